@@ -1,11 +1,27 @@
 const std = @import("std");
 
+/// Specs `-Daot` compiles decoders for unless told otherwise, the ones we
+/// lift the most
+const default_aot_specs = [_][]const u8{ "riscv.lp64d.sla", "SparcV9_32.sla" };
+
 // Although this function looks imperative, note that its job is to
 // declaratively construct a build graph that will be executed by an external
 // runner.
 pub fn build(b: *std.Build) !void {
     const target = b.standardTargetOptions(.{});
     const optimize = b.standardOptimizeOption(.{});
+    const stats = b.option(bool, "stats", "Compile in the lift counters printed by `struct.foo --profile`") orelse false;
+    const aot_specs = b.option([]const []const u8, "aot", "Specs in specfiles/ to compile decoders for ahead of time, once per spec or `none` (default riscv.lp64d.sla + SparcV9_32.sla)") orelse &default_aot_specs;
+
+    // writes the decoders of `aot_specs`, it runs on the build host
+    const gen_exe = b.addExecutable(.{
+        .name = "gen-decoder",
+        .root_source_file = .{ .path = "src/gen_decoder.zig" },
+        .target = b.host,
+        .optimize = optimize,
+    });
+    try add_deps(b, gen_exe, b.host, optimize, &.{}, &.{});
+    const decoders = try generate_decoders(b, gen_exe, aot_specs);
 
     const exe = b.addExecutable(.{
         .name = "struct.foo",
@@ -20,8 +36,9 @@ pub fn build(b: *std.Build) !void {
     const clap_dep = b.dependency("clap", .{ .target = target, .optimize = optimize }).module("clap");
     exe.root_module.addImport("clap", clap_dep);
 
-    // add + link all the core dependencies
-    try add_deps(b, exe, target, optimize);
+    // add + link all the core dependencies, `-Dstats` also counts allocations
+    const exe_flags: []const []const u8 = if (stats) &.{ "-DLIBSLA_STATS", "-DLIBSLA_COUNT_ALLOCATIONS" } else &.{};
+    try add_deps(b, exe, target, optimize, exe_flags, decoders);
 
     // This declares intent for the executable to be installed into the
     // standard location when the user invokes the "install" step (the default
@@ -51,6 +68,44 @@ pub fn build(b: *std.Build) !void {
     const run_step = b.step("run", "Run the app");
     run_step.dependOn(&run_cmd.step);
 
+    // converts `.sla` specs into packed specs that skip the XML parser
+    const pack_exe = b.addExecutable(.{
+        .name = "pack-sla",
+        .root_source_file = .{ .path = "src/pack_sla.zig" },
+        .target = target,
+        .optimize = optimize,
+    });
+    try add_deps(b, pack_exe, target, optimize, &.{}, &.{});
+    b.installArtifact(pack_exe);
+
+    const pack_cmd = b.addRunArtifact(pack_exe);
+    pack_cmd.step.dependOn(b.getInstallStep());
+    if (b.args) |args| {
+        pack_cmd.addArgs(args);
+    }
+
+    const pack_step = b.step("pack-sla", "Convert a .sla into a packed spec: zig build pack-sla -- <in.sla> <out.psla>");
+    pack_step.dependOn(&pack_cmd.step);
+
+    // lift throughput of every spec, libsla is built counting its allocations
+    const bench_exe = b.addExecutable(.{
+        .name = "bench",
+        .root_source_file = .{ .path = "src/bench.zig" },
+        .target = target,
+        .optimize = optimize,
+    });
+    try add_deps(b, bench_exe, target, optimize, &.{"-DLIBSLA_COUNT_ALLOCATIONS"}, decoders);
+    b.installArtifact(bench_exe);
+
+    const bench_cmd = b.addRunArtifact(bench_exe);
+    bench_cmd.step.dependOn(b.getInstallStep());
+    if (b.args) |args| {
+        bench_cmd.addArgs(args);
+    }
+
+    const bench_step = b.step("bench", "Benchmark lifting with every spec, prints JSON: zig build bench -- [--bytes <n>] [--input <elf>] [spec filters]");
+    bench_step.dependOn(&bench_cmd.step);
+
     // Creates a step for unit testing. This only builds the test executable
     // but does not run it.
     const unit_tests = b.addTest(.{
@@ -60,7 +115,7 @@ pub fn build(b: *std.Build) !void {
     });
 
     // add deps to test binary
-    try add_deps(b, unit_tests, target, optimize);
+    try add_deps(b, unit_tests, target, optimize, &.{}, decoders);
     const run_unit_tests = b.addRunArtifact(unit_tests);
 
     // Similar to creating the run step earlier, this exposes a `test` step to
@@ -75,8 +130,29 @@ pub fn build(b: *std.Build) !void {
     docs_step.dependOn(&generate_docs.step);
 }
 
-/// Add all the dependencies via the compile step
-fn add_deps(b: *std.Build, build_step: *std.Build.Step.Compile, target: std.Build.ResolvedTarget, optimize: std.builtin.OptimizeMode) !void {
+/// Runs `gen-decoder` over each of `specs` (file names in `specfiles/`),
+/// returns the sources it writes
+fn generate_decoders(b: *std.Build, gen_exe: *std.Build.Step.Compile, specs: []const []const u8) ![]const std.Build.LazyPath {
+    var sources = std.ArrayList(std.Build.LazyPath).init(b.allocator);
+    for (specs) |spec| {
+        if (std.mem.eql(u8, spec, "none")) {
+            continue;
+        }
+
+        const name = std.fs.path.stem(spec);
+        const gen_cmd = b.addRunArtifact(gen_exe);
+        gen_cmd.addFileArg(.{ .path = b.fmt("specfiles/{s}", .{spec}) });
+        try sources.append(gen_cmd.addOutputFileArg(b.fmt("{s}.cc", .{name})));
+        gen_cmd.addArg(name);
+    }
+    return sources.toOwnedSlice();
+}
+
+/// Add all the dependencies via the compile step, `sleigh_flags` are passed
+/// on to every SLEIGH source. The generated `decoders` are compiled into
+/// the step itself, out of a static library the linker would drop them as
+/// nothing refers to them.
+fn add_deps(b: *std.Build, build_step: *std.Build.Step.Compile, target: std.Build.ResolvedTarget, optimize: std.builtin.OptimizeMode, sleigh_flags: []const []const u8, decoders: []const std.Build.LazyPath) !void {
     // C deps
     build_step.linkLibC();
     const libsla = b.addStaticLibrary(.{
@@ -85,9 +161,18 @@ fn add_deps(b: *std.Build, build_step: *std.Build.Step.Compile, target: std.Buil
         .optimize = optimize,
     });
 
-    try build_sleigh(libsla, b);
+    try build_sleigh(libsla, b, sleigh_flags);
     build_step.linkLibrary(libsla);
 
+    if (decoders.len > 0) {
+        const flags = try build_sleigh_flags(b, sleigh_flags);
+        build_step.addIncludePath(.{ .path = "deps/sleigh" });
+        for (decoders) |decoder| {
+            build_step.addCSourceFile(.{ .file = decoder, .flags = flags });
+        }
+        build_step.linkLibCpp();
+    }
+
     // at some point we'll use actual binutils-bfd master
     //build_step.addIncludePath("./deps/binutils-gdb/bfd");
     //build_step.addIncludePath("./deps/binutils-gdb");
@@ -98,9 +183,9 @@ fn add_deps(b: *std.Build, build_step: *std.Build.Step.Compile, target: std.Buil
     //build_step.addObjectFile(.{ .path = "./deps/libz3.so" });
 }
 
-/// Builds the packaged SLEIGH library
-fn build_sleigh(sleigh_lib: *std.Build.Step.Compile, b: *std.Build) !void {
-    const flags = [_][]const u8{
+/// Flags of every SLEIGH source, `extra_flags` after the defaults
+fn build_sleigh_flags(b: *std.Build, extra_flags: []const []const u8) ![]const []const u8 {
+    const default_flags = [_][]const u8{
         "-march=native",
         "-O3",
         "-Werror",
@@ -112,6 +197,16 @@ fn build_sleigh(sleigh_lib: *std.Build.Step.Compile, b: *std.Build) !void {
         "-fPIC",
     };
 
+    var flags = std.ArrayList([]const u8).init(b.allocator);
+    try flags.appendSlice(&default_flags);
+    try flags.appendSlice(extra_flags);
+    return flags.toOwnedSlice();
+}
+
+/// Builds the packaged SLEIGH library, with `extra_flags` after the defaults
+fn build_sleigh(sleigh_lib: *std.Build.Step.Compile, b: *std.Build, extra_flags: []const []const u8) !void {
+    const flags = try build_sleigh_flags(b, extra_flags);
+
     var sources = std.ArrayList([]const u8).init(b.allocator);
     {
         var dir = try std.fs.cwd().openDir("deps/sleigh", .{ .iterate = true, .access_sub_paths = true });
@@ -139,13 +234,14 @@ fn build_sleigh(sleigh_lib: *std.Build.Step.Compile, b: *std.Build) !void {
     //exe.addLibraryPath(.{.path="./deps/gluon/target/release/"});
 
     // add source files
-    sleigh_lib.addCSourceFiles(.{ .files = sources.items, .flags = &flags });
+    sleigh_lib.addCSourceFiles(.{ .files = sources.items, .flags = flags });
 
     // link bfd
     sleigh_lib.linkSystemLibrary("bfd");
 
-    // link zstd
+    // link zlib + zstd, `zstd_image.cc` decompresses images
     sleigh_lib.linkSystemLibrary("z");
+    sleigh_lib.linkSystemLibrary("zstd");
 
     // link stdc++
     sleigh_lib.linkLibCpp();
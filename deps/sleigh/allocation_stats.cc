@@ -0,0 +1,62 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "allocation_stats.hh"
+
+#ifdef LIBSLA_COUNT_ALLOCATIONS
+
+static std::atomic<uint64_t> allocation_count(0);
+static std::atomic<uint64_t> allocation_bytes(0);
+
+static void *counted_allocate(size_t size)
+{
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+  return malloc(size != 0 ? size : 1);
+}
+
+void *operator new(size_t size)
+{
+  void *out = counted_allocate(size);
+  if (out == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return out;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  return counted_allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return counted_allocate(size);
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { free(ptr); }
+
+bool allocation_stats(uint64_t *count, uint64_t *bytes)
+{
+  *count = allocation_count.load(std::memory_order_relaxed);
+  *bytes = allocation_bytes.load(std::memory_order_relaxed);
+  return true;
+}
+
+#else
+
+bool allocation_stats(uint64_t *count, uint64_t *bytes)
+{
+  *count = 0;
+  *bytes = 0;
+  return false;
+}
+
+#endif
@@ -0,0 +1,20 @@
+/// \file allocation_stats.hh
+/// \brief Counts of the heap allocations made through `operator new`
+///
+/// Only compiled in when libsla is built with `-DLIBSLA_COUNT_ALLOCATIONS`:
+/// the global `operator new`s are replaced with ones that count every call
+/// and byte before going to `malloc`. This is what `zig build bench` uses to
+/// report allocations per instruction, and it costs an atomic add per
+/// allocation, so nothing else is built with it.
+#ifndef __ALLOCATION_STATS_HH__
+#define __ALLOCATION_STATS_HH__
+
+#include <cstdint>
+
+/**
+ * \brief sets `count` + `bytes` to the calls to and bytes requested from
+ * `operator new` so far, returns false if counting isn't compiled in
+ */
+bool allocation_stats(uint64_t *count, uint64_t *bytes);
+
+#endif
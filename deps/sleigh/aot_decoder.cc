@@ -0,0 +1,133 @@
+#include <atomic>
+#include <ios>
+#include <vector>
+
+#include "aot_decoder.hh"
+#include "sleighbase.hh"
+#include "translate.hh"
+
+// every registered decoder, the last registered first. Only pushed to
+// before `main`, so it is never written while being read
+static AotDecoder *registered = nullptr;
+
+static std::atomic<bool> enabled(true);
+
+AotDecoderRegistration::AotDecoderRegistration(AotDecoder *decoder)
+{
+  decoder->next = registered;
+  registered = decoder;
+}
+
+void aot_stream_overrun(void)
+{
+  throw ghidra::BadDataError("Instruction is using more than 16 bytes");
+}
+
+/** \brief every subtable of `spec`, in symbol id order */
+static std::vector<ghidra::SubtableSymbol *>
+subtables(const ghidra::SleighBase &spec)
+{
+  std::vector<ghidra::SubtableSymbol *> out;
+  for (ghidra::int4 id = 0; id < spec.numSymbols(); id++)
+  {
+    ghidra::SleighSymbol *sym = spec.findSymbol(id);
+    if (sym->getType() == ghidra::SleighSymbol::subtable_symbol)
+    {
+      out.push_back((ghidra::SubtableSymbol *)sym);
+    }
+  }
+  return out;
+}
+
+uint64_t aot_decoder_fingerprint(const ghidra::SleighBase &spec)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const ghidra::SubtableSymbol *table : subtables(spec))
+  {
+    for (char c : table->getName())
+    {
+      hash = (hash ^ (uint8_t)c) * 0x100000001b3ULL;
+    }
+    hash = (hash ^ table->getNumConstructors()) * 0x100000001b3ULL;
+    hash = table->getDecisionTable().fingerprint(hash);
+  }
+  return hash;
+}
+
+void aot_decoder_write(const ghidra::SleighBase &spec, const std::string &name,
+                       std::ostream &out)
+{
+  std::vector<ghidra::SubtableSymbol *> tables = subtables(spec);
+  out << "// Generated by `gen-decoder` from " << name << ", do not edit\n"
+      << "#include \"aot_decoder.hh\"\n\n"
+      << "namespace\n{\nusing namespace ghidra;\n\n";
+  for (size_t i = 0; i < tables.size(); i++)
+  {
+    if (tables[i]->getDecisionTable().empty())
+    {
+      continue;
+    }
+    out << "// " << tables[i]->getName() << "\n";
+    tables[i]->getDecisionTable().writeDecoder(out,
+                                               "decode_" + std::to_string(i));
+    out << "\n";
+  }
+
+  out << "const char *const tables[] = {\n";
+  for (ghidra::SubtableSymbol *table : tables)
+  {
+    out << "    \"" << table->getName() << "\",\n";
+  }
+  out << "};\n\nconst CompiledDecoder decoders[] = {\n";
+  for (size_t i = 0; i < tables.size(); i++)
+  {
+    if (tables[i]->getDecisionTable().empty())
+    {
+      out << "    nullptr,\n";
+    }
+    else
+    {
+      out << "    decode_" << i << ",\n";
+    }
+  }
+  out << "};\n\nAotDecoder decoder = {\"" << name << "\", 0x" << std::hex
+      << aot_decoder_fingerprint(spec) << std::dec << "ULL, " << tables.size()
+      << ", tables, decoders, nullptr};\n"
+      << "const AotDecoderRegistration registration(&decoder);\n"
+      << "} // namespace\n";
+}
+
+const AotDecoder *aot_decoder_install(ghidra::SleighBase &spec)
+{
+  if (!enabled.load(std::memory_order_relaxed) || registered == nullptr)
+  {
+    return nullptr;
+  }
+
+  uint64_t fingerprint = aot_decoder_fingerprint(spec);
+  const AotDecoder *decoder = registered;
+  while (decoder != nullptr && decoder->fingerprint != fingerprint)
+  {
+    decoder = decoder->next;
+  }
+  if (decoder == nullptr)
+  {
+    return nullptr;
+  }
+
+  std::vector<ghidra::SubtableSymbol *> tables = subtables(spec);
+  if (tables.size() != decoder->table_count)
+  {
+    return nullptr;
+  }
+  for (size_t i = 0; i < tables.size(); i++)
+  {
+    tables[i]->setCompiled(decoder->decoders[i]);
+  }
+  return decoder;
+}
+
+void aot_decoder_enable(bool enable)
+{
+  enabled.store(enable, std::memory_order_relaxed);
+}
@@ -0,0 +1,177 @@
+/// \file aot_decoder.hh
+/// \brief Decision trees of a spec compiled to C++ ahead of time
+///
+/// Resolving a constructor walks the `DecisionTable` of its subtable: a
+/// loop reading field positions and pattern words out of arrays, through
+/// the out of line bit readers of `ParserContext`. For the specs that get
+/// lifted all the time, `zig build` runs `gen-decoder` over them and
+/// compiles what it writes into the binary. Every subtable then becomes a
+/// function of nested `switch`es on fields whose positions are constants,
+/// ending in the pattern tests of its leaves as constant mask + compares.
+/// The code resolves exactly the constructors the table would, including
+/// where it throws.
+///
+/// A generated file registers its decoder when the binary starts, keyed by
+/// the fingerprint of the decision trees it was generated from (see
+/// `DecisionTable::fingerprint`). Loading a spec with that fingerprint
+/// hooks the functions into its subtables, so a spec that changed since
+/// (or one that was never generated) keeps resolving through its tables.
+/// Only constructor resolution is compiled, building p-code still goes
+/// through the templates of the spec.
+#ifndef __AOT_DECODER_HH__
+#define __AOT_DECODER_HH__
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "slghsymbol.hh"
+
+namespace ghidra
+{
+class SleighBase;
+}
+
+/**
+ * \brief throws the `ghidra::BadDataError` of reading past the 16 bytes of
+ * the instruction stream, out of line so every inlined read stays small
+ */
+[[noreturn]] void aot_stream_overrun(void);
+
+/**
+ * \brief reads the instruction stream + context of a parse the way
+ * `ParserContext` does, but inline so generated code folds its constant
+ * bit positions
+ */
+struct AotStream
+{
+  const ghidra::uint1 *buf;
+  ghidra::uint4 off; // of the operand being resolved
+  const ghidra::uintm *context;
+  ghidra::int4 contextsize;
+
+  explicit AotStream(const ghidra::ParserWalker &walker)
+      : buf(walker.getInstructionBuffer()), off(walker.getOffset(-1)),
+        context(walker.getContextWords()),
+        contextsize(walker.getContextSize())
+  {
+  }
+
+  /** \brief same as `ParserWalker::getInstructionBits` */
+  ghidra::uintm bits(ghidra::int4 startbit, ghidra::int4 size) const
+  {
+    ghidra::uint4 at = off + startbit / 8;
+    if (at >= 16)
+    {
+      aot_stream_overrun();
+    }
+    startbit = startbit % 8;
+    ghidra::int4 bytesize = (startbit + size - 1) / 8 + 1;
+    ghidra::uintm res = 0;
+    for (ghidra::int4 i = 0; i < bytesize; i++)
+    {
+      res = (res << 8) | buf[at + i];
+    }
+    res <<= 8 * (sizeof(ghidra::uintm) - bytesize) + startbit;
+    res >>= 8 * sizeof(ghidra::uintm) - size;
+    return res;
+  }
+
+  /**
+   * \brief same as `ParserWalker::getInstructionBytes` of a whole word
+   * at `byteoff`
+   */
+  ghidra::uintm bytes(ghidra::int4 byteoff) const
+  {
+    ghidra::uint4 at = off + byteoff;
+    if (at >= 16)
+    {
+      aot_stream_overrun();
+    }
+    ghidra::uintm res = 0;
+    for (ghidra::int4 i = 0; i < (ghidra::int4)sizeof(ghidra::uintm); i++)
+    {
+      res = (res << 8) | buf[at + i];
+    }
+    return res;
+  }
+
+  /** \brief same as `ParserWalker::getContextBits` */
+  ghidra::uintm contextBits(ghidra::int4 startbit, ghidra::int4 size) const
+  {
+    ghidra::int4 intstart = startbit / (8 * sizeof(ghidra::uintm));
+    ghidra::int4 bitoff = startbit % (8 * sizeof(ghidra::uintm));
+    ghidra::uintm res = context[intstart];
+    res <<= bitoff;
+    res >>= 8 * sizeof(ghidra::uintm) - size;
+    ghidra::int4 remaining = size - 8 * sizeof(ghidra::uintm) + bitoff;
+    if (remaining > 0 && intstart + 1 < contextsize)
+    {
+      res |= context[intstart + 1] >> (8 * sizeof(ghidra::uintm) - remaining);
+    }
+    return res;
+  }
+
+  /**
+   * \brief same as `ParserWalker::getContextBytes` of a whole word at
+   * `byteoff`
+   */
+  ghidra::uintm contextBytes(ghidra::int4 byteoff) const
+  {
+    ghidra::int4 intstart = byteoff / sizeof(ghidra::uintm);
+    ghidra::int4 shift = byteoff % sizeof(ghidra::uintm);
+    ghidra::uintm res = context[intstart];
+    if (shift == 0)
+    {
+      return res;
+    }
+    res <<= shift * 8;
+    if (intstart + 1 < contextsize)
+    {
+      res |= context[intstart + 1] >> ((sizeof(ghidra::uintm) - shift) * 8);
+    }
+    return res;
+  }
+};
+
+/** \brief the decoder generated for one spec */
+struct AotDecoder
+{
+  const char *name;     // what it was generated from
+  uint64_t fingerprint; // `aot_decoder_fingerprint` of that spec
+  uint32_t table_count;
+  const char *const *tables; // subtable names, in symbol id order
+  const ghidra::CompiledDecoder *decoders; // of each of `tables`
+  AotDecoder *next;                        // registered before it
+};
+
+/** \brief registers `decoder`, generated files do this before `main` */
+struct AotDecoderRegistration
+{
+  explicit AotDecoderRegistration(AotDecoder *decoder);
+};
+
+/**
+ * \brief hashes the decision trees of every subtable of `spec`, along
+ * with the subtable names + constructor counts
+ */
+uint64_t aot_decoder_fingerprint(const ghidra::SleighBase &spec);
+
+/**
+ * \brief writes C++ source of a decoder for `spec` to `out`, registered
+ * as `name` when compiled in
+ */
+void aot_decoder_write(const ghidra::SleighBase &spec, const std::string &name,
+                       std::ostream &out);
+
+/**
+ * \brief hooks the registered decoder matching the fingerprint of `spec`
+ * into its subtables, returns it or null if there is none (or decoders
+ * were turned off with `aot_decoder_enable`)
+ */
+const AotDecoder *aot_decoder_install(ghidra::SleighBase &spec);
+
+/** \brief whether `aot_decoder_install` installs anything, on by default */
+void aot_decoder_enable(bool enable);
+
+#endif
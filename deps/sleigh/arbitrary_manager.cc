@@ -1,17 +1,43 @@
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <ios>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "allocation_stats.hh"
+#include "aot_decoder.hh"
+#include "bfd_image.hh"
+#include "decode_cache.hh"
+#include "decode_profile.hh"
+#include "insn_effects.hh"
+#include "lane_emulator.hh"
+#include "lift_arena.hh"
+#include "lift_stats.hh"
 #include "loadimage.hh"
+#include "mapped_file.hh"
+#include "numa_placement.hh"
 #include "opcodes.hh"
+#include "packed_spec.hh"
+#include "pcode_simplify.hh"
 #include "pcoderaw.hh"
+#include "register_table.hh"
 #include "sleigh.hh"
+#include "snapshot_emulator.hh"
+#include "spec_arena.hh"
 #include "space.hh"
 #include "translate.hh"
 #include "xml.hh"
+#include "xml_scan.hh"
+#include "zstd_image.hh"
 
 struct VarnodeDesc
 {
@@ -40,16 +66,243 @@ struct InsnDesc
   uint64_t body_len;
 };
 
+/// Instruction record inside of a `LiftedRange` arena. Instead of pointers
+/// every member references the other tables of the arena by index, so the
+/// whole arena can be freed (or copied) in one go.
+struct RangeInsnDesc
+{
+  uint64_t address;
+  uint64_t size;
+  uint64_t op_start;    // index of the first op in the op table
+  uint64_t op_count;
+  uint64_t insn_offset; // byte offset of the mnemonic in the text pool
+  uint64_t insn_len;
+  uint64_t body_offset; // byte offset of the operands in the text pool
+  uint64_t body_len;
+};
+
+/// Marks an op of a `LiftedRange` that has no output varnode
+#define RANGE_NO_OUTPUT UINT32_MAX
+
+/// How an instruction of a `LiftedRange` moves along with the bytes it was
+/// decoded from, see `arbitrary_manager_relocate_range`
+enum RangeInsnReloc
+{
+  RangeInsnPinned = 0, // decoded again wherever it moves to
+  RangeInsnMoves = 1,  // only its relocated varnodes change, the text stays
+  RangeInsnRetext = 2, // its text holds an address and is rendered again
+};
+
+/// A range lift stops early once it holds this many varnodes, so every
+/// varnode index fits into the `uint32_t` op columns
+#define RANGE_MAX_VARNODES (UINT32_MAX - 0xffff)
+
+/// Distinct encodings a manager interns unless `set_insn_intern` says
+/// otherwise, a few MB of p-code at most
+#define DEFAULT_INSN_INTERN (1 << 16)
+
+/// Caller-owned output of `arbitrary_manager_lift_range`.
+///
+/// Every table lives inside of the single `arena` allocation, and the
+/// `*_offset` members are the byte offsets of each table from the start
+/// of the arena. Release with `arbitrary_manager_release`.
+///
+/// The op + varnode tables are stored as one column per member, so scans
+/// over a single member (eg. every opcode of an instruction) only touch
+/// that member. Op `i` is `{opcodes[i], outputs[i], input_starts[i],
+/// input_lens[i]}`, varnode `i` is `{offsets[i], sizes[i], spaces[i],
+/// registers[i]}`.
+/// Each column starts 8 byte aligned.
+///
+/// Repeats of an interned encoding (see `arbitrary_manager_set_insn_intern`)
+/// share the op + varnode rows and text of the first one in the range, so
+/// `op_count` can be less than the op counts of the instructions added up.
+///
+/// The constant space operand of `LOAD` / `STORE` holds the index of the
+/// space instead of an `AddrSpace` pointer, so an arena holds no pointers
+/// and can be written out and read back in by another process.
+///
+/// `registers[i]` is the index into `arbitrary_manager_get_all_registers`
+/// of the register varnode `i` names, resolved while lifting so nothing
+/// downstream has to look it up again.
+///
+/// `effects[i]` sums up what instruction `i` reads, writes and how it ends
+/// (see `insn_effects.hh`), so gadget filters can test it without walking
+/// its ops.
+///
+/// `insn_relocs[i]` is the `RangeInsnReloc` of instruction `i` and
+/// `vn_relocs[i]` how varnode `i` moves with it, its `InternRelocKind` + 1
+/// or 0 if it stays.
+struct LiftedRange
+{
+  uint8_t *arena;
+  uint64_t arena_size;
+  uint64_t end_address; // first address that was not lifted
+  uint64_t insn_count;
+  uint64_t insns_offset;           // RangeInsnDesc[insn_count]
+  uint64_t op_count;
+  uint64_t op_opcodes_offset;      // uint32_t[op_count], `ghidra::OpCode`
+  uint64_t op_outputs_offset;      // uint32_t[op_count], or `RANGE_NO_OUTPUT`
+  uint64_t op_input_starts_offset; // uint32_t[op_count]
+  uint64_t op_input_lens_offset;   // uint32_t[op_count]
+  uint64_t varnode_count;
+  uint64_t vn_offsets_offset;      // uint64_t[varnode_count]
+  uint64_t vn_sizes_offset;        // uint32_t[varnode_count]
+  uint64_t vn_spaces_offset;       // uint32_t[varnode_count], space index
+  uint64_t vn_registers_offset;    // uint32_t[varnode_count], or `REGISTER_NONE`
+  uint64_t text_size;
+  uint64_t text_offset;            // char[text_size], not null terminated
+  uint64_t effects_offset;         // InsnEffects[insn_count]
+  uint64_t insn_relocs_offset;     // uint8_t[insn_count], `RangeInsnReloc`
+  uint64_t vn_relocs_offset;       // uint8_t[varnode_count]
+};
+
 struct RegisterDesc
 {
   char name[64];
   VarnodeDesc varnode;
 };
 
+/// Every register of the spec, ordered by space, offset and then size
+/// descending. Owned by the spec, see `RegisterTable` for the lookup.
 struct RegisterList
 {
   uint64_t register_count;
   RegisterDesc *registers;
+  // registers `[space_start, space_start + space_count)` are the ones in
+  // the register space, `offsets` holds their ascending offsets
+  uint64_t space_start;
+  uint64_t space_count;
+  const uint64_t *offsets;
+  // index of the first register at offset `direct_base + i`, or
+  // `REGISTER_NONE`. `direct_count` is 0 if the register space is too
+  // sparse to index directly
+  uint64_t direct_base;
+  uint64_t direct_count;
+  const uint32_t *direct;
+  // effect slot (`InsnEffects` bit) of every register, and the id of the
+  // stack pointer the effects track or `REGISTER_NONE`
+  const uint16_t *slots;
+  uint64_t stack_pointer;
+};
+
+/// Name of the address space with an index of `index`
+struct SpaceDesc
+{
+  char name[16];
+  uint64_t index;
+};
+
+/// Table of every address space in the spec, `spaces[i].index == i`.
+/// Entries for unused indices have an empty name.
+struct SpaceList
+{
+  uint64_t space_count;
+  SpaceDesc *spaces;
+};
+
+/// Copy-on-write view of part of a file from `arbitrary_file_map`, `data`
+/// can be handed straight to `arbitrary_manager_load_region` so SLEIGH reads
+/// the image out of the page cache instead of a heap copy
+struct MappedRegion
+{
+  uint8_t *data;
+  uint64_t size;
+  MappedFile *file; // owns the mapping
+};
+
+/// A zstd image from `arbitrary_zstd_open`, managers it is loaded into keep
+/// their own reference so it can be closed as soon as it is loaded
+struct ZstdHandle
+{
+  std::shared_ptr<ZstdImage> image;
+};
+
+/// A section of an object file from `arbitrary_bfd_open`, `data` points into
+/// the mapped file and is null for sections without bytes in the file
+struct ObjectSection
+{
+  const char *name;
+  uint64_t address;
+  uint64_t size;
+  /// `ghidra::LoadImageSection` flags
+  uint32_t flags;
+  uint8_t *data;
+};
+
+/// An object file from `arbitrary_bfd_open`, `sections` are its allocated
+/// sections in the order of its section table
+struct ObjectImage
+{
+  uint64_t section_count;
+  ObjectSection *sections;
+  uint64_t entry;
+  const char *arch;
+  BfdImage *image; // owns the mapping + names
+};
+
+/// Assembly of one instruction from `arbitrary_manager_disasm`, the text is
+/// owned by the manager and only valid until its next call
+struct DisasmText
+{
+  uint64_t size;
+  const char *insn;
+  uint64_t insn_len;
+  const char *body;
+  uint64_t body_len;
+};
+
+/// Length and control flow of one instruction from the flow-only decoder,
+/// `flow` is a mask of `ghidra::Sleigh::flow_flags`
+struct InsnFlow
+{
+  uint64_t address;
+  uint64_t size;
+  uint64_t flow;
+};
+
+/// How control leaves a basic block along a `BlockEdge`
+enum BlockEdgeKind
+{
+  BlockEdgeFallthrough = 0, // into the instruction right after the block
+  BlockEdgeBranch = 1,      // a `BRANCH` / `CBRANCH` to a constant address
+  BlockEdgeCall = 2,        // a `CALL` of a constant address
+};
+
+/// Edge out of a basic block from `arbitrary_manager_block_flow`
+struct BlockEdge
+{
+  uint64_t target;
+  uint32_t kind; // `BlockEdgeKind`
+  uint32_t _pad;
+};
+
+/// Basic block decoded by `arbitrary_manager_block_flow`, `flow` is a mask
+/// of `ghidra::Sleigh::flow_flags` of how its last instruction leaves it,
+/// `flow_unimplemented` if the bytes after it don't decode
+struct BlockFlow
+{
+  uint64_t start;
+  uint64_t end; // first address past its last instruction
+  uint64_t insn_count;
+  uint64_t flow;
+  uint64_t edge_count; // can be more than the capacity of the edges
+};
+
+/// What the decoded spec of a manager holds, from
+/// `arbitrary_manager_spec_memory_usage`. A spec is shared by every manager
+/// forked from or attached to it, so this is paid once for all of them.
+struct SpecMemoryUsage
+{
+  uint64_t symbol_count;
+  uint64_t constructor_count;
+  uint64_t op_template_count;
+  uint64_t varnode_template_refs;  // outputs + inputs of every op template
+  uint64_t varnode_template_count; // distinct `VarnodeTpl`s kept for them
+  uint64_t name_bytes;             // characters of every symbol name
+  uint64_t template_bytes;         // of templates in the spec's `SpecArena`
+  uint64_t template_capacity;      // bytes of the arena's chunks
+  uint64_t references;             // managers + spec handles sharing it
 };
 
 struct UserOpNames
@@ -110,8 +363,26 @@ public:
     insn_body = strdup(body.c_str());
     insn_body_len = body.size();
   }
+
+  virtual void dumpText(const ghidra::Address &addr, const char *text,
+                        ghidra::int4 text_len, const char *body,
+                        ghidra::int4 body_len)
+  {
+    address = addr.getOffset();
+    insn_text = strndup(text, text_len);
+    insn_text_len = text_len;
+    insn_body = strndup(body, body_len);
+    insn_body_len = body_len;
+  }
 };
 
+static void to_varnode_desc(const ghidra::VarnodeData &vn, VarnodeDesc *out)
+{
+  out->offset = vn.offset;
+  out->size = vn.size;
+  strncpy(out->space, vn.space->getName().c_str(), sizeof(out->space));
+}
+
 class ArbitraryPcodeEmitter : public ghidra::PcodeEmit
 {
 public:
@@ -122,39 +393,118 @@ public:
                     ghidra::VarnodeData *output, ghidra::VarnodeData *inputs,
                     ghidra::int4 input_len)
   {
-    pcode_ops.emplace_back();
-    PcodeOp &op = pcode_ops.back();
+    ghidra::PcodeData op;
+    op.opc = opcode;
+    op.outvar = output;
+    op.invar = inputs;
+    op.isize = input_len;
+    dumpOps(addr, &op, 1, nullptr, 0);
+  }
 
-    op.opcode = opcode;
-    op.input_len = (uint64_t)input_len;
+  /// the varnodes of every op of the instruction go into one block, which
+  /// starts at the first varnode of the first op
+  virtual void dumpOps(const ghidra::Address &addr, const ghidra::PcodeData *ops,
+                       ghidra::int4 count, const ghidra::VarnodeData *pool,
+                       ghidra::int4 pool_size)
+  {
+    size_t varnode_count = 0;
+    for (ghidra::int4 i = 0; i < count; i++)
+    {
+      varnode_count += ops[i].isize + (ops[i].outvar != nullptr ? 1 : 0);
+    }
 
-    // copy the n input nodes
-    VarnodeDesc *input_descs = new (std::nothrow) VarnodeDesc[input_len];
-    for (int i = 0; i < input_len; i++)
+    VarnodeDesc *descs = new (std::nothrow) VarnodeDesc[varnode_count];
+    for (ghidra::int4 i = 0; i < count; i++)
     {
-      ghidra::VarnodeData input_node = inputs[i];
-      input_descs[i].offset = input_node.offset;
-      input_descs[i].size = input_node.size;
-      strncpy(input_descs[i].space, input_node.space->getName().c_str(),
-              sizeof(input_descs[i].space));
+      const ghidra::PcodeData &src = ops[i];
+      pcode_ops.emplace_back();
+      PcodeOp &op = pcode_ops.back();
+
+      op.opcode = src.opc;
+      op.output = nullptr;
+      if (src.outvar != nullptr)
+      {
+        op.output = descs++;
+        to_varnode_desc(*src.outvar, op.output);
+      }
+
+      op.input_len = (uint64_t)src.isize;
+      op.inputVarnodes = descs;
+      for (ghidra::int4 j = 0; j < src.isize; j++)
+      {
+        to_varnode_desc(src.invar[j], descs++);
+      }
     }
-    op.inputVarnodes = input_descs;
+  }
+
+};
 
-    // now get the output metadata is there is an output node
-    if (output != nullptr)
+/// Op + varnode columns of a range lift, only ever cleared so their storage
+/// gets reused across lifts.
+class RangeColumns
+{
+public:
+  std::vector<uint32_t> opcodes;
+  std::vector<uint32_t> outputs;
+  std::vector<uint32_t> input_starts;
+  std::vector<uint32_t> input_lens;
+  std::vector<uint64_t> offsets;
+  std::vector<uint32_t> sizes;
+  std::vector<uint32_t> spaces;
+  std::vector<uint32_t> registers;
+  std::vector<uint8_t> relocs;
+
+  uint64_t op_count(void) const { return opcodes.size(); }
+  uint64_t varnode_count(void) const { return offsets.size(); }
+
+  /**
+   * \brief appends the ops + varnodes of `insn`, resolving the register of
+   * every varnode through `table`
+   */
+  void append(const DecodedInsn &insn, const RegisterTable &table)
+  {
+    uint32_t base = varnode_count();
+    for (size_t i = 0; i < insn.varnodes.size(); i++)
     {
-      op.output = new (std::nothrow) VarnodeDesc;
-      op.output->offset = output->offset;
-      op.output->size = output->size;
-      strncpy(op.output->space, output->space->getName().c_str(),
-              sizeof(op.output->space));
+      const ghidra::VarnodeData &vn = insn.varnodes[i];
+      int32_t space = vn.space->getIndex();
+      offsets.push_back(vn.offset);
+      sizes.push_back(vn.size);
+      spaces.push_back(space);
+      registers.push_back(table.lookup(space, vn.offset, vn.size));
+      relocs.push_back(0);
     }
-    else
+
+    for (size_t i = 0; i < insn.ops.size(); i++)
     {
-      // not output node
-      op.output = nullptr;
+      const DecodedOp &op = insn.ops[i];
+      opcodes.push_back(op.opcode);
+      outputs.push_back(op.output == DECODED_NO_OUTPUT ? RANGE_NO_OUTPUT
+                                                       : base + op.output);
+      input_starts.push_back(base + op.input_start);
+      input_lens.push_back(op.input_len);
+
+      if ((op.opcode == ghidra::CPUI_LOAD || op.opcode == ghidra::CPUI_STORE) &&
+          op.input_len > 0)
+      {
+        offsets[base + op.input_start] =
+            insn.varnodes[op.input_start].getSpaceFromConst()->getIndex();
+      }
     }
   }
+
+  void clear(void)
+  {
+    opcodes.clear();
+    outputs.clear();
+    input_starts.clear();
+    input_lens.clear();
+    offsets.clear();
+    sizes.clear();
+    spaces.clear();
+    registers.clear();
+    relocs.clear();
+  }
 };
 
 /// Loader for holding regions we want to be able to translate.
@@ -163,8 +513,6 @@ public:
 /// explicit backing for.
 class ArbitraryLoader : public ghidra::LoadImage
 {
-  // maximum address of any region
-  uint64_t max_addr = 0;
   // minimum address of any region
   uint64_t min_addr = 0xffffffffffffffff;
 
@@ -173,221 +521,855 @@ class ArbitraryLoader : public ghidra::LoadImage
     uint64_t base_address;
     uint64_t size;
     uint8_t *data;
+    // set instead of `data` for a region read out of a zstd image, its
+    // bytes start at `image_offset` of the decompressed image
+    std::shared_ptr<ZstdImage> compressed;
+    uint64_t image_offset;
+    // `ghidra::LoadImageSection` flags of the region it was loaded as
+    uint32_t flags;
+
+    static bool base_less_than(const MemoryDescription &lhs,
+                               const MemoryDescription &rhs)
+    {
+      return lhs.base_address < rhs.base_address;
+    }
+  };
+
+  // sorted by `base_address` and never overlapping, so both the starts and
+  // ends of the regions are in order and can be binary searched. The loader
+  // is shared by forked managers, so there is deliberately no mutable
+  // last-hit cache in here.
+  std::vector<MemoryDescription> regions;
+
+  // every region as it was loaded, before earlier regions cut it up
+  struct SectionDescription
+  {
+    uint64_t address;
+    uint64_t size;
+    uint32_t flags;
   };
+  std::vector<SectionDescription> sections;
+
+  // copies of the bytes `patch_region` wrote, the regions over them point in
+  std::vector<std::unique_ptr<uint8_t[]>> patches;
+
+  // the code space of the spec, what the sections are reported in
+  ghidra::AddrSpace *space = nullptr;
+
+  // index of the first region that ends after `address`,
+  // `regions.size()` if there is none
+  size_t first_region_after(uint64_t address) const
+  {
+    size_t low = 0;
+    size_t high = regions.size();
+    while (low < high)
+    {
+      size_t mid = low + (high - low) / 2;
+      const MemoryDescription &region = regions[mid];
+      if (region.base_address + region.size <= address)
+      {
+        low = mid + 1;
+      }
+      else
+      {
+        high = mid;
+      }
+    }
 
-  // this holds the list of memory regions we're working with
-  std::vector<MemoryDescription *> regions;
+    return low;
+  }
 
 public:
   ArbitraryLoader(void) : ghidra::LoadImage("nofile") {}
   virtual void loadFill(ghidra::uint1 *ptr, ghidra::int4 size,
                         const ghidra::Address &addr);
+  virtual const ghidra::uint1 *getBytes(ghidra::int4 size,
+                                        const ghidra::Address &addr) const;
+  virtual void openSectionInfo(void) const;
+  virtual bool getNextSection(ghidra::LoadImageSection &record) const;
+  virtual void getReadonly(ghidra::RangeList &list) const;
   virtual std::string getArchType(void) const { return "none"; }
   virtual void adjustVma(long adjust) {}
 
-  // finds and returns the minimum address of all the memory regions
-  uint64_t base(void)
-  {
-    uint64_t base = UINT64_MAX;
+  // returns the minimum address of all the memory regions
+  uint64_t base(void) { return min_addr; }
 
-    std::vector<MemoryDescription *>::iterator it;
-    for (it = regions.begin(); it != regions.end(); it++)
-    {
-      uint64_t iter_base = (*it.base())->base_address;
-      if (iter_base < base)
-      {
-        base = iter_base;
-      }
-    }
+  // sets the space the sections are in, once a spec is attached
+  void set_space(ghidra::AddrSpace *code_space) { space = code_space; }
 
-    return base;
+  /**
+   * \brief adds a region to the internal store. Where it overlaps regions
+   * that were loaded earlier the earlier regions win, so only the parts
+   * of it that fill the gaps between them are kept.
+   */
+  void load_region(uint64_t address, uint64_t size, uint8_t *input_data,
+                   uint32_t flags = 0)
+  {
+    add_region(address, size, input_data, nullptr, flags);
   }
 
-  // adds a region to the internal store
-  void load_region(uint64_t address, uint64_t size, uint8_t *input_data)
+  /**
+   * \brief adds the whole decompressed `image` as a region at `address`,
+   * its frames are only decompressed once SLEIGH reads them
+   */
+  void load_region(uint64_t address, const std::shared_ptr<ZstdImage> &image)
   {
-    MemoryDescription *desc = new MemoryDescription;
-    desc->base_address = address;
-    desc->size = size;
-    desc->data = input_data;
-    regions.push_back(desc);
+    add_region(address, image->size(), nullptr, image, 0);
+  }
+
+  /**
+   * \brief replaces `[address, address + size)` with a copy of `bytes`.
+   * The regions under it are cut around the patch, which becomes a region of
+   * its own with the flags of the first one (bytes outside of every region
+   * are mapped by it). The sections stay as they were loaded. Nothing may
+   * be reading out of the loader meanwhile.
+   */
+  void patch_region(uint64_t address, uint64_t size, const uint8_t *bytes)
+  {
+    if (size == 0)
+    {
+      return;
+    }
+    patches.emplace_back(new uint8_t[size]);
+    memcpy(patches.back().get(), bytes, size);
 
-    // adjust minimum address
     if (address < min_addr)
     {
       min_addr = address;
     }
 
-    // adjust maximum address
-    if (address + size > max_addr)
+    uint64_t end = address + size;
+    uint32_t flags = 0;
+    bool flagged = false;
+    std::vector<MemoryDescription> kept;
+    kept.reserve(regions.size() + 2);
+    for (const MemoryDescription &region : regions)
     {
-      max_addr = address + size;
+      uint64_t region_end = region.base_address + region.size;
+      if (region_end <= address || end <= region.base_address)
+      {
+        kept.push_back(region);
+        continue;
+      }
+      if (!flagged)
+      {
+        flags = region.flags;
+        flagged = true;
+      }
+
+      // the parts of the region on either side of the patch
+      if (region.base_address < address)
+      {
+        MemoryDescription before = region;
+        before.size = address - region.base_address;
+        kept.push_back(before);
+      }
+      if (end < region_end)
+      {
+        uint64_t skip = end - region.base_address;
+        MemoryDescription after = region;
+        after.base_address = end;
+        after.size = region_end - end;
+        after.data = region.data != nullptr ? region.data + skip : nullptr;
+        after.image_offset = region.image_offset + skip;
+        kept.push_back(after);
+      }
     }
+
+    MemoryDescription piece;
+    piece.base_address = address;
+    piece.size = size;
+    piece.data = patches.back().get();
+    piece.image_offset = 0;
+    piece.flags = flags;
+    kept.push_back(piece);
+
+    std::sort(kept.begin(), kept.end(), MemoryDescription::base_less_than);
+    regions.swap(kept);
   }
 
-  // given an address, return which of our region's owns it,
-  // null otherwise
-  MemoryDescription *region_from_address(uint64_t address)
+private:
+  void add_region(uint64_t address, uint64_t size, uint8_t *input_data,
+                  const std::shared_ptr<ZstdImage> &image, uint32_t flags)
   {
-    std::vector<MemoryDescription *>::iterator it;
-    for (it = regions.begin(); it != regions.end(); it++)
+    if (size == 0)
+    {
+      return;
+    }
+    sections.push_back(SectionDescription{address, size, flags});
+
+    // adjust minimum address
+    if (address < min_addr)
     {
-      MemoryDescription *guess = *it.base();
+      min_addr = address;
+    }
 
-      // this region starts higher than the address
-      if (guess->base_address > address)
+    uint64_t end = address + size;
+    uint64_t cursor = address;
+    size_t idx = first_region_after(address);
+    size_t old_count = regions.size();
+    while (cursor < end)
+    {
+      // already owned by an earlier region, skip past it
+      if (idx < old_count && regions[idx].base_address <= cursor)
       {
+        cursor = regions[idx].base_address + regions[idx].size;
+        idx++;
         continue;
       }
 
-      // this region ends before the address
-      if (guess->base_address + guess->size <= address)
+      // the gap runs until the next region, or the end of this one
+      uint64_t piece_end = end;
+      if (idx < old_count && regions[idx].base_address < end)
       {
-        continue;
+        piece_end = regions[idx].base_address;
       }
 
-      // this is the correct region
-      return guess;
+      MemoryDescription piece;
+      piece.base_address = cursor;
+      piece.size = piece_end - cursor;
+      piece.data = input_data != nullptr ? input_data + (cursor - address)
+                                         : nullptr;
+      piece.compressed = image;
+      piece.image_offset = cursor - address;
+      piece.flags = flags;
+      regions.push_back(piece);
+      cursor = piece_end;
     }
 
-    return nullptr;
+    std::sort(regions.begin(), regions.end(),
+              MemoryDescription::base_less_than);
   }
 };
 
-/** \brief basically just follow the example `loadFill` except fixes the inner
- * loop extra math garbage. Note that ghidra is going to have 1 loader per
- * address space...so things may get hectic here since we need to fake it
+/** \brief copies the mapped parts of `[addr, addr + size)` straight out of
+ * the regions and zero-fills the gaps between them. Note that ghidra is
+ * going to have 1 loader per address space...so things may get hectic here
+ * since we need to fake it
  */
 void ArbitraryLoader::loadFill(ghidra::uint1 *ptr, ghidra::int4 size,
                                const ghidra::Address &addr)
 {
-  // use this to keep track of data left across region boundaries
-  int32_t bytes_remaining = size;
-  uint64_t search_address = addr.getOffset();
   uint8_t *out = (uint8_t *)ptr;
-  uint64_t write_idx = 0;
+  uint64_t address = addr.getOffset();
+  uint64_t remaining = size > 0 ? size : 0;
+  size_t idx = first_region_after(address);
 
-  // too big
-  if (search_address > max_addr)
+  while (remaining > 0)
   {
-    return;
+    // past the last region, everything left is unmapped
+    if (idx >= regions.size())
+    {
+      memset(out, 0, remaining);
+      return;
+    }
+
+    const MemoryDescription &region = regions[idx];
+
+    // unmapped bytes up to the start of the next region
+    if (region.base_address > address)
+    {
+      uint64_t gap = std::min(remaining, region.base_address - address);
+      memset(out, 0, gap);
+      out += gap;
+      address += gap;
+      remaining -= gap;
+      continue;
+    }
+
+    uint64_t offset = address - region.base_address;
+    uint64_t count = std::min(remaining, region.size - offset);
+    if (region.compressed != nullptr)
+    {
+      region.compressed->read(region.image_offset + offset, out, count);
+    }
+    else
+    {
+      memcpy(out, region.data + offset, count);
+    }
+    out += count;
+    address += count;
+    remaining -= count;
+    idx++;
   }
+}
 
-  // keep looping through memory regions until we've copied all the data
-  while (bytes_remaining > 0)
+/** \brief the bytes of `[addr, addr + size)` where they lie in a single
+ * uncompressed region. Patching never frees the bytes it replaces, so the
+ * old pointers stay valid (with the old bytes).
+ */
+const ghidra::uint1 *ArbitraryLoader::getBytes(ghidra::int4 size,
+                                               const ghidra::Address &addr) const
+{
+  uint64_t address = addr.getOffset();
+  size_t idx = first_region_after(address);
+  if (size <= 0 || idx >= regions.size())
   {
-    // get the region that own the index that houses theh requested
-    // start address
-    MemoryDescription *region = region_from_address(search_address);
+    return nullptr;
+  }
 
-    // no region owns this address, write a null byte until we're done
-    if (region == nullptr)
-    {
+  const MemoryDescription &region = regions[idx];
+  if (region.data == nullptr || region.base_address > address ||
+      region.base_address + region.size - address < (uint64_t)size)
+  {
+    return nullptr;
+  }
+  return region.data + (address - region.base_address);
+}
 
-      out[write_idx] = 0;
+// next section of the walk `openSectionInfo` started, per thread rather
+// than in the (shared) loader itself
+static thread_local size_t section_cursor = 0;
 
-      // adjust counters
-      write_idx++;
-      search_address++;
-      bytes_remaining--;
-      continue;
-    }
+void ArbitraryLoader::openSectionInfo(void) const { section_cursor = 0; }
 
-    // get the region index to start at
-    uint64_t region_index = search_address - region->base_address;
+/** \brief reports every region in the order it was loaded, with the flags
+ * it was loaded with
+ */
+bool ArbitraryLoader::getNextSection(ghidra::LoadImageSection &record) const
+{
+  if (space == nullptr || section_cursor >= sections.size())
+  {
+    return false;
+  }
 
-    // copy all the data from the current region until we:
-    // - hit the end of the section
-    // - copy the necessary bytes
-    for (uint64_t i = region_index; i < region->size && bytes_remaining > 0;
-         i++)
-    {
-      out[write_idx] = region->data[i];
+  const SectionDescription &section = sections[section_cursor++];
+  record.address = ghidra::Address(space, section.address);
+  record.size = section.size;
+  record.flags = section.flags;
+  return section_cursor < sections.size();
+}
 
-      // adjust counters
-      write_idx++;
-      search_address++;
-      bytes_remaining--;
+void ArbitraryLoader::getReadonly(ghidra::RangeList &list) const
+{
+  if (space == nullptr)
+  {
+    return;
+  }
+  for (const SectionDescription &section : sections)
+  {
+    if ((section.flags & ghidra::LoadImageSection::readonly) != 0)
+    {
+      list.insertRange(space, section.address,
+                       section.address + section.size - 1);
     }
   }
 }
 
-class ArbitraryManager
+/** \brief builds the process wide ghidra id tables, only once no matter how
+ * many specs, managers or threads get spun up
+ */
+static void build_id_tables(void)
+{
+  ghidra::AttributeId::initialize();
+  ghidra::ElementId::initialize();
+}
+
+static void initialize_globals(void)
+{
+  static std::once_flag globals_flag;
+  std::call_once(globals_flag, build_id_tables);
+}
+
+/** \brief a decoded `.sla` specification that any number of
+ * `ArbitraryManager`s can attach to without decoding it again.
+ *
+ * The spec owns a fully initialized `Sleigh`, every attached manager gets
+ * a `Sleigh` that borrows its symbol table, decision trees and address
+ * spaces, so only the parser caches + context are per manager. The spec is
+ * reference counted and lives until the last manager using it is gone.
+ */
+class ArbitrarySpec
 {
+  // SLEIGH wants an image + context to exist while decoding the spec,
+  // neither is used to lift anything
   ArbitraryLoader loader;
-  ArbitraryPcodeEmitter pcode_emitter;
-  ArbitraryAsmEmitter asm_emitter;
-  ghidra::DocumentStorage document_storage;
-  ghidra::ContextInternal context; // TODO: make impl of this
-  ghidra::Document *document;
-  ghidra::Element *root_node;
+  ghidra::ContextInternal context;
+  // holds the p-code templates of `sleigh`, so it has to be destroyed after
+  SpecArena template_arena;
   std::unique_ptr<ghidra::Sleigh> sleigh;
-  uint64_t current_translate_address = 0;
+  // built by `load`, never changes after
+  RegisterTable register_table;
+  const AotDecoder *decoder = nullptr; // installed by `load`, if any
+  std::vector<RegisterDesc> register_descs;
+  RegisterList register_list;
+  // guards the (non-atomic) address space reference counts, which are
+  // touched whenever an engine attaches or detaches
+  std::mutex lock;
+  std::atomic<uint32_t> refcount;
 
 public:
-  ArbitraryManager(void)
+  ArbitrarySpec(void) : refcount(1) {}
+
+  /**
+   * \brief reads + decodes the spec at `path`, which is either a `.sla`
+   * or a packed spec (see `packed_spec.hh`). Throws `ghidra::DecoderError`
+   * or `ghidra::LowlevelError` on a bad spec
+   */
+  void load(const char *path)
   {
-    // initialize ghidra globals
-    ghidra::AttributeId::initialize();
-    ghidra::ElementId::initialize();
+    initialize_globals();
 
-    // setup instance variables
-    sleigh.reset(new ghidra::Sleigh(&loader, &context)); // init unique_ptr
-  }
+    // either DOM is no longer needed once decoded
+    ghidra::DocumentStorage document_storage;
+    std::unique_ptr<ghidra::Document> document;
+    if (packed_spec_detect(path))
+    {
+      document.reset(packed_spec_read(path));
+    }
+    else
+    {
+      document.reset(xml_scan_file(path));
+    }
+    document_storage.registerTag(document->getRoot());
 
-  void begin(void)
-  {
-    // given that we've already setup the spec file, the loaded image,
-    // start the thing frfr
-    sleigh->initialize(document_storage);
+    sleigh.reset(new ghidra::Sleigh(&loader, &context));
+    {
+      SpecArenaScope scope(template_arena);
+      sleigh->initialize(document_storage);
+    }
+    // a `.sla` has no float formats (they come from the processor spec),
+    // without them every float op the emulators run would fault
+    sleigh->setDefaultFloatFormats();
+    template_arena.finish();
+    build_registers();
+    decoder = aot_decoder_install(*sleigh);
   }
 
-  void load_specfile(char path[])
+  /** \brief name of the compiled in decoder resolving it, or null */
+  const char *decoder_name(void) const
   {
-    document = document_storage.openDocument(path);
-    root_node = document->getRoot();
-    document_storage.registerTag(root_node);
+    return decoder != nullptr ? decoder->name : nullptr;
   }
 
-  void reset(void)
+  /**
+   * \brief writes the C++ source of a decoder for it to `out_path`, see
+   * `aot_decoder.hh`. Throws `ghidra::LowlevelError` if the file can't be
+   * written.
+   */
+  void write_decoder(const char *out_path, const char *name) const
   {
-    sleigh.reset(new ghidra::Sleigh(&loader, &context));
-    sleigh->initialize(document_storage);
+    std::ofstream out(out_path);
+    aot_decoder_write(*sleigh, name, out);
+    out.close();
+    if (!out)
+    {
+      throw ghidra::LowlevelError(std::string("Cannot write ") + out_path);
+    }
   }
 
-  void load_data(uint64_t address, uint64_t size, uint8_t *data)
+  /**
+   * \brief builds the register table + the list handed out through the
+   * C API out of it, once per spec instead of once per caller
+   */
+  void build_registers(void)
   {
-    loader.load_region(address, size, data);
+    register_table.build(*sleigh);
+    register_descs.assign(register_table.size(), RegisterDesc());
+    for (uint32_t id = 0; id < register_table.size(); id++)
+    {
+      RegisterDesc &reg = register_descs[id];
+      const ghidra::VarnodeData &vn = register_table.varnode(id);
+
+      strncpy(reg.name, register_table.name(id).c_str(), sizeof(reg.name));
+      reg.varnode.offset = vn.offset;
+      reg.varnode.size = vn.size;
+      strncpy(reg.varnode.space, vn.space->getName().c_str(),
+              sizeof(reg.varnode.space));
+    }
+
+    register_list.register_count = register_descs.size();
+    register_list.registers = register_descs.data();
+    register_list.space_start = register_table.get_space_start();
+    register_list.space_count = register_table.get_offsets().size();
+    register_list.offsets = register_table.get_offsets().data();
+    register_list.direct_base = register_table.get_direct_base();
+    register_list.direct_count = register_table.get_direct().size();
+    register_list.direct = register_table.get_direct().data();
+    register_list.slots = register_table.get_slots().data();
+    register_list.stack_pointer = register_table.get_stack_pointer();
   }
 
-  InsnDesc *to_insn_desc(void)
+  /** \brief counts what the decoded spec holds into `out` */
+  void memory_usage(SpecMemoryUsage *out) const
   {
-    // build the innitial desc from the pcodeemit class
-    InsnDesc *out = new (std::nothrow) InsnDesc;
-    out->op_count = pcode_emitter.pcode_ops.size();
-    out->ops = new (std::nothrow) PcodeOp[out->op_count];
-    memcpy(out->ops, pcode_emitter.pcode_ops.data(),
-           sizeof(PcodeOp) * pcode_emitter.pcode_ops.size());
+    *out = SpecMemoryUsage();
+    out->symbol_count = sleigh->numSymbols();
+    for (ghidra::int4 id = 0; id < sleigh->numSymbols(); id++)
+    {
+      ghidra::SleighSymbol *sym = sleigh->findSymbol(id);
+      out->name_bytes += sym->getName().size();
+      if (sym->getType() != ghidra::SleighSymbol::subtable_symbol)
+      {
+        continue;
+      }
 
-    // now add the details from the asm emit
-    out->size = asm_emitter.insn_size;
-    out->insn = asm_emitter.insn_text;
-    out->insn_len = asm_emitter.insn_text_len;
-    out->body = asm_emitter.insn_body;
-    out->body_len = asm_emitter.insn_body_len;
+      ghidra::SubtableSymbol *table = (ghidra::SubtableSymbol *)sym;
+      for (ghidra::int4 i = 0; i < table->getNumConstructors(); i++)
+      {
+        ghidra::Constructor *ct = table->getConstructor(i);
+        out->constructor_count++;
+        count_templates(ct->getTempl(), out);
+        for (ghidra::int4 section = 0; section < ct->getNumSections();
+             section++)
+        {
+          count_templates(ct->getNamedTempl(section), out);
+        }
+      }
+    }
 
-    return out;
+    out->varnode_template_count = template_arena.varnodes_kept();
+    out->template_bytes = template_arena.bytes_used();
+    out->template_capacity = template_arena.capacity();
+    out->references = refcount;
   }
 
-  InsnDesc *translate_next(void)
+  static void count_templates(const ghidra::ConstructTpl *tpl,
+                              SpecMemoryUsage *out)
   {
-    if (current_translate_address == 0)
+    if (tpl == nullptr)
     {
-      current_translate_address = loader.base();
+      return;
+    }
+    const std::vector<ghidra::OpTpl *> &ops = tpl->getOpvec();
+    out->op_template_count += ops.size();
+    for (const ghidra::OpTpl *op : ops)
+    {
+      out->varnode_template_refs +=
+          op->numInput() + (op->getOut() != nullptr ? 1 : 0);
+    }
+  }
+
+  const RegisterTable &registers(void) const { return register_table; }
+  RegisterList *get_register_list(void) { return &register_list; }
+
+  /**
+   * \brief converts the `.sla` at `in_path` into a packed spec written to
+   * `out_path`, throws the same errors as `ArbitrarySpec::load`
+   */
+  static void pack(const char *in_path, const char *out_path)
+  {
+    std::unique_ptr<ghidra::Document> document(xml_scan_file(in_path));
+    if (document->getRoot()->getName() != "sleigh")
+    {
+      throw ghidra::DecoderError(std::string("Not a sleigh spec: ") + in_path);
+    }
+
+    packed_spec_write(document->getRoot(), out_path);
+  }
+
+  void retain(void) { refcount++; }
+
+  static void release(ArbitrarySpec *spec)
+  {
+    if (--spec->refcount == 0)
+    {
+      delete spec;
+    }
+  }
+
+  /**
+   * \brief creates a new engine lifting out of `image` with `context_db`
+   * that shares this spec, detach it with `ArbitrarySpec::detach`
+   */
+  ghidra::Sleigh *attach(ghidra::LoadImage *image,
+                         ghidra::ContextDatabase *context_db)
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    std::unique_ptr<ghidra::Sleigh> out(new ghidra::Sleigh(image, context_db));
+    out->initializeShared(*sleigh);
+    return out.release();
+  }
+
+  void detach(ghidra::Sleigh *engine)
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    delete engine;
+  }
+};
+
+class ArbitraryManager
+{
+  // the loader + spec are shared with every manager forked from this one,
+  // and are read-only once lifting starts
+  std::shared_ptr<ArbitraryLoader> loader;
+  ArbitrarySpec *spec = nullptr;
+  ArbitraryPcodeEmitter pcode_emitter;
+  ArbitraryAsmEmitter asm_emitter;
+  RangeColumns range_columns;
+  std::string range_text;
+  std::vector<RangeInsnDesc> range_insns;
+  std::vector<InsnEffects> range_effects; // parallel to `range_insns`
+  std::vector<uint8_t> range_insn_relocs; // parallel to `range_insns`
+  // scratch of `move_range_insn`
+  std::vector<uint64_t> moved_offsets;
+  DecodedInsn moved_text;
+  EffectBuilder effect_builder;
+  std::vector<SpaceDesc> space_descs;
+  SpaceList space_list;
+  ghidra::ContextInternal context; // TODO: make impl of this
+  // every default set on `context`, replayed onto forked managers
+  std::vector<std::pair<std::string, uint32_t>> context_defaults;
+  // a context variable painted over `[start, end)`
+  struct ContextRegion
+  {
+    std::string key;
+    uint64_t start;
+    uint64_t end;
+    uint32_t value;
+  };
+  // every region set on `context`, replayed after the defaults
+  std::vector<ContextRegion> context_regions;
+  // `0` keeps the size the spec picks for the parser cache
+  uint32_t parser_cache_size = 0;
+  uint32_t parser_window_size = 0;
+  DecodeCache decode_cache;
+  DecodedInsn decoded_scratch; // decode target while the cache is disabled
+  // every encoding decoded so far, shared by the addresses it repeats at
+  InsnInternTable intern_table;
+  // the interned instruction the last `decode` returned the p-code of, if
+  // it is the same at every address
+  InternedInsn *decoded_entry = nullptr;
+  // the interned instruction whose relocations say how the p-code the last
+  // `decode` returned moves, null if it can't
+  const InternedInsn *decoded_relocs = nullptr;
+  // counts `lift_range` calls, marks the interned instructions already in
+  // the range being lifted
+  uint64_t range_epoch = 0;
+  DecodedInsn disasm_scratch;  // decode target of `disasm`
+  // skip the assembly text when decoding, `disasm` renders it on demand
+  bool pcode_only = false;
+  // `lift_range` decodes at every aligned offset instead of stepping over
+  // each instruction
+  bool all_offsets = false;
+  // run the p-code of every decoded instruction through `simplifier`
+  bool simplify = false;
+  // built over `sleigh` by `begin` while `simplify` is on
+  std::unique_ptr<PcodeSimplifier> simplifier;
+  DecodedInsn simplified_scratch; // simplified copy of an interned body
+  // backs the disassembly text of the instruction being decoded, reset
+  // before each one
+  LiftArena lift_arena;
+  // counted into by `sleigh` and `decode`, see `lift_stats.hh`
+  LiftStats stats = {};
+  // `allocation_stats` when `stats` was last reset
+  uint64_t allocation_base_count = 0;
+  uint64_t allocation_base_bytes = 0;
+  // counted into by `sleigh` while set, see `decode_profile.hh`
+  std::unique_ptr<DecodeProfile> decode_profile;
+  std::string decode_report; // the last `decode_profile_report`
+  // attached to `spec` by `begin`
+  ghidra::Sleigh *sleigh = nullptr;
+  // built over `sleigh` by the first `emulator()` call, never forked
+  std::unique_ptr<SnapshotEmulator> emulate_state;
+  // built by `emulate_lanes`, never forked
+  std::unique_ptr<LaneEmulator> lane_state;
+  uint64_t current_translate_address = 0;
+
+public:
+  ArbitraryManager(void) : loader(new ArbitraryLoader)
+  {
+    // initialize ghidra globals
+    initialize_globals();
+    reset_stats();
+    intern_table.set_capacity(DEFAULT_INSN_INTERN);
+  }
+
+  /**
+   * \brief creates a manager that shares the loaded regions and decoded
+   * spec of `parent`, but owns its own `Sleigh`, context and emitters so it
+   * can lift on a different thread than `parent`.
+   *
+   * `parent` must have already called `begin`, and no more regions should
+   * be loaded into either manager once they are shared.
+   */
+  explicit ArbitraryManager(const ArbitraryManager &parent)
+      : loader(parent.loader), context_defaults(parent.context_defaults),
+        context_regions(parent.context_regions),
+        parser_cache_size(parent.parser_cache_size),
+        parser_window_size(parent.parser_window_size),
+        pcode_only(parent.pcode_only), all_offsets(parent.all_offsets),
+        simplify(parent.simplify)
+  {
+    reset_stats();
+    if (parent.decode_profile != nullptr)
+    {
+      decode_profile.reset(new DecodeProfile);
+    }
+    decode_cache.set_capacity(parent.decode_cache.get_capacity());
+    intern_table.set_capacity(parent.intern_table.get_capacity());
+    if (parent.spec == nullptr)
+    {
+      throw ghidra::LowlevelError("Cannot fork a manager without a spec");
+    }
+    use_spec(parent.spec);
+    begin();
+    rebuild_context();
+  }
+
+  ~ArbitraryManager(void)
+  {
+    emulate_state.reset();
+    lane_state.reset();
+    if (sleigh != nullptr)
+    {
+      spec->detach(sleigh);
+    }
+    if (spec != nullptr)
+    {
+      ArbitrarySpec::release(spec);
+    }
+  }
+
+  void begin(void)
+  {
+    // given that we've already setup the spec file, the loaded image,
+    // start the thing frfr
+    sleigh = spec->attach(loader.get(), &context);
+    loader->set_space(sleigh->getDefaultCodeSpace());
+    sleigh->setArena(&lift_arena);
+    sleigh->setStats(&stats);
+    sleigh->setProfile(decode_profile.get());
+    if (parser_cache_size != 0 || parser_window_size != 0)
+    {
+      sleigh->setDisassemblyCacheSize(parser_cache_size, parser_window_size);
+    }
+    simplifier.reset(simplify ? new PcodeSimplifier(sleigh) : nullptr);
+    effect_builder.reset(&spec->registers());
+    // the spec is done setting up the context, from here on it is mostly
+    // looked up
+    context.freeze();
+  }
+
+  void load_specfile(char path[])
+  {
+    std::unique_ptr<ArbitrarySpec> loaded(new ArbitrarySpec);
+    loaded->load(path);
+    use_spec(loaded.get());
+    ArbitrarySpec::release(loaded.release());
+  }
+
+  /**
+   * \brief lift with the already decoded `new_spec` instead of loading a
+   * specfile, must be called before `begin`
+   */
+  void use_spec(ArbitrarySpec *new_spec)
+  {
+    new_spec->retain();
+    if (spec != nullptr)
+    {
+      ArbitrarySpec::release(spec);
+    }
+    spec = new_spec;
+  }
+
+  void reset(void)
+  {
+    emulate_state.reset();
+    lane_state.reset();
+    spec->detach(sleigh);
+    sleigh = nullptr;
+    begin();
+    space_descs.clear();
+    decode_cache.clear();
+    clear_intern();
+  }
+
+  void load_data(uint64_t address, uint64_t size, uint8_t *data,
+                 uint32_t flags = 0)
+  {
+    loader->load_region(address, size, data, flags);
+    flush_loaded();
+  }
+
+  void load_data(uint64_t address, const std::shared_ptr<ZstdImage> &image)
+  {
+    loader->load_region(address, image);
+    flush_loaded();
+  }
+
+  /**
+   * \brief overwrites `size` bytes at `address` with `bytes`, see
+   * `ArbitraryLoader::patch_region`. Only the decodes that read a patched
+   * byte are dropped, everything else is still cached for the next lift.
+   *
+   * The loader is shared with every fork of (and the parent of) this
+   * manager, which may be lifting out of it on other threads and keep
+   * decodes of the old bytes in caches of their own. So nothing is patched
+   * while any of them is still around, returns false then. Also returns
+   * false if the end of the patch doesn't fit in 64 bits.
+   */
+  bool patch_data(uint64_t address, uint64_t size, const uint8_t *bytes)
+  {
+    if (size > UINT64_MAX - address || loader.use_count() > 1)
+    {
+      return false;
+    }
+
+    loader->patch_region(address, size, bytes);
+    decode_cache.invalidate(address, address + size);
+    if (sleigh != nullptr)
+    {
+      sleigh->invalidateBytes(
+          ghidra::Address(sleigh->getDefaultCodeSpace(), address), size);
+    }
+    // interned instructions are keyed by their bytes, so the patched ones
+    // simply stop matching. The emulators are cheap to refill.
+    if (emulate_state != nullptr)
+    {
+      emulate_state->flush_code();
+    }
+    if (lane_state != nullptr)
+    {
+      lane_state->flush_code();
+    }
+    return true;
+  }
+
+  // everything decoded out of the old image is stale
+  void flush_loaded(void)
+  {
+    decode_cache.clear();
+    clear_intern();
+    if (emulate_state != nullptr)
+    {
+      emulate_state->flush_code();
+    }
+    if (lane_state != nullptr)
+    {
+      lane_state->flush_code();
+    }
+  }
+
+  InsnDesc *to_insn_desc(void)
+  {
+    // build the innitial desc from the pcodeemit class
+    InsnDesc *out = new (std::nothrow) InsnDesc;
+    out->op_count = pcode_emitter.pcode_ops.size();
+    out->ops = new (std::nothrow) PcodeOp[out->op_count];
+    memcpy(out->ops, pcode_emitter.pcode_ops.data(),
+           sizeof(PcodeOp) * pcode_emitter.pcode_ops.size());
+
+    // now add the details from the asm emit
+    out->size = asm_emitter.insn_size;
+    out->insn = asm_emitter.insn_text;
+    out->insn_len = asm_emitter.insn_text_len;
+    out->body = asm_emitter.insn_body;
+    out->body_len = asm_emitter.insn_body_len;
+
+    return out;
+  }
+
+  InsnDesc *translate_next(void)
+  {
+    if (current_translate_address == 0)
+    {
+      current_translate_address = loader->base();
     }
     ghidra::Address address(sleigh->getDefaultCodeSpace(),
                             current_translate_address);
     // setup the asm for the insn
+    lift_arena.reset();
     sleigh->printAssembly(asm_emitter, address);
     int32_t insn_length = sleigh->oneInstruction(pcode_emitter, address);
 
@@ -404,206 +1386,2249 @@ public:
     pcode_emitter.pcode_ops.clear();
     asm_emitter.clear();
 
-    // return our populated struct
-    return out;
+    // return our populated struct
+    return out;
+  }
+
+  /** \brief `out` is left null when nothing decodes at `addr` */
+  LibSlaError lift_insn(uint64_t addr, InsnDesc **out)
+  {
+    *out = nullptr;
+    const DecodedInsn &decoded = decode(addr);
+    if (decoded.size == 0)
+    {
+      return LibSlaError::Ok;
+    }
+
+    return to_insn_desc(decoded, addr, out);
+  }
+
+  /**
+   * \brief decodes the instruction at `addr`, out of the decode cache if it
+   * is enabled. The result is only valid until the next `decode`.
+   */
+  const DecodedInsn &decode(uint64_t addr)
+  {
+    ghidra::Address address(sleigh->getDefaultCodeSpace(), addr);
+    int parts = pcode_only ? DecodePcode : DecodeAll;
+    lift_arena.reset();
+    decoded_entry = nullptr;
+    decoded_relocs = nullptr;
+    if (decode_cache.get_capacity() == 0)
+    {
+      return simplified(decode_interned(address, parts, decoded_scratch),
+                        decoded_scratch);
+    }
+
+    // a hit still shares the rows + relocations of its interned encoding
+    const CachedInsn *hit = decode_cache.find(addr);
+    if (hit != nullptr)
+    {
+      LIFT_STATS_ADD(&stats, decode_cache_hits, 1);
+      decoded_entry = hit->entry;
+      decoded_relocs = hit->relocs;
+      return hit->insn;
+    }
+
+    LIFT_STATS_ADD(&stats, decode_cache_misses, 1);
+    CachedInsn &slot = decode_cache.insert(addr);
+    const DecodedInsn &decoded = decode_interned(address, parts, slot.insn);
+    if (&decoded != &slot.insn)
+    {
+      slot.insn = decoded;
+    }
+    slot.entry = decoded_entry;
+    slot.relocs = decoded_relocs;
+    return simplified(slot.insn, slot.insn);
+  }
+
+  /**
+   * \brief `decoded` with its p-code simplified if that is enabled, in
+   * `scratch` unless `decoded` already is `scratch`. Interned bodies are
+   * never touched, the next repeat still needs them as SLEIGH emitted them.
+   */
+  const DecodedInsn &simplified(const DecodedInsn &decoded,
+                                DecodedInsn &scratch)
+  {
+    if (simplifier == nullptr || decoded.size == 0)
+    {
+      return decoded;
+    }
+    if (&decoded == &scratch)
+    {
+      simplifier->simplify(scratch);
+      return scratch;
+    }
+    simplified_scratch = decoded;
+    simplifier->simplify(simplified_scratch);
+    return simplified_scratch;
+  }
+
+  /**
+   * \brief decodes the instruction at `address` out of the intern table,
+   * into `scratch` unless its interned body can be used as is
+   */
+  const DecodedInsn &decode_interned(const ghidra::Address &address,
+                                     int parts, DecodedInsn &scratch)
+  {
+    const DecodedInsn &decoded = intern_table.decode(
+        *sleigh, address, parts, scratch, &decoded_entry);
+    // simplified p-code no longer lines up with the interned varnodes
+    decoded_relocs = simplifier == nullptr ? intern_table.last_shared : nullptr;
+    if (decoded.size == 0)
+    {
+      LIFT_STATS_ADD(&stats, decode_errors, 1);
+    }
+    return decoded;
+  }
+
+  /**
+   * \brief interns up to `capacity` distinct encodings, so each of them is
+   * only decoded once however often it repeats. 0 disables the table.
+   */
+  void set_insn_intern(uint64_t capacity)
+  {
+    intern_table.set_capacity(capacity);
+    // the cached decodes may point at the entries it dropped
+    decode_cache.clear();
+  }
+
+  void clear_intern(void)
+  {
+    intern_table.clear();
+    decoded_entry = nullptr;
+  }
+
+  /**
+   * \brief renders the assembly of the instruction at `addr` into `out`,
+   * valid until the next `disasm`. Returns false if it doesn't decode.
+   */
+  bool disasm(uint64_t addr, DisasmText *out)
+  {
+    ghidra::Address address(sleigh->getDefaultCodeSpace(), addr);
+    lift_arena.reset();
+    if (!decode_insn(*sleigh, address, disasm_scratch, DecodeText))
+    {
+      return false;
+    }
+
+    const std::string &text = disasm_scratch.text;
+    out->size = disasm_scratch.size;
+    out->insn = text.data();
+    out->insn_len = disasm_scratch.mnemonic_len;
+    out->body = text.data() + disasm_scratch.mnemonic_len;
+    out->body_len = text.size() - disasm_scratch.mnemonic_len;
+    return true;
+  }
+
+  /**
+   * \brief decodes p-code only (empty text) when `enable`d, which skips
+   * `printAssembly` for every instruction. Cached instructions are
+   * dropped whenever it changes.
+   */
+  void set_pcode_only(bool enable)
+  {
+    if (enable != pcode_only)
+    {
+      decode_cache.clear();
+      clear_intern();
+    }
+    pcode_only = enable;
+  }
+
+  /**
+   * \brief makes `lift_range` decode an instruction at every aligned offset
+   * when `enable`d, including the ones inside of other instructions. Each
+   * offset is still decoded once, and the rows of overlapping instructions
+   * are shared like any other repeated encoding.
+   */
+  void set_all_offsets(bool enable) { all_offsets = enable; }
+
+  /**
+   * \brief runs the p-code of every decoded instruction through a
+   * `PcodeSimplifier` when `enable`d. Cached instructions are dropped
+   * whenever it changes.
+   */
+  void set_simplify(bool enable)
+  {
+    if (enable != simplify)
+    {
+      decode_cache.clear();
+    }
+    simplify = enable;
+    simplifier.reset(simplify && sleigh != nullptr ? new PcodeSimplifier(sleigh)
+                                                   : nullptr);
+  }
+
+  /** \brief instruction alignment of the spec, in bytes */
+  uint64_t get_alignment(void) const { return sleigh->getAlignment(); }
+
+  /** \brief see `ArbitrarySpec::decoder_name` */
+  const char *decoder_name(void) const
+  {
+    return spec != nullptr ? spec->decoder_name() : nullptr;
+  }
+
+  /** \brief counts what the spec holds, false if there is none yet */
+  bool spec_memory_usage(SpecMemoryUsage *out) const
+  {
+    if (spec == nullptr)
+    {
+      return false;
+    }
+    spec->memory_usage(out);
+    return true;
+  }
+
+  /**
+   * \brief decodes only the length + flow of the instruction at `addr`,
+   * without any p-code or text. Returns false if it doesn't decode.
+   */
+  bool insn_flow(uint64_t addr, InsnFlow *out)
+  {
+    ghidra::Address address(sleigh->getDefaultCodeSpace(), addr);
+    ghidra::uint4 flow = 0;
+    ghidra::int4 size = 0;
+    try
+    {
+      size = sleigh->tryInstructionFlow(address, flow);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      size = 0;
+    }
+
+    out->address = addr;
+    out->size = size;
+    out->flow = size != 0 ? flow : 0;
+    return size != 0;
+  }
+
+  /**
+   * \brief decodes the basic block at `addr` into `out`: every instruction
+   * up to the first one whose p-code branches out of it, calls or returns.
+   * The block also ends before bytes that don't decode, and at `end` like
+   * `lift_range`. Its constant branch + call targets and the fall through
+   * past its end go into `edges`, at most `capacity` of them.
+   */
+  void block_flow(uint64_t addr, uint64_t end, BlockEdge *edges,
+                  uint64_t capacity, BlockFlow *out)
+  {
+    memset(out, 0, sizeof(BlockFlow));
+    out->start = addr;
+    out->end = addr;
+    bool falls_through = true;
+    auto add_edge = [&](uint64_t target, uint32_t kind)
+    {
+      if (out->edge_count < capacity)
+      {
+        edges[out->edge_count] = BlockEdge{target, kind, 0};
+      }
+      out->edge_count++;
+    };
+
+    while (out->end < end && out->flow == 0)
+    {
+      const DecodedInsn &decoded = decode(out->end);
+      if (decoded.size == 0)
+      {
+        out->flow = ghidra::Sleigh::flow_unimplemented;
+        falls_through = false;
+        break;
+      }
+
+      // branches between the ops of the instruction itself are relative
+      // constants, they only make the instruction fall through. So does a
+      // conditional branch to the next instruction (how ARM skips one), it
+      // doesn't end the block
+      uint64_t next = out->end + decoded.size;
+      bool conditional = false;
+      bool leaves = false;
+      for (const DecodedOp &op : decoded.ops)
+      {
+        const ghidra::VarnodeData *dest =
+            op.input_len != 0 ? &decoded.varnodes[op.input_start] : nullptr;
+        bool relative = dest == nullptr ||
+                        dest->space->getType() == ghidra::IPTR_CONSTANT;
+        leaves = false;
+        switch (op.opcode)
+        {
+        case ghidra::CPUI_CBRANCH:
+          conditional = true;
+          if (!relative && dest->offset != next)
+          {
+            out->flow |= ghidra::Sleigh::flow_branch |
+                         ghidra::Sleigh::flow_conditional;
+            add_edge(dest->offset, BlockEdgeBranch);
+          }
+          break;
+        case ghidra::CPUI_BRANCH:
+          if (!relative)
+          {
+            out->flow |= ghidra::Sleigh::flow_branch;
+            add_edge(dest->offset, BlockEdgeBranch);
+            leaves = true;
+          }
+          break;
+        case ghidra::CPUI_CALL:
+          out->flow |= ghidra::Sleigh::flow_call;
+          if (!relative)
+          {
+            add_edge(dest->offset, BlockEdgeCall);
+          }
+          break;
+        case ghidra::CPUI_BRANCHIND:
+          out->flow |= ghidra::Sleigh::flow_branchind;
+          leaves = true;
+          break;
+        case ghidra::CPUI_CALLIND:
+          out->flow |= ghidra::Sleigh::flow_callind;
+          break;
+        case ghidra::CPUI_RETURN:
+          out->flow |= ghidra::Sleigh::flow_return;
+          leaves = true;
+          break;
+        default:
+          break;
+        }
+      }
+
+      // calls come back, an instruction whose last op leaves doesn't
+      falls_through = conditional || !leaves;
+      out->end = next;
+      out->insn_count++;
+    }
+
+    if (falls_through && out->insn_count != 0)
+    {
+      add_edge(out->end, BlockEdgeFallthrough);
+    }
+  }
+
+  /**
+   * \brief `insn_flow` of every instruction in `[start, end)`, at most
+   * `capacity` of them. Steps through the code exactly like `lift_range`:
+   * undecodable and unimplemented instructions are skipped by the
+   * instruction alignment. Returns where to pick back up.
+   */
+  uint64_t flow_range(uint64_t start, uint64_t end, InsnFlow *out,
+                      uint64_t capacity, uint64_t *count)
+  {
+    uint64_t alignment = sleigh->getAlignment();
+    uint64_t addr = start;
+    *count = 0;
+    while (addr < end && *count < capacity)
+    {
+      InsnFlow &insn = out[*count];
+      if (!insn_flow(addr, &insn) ||
+          (insn.flow & ghidra::Sleigh::flow_unimplemented) != 0)
+      {
+        addr += alignment;
+        continue;
+      }
+
+      addr += insn.size;
+      *count += 1;
+    }
+    return addr;
+  }
+
+  /**
+   * \brief copies what was counted since the last `reset_stats` into `out`,
+   * see `lift_stats.hh`
+   */
+  void get_stats(LiftStats *out)
+  {
+    *out = stats;
+#ifdef LIBSLA_STATS
+    out->enabled = 1;
+    out->intern_hits = intern_table.hits;
+    out->intern_misses = intern_table.misses;
+#endif
+    uint64_t count, bytes;
+    if (allocation_stats(&count, &bytes))
+    {
+      out->allocation_count = count - allocation_base_count;
+      out->allocation_bytes = bytes - allocation_base_bytes;
+    }
+  }
+
+  void reset_stats(void)
+  {
+    stats = LiftStats();
+    intern_table.hits = 0;
+    intern_table.misses = 0;
+    allocation_stats(&allocation_base_count, &allocation_base_bytes);
+  }
+
+  /**
+   * \brief starts profiling every decode into an empty profile, or stops
+   * and drops it. Returns false unless built with `-DLIBSLA_STATS`.
+   */
+  bool set_decode_profile(bool enable)
+  {
+#ifdef LIBSLA_STATS
+    decode_profile.reset(enable ? new DecodeProfile : nullptr);
+    if (sleigh != nullptr)
+    {
+      sleigh->setProfile(decode_profile.get());
+    }
+    return true;
+#else
+    return !enable;
+#endif
+  }
+
+  /** \brief adds the profile of `other`, which must share the spec */
+  bool merge_decode_profile(const ArbitraryManager &other)
+  {
+    if (decode_profile == nullptr || other.decode_profile == nullptr ||
+        spec != other.spec)
+    {
+      return false;
+    }
+    decode_profile->merge(*other.decode_profile);
+    return true;
+  }
+
+  /** \brief renders the profile, null if there is none */
+  const char *decode_profile_report(void)
+  {
+    if (decode_profile == nullptr || sleigh == nullptr)
+    {
+      return nullptr;
+    }
+    decode_report = decode_profile->report(*sleigh);
+    return decode_report.c_str();
+  }
+
+  /**
+   * \brief copies `decoded` into a caller owned `InsnDesc`, `Fail` with
+   * nothing allocated when out of memory
+   */
+  LibSlaError to_insn_desc(const DecodedInsn &decoded, uint64_t addr,
+                           InsnDesc **result)
+  {
+    std::string mnemonic = decoded.text.substr(0, decoded.mnemonic_len);
+    std::string body = decoded.text.substr(decoded.mnemonic_len);
+
+    // the ops reference the varnodes by index, so they are all converted
+    // into one block in order and the ops point into it
+    InsnDesc *out = new (std::nothrow) InsnDesc;
+    PcodeOp *ops = new (std::nothrow) PcodeOp[decoded.ops.size()];
+    VarnodeDesc *descs = new (std::nothrow) VarnodeDesc[decoded.varnodes.size()];
+    char *insn = strdup(mnemonic.c_str());
+    char *operands = strdup(body.c_str());
+    if (out == nullptr || ops == nullptr || descs == nullptr ||
+        insn == nullptr || operands == nullptr)
+    {
+      delete out;
+      delete[] ops;
+      delete[] descs;
+      free(insn);
+      free(operands);
+      return LibSlaError::Fail;
+    }
+
+    out->op_count = decoded.ops.size();
+    out->ops = ops;
+    for (size_t i = 0; i < decoded.varnodes.size(); i++)
+    {
+      to_varnode_desc(decoded.varnodes[i], &descs[i]);
+    }
+    for (size_t i = 0; i < decoded.ops.size(); i++)
+    {
+      const DecodedOp &src = decoded.ops[i];
+      PcodeOp &op = out->ops[i];
+      op.opcode = src.opcode;
+      op.input_len = src.input_len;
+      op.inputVarnodes = descs + src.input_start;
+      op.output = nullptr;
+      if (src.output != DECODED_NO_OUTPUT)
+      {
+        op.output = descs + src.output;
+      }
+    }
+
+    out->size = decoded.size;
+    out->address = addr;
+    out->insn = insn;
+    out->insn_len = mnemonic.size();
+    out->body = operands;
+    out->body_len = body.size();
+
+    *result = out;
+    return LibSlaError::Ok;
+  }
+
+  /**
+   * \brief keeps up to `capacity` decoded instructions around for repeated
+   * lifts of the same addresses, 0 disables the cache
+   */
+  void set_decode_cache(uint64_t capacity)
+  {
+    decode_cache.set_capacity(capacity);
+  }
+
+  /**
+   * \brief sizes the parser cache of SLEIGH to `cache_size` parse trees
+   * hashed into a `window_size` table (a power of 2), 0 keeps the default
+   * of the spec, which is also the minimum of each
+   */
+  void set_parser_cache(uint32_t cache_size, uint32_t window_size)
+  {
+    // checked up front, `begin` reapplies the sizes and must not throw
+    if ((window_size & (window_size - 1)) != 0)
+    {
+      throw ghidra::LowlevelError("Parser cache window must be a power of 2");
+    }
+    if (sleigh != nullptr)
+    {
+      sleigh->setDisassemblyCacheSize(cache_size, window_size);
+    }
+    parser_cache_size = cache_size;
+    parser_window_size = window_size;
+  }
+
+  /**
+   * \brief lifts every instruction in `[start, end)` into a single arena
+   * owned by `out`. Undecodable addresses are skipped by the instruction
+   * alignment of the spec, or at every aligned address with
+   * `set_all_offsets`. Stops early if the varnodes would no longer fit
+   * the op columns, `out->end_address` is where to pick back up.
+   */
+  void lift_range(uint64_t start, uint64_t end, LiftedRange *out)
+  {
+    begin_range();
+
+    uint64_t alignment = sleigh->getAlignment();
+    uint64_t addr = start;
+    while (addr < end && range_columns.varnode_count() < RANGE_MAX_VARNODES)
+    {
+      const DecodedInsn &decoded = decode(addr);
+      if (decoded.size == 0)
+      {
+        addr += alignment;
+        continue;
+      }
+
+      emit_range_insn(addr, decoded);
+      addr += all_offsets ? alignment : decoded.size;
+    }
+
+    pack_range(out, addr);
+  }
+
+  /**
+   * \brief the range `in` that was lifted at `from`, as if it was lifted
+   * out of the same bytes loaded at `to` instead. Instructions that don't
+   * move with their bytes (`RangeInsnPinned`, or an address that wraps
+   * differently at `to`) are decoded again, everything else is copied with
+   * its relocated varnodes moved and its context changes committed at `to`.
+   */
+  void relocate_range(const LiftedRange &in, uint64_t from, uint64_t to,
+                      LiftedRange *out)
+  {
+    begin_range();
+
+    const RangeInsnDesc *insns =
+        (const RangeInsnDesc *)(in.arena + in.insns_offset);
+    const uint8_t *insn_relocs = in.arena + in.insn_relocs_offset;
+    uint64_t delta = to - from;
+    // rows + text of `in` already copied without relocations, by their
+    // position in `in`
+    std::unordered_map<uint64_t, uint64_t> moved_rows;
+    std::unordered_map<uint64_t, uint64_t> moved_texts;
+    for (uint64_t i = 0; i < in.insn_count; i++)
+    {
+      uint64_t addr = insns[i].address + delta;
+      if (range_columns.varnode_count() >= RANGE_MAX_VARNODES)
+      {
+        pack_range(out, addr);
+        return;
+      }
+      if (insn_relocs[i] != RangeInsnPinned &&
+          move_range_insn(in, i, addr, moved_rows, moved_texts))
+      {
+        continue;
+      }
+
+      const DecodedInsn &decoded = decode(addr);
+      if (decoded.size != 0)
+      {
+        emit_range_insn(addr, decoded);
+      }
+    }
+
+    pack_range(out, in.end_address + delta);
+  }
+
+  /** \brief empties the tables of the range being lifted */
+  void begin_range(void)
+  {
+    range_insns.clear();
+    range_effects.clear();
+    range_insn_relocs.clear();
+    range_columns.clear();
+    range_text.clear();
+    range_epoch++;
+    // context changes committed by the last lift thawed it
+    context.freeze();
+  }
+
+  /** \brief appends `decoded` at `addr` to the range being lifted */
+  void emit_range_insn(uint64_t addr, const DecodedInsn &decoded)
+  {
+    range_insns.emplace_back();
+    range_effects.emplace_back();
+    RangeInsnDesc &insn = range_insns.back();
+    insn.address = addr;
+    insn.size = decoded.size;
+    insn.op_count = decoded.ops.size();
+    insn.insn_len = decoded.mnemonic_len;
+    insn.body_len = decoded.text.size() - decoded.mnemonic_len;
+
+    const InternedInsn *relocs = decoded_relocs;
+    range_insn_relocs.push_back(
+        relocs == nullptr    ? RangeInsnPinned
+        : relocs->shared_text ? RangeInsnMoves
+                              : RangeInsnRetext);
+
+    // repeats of an interned encoding point at the rows of the first one
+    InternedInsn *shared = decoded_entry;
+    bool seen = shared != nullptr && shared->range_epoch == range_epoch;
+    if (seen)
+    {
+      insn.op_start = shared->range_op_start;
+      range_effects.back() = range_effects[shared->range_insn];
+    }
+    else
+    {
+      insn.op_start = range_columns.op_count();
+      uint64_t base = range_columns.varnode_count();
+      range_columns.append(decoded, spec->registers());
+      effect_builder.build(decoded, range_effects.back());
+      for (size_t i = 0; relocs != nullptr && i < relocs->relocs.size(); i++)
+      {
+        const InternReloc &reloc = relocs->relocs[i];
+        range_columns.relocs[base + reloc.varnode] = reloc.kind + 1;
+      }
+    }
+    if (seen && shared->shared_text)
+    {
+      insn.insn_offset = shared->range_text_offset;
+    }
+    else
+    {
+      insn.insn_offset = range_text.size();
+      range_text.append(decoded.text);
+    }
+    insn.body_offset = insn.insn_offset + decoded.mnemonic_len;
+    if (shared != nullptr && !seen)
+    {
+      shared->range_epoch = range_epoch;
+      shared->range_op_start = insn.op_start;
+      shared->range_insn = range_insns.size() - 1;
+      shared->range_text_offset = insn.insn_offset;
+    }
+  }
+
+  /**
+   * \brief appends instruction `idx` of `in` moved to `addr` to the range
+   * being lifted, false (appending nothing) if it has to be decoded there
+   * instead. Rows + text without anything to move are shared through
+   * `moved_rows` + `moved_texts` like the repeats in `in` shared them. The
+   * context changes of the instruction are committed at `addr` as a decode
+   * there would.
+   */
+  bool move_range_insn(const LiftedRange &in, uint64_t idx, uint64_t addr,
+                       std::unordered_map<uint64_t, uint64_t> &moved_rows,
+                       std::unordered_map<uint64_t, uint64_t> &moved_texts)
+  {
+    const RangeInsnDesc &src =
+        ((const RangeInsnDesc *)(in.arena + in.insns_offset))[idx];
+    const uint32_t *outputs = (const uint32_t *)(in.arena + in.op_outputs_offset);
+    const uint32_t *input_starts =
+        (const uint32_t *)(in.arena + in.op_input_starts_offset);
+    const uint32_t *input_lens =
+        (const uint32_t *)(in.arena + in.op_input_lens_offset);
+    const uint64_t *offsets = (const uint64_t *)(in.arena + in.vn_offsets_offset);
+    const uint32_t *sizes = (const uint32_t *)(in.arena + in.vn_sizes_offset);
+    const uint32_t *spaces = (const uint32_t *)(in.arena + in.vn_spaces_offset);
+    const uint8_t *vn_relocs = in.arena + in.vn_relocs_offset;
+    uint8_t kind = in.arena[in.insn_relocs_offset + idx];
+
+    // the varnodes of an instruction are one block of rows its ops point into
+    uint64_t first = UINT64_MAX;
+    uint64_t last = 0;
+    for (uint64_t op = src.op_start; op < src.op_start + src.op_count; op++)
+    {
+      if (outputs[op] != RANGE_NO_OUTPUT)
+      {
+        first = std::min<uint64_t>(first, outputs[op]);
+        last = std::max<uint64_t>(last, outputs[op] + 1);
+      }
+      if (input_lens[op] != 0)
+      {
+        first = std::min<uint64_t>(first, input_starts[op]);
+        last = std::max<uint64_t>(last, input_starts[op] + input_lens[op]);
+      }
+    }
+    if (first > last)
+    {
+      first = last;
+    }
+
+    moved_offsets.assign(offsets + first, offsets + last);
+    bool moves = false;
+    for (uint64_t vn = first; vn < last; vn++)
+    {
+      if (vn_relocs[vn] == 0)
+      {
+        continue;
+      }
+      ghidra::VarnodeData data;
+      data.space = sleigh->getSpace(spaces[vn]);
+      data.offset = offsets[vn];
+      data.size = sizes[vn];
+      if (!relocate_varnode(*sleigh, vn_relocs[vn] - 1, src.address, addr,
+                            src.size, data))
+      {
+        return false;
+      }
+      moved_offsets[vn - first] = data.offset;
+      moves = true;
+    }
+
+    moved_text.clear();
+    if (kind == RangeInsnRetext && !pcode_only)
+    {
+      lift_arena.reset();
+      ghidra::Address address(sleigh->getDefaultCodeSpace(), addr);
+      if (!decode_insn(*sleigh, address, moved_text, DecodeText))
+      {
+        return false;
+      }
+    }
+
+    // its globalset changes are the ones decoding it here would commit
+    try
+    {
+      sleigh->commitInstructionContext(
+          ghidra::Address(sleigh->getDefaultCodeSpace(), addr));
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return false;
+    }
+
+    range_insns.push_back(src);
+    range_effects.push_back(
+        ((const InsnEffects *)(in.arena + in.effects_offset))[idx]);
+    range_insn_relocs.push_back(kind);
+    RangeInsnDesc &insn = range_insns.back();
+    insn.address = addr;
+
+    // an instruction without ops (or text) starts where the next one does,
+    // so only non-empty ones are shared
+    bool share_rows = !moves && src.op_count != 0;
+    std::unordered_map<uint64_t, uint64_t>::iterator row =
+        moved_rows.find(src.op_start);
+    if (share_rows && row != moved_rows.end())
+    {
+      insn.op_start = row->second;
+    }
+    else
+    {
+      insn.op_start = range_columns.op_count();
+      append_moved_rows(in, src, first, last);
+      if (share_rows)
+      {
+        moved_rows[src.op_start] = insn.op_start;
+      }
+    }
+
+    if (kind == RangeInsnRetext)
+    {
+      insn.insn_offset = range_text.size();
+      insn.insn_len = moved_text.mnemonic_len;
+      insn.body_len = moved_text.text.size() - moved_text.mnemonic_len;
+      range_text.append(moved_text.text);
+    }
+    else
+    {
+      uint64_t text_len = src.insn_len + src.body_len;
+      std::unordered_map<uint64_t, uint64_t>::iterator text =
+          moved_texts.find(src.insn_offset);
+      if (text_len != 0 && text != moved_texts.end())
+      {
+        insn.insn_offset = text->second;
+      }
+      else
+      {
+        insn.insn_offset = range_text.size();
+        if (text_len != 0)
+        {
+          moved_texts[src.insn_offset] = insn.insn_offset;
+        }
+        range_text.append((const char *)(in.arena + in.text_offset) +
+                              src.insn_offset,
+                          text_len);
+      }
+    }
+    insn.body_offset = insn.insn_offset + insn.insn_len;
+    return true;
+  }
+
+  /**
+   * \brief appends the op rows of `src` and its varnode rows
+   * `[first, last)` of `in`, with the offsets in `moved_offsets`
+   */
+  void append_moved_rows(const LiftedRange &in, const RangeInsnDesc &src,
+                         uint64_t first, uint64_t last)
+  {
+    RangeColumns &pcode = range_columns;
+    const uint32_t *opcodes = (const uint32_t *)(in.arena + in.op_opcodes_offset);
+    const uint32_t *outputs = (const uint32_t *)(in.arena + in.op_outputs_offset);
+    const uint32_t *input_starts =
+        (const uint32_t *)(in.arena + in.op_input_starts_offset);
+    const uint32_t *input_lens =
+        (const uint32_t *)(in.arena + in.op_input_lens_offset);
+    const uint32_t *sizes = (const uint32_t *)(in.arena + in.vn_sizes_offset);
+    const uint32_t *spaces = (const uint32_t *)(in.arena + in.vn_spaces_offset);
+    const uint32_t *registers =
+        (const uint32_t *)(in.arena + in.vn_registers_offset);
+    const uint8_t *vn_relocs = in.arena + in.vn_relocs_offset;
+
+    uint32_t base = pcode.varnode_count();
+    for (uint64_t op = src.op_start; op < src.op_start + src.op_count; op++)
+    {
+      pcode.opcodes.push_back(opcodes[op]);
+      pcode.outputs.push_back(outputs[op] == RANGE_NO_OUTPUT
+                                  ? RANGE_NO_OUTPUT
+                                  : base + (outputs[op] - first));
+      pcode.input_starts.push_back(base + (input_starts[op] - first));
+      pcode.input_lens.push_back(input_lens[op]);
+    }
+    pcode.offsets.insert(pcode.offsets.end(), moved_offsets.begin(),
+                         moved_offsets.end());
+    pcode.sizes.insert(pcode.sizes.end(), sizes + first, sizes + last);
+    pcode.spaces.insert(pcode.spaces.end(), spaces + first, spaces + last);
+    pcode.registers.insert(pcode.registers.end(), registers + first,
+                           registers + last);
+    pcode.relocs.insert(pcode.relocs.end(), vn_relocs + first,
+                        vn_relocs + last);
+  }
+
+  /**
+   * \brief copies the range tables + columns into one allocation, each is
+   * aligned to 8 bytes inside of the arena
+   */
+  void pack_range(LiftedRange *out, uint64_t end_address)
+  {
+    RangeColumns &pcode = range_columns;
+    std::string &text = range_text;
+
+    uint64_t ops = pcode.op_count();
+    uint64_t varnodes = pcode.varnode_count();
+    uint64_t op_column = align_column(sizeof(uint32_t) * ops);
+    uint64_t vn_column = align_column(sizeof(uint32_t) * varnodes);
+
+    out->end_address = end_address;
+    out->insn_count = range_insns.size();
+    out->insns_offset = 0;
+    out->op_count = ops;
+    out->effects_offset =
+        out->insns_offset + sizeof(RangeInsnDesc) * range_insns.size();
+    out->op_opcodes_offset =
+        out->effects_offset + sizeof(InsnEffects) * range_effects.size();
+    out->op_outputs_offset = out->op_opcodes_offset + op_column;
+    out->op_input_starts_offset = out->op_outputs_offset + op_column;
+    out->op_input_lens_offset = out->op_input_starts_offset + op_column;
+    out->varnode_count = varnodes;
+    out->vn_offsets_offset = out->op_input_lens_offset + op_column;
+    out->vn_sizes_offset =
+        out->vn_offsets_offset + sizeof(uint64_t) * varnodes;
+    out->vn_spaces_offset = out->vn_sizes_offset + vn_column;
+    out->text_size = text.size();
+    out->vn_registers_offset = out->vn_spaces_offset + vn_column;
+    out->vn_relocs_offset = out->vn_registers_offset + vn_column;
+    out->insn_relocs_offset =
+        out->vn_relocs_offset + align_column(sizeof(uint8_t) * varnodes);
+    out->text_offset = out->insn_relocs_offset +
+                       align_column(sizeof(uint8_t) * range_insns.size());
+    out->arena_size = out->text_offset + text.size();
+    out->arena = (uint8_t *)malloc(out->arena_size > 0 ? out->arena_size : 1);
+    if (out->arena == nullptr)
+    {
+      throw std::bad_alloc();
+    }
+
+    memcpy(out->arena + out->insns_offset, range_insns.data(),
+           sizeof(RangeInsnDesc) * range_insns.size());
+    memcpy(out->arena + out->effects_offset, range_effects.data(),
+           sizeof(InsnEffects) * range_effects.size());
+    copy_column(out->arena + out->op_opcodes_offset, pcode.opcodes, op_column);
+    copy_column(out->arena + out->op_outputs_offset, pcode.outputs, op_column);
+    copy_column(out->arena + out->op_input_starts_offset, pcode.input_starts,
+                op_column);
+    copy_column(out->arena + out->op_input_lens_offset, pcode.input_lens,
+                op_column);
+    copy_column(out->arena + out->vn_offsets_offset, pcode.offsets,
+                sizeof(uint64_t) * varnodes);
+    copy_column(out->arena + out->vn_sizes_offset, pcode.sizes, vn_column);
+    copy_column(out->arena + out->vn_spaces_offset, pcode.spaces, vn_column);
+    copy_column(out->arena + out->vn_registers_offset, pcode.registers,
+                vn_column);
+    copy_column(out->arena + out->vn_relocs_offset, pcode.relocs,
+                align_column(sizeof(uint8_t) * varnodes));
+    copy_column(out->arena + out->insn_relocs_offset, range_insn_relocs,
+                align_column(sizeof(uint8_t) * range_insns.size()));
+    memcpy(out->arena + out->text_offset, text.data(), text.size());
+  }
+
+  /** \brief rounds a column size up so the next column stays 8 byte aligned */
+  static uint64_t align_column(uint64_t size) { return (size + 7) & ~7ull; }
+
+  /** \brief copies `column` into `dst`, zeroing the padding up to `size` */
+  template <typename T>
+  static void copy_column(uint8_t *dst, const std::vector<T> &column,
+                          uint64_t size)
+  {
+    uint64_t used = sizeof(T) * column.size();
+    memcpy(dst, column.data(), used);
+    memset(dst + used, 0, size - used);
+  }
+
+  /**
+   * \brief the emulator of this manager, built on first use. Throws if
+   * `begin` hasn't been called yet.
+   */
+  SnapshotEmulator &emulator(void)
+  {
+    if (sleigh == nullptr)
+    {
+      throw ghidra::LowlevelError("Cannot emulate before begin");
+    }
+    if (emulate_state == nullptr)
+    {
+      emulate_state.reset(new SnapshotEmulator(sleigh, loader.get()));
+    }
+
+    return *emulate_state;
+  }
+
+  void emulate_lanes(uint32_t count)
+  {
+    if (sleigh == nullptr)
+    {
+      throw ghidra::LowlevelError("Cannot emulate before begin");
+    }
+    lane_state.reset();
+    lane_state.reset(new LaneEmulator(sleigh, loader.get(), count));
+  }
+
+  LaneEmulator &lanes(void)
+  {
+    if (lane_state == nullptr)
+    {
+      throw ghidra::LowlevelError("Lanes have not been set up");
+    }
+
+    return *lane_state;
+  }
+
+  /**
+   * \brief sets the default of `key` to `value`, also past the regions
+   * already painted: their split points hold a copy of the old default
+   */
+  void context_var_set_default(char key[], uint32_t value)
+  {
+    context.setVariableDefault(key, value);
+    context_defaults.emplace_back(key, value);
+    rebuild_context();
+    context_changed();
+  }
+
+  /**
+   * \brief paints `context_regions` over `context_defaults` again from an
+   * empty context, the same way a fork starts out. Drops the context the
+   * decoded instructions committed with it.
+   */
+  void rebuild_context(void)
+  {
+    context.clearRegions();
+    for (size_t i = 0; i < context_defaults.size(); i++)
+    {
+      context.setVariableDefault(context_defaults[i].first,
+                                 context_defaults[i].second);
+    }
+    for (size_t i = 0; i < context_regions.size(); i++)
+    {
+      paint_context(context_regions[i]);
+    }
+    ghidra::AddrSpace *space = sleigh->getDefaultCodeSpace();
+    sleigh->invalidateContext(ghidra::Address(space, 0), space->getHighest());
+    context.freeze();
+  }
+
+  /** \brief sets `region.key` to `region.value` over its addresses */
+  void paint_context(const ContextRegion &region)
+  {
+    ghidra::AddrSpace *space = sleigh->getDefaultCodeSpace();
+    ghidra::Address begad(space, region.start);
+    // running up to the end of the space is an open ended region
+    ghidra::Address endad = region.end - 1 >= space->getHighest()
+                                ? ghidra::Address()
+                                : ghidra::Address(space, region.end);
+    context.setVariableRegion(region.key, begad, endad, region.value);
+    sleigh->invalidateContext(begad, region.end - region.start);
+  }
+
+  void context_var_set_region(char key[], uint64_t start, uint64_t end,
+                              uint32_t value)
+  {
+    if (sleigh == nullptr)
+    {
+      throw ghidra::LowlevelError("Context regions need a started manager");
+    }
+    if (end <= start)
+    {
+      throw ghidra::LowlevelError("Empty context region");
+    }
+
+    ContextRegion region = {key, start, end, value};
+    paint_context(region);
+    context_regions.push_back(region);
+    context_changed();
+  }
+
+  /** \brief drops everything decoded with the context before it changed */
+  void context_changed(void)
+  {
+    decode_cache.clear();
+    clear_intern();
+    if (emulate_state != nullptr)
+    {
+      emulate_state->flush_code();
+    }
+    if (lane_state != nullptr)
+    {
+      lane_state->flush_code();
+    }
+  }
+
+  /** \brief every register of the spec, owned by the spec */
+  RegisterList *get_all_registers(void) { return spec->get_register_list(); }
+
+  /**
+   * \brief returns the table of address spaces, built on the first call
+   * and owned by the manager
+   */
+  SpaceList *get_spaces(void)
+  {
+    if (space_descs.empty())
+    {
+      space_descs.resize(sleigh->numSpaces());
+      for (int i = 0; i < sleigh->numSpaces(); i++)
+      {
+        SpaceDesc &desc = space_descs[i];
+        memset(desc.name, 0, sizeof(desc.name));
+        desc.index = i;
+
+        ghidra::AddrSpace *space = sleigh->getSpace(i);
+        if (space != nullptr)
+        {
+          strncpy(desc.name, space->getName().c_str(), sizeof(desc.name));
+        }
+      }
+    }
+
+    space_list.space_count = space_descs.size();
+    space_list.spaces = space_descs.data();
+    return &space_list;
+  }
+
+  UserOpNames *get_user_ops(void)
+  {
+    std::vector<std::string> ops;
+
+    // get the op names
+    sleigh->getUserOpNames(ops);
+
+    // now copy and export
+    UserOpNames *names = new (std::nothrow) UserOpNames;
+    names->num = ops.size();
+    names->name_lens = new (std::nothrow) uint64_t[names->num];
+    names->names = new (std::nothrow) char *[names->num];
+
+    // not duplicate all the string
+    uint64_t idx = 0;
+    std::vector<std::string>::iterator it;
+    for (it = ops.begin(); it != ops.end(); it++, idx++)
+    {
+      std::string n = it->data();
+      names->name_lens[idx] = n.size();
+      names->names[idx] = strdup(n.c_str());
+    }
+
+    return names;
+  }
+};
+
+/************************************************/
+/// C-API begins here
+/************************************************/
+extern "C"
+{
+  /**
+   * \brief constructs a new `ArbitraryManager`
+   */
+  ArbitraryManager *arbitrary_manager_new(void) { return new ArbitraryManager{}; }
+
+  /**
+   * \brief constructs a new `ArbitraryManager` that shares the loaded
+   * regions, spec and context defaults of `parent` (which must have
+   * already called `arbitrary_manager_begin`). Each manager may be used
+   * from its own thread, returns null if the fork failed.
+   */
+  ArbitraryManager *arbitrary_manager_fork(ArbitraryManager *parent)
+  {
+    ArbitraryManager *out = nullptr;
+
+    try
+    {
+      out = new ArbitraryManager(*parent);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      out = nullptr;
+    }
+
+    return out;
+  }
+
+  /**
+   * \brief free's the provided `ArbitraryManager`
+   */
+  void arbitrary_manager_free(ArbitraryManager *mgr) { delete mgr; }
+
+  /**
+   * \brief Loads a sequence of bytes at the provided address
+   * inside the underlying `ArbitraryLoader` to the
+   * `ArbitraryManager`.
+   *
+   * *This must be called before `arbitrary_manager_specfile`
+   * and `arbitrary_manager_next_insn`*
+   */
+  void arbitrary_manager_load_region(ArbitraryManager *mgr, uint64_t address,
+                                     uint64_t size, uint8_t *data)
+  {
+    mgr->load_data(address, size, data);
+  }
+
+  /**
+   * \brief Same as `arbitrary_manager_load_region` for a region that is a
+   * section with `flags` (`ghidra::LoadImageSection` flags), which SLEIGH's
+   * `getNextSection` + `getReadonly` report
+   */
+  void arbitrary_manager_load_section(ArbitraryManager *mgr, uint64_t address,
+                                      uint64_t size, uint8_t *data,
+                                      uint32_t flags)
+  {
+    mgr->load_data(address, size, data, flags);
+  }
+
+  /**
+   * \brief Overwrites `size` bytes at `address` with a copy of `bytes`
+   * (any bytes of it that weren't loaded are mapped). Only the cached
+   * decodes of instructions that read a patched byte are dropped, so the
+   * next lift only decodes those again. Returns `Fail` if the patch runs
+   * up to or wraps around the end of the address space, or while `mgr`
+   * shares its regions with a fork (or the manager it was forked off of)
+   * that isn't freed yet. Fork again after patching instead.
+   */
+  LibSlaError arbitrary_manager_patch(ArbitraryManager *mgr, uint64_t address,
+                                      const uint8_t *bytes, uint64_t size)
+  {
+    if (!mgr->patch_data(address, size, bytes))
+    {
+      return LibSlaError::Fail;
+    }
+    return LibSlaError::Ok;
+  }
+
+  /**
+   * \brief Loads the decompressed bytes of `image` at `address`, the same as
+   * `arbitrary_manager_load_region` without decompressing anything up
+   * front. `image` may be closed afterwards.
+   */
+  void arbitrary_manager_load_zstd_region(ArbitraryManager *mgr,
+                                          uint64_t address, ZstdHandle *image)
+  {
+    mgr->load_data(address, image->image);
+  }
+
+  /**
+   * \brief After loading bytes into the loader, connect the
+   * proper specfile at `path` to decode the bytestream.
+   */
+  LibSlaError arbitrary_manager_specfile(ArbitraryManager *mgr, char path[])
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      mgr->load_specfile(path);
+    }
+    catch (ghidra::DecoderError &err)
+    {
+      return_value = LibSlaError::InvalidSlaspec;
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::InvalidSlaspec;
+    }
+
+    return return_value;
+  }
+
+  /**
+   * \brief Reads and decodes the specfile at `path` once, so any number
+   * of managers can share it through `arbitrary_manager_use_spec`.
+   * Returns null if the spec is invalid.
+   */
+  ArbitrarySpec *arbitrary_spec_load(char path[])
+  {
+    ArbitrarySpec *out = new ArbitrarySpec;
+
+    try
+    {
+      out->load(path);
+    }
+    catch (ghidra::DecoderError &err)
+    {
+      ArbitrarySpec::release(out);
+      out = nullptr;
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      ArbitrarySpec::release(out);
+      out = nullptr;
+    }
+
+    return out;
+  }
+
+  /**
+   * \brief Converts the `.sla` at `in_path` into a packed spec at
+   * `out_path`, which `arbitrary_spec_load` / `arbitrary_manager_specfile`
+   * load without going through the XML parser.
+   */
+  LibSlaError arbitrary_spec_pack(char in_path[], char out_path[])
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      ArbitrarySpec::pack(in_path, out_path);
+    }
+    catch (ghidra::DecoderError &err)
+    {
+      return_value = LibSlaError::InvalidSlaspec;
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
+  }
+
+  /**
+   * \brief Writes the C++ source of a decoder for the spec at `in_path` to
+   * `out_path`: the decision tree of every subtable compiled into nested
+   * `switch`es, see `aot_decoder.hh`. Compiled into a binary, it resolves
+   * every load of the same spec, registered as `name`.
+   */
+  LibSlaError arbitrary_spec_gen_decoder(char in_path[], char out_path[],
+                                         char name[])
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      ArbitrarySpec spec;
+      spec.load(in_path);
+      spec.write_decoder(out_path, name);
+    }
+    catch (ghidra::DecoderError &err)
+    {
+      return_value = LibSlaError::InvalidSlaspec;
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
+  }
+
+  /**
+   * \brief whether specs loaded from now on resolve through the decoders
+   * compiled into the binary (the default), or always through their
+   * decision tables. Specs already loaded keep what they had.
+   */
+  void arbitrary_set_aot_decoders(bool enable) { aot_decoder_enable(enable); }
+
+  /**
+   * \brief whether specs loaded from now on convert the float formats that
+   * match the host's `float` + `double` by reinterpreting their bits (the
+   * default), or always field by field. Both give the same results (up to
+   * the sign of NaNs that ops produce), this is for measuring the
+   * difference. Specs already loaded keep what they had.
+   */
+  void arbitrary_set_host_floats(bool enable)
+  {
+    ghidra::FloatFormat::setHostFormats(enable);
+  }
+
+  /**
+   * \brief name of the compiled in decoder resolving the spec of `mgr`,
+   * null if it resolves through its decision tables
+   */
+  const char *arbitrary_manager_aot_decoder(ArbitraryManager *mgr)
+  {
+    return mgr->decoder_name();
+  }
+
+  /**
+   * \brief drops the callers reference to `spec`, managers still using
+   * it keep it alive until they are free'd
+   */
+  void arbitrary_spec_free(ArbitrarySpec *spec) { ArbitrarySpec::release(spec); }
+
+  /**
+   * \brief Use the already decoded `spec` instead of calling
+   * `arbitrary_manager_specfile`, must be called before
+   * `arbitrary_manager_begin`.
+   */
+  void arbitrary_manager_use_spec(ArbitraryManager *mgr, ArbitrarySpec *spec)
+  {
+    mgr->use_spec(spec);
+  }
+
+  /**
+   * \brief After loading bytes and setting the specfile,
+   * call this method to kickoff the SLEIGH backend.
+   */
+  void arbitrary_manager_begin(ArbitraryManager *mgr) { mgr->begin(); }
+
+  /**
+   * \brief After starting the SLEIGH backend, call this method
+   * to decode the next instruction, by default it starts at the
+   * beginning of the sole provided address space.
+   */
+  InsnDesc *arbitrary_manager_next_insn(ArbitraryManager *mgr)
+  {
+    return mgr->translate_next();
+  }
+
+  /**
+   * \brief After starting the SLEIGH backend, call this method to
+   * decode the instruction at `address` into `out`, which is left null
+   * when nothing decodes there. You probably want to make sure the
+   * requested addreess is aligned properly and in the right address
+   * space. `Fail` when out of memory.
+   */
+  LibSlaError arbitrary_manager_lift_insn(ArbitraryManager *mgr,
+                                          uint64_t address, InsnDesc **out)
+  {
+    return mgr->lift_insn(address, out);
+  }
+
+  /**
+   * \brief Keeps up to `capacity` decoded instructions of `mgr` around, so
+   * lifting an address again (with either `arbitrary_manager_lift_insn` or
+   * `arbitrary_manager_lift_range`) skips decoding it. 0, the default,
+   * disables the cache. It is emptied by loading data or setting a context
+   * variable.
+   */
+  void arbitrary_manager_set_decode_cache(ArbitraryManager *mgr,
+                                          uint64_t capacity)
+  {
+    mgr->set_decode_cache(capacity);
+  }
+
+  /**
+   * \brief Simplifies the p-code of every lifted instruction when `enable`d:
+   * copies into `unique` temporaries are propagated, integer ops of
+   * constants folded and temporaries nothing reads dropped, see
+   * `pcode_simplify.hh`. Forks inherit the setting.
+   */
+  void arbitrary_manager_set_simplify_pcode(ArbitraryManager *mgr, bool enable)
+  {
+    mgr->set_simplify(enable);
+  }
+
+  /**
+   * \brief lifts p-code only from now on (`lift_insn` + `lift_range` leave
+   * the text empty) when `enable`d, get the text of the few instructions
+   * that need it from `arbitrary_manager_disasm`
+   */
+  void arbitrary_manager_set_pcode_only(ArbitraryManager *mgr, bool enable)
+  {
+    mgr->set_pcode_only(enable);
+  }
+
+  /**
+   * \brief `arbitrary_manager_lift_range` decodes at every aligned offset
+   * from now on when `enable`d, instead of only where the last instruction
+   * ended. Forks inherit the setting.
+   */
+  void arbitrary_manager_set_all_offsets(ArbitraryManager *mgr, bool enable)
+  {
+    mgr->set_all_offsets(enable);
+  }
+
+  /**
+   * \brief instruction alignment of the spec `mgr` began with, the step of
+   * `arbitrary_manager_set_all_offsets` and of decode failures
+   */
+  uint64_t arbitrary_manager_get_alignment(ArbitraryManager *mgr)
+  {
+    return mgr->get_alignment();
+  }
+
+  /**
+   * \brief counts the symbols, constructors and p-code templates of the spec
+   * `mgr` lifts with and the bytes they take into `out`, for sizing how
+   * many managers fit. Forked managers share them.
+   */
+  LibSlaError arbitrary_manager_spec_memory_usage(ArbitraryManager *mgr,
+                                                  SpecMemoryUsage *out)
+  {
+    if (!mgr->spec_memory_usage(out))
+    {
+      return LibSlaError::Uninit;
+    }
+    return LibSlaError::Ok;
+  }
+
+  /**
+   * \brief Interns up to `capacity` distinct instruction encodings (bytes +
+   * context) of `mgr`: every repeat of one reuses the p-code decoded for the
+   * first, relocated to its own address, and the repeats in one
+   * `arbitrary_manager_lift_range` share its op + varnode rows. 0 disables
+   * it, the default is `DEFAULT_INSN_INTERN`. It is emptied by loading data
+   * or setting a context variable.
+   */
+  void arbitrary_manager_set_insn_intern(ArbitraryManager *mgr,
+                                         uint64_t capacity)
+  {
+    mgr->set_insn_intern(capacity);
+  }
+
+  /**
+   * \brief renders the assembly of the instruction at `address` into `out`,
+   * the text belongs to `mgr` and is only valid until the next
+   * `arbitrary_manager_disasm`
+   */
+  LibSlaError arbitrary_manager_disasm(ArbitraryManager *mgr,
+                                       uint64_t address, DisasmText *out)
+  {
+    memset(out, 0, sizeof(DisasmText));
+    if (!mgr->disasm(address, out))
+    {
+      return LibSlaError::InsnDecodeError;
+    }
+    return LibSlaError::Ok;
+  }
+
+  /**
+   * \brief decodes the length + flow of the instruction at `address` into
+   * `out`, several times faster than lifting it as no p-code, varnodes or
+   * text are built
+   */
+  LibSlaError arbitrary_manager_insn_flow(ArbitraryManager *mgr,
+                                          uint64_t address, InsnFlow *out)
+  {
+    if (!mgr->insn_flow(address, out))
+    {
+      return LibSlaError::InsnDecodeError;
+    }
+    return LibSlaError::Ok;
+  }
+
+  /**
+   * \brief decodes the length + flow of up to `capacity` instructions in
+   * `[start, end)` into the caller-owned `out`, stepping through the code
+   * like `arbitrary_manager_lift_range`. `*count` is set to how many were
+   * written and `*end_address` to the first address that wasn't decoded.
+   */
+  LibSlaError arbitrary_manager_flow_range(ArbitraryManager *mgr,
+                                           uint64_t start, uint64_t end,
+                                           InsnFlow *out, uint64_t capacity,
+                                           uint64_t *count,
+                                           uint64_t *end_address)
+  {
+    *end_address = mgr->flow_range(start, end, out, capacity, count);
+    return LibSlaError::Ok;
+  }
+
+  /**
+   * \brief decodes the basic block at `address` into `out`, and up to
+   * `capacity` of its edges into the caller-owned `edges`. Nothing past
+   * `end` is decoded. See `BlockFlow`.
+   */
+  LibSlaError arbitrary_manager_block_flow(ArbitraryManager *mgr,
+                                           uint64_t address, uint64_t end,
+                                           BlockEdge *edges, uint64_t capacity,
+                                           BlockFlow *out)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      mgr->block_flow(address, end, edges, capacity, out);
+    }
+    catch (std::bad_alloc &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
+  }
+
+  /**
+   * \brief Sizes the parse tree cache of SLEIGH for `mgr` to `cache_size`
+   * trees hashed into a `window_size` table, 0 for either keeps the default
+   * of the spec (which is also the smallest size allowed). Fails if
+   * `window_size` isn't a power of 2.
+   */
+  LibSlaError arbitrary_manager_set_parser_cache(ArbitraryManager *mgr,
+                                                 uint32_t cache_size,
+                                                 uint32_t window_size)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      mgr->set_parser_cache(cache_size, window_size);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
+  }
+
+  /**
+   * \brief After starting the SLEIGH backend, lifts every instruction in
+   * `[start, end)` into the caller-owned `out`. Everything lifted lives in
+   * one arena, free it with `arbitrary_manager_release`.
+   */
+  LibSlaError arbitrary_manager_lift_range(ArbitraryManager *mgr,
+                                           uint64_t start, uint64_t end,
+                                           LiftedRange *out)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+    memset(out, 0, sizeof(LiftedRange));
+
+    try
+    {
+      mgr->lift_range(start, end, out);
+    }
+    catch (std::bad_alloc &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
+  }
+
+  /**
+   * \brief Lifts the bytes the range `in` was lifted from at `from` (by any
+   * manager of the same spec + context) as if they were at `to`, where
+   * `mgr` must have them loaded, into the caller-owned `out`. Only the
+   * instructions whose p-code doesn't simply move with their bytes are
+   * decoded again. Free `out` with `arbitrary_manager_release`.
+   */
+  LibSlaError arbitrary_manager_relocate_range(ArbitraryManager *mgr,
+                                               const LiftedRange *in,
+                                               uint64_t from, uint64_t to,
+                                               LiftedRange *out)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+    memset(out, 0, sizeof(LiftedRange));
+    if (in->arena == nullptr && in->insn_count != 0)
+    {
+      return LibSlaError::Fail;
+    }
+
+    try
+    {
+      mgr->relocate_range(*in, from, to, out);
+    }
+    catch (std::bad_alloc &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
+  }
+
+  /**
+   * \brief free's the arena owned by `out` from
+   * `arbitrary_manager_lift_range`
+   */
+  void arbitrary_manager_release(LiftedRange *out)
+  {
+    free(out->arena);
+    memset(out, 0, sizeof(LiftedRange));
+  }
+
+  /**
+   * \brief Maps `size` bytes at `offset` of the file at `path` into `out`,
+   * a `size` of 0 maps to the end of the file. Nothing is read up front,
+   * pages are faulted in as SLEIGH touches them. Writes to the view never
+   * reach the file. Unmap with `arbitrary_file_unmap`.
+   */
+  LibSlaError arbitrary_file_map(char path[], uint64_t offset, uint64_t size,
+                                 MappedRegion *out)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+    memset(out, 0, sizeof(MappedRegion));
+
+    try
+    {
+      out->file = new MappedFile(path, offset, size, true);
+      out->data = out->file->data;
+      out->size = out->file->size;
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
+  }
+
+  /**
+   * \brief unmaps a view from `arbitrary_file_map`, no manager may still
+   * have it loaded as a region
+   */
+  void arbitrary_file_unmap(MappedRegion *region)
+  {
+    delete region->file;
+    memset(region, 0, sizeof(MappedRegion));
+  }
+
+  /** \brief NUMA nodes with CPUs, see `numa_placement.hh` */
+  uint32_t arbitrary_numa_node_count(void) { return numa_node_count(); }
+
+  /** \brief node the calling thread runs on right now */
+  uint32_t arbitrary_numa_current_node(void) { return numa_current_node(); }
+
+  /** \brief pins the calling thread to the CPUs of `node` */
+  bool arbitrary_numa_bind_thread(uint32_t node)
+  {
+    return numa_bind_thread(node);
+  }
+
+  /**
+   * \brief puts the pages the calling thread touches first on `node`, back
+   * on its own node for a negative `node`
+   */
+  void arbitrary_numa_prefer_node(int32_t node) { numa_prefer_node(node); }
+
+  /** \brief spreads the pages of `[data, data + size)` over every node */
+  void arbitrary_numa_interleave(const uint8_t *data, uint64_t size)
+  {
+    numa_interleave(data, size);
+  }
+
+  /** \brief advises transparent huge pages for `[data, data + size)` */
+  void arbitrary_advise_huge_pages(const uint8_t *data, uint64_t size)
+  {
+    advise_huge_pages(data, size);
+  }
+
+  /**
+   * \brief maps `size` bytes of huge page aligned memory, null on failure.
+   * Free with `arbitrary_huge_page_free` and the same `size`.
+   */
+  uint8_t *arbitrary_huge_page_alloc(uint64_t size)
+  {
+    return huge_page_alloc(size);
+  }
+
+  /** \brief unmaps a `arbitrary_huge_page_alloc` of `size` bytes */
+  void arbitrary_huge_page_free(uint8_t *data, uint64_t size)
+  {
+    huge_page_free(data, size);
+  }
+
+  /**
+   * \brief Maps the object file at `path` (anything BFD recognizes) and
+   * fills `out` with its allocated sections. Fails if BFD doesn't recognize
+   * it. Close with `arbitrary_bfd_close`, no manager may still have any of
+   * its sections loaded by then.
+   */
+  LibSlaError arbitrary_bfd_open(char path[], ObjectImage *out)
+  {
+    memset(out, 0, sizeof(ObjectImage));
+
+    BfdImage *image = nullptr;
+    try
+    {
+      image = new BfdImage(path);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return LibSlaError::Fail;
+    }
+
+    const std::vector<BfdSection> &sections = image->get_sections();
+    out->section_count = sections.size();
+    out->sections = new ObjectSection[sections.size()];
+    for (size_t i = 0; i < sections.size(); i++)
+    {
+      ObjectSection &section = out->sections[i];
+      section.name = sections[i].name.c_str();
+      section.address = sections[i].address;
+      section.size = sections[i].size;
+      section.flags = sections[i].flags;
+      section.data = sections[i].data;
+    }
+    out->entry = image->get_entry();
+    out->arch = image->get_arch().c_str();
+    out->image = image;
+    return LibSlaError::Ok;
+  }
+
+  /** \brief unmaps an object file from `arbitrary_bfd_open` */
+  void arbitrary_bfd_close(ObjectImage *image)
+  {
+    delete[] image->sections;
+    delete image->image;
+    memset(image, 0, sizeof(ObjectImage));
+  }
+
+  /**
+   * \brief Maps + indexes the zstd file at `path` into `out` and sets `size`
+   * to its decompressed size. Fails if it isn't made of frames that can be
+   * decompressed on their own, see `zstd_image.hh`. Close with
+   * `arbitrary_zstd_close`.
+   */
+  LibSlaError arbitrary_zstd_open(char path[], ZstdHandle **out,
+                                  uint64_t *size)
+  {
+    *out = nullptr;
+    *size = 0;
+
+    try
+    {
+      std::shared_ptr<ZstdImage> image(new ZstdImage(path));
+      *size = image->size();
+      *out = new ZstdHandle{image};
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return LibSlaError::Fail;
+    }
+
+    return LibSlaError::Ok;
+  }
+
+  /**
+   * \brief sets `hits` + `misses` to the reads of `image` that found their
+   * frame already decompressed / had to decompress it
+   */
+  void arbitrary_zstd_cache_stats(ZstdHandle *image, uint64_t *hits,
+                                  uint64_t *misses)
+  {
+    *hits = image->image->cache_hits();
+    *misses = image->image->cache_misses();
+  }
+
+  /**
+   * \brief the compressed bytes of `image`, `size` of them, valid until it is
+   * closed
+   */
+  const uint8_t *arbitrary_zstd_compressed(ZstdHandle *image, uint64_t *size)
+  {
+    *size = image->image->compressed_size();
+    return image->image->compressed_data();
+  }
+
+  /**
+   * \brief drops the reference of `arbitrary_zstd_open`, the image lives on
+   * in the managers it was loaded into
+   */
+  void arbitrary_zstd_close(ZstdHandle *image) { delete image; }
+
+  /**
+   * \brief sets `count` + `bytes` to the heap allocations libsla has made
+   * so far, fails unless it was built with `-DLIBSLA_COUNT_ALLOCATIONS`
+   */
+  LibSlaError arbitrary_allocation_stats(uint64_t *count, uint64_t *bytes)
+  {
+    if (!allocation_stats(count, bytes))
+    {
+      return LibSlaError::Fail;
+    }
+    return LibSlaError::Ok;
+  }
+
+  /**
+   * \brief sets `out` to what `mgr` counted since it was created or last
+   * reset. Only `allocation_*` is filled in (by
+   * `-DLIBSLA_COUNT_ALLOCATIONS`) unless libsla was built with
+   * `-DLIBSLA_STATS`, which `out->enabled` tells
+   */
+  LibSlaError arbitrary_manager_get_stats(ArbitraryManager *mgr,
+                                          LiftStats *out)
+  {
+    mgr->get_stats(out);
+    return LibSlaError::Ok;
+  }
+
+  /**
+   * \brief zeroes everything `arbitrary_manager_get_stats` reports for `mgr`
+   */
+  void arbitrary_manager_reset_stats(ArbitraryManager *mgr)
+  {
+    mgr->reset_stats();
+  }
+
+  /**
+   * \brief profiles where decoding goes while `enable`d: how deep the
+   * decision trees of the subtables go, each constructor matched and each
+   * constructor's context changes, see `decode_profile.hh`. Enabling drops
+   * what was counted so far, forks made while it is on profile too. Fails
+   * unless libsla was built with `-DLIBSLA_STATS`.
+   */
+  LibSlaError arbitrary_manager_set_decode_profile(ArbitraryManager *mgr,
+                                                   bool enable)
+  {
+    return mgr->set_decode_profile(enable) ? LibSlaError::Ok
+                                           : LibSlaError::Fail;
+  }
+
+  /**
+   * \brief adds what `other` profiled into the profile of `mgr`, for totals
+   * across forks. Both must be profiling and share a spec.
+   */
+  LibSlaError arbitrary_manager_merge_decode_profile(ArbitraryManager *mgr,
+                                                     ArbitraryManager *other)
+  {
+    return mgr->merge_decode_profile(*other) ? LibSlaError::Ok
+                                             : LibSlaError::Fail;
+  }
+
+  /**
+   * \brief renders what `mgr` profiled as text tables into `out`, the text
+   * belongs to `mgr` and is only valid until the next call. Fails if `mgr`
+   * isn't profiling or hasn't begun.
+   */
+  LibSlaError arbitrary_manager_decode_profile_report(ArbitraryManager *mgr,
+                                                      const char **out)
+  {
+    *out = mgr->decode_profile_report();
+    return *out != nullptr ? LibSlaError::Ok : LibSlaError::Fail;
   }
 
-  InsnDesc *lift_insn(uint64_t addr)
+  /**
+   * \brief set's the context var global default to `value`
+   */
+  LibSlaError arbitrary_manager_context_var_set_default(ArbitraryManager *mgr,
+                                                 char key[], uint32_t value)
   {
-    InsnDesc *out = nullptr;
+    LibSlaError return_value = LibSlaError::Ok;
+
     try
     {
-      ghidra::Address address(sleigh->getDefaultCodeSpace(), addr);
+      mgr->context_var_set_default(key, value);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::BadContextVariable;
+    }
 
-      // lift the insn
-      sleigh->printAssembly(asm_emitter, address);
-      int32_t insn_length = sleigh->oneInstruction(pcode_emitter, address);
-      asm_emitter.insn_size = insn_length;
+    return return_value;
+  }
 
-      // get the metadata
-      out = to_insn_desc();
-      out->address = addr;
+  /**
+   * \brief set's the context var to `value` over `[start, end)`, on top of
+   * its default
+   */
+  LibSlaError arbitrary_manager_context_var_set_region(ArbitraryManager *mgr,
+                                                       char key[],
+                                                       uint64_t start,
+                                                       uint64_t end,
+                                                       uint32_t value)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
 
-      // clear insn data
-      pcode_emitter.pcode_ops.clear();
-      asm_emitter.clear();
+    try
+    {
+      mgr->context_var_set_region(key, start, end, value);
     }
-    catch (ghidra::BadDataError &e)
+    catch (ghidra::LowlevelError &err)
     {
-      // continue
-      out = nullptr;
-      // std::cout << "BadDataError: " << e.explain << std::endl;
+      return_value = LibSlaError::BadContextVariable;
     }
 
-    return out;
+    return return_value;
   }
 
-  void context_var_set_default(char key[], uint32_t value)
+  RegisterList *arbitrary_manager_get_all_registers(ArbitraryManager *mgr)
   {
-    context.setVariableDefault(key, value);
+    return mgr->get_all_registers();
   }
 
-  RegisterList *get_all_registers(void)
+  /**
+   * \brief Get the table mapping the space column of a `LiftedRange` back
+   * to an address space name. The table is owned by `mgr`.
+   */
+  SpaceList *arbitrary_manager_get_spaces(ArbitraryManager *mgr)
   {
-    std::map<ghidra::VarnodeData, ghidra::string> register_list;
-    sleigh->getAllRegisters(register_list);
+    return mgr->get_spaces();
+  }
 
-    // allocate memory needed to fit all the registers
-    RegisterList *out = new (std::nothrow) RegisterList;
-    out->register_count = register_list.size();
-    out->registers = new (std::nothrow) RegisterDesc[out->register_count];
+  UserOpNames *arbitrary_manager_get_user_ops(ArbitraryManager *mgr)
+  {
+    return mgr->get_user_ops();
+  }
 
-    // for all the registers in the map, add them to our output
-    std::map<ghidra::VarnodeData, ghidra::string>::iterator it;
-    uint64_t idx = 0;
-    for (it = register_list.begin(); it != register_list.end(); it++, idx++)
+  /**
+   * \brief Sets the register `name` of the emulator of `mgr` to `value`.
+   * The emulator is built by the first `arbitrary_manager_emulate_*` call
+   * after `arbitrary_manager_begin`, with the loaded regions as its memory.
+   * Fails for unknown registers or ones wider than 8 bytes.
+   */
+  LibSlaError arbitrary_manager_emulate_set_register(ArbitraryManager *mgr,
+                                                     char name[],
+                                                     uint64_t value)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      mgr->emulator().set_register(name, value);
+    }
+    catch (ghidra::LowlevelError &err)
     {
-      RegisterDesc *reg = &out->registers[idx];
-      ghidra::VarnodeData vn = it->first;
-      ghidra::string name = it->second;
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
+  }
 
-      // copy the register name
-      strncpy(reg->name, name.c_str(), 64);
+  /**
+   * \brief Reads the register `name` of the emulator of `mgr` into `out`
+   */
+  LibSlaError arbitrary_manager_emulate_get_register(ArbitraryManager *mgr,
+                                                     char name[],
+                                                     uint64_t *out)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
 
-      // copy the varnode data
-      reg->varnode.offset = vn.offset;
-      reg->varnode.size = vn.size;
-      strncpy(reg->varnode.space, vn.space->getName().c_str(), 16);
+    try
+    {
+      *out = mgr->emulator().get_register(name);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
     }
 
-    return out;
+    return return_value;
   }
 
-  UserOpNames *get_user_ops(void)
+  /**
+   * \brief Writes `size` bytes of `data` at `address` of the default data
+   * space of the emulator, the loaded regions themselves are never written
+   */
+  LibSlaError arbitrary_manager_emulate_write(ArbitraryManager *mgr,
+                                              uint64_t address, uint64_t size,
+                                              uint8_t *data)
   {
-    std::vector<std::string> ops;
+    LibSlaError return_value = LibSlaError::Ok;
 
-    // get the op names
-    sleigh->getUserOpNames(ops);
+    try
+    {
+      mgr->emulator().write_memory(address, data, size);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
 
-    // now copy and export
-    UserOpNames *names = new (std::nothrow) UserOpNames;
-    names->num = ops.size();
-    names->name_lens = new (std::nothrow) uint64_t[names->num];
-    names->names = new (std::nothrow) char *[names->num];
+    return return_value;
+  }
 
-    // not duplicate all the string
-    uint64_t idx = 0;
-    std::vector<std::string>::iterator it;
-    for (it = ops.begin(); it != ops.end(); it++, idx++)
+  /**
+   * \brief Reads `size` bytes at `address` of the default data space of the
+   * emulator into `out`, anything never written or loaded reads as 0
+   */
+  LibSlaError arbitrary_manager_emulate_read(ArbitraryManager *mgr,
+                                             uint64_t address, uint64_t size,
+                                             uint8_t *out)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
     {
-      std::string n = it->data();
-      names->name_lens[idx] = n.size();
-      names->names[idx] = strdup(n.c_str());
+      mgr->emulator().read_memory(address, out, size);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
     }
 
-    return names;
+    return return_value;
   }
-};
 
-/************************************************/
-/// C-API begins here
-/************************************************/
-extern "C"
-{
   /**
-   * \brief constructs a new `ArbitraryManager`
+   * \brief Freezes the registers + memory of the emulator as the state
+   * `arbitrary_manager_emulate_restore` returns to. Nothing is copied, the
+   * writes after it go to a copy-on-write layer over the frozen state.
    */
-  ArbitraryManager *arbitrary_manager_new(void) { return new ArbitraryManager{}; }
+  LibSlaError arbitrary_manager_emulate_snapshot(ArbitraryManager *mgr)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      mgr->emulator().snapshot();
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
+  }
 
   /**
-   * \brief free's the provided `ArbitraryManager`
+   * \brief Drops every write (including those of runs) since the last
+   * `arbitrary_manager_emulate_snapshot`, which costs a free per page
+   * written. Without a snapshot the emulator goes back to just the loaded
+   * regions.
    */
-  void arbitrary_manager_free(ArbitraryManager *mgr) { delete mgr; }
+  LibSlaError arbitrary_manager_emulate_restore(ArbitraryManager *mgr)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      mgr->emulator().restore();
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
+  }
 
   /**
-   * \brief Loads a sequence of bytes at the provided address
-   * inside the underlying `ArbitraryLoader` to the
-   * `ArbitraryManager`.
-   *
-   * *This must be called before `arbitrary_manager_specfile`
-   * and `arbitrary_manager_next_insn`*
+   * \brief Drops every snapshot and write of the emulator
    */
-  void arbitrary_manager_load_region(ArbitraryManager *mgr, uint64_t address,
-                                     uint64_t size, uint8_t *data)
+  LibSlaError arbitrary_manager_emulate_clear(ArbitraryManager *mgr)
   {
-    mgr->load_data(address, size, data);
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      mgr->emulator().clear();
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
   }
 
   /**
-   * \brief After loading bytes into the loader, connect the
-   * proper specfile at `path` to decode the bytestream.
+   * \brief Emulates from `address` until an indirect branch, call or
+   * return, or until `max_insns` instructions have run, and describes why
+   * it stopped in `out`. The final registers + memory are left in the
+   * emulator to be read back, restore it before the next candidate.
    */
-  LibSlaError arbitrary_manager_specfile(ArbitraryManager *mgr, char path[])
+  LibSlaError arbitrary_manager_emulate_run(ArbitraryManager *mgr,
+                                            uint64_t address,
+                                            uint64_t max_insns,
+                                            EmulateResult *out)
   {
     LibSlaError return_value = LibSlaError::Ok;
+    memset(out, 0, sizeof(EmulateResult));
 
     try
     {
-      mgr->load_specfile(path);
+      mgr->emulator().run(address, max_insns, out);
     }
-    catch (ghidra::DecoderError &err)
+    catch (ghidra::LowlevelError &err)
     {
-      return_value = LibSlaError::InvalidSlaspec;
+      return_value = LibSlaError::Fail;
     }
 
     return return_value;
   }
 
   /**
-   * \brief After loading bytes and setting the specfile,
-   * call this method to kickoff the SLEIGH backend.
+   * \brief Sets up `count` lanes that `arbitrary_manager_lanes_run` runs in
+   * lockstep, each one its own copy of the registers + memory of a fresh
+   * emulator. Drops any lanes set up before.
    */
-  void arbitrary_manager_begin(ArbitraryManager *mgr) { mgr->begin(); }
+  LibSlaError arbitrary_manager_emulate_lanes(ArbitraryManager *mgr,
+                                             uint32_t count)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      mgr->emulate_lanes(count);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
+  }
 
   /**
-   * \brief After starting the SLEIGH backend, call this method
-   * to decode the next instruction, by default it starts at the
-   * beginning of the sole provided address space.
+   * \brief `arbitrary_manager_emulate_set_register` for the lane `lane`
    */
-  InsnDesc *arbitrary_manager_next_insn(ArbitraryManager *mgr)
+  LibSlaError arbitrary_manager_lane_set_register(ArbitraryManager *mgr,
+                                                 uint32_t lane, char name[],
+                                                 uint64_t value)
   {
-    return mgr->translate_next();
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      mgr->lanes().set_register(lane, name, value);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
   }
 
   /**
-   * \brief After starting the SLEIGH backend, call this method to
-   * decode the instruction at `address`. You probably want to make
-   * sure the requested addreess is aligned properly and in the right
-   * address space.
+   * \brief `arbitrary_manager_emulate_get_register` for the lane `lane`
    */
-  InsnDesc *arbitrary_manager_lift_insn(ArbitraryManager *mgr, uint64_t address)
+  LibSlaError arbitrary_manager_lane_get_register(ArbitraryManager *mgr,
+                                                 uint32_t lane, char name[],
+                                                 uint64_t *out)
   {
-    return mgr->lift_insn(address);
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      *out = mgr->lanes().get_register(lane, name);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
   }
 
   /**
-   * \brief set's the context var global default to `value`
+   * \brief `arbitrary_manager_emulate_write` for the lane `lane`
    */
-  LibSlaError arbitrary_manager_context_var_set_default(ArbitraryManager *mgr,
-                                                 char key[], uint32_t value)
+  LibSlaError arbitrary_manager_lane_write(ArbitraryManager *mgr,
+                                          uint32_t lane, uint64_t address,
+                                          uint64_t size, uint8_t *data)
   {
     LibSlaError return_value = LibSlaError::Ok;
 
     try
     {
-      mgr->context_var_set_default(key, value);
+      mgr->lanes().write_memory(lane, address, data, size);
     }
     catch (ghidra::LowlevelError &err)
     {
-      return_value = LibSlaError::BadContextVariable;
+      return_value = LibSlaError::Fail;
     }
 
     return return_value;
   }
 
-  RegisterList *arbitrary_manager_get_all_registers(ArbitraryManager *mgr)
+  /**
+   * \brief `arbitrary_manager_emulate_read` for the lane `lane`
+   */
+  LibSlaError arbitrary_manager_lane_read(ArbitraryManager *mgr,
+                                         uint32_t lane, uint64_t address,
+                                         uint64_t size, uint8_t *out)
   {
-    return mgr->get_all_registers();
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      mgr->lanes().read_memory(lane, address, out, size);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
   }
 
-  UserOpNames *arbitrary_manager_get_user_ops(ArbitraryManager *mgr)
+  /**
+   * \brief Drops every write to every lane
+   */
+  LibSlaError arbitrary_manager_lanes_clear(ArbitraryManager *mgr)
   {
-    return mgr->get_user_ops();
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      mgr->lanes().clear();
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
+  }
+
+  /**
+   * \brief Runs every lane from `address` like `arbitrary_manager_emulate_run`,
+   * decoding each instruction once for all of them, and describes why lane
+   * `i` stopped in `out[i]`. `out` must have room for every lane. A lane
+   * that faults stops on its own, the others carry on.
+   */
+  LibSlaError arbitrary_manager_lanes_run(ArbitraryManager *mgr,
+                                          uint64_t address,
+                                          uint64_t max_insns,
+                                          EmulateResult *out)
+  {
+    LibSlaError return_value = LibSlaError::Ok;
+
+    try
+    {
+      LaneEmulator &lanes = mgr->lanes();
+      memset(out, 0, sizeof(EmulateResult) * lanes.lane_count());
+      lanes.run(address, max_insns, out);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      return_value = LibSlaError::Fail;
+    }
+
+    return return_value;
   }
 } // extern "C"
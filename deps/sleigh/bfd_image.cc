@@ -0,0 +1,91 @@
+#include <mutex>
+#include <string>
+
+#include "bfd_image.hh"
+#include "error.hh"
+#include "loadimage.hh"
+
+// bfd.h refuses to be included outside of binutils without these
+#ifndef PACKAGE
+#define PACKAGE "libsla"
+#endif
+#ifndef PACKAGE_VERSION
+#define PACKAGE_VERSION "1"
+#endif
+#include <bfd.h>
+
+static std::once_flag bfd_initialized;
+
+static uint32_t section_flags(flagword flags)
+{
+  uint32_t out = 0;
+  if ((flags & SEC_ALLOC) == 0)
+  {
+    out |= ghidra::LoadImageSection::unalloc;
+  }
+  if ((flags & SEC_LOAD) == 0)
+  {
+    out |= ghidra::LoadImageSection::noload;
+  }
+  if ((flags & SEC_CODE) != 0)
+  {
+    out |= ghidra::LoadImageSection::code;
+  }
+  if ((flags & SEC_DATA) != 0)
+  {
+    out |= ghidra::LoadImageSection::data;
+  }
+  if ((flags & SEC_READONLY) != 0)
+  {
+    out |= ghidra::LoadImageSection::readonly;
+  }
+  return out;
+}
+
+BfdImage::BfdImage(const char *path) : file(path, 0, 0, true)
+{
+  std::call_once(bfd_initialized, []() { bfd_init(); });
+
+  bfd *abfd = bfd_openr(path, nullptr);
+  if (abfd == nullptr)
+  {
+    throw ghidra::LowlevelError(std::string("BFD can't open ") + path);
+  }
+  if (!bfd_check_format(abfd, bfd_object))
+  {
+    bfd_close(abfd);
+    throw ghidra::LowlevelError(std::string(path) +
+                                " isn't an object file BFD knows");
+  }
+
+  arch = bfd_printable_name(abfd);
+  entry = bfd_get_start_address(abfd);
+  for (asection *sec = abfd->sections; sec != nullptr; sec = sec->next)
+  {
+    flagword flags = bfd_section_flags(sec);
+    if ((flags & SEC_ALLOC) == 0)
+    {
+      continue;
+    }
+
+    BfdSection section;
+    section.name = bfd_section_name(sec);
+    section.address = bfd_section_vma(sec);
+    section.size = bfd_section_size(sec);
+    section.flags = section_flags(flags);
+    section.data = nullptr;
+
+    // only sections stored as is in the file can be aliased, anything
+    // else (`.bss`, compressed sections) has no bytes to lift
+    uint64_t offset = sec->filepos;
+    if ((flags & SEC_HAS_CONTENTS) != 0 &&
+        !bfd_is_section_compressed(abfd, sec) && offset <= file.size &&
+        section.size <= file.size - offset)
+    {
+      section.data = file.data + offset;
+    }
+    sections.push_back(section);
+  }
+
+  bfd_close(abfd);
+}
@@ -0,0 +1,62 @@
+/// \file bfd_image.hh
+/// \brief The sections of an object file, found by BFD and mapped in place
+///
+/// Lifting an ELF (or COFF, PE, Mach-O...) as one flat blob decodes its
+/// headers, `.rodata` and `.data` as code too, which is slow and turns up
+/// gadgets that can never run. A `BfdImage` asks BFD where every allocated
+/// section of the file goes and maps the whole file privately, so the bytes
+/// of a section can be loaded into the lifter at its VMA straight out of
+/// the page cache, without BFD copying them.
+#ifndef __BFD_IMAGE_HH__
+#define __BFD_IMAGE_HH__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hh"
+
+/// An allocated section of an object file
+struct BfdSection
+{
+  std::string name;
+  uint64_t address;
+  uint64_t size;
+  /// `ghidra::LoadImageSection` flags
+  uint32_t flags;
+  /// in the mapped file, `nullptr` if the section has no bytes in the file
+  /// (`.bss`)
+  uint8_t *data;
+};
+
+/**
+ * \brief an object file BFD recognized, and its sections
+ */
+class BfdImage
+{
+  MappedFile file;
+  std::vector<BfdSection> sections;
+  std::string arch;
+  uint64_t entry = 0;
+
+public:
+  /**
+   * \brief maps the object file at `path` and reads its section table,
+   * throws `ghidra::LowlevelError` if BFD doesn't recognize it
+   */
+  explicit BfdImage(const char *path);
+
+  /** \brief every allocated section, in the order of the section table */
+  const std::vector<BfdSection> &get_sections(void) const { return sections; }
+
+  /** \brief BFD's name for the architecture, eg `riscv:rv64` */
+  const std::string &get_arch(void) const { return arch; }
+
+  uint64_t get_entry(void) const { return entry; }
+
+private:
+  BfdImage(const BfdImage &);
+  BfdImage &operator=(const BfdImage &);
+};
+
+#endif
@@ -46,6 +46,25 @@ void ParserContext::initialize(int4 maxstate,int4 maxparam,AddrSpace *spc)
   base_state = &state[0];
 }
 
+/// Make room for operand \e i of the current ConstructState and the states after it,
+/// doubling the number of ConstructState objects if they have run out and giving each one
+/// room for \e i + 1 operands.  Any tree resolved so far is invalidated and must be
+/// resolved again.
+/// \param i is the index of the operand that didn't fit
+void ParserContext::growState(int4 i)
+
+{
+  int4 oldsize = state.size();
+  int4 maxparam = state[0].resolve.size();
+  if (alloc == oldsize)
+    state.resize(oldsize * 2);
+  if (i >= maxparam)
+    maxparam = i + 1;
+  for(int4 j=0;j<state.size();++j)
+    state[j].resolve.resize(maxparam);
+  base_state = &state[0];
+}
+
 const Address &ParserContext::getN2addr(void) const
 
 {
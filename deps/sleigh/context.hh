@@ -103,11 +103,14 @@ public:
   void setParserState(int4 st) { parsestate = st; }
   void deallocateState(ParserWalkerChange &walker);
   void allocateOperand(int4 i,ParserWalkerChange &walker);
+  bool canAllocateOperand(int4 i) const { return (alloc < state.size() && i < state[0].resolve.size()); }
+  void growState(int4 i);
   void setAddr(const Address &ad) { addr = ad; n2addr = Address(); }
   void setNaddr(const Address &ad) { naddr = ad; }
   void setCalladdr(const Address &ad) { calladdr = ad; }
   void addCommit(TripleSymbol *sym,int4 num,uintm mask,bool flow,ConstructState *point);
   void clearCommits(void) { contextcommit.clear(); }
+  bool hasCommits(void) const { return !contextcommit.empty(); }
   void applyCommits(void);
   const Address &getAddr(void) const { return addr; }
   const Address &getNaddr(void) const { return naddr; }
@@ -133,8 +136,9 @@ class ParserWalker {		// A class for walking the ParserContext
 protected:
   ConstructState *point;	// The current node being visited
   int4 depth;			// Depth of the current node
-  int4 breadcrumb[32];	// Path of operands from root
+  int4 breadcrumb[64];	// Path of operands from root
 public:
+  enum { max_depth = 63 };	// Deepest node the breadcrumbs can reach
   ParserWalker(const ParserContext *c) { const_context = c; cross_context = (const ParserContext *)0; }
   ParserWalker(const ParserContext *c,const ParserContext *cross) { const_context = c; cross_context = cross; }
   const ParserContext *getParserContext(void) const { return const_context; }
@@ -147,6 +151,7 @@ public:
     ConstructState *op=point->resolve[i]; return op->offset + op->length; }
   Constructor *getConstructor(void) const { return point->ct; }
   int4 getOperand(void) const { return breadcrumb[depth]; }
+  int4 getDepth(void) const { return depth; }
   FixedHandle &getParentHandle(void) { return point->hand; }
   const FixedHandle &getFixedHandle(int4 i) const { return point->resolve[i]->hand; }
   AddrSpace *getCurSpace(void) const { return const_context->getCurSpace(); }
@@ -157,6 +162,9 @@ public:
   const Address &getRefAddr(void) const { if (cross_context != (const ParserContext *)0) { return cross_context->getRefAddr();} return const_context->getRefAddr(); }
   const Address &getDestAddr(void) const { if (cross_context != (const ParserContext *)0) { return cross_context->getDestAddr();} return const_context->getDestAddr(); }
   int4 getLength(void) const { return const_context->getLength(); }
+  const uint1 *getInstructionBuffer(void) const { return const_context->buf; } ///< All 16 bytes of the instruction stream
+  const uintm *getContextWords(void) const { return const_context->context; } ///< Every word of the local context
+  int4 getContextSize(void) const { return const_context->contextsize; } ///< Number of words of the local context
   uintm getInstructionBytes(int4 byteoff,int4 numbytes) const {
     return const_context->getInstructionBytes(byteoff,numbytes,point->offset); }
   uintm getContextBytes(int4 byteoff,int4 numbytes) const {
@@ -0,0 +1,558 @@
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "decode_cache.hh"
+#include "error.hh"
+#include "sleigh.hh"
+
+/** \brief appends the assembly of one instruction to a `DecodedInsn` */
+class DecodedAsmEmitter : public ghidra::AssemblyEmit
+{
+  DecodedInsn &insn;
+
+public:
+  explicit DecodedAsmEmitter(DecodedInsn &out) : insn(out) {}
+
+  virtual void dump(const ghidra::Address &addr, const ghidra::string &mnem,
+                    const ghidra::string &body)
+  {
+    insn.text.assign(mnem);
+    insn.text.append(body);
+    insn.mnemonic_len = mnem.size();
+  }
+
+  virtual void dumpText(const ghidra::Address &addr, const char *mnem,
+                        ghidra::int4 mnemlen, const char *body,
+                        ghidra::int4 bodylen)
+  {
+    insn.text.assign(mnem, mnemlen);
+    insn.text.append(body, bodylen);
+    insn.mnemonic_len = mnemlen;
+  }
+};
+
+/** \brief appends the p-code of one instruction to a `DecodedInsn` */
+class DecodedPcodeEmitter : public ghidra::PcodeEmit
+{
+  DecodedInsn &insn;
+
+public:
+  explicit DecodedPcodeEmitter(DecodedInsn &out) : insn(out) {}
+
+  virtual void dump(const ghidra::Address &addr, ghidra::OpCode opcode,
+                    ghidra::VarnodeData *output, ghidra::VarnodeData *inputs,
+                    ghidra::int4 input_len)
+  {
+    DecodedOp op;
+    op.opcode = opcode;
+    op.output = DECODED_NO_OUTPUT;
+    if (output != nullptr)
+    {
+      op.output = insn.varnodes.size();
+      insn.varnodes.push_back(*output);
+    }
+
+    op.input_start = insn.varnodes.size();
+    op.input_len = input_len;
+    insn.varnodes.insert(insn.varnodes.end(), inputs, inputs + input_len);
+    insn.ops.push_back(op);
+  }
+
+  virtual void dumpOps(const ghidra::Address &addr, const ghidra::PcodeData *ops,
+                       ghidra::int4 count, const ghidra::VarnodeData *pool,
+                       ghidra::int4 pool_size)
+  {
+    // an op output can also be an input of the next op (pointer adds), so
+    // the pool plus one output per op bounds the varnodes that get copied
+    insn.ops.reserve(insn.ops.size() + count);
+    insn.varnodes.reserve(insn.varnodes.size() + pool_size + count);
+    for (ghidra::int4 i = 0; i < count; i++)
+    {
+      const ghidra::PcodeData &src = ops[i];
+      DecodedOp op;
+      op.opcode = src.opc;
+      op.output = DECODED_NO_OUTPUT;
+      if (src.outvar != nullptr)
+      {
+        op.output = insn.varnodes.size();
+        insn.varnodes.push_back(*src.outvar);
+      }
+
+      op.input_start = insn.varnodes.size();
+      op.input_len = src.isize;
+      insn.varnodes.insert(insn.varnodes.end(), src.invar, src.invar + src.isize);
+      insn.ops.push_back(op);
+    }
+  }
+};
+
+void DecodedInsn::clear(void)
+{
+  size = 0;
+  ops.clear();
+  varnodes.clear();
+  text.clear();
+  mnemonic_len = 0;
+}
+
+bool decode_insn(const ghidra::Translate &trans, const ghidra::Address &address,
+                 DecodedInsn &out, int parts)
+{
+  out.clear();
+
+  try
+  {
+    // bytes that don't decode are caught here without an exception
+    if (trans.tryInstructionLength(address) == 0)
+    {
+      return false;
+    }
+
+    if ((parts & DecodeText) != 0)
+    {
+      DecodedAsmEmitter asm_emitter(out);
+      out.size = trans.printAssembly(asm_emitter, address);
+    }
+    if ((parts & DecodePcode) != 0)
+    {
+      DecodedPcodeEmitter pcode_emitter(out);
+      out.size = trans.oneInstruction(pcode_emitter, address);
+    }
+  }
+  catch (ghidra::LowlevelError &err)
+  {
+    // covers both `BadDataError` and `UnimplError`
+    out.clear();
+  }
+
+  return out.size != 0;
+}
+
+void DecodeCache::set_capacity(size_t new_capacity)
+{
+  capacity = new_capacity;
+  while (entries.size() > capacity)
+  {
+    index.erase(entries.back().first);
+    entries.pop_back();
+  }
+}
+
+void DecodeCache::clear(void)
+{
+  entries.clear();
+  index.clear();
+}
+
+void DecodeCache::invalidate(uint64_t start, uint64_t end)
+{
+  for (EntryList::iterator it = entries.begin(); it != entries.end();)
+  {
+    uint64_t address = it->first;
+    uint64_t reach = address + (uint64_t)it->second.insn.size + DECODE_WINDOW;
+    if (address < end && start < reach)
+    {
+      index.erase(address);
+      it = entries.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+const CachedInsn *DecodeCache::find(uint64_t address)
+{
+  std::unordered_map<uint64_t, EntryList::iterator>::iterator it =
+      index.find(address);
+  if (it == index.end())
+  {
+    misses++;
+    return nullptr;
+  }
+
+  hits++;
+  entries.splice(entries.begin(), entries, it->second);
+  return &it->second->second;
+}
+
+CachedInsn &DecodeCache::insert(uint64_t address)
+{
+  std::unordered_map<uint64_t, EntryList::iterator>::iterator it =
+      index.find(address);
+  if (it != index.end())
+  {
+    entries.splice(entries.begin(), entries, it->second);
+  }
+  else if (entries.size() >= capacity && !entries.empty())
+  {
+    // recycle the least recently used entry, its vectors keep their storage
+    index.erase(entries.back().first);
+    entries.splice(entries.begin(), entries, std::prev(entries.end()));
+    entries.front().first = address;
+    index[address] = entries.begin();
+  }
+  else
+  {
+    entries.emplace_front(address, CachedInsn());
+    index[address] = entries.begin();
+  }
+
+  CachedInsn &out = entries.front().second;
+  out.insn.clear();
+  out.entry = nullptr;
+  out.relocs = nullptr;
+  return out;
+}
+
+/** \brief the offset of `vn` as if it moved by `delta` */
+static ghidra::uintb reloc_address(const ghidra::VarnodeData &vn,
+                                   ghidra::uintb delta)
+{
+  if (vn.space->getType() == ghidra::IPTR_CONSTANT)
+  {
+    return (vn.offset + delta) & ghidra::calc_mask(vn.size);
+  }
+  return vn.space->wrapOffset(vn.offset + delta);
+}
+
+/**
+ * \brief the offset of the temporary `vn` as if decoded at `to`: SLEIGH
+ * ORs the address bits under `mask` into the offsets of temporaries
+ */
+static ghidra::uintb reloc_unique(const ghidra::VarnodeData &vn,
+                                  ghidra::uint4 mask, ghidra::uintb to)
+{
+  ghidra::uintb bits = (ghidra::uintb)mask << 4;
+  return (vn.offset & ~bits) | ((to & mask) << 4);
+}
+
+/**
+ * \brief whether `lhs` and `rhs` have the same ops over the same varnode
+ * spaces + sizes, so they can only differ in the varnode offsets
+ */
+static bool same_shape(const DecodedInsn &lhs, const DecodedInsn &rhs)
+{
+  if (lhs.size != rhs.size || lhs.ops.size() != rhs.ops.size() ||
+      lhs.varnodes.size() != rhs.varnodes.size())
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < lhs.ops.size(); i++)
+  {
+    const DecodedOp &l = lhs.ops[i];
+    const DecodedOp &r = rhs.ops[i];
+    if (l.opcode != r.opcode || l.output != r.output ||
+        l.input_start != r.input_start || l.input_len != r.input_len)
+    {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < lhs.varnodes.size(); i++)
+  {
+    const ghidra::VarnodeData &l = lhs.varnodes[i];
+    const ghidra::VarnodeData &r = rhs.varnodes[i];
+    if (l.space != r.space || l.size != r.size)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void InsnInternTable::set_capacity(size_t new_capacity)
+{
+  capacity = new_capacity;
+  if (table.size() > capacity)
+  {
+    table.clear();
+  }
+}
+
+void InsnInternTable::clear(void) { table.clear(); }
+
+/** \brief whether `actual` has the same text as `expected` */
+static bool same_text(const DecodedInsn &expected, const DecodedInsn &actual)
+{
+  return actual.mnemonic_len == expected.mnemonic_len &&
+         actual.text == expected.text;
+}
+
+/**
+ * \brief decodes the instruction parsed at `address` as if it was at `to`
+ * into `out`, false if it can't be relocated
+ */
+bool InsnInternTable::probe(const ghidra::Sleigh &sleigh,
+                            const ghidra::Address &address, int parts,
+                            ghidra::uintb to, DecodedInsn &out) const
+{
+  out.clear();
+  try
+  {
+    DecodedAsmEmitter asm_emitter(out);
+    DecodedPcodeEmitter pcode_emitter(out);
+    out.size = sleigh.translateRelocated(
+        (parts & DecodePcode) != 0 ? &pcode_emitter : nullptr,
+        (parts & DecodeText) != 0 ? &asm_emitter : nullptr, address,
+        ghidra::Address(address.getSpace(), to));
+  }
+  catch (ghidra::LowlevelError &err)
+  {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Decodes the instruction of `entry` at two more addresses, and works out
+ * from the three decodes how each varnode moves with the address. The
+ * first probe is the next aligned address, which catches everything off of
+ * `inst_start`; the second moves every bit of the address, which catches
+ * masking (like the page of an `adrp`). Anything moving in some other way
+ * than `InternRelocKind` leaves the entry unshared.
+ */
+void InsnInternTable::intern(const ghidra::Sleigh &sleigh,
+                             const ghidra::Address &address, int parts,
+                             InternedInsn &entry)
+{
+  entry.shared = false;
+  entry.shared_text = true;
+  entry.relocs.clear();
+
+  const DecodedInsn &body = entry.body;
+  ghidra::AddrSpace *space = address.getSpace();
+  ghidra::uintb alignment = sleigh.getAlignment();
+  ghidra::uintb deltas[2] = {alignment, 0x5555555555555550ull + 3 * alignment};
+  ghidra::uintb probed[2];
+  for (int i = 0; i < 2; i++)
+  {
+    probed[i] = space->wrapOffset(address.getOffset() + deltas[i]);
+    if (!probe(sleigh, address, parts, probed[i], probes[i]) ||
+        !same_shape(body, probes[i]))
+    {
+      return;
+    }
+    entry.shared_text = entry.shared_text && same_text(body, probes[i]);
+  }
+
+  ghidra::uint4 unique_mask = sleigh.getUniqueAllocateMask();
+  ghidra::AddrSpace *unique = sleigh.getUniqueSpace();
+  for (size_t i = 0; i < body.varnodes.size(); i++)
+  {
+    const ghidra::VarnodeData &vn = body.varnodes[i];
+    bool fixed = true;
+    bool address_reloc = true;
+    bool unique_reloc = vn.space == unique && unique_mask != 0;
+    // the OR only relocates if no masked bit was set by the template itself,
+    // so every one of them has to be clear in one of the decodes
+    ghidra::uintb template_bits = vn.offset & ((ghidra::uintb)unique_mask << 4);
+    for (int j = 0; j < 2; j++)
+    {
+      ghidra::uintb moved = probes[j].varnodes[i].offset;
+      fixed = fixed && moved == vn.offset;
+      address_reloc = address_reloc && moved == reloc_address(vn, deltas[j]);
+      unique_reloc =
+          unique_reloc && moved == reloc_unique(vn, unique_mask, probed[j]);
+      template_bits &= moved;
+    }
+    unique_reloc = unique_reloc && template_bits == 0;
+
+    if (fixed)
+    {
+      continue;
+    }
+    if (address_reloc)
+    {
+      entry.relocs.push_back({(uint32_t)i, RelocAddress});
+    }
+    else if (unique_reloc)
+    {
+      entry.relocs.push_back({(uint32_t)i, RelocUnique});
+    }
+    else
+    {
+      entry.relocs.clear();
+      return;
+    }
+  }
+
+  entry.shared = true;
+}
+
+/**
+ * \brief whether the address relocation of `vn` from `from` to `to` keeps
+ * it in the same 64KB / 4GB window relative to the instruction. Address
+ * arithmetic can wrap at 16 or 32 bits inside of a wider space (the offset
+ * of a segment in real mode x86), off of `inst_start` or `inst_next`. Such a
+ * wrap always lands in the window of the instruction, so a moved offset that
+ * stays in the same window (relative to both ends of the instruction) is
+ * what the wrap gives too.
+ */
+static bool same_window(const ghidra::VarnodeData &vn, ghidra::uintb moved,
+                        ghidra::uintb from, ghidra::uintb to, int32_t size)
+{
+  int value_bits = vn.space->getType() == ghidra::IPTR_CONSTANT
+                       ? vn.size * 8
+                       : vn.space->getAddrSize() * 8;
+  for (int bits = 16; bits <= 32 && bits < value_bits; bits += 16)
+  {
+    if ((vn.offset >> bits) - (from >> bits) != (moved >> bits) - (to >> bits) ||
+        (vn.offset >> bits) - ((from + size) >> bits) !=
+            (moved >> bits) - ((to + size) >> bits))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool relocate_varnode(const ghidra::Sleigh &sleigh, uint32_t kind,
+                      uint64_t from, uint64_t to, int32_t size,
+                      ghidra::VarnodeData &vn)
+{
+  if (kind == RelocUnique)
+  {
+    vn.offset = reloc_unique(vn, sleigh.getUniqueAllocateMask(), to);
+    return true;
+  }
+
+  ghidra::uintb moved = reloc_address(vn, to - from);
+  if (!same_window(vn, moved, from, to, size))
+  {
+    return false;
+  }
+  vn.offset = moved;
+  return true;
+}
+
+/**
+ * \brief `entry` moved to `address` into `out`, false if an address it
+ * holds may have wrapped differently than at the address it was decoded at
+ */
+bool InsnInternTable::relocate(const ghidra::Sleigh &sleigh,
+                               const InternedInsn &entry,
+                               const ghidra::Address &address, int parts,
+                               DecodedInsn &out) const
+{
+  out.size = entry.body.size;
+  out.ops = entry.body.ops;
+  out.varnodes = entry.body.varnodes;
+
+  ghidra::uintb to = address.getOffset();
+  for (size_t i = 0; i < entry.relocs.size(); i++)
+  {
+    ghidra::VarnodeData &vn = out.varnodes[entry.relocs[i].varnode];
+    if (!relocate_varnode(sleigh, entry.relocs[i].kind, entry.address, to,
+                          entry.body.size, vn))
+    {
+      return false;
+    }
+  }
+
+  if (entry.shared_text)
+  {
+    out.text = entry.body.text;
+    out.mnemonic_len = entry.body.mnemonic_len;
+  }
+  else if ((parts & DecodeText) != 0)
+  {
+    DecodedAsmEmitter asm_emitter(out);
+    sleigh.printAssembly(asm_emitter, address);
+  }
+  return true;
+}
+
+const DecodedInsn &InsnInternTable::decode(const ghidra::Sleigh &sleigh,
+                                           const ghidra::Address &address,
+                                           int parts, DecodedInsn &scratch,
+                                           InternedInsn **entry)
+{
+  *entry = nullptr;
+  last_shared = nullptr;
+
+  ghidra::int4 length = 0;
+  if (capacity != 0 && address.getOffset() % sleigh.getAlignment() == 0)
+  {
+    try
+    {
+      length = sleigh.tryInstructionEncoding(address, key);
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      length = 0;
+    }
+  }
+  if (length == 0)
+  {
+    decode_insn(sleigh, address, scratch, parts);
+    return scratch;
+  }
+
+  std::unordered_map<std::string, InternedInsn>::iterator it = table.find(key);
+  if (it == table.end())
+  {
+    misses++;
+    if (!decode_insn(sleigh, address, scratch, parts) ||
+        table.size() >= capacity)
+    {
+      return scratch;
+    }
+
+    InternedInsn &interned = table[key];
+    interned.body = scratch;
+    interned.address = address.getOffset();
+    intern(sleigh, address, parts, interned);
+    if (interned.shared)
+    {
+      last_shared = &interned;
+    }
+    if (interned.shared && interned.relocs.empty())
+    {
+      *entry = &interned;
+    }
+    return scratch;
+  }
+
+  hits++;
+  InternedInsn &interned = it->second;
+  if (!interned.shared)
+  {
+    decode_insn(sleigh, address, scratch, parts);
+    return scratch;
+  }
+
+  try
+  {
+    if ((parts & DecodePcode) != 0)
+    {
+      sleigh.commitInstructionContext(address);
+    }
+    if (interned.relocs.empty() && interned.shared_text)
+    {
+      *entry = &interned;
+      last_shared = &interned;
+      return interned.body;
+    }
+    if (!relocate(sleigh, interned, address, parts, scratch))
+    {
+      decode_insn(sleigh, address, scratch, parts);
+      return scratch;
+    }
+  }
+  catch (ghidra::LowlevelError &err)
+  {
+    scratch.clear();
+    return scratch;
+  }
+  last_shared = &interned;
+  if (interned.relocs.empty())
+  {
+    *entry = &interned;
+  }
+  return scratch;
+}
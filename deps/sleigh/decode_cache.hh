@@ -0,0 +1,229 @@
+/// \file decode_cache.hh
+/// \brief Per-manager cache of decoded instructions
+///
+/// Gadget searches decode the same addresses over and over, every byte
+/// offset of a variable length ISA and every backward walk from a return.
+/// `DecodeCache` keeps the assembly + p-code of the most recently decoded
+/// addresses so a repeated lift is a hash lookup instead of resolving the
+/// constructors again.
+///
+/// A cached instruction is only valid for the bytes + context it was decoded
+/// with, the owner has to `clear()` the cache whenever either changes.
+///
+/// `InsnInternTable` goes further and keys instructions by their encoding
+/// instead of their address: firmware repeats the same prologues, epilogues
+/// and returns all over, and every repeat of an encoding gets the one body
+/// decoded for it first. Whatever part of the p-code depends on the address
+/// (`inst_start`, `inst_next`, the address bits of temporaries) is found by
+/// decoding the encoding at two more addresses, and patched through
+/// relocation slots instead of decoding again.
+#ifndef __DECODE_CACHE_HH__
+#define __DECODE_CACHE_HH__
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "translate.hh"
+
+namespace ghidra
+{
+class Sleigh;
+}
+
+/// Bytes SLEIGH reads at the address of an instruction to decode it
+#define DECODE_WINDOW 16
+
+/// Marks a `DecodedOp` that has no output varnode
+#define DECODED_NO_OUTPUT UINT32_MAX
+
+/// P-Code op of a `DecodedInsn`, indices are into `DecodedInsn::varnodes`
+struct DecodedOp
+{
+  ghidra::OpCode opcode;
+  uint32_t output; // or `DECODED_NO_OUTPUT`
+  uint32_t input_start;
+  uint32_t input_len;
+};
+
+/**
+ * \brief assembly + p-code of a single instruction, exactly as SLEIGH
+ * emitted them (so the space operand of `LOAD` / `STORE` is still an
+ * `AddrSpace` pointer)
+ */
+struct DecodedInsn
+{
+  int32_t size = 0; // 0 if nothing decodes at the address
+  std::vector<DecodedOp> ops;
+  std::vector<ghidra::VarnodeData> varnodes;
+  std::string text; // mnemonic immediately followed by the body
+  uint32_t mnemonic_len = 0;
+
+  void clear(void);
+};
+
+/// Which parts of a `DecodedInsn` `decode_insn` fills in
+enum DecodeParts
+{
+  DecodeText = 1,  // `text` + `mnemonic_len`
+  DecodePcode = 2, // `ops` + `varnodes`
+  DecodeAll = DecodeText | DecodePcode,
+};
+
+/**
+ * \brief decodes the `parts` of the instruction at `address` into `out`,
+ * returns false (leaving `out` empty with a `size` of 0) if it doesn't
+ * decode. Leaving out `DecodeText` skips `printAssembly` altogether.
+ */
+bool decode_insn(const ghidra::Translate &trans, const ghidra::Address &address,
+                 DecodedInsn &out, int parts = DecodeAll);
+
+struct InternedInsn;
+
+/**
+ * \brief a `DecodeCache` entry, with what `InsnInternTable::decode` said
+ * about the interned instruction it was decoded out of
+ */
+struct CachedInsn
+{
+  DecodedInsn insn;
+  InternedInsn *entry = nullptr;        // its `*entry`
+  const InternedInsn *relocs = nullptr; // its `last_shared`
+};
+
+/**
+ * \brief least recently used cache of address -> `DecodedInsn`, a capacity
+ * of 0 disables it. Entries point into the `InsnInternTable` they were
+ * decoded with, the owner has to `clear()` both together. Not thread safe,
+ * every manager owns its own.
+ */
+class DecodeCache
+{
+  typedef std::list<std::pair<uint64_t, CachedInsn>> EntryList;
+
+  EntryList entries; // most recently used first
+  std::unordered_map<uint64_t, EntryList::iterator> index;
+  size_t capacity = 0;
+
+public:
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+
+  size_t get_capacity(void) const { return capacity; }
+
+  /** \brief evicts the least recently used entries down to `new_capacity` */
+  void set_capacity(size_t new_capacity);
+
+  void clear(void);
+
+  /**
+   * \brief drops every instruction that may have decoded from a byte in
+   * `[start, end)`, reading a window past its end covers delay slots
+   */
+  void invalidate(uint64_t start, uint64_t end);
+
+  /** \brief the cached instruction at `address`, or null on a miss */
+  const CachedInsn *find(uint64_t address);
+
+  /**
+   * \brief makes room for `address` and returns its (cleared) entry to
+   * decode into, reusing the storage of the entry it evicts. The reference
+   * is valid until the next `insert`.
+   */
+  CachedInsn &insert(uint64_t address);
+};
+
+/// How a varnode of an `InternedInsn` moves with the address it is at
+enum InternRelocKind
+{
+  RelocAddress = 0, // the offset moves with the address
+  RelocUnique = 1,  // temporaries, carrying the address bits of the spec
+};
+
+/// Relocation slot of an `InternedInsn`
+struct InternReloc
+{
+  uint32_t varnode; // index into `DecodedInsn::varnodes`
+  uint32_t kind;    // `InternRelocKind`
+};
+
+/**
+ * \brief moves `vn` of an instruction of `size` bytes decoded at `from` to
+ * `to` the way `InternRelocKind` `kind` says, false if an address it holds
+ * may wrap differently at `to` (the instruction has to be decoded there)
+ */
+bool relocate_varnode(const ghidra::Sleigh &sleigh, uint32_t kind,
+                      uint64_t from, uint64_t to, int32_t size,
+                      ghidra::VarnodeData &vn);
+
+/**
+ * \brief decoded instruction shared by every address its encoding is at.
+ * The `range_*` members belong to the manager, see `lift_range`.
+ */
+struct InternedInsn
+{
+  DecodedInsn body; // as decoded at `address`
+  uint64_t address = 0;
+  // false if the address flows into the instruction some other way than
+  // through `relocs`, it is then always decoded again
+  bool shared = false;
+  bool shared_text = false; // the text doesn't depend on the address
+  std::vector<InternReloc> relocs;
+  uint64_t range_epoch = 0; // the last range lift the body went into
+  uint64_t range_op_start = 0;
+  uint64_t range_insn = 0; // index of the instruction, for its effects
+  uint64_t range_text_offset = 0;
+};
+
+/**
+ * \brief hash-consing table of decoded instructions, keyed by the bytes +
+ * context they decode from. Once `capacity` encodings are interned new ones
+ * are decoded without being kept, a capacity of 0 disables the table. Every
+ * entry was decoded with the same `parts`, the owner has to `clear()` the
+ * table when they change. Not thread safe, every manager owns its own.
+ */
+class InsnInternTable
+{
+  std::unordered_map<std::string, InternedInsn> table;
+  size_t capacity = 0;
+  std::string key;       // encoding of the instruction being decoded
+  DecodedInsn probes[2]; // the instruction decoded at other addresses
+
+  bool probe(const ghidra::Sleigh &sleigh, const ghidra::Address &address,
+             int parts, ghidra::uintb to, DecodedInsn &out) const;
+  void intern(const ghidra::Sleigh &sleigh, const ghidra::Address &address,
+              int parts, InternedInsn &entry);
+  bool relocate(const ghidra::Sleigh &sleigh, const InternedInsn &entry,
+                const ghidra::Address &address, int parts,
+                DecodedInsn &out) const;
+
+public:
+  uint64_t hits = 0;   // encodings found in the table
+  uint64_t misses = 0; // encodings decoded, interned or not
+  // the shared entry whose `relocs` hold for the p-code the last `decode`
+  // returned, null if it was decoded without one
+  const InternedInsn *last_shared = nullptr;
+
+  size_t get_capacity(void) const { return capacity; }
+  size_t size(void) const { return table.size(); }
+
+  /** \brief drops every entry if they no longer fit `new_capacity` */
+  void set_capacity(size_t new_capacity);
+
+  void clear(void);
+
+  /**
+   * \brief `decode_insn` of the instruction at `address` out of the table,
+   * either the interned body or `scratch` decoded / relocated into. `*entry`
+   * is set if the p-code returned is the one of an interned body that is the
+   * same at every address, null otherwise.
+   */
+  const DecodedInsn &decode(const ghidra::Sleigh &sleigh,
+                            const ghidra::Address &address, int parts,
+                            DecodedInsn &scratch, InternedInsn **entry);
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "decode_profile.hh"
+#include "sleighbase.hh"
+#include "slghsymbol.hh"
+
+void DecodeProfile::countResolve(const ghidra::SubtableSymbol *table,
+                                 const ghidra::Constructor *ct, int depth,
+                                 int candidates, uint64_t cycles)
+{
+  if ((size_t)depth >= depths.size())
+  {
+    depths.resize(depth + 1);
+  }
+  depths[depth].resolves += 1;
+  depths[depth].cycles += cycles;
+
+  Table &row = tables[table];
+  row.resolves += 1;
+  row.cycles += cycles;
+  row.depth += depth;
+  row.candidates += candidates;
+  if (ct == nullptr)
+  {
+    row.misses += 1;
+    return;
+  }
+
+  Match &match = constructors[ct];
+  match.matches += 1;
+  match.cycles += cycles;
+}
+
+void DecodeProfile::countContext(const ghidra::Constructor *ct, int changes,
+                                 uint64_t cycles)
+{
+  Match &match = constructors[ct];
+  match.context_applies += 1;
+  match.context_changes += changes;
+  match.context_cycles += cycles;
+}
+
+void DecodeProfile::merge(const DecodeProfile &other)
+{
+  if (other.depths.size() > depths.size())
+  {
+    depths.resize(other.depths.size());
+  }
+  for (size_t i = 0; i < other.depths.size(); i++)
+  {
+    depths[i].resolves += other.depths[i].resolves;
+    depths[i].cycles += other.depths[i].cycles;
+  }
+
+  for (const std::pair<const ghidra::SubtableSymbol *const, Table> &entry :
+       other.tables)
+  {
+    Table &row = tables[entry.first];
+    row.resolves += entry.second.resolves;
+    row.cycles += entry.second.cycles;
+    row.misses += entry.second.misses;
+    row.depth += entry.second.depth;
+    row.candidates += entry.second.candidates;
+  }
+  for (const std::pair<const ghidra::Constructor *const, Match> &entry :
+       other.constructors)
+  {
+    Match &match = constructors[entry.first];
+    match.matches += entry.second.matches;
+    match.cycles += entry.second.cycles;
+    match.context_applies += entry.second.context_applies;
+    match.context_changes += entry.second.context_changes;
+    match.context_cycles += entry.second.context_cycles;
+  }
+}
+
+void DecodeProfile::clear(void)
+{
+  depths.clear();
+  tables.clear();
+  constructors.clear();
+}
+
+/** \brief `value / count`, 0 for no count */
+static double per(uint64_t value, uint64_t count)
+{
+  return count == 0 ? 0.0 : (double)value / (double)count;
+}
+
+/** \brief appends the `printf` style `format` to `out` */
+static void append(std::string &out, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void append(std::string &out, const char *format, ...)
+{
+  char line[512];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (len > 0)
+  {
+    out.append(line, std::min<size_t>(len, sizeof(line) - 1));
+  }
+}
+
+/** \brief `subtable file:line` of `ct` */
+static std::string constructor_name(const ghidra::SleighBase &spec,
+                                    const ghidra::Constructor *ct)
+{
+  std::string file = spec.getSourceFile(ct->getSrcIndex());
+  size_t slash = file.find_last_of('/');
+  if (slash != std::string::npos)
+  {
+    file = file.substr(slash + 1);
+  }
+  char line[32];
+  snprintf(line, sizeof(line), ":%d", ct->getLineno());
+  return ct->getParent()->getName() + " " + file + line;
+}
+
+std::string DecodeProfile::report(const ghidra::SleighBase &spec) const
+{
+  std::string out;
+  uint64_t resolves = 0;
+  uint64_t cycles = 0;
+  for (size_t i = 0; i < depths.size(); i++)
+  {
+    resolves += depths[i].resolves;
+    cycles += depths[i].cycles;
+  }
+  append(out, "decode profile: %" PRIu64 " subtable resolves, %" PRIu64
+              " cycles\n",
+         resolves, cycles);
+
+  append(out, "\n%6s %12s %14s %10s\n", "depth", "resolves", "cycles",
+         "cyc/res");
+  for (size_t i = 0; i < depths.size(); i++)
+  {
+    if (depths[i].resolves == 0)
+    {
+      continue;
+    }
+    append(out, "%6zu %12" PRIu64 " %14" PRIu64 " %10.1f\n", i,
+           depths[i].resolves, depths[i].cycles,
+           per(depths[i].cycles, depths[i].resolves));
+  }
+
+  std::vector<std::pair<const ghidra::SubtableSymbol *, Table>> by_table(
+      tables.begin(), tables.end());
+  std::sort(by_table.begin(), by_table.end(),
+            [](const std::pair<const ghidra::SubtableSymbol *, Table> &lhs,
+               const std::pair<const ghidra::SubtableSymbol *, Table> &rhs)
+            { return lhs.second.cycles > rhs.second.cycles; });
+  append(out, "\n%-32s %12s %10s %14s %10s %9s %10s\n", "subtable",
+         "resolves", "misses", "cycles", "cyc/res", "depth", "candidates");
+  for (size_t i = 0; i < by_table.size() && i < DECODE_PROFILE_TOP; i++)
+  {
+    const Table &row = by_table[i].second;
+    append(out, "%-32s %12" PRIu64 " %10" PRIu64 " %14" PRIu64
+                " %10.1f %9.2f %10.2f\n",
+           by_table[i].first->getName().c_str(), row.resolves, row.misses,
+           row.cycles, per(row.cycles, row.resolves),
+           per(row.depth, row.resolves), per(row.candidates, row.resolves));
+  }
+
+  std::vector<std::pair<const ghidra::Constructor *, Match>> by_match(
+      constructors.begin(), constructors.end());
+  std::sort(by_match.begin(), by_match.end(),
+            [](const std::pair<const ghidra::Constructor *, Match> &lhs,
+               const std::pair<const ghidra::Constructor *, Match> &rhs)
+            { return lhs.second.cycles > rhs.second.cycles; });
+  append(out, "\n%-48s %12s %14s %10s\n", "constructor", "matches", "cycles",
+         "cyc/match");
+  for (size_t i = 0; i < by_match.size() && i < DECODE_PROFILE_TOP; i++)
+  {
+    const Match &match = by_match[i].second;
+    if (match.matches == 0)
+    {
+      break;
+    }
+    append(out, "%-48s %12" PRIu64 " %14" PRIu64 " %10.1f\n",
+           constructor_name(spec, by_match[i].first).c_str(), match.matches,
+           match.cycles, per(match.cycles, match.matches));
+  }
+
+  std::sort(by_match.begin(), by_match.end(),
+            [](const std::pair<const ghidra::Constructor *, Match> &lhs,
+               const std::pair<const ghidra::Constructor *, Match> &rhs)
+            { return lhs.second.context_cycles > rhs.second.context_cycles; });
+  append(out, "\n%-48s %12s %10s %14s %10s\n", "context changes of",
+         "applies", "changes", "cycles", "cyc/apply");
+  for (size_t i = 0; i < by_match.size() && i < DECODE_PROFILE_TOP; i++)
+  {
+    const Match &match = by_match[i].second;
+    if (match.context_applies == 0)
+    {
+      break;
+    }
+    append(out, "%-48s %12" PRIu64 " %10" PRIu64 " %14" PRIu64 " %10.1f\n",
+           constructor_name(spec, by_match[i].first).c_str(),
+           match.context_applies, match.context_changes, match.context_cycles,
+           per(match.context_cycles, match.context_applies));
+  }
+  return out;
+}
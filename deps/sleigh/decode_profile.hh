@@ -0,0 +1,89 @@
+/// \file decode_profile.hh
+/// \brief Where `Sleigh` spends its decoding, per subtable and constructor
+///
+/// Like the counters of `lift_stats.hh` this is only compiled in with
+/// `-DLIBSLA_STATS`, and is only counted while a `DecodeProfile` is set on
+/// the `Sleigh`. Every subtable resolved while building a parse tree is
+/// counted and timed along with how deep its decision tree went and how
+/// many candidate patterns the leaf it reached had to test, every
+/// constructor matched is counted with the cycles of the resolve that
+/// matched it, and the context changes of each constructor with the cycles
+/// applying them took. Parse trees found in the `DisassemblyCache` are
+/// never resolved, so only decodes that missed it show up.
+///
+/// Constructors are keyed by pointer, so profiles of managers sharing one
+/// spec (forks) can be merged.
+#ifndef __DECODE_PROFILE_HH__
+#define __DECODE_PROFILE_HH__
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ghidra
+{
+class Constructor;
+class SleighBase;
+class SubtableSymbol;
+} // namespace ghidra
+
+/// Rows of each table `DecodeProfile::report` prints, the hottest first
+#define DECODE_PROFILE_TOP 40
+
+/** \brief decoding counted by a `Sleigh`, see the file docs */
+struct DecodeProfile
+{
+  /** \brief resolves of one decision depth */
+  struct Depth
+  {
+    uint64_t resolves = 0;
+    uint64_t cycles = 0;
+  };
+
+  /** \brief resolves of one subtable */
+  struct Table
+  {
+    uint64_t resolves = 0;
+    uint64_t cycles = 0;
+    uint64_t misses = 0;     // resolves nothing matched
+    uint64_t depth = 0;      // summed over every resolve
+    uint64_t candidates = 0; // candidate patterns of the leaves reached
+  };
+
+  /** \brief matches of one constructor */
+  struct Match
+  {
+    uint64_t matches = 0;
+    uint64_t cycles = 0; // of the resolves that matched it
+    uint64_t context_applies = 0;
+    uint64_t context_changes = 0; // `ContextChange`s applied
+    uint64_t context_cycles = 0;
+  };
+
+  std::vector<Depth> depths; // indexed by the depth of the decision tree
+  std::unordered_map<const ghidra::SubtableSymbol *, Table> tables;
+  std::unordered_map<const ghidra::Constructor *, Match> constructors;
+
+  /** \brief counts one resolve of `table`, `ct` is what matched or null */
+  void countResolve(const ghidra::SubtableSymbol *table,
+                    const ghidra::Constructor *ct, int depth, int candidates,
+                    uint64_t cycles);
+
+  /** \brief counts applying the `changes` context changes of `ct` */
+  void countContext(const ghidra::Constructor *ct, int changes,
+                    uint64_t cycles);
+
+  /** \brief adds everything `other` counted, both must be of one spec */
+  void merge(const DecodeProfile &other);
+
+  void clear(void);
+
+  /**
+   * \brief renders the profile as text tables, naming the constructors by
+   * subtable and spec source line of `spec`
+   */
+  std::string report(const ghidra::SleighBase &spec) const;
+};
+
+#endif
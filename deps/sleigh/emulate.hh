@@ -435,6 +435,11 @@ inline Address EmulatePcodeCache::getExecuteAddress(void) const
   by caching memory \e pages.  Any write creates an aligned page to hold the new data.  The class
   takes care of loading and filling in pages as needed.
 
+  A MemoryPageTable does the same, but finds its pages through a radix table and remembers the
+  last page touched instead of searching a map on every access.  Pages that are only read point
+  straight at the bytes of the bank under it when that bank holds them in place (the LoadImage
+  of a MemoryImage, or another MemoryPageTable), so stacks of them are cheap to read through.
+
   Here is an example of instantiating a MemoryState and registering memory banks for a
   \e ram space which is initialized with the load image. The \e ram space is implemented
   with the MemoryPageOverlay, and the \e register space and the \e temporary space are implemented
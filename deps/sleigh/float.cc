@@ -17,7 +17,10 @@
 #include "float.hh"
 #include "address.hh"
 
+#include <atomic>
+#include <cfloat>
 #include <cmath>
+#include <cstring>
 #include <limits>
 
 namespace ghidra {
@@ -31,6 +34,9 @@ using std::ceil;
 using std::round;
 using std::fabs;
 
+/// Whether formats set up from now on look for a matching host type
+static std::atomic<bool> hostformats(true);
+
 /// Set format for a given encoding size according to IEEE 754 standards
 /// \param sz is the size of the encoding in bytes
 FloatFormat::FloatFormat(int4 sz)
@@ -58,6 +64,7 @@ FloatFormat::FloatFormat(int4 sz)
   }
   maxexponent = (1<<exp_size)-1;
   calcPrecision();
+  calcHostFormat();
 }
 
 /// \param sign is set to \b true if the value should be negative
@@ -221,11 +228,90 @@ void FloatFormat::calcPrecision(void)
   decimal_precision = (int4)floor(val + 0.5);
 }
 
+/// The format must match binary32 or binary64 field for field, and the host
+/// type must be IEEE 754 itself, for the bits to be reinterpreted directly.
+void FloatFormat::calcHostFormat(void)
+
+{
+  hosttype = host_none;
+  if (!hostformats.load(std::memory_order_relaxed))
+    return;
+  if (frac_pos != 0 || !jbitimplied)
+    return;
+  if (size == 4 && std::numeric_limits<float>::is_iec559) {
+    if (signbit_pos == 31 && exp_pos == 23 && exp_size == 8 && frac_size == 23 && bias == 127)
+      hosttype = host_float;
+  }
+  else if (size == 8 && std::numeric_limits<double>::is_iec559) {
+    if (signbit_pos == 63 && exp_pos == 52 && exp_size == 11 && frac_size == 52 && bias == 1023)
+      hosttype = host_double;
+  }
+}
+
+/// Formats set up before the call keep the conversions they had.  This is on by
+/// default, turning it off keeps every format on the generic conversions.
+/// \param val is \b true to use host conversions for matching formats
+void FloatFormat::setHostFormats(bool val)
+
+{
+  hostformats.store(val,std::memory_order_relaxed);
+}
+
+/// \brief Reinterpret an encoding as the host type \b T and widen it to double
+///
+/// NaNs come back as the same quiet NaN as from the generic conversion, so
+/// payloads never leak into results.
+/// \param encoding is the encoded value
+/// \param type passes back the floating-point class
+/// \return the equivalent double value
+template<typename T,typename B>
+static inline double hostToDouble(uintb encoding,FloatFormat::floatclass *type)
+
+{
+  B bits = (B)encoding;
+  T val;
+  memcpy(&val,&bits,sizeof(T));
+  switch(std::fpclassify(val)) {
+  case FP_ZERO:
+    *type = FloatFormat::zero;
+    break;
+  case FP_SUBNORMAL:
+    *type = FloatFormat::denormalized;
+    break;
+  case FP_INFINITE:
+    *type = FloatFormat::infinity;
+    break;
+  case FP_NAN:
+    {
+      *type = FloatFormat::nan;
+      double nan = std::numeric_limits<double>::quiet_NaN();
+      return signbit(val) ? -nan : +nan;
+    }
+  default:
+    *type = FloatFormat::normalized;
+    break;
+  }
+  return (double)val;
+}
+
 /// \param encoding is the encoding value
 /// \param type points to the floating-point class, which is passed back
 /// \return the equivalent double value
 double FloatFormat::getHostFloat(uintb encoding,floatclass *type) const
 
+{
+  if (hosttype == host_double)
+    return hostToDouble<double,uint8>(encoding,type);
+  if (hosttype == host_float)
+    return hostToDouble<float,uint4>(encoding,type);
+  return getHostFloatGeneric(encoding,type);
+}
+
+/// \param encoding is the encoding value
+/// \param type points to the floating-point class, which is passed back
+/// \return the equivalent double value
+double FloatFormat::getHostFloatGeneric(uintb encoding,floatclass *type) const
+
 {
   bool sgn = extractSign(encoding);
   uintb frac = extractFractionalCode(encoding);
@@ -287,10 +373,38 @@ bool FloatFormat::roundToNearestEven(uintb &signif, int4 lowbitpos)
 }
 
 
+/// A binary64 format takes the bits of the double as they are.  A binary32
+/// format lets the host round into float, which rounds to nearest even like
+/// the generic conversion does, except for results below the normal range
+/// where they can differ: those (zero aside) go through the generic code.
+/// NaNs become the same quiet NaN as from the generic conversion.
 /// \param host is the double value to convert
 /// \return the equivalent encoded value
 uintb FloatFormat::getEncoding(double host) const
 
+{
+  if (hosttype != host_none) {
+    if (std::isnan(host))
+      return getNaNEncoding(signbit(host));
+    if (hosttype == host_double) {
+      uint8 bits;
+      memcpy(&bits,&host,sizeof(bits));
+      return bits;
+    }
+    if (fabs(host) >= FLT_MIN || host == 0.0) {
+      float val = (float)host;
+      uint4 bits;
+      memcpy(&bits,&val,sizeof(bits));
+      return bits;
+    }
+  }
+  return getEncodingGeneric(host);
+}
+
+/// \param host is the double value to convert
+/// \return the equivalent encoded value
+uintb FloatFormat::getEncodingGeneric(double host) const
+
 {
   floatclass type;
   bool sgn;
@@ -352,6 +466,10 @@ uintb FloatFormat::convertEncoding(uintb encoding,
 				   const FloatFormat *formin) const
 
 {
+  if (hosttype != host_none && formin->hosttype != host_none) {
+    floatclass type;	// Widening to double is exact, so this rounds once
+    return getEncoding(formin->getHostFloat(encoding,&type));
+  }
   bool sgn = formin->extractSign(encoding);
   uintb signif = formin->extractFractionalCode(encoding);
   int4 exp = formin->extractExponentCode(encoding);
@@ -688,6 +806,7 @@ void FloatFormat::restoreXml(const Element *el)
   jbitimplied = xml_readbool(el->getAttributeValue("jbitimplied"));
   maxexponent = (1<<exp_size)-1;
   calcPrecision();
+  calcHostFormat();
 }
 
 } // End namespace ghidra
@@ -29,6 +29,13 @@ namespace ghidra {
 /// An encoding can be converted to and from the host format and
 /// convenience methods allow p-code floating-point operations to be
 /// performed on natively encoded operands.  This follows the IEEE754 standards.
+///
+/// A format laid out exactly like the host's binary32 or binary64 is noted
+/// when it is set up, and converts by reinterpreting the bits instead of
+/// taking the encoding apart.  The results are the same as the generic
+/// conversions, which stay in use for every other format, except for the sign
+/// of a NaN an operation produces: IEEE 754 leaves it open, and the compiler
+/// may arrange either path so the host picks a different one.
 class FloatFormat {
 public:
   /// \brief The various classes of floating-point encodings
@@ -40,6 +47,12 @@ public:
     denormalized = 4		///< A denormalized encoding (for very small values)
   };
 private:
+  /// \brief The host type a format has the same encoding as
+  enum hostformat {
+    host_none = 0,		///< Not a host type, conversions use the generic code
+    host_float = 1,		///< Encoded the same as \b float (IEEE 754 binary32)
+    host_double = 2		///< Encoded the same as \b double (IEEE 754 binary64)
+  };
   int4 size;			///< Size of float in bytes (this format)
   int4 signbit_pos;		///< Bit position of sign bit
   int4 frac_pos;		///< (lowest) bit position of fractional part
@@ -50,6 +63,7 @@ private:
   int4 maxexponent;		///< Maximum possible exponent
   int4 decimal_precision;	///< Number of decimal digits of precision
   bool jbitimplied;		///< Set to \b true if integer bit of 1 is assumed
+  hostformat hosttype;		///< Host type with the same encoding, if any
   static double createFloat(bool sign,uintb signif,int4 exp);	 ///< Create a double given sign, fractional, and exponent
   static floatclass extractExpSig(double x,bool *sgn,uintb *signif,int4 *exp);
   static bool roundToNearestEven(uintb &signif, int4 lowbitpos);
@@ -60,6 +74,9 @@ private:
   uintb getInfinityEncoding(bool sgn) const;			///< Get an encoded infinite value
   uintb getNaNEncoding(bool sgn) const;				///< Get an encoded NaN value
   void calcPrecision(void);					///< Calculate the decimal precision of this format
+  void calcHostFormat(void);					///< Determine if \b this is encoded like a host type
+  double getHostFloatGeneric(uintb encoding,floatclass *type) const;	///< Convert an encoding to double, field by field
+  uintb getEncodingGeneric(double host) const;			///< Convert a double to \b this encoding, field by field
 public:
   FloatFormat(void) {}	///< Construct for use with restoreXml()
   FloatFormat(int4 sz);	///< Construct default IEEE 754 standard settings
@@ -68,6 +85,8 @@ public:
   uintb getEncoding(double host) const;				///< Convert host's double into \b this encoding
   int4 getDecimalPrecision(void) const { return decimal_precision; }	///< Get number of digits of precision
   uintb convertEncoding(uintb encoding,const FloatFormat *formin) const;	///< Convert between two different formats
+  bool isHostFormat(void) const { return (hosttype != host_none); }	///< Is \b this encoded like a host type
+  static void setHostFormats(bool val);			///< Set whether formats set up afterward may use host conversions
 
   uintb extractFractionalCode(uintb x) const;			///< Extract the fractional part of the encoding
   bool extractSign(uintb x) const;				///< Extract the sign bit from the encoding
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 #include "globalcontext.hh"
+#include "lift_stats.hh"
 
 namespace ghidra {
 
@@ -559,6 +560,7 @@ ContextCache::ContextCache(ContextDatabase *db)
   database = db;
   curspace = (AddrSpace *)0;	// Mark cache as invalid
   allowset = true;
+  stats = (LiftStats *)0;
 }
 
 /// Check if the address is in the current valid range. If it is, return the cached
@@ -569,9 +571,12 @@ void ContextCache::getContext(const Address &addr,uintm *buf) const
 
 {
   if ((addr.getSpace()!=curspace)||(first>addr.getOffset())||(last<addr.getOffset())) {
+    LIFT_STATS_ADD(stats,context_cache_misses,1);
     curspace = addr.getSpace();
     context = database->getContext(addr,first,last);
   }
+  else
+    LIFT_STATS_ADD(stats,context_cache_hits,1);
   for(int4 i=0;i<database->getContextSize();++i)
     buf[i] = context[i];
 }
@@ -22,6 +22,8 @@
 #include "pcoderaw.hh"
 #include "partmap.hh"
 
+struct LiftStats;
+
 namespace ghidra {
 
 extern ElementId ELEM_CONTEXT_DATA;	///< Marshaling element \<context_data>
@@ -300,6 +302,14 @@ public:
   virtual const uintm *getContext(const Address &addr) const { return database.getValue(addr).array; }
   virtual const uintm *getContext(const Address &addr,uintb &first,uintb &last) const;
 
+  /// \brief Look up context blobs through a flat array of the current split points
+  ///
+  /// Meant for once the context has been set up and lifting starts. The next context change
+  /// point (or region) that gets introduced goes back to the tree lookups.
+  void freeze(void) { database.freeze(); }
+  bool isFrozen(void) const { return database.isFrozen(); }	///< Return \b true if the context is frozen
+  void clearRegions(void) { database.clear(); }		///< Drop every split point, keeping the default blob
+
   virtual TrackedSet &getTrackedDefault(void) { return trackbase.defaultValue(); }
   virtual const TrackedSet &getTrackedSet(const Address &addr) const { return trackbase.getValue(addr); }
   virtual TrackedSet &createSet(const Address &addr1,const Address &addr2);
@@ -321,10 +331,13 @@ class ContextCache {
   mutable uintb first;			///< Starting offset of the current valid range
   mutable uintb last;			///< Ending offset of the current valid range
   mutable const uintm *context;		///< The current cached context blob
+  LiftStats *stats;			///< Where hits and misses are counted (or null)
 public:
   ContextCache(ContextDatabase *db);	///< Construct given a context database
   ContextDatabase *getDatabase(void) const { return database; }		///< Retrieve the encapsulated database object
   void allowSet(bool val) { allowset = val; }		///< Toggle whether setContext() calls are ignored
+  void invalidate(void) { curspace = (AddrSpace *)0; }	///< Drop the cached blob, the database changed underneath it
+  void setStats(LiftStats *s) { stats = s; }		///< Count hits and misses of getContext() in \e s
   void getContext(const Address &addr,uintm *buf) const;	///< Retrieve the context blob for the given address
   void setContext(const Address &addr,int4 num,uintm mask,uintm value);
   void setContext(const Address &addr1,const Address &addr2,int4 num,uintm mask,uintm value);
@@ -0,0 +1,229 @@
+#include <cstring>
+
+#include "insn_effects.hh"
+
+static bool overlaps(const ghidra::VarnodeData &lhs,
+                     const ghidra::VarnodeData &rhs)
+{
+  return lhs.space == rhs.space && lhs.offset < rhs.offset + rhs.size &&
+         rhs.offset < lhs.offset + lhs.size;
+}
+
+static bool same(const ghidra::VarnodeData &lhs, const ghidra::VarnodeData &rhs)
+{
+  return lhs.space == rhs.space && lhs.offset == rhs.offset &&
+         lhs.size == rhs.size;
+}
+
+/** \brief `value` of `size` bytes, sign extended */
+static int64_t sign_extend(uint64_t value, uint32_t size)
+{
+  if (size == 0 || size >= 8)
+  {
+    return (int64_t)value;
+  }
+  uint32_t shift = 64 - 8 * size;
+  return (int64_t)(value << shift) >> shift;
+}
+
+static uint32_t flag_of(ghidra::OpCode opcode)
+{
+  switch (opcode)
+  {
+  case ghidra::CPUI_COPY:
+    return 0;
+  case ghidra::CPUI_LOAD:
+    return EFFECT_LOAD;
+  case ghidra::CPUI_STORE:
+    return EFFECT_STORE;
+  case ghidra::CPUI_BRANCH:
+  case ghidra::CPUI_CBRANCH:
+  case ghidra::CPUI_BRANCHIND:
+    return EFFECT_BRANCH;
+  case ghidra::CPUI_CALL:
+  case ghidra::CPUI_CALLIND:
+    return EFFECT_CALL;
+  case ghidra::CPUI_RETURN:
+    return EFFECT_RETURN;
+  case ghidra::CPUI_CALLOTHER:
+    return EFFECT_CALLOTHER;
+  default:
+    return EFFECT_COMPUTE;
+  }
+}
+
+void EffectBuilder::reset(const RegisterTable *table)
+{
+  registers = table;
+  has_stack_pointer = table != nullptr &&
+                      table->get_stack_pointer() != REGISTER_NONE;
+  if (has_stack_pointer)
+  {
+    stack_pointer = table->varnode(table->get_stack_pointer());
+  }
+}
+
+EffectBuilder::Value EffectBuilder::input(const ghidra::VarnodeData &vn) const
+{
+  for (size_t i = written.size(); i-- > 0;)
+  {
+    if (same(written[i].vn, vn))
+    {
+      return written[i].value;
+    }
+    if (overlaps(written[i].vn, vn))
+    {
+      return Value{Value::unknown, 0};
+    }
+  }
+  if (has_stack_pointer && same(vn, stack_pointer))
+  {
+    return Value{Value::stack, 0};
+  }
+  if (vn.space->getType() == ghidra::IPTR_CONSTANT)
+  {
+    return Value{Value::constant, vn.offset};
+  }
+  return Value{Value::unknown, 0};
+}
+
+/**
+ * \brief value of the output of `op`, following the stack pointer through
+ * copies + constant adds and subtracts like `GadgetEffects` does
+ */
+EffectBuilder::Value EffectBuilder::evaluate(const DecodedInsn &insn,
+                                             const DecodedOp &op) const
+{
+  const ghidra::VarnodeData *in = &insn.varnodes[op.input_start];
+  switch (op.opcode)
+  {
+  case ghidra::CPUI_COPY:
+  case ghidra::CPUI_INT_ZEXT:
+  case ghidra::CPUI_INT_SEXT:
+  case ghidra::CPUI_SUBPIECE:
+  {
+    Value value = input(in[0]);
+    // only the full width copy keeps a stack address intact
+    if (op.opcode != ghidra::CPUI_COPY && value.kind == Value::stack)
+    {
+      return Value{Value::unknown, 0};
+    }
+    return value;
+  }
+  case ghidra::CPUI_INT_ADD:
+  case ghidra::CPUI_INT_SUB:
+  {
+    if (op.input_len != 2)
+    {
+      return Value{Value::unknown, 0};
+    }
+    Value lhs = input(in[0]);
+    Value rhs = input(in[1]);
+    bool negate = op.opcode == ghidra::CPUI_INT_SUB;
+    if (lhs.kind == Value::stack && rhs.kind == Value::constant)
+    {
+      uint64_t delta = sign_extend(rhs.value, in[1].size);
+      return Value{Value::stack, negate ? lhs.value - delta : lhs.value + delta};
+    }
+    if (!negate && lhs.kind == Value::constant && rhs.kind == Value::stack)
+    {
+      return Value{Value::stack,
+                   rhs.value + (uint64_t)sign_extend(lhs.value, in[0].size)};
+    }
+    if (lhs.kind == Value::constant && rhs.kind == Value::constant)
+    {
+      return Value{Value::constant,
+                   negate ? lhs.value - rhs.value : lhs.value + rhs.value};
+    }
+    return Value{Value::unknown, 0};
+  }
+  default:
+    return Value{Value::unknown, 0};
+  }
+}
+
+/** \brief true if the instruction already wrote all of `vn` */
+bool EffectBuilder::covered(const ghidra::VarnodeData &vn) const
+{
+  for (const Written &entry : written)
+  {
+    if (entry.vn.space == vn.space && entry.vn.offset <= vn.offset &&
+        vn.offset + vn.size <= entry.vn.offset + entry.vn.size)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void EffectBuilder::assign(const ghidra::VarnodeData &vn, Value value)
+{
+  for (Written &entry : written)
+  {
+    if (same(entry.vn, vn))
+    {
+      entry.value = value;
+      return;
+    }
+  }
+  written.push_back(Written{vn, value});
+}
+
+void EffectBuilder::build(const DecodedInsn &insn, InsnEffects &out)
+{
+  memset(&out, 0, sizeof(out));
+  out.sp_delta = EFFECT_SP_UNKNOWN;
+  if (registers == nullptr)
+  {
+    return;
+  }
+
+  written.clear();
+  int32_t space = registers->get_space_index();
+  bool sp_clobbered = false;
+  for (const DecodedOp &op : insn.ops)
+  {
+    uint32_t flag = flag_of(op.opcode);
+    out.flags |= flag;
+    if ((flag & (EFFECT_BRANCH | EFFECT_CALL | EFFECT_RETURN)) != 0)
+    {
+      out.terminator = op.opcode;
+    }
+
+    for (uint32_t i = 0; i < op.input_len; i++)
+    {
+      const ghidra::VarnodeData &vn = insn.varnodes[op.input_start + i];
+      if (vn.space->getIndex() == space && !covered(vn))
+      {
+        registers->mark(space, vn.offset, vn.size, out.reads);
+      }
+    }
+
+    if (op.output == DECODED_NO_OUTPUT)
+    {
+      continue;
+    }
+    const ghidra::VarnodeData &vn = insn.varnodes[op.output];
+    Value value = evaluate(insn, op);
+    if (vn.space->getIndex() == space)
+    {
+      registers->mark(space, vn.offset, vn.size, out.writes);
+      if (has_stack_pointer && overlaps(vn, stack_pointer))
+      {
+        out.flags |= EFFECT_WRITE_SP;
+        sp_clobbered = sp_clobbered || !same(vn, stack_pointer);
+      }
+    }
+    assign(vn, value);
+  }
+
+  if (!has_stack_pointer || sp_clobbered)
+  {
+    return;
+  }
+  Value sp = input(stack_pointer);
+  if (sp.kind == Value::stack)
+  {
+    out.sp_delta = (int64_t)sp.value;
+  }
+}
@@ -0,0 +1,103 @@
+/// \file insn_effects.hh
+/// \brief What a lifted instruction does, summed up as it is emitted
+///
+/// Gadget searches ask the same few questions of every instruction: which
+/// registers does it read and write, does it touch memory, how does it end
+/// and how far does it move the stack pointer. Answering them from the
+/// p-code means walking every op and comparing every varnode, once per
+/// question. An `InsnEffects` answers all of them with fixed size records:
+/// bitsets indexed by the effect slots of the spec's `RegisterTable`, so a
+/// filter over a run of instructions is a few ANDs + ORs of words.
+///
+/// The bitsets are exact for every register with a slot of its own. Bit
+/// `EFFECT_SLOT_OTHER` means the instruction touches some register past
+/// those, the p-code has to be looked at to tell which.
+#ifndef __INSN_EFFECTS_HH__
+#define __INSN_EFFECTS_HH__
+
+#include <cstdint>
+#include <vector>
+
+#include "decode_cache.hh"
+#include "register_table.hh"
+
+/// Words of an effect bitset
+#define EFFECT_WORDS (EFFECT_SLOTS / 64)
+
+/// `InsnEffects::sp_delta` when the stack pointer doesn't move by a constant
+#define EFFECT_SP_UNKNOWN INT64_MIN
+
+/// `InsnEffects::flags`
+enum
+{
+  EFFECT_LOAD = 1 << 0,
+  EFFECT_STORE = 1 << 1,
+  /// `BRANCH`, `CBRANCH` or `BRANCHIND`
+  EFFECT_BRANCH = 1 << 2,
+  /// `CALL` or `CALLIND`
+  EFFECT_CALL = 1 << 3,
+  EFFECT_RETURN = 1 << 4,
+  EFFECT_CALLOTHER = 1 << 5,
+  /// any op besides `COPY`, `LOAD`, `STORE` and the ones above
+  EFFECT_COMPUTE = 1 << 6,
+  /// writes (part of) the stack pointer
+  EFFECT_WRITE_SP = 1 << 7,
+};
+
+/// Effects of one lifted instruction
+struct InsnEffects
+{
+  /// registers read before the instruction writes them
+  uint64_t reads[EFFECT_WORDS];
+  uint64_t writes[EFFECT_WORDS];
+  /// how far the stack pointer moves, `EFFECT_SP_UNKNOWN` if that isn't
+  /// a constant
+  int64_t sp_delta;
+  uint32_t flags;
+  /// `ghidra::OpCode` of the last branch, call or return, 0 if there is none
+  uint32_t terminator;
+};
+
+/**
+ * \brief sums up decoded instructions of one spec, reuses its scratch space
+ * across instructions. Not thread safe, every manager owns its own.
+ */
+class EffectBuilder
+{
+  // a constant, or the stack pointer on entry plus `value`
+  struct Value
+  {
+    enum
+    {
+      unknown,
+      constant,
+      stack
+    } kind;
+    uint64_t value;
+  };
+
+  struct Written
+  {
+    ghidra::VarnodeData vn;
+    Value value;
+  };
+
+  const RegisterTable *registers = nullptr;
+  ghidra::VarnodeData stack_pointer;
+  bool has_stack_pointer = false;
+  std::vector<Written> written;
+
+  Value input(const ghidra::VarnodeData &vn) const;
+  Value evaluate(const DecodedInsn &insn, const DecodedOp &op) const;
+  bool covered(const ghidra::VarnodeData &vn) const;
+  void assign(const ghidra::VarnodeData &vn, Value value);
+
+public:
+  /** \brief sums up instructions lifted with the spec `table` belongs to */
+  void reset(const RegisterTable *table);
+
+  /** \brief sums up the p-code of `insn` into `out` */
+  void build(const DecodedInsn &insn, InsnEffects &out);
+};
+
+#endif
@@ -0,0 +1,791 @@
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error.hh"
+#include "lane_emulator.hh"
+#include "translate.hh"
+
+/// Word size of every memory bank, the widest value p-code reads in one go
+#define LANE_WORD_SIZE 8
+
+/// Page size of the banks over the loaded image
+#define LANE_IMAGE_PAGE_SIZE 4096
+
+/// Page size of every other bank, small since every lane has its own
+#define LANE_STATE_PAGE_SIZE 256
+
+/// Most bytes of a register space kept flat, every lane has a copy so
+/// anything past it is paged instead
+#define LANE_MAX_FLAT_SIZE (1 << 16)
+
+/// Most relative branches a single instruction may take before it is
+/// treated as looping forever
+#define LANE_MAX_INSN_BRANCHES 0x10000
+
+/// Largest chunk handed to a `MemoryState` at once, it takes an `int4` size
+#define LANE_MAX_CHUNK (1 << 30)
+
+/// Longest instruction checked against the bytes a lane wrote, like
+/// `INTERP_MAX_INSN_BYTES`
+#define LANE_MAX_INSN_BYTES 32
+
+/** \brief true for the spaces that hold machine state (so not constants) */
+static bool is_state_space(const ghidra::AddrSpace *space)
+{
+  return space != nullptr && (space->getType() == ghidra::IPTR_PROCESSOR ||
+                              space->getType() == ghidra::IPTR_INTERNAL);
+}
+
+LaneEmulator::LaneInsn::~LaneInsn(void)
+{
+  for (size_t i = 0; i < ops.size(); i++)
+  {
+    delete ops[i];
+  }
+  for (size_t i = 0; i < varnodes.size(); i++)
+  {
+    delete varnodes[i];
+  }
+}
+
+LaneEmulator::LaneEmulator(ghidra::Translate *t, ghidra::LoadImage *ld,
+                           uint32_t count)
+    : trans(t), loader(ld)
+{
+  if (count == 0 || count > LANE_MAX_LANES)
+  {
+    throw ghidra::LowlevelError("Bad lane count");
+  }
+
+  ghidra::OpBehavior::registerInstructions(inst, trans);
+
+  images.resize(trans->numSpaces());
+  flat_sizes.resize(trans->numSpaces());
+  for (int32_t i = 0; i < trans->numSpaces(); i++)
+  {
+    ghidra::AddrSpace *space = trans->getSpace(i);
+    if (space != nullptr && (space == trans->getDefaultCodeSpace() ||
+                             space == trans->getDefaultDataSpace()))
+    {
+      images[i].reset(new ghidra::MemoryImage(space, LANE_WORD_SIZE,
+                                              LANE_IMAGE_PAGE_SIZE, loader));
+    }
+    else if (is_state_space(space))
+    {
+      uint64_t extent = space == trans->getUniqueSpace()
+                            ? LANE_SCRATCH_SIZE
+                            : ghidra::MemoryFlatBank::getExtent(trans, space);
+      flat_sizes[i] = std::min<uint64_t>(extent, LANE_MAX_FLAT_SIZE);
+    }
+  }
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    lanes.emplace_back(new Lane(trans));
+    reset_lane(*lanes.back());
+  }
+}
+
+LaneEmulator::~LaneEmulator(void)
+{
+  for (size_t i = 0; i < inst.size(); i++)
+  {
+    delete inst[i];
+  }
+}
+
+void LaneEmulator::reset_lane(Lane &state)
+{
+  state.banks.clear();
+  state.flats.assign(trans->numSpaces(), nullptr);
+  state.image_banks.clear();
+  state.stored_start = UINT64_MAX;
+  state.stored_end = 0;
+  for (int32_t i = 0; i < trans->numSpaces(); i++)
+  {
+    ghidra::AddrSpace *space = trans->getSpace(i);
+    if (!is_state_space(space))
+    {
+      continue;
+    }
+
+    if (images[i] != nullptr)
+    {
+      state.image_banks.push_back(new ghidra::MemoryPageTable(
+          space, LANE_WORD_SIZE, LANE_IMAGE_PAGE_SIZE, images[i].get()));
+      state.banks.emplace_back(state.image_banks.back());
+      state.state.setMemoryBank(state.banks.back().get());
+      continue;
+    }
+
+    state.banks.emplace_back(new ghidra::MemoryPageTable(
+        space, LANE_WORD_SIZE, LANE_STATE_PAGE_SIZE, nullptr));
+    if (flat_sizes[i] > 0)
+    {
+      // anything past the flat bytes spills to the paged bank
+      ghidra::MemoryBank *spill = state.banks.back().get();
+      state.flats[i] = new ghidra::MemoryFlatBank(
+          space, LANE_WORD_SIZE, LANE_STATE_PAGE_SIZE, flat_sizes[i], spill);
+      state.banks.emplace_back(state.flats[i]);
+    }
+    state.state.setMemoryBank(state.banks.back().get());
+  }
+}
+
+LaneEmulator::Lane &LaneEmulator::lane(uint32_t index) const
+{
+  if (index >= lanes.size())
+  {
+    throw ghidra::LowlevelError("Bad lane index");
+  }
+
+  return *lanes[index];
+}
+
+/** \brief the varnode of the register `name`, throws if it isn't 1 - 8 bytes */
+static const ghidra::VarnodeData &scalar_register(ghidra::Translate *trans,
+                                                  const std::string &name)
+{
+  const ghidra::VarnodeData &vn = trans->getRegister(name);
+  if (vn.size == 0 || vn.size > sizeof(uint64_t))
+  {
+    throw ghidra::LowlevelError("Register " + name + " is wider than 8 bytes");
+  }
+
+  return vn;
+}
+
+void LaneEmulator::set_register(uint32_t index, const std::string &name,
+                                uint64_t value)
+{
+  const ghidra::VarnodeData &vn = scalar_register(trans, name);
+  lane(index).state.setValue(vn.space, vn.offset, vn.size, value);
+}
+
+uint64_t LaneEmulator::get_register(uint32_t index,
+                                    const std::string &name) const
+{
+  const ghidra::VarnodeData &vn = scalar_register(trans, name);
+  return lane(index).state.getValue(vn.space, vn.offset, vn.size);
+}
+
+void LaneEmulator::write_memory(uint32_t index, uint64_t address,
+                                const uint8_t *data, uint64_t size)
+{
+  Lane &target = lane(index);
+  ghidra::MemoryState &state = target.state;
+  ghidra::AddrSpace *space = trans->getDefaultDataSpace();
+  note_write(target, space, address, size);
+  while (size > 0)
+  {
+    int32_t chunk = std::min<uint64_t>(size, LANE_MAX_CHUNK);
+    state.setChunk(data, space, address, chunk);
+    address += chunk;
+    data += chunk;
+    size -= chunk;
+  }
+}
+
+void LaneEmulator::read_memory(uint32_t index, uint64_t address, uint8_t *out,
+                               uint64_t size) const
+{
+  const ghidra::MemoryState &state = lane(index).state;
+  ghidra::AddrSpace *space = trans->getDefaultDataSpace();
+  while (size > 0)
+  {
+    int32_t chunk = std::min<uint64_t>(size, LANE_MAX_CHUNK);
+    state.getChunk(out, space, address, chunk);
+    address += chunk;
+    out += chunk;
+    size -= chunk;
+  }
+}
+
+void LaneEmulator::clear(void)
+{
+  for (size_t i = 0; i < lanes.size(); i++)
+  {
+    reset_lane(*lanes[i]);
+  }
+}
+
+void LaneEmulator::flush_code(void)
+{
+  code.clear();
+  for (size_t i = 0; i < lanes.size(); i++)
+  {
+    for (ghidra::MemoryPageTable *bank : lanes[i]->image_banks)
+    {
+      bank->flushUnwritten();
+    }
+  }
+}
+
+LaneEmulator::LaneInsn &LaneEmulator::decode(uint64_t address)
+{
+  std::unordered_map<uint64_t, std::unique_ptr<LaneInsn>>::iterator it =
+      code.find(address);
+  if (it != code.end())
+  {
+    return *it->second;
+  }
+
+  std::unique_ptr<LaneInsn> insn(new LaneInsn);
+  ghidra::PcodeEmitCache emit(insn->ops, insn->varnodes, inst, 0);
+  insn->length = trans->oneInstruction(
+      emit, ghidra::Address(trans->getDefaultCodeSpace(), address));
+  pack_uniques(*insn);
+
+  LaneInsn &out = *insn;
+  code[address] = std::move(insn);
+  return out;
+}
+
+void LaneEmulator::pack_uniques(LaneInsn &insn) const
+{
+  ghidra::AddrSpace *unique = trans->getUniqueSpace();
+  std::vector<std::pair<uint64_t, uint64_t>> spans; // [start, end)
+  for (size_t i = 0; i < insn.varnodes.size(); i++)
+  {
+    const ghidra::VarnodeData *vn = insn.varnodes[i];
+    if (vn->space == unique)
+    {
+      spans.emplace_back(vn->offset, vn->offset + vn->size);
+    }
+  }
+  std::sort(spans.begin(), spans.end());
+
+  // merge the overlapping spans, which `SUBPIECE`s of a temporary make
+  size_t merged = 0;
+  for (size_t i = 0; i < spans.size(); i++)
+  {
+    if (merged > 0 && spans[i].first < spans[merged - 1].second)
+    {
+      spans[merged - 1].second =
+          std::max(spans[merged - 1].second, spans[i].second);
+      continue;
+    }
+    spans[merged++] = spans[i];
+  }
+  spans.resize(merged);
+
+  std::vector<uint64_t> slots(spans.size());
+  uint64_t slot = 0;
+  for (size_t i = 0; i < spans.size(); i++)
+  {
+    slots[i] = slot;
+    slot += spans[i].second - spans[i].first;
+  }
+  if (slot > LANE_SCRATCH_SIZE)
+  {
+    // doesn't fit, leave it to the paged bank
+    return;
+  }
+
+  for (size_t i = 0; i < insn.varnodes.size(); i++)
+  {
+    ghidra::VarnodeData *vn = insn.varnodes[i];
+    if (vn->space != unique)
+    {
+      continue;
+    }
+    std::pair<uint64_t, uint64_t> key(vn->offset, UINT64_MAX);
+    size_t span = std::upper_bound(spans.begin(), spans.end(), key) -
+                  spans.begin() - 1;
+    vn->offset = slots[span] + vn->offset - spans[span].first;
+  }
+}
+
+void LaneEmulator::gather(const LaneGroup &group,
+                          const ghidra::VarnodeData *vn,
+                          std::vector<ghidra::uintb> &values) const
+{
+  values.resize(group.lanes.size());
+  if (vn->space->getType() == ghidra::IPTR_CONSTANT)
+  {
+    std::fill(values.begin(), values.end(), vn->offset);
+    return;
+  }
+
+  int32_t space = vn->space->getIndex();
+  if (vn->offset + vn->size <= flat_sizes[space])
+  {
+    bool big_endian = vn->space->isBigEndian();
+    for (size_t i = 0; i < group.lanes.size(); i++)
+    {
+      const uint8_t *bytes = lanes[group.lanes[i]]->flats[space]->getData();
+      values[i] = ghidra::MemoryFlatBank::loadValue(bytes + vn->offset,
+                                                    vn->size, big_endian);
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < group.lanes.size(); i++)
+  {
+    values[i] = lanes[group.lanes[i]]->state.getValue(vn->space, vn->offset,
+                                                      vn->size);
+  }
+}
+
+void LaneEmulator::scatter(const LaneGroup &group,
+                           const ghidra::VarnodeData *vn,
+                           const std::vector<ghidra::uintb> &values)
+{
+  int32_t space = vn->space->getIndex();
+  if (vn->offset + vn->size <= flat_sizes[space])
+  {
+    bool big_endian = vn->space->isBigEndian();
+    for (size_t i = 0; i < group.lanes.size(); i++)
+    {
+      uint8_t *bytes = lanes[group.lanes[i]]->flats[space]->getData();
+      ghidra::MemoryFlatBank::storeValue(bytes + vn->offset, values[i],
+                                         vn->size, big_endian);
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < group.lanes.size(); i++)
+  {
+    lanes[group.lanes[i]]->state.setValue(vn->space, vn->offset, vn->size,
+                                          values[i]);
+  }
+}
+
+void LaneEmulator::note_write(Lane &state, const ghidra::AddrSpace *space,
+                              uint64_t offset, uint64_t size) const
+{
+  if (space != trans->getDefaultCodeSpace() || size == 0)
+  {
+    return;
+  }
+
+  state.stored_start = std::min(state.stored_start, offset);
+  state.stored_end = std::max(state.stored_end, offset + size);
+}
+
+void LaneEmulator::check_image(LaneGroup &group, const LaneInsn &insn,
+                               EmulateResult *results) const
+{
+  uint64_t end = group.address + insn.length;
+  uint8_t decoded[LANE_MAX_INSN_BYTES];
+  uint8_t memory[LANE_MAX_INSN_BYTES];
+  bool loaded = false;
+  std::vector<uint8_t> dead;
+  for (size_t i = 0; i < group.lanes.size(); i++)
+  {
+    Lane &state = *lanes[group.lanes[i]];
+    if (state.stored_start >= end || group.address >= state.stored_end)
+    {
+      continue;
+    }
+
+    ghidra::AddrSpace *space = trans->getDefaultCodeSpace();
+    if (!loaded)
+    {
+      loader->loadFill(decoded, insn.length,
+                       ghidra::Address(space, group.address));
+      loaded = true;
+    }
+    state.state.getChunk(memory, space, group.address, insn.length);
+    if (!std::equal(decoded, decoded + insn.length, memory))
+    {
+      dead.resize(group.lanes.size(), 0);
+      dead[i] = 1;
+    }
+  }
+  if (!dead.empty())
+  {
+    drop(group, dead, StopFault, results);
+  }
+}
+
+void LaneEmulator::drop(LaneGroup &group, const std::vector<uint8_t> &dead,
+                        uint32_t stop, EmulateResult *results) const
+{
+  size_t kept = 0;
+  for (size_t i = 0; i < group.lanes.size(); i++)
+  {
+    if (!dead[i])
+    {
+      group.lanes[kept++] = group.lanes[i];
+      continue;
+    }
+
+    EmulateResult &result = results[group.lanes[i]];
+    result.stop = stop;
+    result.insn_count = group.insn_count;
+    result.address = group.address;
+    result.target = 0;
+  }
+  group.lanes.resize(kept);
+}
+
+void LaneEmulator::stop_all(LaneGroup &group, uint32_t stop,
+                            EmulateResult *results) const
+{
+  drop(group, std::vector<uint8_t>(group.lanes.size(), 1), stop, results);
+}
+
+void LaneEmulator::run(uint64_t address, uint64_t max_insns,
+                       EmulateResult *results)
+{
+  LaneGroup all;
+  all.address = address;
+  all.op = 0;
+  all.started = false;
+  all.branches = 0;
+  all.insn_count = 0;
+  for (uint32_t i = 0; i < lanes.size(); i++)
+  {
+    all.lanes.push_back(i);
+    results[i].stop = StopInsnLimit;
+    results[i].insn_count = 0;
+    results[i].address = address;
+    results[i].target = 0;
+  }
+
+  std::vector<LaneGroup> pending;
+  pending.push_back(std::move(all));
+  while (!pending.empty())
+  {
+    LaneGroup group = std::move(pending.back());
+    pending.pop_back();
+    run_group(group, max_insns, pending, results);
+  }
+}
+
+void LaneEmulator::run_group(LaneGroup &group, uint64_t max_insns,
+                             std::vector<LaneGroup> &pending,
+                             EmulateResult *results)
+{
+  while (!group.lanes.empty())
+  {
+    if (!group.started)
+    {
+      if (group.insn_count == max_insns)
+      {
+        stop_all(group, StopInsnLimit, results);
+        return;
+      }
+      group.started = true;
+      group.branches = 0;
+      group.insn_count++;
+    }
+
+    LaneInsn *insn;
+    try
+    {
+      insn = &decode(group.address);
+    }
+    catch (ghidra::BadDataError &err)
+    {
+      // thrown while decoding the instruction, so it didn't start
+      group.insn_count--;
+      stop_all(group, StopBadInsn, results);
+      return;
+    }
+    catch (ghidra::UnimplError &err)
+    {
+      group.insn_count--;
+      stop_all(group, StopBadInsn, results);
+      return;
+    }
+    catch (ghidra::LowlevelError &err)
+    {
+      stop_all(group, StopFault, results);
+      return;
+    }
+    if (group.op == 0 && insn->length > 0 &&
+        insn->length <= LANE_MAX_INSN_BYTES)
+    {
+      check_image(group, *insn, results);
+      if (group.lanes.empty())
+      {
+        return;
+      }
+    }
+
+    LaneFlow flow = LaneNext;
+    while (group.op < insn->ops.size())
+    {
+      try
+      {
+        flow = run_op(group, insn->ops[group.op], *insn, pending, results);
+      }
+      catch (ghidra::LowlevelError &err)
+      {
+        // something no lane can get past, like an unmapped space
+        flow = LaneDone;
+        stop_all(group, StopFault, results);
+      }
+
+      if (flow == LaneNext)
+      {
+        group.op++;
+      }
+      else if (flow != LaneJump)
+      {
+        break;
+      }
+    }
+
+    if (flow == LaneDone || group.lanes.empty())
+    {
+      return;
+    }
+    if (flow != LaneLeave)
+    {
+      group.address += insn->length;
+    }
+    group.op = 0;
+    group.started = false;
+  }
+}
+
+LaneEmulator::LaneFlow LaneEmulator::branch(LaneGroup &group,
+                                            const ghidra::PcodeOpRaw *op,
+                                            const LaneInsn &insn) const
+{
+  const ghidra::VarnodeData *dest = op->getInput(0);
+  if (op->getOpcode() == ghidra::CPUI_CALL ||
+      dest->space->getType() != ghidra::IPTR_CONSTANT)
+  {
+    group.address = dest->offset;
+    return LaneLeave;
+  }
+
+  // relative to this op, one past the end falls through
+  uint32_t target = group.op + (ghidra::uintm)dest->offset;
+  if (target > insn.ops.size())
+  {
+    throw ghidra::LowlevelError("Bad intra-instruction branch");
+  }
+  if (++group.branches > LANE_MAX_INSN_BRANCHES)
+  {
+    throw ghidra::LowlevelError("Instruction branched too many times");
+  }
+  group.op = target;
+  return LaneJump;
+}
+
+LaneEmulator::LaneFlow LaneEmulator::run_op(LaneGroup &group,
+                                            const ghidra::PcodeOpRaw *op,
+                                            const LaneInsn &insn,
+                                            std::vector<LaneGroup> &pending,
+                                            EmulateResult *results)
+{
+  ghidra::OpCode opcode = op->getOpcode();
+  const ghidra::VarnodeData *output = op->getOutput();
+  size_t count = group.lanes.size();
+
+  if (opcode == ghidra::CPUI_CALLOTHER)
+  {
+    stop_all(group, StopUserOp, results);
+    return LaneDone;
+  }
+
+  // the values of every other op have to fit a `uintb`
+  bool too_wide = output != nullptr && output->size > sizeof(uint64_t);
+  for (int32_t i = 0; i < op->numInput(); i++)
+  {
+    too_wide = too_wide || op->getInput(i)->size > sizeof(uint64_t);
+  }
+  if (too_wide)
+  {
+    stop_all(group, StopFault, results);
+    return LaneDone;
+  }
+
+  switch (opcode)
+  {
+  case ghidra::CPUI_LOAD:
+  case ghidra::CPUI_STORE:
+  {
+    // addresses differ between lanes, so these go one lane at a time
+    ghidra::AddrSpace *space = op->getInput(0)->getSpaceFromConst();
+    gather(group, op->getInput(1), in1);
+    if (opcode == ghidra::CPUI_STORE)
+    {
+      gather(group, op->getInput(2), in2);
+    }
+
+    std::vector<uint8_t> dead(count, 0);
+    bool any_dead = false;
+    for (size_t i = 0; i < count; i++)
+    {
+      ghidra::MemoryState &state = lanes[group.lanes[i]]->state;
+      ghidra::uintb offset =
+          ghidra::AddrSpace::addressToByte(in1[i], space->getWordSize());
+      try
+      {
+        if (opcode == ghidra::CPUI_LOAD)
+        {
+          state.setValue(output, state.getValue(space, offset, output->size));
+        }
+        else
+        {
+          state.setValue(space, offset, op->getInput(2)->size, in2[i]);
+          note_write(*lanes[group.lanes[i]], space, offset,
+                     op->getInput(2)->size);
+        }
+      }
+      catch (ghidra::LowlevelError &err)
+      {
+        dead[i] = 1;
+        any_dead = true;
+      }
+    }
+    if (any_dead)
+    {
+      drop(group, dead, StopFault, results);
+    }
+    return group.lanes.empty() ? LaneDone : LaneNext;
+  }
+  case ghidra::CPUI_BRANCH:
+  case ghidra::CPUI_CALL:
+    return branch(group, op, insn);
+  case ghidra::CPUI_CBRANCH:
+  {
+    gather(group, op->getInput(1), in1);
+    LaneGroup taken;
+    taken.address = group.address;
+    taken.op = group.op;
+    taken.started = group.started;
+    taken.branches = group.branches;
+    taken.insn_count = group.insn_count;
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      if (in1[i] != 0)
+      {
+        taken.lanes.push_back(group.lanes[i]);
+      }
+      else
+      {
+        group.lanes[kept++] = group.lanes[i];
+      }
+    }
+    group.lanes.resize(kept);
+
+    if (group.lanes.empty())
+    {
+      // every lane agrees, so the whole group branches
+      group.lanes.swap(taken.lanes);
+      return branch(group, op, insn);
+    }
+    if (!taken.lanes.empty())
+    {
+      // the lanes that took it carry on later from wherever it goes
+      try
+      {
+        if (branch(taken, op, insn) == LaneLeave)
+        {
+          taken.op = 0;
+          taken.started = false;
+        }
+        pending.push_back(std::move(taken));
+      }
+      catch (ghidra::LowlevelError &err)
+      {
+        stop_all(taken, StopFault, results);
+      }
+    }
+    return LaneNext;
+  }
+  case ghidra::CPUI_BRANCHIND:
+  case ghidra::CPUI_CALLIND:
+  case ghidra::CPUI_RETURN:
+    // the destination is left undecoded since it is usually whatever the
+    // gadget loaded
+    gather(group, op->getInput(0), in1);
+    for (size_t i = 0; i < count; i++)
+    {
+      EmulateResult &result = results[group.lanes[i]];
+      result.stop = StopBranch;
+      result.insn_count = group.insn_count;
+      result.address = group.address;
+      result.target = in1[i];
+    }
+    group.lanes.clear();
+    return LaneDone;
+  case ghidra::CPUI_MULTIEQUAL:
+  case ghidra::CPUI_INDIRECT:
+  case ghidra::CPUI_SEGMENTOP:
+  case ghidra::CPUI_CPOOLREF:
+  case ghidra::CPUI_NEW:
+    stop_all(group, StopFault, results);
+    return LaneDone;
+  default:
+    break;
+  }
+
+  const ghidra::OpBehavior *behave = op->getBehavior();
+  if (behave == nullptr)
+  {
+    // `Emulate` runs ops without a behavior as a no-op
+    return LaneNext;
+  }
+  if (behave->isSpecial() || output == nullptr)
+  {
+    stop_all(group, StopFault, results);
+    return LaneDone;
+  }
+
+  int32_t sizeout = output->size;
+  int32_t sizein = op->getInput(0)->size;
+  bool unary = behave->isUnary();
+  gather(group, op->getInput(0), in1);
+  if (!unary)
+  {
+    gather(group, op->getInput(1), in2);
+  }
+  out.resize(count);
+
+  try
+  {
+    if (unary)
+    {
+      behave->evaluateUnaryN(sizeout, sizein, in1.data(), out.data(), count);
+    }
+    else
+    {
+      behave->evaluateBinaryN(sizeout, sizein, in1.data(), in2.data(),
+                              out.data(), count);
+    }
+  }
+  catch (ghidra::LowlevelError &err)
+  {
+    // only some of the lanes fault (a divide by 0, say), find which
+    std::vector<uint8_t> dead(count, 0);
+    for (size_t i = 0; i < count; i++)
+    {
+      try
+      {
+        out[i] = unary ? behave->evaluateUnary(sizeout, sizein, in1[i])
+                       : behave->evaluateBinary(sizeout, sizein, in1[i], in2[i]);
+      }
+      catch (ghidra::LowlevelError &err)
+      {
+        dead[i] = 1;
+      }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      if (!dead[i])
+      {
+        out[kept++] = out[i];
+      }
+    }
+    out.resize(kept);
+    drop(group, dead, StopFault, results);
+  }
+
+  scatter(group, output, out);
+  return group.lanes.empty() ? LaneDone : LaneNext;
+}
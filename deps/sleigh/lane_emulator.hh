@@ -0,0 +1,179 @@
+/// \file lane_emulator.hh
+/// \brief P-Code emulator running one gadget over many machine states at once
+///
+/// Checking what a gadget does means running it from thousands of seed
+/// states. `LaneEmulator` keeps one state per lane and runs them in
+/// lockstep: each instruction is decoded once and cached, and each op gathers
+/// its inputs from every lane into an array and evaluates them all with one
+/// `OpBehavior::evaluateBinaryN`/`evaluateUnaryN` call. Lanes that disagree
+/// on a conditional branch are split into groups that carry on separately,
+/// so every lane runs exactly what it would have run on its own.
+///
+/// Lanes keep the low bytes of the register space and the packed `unique`
+/// space of the running instruction flat, so gathering an operand is one
+/// load per lane. Every lane starts out as the loaded image with all registers 0, and
+/// keeps whatever runs write until `clear`. Like `SnapshotEmulator` the
+/// instructions are decoded through the `Translate` the emulator was built
+/// on, it must be used from the same thread and not outlive it. SLEIGH
+/// decodes the image, so a lane that wrote over the bytes of an instruction
+/// stops with `StopFault` when it gets there, just like `PcodeInterpreter`.
+#ifndef __LANE_EMULATOR_HH__
+#define __LANE_EMULATOR_HH__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "emulate.hh"
+#include "loadimage.hh"
+#include "memstate.hh"
+#include "snapshot_emulator.hh"
+
+/// Most lanes a `LaneEmulator` can have
+#define LANE_MAX_LANES 0x10000
+
+/// Bytes of `unique` space a lane keeps flat. The `unique` varnodes of each
+/// instruction are packed from offset 0 when decoded, so an instruction only
+/// goes through the paged bank if it uses more than this.
+#define LANE_SCRATCH_SIZE 0x1000
+
+/**
+ * \brief emulates one sequence of instructions from many states at once,
+ * see the file docs
+ */
+class LaneEmulator
+{
+  /** \brief the machine state of one lane */
+  struct Lane
+  {
+    ghidra::MemoryState state;
+    std::vector<std::unique_ptr<ghidra::MemoryBank>> banks;
+    // indexed by space, the flat bank on top of it or null
+    std::vector<ghidra::MemoryFlatBank *> flats;
+    // the banks over the loaded image, which borrow its pages
+    std::vector<ghidra::MemoryPageTable *> image_banks;
+    // bounds of every write to the default code space, the instructions in
+    // them are checked against the image before they run
+    uint64_t stored_start = UINT64_MAX;
+    uint64_t stored_end = 0;
+
+    explicit Lane(ghidra::Translate *trans) : state(trans) {}
+  };
+
+  /** \brief the p-code of one instruction */
+  struct LaneInsn
+  {
+    uint64_t length;
+    std::vector<ghidra::PcodeOpRaw *> ops;
+    std::vector<ghidra::VarnodeData *> varnodes;
+
+    ~LaneInsn(void);
+  };
+
+  /** \brief lanes running in lockstep, from op `op` of the instruction at `address` */
+  struct LaneGroup
+  {
+    uint64_t address;
+    uint32_t op;
+    bool started;      // the instruction at `address` was counted already
+    uint64_t branches; // relative branches taken within it
+    uint64_t insn_count;
+    std::vector<uint32_t> lanes;
+  };
+
+  /** \brief where a group goes after `run_op` */
+  enum LaneFlow
+  {
+    LaneNext,   // the next op
+    LaneJump,   // `op` was set to another op of the same instruction
+    LaneLeave,  // `address` was set to another instruction
+    LaneDone,   // every lane of the group stopped
+  };
+
+  ghidra::Translate *trans;
+  ghidra::LoadImage *loader;
+  std::vector<ghidra::OpBehavior *> inst;
+  // indexed by space, the loaded image under the default code + data spaces
+  std::vector<std::unique_ptr<ghidra::MemoryBank>> images;
+  std::vector<std::unique_ptr<Lane>> lanes;
+  // indexed by space, the bytes every lane keeps flat, 0 for none
+  std::vector<uint64_t> flat_sizes;
+  std::unordered_map<uint64_t, std::unique_ptr<LaneInsn>> code;
+  // gather/scatter arrays, one element per lane of the running group
+  std::vector<ghidra::uintb> in1, in2, out;
+
+  Lane &lane(uint32_t index) const;
+  void reset_lane(Lane &state);
+  LaneInsn &decode(uint64_t address);
+  void pack_uniques(LaneInsn &insn) const;
+
+  /** \brief runs `group` until every lane of it stops, pushes the groups it splits off */
+  void run_group(LaneGroup &group, uint64_t max_insns,
+                 std::vector<LaneGroup> &pending, EmulateResult *results);
+
+  /** \brief carries out one op for every lane of `group`, see `run_group` */
+  LaneFlow run_op(LaneGroup &group, const ghidra::PcodeOpRaw *op,
+                  const LaneInsn &insn, std::vector<LaneGroup> &pending,
+                  EmulateResult *results);
+
+  /** \brief takes the branch of `op` for every lane of `group` */
+  LaneFlow branch(LaneGroup &group, const ghidra::PcodeOpRaw *op,
+                  const LaneInsn &insn) const;
+
+  /** \brief reads/writes `vn` of every lane of `group`, one element each */
+  void gather(const LaneGroup &group, const ghidra::VarnodeData *vn,
+              std::vector<ghidra::uintb> &values) const;
+  void scatter(const LaneGroup &group, const ghidra::VarnodeData *vn,
+               const std::vector<ghidra::uintb> &values);
+
+  /** \brief notes a write of `[offset, offset + size)` to `space` by `state` */
+  void note_write(Lane &state, const ghidra::AddrSpace *space, uint64_t offset,
+                  uint64_t size) const;
+
+  /**
+   * \brief stops the lanes of `group` whose memory no longer holds the
+   * image bytes of `insn`, which SLEIGH decoded it from
+   */
+  void check_image(LaneGroup &group, const LaneInsn &insn,
+                   EmulateResult *results) const;
+
+  /** \brief stops the lanes of `group` flagged in `dead` and drops them */
+  void drop(LaneGroup &group, const std::vector<uint8_t> &dead, uint32_t stop,
+            EmulateResult *results) const;
+  void stop_all(LaneGroup &group, uint32_t stop, EmulateResult *results) const;
+
+public:
+  LaneEmulator(ghidra::Translate *t, ghidra::LoadImage *ld, uint32_t count);
+  ~LaneEmulator(void);
+
+  uint32_t lane_count(void) const { return lanes.size(); }
+
+  /** \brief the same as those of `SnapshotEmulator`, for the lane `index` */
+  void set_register(uint32_t index, const std::string &name, uint64_t value);
+  uint64_t get_register(uint32_t index, const std::string &name) const;
+  void write_memory(uint32_t index, uint64_t address, const uint8_t *data,
+                    uint64_t size);
+  void read_memory(uint32_t index, uint64_t address, uint8_t *out,
+                   uint64_t size) const;
+
+  /** \brief drops every write to every lane */
+  void clear(void);
+
+  /**
+   * \brief drops every decoded instruction and every image page read, for
+   * when the image or context changes
+   */
+  void flush_code(void);
+
+  /**
+   * \brief runs every lane from `address` like `SnapshotEmulator::run`,
+   * filling `results[lane]` for each. Never throws, a lane that faults
+   * stops on its own while the others carry on.
+   */
+  void run(uint64_t address, uint64_t max_insns, EmulateResult *results);
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include <cstring>
+
+#include "lift_arena.hh"
+
+LiftArena::~LiftArena(void)
+{
+  for (uint8_t *chunk : chunks)
+  {
+    delete[] chunk;
+  }
+}
+
+void *LiftArena::allocate_chunk(size_t size, size_t align)
+{
+  // each chunk at least doubles the arena, so a burst settles after a few
+  size_t chunk_size = total != 0 ? total : LIFT_ARENA_CHUNK_SIZE;
+  while (chunk_size < size + align)
+  {
+    chunk_size *= 2;
+  }
+
+  uint8_t *chunk = new uint8_t[chunk_size];
+  chunks.push_back(chunk);
+  chunk_sizes.push_back(chunk_size);
+  total += chunk_size;
+  cur = chunk;
+  end = chunk + chunk_size;
+  return allocate(size, align);
+}
+
+void LiftArena::reset(void)
+{
+  if (chunks.size() > 1)
+  {
+    for (uint8_t *chunk : chunks)
+    {
+      delete[] chunk;
+    }
+    chunks.clear();
+    chunk_sizes.clear();
+    chunks.push_back(new uint8_t[total]);
+    chunk_sizes.push_back(total);
+  }
+
+  if (chunks.empty())
+  {
+    cur = end = nullptr;
+    return;
+  }
+  cur = chunks[0];
+  end = chunks[0] + chunk_sizes[0];
+}
+
+ArenaStreamBuf::ArenaStreamBuf(LiftArena &a, size_t reserve) : arena(a)
+{
+  char *start = (char *)arena.allocate(reserve, 1);
+  setp(start, start + reserve);
+}
+
+void ArenaStreamBuf::grow(size_t needed)
+{
+  size_t used = size();
+  size_t new_size = (epptr() - pbase()) * 2;
+  if (new_size == 0)
+  {
+    new_size = 64;
+  }
+  while (new_size < used + needed)
+  {
+    new_size *= 2;
+  }
+
+  char *start = (char *)arena.allocate(new_size, 1);
+  memcpy(start, pbase(), used);
+  setp(start, start + new_size);
+  pbump(used);
+}
+
+ArenaStreamBuf::int_type ArenaStreamBuf::overflow(int_type c)
+{
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+  {
+    return traits_type::not_eof(c);
+  }
+  grow(1);
+  *pptr() = traits_type::to_char_type(c);
+  pbump(1);
+  return c;
+}
+
+std::streamsize ArenaStreamBuf::xsputn(const char *s, std::streamsize n)
+{
+  if (epptr() - pptr() < n)
+  {
+    grow(n);
+  }
+  memcpy(pptr(), s, n);
+  pbump(n);
+  return n;
+}
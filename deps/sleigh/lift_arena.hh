@@ -0,0 +1,87 @@
+/// \file lift_arena.hh
+/// \brief Bump allocation for the scratch data of lifting one instruction
+///
+/// Lifting an instruction builds its disassembly text in `ostringstream`s
+/// that are thrown away as soon as the emitter has copied them, which is a
+/// handful of heap allocations for every instruction. A `LiftArena` hands
+/// out that memory from a few large chunks instead, and `reset` gives all
+/// of it back at once. Once its chunks are large enough for the biggest
+/// instruction seen, lifting through an arena does no heap allocations.
+#ifndef __LIFT_ARENA_HH__
+#define __LIFT_ARENA_HH__
+
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <vector>
+
+/// Bytes of the first chunk of a `LiftArena`
+#define LIFT_ARENA_CHUNK_SIZE 0x4000
+
+/**
+ * \brief chunked bump allocator, everything it handed out is freed at once
+ * by `reset`. Not thread safe, each lifting thread needs its own.
+ */
+class LiftArena
+{
+  std::vector<uint8_t *> chunks;
+  std::vector<size_t> chunk_sizes;
+  uint8_t *cur = nullptr; // next free byte of the last chunk
+  uint8_t *end = nullptr; // end of the last chunk
+  size_t total = 0;       // bytes of every chunk together
+
+  void *allocate_chunk(size_t size, size_t align);
+
+public:
+  LiftArena(void) {}
+  ~LiftArena(void);
+
+  /** \brief `size` bytes aligned to `align`, which must be a power of 2 */
+  void *allocate(size_t size, size_t align = alignof(std::max_align_t))
+  {
+    uintptr_t start = ((uintptr_t)cur + align - 1) & ~(uintptr_t)(align - 1);
+    if (cur != nullptr && start + size <= (uintptr_t)end)
+    {
+      cur = (uint8_t *)(start + size);
+      return (void *)start;
+    }
+    return allocate_chunk(size, align);
+  }
+
+  /**
+   * \brief frees everything that was allocated. If it took more than one
+   * chunk they are replaced by a single one as big as all of them, so the
+   * same amount of work fits without growing next time.
+   */
+  void reset(void);
+
+  /** \brief bytes held by the arena, used or not */
+  size_t capacity(void) const { return total; }
+
+private:
+  LiftArena(const LiftArena &);
+  LiftArena &operator=(const LiftArena &);
+};
+
+/**
+ * \brief output buffer of an `ostream` that lives in a `LiftArena`, growing
+ * by doubling. The text is only valid until the arena is reset.
+ */
+class ArenaStreamBuf : public std::streambuf
+{
+  LiftArena &arena;
+
+  void grow(size_t needed);
+
+protected:
+  virtual int_type overflow(int_type c);
+  virtual std::streamsize xsputn(const char *s, std::streamsize n);
+
+public:
+  ArenaStreamBuf(LiftArena &a, size_t reserve);
+
+  const char *data(void) const { return pbase(); }
+  size_t size(void) const { return pptr() - pbase(); }
+};
+
+#endif
@@ -0,0 +1,134 @@
+/// \file lift_stats.hh
+/// \brief Counters + cycle timers of the lift hot path
+///
+/// Only compiled in when libsla is built with `-DLIBSLA_STATS` (what
+/// `zig build -Dstats` does): every manager then counts how often it went
+/// through `loadFill`, `printAssembly` and `oneInstruction` and how many
+/// cycles each took, how its parser, context and decode caches and intern
+/// table did, and how many instructions failed to decode. Without it the `LIFT_STATS_*` macros
+/// compile to nothing and `LiftStats::enabled` reads 0.
+///
+/// The phases nest: `printAssembly` and `oneInstruction` include the
+/// `loadFill`s they trigger, and a failed decode counts the cycles spent up
+/// to the exception. Cycles are whatever counter the CPU has at hand, the
+/// TSC on x86 and the virtual counter on aarch64, so they only compare
+/// within one machine.
+#ifndef __LIFT_STATS_HH__
+#define __LIFT_STATS_HH__
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif !defined(__aarch64__)
+#include <chrono>
+#endif
+
+/**
+ * \brief everything a manager counted since it was created or last reset,
+ * passed over the C API as is
+ */
+struct LiftStats
+{
+  uint64_t enabled; // 1 if libsla was built with `-DLIBSLA_STATS`
+  uint64_t load_fill_calls;
+  uint64_t load_fill_cycles;
+  uint64_t print_assembly_calls;
+  uint64_t print_assembly_cycles;
+  uint64_t one_instruction_calls;
+  uint64_t one_instruction_cycles;
+  // `BadDataError`s + `UnimplError`s thrown while decoding
+  uint64_t decode_errors;
+  // parse trees found already built in the `DisassemblyCache`
+  uint64_t parser_cache_hits;
+  uint64_t parser_cache_misses;
+  // lookups the `ContextCache` answered without the context database
+  uint64_t context_cache_hits;
+  uint64_t context_cache_misses;
+  uint64_t decode_cache_hits;
+  uint64_t decode_cache_misses;
+  // encodings found in / decoded into the `InsnInternTable`
+  uint64_t intern_hits;
+  uint64_t intern_misses;
+  // process wide, 0 unless also built with `-DLIBSLA_COUNT_ALLOCATIONS`
+  uint64_t allocation_count;
+  uint64_t allocation_bytes;
+};
+
+/** \brief the cycle counter `LiftStats` is timed with */
+inline uint64_t lift_stats_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t value;
+  __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(value));
+  return value;
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+/**
+ * \brief counts a call of the phase `calls`/`cycles` of `stats` (which may
+ * be null) and the cycles until it goes out of scope, thrown out of or not
+ */
+class LiftStatsTimer
+{
+  LiftStats *stats;
+  uint64_t LiftStats::*cycles;
+  uint64_t start;
+
+public:
+  LiftStatsTimer(LiftStats *s, uint64_t LiftStats::*calls,
+                 uint64_t LiftStats::*c)
+      : stats(s), cycles(c), start(0)
+  {
+    if (stats != nullptr)
+    {
+      stats->*calls += 1;
+      start = lift_stats_cycles();
+    }
+  }
+
+  ~LiftStatsTimer(void)
+  {
+    if (stats != nullptr)
+    {
+      stats->*cycles += lift_stats_cycles() - start;
+    }
+  }
+
+private:
+  LiftStatsTimer(const LiftStatsTimer &);
+  LiftStatsTimer &operator=(const LiftStatsTimer &);
+};
+
+#ifdef LIBSLA_STATS
+/// Adds `n` to `field` of the `LiftStats *stats`, if it isn't null
+#define LIFT_STATS_ADD(stats, field, n)                                        \
+  do                                                                           \
+  {                                                                            \
+    if ((stats) != nullptr)                                                    \
+    {                                                                          \
+      (stats)->field += (n);                                                   \
+    }                                                                          \
+  } while (0)
+/// Times the rest of the scope as the phase `phase` of `stats`
+#define LIFT_STATS_TIME(stats, phase)                                          \
+  LiftStatsTimer lift_stats_timer_##phase(                                     \
+      (stats), &LiftStats::phase##_calls, &LiftStats::phase##_cycles)
+#else
+#define LIFT_STATS_ADD(stats, field, n)                                        \
+  do                                                                           \
+  {                                                                            \
+  } while (0)
+#define LIFT_STATS_TIME(stats, phase)                                          \
+  do                                                                           \
+  {                                                                            \
+  } while (0)
+#endif
+
+#endif
@@ -78,6 +78,7 @@ public:
   virtual ~LoadImage(void);	///< LoadImage destructor
   const string &getFileName(void) const; ///< Get the name of the LoadImage
   virtual void loadFill(uint1 *ptr,int4 size,const Address &addr)=0; ///< Get data from the LoadImage
+  virtual const uint1 *getBytes(int4 size,const Address &addr) const; ///< Get data the LoadImage holds in place
   virtual void openSymbols(void) const; ///< Prepare to read symbols
   virtual void closeSymbols(void) const; ///< Stop reading symbols
   virtual bool getNextSymbol(LoadImageFunc &record) const; ///< Get the next symbol record
@@ -128,6 +129,16 @@ inline const string &LoadImage::getFileName(void) const {
   return filename;
 }
 
+/// Images that keep (some of) their bytes in memory can hand them out without a copy.
+/// The pointer must stay valid for as long as the image does, even once the image has
+/// changed the bytes at that address. The base class holds nothing in place.
+/// \param size is the number of bytes wanted
+/// \param addr is the address of the first byte
+/// \return a pointer to all \b size bytes, or null if they aren't held in one piece
+inline const uint1 *LoadImage::getBytes(int4 size,const Address &addr) const {
+  return (const uint1 *)0;
+}
+
 /// This routine should read in and parse any symbol information
 /// that the load image contains about executable.  Once this
 /// method is called, individual symbol records are read out
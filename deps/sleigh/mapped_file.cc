@@ -0,0 +1,63 @@
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "error.hh"
+#include "mapped_file.hh"
+
+MappedFile::MappedFile(const char *path, uint64_t offset, uint64_t length,
+                       bool writable)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    throw ghidra::LowlevelError(std::string("Unable to open ") + path);
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (uint64_t)info.st_size <= offset)
+  {
+    close(fd);
+    throw ghidra::LowlevelError(std::string("Nothing to map in ") + path);
+  }
+
+  uint64_t available = info.st_size - offset;
+  if (length == 0 || length > available)
+  {
+    length = available;
+  }
+
+  // mmap offsets have to be page aligned, map from the page holding
+  // `offset` and skip the bytes before it
+  uint64_t page_size = sysconf(_SC_PAGESIZE);
+  uint64_t page_offset = offset - (offset % page_size);
+  mapping_size = length + (offset - page_offset);
+  int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  mapping = mmap(nullptr, mapping_size, prot, MAP_PRIVATE, fd, page_offset);
+  close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    mapping = nullptr;
+    throw ghidra::LowlevelError(std::string("Unable to map ") + path);
+  }
+
+  data = (uint8_t *)mapping + (offset - page_offset);
+  size = length;
+}
+
+MappedFile::~MappedFile(void)
+{
+  if (mapping != nullptr)
+  {
+    munmap(mapping, mapping_size);
+  }
+}
+
+void MappedFile::advise_sequential(void)
+{
+  madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+}
@@ -0,0 +1,40 @@
+/// \file mapped_file.hh
+/// \brief Private memory mappings of files on disk
+#ifndef __MAPPED_FILE_HH__
+#define __MAPPED_FILE_HH__
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief private mapping of `[offset, offset + length)` of a file, which is
+ * unmapped when destroyed. Pages are read straight out of the page cache and
+ * writes (if `writable`) go to private copy-on-write pages, never the file.
+ */
+class MappedFile
+{
+  void *mapping = nullptr;
+  size_t mapping_size = 0;
+
+public:
+  uint8_t *data = nullptr;
+  size_t size = 0;
+
+  /**
+   * \brief maps `length` bytes at `offset` of the file at `path`, a
+   * `length` of 0 maps everything from `offset` to the end of the file.
+   * Throws `ghidra::LowlevelError` if the file can't be mapped.
+   */
+  MappedFile(const char *path, uint64_t offset = 0, uint64_t length = 0,
+             bool writable = false);
+  ~MappedFile(void);
+
+  /** \brief tells the kernel the mapping will be read front to back */
+  void advise_sequential(void);
+
+private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+};
+
+#endif
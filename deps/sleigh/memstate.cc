@@ -170,6 +170,18 @@ void MemoryBank::setPage(uintb addr,const uint1 *val,int4 skip,int4 size)
   } while(startalign != endalign);
 }
 
+/// Banks that keep their pages in memory can hand them out, so a bank overlaying them reads
+/// the bytes in place instead of copying them.  The pointer stays valid until the page is
+/// written or the bank is destroyed.  The default implementation holds nothing in place.
+/// \param addr is the offset of the first byte wanted
+/// \param size is the number of bytes wanted, which must all lie in the same page
+/// \return a pointer to all \b size bytes, or null if they aren't held in place
+const uint1 *MemoryBank::getPageView(uintb addr,int4 size) const
+
+{
+  return (const uint1 *)0;
+}
+
 /// This routine is used to set a single value in the memory bank at an arbitrary address
 /// It takes into account the endianness of the associated address space when encoding the
 /// value as bytes in the bank.  The value is broken up into aligned pieces of \e wordsize and
@@ -398,6 +410,16 @@ void MemoryImage::getPage(uintb addr,uint1 *res,int4 skip,int4 size) const
   }
 }
 
+/// The bytes are handed out by the LoadImage, if it holds all of them in one piece.
+/// \param addr is the offset of the first byte wanted
+/// \param size is the number of bytes wanted
+/// \return a pointer to the bytes, or null if the LoadImage doesn't hold them in place
+const uint1 *MemoryImage::getPageView(uintb addr,int4 size) const
+
+{
+  return loader->getBytes(size,Address(getSpace(),addr));
+}
+
 /// A MemoryImage needs everything a basic memory bank needs and is needs to know
 /// the underlying LoadImage object to forward read reqests to.
 /// \param spc is the address space associated with the memory bank
@@ -613,6 +635,439 @@ MemoryHashOverlay::MemoryHashOverlay(AddrSpace *spc,int4 ws,int4 ps,int4 hashsiz
   }
 }
 
+/// A flat bank needs all the parameters for a generic memory bank, the number of bytes to
+/// keep in place (rounded up to a whole number of pages) and the bank to forward the rest of
+/// the space to.
+/// \param spc is the address space associated with the memory bank
+/// \param ws is the number of bytes in the preferred wordsize (must be power of 2)
+/// \param ps is the number of bytes in a page (must be power of 2)
+/// \param sz is the number of bytes, starting at offset 0, to store in place
+/// \param ul is the underlying memory bank, which may be \b null
+MemoryFlatBank::MemoryFlatBank(AddrSpace *spc,int4 ws,int4 ps,uintb sz,MemoryBank *ul)
+  : MemoryBank(spc,ws,ps), bytes(((sz + ps - 1) / ps) * ps,0)
+{
+  underlie = ul;
+  bigendian = spc->isBigEndian();
+}
+
+/// Words are either entirely in place or entirely past the array, as it is a whole number of pages.
+/// \param addr is the aligned address of the word being written
+/// \param val is the value of the word to write
+void MemoryFlatBank::insert(uintb addr,uintb val)
+
+{
+  if (addr < bytes.size()) {
+    storeValue(&bytes[addr],val,getWordSize(),bigendian);
+    return;
+  }
+  if (underlie == (MemoryBank *)0)
+    throw LowlevelError("Writing past the end of a flat MemoryBank");
+  underlie->insert(addr,val);
+}
+
+/// Words past the array are read from the underlying bank, or are 0 if there is none.
+/// \param addr is the aligned address of the word to retrieve
+/// \return the retrieved value
+uintb MemoryFlatBank::find(uintb addr) const
+
+{
+  if (addr < bytes.size())
+    return loadValue(&bytes[addr],getWordSize(),bigendian);
+  if (underlie == (MemoryBank *)0)
+    return (uintb)0;
+  return underlie->find(addr);
+}
+
+/// Pages in place are copied out directly, the rest are forwarded to the underlying bank.
+/// \param addr is the aligned offset of the desired page
+/// \param res is the pointer to where fetched data should be written
+/// \param skip is the offset \e into \e the \e page to get the bytes from
+/// \param size is the number of bytes to retrieve
+void MemoryFlatBank::getPage(uintb addr,uint1 *res,int4 skip,int4 size) const
+
+{
+  if (addr < bytes.size())
+    memcpy(res,&bytes[addr+skip],size);
+  else if (underlie == (MemoryBank *)0)
+    memset(res,0,size);
+  else
+    underlie->getPage(addr,res,skip,size);
+}
+
+/// Pages in place are copied in directly, the rest are forwarded to the underlying bank.
+/// \param addr is the aligned offset of the desired page
+/// \param val is a pointer to the bytes to be written into the page
+/// \param skip is the offset \e into \e the \e page where bytes will be written
+/// \param size is the number of bytes to be written
+void MemoryFlatBank::setPage(uintb addr,const uint1 *val,int4 skip,int4 size)
+
+{
+  if (addr < bytes.size()) {
+    memcpy(&bytes[addr+skip],val,size);
+    return;
+  }
+  if (underlie == (MemoryBank *)0)
+    throw LowlevelError("Writing past the end of a flat MemoryBank");
+  underlie->setPage(addr,val,skip,size);
+}
+
+/// Values lying entirely in place are stored directly, anything that reaches past the
+/// array goes through the generic word by word path.
+/// \param offset is the start of the byte range to write
+/// \param size is the number of bytes in the range to write
+/// \param val is the value to be written
+void MemoryFlatBank::setValue(uintb offset,int4 size,uintb val)
+
+{
+  if (offset < bytes.size() && (uintb)size <= bytes.size() - offset) {
+    storeValue(&bytes[offset],val,size,bigendian);
+    return;
+  }
+  MemoryBank::setValue(offset,size,val);
+}
+
+/// Values lying entirely in place are read directly, anything that reaches past the
+/// array goes through the generic word by word path.
+/// \param offset is the start of the byte range to read
+/// \param size is the number of bytes in the range to read
+/// \return the value of the bytes
+uintb MemoryFlatBank::getValue(uintb offset,int4 size) const
+
+{
+  if (offset < bytes.size() && (uintb)size <= bytes.size() - offset)
+    return loadValue(&bytes[offset],size,bigendian);
+  return MemoryBank::getValue(offset,size);
+}
+
+/// The underlying bank is left alone.
+void MemoryFlatBank::clear(void)
+
+{
+  memset(bytes.data(),0,bytes.size());
+}
+
+/// For the \e unique space this covers every temporary of the specification and the
+/// runtime temporaries; for any other space it is the end of the last register in it,
+/// which is 0 for a space without registers.
+/// \param trans is the translator describing the registers
+/// \param spc is the space to size
+/// \return the number of bytes a MemoryFlatBank needs to hold the space in place
+uintb MemoryFlatBank::getExtent(const Translate *trans,AddrSpace *spc)
+
+{
+  if (spc == trans->getUniqueSpace())
+    return trans->getUniqueStart(Translate::INJECT);
+
+  map<VarnodeData,string> reglist;
+  trans->getAllRegisters(reglist);
+  uintb extent = 0;
+  map<VarnodeData,string>::const_iterator iter;
+  for(iter=reglist.begin();iter!=reglist.end();++iter) {
+    const VarnodeData &vn((*iter).first);
+    if (vn.space == spc && vn.offset + vn.size > extent)
+      extent = vn.offset + vn.size;
+  }
+  return extent;
+}
+
+/// The last page touched is checked first, then the last directory walked through, before the
+/// root map is searched.  Directories and leaves are allocated as they are first needed, and are
+/// never freed before the bank is, so the returned entry stays valid.
+/// \param pageaddr is the aligned offset of the page
+/// \param create is \b true to allocate whatever the entry is missing
+/// \return the entry of the page (whose \b ptr is null if the page isn't mapped), or null
+/// if \b create is \b false and there is none
+MemoryPageTable::Entry *MemoryPageTable::lookup(uintb pageaddr,bool create) const
+
+{
+  if (lastentry != (Entry *)0 && lastpage == pageaddr)
+    return lastentry;
+
+  uintb pagenum = pageaddr >> pageshift;
+  uintb key = pagenum >> (LEAF_BITS + DIR_BITS);
+  if (lastdir == (Directory *)0 || lastkey != key) {
+    map<uintb,Directory *>::iterator iter = root.find(key);
+    if (iter != root.end())
+      lastdir = (*iter).second;
+    else if (!create)
+      return (Entry *)0;
+    else {
+      lastdir = new Directory;
+      memset(lastdir->leaf,0,sizeof(lastdir->leaf));
+      root[key] = lastdir;
+    }
+    lastkey = key;
+  }
+
+  Leaf *&leaf(lastdir->leaf[(pagenum >> LEAF_BITS) & ((1 << DIR_BITS) - 1)]);
+  if (leaf == (Leaf *)0) {
+    if (!create)
+      return (Entry *)0;
+    leaf = new Leaf;
+    memset(leaf->entry,0,sizeof(leaf->entry));
+    leaf->listed = false;
+  }
+  lastpage = pageaddr;
+  lastleaf = leaf;
+  lastentry = &leaf->entry[pagenum & ((1 << LEAF_BITS) - 1)];
+  return lastentry;
+}
+
+/// Called when a page is mapped, so clear() and flushUnwritten() only visit the leaves that
+/// have anything in them.
+void MemoryPageTable::listLeaf(void) const
+
+{
+  if (lastleaf->listed) return;
+  lastleaf->listed = true;
+  mapped.push_back(lastleaf);
+}
+
+/// A page that isn't mapped yet is borrowed from the underlying bank, if it holds the page
+/// in place and its leaf is already allocated.  Reads never allocate anything, so a table
+/// that is only read (a fresh snapshot layer, mostly) costs nothing to make and throw away.
+/// \param pageaddr is the aligned offset of the page
+/// \return the bytes of the page, or null if reads of it must go to the underlying bank
+/// (or are zero, if there is none)
+const uint1 *MemoryPageTable::readPage(uintb pageaddr) const
+
+{
+  Entry *entry = lookup(pageaddr,false);
+  if (entry == (Entry *)0)
+    return (const uint1 *)0;
+  if (entry->ptr != (uint1 *)0)
+    return entry->ptr;
+  if (underlie == (MemoryBank *)0)
+    return (const uint1 *)0;
+
+  const uint1 *view = underlie->getPageView(pageaddr,getPageSize());
+  if (view == (const uint1 *)0)
+    return (const uint1 *)0;
+  entry->ptr = (uint1 *)view;	// Never written through, see writePage()
+  entry->written = false;
+  listLeaf();
+  return view;
+}
+
+/// A borrowed page (or one that isn't mapped) is copied first, unless the whole page is about
+/// to be overwritten.
+/// \param pageaddr is the aligned offset of the page
+/// \param whole is \b true if the caller writes every byte of the page
+/// \return the private bytes of the page
+uint1 *MemoryPageTable::writePage(uintb pageaddr,bool whole)
+
+{
+  Entry *entry = lookup(pageaddr,true);
+  if (entry->written)
+    return entry->ptr;
+
+  uint1 *pageptr = new uint1[getPageSize()];
+  if (!whole) {
+    if (entry->ptr != (uint1 *)0)
+      memcpy(pageptr,entry->ptr,getPageSize());
+    else if (underlie == (MemoryBank *)0)
+      memset(pageptr,0,getPageSize());
+    else
+      underlie->getPage(pageaddr,pageptr,0,getPageSize());
+  }
+  entry->ptr = pageptr;
+  entry->written = true;
+  listLeaf();
+  return pageptr;
+}
+
+/// \param addr is the aligned address of the word being written
+/// \param val is the value of the word to write
+void MemoryPageTable::insert(uintb addr,uintb val)
+
+{
+  uintb pageaddr = addr & ~((uintb)(getPageSize()-1));
+  uint1 *pageptr = writePage(pageaddr,false);
+  MemoryFlatBank::storeValue(pageptr + (addr - pageaddr),val,getWordSize(),bigendian);
+}
+
+/// \param addr is the aligned address of the word to retrieve
+/// \return the retrieved value
+uintb MemoryPageTable::find(uintb addr) const
+
+{
+  uintb pageaddr = addr & ~((uintb)(getPageSize()-1));
+  const uint1 *pageptr = readPage(pageaddr);
+  if (pageptr != (const uint1 *)0)
+    return MemoryFlatBank::loadValue(pageptr + (addr - pageaddr),getWordSize(),bigendian);
+  if (underlie == (MemoryBank *)0)
+    return (uintb)0;
+  return underlie->find(addr);
+}
+
+/// \param addr is the aligned offset of the desired page
+/// \param res is the pointer to where fetched data should be written
+/// \param skip is the offset \e into \e the \e page to get the bytes from
+/// \param size is the number of bytes to retrieve
+void MemoryPageTable::getPage(uintb addr,uint1 *res,int4 skip,int4 size) const
+
+{
+  const uint1 *pageptr = readPage(addr);
+  if (pageptr != (const uint1 *)0)
+    memcpy(res,pageptr+skip,size);
+  else if (underlie == (MemoryBank *)0)
+    memset(res,0,size);
+  else
+    underlie->getPage(addr,res,skip,size);
+}
+
+/// \param addr is the aligned offset of the page to write
+/// \param val is a pointer to bytes to be written into the page
+/// \param skip is the offset \e into \e the \e page where bytes should be written
+/// \param size is the number of bytes to write
+void MemoryPageTable::setPage(uintb addr,const uint1 *val,int4 skip,int4 size)
+
+{
+  uint1 *pageptr = writePage(addr,size == getPageSize());
+  memcpy(pageptr+skip,val,size);
+}
+
+/// Every mapped page of the table is held in place, along with every page it can borrow.
+/// \param addr is the offset of the first byte wanted
+/// \param size is the number of bytes wanted
+/// \return a pointer to the bytes, or null if they aren't held in place or span two pages
+const uint1 *MemoryPageTable::getPageView(uintb addr,int4 size) const
+
+{
+  uintb pageaddr = addr & ~((uintb)(getPageSize()-1));
+  if (size <= 0 || (addr - pageaddr) + size > (uintb)getPageSize())
+    return (const uint1 *)0;
+  const uint1 *pageptr = readPage(pageaddr);
+  if (pageptr == (const uint1 *)0)
+    return (const uint1 *)0;
+  return pageptr + (addr - pageaddr);
+}
+
+/// A page table needs all the parameters for a generic memory bank and the underlying bank
+/// it starts out as a copy of.
+/// \param spc is the address space associated with the memory bank
+/// \param ws is the number of bytes in the preferred wordsize (must be power of 2)
+/// \param ps is the number of bytes in a page (must be power of 2)
+/// \param ul is the underlying memory bank, which may be \b null
+MemoryPageTable::MemoryPageTable(AddrSpace *spc,int4 ws,int4 ps,MemoryBank *ul)
+  : MemoryBank(spc,ws,ps)
+{
+  underlie = ul;
+  bigendian = spc->isBigEndian();
+  pageshift = 0;
+  while((1 << pageshift) < ps)
+    pageshift += 1;
+  lastkey = 0;
+  lastdir = (Directory *)0;
+  lastpage = 0;
+  lastentry = (Entry *)0;
+  lastleaf = (Leaf *)0;
+}
+
+MemoryPageTable::~MemoryPageTable(void)
+
+{
+  freeTables();
+}
+
+/// Afterwards the bank is empty, as if it had just been made.
+void MemoryPageTable::freeTables(void)
+
+{
+  map<uintb,Directory *>::iterator iter;
+  for(iter=root.begin();iter!=root.end();++iter) {
+    Directory *dir = (*iter).second;
+    for(int4 i=0;i<(1 << DIR_BITS);++i) {
+      Leaf *leaf = dir->leaf[i];
+      if (leaf == (Leaf *)0) continue;
+      for(int4 j=0;j<(1 << LEAF_BITS);++j) {
+	if (leaf->entry[j].written)
+	  delete [] leaf->entry[j].ptr;
+      }
+      delete leaf;
+    }
+    delete dir;
+  }
+  root.clear();
+  mapped.clear();
+  lastdir = (Directory *)0;
+  lastentry = (Entry *)0;
+  lastleaf = (Leaf *)0;
+}
+
+/// Values lying entirely in one page are read or written with a single page lookup, anything
+/// spanning two pages goes through the generic word by word path.
+/// \param offset is the start of the byte range to write
+/// \param size is the number of bytes in the range to write
+/// \param val is the value to be written
+void MemoryPageTable::setValue(uintb offset,int4 size,uintb val)
+
+{
+  uintb pageaddr = offset & ~((uintb)(getPageSize()-1));
+  if (size > 0 && (offset - pageaddr) + size <= (uintb)getPageSize()) {
+    uint1 *pageptr = writePage(pageaddr,false);
+    MemoryFlatBank::storeValue(pageptr + (offset - pageaddr),val,size,bigendian);
+    return;
+  }
+  MemoryBank::setValue(offset,size,val);
+}
+
+/// \param offset is the start of the byte range to read
+/// \param size is the number of bytes in the range to read
+/// \return the value of the bytes
+uintb MemoryPageTable::getValue(uintb offset,int4 size) const
+
+{
+  uintb pageaddr = offset & ~((uintb)(getPageSize()-1));
+  if (size > 0 && (offset - pageaddr) + size <= (uintb)getPageSize()) {
+    const uint1 *pageptr = readPage(pageaddr);
+    if (pageptr != (const uint1 *)0)
+      return MemoryFlatBank::loadValue(pageptr + (offset - pageaddr),size,bigendian);
+    if (underlie == (MemoryBank *)0)
+      return (uintb)0;
+    return underlie->getValue(offset,size);	// Nothing of the page is mapped here
+  }
+  return MemoryBank::getValue(offset,size);
+}
+
+/// Pages that were borrowed from the underlying bank are read from it again the next time, for
+/// when its bytes changed.  A bank borrowing pages from this one must be flushed first.
+void MemoryPageTable::flushUnwritten(void)
+
+{
+  for(int4 i=0;i<mapped.size();++i) {
+    Leaf *leaf = mapped[i];
+    for(int4 j=0;j<(1 << LEAF_BITS);++j) {
+      if (!leaf->entry[j].written)
+	leaf->entry[j].ptr = (uint1 *)0;
+    }
+  }
+}
+
+/// The bank reads as a copy of the underlying bank again.  Directories and leaves stay allocated,
+/// so a bank that is written and cleared over and over (the top of a snapshot stack) stops
+/// allocating anything but the pages it writes.  Only the leaves pages were mapped in are
+/// visited, and the tables are freed after all once writes scattered them over too many
+/// directories.
+void MemoryPageTable::clear(void)
+
+{
+  if (root.size() > MAX_KEPT_DIRS) {
+    freeTables();
+    return;
+  }
+  for(int4 i=0;i<mapped.size();++i) {
+    Leaf *leaf = mapped[i];
+    for(int4 j=0;j<(1 << LEAF_BITS);++j) {
+      if (leaf->entry[j].written)
+	delete [] leaf->entry[j].ptr;
+    }
+    memset(leaf->entry,0,sizeof(leaf->entry));
+    leaf->listed = false;
+  }
+  mapped.clear();
+}
+
 /// MemoryBanks associated with specific address spaces must be registers with this MemoryState
 /// via this method.  Each address space that will be used during emulation must be registered
 /// separately.  The MemoryState object does \e not assume responsibility for freeing the MemoryBank
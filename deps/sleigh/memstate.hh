@@ -22,6 +22,8 @@
 #include "pcoderaw.hh"
 #include "loadimage.hh"
 
+#include <cstring>
+
 namespace ghidra {
 
 /// \brief Memory storage/state for a single AddressSpace
@@ -38,6 +40,8 @@ namespace ghidra {
 class MemoryBank {
   friend class MemoryPageOverlay;
   friend class MemoryHashOverlay;
+  friend class MemoryFlatBank;
+  friend class MemoryPageTable;
   int4 wordsize;		///< Number of bytes in an aligned word access
   int4 pagesize;		///< Number of bytes in an aligned page access
   AddrSpace *space;		///< The address space associated with this memory
@@ -46,6 +50,7 @@ protected:
   virtual uintb find(uintb addr) const=0; ///< Retrieve a word from memory bank at an aligned location
   virtual void getPage(uintb addr,uint1 *res,int4 skip,int4 size) const; ///< Retrieve data from a memory \e page
   virtual void setPage(uintb addr,const uint1 *val,int4 skip,int4 size); ///< Write data into a memory page
+  virtual const uint1 *getPageView(uintb addr,int4 size) const; ///< Get the bytes of a page held in place
 public:
   MemoryBank(AddrSpace *spc,int4 ws,int4 ps); ///< Generic constructor for a memory bank
   virtual ~MemoryBank(void) {}
@@ -53,8 +58,8 @@ public:
   int4 getPageSize(void) const;	///< Get the number of bytes in a page for this memory bank
   AddrSpace *getSpace(void) const; ///< Get the address space associated with this memory bank
 
-  void setValue(uintb offset,int4 size,uintb val); ///< Set the value of a (small) range of bytes
-  uintb getValue(uintb offset,int4 size) const; ///< Retrieve the value encoded in a (small) range of bytes
+  virtual void setValue(uintb offset,int4 size,uintb val); ///< Set the value of a (small) range of bytes
+  virtual uintb getValue(uintb offset,int4 size) const; ///< Retrieve the value encoded in a (small) range of bytes
   void setChunk(uintb offset,int4 size,const uint1 *val); ///< Set values of an arbitrary sequence of bytes
   void getChunk(uintb offset,int4 size,uint1 *res) const; ///< Retrieve an arbitrary sequence of bytes
   static uintb constructValue(const uint1 *ptr,int4 size,bool bigendian); ///< Decode bytes to value
@@ -99,6 +104,7 @@ protected:
     throw LowlevelError("Writing to read-only MemoryBank"); } ///< Exception is thrown for write attempts
   virtual uintb find(uintb addr) const;	///< Overridden find method
   virtual void getPage(uintb addr,uint1 *res,int4 skip,int4 size) const; ///< Overridded getPage method
+  virtual const uint1 *getPageView(uintb addr,int4 size) const; ///< Overridden getPageView
 public:
   MemoryImage(AddrSpace *spc,int4 ws,int4 ps,LoadImage *ld); ///< Constructor for a loadimage memorybank
 };
@@ -140,8 +146,147 @@ public:
   MemoryHashOverlay(AddrSpace *spc,int4 ws,int4 ps,int4 hashsize,MemoryBank *ul); ///< Constructor for hash overlay
 };
 
+/// \brief Copy-on-write memory bank that finds its pages through a radix page table
+///
+/// A drop-in for MemoryPageOverlay where every access counts.  Page addresses are split
+/// into a \e root key, looked up in a map, and two small levels of tables beneath it.  The
+/// tables are kept small so a bank that only writes a few pages stays cheap to make.  The
+/// last directory walked through is remembered, so the map is only searched when accesses
+/// move to a far away part of the space, and so is the last page touched, so a run of
+/// accesses to the same page (a stack, a struct) skips the walk entirely.
+///
+/// Pages are only copied when written.  Until then a page read from the \e underlying bank
+/// points straight at the bytes that bank holds in place (see MemoryBank::getPageView),
+/// which is every page of the loaded image and of any MemoryPageTable under it, so reading
+/// through a deep stack of tables is still a single lookup.  Reads of pages the underlying
+/// bank can't hand out are forwarded to it, like MemoryPageOverlay does.  The underlying bank
+/// must not change while this one is in use, except that every borrowed page is dropped with
+/// flushUnwritten().
+class MemoryPageTable : public MemoryBank {
+  static const int4 LEAF_BITS = 5;	///< Bits of the page number indexing a Leaf
+  static const int4 DIR_BITS = 5;	///< Bits of the page number indexing a Directory
+  static const int4 MAX_KEPT_DIRS = 16;	///< Most directories clear() keeps for reuse
+  /// \brief A mapped page, \b ptr is null if it isn't mapped
+  struct Entry {
+    uint1 *ptr;			///< The bytes of the page
+    bool written;		///< \b true for a private copy, \b false if borrowed from the underlying bank
+  };
+  struct Leaf {
+    Entry entry[1 << LEAF_BITS];	///< Every page of the leaf
+    bool listed;		///< \b true if the leaf is in \b mapped
+  };
+  struct Directory {
+    Leaf *leaf[1 << DIR_BITS];	///< Every leaf of the directory, null if it isn't allocated
+  };
+  MemoryBank *underlie;		///< Underlying memory bank, or null for all zeros
+  int4 pageshift;		///< Bits of a page offset
+  bool bigendian;		///< \b true if the space is big endian
+  mutable map<uintb,Directory *> root;	///< Every allocated directory by its root key
+  mutable uintb lastkey;	///< Root key of \b lastdir
+  mutable Directory *lastdir;	///< The last directory walked through, null if there is none
+  mutable uintb lastpage;	///< Address of the page in \b lastentry
+  mutable Entry *lastentry;	///< The last page touched, null if there is none
+  mutable Leaf *lastleaf;	///< The leaf holding \b lastentry
+  mutable vector<Leaf *> mapped;	///< Every leaf with a page mapped in it
+  Entry *lookup(uintb pageaddr,bool create) const;	///< Find (or allocate) the entry of a page
+  void listLeaf(void) const;	///< Add the leaf of the last page touched to \b mapped
+  void freeTables(void);	///< Free every page that was written and every table
+  const uint1 *readPage(uintb pageaddr) const;	///< Get a page for reading, null if it isn't held in place
+  uint1 *writePage(uintb pageaddr,bool whole);	///< Get a private copy of a page for writing
+protected:
+  virtual void insert(uintb addr,uintb val); ///< Overridden aligned word insert
+  virtual uintb find(uintb addr) const;	///< Overridden aligned word find
+  virtual void getPage(uintb addr,uint1 *res,int4 skip,int4 size) const; ///< Overridden getPage
+  virtual void setPage(uintb addr,const uint1 *val,int4 skip,int4 size); ///< Overridden setPage
+  virtual const uint1 *getPageView(uintb addr,int4 size) const; ///< Overridden getPageView
+public:
+  MemoryPageTable(AddrSpace *spc,int4 ws,int4 ps,MemoryBank *ul); ///< Constructor for a page table
+  virtual ~MemoryPageTable(void);
+  virtual void setValue(uintb offset,int4 size,uintb val); ///< Overridden setValue
+  virtual uintb getValue(uintb offset,int4 size) const; ///< Overridden getValue
+  void flushUnwritten(void);	///< Drop every page that was never written
+  void clear(void);		///< Drop every page, keeping the tables for reuse
+};
+
 class Translate;		// Forward declaration
 
+/// \brief A memory bank that stores a small, dense space as one contiguous array of bytes
+///
+/// Meant for the \e register and \e unique spaces, whose extent is known from the
+/// specification.  Every byte below the size of the bank is stored in place, so a value
+/// is read or written with a single load or store when the space and host endianness agree.
+/// Accesses past the end of the array are forwarded to an \e underlying memory bank, or
+/// read as zero if it is a \b null pointer, in which case writing there throws.
+class MemoryFlatBank : public MemoryBank {
+  MemoryBank *underlie;		///< Underlying memory bank for everything past the array
+  vector<uint1> bytes;		///< The in place bytes, a whole number of pages
+  bool bigendian;		///< \b true if the space is big endian
+protected:
+  virtual void insert(uintb addr,uintb val); ///< Overridden aligned word insert
+  virtual uintb find(uintb addr) const;	///< Overridden aligned word find
+  virtual void getPage(uintb addr,uint1 *res,int4 skip,int4 size) const; ///< Overridden getPage
+  virtual void setPage(uintb addr,const uint1 *val,int4 skip,int4 size); ///< Overridden setPage
+public:
+  MemoryFlatBank(AddrSpace *spc,int4 ws,int4 ps,uintb sz,MemoryBank *ul); ///< Constructor for a flat bank
+  virtual void setValue(uintb offset,int4 size,uintb val); ///< Overridden setValue
+  virtual uintb getValue(uintb offset,int4 size) const; ///< Overridden getValue
+  uintb getSize(void) const { return bytes.size(); } ///< Get the number of bytes stored in place
+  uint1 *getData(void) { return bytes.data(); }	///< Get the bytes stored in place
+  const uint1 *getData(void) const { return bytes.data(); } ///< Get the bytes stored in place
+  void clear(void);		///< Reset every byte stored in place to zero
+  static uintb getExtent(const Translate *trans,AddrSpace *spc); ///< Bytes needed to hold a space in place
+  static uintb loadValue(const uint1 *ptr,int4 size,bool bigendian); ///< Decode bytes to value, fast path
+  static void storeValue(uint1 *ptr,uintb val,int4 size,bool bigendian); ///< Encode value to bytes, fast path
+};
+
+/// The common sizes are read with one (unaligned) load, when the bytes are little endian
+/// on a little endian host, anything else is decoded byte by byte.
+/// \param ptr is the pointer to the bytes to decode
+/// \param size is the number of bytes
+/// \param bigendian is \b true if the bytes are encoded in big endian form
+/// \return the decoded value
+inline uintb MemoryFlatBank::loadValue(const uint1 *ptr,int4 size,bool bigendian)
+
+{
+  if (!bigendian && HOST_ENDIAN == 0) {
+    switch(size) {
+    case 1:
+      return *ptr;
+    case 2:
+      { uint2 val; memcpy(&val,ptr,sizeof(val)); return val; }
+    case 4:
+      { uint4 val; memcpy(&val,ptr,sizeof(val)); return val; }
+    case 8:
+      { uint8 val; memcpy(&val,ptr,sizeof(val)); return val; }
+    }
+  }
+  return MemoryBank::constructValue(ptr,size,bigendian);
+}
+
+/// The inverse of loadValue(), the common sizes are written with one (unaligned) store.
+/// \param ptr is the pointer to the bytes to encode into
+/// \param val is the value to encode, only its low \b size bytes are written
+/// \param size is the number of bytes
+/// \param bigendian is \b true if the bytes are to be encoded in big endian form
+inline void MemoryFlatBank::storeValue(uint1 *ptr,uintb val,int4 size,bool bigendian)
+
+{
+  if (!bigendian && HOST_ENDIAN == 0) {
+    switch(size) {
+    case 1:
+      *ptr = val;
+      return;
+    case 2:
+      { uint2 tmp = val; memcpy(ptr,&tmp,sizeof(tmp)); return; }
+    case 4:
+      { uint4 tmp = val; memcpy(ptr,&tmp,sizeof(tmp)); return; }
+    case 8:
+      { uint8 tmp = val; memcpy(ptr,&tmp,sizeof(tmp)); return; }
+    }
+  }
+  MemoryBank::deconstructValue(ptr,val,size,bigendian);
+}
+
 /// \brief All storage/state for a pcode machine
 ///
 /// Every piece of information in a pcode machine is representable as a triple
@@ -0,0 +1,249 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "numa_placement.hh"
+
+// from `linux/mempolicy.h`, which not every libc ships
+#define NUMA_MPOL_DEFAULT 0
+#define NUMA_MPOL_PREFERRED 1
+#define NUMA_MPOL_INTERLEAVE 3
+#define NUMA_MPOL_MF_MOVE (1 << 1)
+
+#define NUMA_NODE_PATH "/sys/devices/system/node"
+
+/** \brief the nodes with CPUs + the CPUs of each, read once */
+struct NumaTopology
+{
+  std::vector<int> nodes;      // kernel ids, ascending
+  std::vector<cpu_set_t> cpus; // of each of `nodes`, empty if unknown
+
+  NumaTopology(void);
+};
+
+/** \brief everything in the file at `path`, empty if it can't be read */
+static std::string read_file(const std::string &path)
+{
+  std::string out;
+  FILE *file = fopen(path.c_str(), "r");
+  if (file == nullptr)
+  {
+    return out;
+  }
+  char buf[256];
+  size_t len;
+  while ((len = fread(buf, 1, sizeof(buf), file)) > 0)
+  {
+    out.append(buf, len);
+  }
+  fclose(file);
+  return out;
+}
+
+/** \brief every number of a sysfs list like `0-3,8-11` */
+static std::vector<int> parse_list(const std::string &text)
+{
+  std::vector<int> out;
+  const char *cursor = text.c_str();
+  while (*cursor != '\0' && *cursor != '\n')
+  {
+    char *end;
+    long first = strtol(cursor, &end, 10);
+    if (end == cursor)
+    {
+      break;
+    }
+    long last = first;
+    if (*end == '-')
+    {
+      cursor = end + 1;
+      last = strtol(cursor, &end, 10);
+      if (end == cursor)
+      {
+        break;
+      }
+    }
+    for (long i = first; i <= last; i++)
+    {
+      out.push_back((int)i);
+    }
+    cursor = *end == ',' ? end + 1 : end;
+  }
+  return out;
+}
+
+NumaTopology::NumaTopology(void)
+{
+  for (int node : parse_list(read_file(NUMA_NODE_PATH "/online")))
+  {
+    std::string path =
+        NUMA_NODE_PATH "/node" + std::to_string(node) + "/cpulist";
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : parse_list(read_file(path)))
+    {
+      if (cpu < CPU_SETSIZE)
+      {
+        CPU_SET(cpu, &set);
+      }
+    }
+    // memory only nodes have nothing to run a thread on
+    if (CPU_COUNT(&set) > 0)
+    {
+      nodes.push_back(node);
+      cpus.push_back(set);
+    }
+  }
+
+  if (nodes.empty())
+  {
+    nodes.push_back(0);
+  }
+}
+
+static const NumaTopology &topology(void)
+{
+  static const NumaTopology instance;
+  return instance;
+}
+
+/** \brief `value` rounded up to whole huge pages */
+static uintptr_t round_huge(uintptr_t value)
+{
+  return (value + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1);
+}
+
+uint32_t numa_node_count(void) { return topology().nodes.size(); }
+
+uint32_t numa_current_node(void)
+{
+  const NumaTopology &topo = topology();
+  if (topo.nodes.size() < 2)
+  {
+    return 0;
+  }
+
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+  {
+    return 0;
+  }
+  for (size_t i = 0; i < topo.nodes.size(); i++)
+  {
+    if (topo.nodes[i] == (int)node)
+    {
+      return i;
+    }
+  }
+  return 0;
+}
+
+bool numa_bind_thread(uint32_t node)
+{
+  const NumaTopology &topo = topology();
+  if (node >= topo.cpus.size())
+  {
+    return false;
+  }
+  return sched_setaffinity(0, sizeof(cpu_set_t), &topo.cpus[node]) == 0;
+}
+
+void numa_prefer_node(int32_t node)
+{
+  const NumaTopology &topo = topology();
+  if (topo.nodes.size() < 2)
+  {
+    return;
+  }
+
+  // a single word of mask covers the first 64 node ids
+  if (node < 0 || (size_t)node >= topo.nodes.size() || topo.nodes[node] >= 64)
+  {
+    syscall(SYS_set_mempolicy, NUMA_MPOL_DEFAULT, nullptr, 0);
+    return;
+  }
+  unsigned long mask = 1UL << topo.nodes[node];
+  syscall(SYS_set_mempolicy, NUMA_MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1);
+}
+
+void numa_interleave(const void *data, size_t size)
+{
+  const NumaTopology &topo = topology();
+  if (topo.nodes.size() < 2)
+  {
+    return;
+  }
+
+  unsigned long mask = 0;
+  for (int node : topo.nodes)
+  {
+    if (node < 64)
+    {
+      mask |= 1UL << node;
+    }
+  }
+  // only the pages wholly inside of the buffer, the rest may hold anything
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t start = ((uintptr_t)data + page - 1) & ~(page - 1);
+  uintptr_t end = ((uintptr_t)data + size) & ~(page - 1);
+  if (start < end)
+  {
+    syscall(SYS_mbind, start, end - start, NUMA_MPOL_INTERLEAVE, &mask,
+            sizeof(mask) * 8 + 1, NUMA_MPOL_MF_MOVE);
+  }
+}
+
+void advise_huge_pages(const void *data, size_t size)
+{
+#ifdef MADV_HUGEPAGE
+  uintptr_t start = round_huge((uintptr_t)data);
+  uintptr_t end = ((uintptr_t)data + size) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1);
+  if (start < end)
+  {
+    madvise((void *)start, end - start, MADV_HUGEPAGE);
+  }
+#else
+  (void)data;
+  (void)size;
+#endif
+}
+
+uint8_t *huge_page_alloc(size_t size)
+{
+  // a huge page more than needed, so an aligned run can be cut out of it
+  size_t mapped = round_huge(size);
+  void *raw = mmap(nullptr, mapped + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED)
+  {
+    return nullptr;
+  }
+
+  uintptr_t aligned = round_huge((uintptr_t)raw);
+  size_t head = aligned - (uintptr_t)raw;
+  if (head != 0)
+  {
+    munmap(raw, head);
+  }
+  if (HUGE_PAGE_SIZE - head != 0)
+  {
+    munmap((void *)(aligned + mapped), HUGE_PAGE_SIZE - head);
+  }
+  advise_huge_pages((void *)aligned, mapped);
+  return (uint8_t *)aligned;
+}
+
+void huge_page_free(uint8_t *data, size_t size)
+{
+  if (data != nullptr)
+  {
+    munmap(data, round_huge(size));
+  }
+}
@@ -0,0 +1,63 @@
+/// \file numa_placement.hh
+/// \brief Where lifting threads run and where their memory lives
+///
+/// On a machine with more than one NUMA node, memory is placed on the node
+/// of the thread that first touches it. A parallel lift that forks every
+/// handle from the main thread leaves all of their caches on one node,
+/// which makes every other node's threads stall on remote reads. These
+/// calls pin a thread to the CPUs of a node and put allocations on a given
+/// node, and spread or advise huge pages for buffers.
+///
+/// Nodes are numbered `0..numa_node_count()` in the order the kernel lists
+/// the nodes with CPUs, whatever their ids. Everything is best effort: with
+/// one node, without the syscalls or with transparent huge pages turned
+/// off, the calls do nothing.
+#ifndef __NUMA_PLACEMENT_HH__
+#define __NUMA_PLACEMENT_HH__
+
+#include <cstddef>
+#include <cstdint>
+
+/// Size of a transparent huge page on x86-64 and 4K page AArch64
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+/** \brief NUMA nodes with CPUs, 1 if the topology can't be read */
+uint32_t numa_node_count(void);
+
+/** \brief node of the CPU the calling thread runs on right now */
+uint32_t numa_current_node(void);
+
+/**
+ * \brief runs the calling thread only on the CPUs of `node` from now on,
+ * false if it couldn't be pinned
+ */
+bool numa_bind_thread(uint32_t node);
+
+/**
+ * \brief allocates the pages the calling thread touches first on `node`
+ * from now on, or on its own node again for a negative `node`
+ */
+void numa_prefer_node(int32_t node);
+
+/**
+ * \brief spreads the whole pages of `[data, data + size)` evenly over
+ * every node, moving the pages already there. For buffers every node reads.
+ */
+void numa_interleave(const void *data, size_t size);
+
+/**
+ * \brief asks for the `HUGE_PAGE_SIZE` aligned part of `[data, data + size)`
+ * to be backed by transparent huge pages
+ */
+void advise_huge_pages(const void *data, size_t size);
+
+/**
+ * \brief maps `size` bytes (rounded up to whole huge pages) aligned to
+ * `HUGE_PAGE_SIZE` and advised for huge pages, null if it can't be mapped
+ */
+uint8_t *huge_page_alloc(size_t size);
+
+/** \brief unmaps a `huge_page_alloc` of `size` bytes */
+void huge_page_free(uint8_t *data, size_t size);
+
+#endif
@@ -130,6 +130,37 @@ uintb OpBehavior::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) c
   throw LowlevelError("Binary emulation unimplemented for "+name);
 }
 
+/// Evaluates every element of \b in1 in turn.  Element \e i of the output array is the
+/// same value evaluateUnary() returns for element \e i of the input.  Derived classes
+/// override this with a loop simple enough for the compiler to vectorize.
+/// \param sizeout is the size of the output in bytes
+/// \param sizein is the size of the input in bytes
+/// \param in1 is the array of input values
+/// \param out is the array receiving the output values, which may be \b in1
+/// \param count is the number of elements in each array
+void OpBehavior::evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = evaluateUnary(sizeout,sizein,in1[i]);
+}
+
+/// Evaluates every pair of elements of \b in1 and \b in2 in turn.  Element \e i of the
+/// output array is the same value evaluateBinary() returns for element \e i of the inputs.
+/// Derived classes override this with a loop simple enough for the compiler to vectorize.
+/// \param sizeout is the size of the output in bytes
+/// \param sizein is the size of the inputs in bytes
+/// \param in1 is the array of first input values
+/// \param in2 is the array of second input values
+/// \param out is the array receiving the output values, which may be either input
+/// \param count is the number of elements in each array
+void OpBehavior::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = evaluateBinary(sizeout,sizein,in1[i],in2[i]);
+}
+
 /// If the output value is known, recover the input value.
 /// \param sizeout is the size of the output in bytes
 /// \param out is the output value
@@ -161,6 +192,13 @@ uintb OpBehaviorCopy::evaluateUnary(int4 sizeout,int4 sizein,uintb in1) const
   return in1;
 }
 
+void OpBehaviorCopy::evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = in1[i];
+}
+
 uintb OpBehaviorCopy::recoverInputUnary(int4 sizeout,uintb out,int4 sizein) const
 
 {
@@ -174,6 +212,13 @@ uintb OpBehaviorEqual::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb i
   return res;
 }
 
+void OpBehaviorEqual::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = (in1[i] == in2[i]) ? 1 : 0;
+}
+
 uintb OpBehaviorNotEqual::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -181,6 +226,13 @@ uintb OpBehaviorNotEqual::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uint
   return res;
 }
 
+void OpBehaviorNotEqual::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = (in1[i] != in2[i]) ? 1 : 0;
+}
+
 uintb OpBehaviorIntSless::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -201,6 +253,20 @@ uintb OpBehaviorIntSless::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uint
   return res;
 }
 
+void OpBehaviorIntSless::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  if (sizein<=0) {
+    for(int4 i=0;i<count;++i)
+      out[i] = 0;
+    return;
+  }
+  uintb mask = 0x80;
+  mask <<= 8*(sizein-1);
+  for(int4 i=0;i<count;++i)
+    out[i] = ((in1[i] & mask) != (in2[i] & mask)) ? (((in1[i] & mask) != 0) ? 1 : 0) : ((in1[i] < in2[i]) ? 1 : 0);
+}
+
 uintb OpBehaviorIntSlessEqual::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -221,6 +287,20 @@ uintb OpBehaviorIntSlessEqual::evaluateBinary(int4 sizeout,int4 sizein,uintb in1
   return res;
 }
 
+void OpBehaviorIntSlessEqual::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  if (sizein<=0) {
+    for(int4 i=0;i<count;++i)
+      out[i] = 0;
+    return;
+  }
+  uintb mask = 0x80;
+  mask <<= 8*(sizein-1);
+  for(int4 i=0;i<count;++i)
+    out[i] = ((in1[i] & mask) != (in2[i] & mask)) ? (((in1[i] & mask) != 0) ? 1 : 0) : ((in1[i] <= in2[i]) ? 1 : 0);
+}
+
 uintb OpBehaviorIntLess::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -228,6 +308,13 @@ uintb OpBehaviorIntLess::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb
   return res;
 }
 
+void OpBehaviorIntLess::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = (in1[i] < in2[i]) ? 1 : 0;
+}
+
 uintb OpBehaviorIntLessEqual::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -235,12 +322,26 @@ uintb OpBehaviorIntLessEqual::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,
   return res;
 }
 
+void OpBehaviorIntLessEqual::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = (in1[i] <= in2[i]) ? 1 : 0;
+}
+
 uintb OpBehaviorIntZext::evaluateUnary(int4 sizeout,int4 sizein,uintb in1) const
 
 {
   return in1;
 }
 
+void OpBehaviorIntZext::evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = in1[i];
+}
+
 uintb OpBehaviorIntZext::recoverInputUnary(int4 sizeout,uintb out,int4 sizein) const
 
 {
@@ -257,6 +358,16 @@ uintb OpBehaviorIntSext::evaluateUnary(int4 sizeout,int4 sizein,uintb in1) const
   return res;
 }
 
+void OpBehaviorIntSext::evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const
+
+{
+  int4 upshift = (sizeof(intb) - sizein) * 8;
+  int4 downshift = (sizeout - sizein) * 8;
+  int4 outshift = (sizeof(uintb) - sizeout) * 8;
+  for(int4 i=0;i<count;++i)
+    out[i] = ((uintb)(((intb)(in1[i] << upshift)) >> downshift)) >> outshift;
+}
+
 uintb OpBehaviorIntSext::recoverInputUnary(int4 sizeout,uintb out,int4 sizein) const
 
 {
@@ -281,6 +392,14 @@ uintb OpBehaviorIntAdd::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb
   return res;
 }
 
+void OpBehaviorIntAdd::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  uintb mask = calc_mask(sizeout);
+  for(int4 i=0;i<count;++i)
+    out[i] = (in1[i] + in2[i]) & mask;
+}
+
 uintb OpBehaviorIntAdd::recoverInputBinary(int4 slot,int4 sizeout,uintb out,int4 sizein,uintb in) const
 
 {
@@ -295,6 +414,14 @@ uintb OpBehaviorIntSub::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb
   return res;
 }
 
+void OpBehaviorIntSub::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  uintb mask = calc_mask(sizeout);
+  for(int4 i=0;i<count;++i)
+    out[i] = (in1[i] - in2[i]) & mask;
+}
+
 uintb OpBehaviorIntSub::recoverInputBinary(int4 slot,int4 sizeout,uintb out,int4 sizein,uintb in) const
 
 {
@@ -314,6 +441,14 @@ uintb OpBehaviorIntCarry::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uint
   return res;
 }
 
+void OpBehaviorIntCarry::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  uintb mask = calc_mask(sizein);
+  for(int4 i=0;i<count;++i)
+    out[i] = (in1[i] > ((in1[i] + in2[i]) & mask)) ? 1 : 0;
+}
+
 uintb OpBehaviorIntScarry::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -330,6 +465,14 @@ uintb OpBehaviorIntScarry::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uin
   return (uintb)r;
 }
 
+void OpBehaviorIntScarry::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  int4 sign = sizein*8-1;
+  for(int4 i=0;i<count;++i)
+    out[i] = (((in1[i] + in2[i]) >> sign) ^ (in1[i] >> sign)) & ((in1[i] >> sign) ^ (in2[i] >> sign) ^ 1) & 1;
+}
+
 uintb OpBehaviorIntSborrow::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -346,6 +489,14 @@ uintb OpBehaviorIntSborrow::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,ui
   return (uintb)a;
 }
 
+void OpBehaviorIntSborrow::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  int4 sign = sizein*8-1;
+  for(int4 i=0;i<count;++i)
+    out[i] = ((in1[i] >> sign) ^ ((in1[i] - in2[i]) >> sign)) & (((in1[i] - in2[i]) >> sign) ^ (in2[i] >> sign) ^ 1) & 1;
+}
+
 uintb OpBehaviorInt2Comp::evaluateUnary(int4 sizeout,int4 sizein,uintb in1) const
 
 {
@@ -353,6 +504,14 @@ uintb OpBehaviorInt2Comp::evaluateUnary(int4 sizeout,int4 sizein,uintb in1) cons
   return res;
 }
 
+void OpBehaviorInt2Comp::evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const
+
+{
+  uintb mask = calc_mask(sizein);
+  for(int4 i=0;i<count;++i)
+    out[i] = (~(in1[i] - 1)) & mask;
+}
+
 uintb OpBehaviorInt2Comp::recoverInputUnary(int4 sizeout,uintb out,int4 sizein) const
 
 {
@@ -367,6 +526,14 @@ uintb OpBehaviorIntNegate::evaluateUnary(int4 sizeout,int4 sizein,uintb in1) con
   return res;
 }
 
+void OpBehaviorIntNegate::evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const
+
+{
+  uintb mask = calc_mask(sizein);
+  for(int4 i=0;i<count;++i)
+    out[i] = (~in1[i]) & mask;
+}
+
 uintb OpBehaviorIntNegate::recoverInputUnary(int4 sizeout,uintb out,int4 sizein) const
 
 {
@@ -381,6 +548,13 @@ uintb OpBehaviorIntXor::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb
   return res;
 }
 
+void OpBehaviorIntXor::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = in1[i] ^ in2[i];
+}
+
 uintb OpBehaviorIntAnd::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -388,6 +562,13 @@ uintb OpBehaviorIntAnd::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb
   return res;
 }
 
+void OpBehaviorIntAnd::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = in1[i] & in2[i];
+}
+
 uintb OpBehaviorIntOr::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -395,6 +576,13 @@ uintb OpBehaviorIntOr::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb i
   return res;
 }
 
+void OpBehaviorIntOr::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = in1[i] | in2[i];
+}
+
 uintb OpBehaviorIntLeft::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -405,6 +593,15 @@ uintb OpBehaviorIntLeft::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb
     return res;
 }
 
+void OpBehaviorIntLeft::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  uintb mask = calc_mask(sizeout);
+  uintb bits = sizeout*8;
+  for(int4 i=0;i<count;++i)
+    out[i] = (in2[i] >= bits) ? 0 : ((in1[i] << in2[i]) & mask);
+}
+
 uintb OpBehaviorIntLeft::recoverInputBinary(int4 slot,int4 sizeout,uintb out,int4 sizein,uintb in) const
 
 {
@@ -426,6 +623,15 @@ uintb OpBehaviorIntRight::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uint
   return res;
 }
 
+void OpBehaviorIntRight::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  uintb mask = calc_mask(sizeout);
+  uintb bits = sizeout*8;
+  for(int4 i=0;i<count;++i)
+    out[i] = (in2[i] >= bits) ? 0 : ((in1[i] & mask) >> in2[i]);
+}
+
 uintb OpBehaviorIntRight::recoverInputBinary(int4 slot,int4 sizeout,uintb out,int4 sizein,uintb in) const
 
 {
@@ -458,6 +664,23 @@ uintb OpBehaviorIntSright::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uin
   return res;
 }
 
+void OpBehaviorIntSright::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  uintb signbit = 0x80;
+  signbit <<= 8*(sizein-1);
+  uintb maskin = calc_mask(sizein);
+  uintb maskout = calc_mask(sizeout);
+  uintb bits = sizeout*8;
+  for(int4 i=0;i<count;++i) {
+    bool negative = (in1[i] & signbit) != 0;
+    if (in2[i] >= bits)
+      out[i] = negative ? maskout : 0;
+    else
+      out[i] = (in1[i] >> in2[i]) | (negative ? ((maskin >> in2[i]) ^ maskin) : 0);
+  }
+}
+
 uintb OpBehaviorIntSright::recoverInputBinary(int4 slot,int4 sizeout,uintb out,int4 sizein,uintb in) const
 
 {
@@ -483,6 +706,14 @@ uintb OpBehaviorIntMult::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb
   return res;
 }
 
+void OpBehaviorIntMult::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  uintb mask = calc_mask(sizeout);
+  for(int4 i=0;i<count;++i)
+    out[i] = (in1[i] * in2[i]) & mask;
+}
+
 uintb OpBehaviorIntDiv::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -532,6 +763,13 @@ uintb OpBehaviorBoolNegate::evaluateUnary(int4 sizeout,int4 sizein,uintb in1) co
   return res;
 }
 
+void OpBehaviorBoolNegate::evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = in1[i] ^ 1;
+}
+
 uintb OpBehaviorBoolXor::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -539,6 +777,13 @@ uintb OpBehaviorBoolXor::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb
   return res;
 }
 
+void OpBehaviorBoolXor::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = in1[i] ^ in2[i];
+}
+
 uintb OpBehaviorBoolAnd::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -546,6 +791,13 @@ uintb OpBehaviorBoolAnd::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb
   return res;
 }
 
+void OpBehaviorBoolAnd::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = in1[i] & in2[i];
+}
+
 uintb OpBehaviorBoolOr::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -553,6 +805,13 @@ uintb OpBehaviorBoolOr::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb
   return res;
 }
 
+void OpBehaviorBoolOr::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  for(int4 i=0;i<count;++i)
+    out[i] = in1[i] | in2[i];
+}
+
 uintb OpBehaviorFloatEqual::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -743,6 +1002,14 @@ uintb OpBehaviorPiece::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb i
   return res;
 }
 
+void OpBehaviorPiece::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  int4 shift = (sizeout-sizein)*8;
+  for(int4 i=0;i<count;++i)
+    out[i] = (in1[i] << shift) | in2[i];
+}
+
 uintb OpBehaviorSubpiece::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const
 
 {
@@ -750,6 +1017,14 @@ uintb OpBehaviorSubpiece::evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uint
   return res;
 }
 
+void OpBehaviorSubpiece::evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const
+
+{
+  uintb mask = calc_mask(sizeout);
+  for(int4 i=0;i<count;++i)
+    out[i] = (in1[i] >> (in2[i] * 8)) & mask;
+}
+
 uintb OpBehaviorPopcount::evaluateUnary(int4 sizeout,int4 sizein,uintb in1) const
 
 {
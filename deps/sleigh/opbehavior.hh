@@ -39,6 +39,8 @@ struct EvaluationError : public LowlevelError {
 /// These classes describe the most basic behaviors and include:
 ///    * uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb int2)
 ///    * uintb evaluateUnary(int4 sizeout,int4 sizein,uintb in1)
+///    * void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count)
+///    * void evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count)
 ///    * uintb recoverInputBinary(int4 slot,int4 sizeout,uintb out,int4 sizein,uintb in)
 ///    * uintb recoverInputUnary(int4 sizeout,uintb out,int4 sizein)
 class OpBehavior {
@@ -67,6 +69,12 @@ public:
   /// \brief Emulate the binary op-code on input values
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
 
+  /// \brief Emulate the unary op-code on an array of input values
+  virtual void evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const;
+
+  /// \brief Emulate the binary op-code on arrays of input values
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
+
   /// \brief Reverse the binary op-code operation, recovering an input value
   virtual uintb recoverInputBinary(int4 slot,int4 sizeout,uintb out,int4 sizein,uintb in) const;
 
@@ -126,6 +134,7 @@ class OpBehaviorCopy : public OpBehavior {
 public:
   OpBehaviorCopy(void) : OpBehavior(CPUI_COPY,true) {}	///< Constructor
   virtual uintb evaluateUnary(int4 sizeout,int4 sizein,uintb in1) const;
+  virtual void evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const;
   virtual uintb recoverInputUnary(int4 sizeout,uintb out,int4 sizein) const;
 };
 
@@ -134,6 +143,7 @@ class OpBehaviorEqual : public OpBehavior {
 public:
   OpBehaviorEqual(void) : OpBehavior(CPUI_INT_EQUAL,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_NOTEQUAL behavior
@@ -141,6 +151,7 @@ class OpBehaviorNotEqual : public OpBehavior {
 public:
   OpBehaviorNotEqual(void) : OpBehavior(CPUI_INT_NOTEQUAL,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_SLESS behavior
@@ -148,6 +159,7 @@ class OpBehaviorIntSless : public OpBehavior {
 public:
   OpBehaviorIntSless(void) : OpBehavior(CPUI_INT_SLESS,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_SLESSEQUAL behavior
@@ -155,6 +167,7 @@ class OpBehaviorIntSlessEqual : public OpBehavior {
 public:
   OpBehaviorIntSlessEqual(void) : OpBehavior(CPUI_INT_SLESSEQUAL,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_LESS behavior
@@ -162,6 +175,7 @@ class OpBehaviorIntLess : public OpBehavior {
 public:
   OpBehaviorIntLess(void) : OpBehavior(CPUI_INT_LESS,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_LESSEQUAL behavior
@@ -169,6 +183,7 @@ class OpBehaviorIntLessEqual : public OpBehavior {
 public:
   OpBehaviorIntLessEqual(void): OpBehavior(CPUI_INT_LESSEQUAL,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_ZEXT behavior
@@ -176,6 +191,7 @@ class OpBehaviorIntZext : public OpBehavior {
 public:
   OpBehaviorIntZext(void): OpBehavior(CPUI_INT_ZEXT,true) {}	///< Constructor
   virtual uintb evaluateUnary(int4 sizeout,int4 sizein,uintb in1) const;
+  virtual void evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const;
   virtual uintb recoverInputUnary(int4 sizeout,uintb out,int4 sizein) const;
 };
 
@@ -184,6 +200,7 @@ class OpBehaviorIntSext : public OpBehavior {
 public:
   OpBehaviorIntSext(void): OpBehavior(CPUI_INT_SEXT,true) {}	///< Constructor
   virtual uintb evaluateUnary(int4 sizeout,int4 sizein,uintb in1) const;
+  virtual void evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const;
   virtual uintb recoverInputUnary(int4 sizeout,uintb out,int4 sizein) const;
 };
 
@@ -192,6 +209,7 @@ class OpBehaviorIntAdd : public OpBehavior {
 public:
   OpBehaviorIntAdd(void): OpBehavior(CPUI_INT_ADD,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
   virtual uintb recoverInputBinary(int4 slot,int4 sizeout,uintb out,int4 sizein,uintb in) const;
 };
 
@@ -200,6 +218,7 @@ class OpBehaviorIntSub : public OpBehavior {
 public:
   OpBehaviorIntSub(void): OpBehavior(CPUI_INT_SUB,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
   virtual uintb recoverInputBinary(int4 slot,int4 sizeout,uintb out,int4 sizein,uintb in) const;
 };
 
@@ -208,6 +227,7 @@ class OpBehaviorIntCarry : public OpBehavior {
 public:
   OpBehaviorIntCarry(void): OpBehavior(CPUI_INT_CARRY,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_SCARRY behavior
@@ -215,6 +235,7 @@ class OpBehaviorIntScarry : public OpBehavior {
 public:
   OpBehaviorIntScarry(void): OpBehavior(CPUI_INT_SCARRY,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_SBORROW behavior
@@ -222,6 +243,7 @@ class OpBehaviorIntSborrow : public OpBehavior {
 public:
   OpBehaviorIntSborrow(void): OpBehavior(CPUI_INT_SBORROW,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_2COMP behavior
@@ -229,6 +251,7 @@ class OpBehaviorInt2Comp : public OpBehavior {
 public:
   OpBehaviorInt2Comp(void): OpBehavior(CPUI_INT_2COMP,true) {}	///< Constructor
   virtual uintb evaluateUnary(int4 sizeout,int4 sizein,uintb in1) const;
+  virtual void evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const;
   virtual uintb recoverInputUnary(int4 sizeout,uintb out,int4 sizein) const;
 };
 
@@ -237,6 +260,7 @@ class OpBehaviorIntNegate : public OpBehavior {
 public:
   OpBehaviorIntNegate(void): OpBehavior(CPUI_INT_NEGATE,true) {}	///< Constructor
   virtual uintb evaluateUnary(int4 sizeout,int4 sizein,uintb in1) const;
+  virtual void evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const;
   virtual uintb recoverInputUnary(int4 sizeout,uintb out,int4 sizein) const;
 };
 
@@ -245,6 +269,7 @@ class OpBehaviorIntXor : public OpBehavior {
 public:
   OpBehaviorIntXor(void): OpBehavior(CPUI_INT_XOR,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_AND behavior
@@ -252,6 +277,7 @@ class OpBehaviorIntAnd : public OpBehavior {
 public:
   OpBehaviorIntAnd(void): OpBehavior(CPUI_INT_AND,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_OR behavior
@@ -259,6 +285,7 @@ class OpBehaviorIntOr : public OpBehavior {
 public:
   OpBehaviorIntOr(void): OpBehavior(CPUI_INT_OR,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_LEFT behavior
@@ -266,6 +293,7 @@ class OpBehaviorIntLeft : public OpBehavior {
 public:
   OpBehaviorIntLeft(void): OpBehavior(CPUI_INT_LEFT,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
   virtual uintb recoverInputBinary(int4 slot,int4 sizeout,uintb out,int4 sizein,uintb in) const;
 };
 
@@ -274,6 +302,7 @@ class OpBehaviorIntRight : public OpBehavior {
 public:
   OpBehaviorIntRight(void): OpBehavior(CPUI_INT_RIGHT,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
   virtual uintb recoverInputBinary(int4 slot,int4 sizeout,uintb out,int4 sizein,uintb in) const;
 };
 
@@ -282,6 +311,7 @@ class OpBehaviorIntSright : public OpBehavior {
 public:
   OpBehaviorIntSright(void): OpBehavior(CPUI_INT_SRIGHT,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
   virtual uintb recoverInputBinary(int4 slot,int4 sizeout,uintb out,int4 sizein,uintb in) const;
 };
 
@@ -290,6 +320,7 @@ class OpBehaviorIntMult : public OpBehavior {
 public:
   OpBehaviorIntMult(void): OpBehavior(CPUI_INT_MULT,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_INT_DIV behavior
@@ -325,6 +356,7 @@ class OpBehaviorBoolNegate : public OpBehavior {
 public:
   OpBehaviorBoolNegate(void): OpBehavior(CPUI_BOOL_NEGATE,true) {}	///< Constructor
   virtual uintb evaluateUnary(int4 sizeout,int4 sizein,uintb in1) const;
+  virtual void evaluateUnaryN(int4 sizeout,int4 sizein,const uintb *in1,uintb *out,int4 count) const;
 };
 
 /// CPUI_BOOL_XOR behavior
@@ -332,6 +364,7 @@ class OpBehaviorBoolXor : public OpBehavior {
 public:
   OpBehaviorBoolXor(void): OpBehavior(CPUI_BOOL_XOR,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_BOOL_AND behavior
@@ -339,6 +372,7 @@ class OpBehaviorBoolAnd : public OpBehavior {
 public:
   OpBehaviorBoolAnd(void): OpBehavior(CPUI_BOOL_AND,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_BOOL_OR behavior
@@ -346,6 +380,7 @@ class OpBehaviorBoolOr : public OpBehavior {
 public:
   OpBehaviorBoolOr(void): OpBehavior(CPUI_BOOL_OR,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_FLOAT_EQUAL behavior
@@ -497,6 +532,7 @@ class OpBehaviorPiece : public OpBehavior {
 public:
   OpBehaviorPiece(void) : OpBehavior(CPUI_PIECE,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_SUBPIECE behavior
@@ -504,6 +540,7 @@ class OpBehaviorSubpiece : public OpBehavior {
 public:
   OpBehaviorSubpiece(void) : OpBehavior(CPUI_SUBPIECE,false) {}	///< Constructor
   virtual uintb evaluateBinary(int4 sizeout,int4 sizein,uintb in1,uintb in2) const;
+  virtual void evaluateBinaryN(int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,uintb *out,int4 count) const;
 };
 
 /// CPUI_POPCOUNT behavior
@@ -0,0 +1,233 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "error.hh"
+#include "mapped_file.hh"
+#include "packed_spec.hh"
+
+/// Deepest element nesting accepted while reading, real specs stay well
+/// under a dozen levels
+#define PACKED_SPEC_MAX_DEPTH 256
+
+/** \brief interns every string of a DOM while flattening its elements */
+class PackedSpecWriter
+{
+  std::map<std::string, uint32_t> string_ids;
+  std::vector<const std::string *> strings;
+
+  uint32_t intern(const std::string &str)
+  {
+    std::map<std::string, uint32_t>::iterator it = string_ids.find(str);
+    if (it != string_ids.end())
+    {
+      return it->second;
+    }
+
+    uint32_t id = strings.size();
+    it = string_ids.insert(std::make_pair(str, id)).first;
+    strings.push_back(&it->first);
+    return id;
+  }
+
+public:
+  std::vector<uint32_t> elements;
+
+  void add_element(const ghidra::Element *el)
+  {
+    elements.push_back(intern(el->getName()));
+    elements.push_back(el->getNumAttributes());
+    for (int32_t i = 0; i < el->getNumAttributes(); i++)
+    {
+      elements.push_back(intern(el->getAttributeName(i)));
+      elements.push_back(intern(el->getAttributeValue(i)));
+    }
+    elements.push_back(intern(el->getContent()));
+
+    const ghidra::List &children = el->getChildren();
+    elements.push_back(children.size());
+    ghidra::List::const_iterator it;
+    for (it = children.begin(); it != children.end(); it++)
+    {
+      add_element(*it);
+    }
+  }
+
+  void write(std::ostream &s)
+  {
+    uint32_t header[3] = {PACKED_SPEC_BYTE_ORDER, (uint32_t)strings.size(),
+                          (uint32_t)elements.size()};
+    s.write(PACKED_SPEC_MAGIC, PACKED_SPEC_MAGIC_LEN);
+    s.write((const char *)header, sizeof(header));
+
+    for (size_t i = 0; i < strings.size(); i++)
+    {
+      uint32_t len = strings[i]->size();
+      s.write((const char *)&len, sizeof(len));
+      s.write(strings[i]->data(), len);
+    }
+
+    s.write((const char *)elements.data(), sizeof(uint32_t) * elements.size());
+  }
+};
+
+/** \brief rebuilds the DOM out of a mapped packed spec */
+class PackedSpecReader
+{
+  const uint8_t *cursor;
+  const uint8_t *end;
+  std::vector<std::string> strings;
+
+  uint32_t read_u32(void)
+  {
+    if (end - cursor < (ptrdiff_t)sizeof(uint32_t))
+    {
+      throw ghidra::DecoderError("Truncated packed spec");
+    }
+
+    // the string table leaves the rest of the file unaligned
+    uint32_t out;
+    memcpy(&out, cursor, sizeof(out));
+    cursor += sizeof(out);
+    return out;
+  }
+
+  const std::string &read_string(void)
+  {
+    uint32_t id = read_u32();
+    if (id >= strings.size())
+    {
+      throw ghidra::DecoderError("Bad string index in packed spec");
+    }
+
+    return strings[id];
+  }
+
+  void read_element(ghidra::Element *el, int32_t depth)
+  {
+    if (depth > PACKED_SPEC_MAX_DEPTH)
+    {
+      throw ghidra::DecoderError("Packed spec nested too deeply");
+    }
+
+    el->setName(read_string());
+    uint32_t attr_count = read_u32();
+    for (uint32_t i = 0; i < attr_count; i++)
+    {
+      const std::string &name = read_string();
+      el->addAttribute(name, read_string());
+    }
+
+    const std::string &content = read_string();
+    el->addContent(content.data(), 0, content.size());
+
+    uint32_t child_count = read_u32();
+    for (uint32_t i = 0; i < child_count; i++)
+    {
+      // the parent owns the child before it is read, so nothing leaks if
+      // reading it throws
+      ghidra::Element *child = new ghidra::Element(el);
+      el->addChild(child);
+      read_element(child, depth + 1);
+    }
+  }
+
+public:
+  PackedSpecReader(const uint8_t *data, size_t size)
+      : cursor(data), end(data + size)
+  {
+  }
+
+  ghidra::Document *read(void)
+  {
+    if (end - cursor < PACKED_SPEC_MAGIC_LEN ||
+        memcmp(cursor, PACKED_SPEC_MAGIC, PACKED_SPEC_MAGIC_LEN) != 0)
+    {
+      throw ghidra::DecoderError("Not a packed spec");
+    }
+    cursor += PACKED_SPEC_MAGIC_LEN;
+
+    if (read_u32() != PACKED_SPEC_BYTE_ORDER)
+    {
+      throw ghidra::DecoderError("Packed spec has the wrong byte order");
+    }
+
+    uint32_t string_count = read_u32();
+    uint32_t element_words = read_u32();
+    strings.reserve(string_count);
+    for (uint32_t i = 0; i < string_count; i++)
+    {
+      uint32_t len = read_u32();
+      if ((uint64_t)(end - cursor) < len)
+      {
+        throw ghidra::DecoderError("Truncated packed spec");
+      }
+      strings.emplace_back((const char *)cursor, len);
+      cursor += len;
+    }
+
+    if ((uint64_t)(end - cursor) != (uint64_t)element_words * sizeof(uint32_t))
+    {
+      throw ghidra::DecoderError("Packed spec element stream size mismatch");
+    }
+
+    std::unique_ptr<ghidra::Document> doc(new ghidra::Document);
+    ghidra::Element *root = new ghidra::Element(doc.get());
+    doc->addChild(root);
+    read_element(root, 0);
+    return doc.release();
+  }
+};
+
+bool packed_spec_detect(const char *path)
+{
+  char magic[PACKED_SPEC_MAGIC_LEN];
+  std::ifstream s(path, std::ios::binary);
+  if (!s.read(magic, PACKED_SPEC_MAGIC_LEN))
+  {
+    return false;
+  }
+
+  return memcmp(magic, PACKED_SPEC_MAGIC, PACKED_SPEC_MAGIC_LEN) == 0;
+}
+
+void packed_spec_write(const ghidra::Element *root, const char *path)
+{
+  PackedSpecWriter writer;
+  writer.add_element(root);
+
+  std::ofstream s(path, std::ios::binary | std::ios::trunc);
+  if (!s)
+  {
+    throw ghidra::LowlevelError(std::string("Unable to create ") + path);
+  }
+
+  writer.write(s);
+  s.flush();
+  if (!s)
+  {
+    throw ghidra::LowlevelError(std::string("Unable to write ") + path);
+  }
+}
+
+ghidra::Document *packed_spec_read(const char *path)
+{
+  std::unique_ptr<MappedFile> file;
+  try
+  {
+    file.reset(new MappedFile(path));
+  }
+  catch (ghidra::LowlevelError &err)
+  {
+    throw ghidra::DecoderError(err.explain);
+  }
+
+  // the whole file is read exactly once front to back
+  file->advise_sequential();
+  PackedSpecReader reader(file->data, file->size);
+  return reader.read();
+}
@@ -0,0 +1,56 @@
+/// \file packed_spec.hh
+/// \brief Pre-parsed `.sla` documents that load without the XML parser
+///
+/// A packed spec is the DOM of a `.sla` written out in pre-order with every
+/// distinct string stored once. Loading one is a single mmap + walk over
+/// the element stream, instead of lexing and parsing the XML text (which is
+/// most of the cost of loading the bigger specs).
+///
+/// Layout, every integer is a host byte order `uint32_t`:
+///
+/// ```
+/// char     magic[8]       PACKED_SPEC_MAGIC
+/// uint32_t byte_order     PACKED_SPEC_BYTE_ORDER, as written by the host
+/// uint32_t string_count
+/// uint32_t element_words  number of `uint32_t` in the element stream
+/// string_count x { uint32_t len; char data[len]; }
+/// uint32_t elements[element_words]
+/// ```
+///
+/// Each element in the stream is encoded as
+/// `name, attr_count, attr_count x { name, value }, content, child_count`
+/// followed by its children, where every string is an index into the
+/// string table.
+#ifndef __PACKED_SPEC_HH__
+#define __PACKED_SPEC_HH__
+
+#include "xml.hh"
+
+/// First bytes of every packed spec, the last byte is the format version
+#define PACKED_SPEC_MAGIC "SLAPACK\x01"
+#define PACKED_SPEC_MAGIC_LEN 8
+
+/// Written as a native `uint32_t` to reject specs packed on a host with the
+/// other byte order
+#define PACKED_SPEC_BYTE_ORDER 0x01020304
+
+/**
+ * \brief returns true if the file at `path` starts with the packed spec
+ * magic, false if it doesn't or can't be read
+ */
+bool packed_spec_detect(const char *path);
+
+/**
+ * \brief writes the DOM rooted at `root` to `path` as a packed spec,
+ * throws `ghidra::LowlevelError` if the file can't be written
+ */
+void packed_spec_write(const ghidra::Element *root, const char *path);
+
+/**
+ * \brief maps the packed spec at `path` and rebuilds its DOM, the caller
+ * owns the returned document. Throws `ghidra::DecoderError` if the file
+ * can't be read or is malformed.
+ */
+ghidra::Document *packed_spec_read(const char *path);
+
+#endif
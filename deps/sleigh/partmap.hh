@@ -20,6 +20,7 @@
 #define __PARTMAP_HH__
 
 #include <map>
+#include <vector>
 
 namespace ghidra {
 
@@ -46,6 +47,10 @@ namespace ghidra {
 /// in the linear space. At each split point, the associated value object is split
 /// into two objects.  At any point the value object describing some part of the linear space
 /// can be changed.
+///
+/// A partmap that is looked up far more often than it is split can be \e frozen, which
+/// copies the split points into one sorted array that is binary searched instead of
+/// walking the tree. Introducing or removing a split point thaws the map again.
 template<typename _linetype,typename _valuetype>
 class partmap {
 public:
@@ -55,7 +60,15 @@ public:
 private:
   maptype database;						///< Map from linear split points to the value objects
   _valuetype defaultvalue;					///< The value object \e before the first split point
+  std::vector<_linetype> flatpoints;				///< Split points of a frozen map, in order
+  std::vector<const _valuetype *> flatvalues;			///< Value object of each of \e flatpoints
+  bool frozen;							///< Set if lookups go through the flat arrays
+  int flatFind(const _linetype &pnt) const;			///< Index of the last flat split point at or before a point
 public:
+  partmap(void) { frozen = false; }				///< Construct an empty map
+  partmap(const partmap &op2) : database(op2.database), defaultvalue(op2.defaultvalue) { frozen = false; }	///< Copy the split points, thawed
+  partmap &operator=(const partmap &op2) {
+    database = op2.database; defaultvalue = op2.defaultvalue; thaw(); return *this; }	///< Assign the split points, thawed
   _valuetype &getValue(const _linetype &pnt);			///< Get the value object at a point
   const _valuetype &getValue(const _linetype &pnt) const;	///< Get the value object at a point
   const _valuetype &bounds(const _linetype &pnt,_linetype &before,_linetype &after,int &valid) const;
@@ -69,10 +82,70 @@ public:
   iterator end(void) { return database.end(); }				///< End of split points
   const_iterator begin(const _linetype &pnt) const { return database.lower_bound(pnt); }	///< Get first split point after given point
   iterator begin(const _linetype &pnt) { return database.lower_bound(pnt); }	///< Get first split point after given point
-  void clear(void) { database.clear(); }				///< Clear all split points
+  void clear(void) { thaw(); database.clear(); }			///< Clear all split points
   bool empty(void) const { return database.empty(); }			///< Return \b true if there are no split points
+  void freeze(void);							///< Look up split points through a flat array
+  void thaw(void);							///< Look up split points through the map again
+  bool isFrozen(void) const { return frozen; }				///< Return \b true if lookups use the flat array
 };
 
+/// Binary search without an early exit, the loop only narrows \e base so the comparison can
+/// turn into a conditional move.
+/// \param pnt is the given point in the linear space
+/// \return the index into \e flatpoints of the last split point not after \e pnt, or -1
+template<typename _linetype,typename _valuetype>
+  int partmap<_linetype,_valuetype>::
+  flatFind(const _linetype &pnt) const
+
+  {
+    int count = flatpoints.size();
+    if (count == 0)
+      return -1;
+    const _linetype *base = flatpoints.data();
+    while(count > 1) {
+      int half = count / 2;
+      base = (pnt < base[half]) ? base : base + half;
+      count -= half;
+    }
+    if (pnt < *base)
+      return -1;
+    return base - flatpoints.data();
+  }
+
+/// The split points and pointers to their value objects are copied into arrays, value
+/// objects can still be changed in place. Does nothing if the map is already frozen.
+template<typename _linetype,typename _valuetype>
+  void partmap<_linetype,_valuetype>::
+  freeze(void)
+
+  {
+    if (frozen)
+      return;
+    flatpoints.clear();
+    flatvalues.clear();
+    flatpoints.reserve(database.size());
+    flatvalues.reserve(database.size());
+    const_iterator iter;
+    for(iter=database.begin();iter!=database.end();++iter) {
+      flatpoints.push_back((*iter).first);
+      flatvalues.push_back(&(*iter).second);
+    }
+    frozen = true;
+  }
+
+/// Drops the flat arrays, called by anything that changes the split points.
+template<typename _linetype,typename _valuetype>
+  void partmap<_linetype,_valuetype>::
+  thaw(void)
+
+  {
+    if (!frozen)
+      return;
+    frozen = false;
+    flatpoints.clear();
+    flatvalues.clear();
+  }
+
 /// Look up the first split point coming before the given point
 /// and return the value object it maps to. If there is no earlier split point
 /// return the default value.
@@ -83,6 +156,10 @@ template<typename _linetype,typename _valuetype>
   getValue(const _linetype &pnt)
 
   {
+    if (frozen) {
+      int idx = flatFind(pnt);
+      return idx < 0 ? defaultvalue : const_cast<_valuetype &>(*flatvalues[idx]);
+    }
     iterator iter;
 
     iter = database.upper_bound(pnt);
@@ -102,6 +179,10 @@ template<typename _linetype,typename _valuetype>
   getValue(const _linetype &pnt) const
 
   {
+    if (frozen) {
+      int idx = flatFind(pnt);
+      return idx < 0 ? defaultvalue : *flatvalues[idx];
+    }
     const_iterator iter;
 
     iter = database.upper_bound(pnt);
@@ -121,6 +202,8 @@ template<typename _linetype,typename _valuetype>
   {
     iterator iter;
 
+    thaw();
+
     iter = database.upper_bound(pnt);
     if (iter != database.begin()) {
       --iter;
@@ -177,6 +260,22 @@ template<typename _linetype,typename _valuetype>
       valid = 3;
       return defaultvalue;
     }
+    if (frozen) {
+      int idx = flatFind(pnt);
+      int next = idx + 1;
+      if (next < (int)flatpoints.size()) {
+	after = flatpoints[next];
+	valid = 0;		// Fully bounded
+      }
+      else
+	valid = 2;		// No upperbound
+      if (idx < 0) {
+	valid = 1;		// No lowerbound
+	return defaultvalue;
+      }
+      before = flatpoints[idx];
+      return *flatvalues[idx];
+    }
     const_iterator iter,enditer;
 
     enditer = database.upper_bound(pnt);
@@ -0,0 +1,991 @@
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "error.hh"
+#include "opcodes.hh"
+#include "pcode_interp.hh"
+#include "translate.hh"
+
+// labels as values are a GNU extension, which both gcc + clang have
+#if defined(__GNUC__)
+#define INTERP_THREADED 1
+#endif
+
+/// Contiguous run of `unique` space used by one instruction, packed into the
+/// scratch area at `slot`
+struct PcodeInterpreter::UniqueSpan
+{
+  uint64_t start;
+  uint64_t end;
+  uint64_t slot;
+};
+
+PcodeInterpreter::InterpInsn::~InterpInsn(void)
+{
+  for (size_t i = 0; i < raw_ops.size(); i++)
+  {
+    delete raw_ops[i];
+  }
+  for (size_t i = 0; i < raw_varnodes.size(); i++)
+  {
+    delete raw_varnodes[i];
+  }
+}
+
+PcodeInterpreter::PcodeInterpreter(ghidra::Translate *t,
+                                   ghidra::MemoryState *s,
+                                   ghidra::BreakTable *b)
+    : trans(t), memstate(s), breaktable(b)
+{
+  ghidra::OpBehavior::registerInstructions(inst, trans);
+
+  spaces.resize(trans->numSpaces());
+  for (int32_t i = 0; i < trans->numSpaces(); i++)
+  {
+    spaces[i] = trans->getSpace(i);
+  }
+  register_space = trans->getSpaceByName("register");
+  unique_space = trans->getUniqueSpace();
+  code_space = trans->getDefaultCodeSpace();
+
+  if (register_space != nullptr)
+  {
+    ghidra::MemoryFlatBank *bank = dynamic_cast<ghidra::MemoryFlatBank *>(
+        memstate->getMemoryBank(register_space));
+    if (bank != nullptr)
+    {
+      registers = bank->getData();
+      register_size = bank->getSize();
+    }
+  }
+  scratch.assign(INTERP_SCRATCH_SIZE, 0);
+
+  breaktable->setEmulate(this);
+}
+
+PcodeInterpreter::~PcodeInterpreter(void)
+{
+  for (size_t i = 0; i < inst.size(); i++)
+  {
+    delete inst[i];
+  }
+}
+
+void PcodeInterpreter::setExecuteAddress(const ghidra::Address &addr)
+{
+  current_address = addr;
+  redirected = true;
+  last = nullptr;
+}
+
+void PcodeInterpreter::clearCache(void)
+{
+  code.clear();
+  code_pages.clear();
+  code_start = UINT64_MAX;
+  code_end = 0;
+  stale.clear();
+  last = nullptr;
+}
+
+void PcodeInterpreter::dropCode(uint64_t offset, uint64_t size)
+{
+  if (size > 0 && offset < code_end && code_start < offset + size)
+  {
+    noteStore(offset, size);
+  }
+}
+
+void PcodeInterpreter::executeInstruction(void)
+{
+  if (!stale.empty())
+  {
+    dropStale();
+  }
+
+  InterpFlow from_flow = flow;
+  flow = INTERP_FLOW_BREAK;
+  if (breaktable->doAddressBreak(current_address))
+  {
+    last = nullptr;
+    return;
+  }
+
+  // the breakpoint may have moved the execute address, which unlinks `last`
+  InterpInsn **link = nullptr;
+  if (last != nullptr && from_flow == INTERP_FLOW_FALLTHRU)
+  {
+    link = &last->next;
+  }
+  else if (last != nullptr && from_flow == INTERP_FLOW_BRANCH)
+  {
+    link = &last->taken;
+  }
+  last = nullptr;
+
+  uint64_t address = current_address.getOffset();
+  InterpInsn *insn = link != nullptr ? *link : nullptr;
+  if (insn == nullptr || insn->address != address)
+  {
+    insn = &translate(address);
+    if (link != nullptr)
+    {
+      *link = insn;
+    }
+  }
+
+  run(*insn);
+  last = insn;
+}
+
+PcodeInterpreter::InterpInsn &PcodeInterpreter::translate(uint64_t address)
+{
+  std::unordered_map<uint64_t, std::unique_ptr<InterpInsn>>::iterator it =
+      code.find(address);
+  if (it != code.end())
+  {
+    return *it->second;
+  }
+
+  std::unique_ptr<InterpInsn> insn(new InterpInsn);
+  ghidra::PcodeEmitCache emit(insn->raw_ops, insn->raw_varnodes, inst, 0);
+  insn->address = address;
+  insn->length = trans->oneInstruction(
+      emit, ghidra::Address(current_address.getSpace(), address));
+  if (image != nullptr && current_address.getSpace() == code_space)
+  {
+    checkImage(*insn);
+  }
+
+  // pack every run of `unique` the instruction touches into the scratch
+  std::vector<UniqueSpan> uniques;
+  for (size_t i = 0; i < insn->raw_varnodes.size(); i++)
+  {
+    const ghidra::VarnodeData *vn = insn->raw_varnodes[i];
+    if (vn->space == unique_space)
+    {
+      UniqueSpan span = {vn->offset, vn->offset + vn->size, 0};
+      uniques.push_back(span);
+    }
+  }
+  std::sort(uniques.begin(), uniques.end(),
+            [](const UniqueSpan &lhs, const UniqueSpan &rhs)
+            { return lhs.start < rhs.start; });
+
+  size_t merged = 0;
+  uint64_t slot = 0;
+  for (size_t i = 0; i < uniques.size(); i++)
+  {
+    if (merged > 0 && uniques[i].start < uniques[merged - 1].end)
+    {
+      uniques[merged - 1].end = std::max(uniques[merged - 1].end, uniques[i].end);
+      continue;
+    }
+    uniques[merged++] = uniques[i];
+  }
+  uniques.resize(merged);
+  for (size_t i = 0; i < uniques.size(); i++)
+  {
+    uniques[i].slot = slot;
+    slot += uniques[i].end - uniques[i].start;
+  }
+  if (slot > scratch.size())
+  {
+    // doesn't fit, so this one goes through the `MemoryState`
+    uniques.clear();
+  }
+
+  insn->ops.resize(insn->raw_ops.size());
+  for (size_t i = 0; i < insn->raw_ops.size(); i++)
+  {
+    compile(insn->raw_ops[i], i, uniques, insn->ops[i]);
+  }
+
+  if (current_address.getSpace() == code_space)
+  {
+    uint64_t end = address + std::max<uint64_t>(insn->length, 1);
+    for (uint64_t page = address >> INTERP_CODE_PAGE_BITS;
+         page <= (end - 1) >> INTERP_CODE_PAGE_BITS; page++)
+    {
+      code_pages[page].push_back(address);
+    }
+    code_start = std::min(code_start, address);
+    code_end = std::max(code_end, end);
+  }
+
+  InterpInsn &out = *insn;
+  code[address] = std::move(insn);
+  return out;
+}
+
+void PcodeInterpreter::checkImage(const InterpInsn &insn) const
+{
+  if (insn.length == 0 || insn.length > INTERP_MAX_INSN_BYTES)
+  {
+    return;
+  }
+
+  uint8_t decoded[INTERP_MAX_INSN_BYTES];
+  uint8_t memory[INTERP_MAX_INSN_BYTES];
+  image->loadFill(decoded, insn.length,
+                  ghidra::Address(code_space, insn.address));
+  memstate->getChunk(memory, code_space, insn.address, insn.length);
+  if (!std::equal(decoded, decoded + insn.length, memory))
+  {
+    throw ghidra::LowlevelError("Instruction bytes were stored to");
+  }
+}
+
+void PcodeInterpreter::noteStore(uint64_t offset, uint64_t size)
+{
+  uint64_t end = offset + size;
+  bool hit = false;
+  for (uint64_t page = offset >> INTERP_CODE_PAGE_BITS;
+       page <= (end - 1) >> INTERP_CODE_PAGE_BITS && !hit; page++)
+  {
+    std::unordered_map<uint64_t, std::vector<uint64_t>>::const_iterator it =
+        code_pages.find(page);
+    if (it == code_pages.end())
+    {
+      continue;
+    }
+    for (size_t i = 0; i < it->second.size() && !hit; i++)
+    {
+      const InterpInsn &insn = *code.find(it->second[i])->second;
+      hit = insn.address < end && offset < insn.address + insn.length;
+    }
+  }
+  if (!hit)
+  {
+    return;
+  }
+
+  // dropped once the running instruction is done with its ops
+  stale.push_back(std::make_pair(offset, end));
+}
+
+void PcodeInterpreter::dropStale(void)
+{
+  std::vector<uint64_t> dropped;
+  for (size_t i = 0; i < stale.size(); i++)
+  {
+    uint64_t offset = stale[i].first;
+    uint64_t end = stale[i].second;
+    for (uint64_t page = offset >> INTERP_CODE_PAGE_BITS;
+         page <= (end - 1) >> INTERP_CODE_PAGE_BITS; page++)
+    {
+      std::unordered_map<uint64_t, std::vector<uint64_t>>::const_iterator it =
+          code_pages.find(page);
+      if (it == code_pages.end())
+      {
+        continue;
+      }
+      for (size_t j = 0; j < it->second.size(); j++)
+      {
+        const InterpInsn &insn = *code.find(it->second[j])->second;
+        if (insn.address < end && offset < insn.address + insn.length)
+        {
+          dropped.push_back(insn.address);
+        }
+      }
+    }
+  }
+  stale.clear();
+
+  std::sort(dropped.begin(), dropped.end());
+  dropped.erase(std::unique(dropped.begin(), dropped.end()), dropped.end());
+  for (size_t i = 0; i < dropped.size(); i++)
+  {
+    uint64_t address = dropped[i];
+    uint64_t end = address + std::max<uint64_t>(code[address]->length, 1);
+    for (uint64_t page = address >> INTERP_CODE_PAGE_BITS;
+         page <= (end - 1) >> INTERP_CODE_PAGE_BITS; page++)
+    {
+      std::vector<uint64_t> &on_page = code_pages[page];
+      on_page.erase(std::remove(on_page.begin(), on_page.end(), address),
+                    on_page.end());
+      if (on_page.empty())
+      {
+        code_pages.erase(page);
+      }
+    }
+    code.erase(address);
+  }
+
+  // self modifying code is rare enough to unlink everything rather than
+  // track who links to what
+  for (std::unordered_map<uint64_t, std::unique_ptr<InterpInsn>>::iterator it =
+           code.begin();
+       it != code.end(); ++it)
+  {
+    it->second->next = nullptr;
+    it->second->taken = nullptr;
+  }
+  last = nullptr;
+}
+
+InterpOperand
+PcodeInterpreter::resolve(const ghidra::VarnodeData *vn,
+                          const std::vector<UniqueSpan> &uniques) const
+{
+  InterpOperand out;
+  out.size = vn->size;
+  out.value = vn->offset;
+  if (vn->space->getType() == ghidra::IPTR_CONSTANT)
+  {
+    return out;
+  }
+
+  if (vn->space == register_space && vn->offset < register_size &&
+      vn->size <= register_size - vn->offset)
+  {
+    out.kind = INTERP_REGISTER;
+    out.big_endian = register_space->isBigEndian();
+    return out;
+  }
+
+  if (vn->space == unique_space)
+  {
+    for (size_t i = 0; i < uniques.size(); i++)
+    {
+      if (uniques[i].start <= vn->offset && vn->offset < uniques[i].end)
+      {
+        out.kind = INTERP_SCRATCH;
+        out.big_endian = unique_space->isBigEndian();
+        out.value = uniques[i].slot + (vn->offset - uniques[i].start);
+        return out;
+      }
+    }
+  }
+
+  out.kind = INTERP_SPACE;
+  out.space = vn->space->getIndex();
+  return out;
+}
+
+void PcodeInterpreter::compile(const ghidra::PcodeOpRaw *raw, uint32_t index,
+                               const std::vector<UniqueSpan> &uniques,
+                               InterpOp &op) const
+{
+  op.code = INTERP_FAULT;
+  op.target = 0;
+  op.opcode = raw->getOpcode();
+  op.behave = raw->getBehavior();
+
+  // the values of every op but a `CALLOTHER` have to fit a `uintb`
+  bool too_wide = false;
+  if (raw->getOutput() != nullptr)
+  {
+    op.out = resolve(raw->getOutput(), uniques);
+    too_wide = raw->getOutput()->size > sizeof(uint64_t);
+  }
+  for (int32_t i = 0; i < raw->numInput() && i < 3; i++)
+  {
+    op.in[i] = resolve(raw->getInput(i), uniques);
+    too_wide = too_wide || raw->getInput(i)->size > sizeof(uint64_t);
+  }
+
+  switch (op.opcode)
+  {
+  case ghidra::CPUI_LOAD:
+  case ghidra::CPUI_STORE:
+  {
+    // the first input is the space to load from, kept as its word size
+    ghidra::AddrSpace *space = raw->getInput(0)->getSpaceFromConst();
+    op.in[0].kind = INTERP_CONST;
+    op.in[0].space = space->getIndex();
+    op.in[0].value = space->getWordSize();
+    op.code = op.opcode == ghidra::CPUI_LOAD ? INTERP_LOAD : INTERP_STORE;
+    break;
+  }
+  case ghidra::CPUI_BRANCH:
+  case ghidra::CPUI_CBRANCH:
+  case ghidra::CPUI_CALL:
+  {
+    const ghidra::VarnodeData *dest = raw->getInput(0);
+    bool conditional = op.opcode == ghidra::CPUI_CBRANCH;
+    if (op.opcode != ghidra::CPUI_CALL &&
+        dest->space->getType() == ghidra::IPTR_CONSTANT)
+    {
+      // relative to this op, checked when taken like `EmulatePcodeCache`
+      op.target = (uint32_t)(index + (ghidra::uintm)dest->offset);
+      op.code = conditional ? INTERP_CBRANCH : INTERP_BRANCH;
+    }
+    else
+    {
+      op.in[0].kind = INTERP_CONST;
+      op.in[0].space = dest->space->getIndex();
+      op.code = conditional ? INTERP_CBRANCH_ADDR : INTERP_BRANCH_ADDR;
+    }
+    break;
+  }
+  case ghidra::CPUI_BRANCHIND:
+  case ghidra::CPUI_CALLIND:
+  case ghidra::CPUI_RETURN:
+    op.code = INTERP_BRANCHIND;
+    break;
+  case ghidra::CPUI_CALLOTHER:
+    // handed to the breakpoint as is, so it may be as wide as it likes
+    op.code = INTERP_CALLOTHER;
+    op.target = index;
+    return;
+  case ghidra::CPUI_MULTIEQUAL:
+  case ghidra::CPUI_INDIRECT:
+  case ghidra::CPUI_SEGMENTOP:
+  case ghidra::CPUI_CPOOLREF:
+  case ghidra::CPUI_NEW:
+    return;
+  case ghidra::CPUI_COPY:
+    op.code = INTERP_COPY;
+    break;
+  case ghidra::CPUI_INT_ADD:
+    op.code = INTERP_INT_ADD;
+    break;
+  case ghidra::CPUI_INT_SUB:
+    op.code = INTERP_INT_SUB;
+    break;
+  case ghidra::CPUI_INT_MULT:
+    op.code = INTERP_INT_MULT;
+    break;
+  case ghidra::CPUI_INT_AND:
+    op.code = INTERP_INT_AND;
+    break;
+  case ghidra::CPUI_INT_OR:
+    op.code = INTERP_INT_OR;
+    break;
+  case ghidra::CPUI_INT_XOR:
+    op.code = INTERP_INT_XOR;
+    break;
+  case ghidra::CPUI_INT_EQUAL:
+    op.code = INTERP_INT_EQUAL;
+    break;
+  case ghidra::CPUI_INT_NOTEQUAL:
+    op.code = INTERP_INT_NOTEQUAL;
+    break;
+  case ghidra::CPUI_INT_LESS:
+    op.code = INTERP_INT_LESS;
+    break;
+  case ghidra::CPUI_INT_LESSEQUAL:
+    op.code = INTERP_INT_LESSEQUAL;
+    break;
+  case ghidra::CPUI_INT_SLESS:
+    op.code = INTERP_INT_SLESS;
+    break;
+  case ghidra::CPUI_INT_SLESSEQUAL:
+    op.code = INTERP_INT_SLESSEQUAL;
+    break;
+  case ghidra::CPUI_INT_ZEXT:
+    op.code = INTERP_INT_ZEXT;
+    break;
+  case ghidra::CPUI_INT_SEXT:
+    op.code = INTERP_INT_SEXT;
+    break;
+  case ghidra::CPUI_INT_NEGATE:
+    op.code = INTERP_INT_NEGATE;
+    break;
+  case ghidra::CPUI_INT_2COMP:
+    op.code = INTERP_INT_2COMP;
+    break;
+  case ghidra::CPUI_INT_LEFT:
+    op.code = INTERP_INT_LEFT;
+    break;
+  case ghidra::CPUI_INT_RIGHT:
+    op.code = INTERP_INT_RIGHT;
+    break;
+  case ghidra::CPUI_INT_SRIGHT:
+    op.code = INTERP_INT_SRIGHT;
+    break;
+  case ghidra::CPUI_INT_CARRY:
+    op.code = INTERP_INT_CARRY;
+    break;
+  case ghidra::CPUI_INT_SCARRY:
+    op.code = INTERP_INT_SCARRY;
+    break;
+  case ghidra::CPUI_INT_SBORROW:
+    op.code = INTERP_INT_SBORROW;
+    break;
+  case ghidra::CPUI_BOOL_NEGATE:
+    op.code = INTERP_BOOL_NEGATE;
+    break;
+  case ghidra::CPUI_BOOL_AND:
+    op.code = INTERP_BOOL_AND;
+    break;
+  case ghidra::CPUI_BOOL_OR:
+    op.code = INTERP_BOOL_OR;
+    break;
+  case ghidra::CPUI_BOOL_XOR:
+    op.code = INTERP_BOOL_XOR;
+    break;
+  case ghidra::CPUI_PIECE:
+    op.code = INTERP_PIECE;
+    break;
+  case ghidra::CPUI_SUBPIECE:
+    op.code = INTERP_SUBPIECE;
+    break;
+  default:
+    if (op.behave == nullptr)
+    {
+      // `Emulate` runs ops without a behavior as a no-op
+      op.code = INTERP_NOP;
+    }
+    else if (!op.behave->isSpecial())
+    {
+      op.code = op.behave->isUnary() ? INTERP_UNARY : INTERP_BINARY;
+    }
+    break;
+  }
+
+  if (too_wide)
+  {
+    op.code = INTERP_FAULT;
+  }
+}
+
+inline uint64_t PcodeInterpreter::load(const InterpOperand &operand) const
+{
+  switch (operand.kind)
+  {
+  case INTERP_CONST:
+    return operand.value;
+  case INTERP_REGISTER:
+    return ghidra::MemoryFlatBank::loadValue(registers + operand.value,
+                                             operand.size, operand.big_endian);
+  case INTERP_SCRATCH:
+    return ghidra::MemoryFlatBank::loadValue(scratch.data() + operand.value,
+                                             operand.size, operand.big_endian);
+  default:
+    return memstate->getValue(spaces[operand.space], operand.value,
+                              operand.size);
+  }
+}
+
+inline void PcodeInterpreter::store(const InterpOperand &operand,
+                                    uint64_t value)
+{
+  switch (operand.kind)
+  {
+  case INTERP_REGISTER:
+    ghidra::MemoryFlatBank::storeValue(registers + operand.value, value,
+                                       operand.size, operand.big_endian);
+    break;
+  case INTERP_SCRATCH:
+    ghidra::MemoryFlatBank::storeValue(scratch.data() + operand.value, value,
+                                       operand.size, operand.big_endian);
+    break;
+  default:
+    if (spaces[operand.space] == code_space && operand.value < code_end &&
+        code_start < operand.value + operand.size)
+    {
+      noteStore(operand.value, operand.size);
+    }
+    memstate->setValue(spaces[operand.space], operand.value, operand.size,
+                       value);
+    break;
+  }
+}
+
+inline uint64_t PcodeInterpreter::loadSpace(uint32_t space, uint64_t offset,
+                                            int32_t size) const
+{
+  if (spaces[space] == register_space && offset < register_size &&
+      (uint64_t)size <= register_size - offset)
+  {
+    return ghidra::MemoryFlatBank::loadValue(registers + offset, size,
+                                             register_space->isBigEndian());
+  }
+
+  return memstate->getValue(spaces[space], offset, size);
+}
+
+inline void PcodeInterpreter::storeSpace(uint32_t space, uint64_t offset,
+                                         int32_t size, uint64_t value)
+{
+  if (spaces[space] == register_space && offset < register_size &&
+      (uint64_t)size <= register_size - offset)
+  {
+    ghidra::MemoryFlatBank::storeValue(registers + offset, value, size,
+                                       register_space->isBigEndian());
+    return;
+  }
+
+  if (spaces[space] == code_space && offset < code_end &&
+      code_start < offset + size)
+  {
+    noteStore(offset, size);
+  }
+  memstate->setValue(spaces[space], offset, size, value);
+}
+
+#ifdef INTERP_THREADED
+#define INTERP_HANDLER(name) handle_##name:
+#define INTERP_DISPATCH() goto *handlers[op->code]
+#else
+#define INTERP_HANDLER(name) case INTERP_##name:
+#define INTERP_DISPATCH() goto dispatch
+#endif
+
+/// Moves on to the next op of the instruction
+#define INTERP_NEXT()                                                         \
+  do                                                                          \
+  {                                                                           \
+    if (++pc >= count)                                                        \
+    {                                                                         \
+      goto fallthru;                                                          \
+    }                                                                         \
+    op = &ops[pc];                                                            \
+    INTERP_DISPATCH();                                                        \
+  } while (0)
+
+/// Takes a relative branch to the op at `to`, one past the end falls through
+#define INTERP_JUMP(to)                                                       \
+  do                                                                          \
+  {                                                                           \
+    pc = (to);                                                                \
+    if (pc >= count)                                                          \
+    {                                                                         \
+      if (pc > count)                                                         \
+      {                                                                       \
+        throw ghidra::LowlevelError("Bad intra-instruction branch");          \
+      }                                                                       \
+      goto fallthru;                                                          \
+    }                                                                         \
+    if (++branches > INTERP_MAX_INSN_BRANCHES)                                \
+    {                                                                         \
+      throw ghidra::LowlevelError("Instruction branched too many times");     \
+    }                                                                         \
+    op = &ops[pc];                                                            \
+    INTERP_DISPATCH();                                                        \
+  } while (0)
+
+#define INTERP_IN(i) load(op->in[i])
+#define INTERP_OUT(value) store(op->out, (value))
+
+void PcodeInterpreter::run(const InterpInsn &insn)
+{
+#ifdef INTERP_THREADED
+  static const void *const handlers[] = {
+      &&handle_NOP,          &&handle_COPY,         &&handle_LOAD,
+      &&handle_STORE,        &&handle_BRANCH,       &&handle_BRANCH_ADDR,
+      &&handle_CBRANCH,      &&handle_CBRANCH_ADDR, &&handle_BRANCHIND,
+      &&handle_CALLOTHER,    &&handle_INT_ADD,      &&handle_INT_SUB,
+      &&handle_INT_MULT,     &&handle_INT_AND,      &&handle_INT_OR,
+      &&handle_INT_XOR,      &&handle_INT_EQUAL,    &&handle_INT_NOTEQUAL,
+      &&handle_INT_LESS,     &&handle_INT_LESSEQUAL, &&handle_INT_SLESS,
+      &&handle_INT_SLESSEQUAL, &&handle_INT_ZEXT,   &&handle_INT_SEXT,
+      &&handle_INT_NEGATE,   &&handle_INT_2COMP,    &&handle_INT_LEFT,
+      &&handle_INT_RIGHT,    &&handle_INT_SRIGHT,   &&handle_INT_CARRY,
+      &&handle_INT_SCARRY,   &&handle_INT_SBORROW,  &&handle_BOOL_NEGATE,
+      &&handle_BOOL_AND,     &&handle_BOOL_OR,      &&handle_BOOL_XOR,
+      &&handle_PIECE,        &&handle_SUBPIECE,     &&handle_UNARY,
+      &&handle_BINARY,       &&handle_FAULT,
+  };
+  static_assert(sizeof(handlers) / sizeof(handlers[0]) == INTERP_CODE_COUNT,
+                "every InterpCode needs a handler");
+#endif
+
+  const InterpOp *ops = insn.ops.data();
+  const uint32_t count = insn.ops.size();
+  const InterpOp *op = ops;
+  uint32_t pc = 0;
+  uint64_t branches = 0;
+  flow = INTERP_FLOW_FALLTHRU;
+
+  if (count == 0)
+  {
+    goto fallthru;
+  }
+
+#ifdef INTERP_THREADED
+  INTERP_DISPATCH();
+#else
+dispatch:
+  switch (op->code)
+  {
+#endif
+
+  INTERP_HANDLER(NOP)
+  INTERP_NEXT();
+
+  INTERP_HANDLER(COPY)
+  INTERP_OUT(INTERP_IN(0));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(LOAD)
+  {
+    uint64_t offset = INTERP_IN(1) * op->in[0].value;
+    INTERP_OUT(loadSpace(op->in[0].space, offset, op->out.size));
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(STORE)
+  {
+    uint64_t offset = INTERP_IN(1) * op->in[0].value;
+    storeSpace(op->in[0].space, offset, op->in[2].size, INTERP_IN(2));
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(BRANCH)
+  INTERP_JUMP(op->target);
+
+  INTERP_HANDLER(BRANCH_ADDR)
+  current_address = ghidra::Address(spaces[op->in[0].space], op->in[0].value);
+  flow = INTERP_FLOW_BRANCH;
+  return;
+
+  INTERP_HANDLER(CBRANCH)
+  if (INTERP_IN(1) != 0)
+  {
+    INTERP_JUMP(op->target);
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(CBRANCH_ADDR)
+  if (INTERP_IN(1) != 0)
+  {
+    current_address =
+        ghidra::Address(spaces[op->in[0].space], op->in[0].value);
+    flow = INTERP_FLOW_BRANCH;
+    return;
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(BRANCHIND)
+  current_address = ghidra::Address(current_address.getSpace(), INTERP_IN(0));
+  flow = INTERP_FLOW_INDIRECT;
+  return;
+
+  INTERP_HANDLER(CALLOTHER)
+  redirected = false;
+  if (!breaktable->doPcodeOpBreak(insn.raw_ops[op->target]))
+  {
+    throw ghidra::LowlevelError("Userop not hooked");
+  }
+  if (redirected || getHalt())
+  {
+    flow = INTERP_FLOW_BREAK;
+    return;
+  }
+  INTERP_NEXT();
+
+  // the handlers below mirror `OpBehavior::evaluate*` of their op, the
+  // output is truncated to its size by `store`
+
+  INTERP_HANDLER(INT_ADD)
+  INTERP_OUT(INTERP_IN(0) + INTERP_IN(1));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_SUB)
+  INTERP_OUT(INTERP_IN(0) - INTERP_IN(1));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_MULT)
+  INTERP_OUT(INTERP_IN(0) * INTERP_IN(1));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_AND)
+  INTERP_OUT(INTERP_IN(0) & INTERP_IN(1));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_OR)
+  INTERP_OUT(INTERP_IN(0) | INTERP_IN(1));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_XOR)
+  INTERP_OUT(INTERP_IN(0) ^ INTERP_IN(1));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_EQUAL)
+  INTERP_OUT(INTERP_IN(0) == INTERP_IN(1) ? 1 : 0);
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_NOTEQUAL)
+  INTERP_OUT(INTERP_IN(0) != INTERP_IN(1) ? 1 : 0);
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_LESS)
+  INTERP_OUT(INTERP_IN(0) < INTERP_IN(1) ? 1 : 0);
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_LESSEQUAL)
+  INTERP_OUT(INTERP_IN(0) <= INTERP_IN(1) ? 1 : 0);
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_SLESS)
+  {
+    uint64_t in1 = INTERP_IN(0);
+    uint64_t in2 = INTERP_IN(1);
+    uint64_t mask = (uint64_t)0x80 << (8 * (op->in[0].size - 1));
+    uint64_t bit1 = in1 & mask;
+    uint64_t bit2 = in2 & mask;
+    INTERP_OUT(bit1 != bit2 ? (bit1 != 0) : (in1 < in2));
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_SLESSEQUAL)
+  {
+    uint64_t in1 = INTERP_IN(0);
+    uint64_t in2 = INTERP_IN(1);
+    uint64_t mask = (uint64_t)0x80 << (8 * (op->in[0].size - 1));
+    uint64_t bit1 = in1 & mask;
+    uint64_t bit2 = in2 & mask;
+    INTERP_OUT(bit1 != bit2 ? (bit1 != 0) : (in1 <= in2));
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_ZEXT)
+  INTERP_OUT(INTERP_IN(0));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_SEXT)
+  INTERP_OUT(ghidra::sign_extend(INTERP_IN(0), op->in[0].size, op->out.size));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_NEGATE)
+  INTERP_OUT(~INTERP_IN(0));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_2COMP)
+  INTERP_OUT(~(INTERP_IN(0) - 1));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_LEFT)
+  {
+    uint64_t in1 = INTERP_IN(0);
+    uint64_t in2 = INTERP_IN(1);
+    INTERP_OUT(in2 >= 8u * op->out.size ? 0 : in1 << in2);
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_RIGHT)
+  {
+    uint64_t in1 = INTERP_IN(0) & ghidra::calc_mask(op->out.size);
+    uint64_t in2 = INTERP_IN(1);
+    INTERP_OUT(in2 >= 8u * op->out.size ? 0 : in1 >> in2);
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_SRIGHT)
+  {
+    uint64_t in1 = INTERP_IN(0);
+    uint64_t in2 = INTERP_IN(1);
+    bool negative = ghidra::signbit_negative(in1, op->in[0].size);
+    uint64_t res;
+    if (in2 >= 8u * op->out.size)
+    {
+      res = negative ? ghidra::calc_mask(op->out.size) : 0;
+    }
+    else
+    {
+      res = in1 >> in2;
+      if (negative)
+      {
+        uint64_t mask = ghidra::calc_mask(op->in[0].size);
+        res |= (mask >> in2) ^ mask;
+      }
+    }
+    INTERP_OUT(res);
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_CARRY)
+  {
+    uint64_t in1 = INTERP_IN(0);
+    uint64_t in2 = INTERP_IN(1);
+    INTERP_OUT(in1 > ((in1 + in2) & ghidra::calc_mask(op->in[0].size)) ? 1 : 0);
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_SCARRY)
+  {
+    uint64_t in1 = INTERP_IN(0);
+    uint64_t in2 = INTERP_IN(1);
+    uint32_t sign = op->in[0].size * 8 - 1;
+    uint64_t a = (in1 >> sign) & 1;
+    uint64_t b = (in2 >> sign) & 1;
+    uint64_t r = ((in1 + in2) >> sign) & 1;
+    INTERP_OUT((r ^ a) & (a ^ b ^ 1));
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(INT_SBORROW)
+  {
+    uint64_t in1 = INTERP_IN(0);
+    uint64_t in2 = INTERP_IN(1);
+    uint32_t sign = op->in[0].size * 8 - 1;
+    uint64_t a = (in1 >> sign) & 1;
+    uint64_t b = (in2 >> sign) & 1;
+    uint64_t r = ((in1 - in2) >> sign) & 1;
+    INTERP_OUT((a ^ r) & (r ^ b ^ 1));
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(BOOL_NEGATE)
+  INTERP_OUT(INTERP_IN(0) ^ 1);
+  INTERP_NEXT();
+
+  INTERP_HANDLER(BOOL_AND)
+  INTERP_OUT(INTERP_IN(0) & INTERP_IN(1));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(BOOL_OR)
+  INTERP_OUT(INTERP_IN(0) | INTERP_IN(1));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(BOOL_XOR)
+  INTERP_OUT(INTERP_IN(0) ^ INTERP_IN(1));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(PIECE)
+  {
+    uint64_t in1 = INTERP_IN(0);
+    uint64_t in2 = INTERP_IN(1);
+    uint32_t shift = (op->out.size - op->in[0].size) * 8;
+    INTERP_OUT((shift >= 64 ? 0 : in1 << shift) | in2);
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(SUBPIECE)
+  {
+    uint64_t in1 = INTERP_IN(0);
+    uint64_t in2 = INTERP_IN(1);
+    INTERP_OUT(in2 >= 8 ? 0 : in1 >> (in2 * 8));
+  }
+  INTERP_NEXT();
+
+  INTERP_HANDLER(UNARY)
+  INTERP_OUT(op->behave->evaluateUnary(op->out.size, op->in[0].size,
+                                       INTERP_IN(0)));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(BINARY)
+  INTERP_OUT(op->behave->evaluateBinary(op->out.size, op->in[0].size,
+                                        INTERP_IN(0), INTERP_IN(1)));
+  INTERP_NEXT();
+
+  INTERP_HANDLER(FAULT)
+  throw ghidra::LowlevelError(std::string("Cannot emulate ") +
+                              ghidra::get_opname(op->opcode));
+
+#ifndef INTERP_THREADED
+  default:
+    throw ghidra::LowlevelError("Bad interpreter op");
+  }
+#endif
+
+fallthru:
+  current_address = current_address + insn.length;
+}
+
+uint64_t PcodeInterpreter::readVarnode(const ghidra::VarnodeData &vn) const
+{
+  return load(resolve(&vn, std::vector<UniqueSpan>()));
+}
+
+void PcodeInterpreter::writeVarnode(const ghidra::VarnodeData &vn,
+                                    uint64_t value)
+{
+  store(resolve(&vn, std::vector<UniqueSpan>()), value);
+}
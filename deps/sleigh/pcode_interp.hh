@@ -0,0 +1,275 @@
+/// \file pcode_interp.hh
+/// \brief Pre-decoded p-code interpreter for emulating many short runs
+///
+/// `EmulatePcodeCache` emits the p-code of an instruction again every time
+/// it is reached, dispatches every op through the `OpBehavior` virtuals and
+/// resolves every varnode through `MemoryState`, which is a map lookup per
+/// word. `PcodeInterpreter` translates each instruction once into `InterpOp`s
+/// whose operands are already resolved: constants are inlined, registers are
+/// offsets into the `MemoryFlatBank` of the register space (if it has one),
+/// the `unique` space of an instruction is packed into a fixed scratch area,
+/// and only the remaining spaces go through `MemoryState`. Ops are dispatched with computed gotos where the
+/// compiler has them, and a switch everywhere else.
+///
+/// Breakpoints follow the `BreakTable` contract of `EmulatePcodeCache`.
+/// `doAddressBreak` is called before every instruction and the instruction
+/// is skipped if it returns true. `doPcodeOpBreak` is called for every
+/// `CALLOTHER`, which throws if no breakpoint handles it. A breakpoint that
+/// halts the emulator or moves the execute address abandons the rest of the
+/// instruction.
+///
+/// The register bank is looked up once, so it must be mapped into the
+/// `MemoryState` before the interpreter is made and stay mapped.
+///
+/// Each translated instruction links to the instructions control reached
+/// from it: its fallthrough and the last direct branch or call it took. A
+/// straight run of code, and the direct jumps between runs, only looks an
+/// instruction up the first time through, after that it follows the links.
+///
+/// Translated instructions are only valid for the bytes + context they were
+/// decoded with, call `clearCache` whenever either changes outside of the
+/// emulator. A `STORE` to the default code space that overwrites the bytes
+/// of a translated instruction drops it before the next instruction runs.
+/// SLEIGH decodes the bytes of its `LoadImage`, not the emulated memory, so
+/// an instruction whose bytes in memory no longer match the image throws
+/// instead of running what the image held there, see `setImage`.
+#ifndef __PCODE_INTERP_HH__
+#define __PCODE_INTERP_HH__
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "emulate.hh"
+#include "loadimage.hh"
+#include "memstate.hh"
+
+/// Bytes of `unique` space a single instruction can use, none of the specs
+/// come close
+#define INTERP_SCRATCH_SIZE 0x4000
+
+/// Most relative branches a single instruction may take before it is
+/// treated as looping forever
+#define INTERP_MAX_INSN_BRANCHES 0x10000
+
+/// Log2 of the pages translated code is tracked in, for spotting stores to it
+#define INTERP_CODE_PAGE_BITS 12
+
+/// Longest instruction checked against the image it was decoded from, more
+/// than any spec decodes
+#define INTERP_MAX_INSN_BYTES 32
+
+/// Where an `InterpOperand` lives
+enum InterpOperandKind
+{
+  INTERP_CONST = 0, // `value` is the constant
+  INTERP_REGISTER,  // `value` is the offset into the flat register bank
+  INTERP_SCRATCH,   // `value` is the offset into the scratch area
+  INTERP_SPACE,     // `value` is the offset into the `space`th space
+};
+
+/// Resolved varnode of an `InterpOp`
+struct InterpOperand
+{
+  uint8_t kind = INTERP_CONST; // `InterpOperandKind`
+  uint8_t size = 0;
+  uint8_t big_endian = 0; // byte order of `INTERP_REGISTER` + `INTERP_SCRATCH` bytes
+  uint32_t space = 0;     // space index of `INTERP_SPACE`, `LOAD` and `STORE`
+  uint64_t value = 0;
+};
+
+/// Handler of an `InterpOp`, the order matches the dispatch table
+enum InterpCode
+{
+  INTERP_NOP = 0,
+  INTERP_COPY,
+  INTERP_LOAD,
+  INTERP_STORE,
+  INTERP_BRANCH,       // to `target` inside of the instruction
+  INTERP_BRANCH_ADDR,  // to the address in `in[0]`, also `CALL`
+  INTERP_CBRANCH,
+  INTERP_CBRANCH_ADDR,
+  INTERP_BRANCHIND,    // also `CALLIND` and `RETURN`
+  INTERP_CALLOTHER,    // `target` is the index of the raw op
+  INTERP_INT_ADD,
+  INTERP_INT_SUB,
+  INTERP_INT_MULT,
+  INTERP_INT_AND,
+  INTERP_INT_OR,
+  INTERP_INT_XOR,
+  INTERP_INT_EQUAL,
+  INTERP_INT_NOTEQUAL,
+  INTERP_INT_LESS,
+  INTERP_INT_LESSEQUAL,
+  INTERP_INT_SLESS,
+  INTERP_INT_SLESSEQUAL,
+  INTERP_INT_ZEXT,
+  INTERP_INT_SEXT,
+  INTERP_INT_NEGATE,
+  INTERP_INT_2COMP,
+  INTERP_INT_LEFT,
+  INTERP_INT_RIGHT,
+  INTERP_INT_SRIGHT,
+  INTERP_INT_CARRY,
+  INTERP_INT_SCARRY,
+  INTERP_INT_SBORROW,
+  INTERP_BOOL_NEGATE,
+  INTERP_BOOL_AND,
+  INTERP_BOOL_OR,
+  INTERP_BOOL_XOR,
+  INTERP_PIECE,
+  INTERP_SUBPIECE,
+  INTERP_UNARY,        // any other unary op, through its `OpBehavior`
+  INTERP_BINARY,       // any other binary op, through its `OpBehavior`
+  INTERP_FAULT,        // throws, for ops that can't be emulated
+  INTERP_CODE_COUNT,
+};
+
+/// A single pre-decoded p-code op
+struct InterpOp
+{
+  uint32_t code;   // `InterpCode`
+  uint32_t target; // see `InterpCode`
+  ghidra::OpCode opcode;
+  const ghidra::OpBehavior *behave; // `INTERP_UNARY` and `INTERP_BINARY`
+  InterpOperand out;
+  InterpOperand in[3];
+};
+
+/// How control left the last instruction run by `PcodeInterpreter`
+enum InterpFlow
+{
+  INTERP_FLOW_FALLTHRU = 0,
+  INTERP_FLOW_BRANCH,   // a direct branch or call
+  INTERP_FLOW_INDIRECT, // an indirect branch, call or return
+  INTERP_FLOW_BREAK,    // a breakpoint replaced, halted or redirected it
+};
+
+/**
+ * \brief an `Emulate` that runs pre-decoded instructions, see the file
+ * docs. Executes whole instructions: `executeCurrentOp` runs the rest of
+ * the current instruction just like `executeInstruction`.
+ */
+class PcodeInterpreter : public ghidra::Emulate
+{
+  /** \brief the translation of one instruction */
+  struct InterpInsn
+  {
+    uint64_t address;
+    uint64_t length;
+    // linked the first time control gets there, checked against `address`
+    InterpInsn *next = nullptr;  // the fallthrough
+    InterpInsn *taken = nullptr; // the last direct branch or call taken
+    std::vector<InterpOp> ops;
+    // kept for `doPcodeOpBreak`, owned by the instruction
+    std::vector<ghidra::PcodeOpRaw *> raw_ops;
+    std::vector<ghidra::VarnodeData *> raw_varnodes;
+
+    ~InterpInsn(void);
+  };
+
+  struct UniqueSpan;
+
+  ghidra::Translate *trans;
+  ghidra::MemoryState *memstate;
+  ghidra::BreakTable *breaktable;
+  std::vector<ghidra::OpBehavior *> inst;
+  std::vector<ghidra::AddrSpace *> spaces;
+  ghidra::AddrSpace *register_space; // null if the spec has none
+  ghidra::AddrSpace *unique_space;
+  // bytes of the register bank, `[0, register_size)` of the space, null if
+  // the register space isn't mapped to a `MemoryFlatBank`
+  uint8_t *registers = nullptr;
+  uint64_t register_size = 0;
+  std::vector<uint8_t> scratch; // `INTERP_SCRATCH_SIZE` bytes
+  std::unordered_map<uint64_t, std::unique_ptr<InterpInsn>> code;
+  // addresses of the translated instructions with bytes on each page of the
+  // default code space, and the bounds of those bytes
+  std::unordered_map<uint64_t, std::vector<uint64_t>> code_pages;
+  uint64_t code_start = UINT64_MAX;
+  uint64_t code_end = 0;
+  ghidra::AddrSpace *code_space;
+  ghidra::LoadImage *image = nullptr;
+  // ranges stored to over translated bytes, dropped before the next one runs
+  std::vector<std::pair<uint64_t, uint64_t>> stale;
+  InterpInsn *last = nullptr; // ran last, null if its successor can't be linked
+  ghidra::Address current_address;
+  InterpFlow flow = INTERP_FLOW_FALLTHRU;
+  bool redirected = false; // set by `setExecuteAddress`
+
+  InterpInsn &translate(uint64_t address);
+  void checkImage(const InterpInsn &insn) const;
+  void noteStore(uint64_t offset, uint64_t size);
+  void dropStale(void);
+  InterpOperand resolve(const ghidra::VarnodeData *vn,
+                        const std::vector<UniqueSpan> &uniques) const;
+  void compile(const ghidra::PcodeOpRaw *raw, uint32_t index,
+               const std::vector<UniqueSpan> &uniques, InterpOp &op) const;
+  void run(const InterpInsn &insn);
+
+  uint64_t load(const InterpOperand &operand) const;
+  void store(const InterpOperand &operand, uint64_t value);
+  uint64_t loadSpace(uint32_t space, uint64_t offset, int32_t size) const;
+  void storeSpace(uint32_t space, uint64_t offset, int32_t size, uint64_t value);
+
+protected:
+  // `currentBehave` is never set, so `executeCurrentOp` only ever reaches
+  // `fallthruOp`. The rest have no meaning for whole instructions.
+  virtual void executeUnary(void) {}
+  virtual void executeBinary(void) {}
+  virtual void executeLoad(void) {}
+  virtual void executeStore(void) {}
+  virtual void executeBranch(void) {}
+  virtual bool executeCbranch(void) { return false; }
+  virtual void executeBranchind(void) {}
+  virtual void executeCall(void) {}
+  virtual void executeCallind(void) {}
+  virtual void executeCallother(void) {}
+  virtual void executeMultiequal(void) {}
+  virtual void executeIndirect(void) {}
+  virtual void executeSegmentOp(void) {}
+  virtual void executeCpoolRef(void) {}
+  virtual void executeNew(void) {}
+  virtual void fallthruOp(void) { executeInstruction(); }
+
+public:
+  PcodeInterpreter(ghidra::Translate *t, ghidra::MemoryState *s,
+                   ghidra::BreakTable *b);
+  virtual ~PcodeInterpreter(void);
+
+  /** \brief sets the next instruction to run, nothing is decoded until it runs */
+  virtual void setExecuteAddress(const ghidra::Address &addr);
+  virtual ghidra::Address getExecuteAddress(void) const { return current_address; }
+
+  /**
+   * \brief runs the instruction at the execute address, translating it
+   * first if needed. Decoding errors propagate as thrown by SLEIGH.
+   */
+  void executeInstruction(void);
+
+  /** \brief how control left the last instruction */
+  InterpFlow getFlow(void) const { return flow; }
+
+  /** \brief drops every translated instruction */
+  void clearCache(void);
+
+  /**
+   * \brief drops the instructions translated from `[offset, offset + size)`
+   * of the default code space, for writes that don't go through a `STORE`
+   */
+  void dropCode(uint64_t offset, uint64_t size);
+
+  /**
+   * \brief sets the image SLEIGH decodes from, every instruction is checked
+   * against the emulated memory when translated. Without one, nothing is.
+   */
+  void setImage(ghidra::LoadImage *ld) { image = ld; }
+
+  /** \brief reads/writes `vn` wherever it lives, it must be at most 8 bytes */
+  uint64_t readVarnode(const ghidra::VarnodeData &vn) const;
+  void writeVarnode(const ghidra::VarnodeData &vn, uint64_t value);
+};
+
+#endif
@@ -0,0 +1,447 @@
+#include <cstdint>
+
+#include "error.hh"
+#include "pcode_simplify.hh"
+
+static bool is_temp(const ghidra::VarnodeData &vn)
+{
+  return vn.space->getType() == ghidra::IPTR_INTERNAL;
+}
+
+static bool is_constant(const ghidra::VarnodeData &vn)
+{
+  return vn.space->getType() == ghidra::IPTR_CONSTANT;
+}
+
+static bool same(const ghidra::VarnodeData &lhs, const ghidra::VarnodeData &rhs)
+{
+  return lhs.space == rhs.space && lhs.offset == rhs.offset &&
+         lhs.size == rhs.size;
+}
+
+static bool overlaps(const ghidra::VarnodeData &lhs,
+                     const ghidra::VarnodeData &rhs)
+{
+  return lhs.space == rhs.space && lhs.offset < rhs.offset + rhs.size &&
+         rhs.offset < lhs.offset + lhs.size;
+}
+
+static bool contains(const ghidra::VarnodeData &outer,
+                     const ghidra::VarnodeData &inner)
+{
+  return outer.space == inner.space && outer.offset <= inner.offset &&
+         inner.offset + inner.size <= outer.offset + outer.size;
+}
+
+/** \brief true if dropping an op with `opcode` only loses its output */
+static bool is_pure(ghidra::OpCode opcode)
+{
+  if (opcode >= ghidra::CPUI_INT_EQUAL && opcode <= ghidra::CPUI_FLOAT_ROUND)
+  {
+    return true;
+  }
+  switch (opcode)
+  {
+  case ghidra::CPUI_COPY:
+  case ghidra::CPUI_PIECE:
+  case ghidra::CPUI_SUBPIECE:
+  case ghidra::CPUI_POPCOUNT:
+  case ghidra::CPUI_LZCOUNT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/** \brief true if an op with `opcode` of constants can be evaluated */
+static bool is_foldable(ghidra::OpCode opcode)
+{
+  // float ops depend on the float formats of the spec, leave them be
+  if (opcode >= ghidra::CPUI_INT_EQUAL && opcode <= ghidra::CPUI_BOOL_OR)
+  {
+    return true;
+  }
+  switch (opcode)
+  {
+  case ghidra::CPUI_PIECE:
+  case ghidra::CPUI_SUBPIECE:
+  case ghidra::CPUI_POPCOUNT:
+  case ghidra::CPUI_LZCOUNT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+PcodeSimplifier::PcodeSimplifier(const ghidra::Translate *trans)
+    : constant_space(trans->getConstantSpace())
+{
+  ghidra::OpBehavior::registerInstructions(behaviors, trans);
+}
+
+PcodeSimplifier::~PcodeSimplifier(void)
+{
+  for (ghidra::OpBehavior *behavior : behaviors)
+  {
+    delete behavior;
+  }
+}
+
+const PcodeSimplifier::KnownValue *
+PcodeSimplifier::lookup(const ghidra::VarnodeData &vn) const
+{
+  for (const KnownValue &entry : known)
+  {
+    if (same(entry.temp, vn))
+    {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+/** \brief drops what is known about the temporaries `vn` (just written)
+ * overlaps, and the ones known to hold it
+ */
+void PcodeSimplifier::forget_written(const ghidra::VarnodeData &vn)
+{
+  size_t kept = 0;
+  for (size_t i = 0; i < known.size(); i++)
+  {
+    if (!overlaps(known[i].temp, vn) && !overlaps(known[i].value, vn))
+    {
+      known[kept++] = known[i];
+    }
+  }
+  known.resize(kept);
+}
+
+/** \brief drops the temporaries known to hold a varnode of `space` */
+void PcodeSimplifier::forget_space(ghidra::AddrSpace *space)
+{
+  size_t kept = 0;
+  for (size_t i = 0; i < known.size(); i++)
+  {
+    if (known[i].value.space != space)
+    {
+      known[kept++] = known[i];
+    }
+  }
+  known.resize(kept);
+}
+
+/** \brief drops every temporary not known to hold a constant */
+void PcodeSimplifier::forget_all(void)
+{
+  size_t kept = 0;
+  for (size_t i = 0; i < known.size(); i++)
+  {
+    if (is_constant(known[i].value))
+    {
+      known[kept++] = known[i];
+    }
+  }
+  known.resize(kept);
+}
+
+/**
+ * \brief evaluates `op` if all of its inputs are constants, turning it into
+ * a `COPY` of the result. False if it can't be folded.
+ */
+bool PcodeSimplifier::fold(DecodedInsn &insn, DecodedOp &op)
+{
+  if (!is_foldable(op.opcode) || op.input_len == 0 || op.input_len > 2 ||
+      op.opcode >= (ghidra::OpCode)behaviors.size())
+  {
+    return false;
+  }
+  const ghidra::OpBehavior *behavior = behaviors[op.opcode];
+  if (behavior == nullptr || behavior->isSpecial() ||
+      behavior->isUnary() != (op.input_len == 1))
+  {
+    return false;
+  }
+
+  const ghidra::VarnodeData &out = insn.varnodes[op.output];
+  const ghidra::VarnodeData *in = &insn.varnodes[op.input_start];
+  if (out.size > sizeof(ghidra::uintb))
+  {
+    return false;
+  }
+  for (uint32_t i = 0; i < op.input_len; i++)
+  {
+    if (!is_constant(in[i]) || in[i].size > sizeof(ghidra::uintb))
+    {
+      return false;
+    }
+  }
+
+  ghidra::uintb value;
+  try
+  {
+    // same operand sizes as the emulators pass
+    value = op.input_len == 1
+                ? behavior->evaluateUnary(out.size, in[0].size, in[0].offset)
+                : behavior->evaluateBinary(out.size, in[0].size, in[0].offset,
+                                           in[1].offset);
+  }
+  catch (ghidra::LowlevelError &err)
+  {
+    // division by zero and the like are left for whoever runs it
+    return false;
+  }
+
+  op.opcode = ghidra::CPUI_COPY;
+  op.input_len = 1;
+  ghidra::VarnodeData &constant = insn.varnodes[op.input_start];
+  constant.space = constant_space;
+  constant.offset = value & ghidra::calc_mask(out.size);
+  constant.size = out.size;
+  return true;
+}
+
+/** \brief copy propagation + constant folding, front to back */
+void PcodeSimplifier::propagate(DecodedInsn &insn)
+{
+  known.clear();
+  for (DecodedOp &op : insn.ops)
+  {
+    for (uint32_t i = 0; i < op.input_len; i++)
+    {
+      ghidra::VarnodeData &in = insn.varnodes[op.input_start + i];
+      if (is_temp(in))
+      {
+        const KnownValue *entry = lookup(in);
+        if (entry != nullptr)
+        {
+          in = entry->value;
+        }
+      }
+    }
+
+    switch (op.opcode)
+    {
+    case ghidra::CPUI_STORE:
+      // the space operand is the `AddrSpace` itself
+      forget_space(
+          (ghidra::AddrSpace *)(uintptr_t)insn.varnodes[op.input_start].offset);
+      break;
+    case ghidra::CPUI_CALL:
+    case ghidra::CPUI_CALLIND:
+    case ghidra::CPUI_CALLOTHER:
+      forget_all();
+      break;
+    default:
+      break;
+    }
+
+    if (op.output == DECODED_NO_OUTPUT)
+    {
+      continue;
+    }
+    const ghidra::VarnodeData out = insn.varnodes[op.output];
+    forget_written(out);
+    if (!is_temp(out))
+    {
+      continue;
+    }
+
+    if (op.opcode == ghidra::CPUI_COPY && op.input_len == 1)
+    {
+      const ghidra::VarnodeData &in = insn.varnodes[op.input_start];
+      if (!overlaps(in, out))
+      {
+        known.push_back(KnownValue{out, in});
+      }
+    }
+    else if (fold(insn, op))
+    {
+      known.push_back(KnownValue{out, insn.varnodes[op.input_start]});
+    }
+  }
+}
+
+/** \brief true if any op after `from` but `skip` reads `vn` */
+static bool read_after(const DecodedInsn &insn, size_t from, size_t skip,
+                       const ghidra::VarnodeData &vn)
+{
+  for (size_t i = from + 1; i < insn.ops.size(); i++)
+  {
+    const DecodedOp &op = insn.ops[i];
+    for (uint32_t j = 0; i != skip && j < op.input_len; j++)
+    {
+      if (overlaps(insn.varnodes[op.input_start + j], vn))
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * \brief true if the ops between `from` and `to` neither touch `vn` nor do
+ * anything but compute their output
+ */
+static bool untouched_between(const DecodedInsn &insn, size_t from, size_t to,
+                              const ghidra::VarnodeData &vn)
+{
+  for (size_t i = from + 1; i < to; i++)
+  {
+    const DecodedOp &op = insn.ops[i];
+    if (!is_pure(op.opcode) ||
+        (op.output != DECODED_NO_OUTPUT &&
+         overlaps(insn.varnodes[op.output], vn)))
+    {
+      return false;
+    }
+    for (uint32_t j = 0; j < op.input_len; j++)
+    {
+      if (overlaps(insn.varnodes[op.input_start + j], vn))
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * \brief writes the result of an op straight to where the `COPY` of its
+ * temporary right after it puts it, `u = INT_ADD a, b; r = COPY u` becomes
+ * `r = INT_ADD a, b`
+ */
+void PcodeSimplifier::coalesce(DecodedInsn &insn)
+{
+  for (size_t to = 0; to < insn.ops.size(); to++)
+  {
+    const DecodedOp &copy = insn.ops[to];
+    if (copy.opcode != ghidra::CPUI_COPY || copy.input_len != 1 ||
+        !is_temp(insn.varnodes[copy.input_start]) ||
+        is_temp(insn.varnodes[copy.output]))
+    {
+      continue;
+    }
+    const ghidra::VarnodeData temp = insn.varnodes[copy.input_start];
+    const ghidra::VarnodeData target = insn.varnodes[copy.output];
+
+    // the op that last wrote the temporary
+    size_t from = to;
+    while (from-- > 0)
+    {
+      const DecodedOp &op = insn.ops[from];
+      if (keep[from] && op.output != DECODED_NO_OUTPUT &&
+          overlaps(insn.varnodes[op.output], temp))
+      {
+        break;
+      }
+    }
+    if (from >= to || !keep[from] ||
+        !same(insn.varnodes[insn.ops[from].output], temp) ||
+        read_after(insn, from, to, temp) ||
+        !untouched_between(insn, from, to, target))
+    {
+      continue;
+    }
+
+    insn.varnodes[insn.ops[from].output] = target;
+    keep[to] = false;
+  }
+}
+
+/**
+ * \brief drops the pure ops whose temporaries are never read again, back to
+ * front, and packs the varnodes of the ops that are left
+ */
+void PcodeSimplifier::sweep(DecodedInsn &insn)
+{
+  live.clear();
+  for (size_t i = insn.ops.size(); i-- > 0;)
+  {
+    const DecodedOp &op = insn.ops[i];
+    if (!keep[i])
+    {
+      continue;
+    }
+    if (op.output != DECODED_NO_OUTPUT)
+    {
+      const ghidra::VarnodeData &out = insn.varnodes[op.output];
+      if (is_temp(out))
+      {
+        bool read = false;
+        for (const ghidra::VarnodeData &vn : live)
+        {
+          read = read || overlaps(vn, out);
+        }
+        if (!read && is_pure(op.opcode))
+        {
+          keep[i] = false;
+          continue;
+        }
+
+        // reads that come later get their value from here
+        size_t kept = 0;
+        for (size_t j = 0; j < live.size(); j++)
+        {
+          if (!contains(out, live[j]))
+          {
+            live[kept++] = live[j];
+          }
+        }
+        live.resize(kept);
+      }
+    }
+
+    for (uint32_t j = 0; j < op.input_len; j++)
+    {
+      const ghidra::VarnodeData &in = insn.varnodes[op.input_start + j];
+      if (is_temp(in))
+      {
+        live.push_back(in);
+      }
+    }
+  }
+
+  ops.clear();
+  varnodes.clear();
+  for (size_t i = 0; i < insn.ops.size(); i++)
+  {
+    if (!keep[i])
+    {
+      continue;
+    }
+    DecodedOp op = insn.ops[i];
+    if (op.output != DECODED_NO_OUTPUT)
+    {
+      varnodes.push_back(insn.varnodes[op.output]);
+      op.output = varnodes.size() - 1;
+    }
+    uint32_t start = varnodes.size();
+    varnodes.insert(varnodes.end(), insn.varnodes.begin() + op.input_start,
+                    insn.varnodes.begin() + op.input_start + op.input_len);
+    op.input_start = start;
+    ops.push_back(op);
+  }
+
+  // swapped rather than copied, so both sets of buffers get reused
+  insn.ops.swap(ops);
+  insn.varnodes.swap(varnodes);
+}
+
+void PcodeSimplifier::simplify(DecodedInsn &insn)
+{
+  for (const DecodedOp &op : insn.ops)
+  {
+    // targets of relative branches are op indices
+    if ((op.opcode == ghidra::CPUI_BRANCH || op.opcode == ghidra::CPUI_CBRANCH) &&
+        op.input_len > 0 && is_constant(insn.varnodes[op.input_start]))
+    {
+      return;
+    }
+  }
+
+  propagate(insn);
+  keep.assign(insn.ops.size(), true);
+  coalesce(insn);
+  sweep(insn);
+}
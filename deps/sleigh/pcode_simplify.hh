@@ -0,0 +1,80 @@
+/// \file pcode_simplify.hh
+/// \brief Folds away the `unique` temporaries of an instruction's p-code
+///
+/// SLEIGH builds the p-code of an instruction constructor by constructor,
+/// and every intermediate value goes through a `unique` temporary: operands
+/// get copied into one, constant expressions get computed into one, and
+/// many are only ever read by the `COPY` right after them. A
+/// `PcodeSimplifier` rewrites a `DecodedInsn` before it leaves the manager:
+///
+/// - copy propagation: reads of a temporary that was just copied from
+///   another varnode read that varnode instead, as long as it wasn't
+///   written in between
+/// - constant folding: integer + boolean ops of constants are evaluated
+///   with the same `OpBehavior`s the emulators use, into a constant
+/// - copy coalescing: an op whose temporary is only copied on by the next
+///   `COPY` writes to that `COPY`'s output instead
+/// - dead temporaries: ops without side effects whose temporary is never
+///   read again are dropped
+///
+/// Registers, memory and everything else an instruction writes are left
+/// exactly as they were, so the instruction does the same thing with fewer
+/// ops. Only temporaries are ever removed, they don't outlive the
+/// instruction. Instructions that branch within their own p-code are left
+/// alone, the relative branch targets count ops.
+#ifndef __PCODE_SIMPLIFY_HH__
+#define __PCODE_SIMPLIFY_HH__
+
+#include <cstdint>
+#include <vector>
+
+#include "decode_cache.hh"
+#include "opbehavior.hh"
+#include "translate.hh"
+
+/**
+ * \brief simplifies the p-code of instructions of one spec, reuses its
+ * scratch space across instructions. Not thread safe, every manager owns
+ * its own.
+ */
+class PcodeSimplifier
+{
+  // a temporary whose value is known to be `value` (a constant, or a
+  // varnode that hasn't been written since)
+  struct KnownValue
+  {
+    ghidra::VarnodeData temp;
+    ghidra::VarnodeData value;
+  };
+
+  ghidra::AddrSpace *constant_space;
+  std::vector<ghidra::OpBehavior *> behaviors;
+
+  std::vector<KnownValue> known;
+  std::vector<ghidra::VarnodeData> live;
+  std::vector<bool> keep;
+  std::vector<DecodedOp> ops;
+  std::vector<ghidra::VarnodeData> varnodes;
+
+  const KnownValue *lookup(const ghidra::VarnodeData &vn) const;
+  void forget_written(const ghidra::VarnodeData &vn);
+  void forget_space(ghidra::AddrSpace *space);
+  void forget_all(void);
+  bool fold(DecodedInsn &insn, DecodedOp &op);
+  void propagate(DecodedInsn &insn);
+  void coalesce(DecodedInsn &insn);
+  void sweep(DecodedInsn &insn);
+
+public:
+  explicit PcodeSimplifier(const ghidra::Translate *trans);
+  ~PcodeSimplifier(void);
+
+  /** \brief simplifies the p-code of `insn` in place */
+  void simplify(DecodedInsn &insn);
+
+private:
+  PcodeSimplifier(const PcodeSimplifier &);
+  PcodeSimplifier &operator=(const PcodeSimplifier &);
+};
+
+#endif
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "register_table.hh"
+#include "sleighbase.hh"
+
+void RegisterTable::build(const ghidra::Translate &trans)
+{
+  std::map<ghidra::VarnodeData, std::string> registers;
+  trans.getAllRegisters(registers);
+
+  varnodes.clear();
+  names.clear();
+  offsets.clear();
+  direct.clear();
+  varnodes.reserve(registers.size());
+  names.reserve(registers.size());
+
+  ghidra::AddrSpace *space = trans.getSpaceByName("register");
+  space_index = space != nullptr ? space->getIndex() : -1;
+  space_start = registers.size();
+
+  // the map is ordered by space, offset and then size descending, so the
+  // registers of one space are contiguous and the largest register at an
+  // offset comes first
+  std::map<ghidra::VarnodeData, std::string>::const_iterator it;
+  for (it = registers.begin(); it != registers.end(); it++)
+  {
+    if (it->first.space == space)
+    {
+      if (offsets.empty())
+      {
+        space_start = varnodes.size();
+      }
+      offsets.push_back(it->first.offset);
+    }
+    varnodes.push_back(it->first);
+    names.push_back(it->second);
+  }
+
+  assign_slots(trans);
+  if (offsets.empty())
+  {
+    return;
+  }
+
+  uint64_t span = offsets.back() - offsets.front() + 1;
+  if (span > REGISTER_DIRECT_MAX)
+  {
+    return;
+  }
+
+  direct_base = offsets.front();
+  direct.assign(span, REGISTER_NONE);
+  for (size_t idx = offsets.size(); idx-- > 0;)
+  {
+    direct[offsets[idx] - direct_base] = space_start + idx;
+  }
+}
+
+/** \brief index of the root holding `offset`, `roots.size()` if none does */
+size_t RegisterTable::root_at(uint64_t offset) const
+{
+  size_t low = 0;
+  size_t high = roots.size();
+  while (low < high)
+  {
+    size_t mid = low + (high - low) / 2;
+    if (roots[mid].end <= offset)
+    {
+      low = mid + 1;
+    }
+    else
+    {
+      high = mid;
+    }
+  }
+  return low < roots.size() && roots[low].offset <= offset ? low : roots.size();
+}
+
+/**
+ * \brief finds the registers that aren't inside of another, ranks them (see
+ * the file comment) and gives the first `EFFECT_SLOT_OTHER` a slot each
+ */
+void RegisterTable::assign_slots(const ghidra::Translate &trans)
+{
+  roots.clear();
+  slots.assign(varnodes.size(), EFFECT_SLOT_OTHER);
+  stack_pointer = REGISTER_NONE;
+
+  // registers of a space are ascending by offset with the widest first, so
+  // a register starting before the end of the last root is inside of it
+  std::vector<size_t> root_of(varnodes.size(), SIZE_MAX);
+  for (uint32_t idx = 0; idx < offsets.size(); idx++)
+  {
+    const ghidra::VarnodeData &vn = varnodes[space_start + idx];
+    if (roots.empty() || vn.offset >= roots.back().end)
+    {
+      roots.push_back(Root{vn.offset, vn.offset + vn.size, EFFECT_SLOT_OTHER});
+    }
+    root_of[space_start + idx] = roots.size() - 1;
+
+    const std::string &name = names[space_start + idx];
+    // `rsp` but also `RSP`
+    bool named_sp = name.size() <= 3 && name.size() >= 2 &&
+                    tolower(name[name.size() - 2]) == 's' &&
+                    tolower(name[name.size() - 1]) == 'p';
+    if (named_sp && (stack_pointer == REGISTER_NONE ||
+                     vn.size > varnodes[stack_pointer].size))
+    {
+      stack_pointer = space_start + idx;
+    }
+  }
+
+  // rank of a root is the length of the shortest attach list naming it or
+  // a register inside of it
+  std::vector<size_t> rank(roots.size(), SIZE_MAX);
+  const ghidra::SleighBase *base =
+      dynamic_cast<const ghidra::SleighBase *>(&trans);
+  for (ghidra::int4 id = 0; base != nullptr && id < base->numSymbols(); id++)
+  {
+    ghidra::SleighSymbol *sym = base->findSymbol(id);
+    if (sym == nullptr ||
+        sym->getType() != ghidra::SleighSymbol::varnodelist_symbol)
+    {
+      continue;
+    }
+
+    const std::vector<ghidra::VarnodeSymbol *> &table =
+        ((ghidra::VarnodeListSymbol *)sym)->getVarnodeTable();
+    for (ghidra::VarnodeSymbol *reg : table)
+    {
+      if (reg == nullptr)
+      {
+        continue;
+      }
+      const ghidra::VarnodeData &vn = reg->getFixedVarnode();
+      if (vn.space == nullptr || vn.space->getIndex() != space_index)
+      {
+        continue;
+      }
+      size_t root = root_at(vn.offset);
+      if (root < roots.size() && table.size() < rank[root])
+      {
+        rank[root] = table.size();
+      }
+    }
+  }
+
+  // registers no operand names rank right after the operand banks
+  for (size_t &value : rank)
+  {
+    value = value == SIZE_MAX ? EFFECT_BANK_MAX + 1 : value;
+  }
+
+  std::vector<size_t> order(roots.size());
+  for (size_t idx = 0; idx < order.size(); idx++)
+  {
+    order[idx] = idx;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&rank](size_t lhs, size_t rhs) { return rank[lhs] < rank[rhs]; });
+  for (size_t idx = 0; idx < order.size() && idx < EFFECT_SLOT_OTHER; idx++)
+  {
+    roots[order[idx]].slot = idx;
+  }
+
+  for (size_t id = 0; id < varnodes.size(); id++)
+  {
+    if (root_of[id] != SIZE_MAX)
+    {
+      slots[id] = roots[root_of[id]].slot;
+    }
+  }
+}
+
+void RegisterTable::mark(int32_t space, uint64_t offset, uint32_t size,
+                         uint64_t *set) const
+{
+  if (space != space_index || size == 0)
+  {
+    return;
+  }
+
+  uint64_t end = offset + size;
+  size_t root = root_at(offset);
+  if (root == roots.size())
+  {
+    // between registers, the next one it runs into is found below
+    set[EFFECT_SLOT_OTHER / 64] |= 1ull << (EFFECT_SLOT_OTHER % 64);
+    root = std::lower_bound(roots.begin(), roots.end(), offset,
+                            [](const Root &lhs, uint64_t rhs) { return lhs.end <= rhs; }) -
+           roots.begin();
+  }
+
+  for (; root < roots.size() && roots[root].offset < end; root++)
+  {
+    uint16_t slot = roots[root].slot;
+    set[slot / 64] |= 1ull << (slot % 64);
+  }
+}
+
+uint32_t RegisterTable::first_at(uint64_t offset) const
+{
+  if (!direct.empty())
+  {
+    if (offset < direct_base || offset - direct_base >= direct.size())
+    {
+      return REGISTER_NONE;
+    }
+    return direct[offset - direct_base];
+  }
+
+  std::vector<uint64_t>::const_iterator found =
+      std::lower_bound(offsets.begin(), offsets.end(), offset);
+  if (found == offsets.end() || *found != offset)
+  {
+    return REGISTER_NONE;
+  }
+  return space_start + (found - offsets.begin());
+}
+
+uint32_t RegisterTable::lookup(int32_t space, uint64_t offset,
+                               uint32_t size) const
+{
+  if (space != space_index)
+  {
+    return REGISTER_NONE;
+  }
+
+  uint32_t first = first_at(offset);
+  if (first == REGISTER_NONE)
+  {
+    return REGISTER_NONE;
+  }
+
+  uint32_t end = space_start + offsets.size();
+  uint32_t last = first;
+  while (last < end && varnodes[last].offset == offset)
+  {
+    if (varnodes[last].size == size)
+    {
+      return last;
+    }
+    last++;
+  }
+
+  static const uint32_t modifiers[] = {2, 4, 8};
+  for (size_t m = 0; m < 3; m++)
+  {
+    for (uint32_t id = first; id < last; id++)
+    {
+      if (varnodes[id].size / modifiers[m] == size)
+      {
+        return id;
+      }
+    }
+  }
+
+  return REGISTER_NONE;
+}
@@ -0,0 +1,124 @@
+/// \file register_table.hh
+/// \brief Dense lookup of the register a varnode reads or writes
+///
+/// Every register varnode of a lift gets turned back into the register it
+/// names, and matching it against the `std::map` SLEIGH hands out (or a
+/// linear scan of its copy) is a search per operand. A `RegisterTable` is
+/// built once per spec: the registers of the register space in
+/// (offset, size descending) order, a sorted array of their offsets, and a
+/// table indexed by `offset - base` holding the first register at each
+/// offset for when the register space is small enough to index directly.
+///
+/// Overlapping subregisters (`al`, `ax`, `eax`, `rax`) share an offset and
+/// are contiguous, so a lookup is one index (or binary search) followed by
+/// a walk over the few registers at that offset.
+///
+/// The table also hands out the slots of the effect bitsets of lifted
+/// instructions (`insn_effects.hh`): every register that isn't inside of a
+/// larger one gets a slot, shared by all of its subregisters. Specs with
+/// more of those than there are slots get them for the registers in the
+/// short operand banks first (the attach lists of the spec: general
+/// purpose, float and vector registers), then the ones no operand can name
+/// (flags, program counter) and last the ones in long banks (CSRs, SPRs).
+/// Whatever is left over shares `EFFECT_SLOT_OTHER`.
+#ifndef __REGISTER_TABLE_HH__
+#define __REGISTER_TABLE_HH__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "translate.hh"
+
+/// Marks a varnode that doesn't name a register
+#define REGISTER_NONE UINT32_MAX
+
+/// Most entries in the direct table, a register space spanning more
+/// offsets than this is binary searched instead
+#define REGISTER_DIRECT_MAX 0x10000
+
+/// Registers an effect bitset tells apart, the last slot stands for every
+/// register that didn't get one of its own
+#define EFFECT_SLOTS 256
+#define EFFECT_SLOT_OTHER (EFFECT_SLOTS - 1)
+
+/// Attach lists up to this long are operand banks whose registers get
+/// effect slots first
+#define EFFECT_BANK_MAX 64
+
+/**
+ * \brief every register of a spec, ids are indices into `varnodes` (the
+ * order of `Translate::getAllRegisters`)
+ */
+class RegisterTable
+{
+  std::vector<ghidra::VarnodeData> varnodes;
+  std::vector<std::string> names;
+  // index of the register space, `-1` if the spec has none
+  int32_t space_index = -1;
+  // ids `[space_start, space_start + offsets.size())` are the registers of
+  // the register space, ascending by offset
+  uint32_t space_start = 0;
+  std::vector<uint64_t> offsets;
+  // id of the first register at `direct_base + idx`, or `REGISTER_NONE`.
+  // Empty when the register space is too sparse
+  uint64_t direct_base = 0;
+  std::vector<uint32_t> direct;
+
+  // a register of the register space that isn't inside of a larger one,
+  // ascending by offset
+  struct Root
+  {
+    uint64_t offset;
+    uint64_t end;
+    uint16_t slot;
+  };
+  std::vector<Root> roots;
+  // effect slot of every register id
+  std::vector<uint16_t> slots;
+  uint32_t stack_pointer = REGISTER_NONE;
+
+  uint32_t first_at(uint64_t offset) const;
+  size_t root_at(uint64_t offset) const;
+  void assign_slots(const ghidra::Translate &trans);
+
+public:
+  /** \brief reads the registers of the spec `trans` was initialized with */
+  void build(const ghidra::Translate &trans);
+
+  /**
+   * \brief id of the register `(offset, size)` in the space with an index
+   * of `space`, or `REGISTER_NONE`. A varnode that is not a whole register
+   * resolves to the register at the same offset that is 2, 4 or 8 times
+   * its size, which is the only subregister some specs (RISC-V) give
+   */
+  uint32_t lookup(int32_t space, uint64_t offset, uint32_t size) const;
+
+  uint32_t size(void) const { return varnodes.size(); }
+  const ghidra::VarnodeData &varnode(uint32_t id) const { return varnodes[id]; }
+  const std::string &name(uint32_t id) const { return names[id]; }
+
+  /**
+   * \brief sets the effect slot of every register `(offset, size)` in the
+   * space with an index of `space` overlaps in the `EFFECT_SLOTS` bit
+   * `set`. Other spaces set nothing, register space bytes outside of any
+   * register set `EFFECT_SLOT_OTHER`
+   */
+  void mark(int32_t space, uint64_t offset, uint32_t size,
+            uint64_t *set) const;
+
+  /**
+   * \brief id of the stack pointer: the widest register named `sp` or
+   * `<x>sp` in any case (`rsp` over `esp` over `sp`), or `REGISTER_NONE`
+   */
+  uint32_t get_stack_pointer(void) const { return stack_pointer; }
+
+  int32_t get_space_index(void) const { return space_index; }
+  uint32_t get_space_start(void) const { return space_start; }
+  const std::vector<uint64_t> &get_offsets(void) const { return offsets; }
+  uint64_t get_direct_base(void) const { return direct_base; }
+  const std::vector<uint32_t> &get_direct(void) const { return direct; }
+  const std::vector<uint16_t> &get_slots(void) const { return slots; }
+};
+
+#endif
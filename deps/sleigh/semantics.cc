@@ -15,6 +15,7 @@
  */
 #include "semantics.hh"
 #include "translate.hh"
+#include "spec_arena.hh"
 
 namespace ghidra {
 
@@ -29,7 +30,7 @@ ConstTpl::ConstTpl(const_type tp,uintb val)
 {				// Constructor for real constants
   type = tp;
   value_real = val;
-  value.handle_index = 0;
+  handle_index = 0;
   select = v_space;
 }
 
@@ -37,7 +38,7 @@ ConstTpl::ConstTpl(const_type tp,int4 ht,v_field vf)
 
 {				// Constructor for handle constant
   type = handle;
-  value.handle_index = ht;
+  handle_index = ht;
   select = vf;
   value_real = 0;
 }
@@ -46,7 +47,7 @@ ConstTpl::ConstTpl(const_type tp,int4 ht,v_field vf,uintb plus)
 
 {
   type = handle;
-  value.handle_index = ht;
+  handle_index = ht;
   select = vf;
   value_real = plus;
 }
@@ -55,14 +56,14 @@ ConstTpl::ConstTpl(AddrSpace *sid)
 
 {
   type = spaceid;
-  value.spaceid = sid;
+  value_space = sid;
 }
 
 bool ConstTpl::isConstSpace(void) const
 
 {
   if (type==spaceid)
-    return (value.spaceid->getType()==IPTR_CONSTANT);
+    return (value_space->getType()==IPTR_CONSTANT);
   return false;
 }
 
@@ -70,7 +71,7 @@ bool ConstTpl::isUniqueSpace(void) const
 
 {
   if (type==spaceid)
-    return (value.spaceid->getType()==IPTR_INTERNAL);
+    return (value_space->getType()==IPTR_INTERNAL);
   return false;
 }
 
@@ -82,11 +83,11 @@ bool ConstTpl::operator==(const ConstTpl &op2) const
   case real:
     return (value_real == op2.value_real);
   case handle:
-    if (value.handle_index != op2.value.handle_index) return false;
+    if (handle_index != op2.handle_index) return false;
     if (select != op2.select) return false;
     break;
   case spaceid:
-    return (value.spaceid == op2.value.spaceid);
+    return (value_space == op2.value_space);
   default:			// Nothing additional to compare
     break;
   }
@@ -101,18 +102,63 @@ bool ConstTpl::operator<(const ConstTpl &op2) const
   case real:
     return (value_real < op2.value_real);
   case handle:
-    if (value.handle_index != op2.value.handle_index)
-      return (value.handle_index < op2.value.handle_index);
+    if (handle_index != op2.handle_index)
+      return (handle_index < op2.handle_index);
     if (select != op2.select) return (select < op2.select);
     break;
   case spaceid:
-    return (value.spaceid < op2.value.spaceid);
+    return (value_space < op2.value_space);
   default:			// Nothing additional to compare
     break;
   }
   return false;
 }
 
+bool ConstTpl::isIdentical(const ConstTpl &op2) const
+
+{				// Unlike operator==, compare every field fix() can read
+  if (type != op2.type) return false;
+  switch(type) {
+  case real:
+  case j_relative:
+    return (value_real == op2.value_real);
+  case handle:
+    if (handle_index != op2.handle_index) return false;
+    if (select != op2.select) return false;
+    if (select == v_offset_plus)
+      return (value_real == op2.value_real);
+    break;
+  case spaceid:
+    return (value_space == op2.value_space);
+  default:			// Nothing additional to compare
+    break;
+  }
+  return true;
+}
+
+uintb ConstTpl::hash(void) const
+
+{				// Hash of the fields compared by isIdentical
+  uintb res = (uintb)type * 0x9e3779b97f4a7c15ULL;
+  switch(type) {
+  case real:
+  case j_relative:
+    res ^= value_real;
+    break;
+  case handle:
+    res ^= ((uintb)handle_index << 8) | (uintb)select;
+    if (select == v_offset_plus)
+      res ^= value_real << 24;
+    break;
+  case spaceid:
+    res ^= (uintb)(uintp)value_space;
+    break;
+  default:
+    break;
+  }
+  return res;
+}
+
 uintb ConstTpl::fix(const ParserWalker &walker) const
 
 { // Get the value of the ConstTpl in context
@@ -139,7 +185,7 @@ uintb ConstTpl::fix(const ParserWalker &walker) const
     return (uintb)(uintp)walker.getCurSpace();
   case handle:
     {
-      const FixedHandle &hand(walker.getFixedHandle(value.handle_index));
+      const FixedHandle &hand(walker.getFixedHandle(handle_index));
       switch(select) {
       case v_space:
 	if (hand.offset_space == (AddrSpace *)0)
@@ -173,7 +219,7 @@ uintb ConstTpl::fix(const ParserWalker &walker) const
   case real:
     return value_real;
   case spaceid:
-    return (uintb)(uintp)value.spaceid;
+    return (uintb)(uintp)value_space;
   }
   return 0;			// Should never reach here
 }
@@ -187,7 +233,7 @@ AddrSpace *ConstTpl::fixSpace(const ParserWalker &walker) const
     return walker.getCurSpace();
   case handle:
     {
-      const FixedHandle &hand(walker.getFixedHandle(value.handle_index));
+      const FixedHandle &hand(walker.getFixedHandle(handle_index));
       switch(select) {
       case v_space:
 	if (hand.offset_space == (AddrSpace *)0)
@@ -199,7 +245,7 @@ AddrSpace *ConstTpl::fixSpace(const ParserWalker &walker) const
       break;
     }
   case spaceid:
-    return value.spaceid;
+    return value_space;
   case j_flowref:
     return walker.getRefAddr().getSpace();
   default:
@@ -217,7 +263,7 @@ void ConstTpl::fillinSpace(FixedHandle &hand,const ParserWalker &walker) const
     return;
   case handle:
     {
-      const FixedHandle &otherhand(walker.getFixedHandle(value.handle_index));
+      const FixedHandle &otherhand(walker.getFixedHandle(handle_index));
       switch(select) {
       case v_space:
 	hand.space = otherhand.space;
@@ -228,7 +274,7 @@ void ConstTpl::fillinSpace(FixedHandle &hand,const ParserWalker &walker) const
       break;
     }
   case spaceid:
-    hand.space = value.spaceid;
+    hand.space = value_space;
     return;
   default:
     break;
@@ -243,7 +289,7 @@ void ConstTpl::fillinOffset(FixedHandle &hand,const ParserWalker &walker) const
   // we don't just fill in the temporary variable offset
   // we assume hand.space is already filled in
   if (type == handle) {
-    const FixedHandle &otherhand(walker.getFixedHandle(value.handle_index));
+    const FixedHandle &otherhand(walker.getFixedHandle(handle_index));
     hand.offset_space = otherhand.offset_space;
     hand.offset_offset = otherhand.offset_offset;
     hand.offset_size = otherhand.offset_size;
@@ -260,7 +306,7 @@ void ConstTpl::transfer(const vector<HandleTpl *> &params)
 
 {				// Replace old handles with new handles
   if (type != handle) return;
-  HandleTpl *newhandle = params[value.handle_index];
+  HandleTpl *newhandle = params[handle_index];
 
   switch(select) {
   case v_space:
@@ -327,7 +373,7 @@ void ConstTpl::changeHandleIndex(const vector<int4> &handmap)
 
 {
   if (type == handle)
-    value.handle_index = handmap[value.handle_index];
+    handle_index = handmap[handle_index];
 }
 
 void ConstTpl::saveXml(ostream &s) const
@@ -339,7 +385,7 @@ void ConstTpl::saveXml(ostream &s) const
     s << "real\" val=\"0x" << hex << value_real << "\"/>";
     break;
   case handle:
-    s << "handle\" val=\"" << dec << value.handle_index << "\" ";
+    s << "handle\" val=\"" << dec << handle_index << "\" ";
     s << "s=\"";
     printHandleSelector(s,select);
     s << "\"";
@@ -363,7 +409,7 @@ void ConstTpl::saveXml(ostream &s) const
     s << "curspace_size\"/>";
     break;
   case spaceid:
-    s << "spaceid\" name=\"" << value.spaceid->getName() << "\"/>";
+    s << "spaceid\" name=\"" << value_space->getName() << "\"/>";
     break;
   case j_relative:
     s << "relative\" val=\"0x" << hex << value_real << "\"/>";
@@ -397,7 +443,7 @@ void ConstTpl::restoreXml(const Element *el,const AddrSpaceManager *manage)
     type = handle;
     istringstream s(el->getAttributeValue("val"));
     s.unsetf(ios::dec | ios::hex | ios::oct);
-    s >> value.handle_index;
+    s >> handle_index;
     select = readHandleSelector(el->getAttributeValue("s"));
     if (select == v_offset_plus) {
       istringstream s2(el->getAttributeValue("plus"));
@@ -422,7 +468,7 @@ void ConstTpl::restoreXml(const Element *el,const AddrSpaceManager *manage)
   }
   else if (typestring=="spaceid") {
     type = spaceid;
-    value.spaceid = manage->getSpaceByName(el->getAttributeValue("name"));
+    value_space = manage->getSpaceByName(el->getAttributeValue("name"));
   }
   else if (typestring=="relative") {
     type = j_relative;
@@ -446,6 +492,18 @@ void ConstTpl::restoreXml(const Element *el,const AddrSpaceManager *manage)
     throw LowlevelError("Bad constant type");
 }
 
+void *VarnodeTpl::operator new(size_t size)
+
+{
+  return SpecArena::allocate_template(size);
+}
+
+void VarnodeTpl::operator delete(void *ptr)
+
+{
+  SpecArena::free_template(ptr);
+}
+
 VarnodeTpl::VarnodeTpl(int4 hand,bool zerosize) :
   space(ConstTpl::handle,hand,ConstTpl::v_space), offset(ConstTpl::handle,hand,ConstTpl::v_offset), size(ConstTpl::handle,hand,ConstTpl::v_size)
 {				// Varnode built from a handle
@@ -576,6 +634,34 @@ bool VarnodeTpl::operator<(const VarnodeTpl &op2) const
   return false;
 }
 
+bool VarnodeTpl::isIdentical(const VarnodeTpl &op2) const
+
+{
+  return (space.isIdentical(op2.space) && offset.isIdentical(op2.offset) &&
+	  size.isIdentical(op2.size) && (unnamed_flag == op2.unnamed_flag));
+}
+
+uintb VarnodeTpl::hash(void) const
+
+{
+  uintb res = space.hash();
+  res = (res << 7 | res >> 57) ^ offset.hash();
+  res = (res << 7 | res >> 57) ^ size.hash();
+  return res;
+}
+
+void *HandleTpl::operator new(size_t size)
+
+{
+  return SpecArena::allocate_template(size);
+}
+
+void HandleTpl::operator delete(void *ptr)
+
+{
+  SpecArena::free_template(ptr);
+}
+
 HandleTpl::HandleTpl(const VarnodeTpl *vn)
 
 {				// Build handle which indicates given varnode
@@ -668,6 +754,18 @@ void HandleTpl::restoreXml(const Element *el,const AddrSpaceManager *manage)
   temp_offset.restoreXml(*iter,manage);
 }
 
+void *OpTpl::operator new(size_t size)
+
+{
+  return SpecArena::allocate_template(size);
+}
+
+void OpTpl::operator delete(void *ptr)
+
+{
+  SpecArena::free_template(ptr);
+}
+
 OpTpl::~OpTpl(void)
 
 {				// An OpTpl owns its varnode_tpls
@@ -723,6 +821,25 @@ void OpTpl::saveXml(ostream &s) const
   s << "</op_tpl>\n";
 }
 
+/// While a spec is decoded into a SpecArena, identical templates are interned
+/// into one, which is safe as nothing changes a template once it is decoded.
+/// \param el is the \<varnode_tpl> element
+/// \param manage is used to look up address spaces
+/// \return the decoded (possibly shared) template
+static VarnodeTpl *restoreVarnodeTpl(const Element *el,const AddrSpaceManager *manage)
+
+{
+  SpecArena *arena = SpecArena::current();
+  if (arena == (SpecArena *)0) {
+    VarnodeTpl *vn = new VarnodeTpl();
+    vn->restoreXml(el,manage);
+    return vn;
+  }
+  VarnodeTpl vn;
+  vn.restoreXml(el,manage);
+  return arena->intern(vn);
+}
+
 void OpTpl::restoreXml(const Element *el,const AddrSpaceManager *manage)
 
 {
@@ -732,19 +849,28 @@ void OpTpl::restoreXml(const Element *el,const AddrSpaceManager *manage)
   iter = list.begin();
   if ((*iter)->getName() == "null")
     output = (VarnodeTpl *)0;
-  else {
-    output = new VarnodeTpl();
-    output->restoreXml(*iter,manage);
-  }
+  else
+    output = restoreVarnodeTpl(*iter,manage);
   ++iter;
+  input.reserve(list.size() - 1);
   while(iter != list.end()) {
-    VarnodeTpl *vn = new VarnodeTpl();
-    vn->restoreXml(*iter,manage);
-    input.push_back(vn);
+    input.push_back(restoreVarnodeTpl(*iter,manage));
     ++iter;
   }
 }
 
+void *ConstructTpl::operator new(size_t size)
+
+{
+  return SpecArena::allocate_template(size);
+}
+
+void ConstructTpl::operator delete(void *ptr)
+
+{
+  SpecArena::free_template(ptr);
+}
+
 ConstructTpl::~ConstructTpl(void)
 
 {				// Constructor owns its ops and handles
@@ -933,6 +1059,7 @@ int4 ConstructTpl::restoreXml(const Element *el,const AddrSpaceManager *manage)
     result->restoreXml(*iter,manage);
   }
   ++iter;
+  vec.reserve(list.size() - 1);
   while(iter != list.end()) {
     OpTpl *op = new OpTpl();
     op->restoreXml(*iter,manage);
@@ -37,20 +37,20 @@ public:
 		    j_flowref=9, j_flowref_size=10, j_flowdest=11, j_flowdest_size=12 };
   enum v_field { v_space=0, v_offset=1, v_size=2, v_offset_plus=3 };
 private:
-  const_type type;
+  // Packed into 16 bytes, every VarnodeTpl holds 3 and every HandleTpl 7 of these
+  const_type type : 8;
+  v_field select : 8;		// Which part of handle to use as constant
+  int4 handle_index;		// Place holder for run-time determined value
   union {
-    //    uintb real;			// an actual constant
-    AddrSpace *spaceid;	// Id (pointer) for registered space
-    int4 handle_index;		// Place holder for run-time determined value
-  } value;
-  uintb value_real;
-  v_field select;		// Which part of handle to use as constant
+    uintb value_real;		// an actual constant, or the truncation of a v_offset_plus handle
+    AddrSpace *value_space;	// Id (pointer) for registered space
+  };
   static void printHandleSelector(ostream &s,v_field val);
   static v_field readHandleSelector(const string &name);
 public:
   ConstTpl(void) { type = real; value_real = 0; }
   ConstTpl(const ConstTpl &op2) {
-    type=op2.type; value=op2.value; value_real=op2.value_real; select=op2.select; }
+    type=op2.type; select=op2.select; handle_index=op2.handle_index; value_real=op2.value_real; }
   ConstTpl(const_type tp,uintb val);
   ConstTpl(const_type tp);
   ConstTpl(AddrSpace *sid);
@@ -60,9 +60,11 @@ public:
   bool isUniqueSpace(void) const;
   bool operator==(const ConstTpl &op2) const;
   bool operator<(const ConstTpl &op2) const;
+  bool isIdentical(const ConstTpl &op2) const;
+  uintb hash(void) const;
   uintb getReal(void) const { return value_real; }
-  AddrSpace *getSpace(void) const { return value.spaceid; }
-  int4 getHandleIndex(void) const { return value.handle_index; }
+  AddrSpace *getSpace(void) const { return value_space; }
+  int4 getHandleIndex(void) const { return handle_index; }
   const_type getType(void) const { return type; }
   v_field getSelect(void) const { return select; }
   uintb fix(const ParserWalker &walker) const;
@@ -82,6 +84,8 @@ class VarnodeTpl {
   ConstTpl space,offset,size;
   bool unnamed_flag;
 public:
+  static void *operator new(size_t size);	// Out of the SpecArena of the spec being decoded, if any
+  static void operator delete(void *ptr);
   VarnodeTpl(int4 hand,bool zerosize);
   VarnodeTpl(void) : space(), offset(), size() { unnamed_flag=false; }
   VarnodeTpl(const ConstTpl &sp,const ConstTpl &off,const ConstTpl &sz);
@@ -93,6 +97,8 @@ public:
   int4 transfer(const vector<HandleTpl *> &params);
   bool isZeroSize(void) const { return size.isZero(); }
   bool operator<(const VarnodeTpl &op2) const;
+  bool isIdentical(const VarnodeTpl &op2) const;
+  uintb hash(void) const;
   void setOffset(uintb constVal) { offset = ConstTpl(ConstTpl::real,constVal); }
   void setRelative(uintb constVal) { offset = ConstTpl(ConstTpl::j_relative,constVal); }
   void setSize(const ConstTpl &sz ) { size = sz; }
@@ -115,6 +121,8 @@ class HandleTpl {
   ConstTpl temp_space;
   ConstTpl temp_offset;
 public:
+  static void *operator new(size_t size);	// Out of the SpecArena of the spec being decoded, if any
+  static void operator delete(void *ptr);
   HandleTpl(void) {}
   HandleTpl(const VarnodeTpl *vn);
   HandleTpl(const ConstTpl &spc,const ConstTpl &sz,const VarnodeTpl *vn,
@@ -141,6 +149,8 @@ class OpTpl {
   OpCode opc;
   vector<VarnodeTpl *> input;
 public:
+  static void *operator new(size_t size);	// Out of the SpecArena of the spec being decoded, if any
+  static void operator delete(void *ptr);
   OpTpl(void) {}
   OpTpl(OpCode oc) { opc = oc; output = (VarnodeTpl *)0; }
   ~OpTpl(void);
@@ -170,6 +180,8 @@ protected:
   void setOpvec(vector<OpTpl *> &opvec) { vec = opvec; }
   void setNumLabels(uint4 val) { numlabels = val; }
 public:
+  static void *operator new(size_t size);	// Out of the SpecArena of the spec being decoded, if any
+  static void operator delete(void *ptr);
   ConstructTpl(void) { delayslot=0; numlabels=0; result = (HandleTpl *)0; }
   ~ConstructTpl(void);
   uint4 delaySlot(void) const { return delayslot; }
@@ -15,6 +15,9 @@
  */
 #include "sleigh.hh"
 #include "loadimage.hh"
+#include "lift_arena.hh"
+#include "decode_profile.hh"
+#include "lift_stats.hh"
 
 namespace ghidra {
 
@@ -67,7 +70,7 @@ VarnodeData *PcodeCacher::expandPool(uint4 size)
       issued[i].invar = invar;
     }
   }
-  list<RelativeRecord>::iterator iter;
+  vector<RelativeRecord>::iterator iter;
   for(iter=label_refs.begin();iter!=label_refs.end();++iter) {
     VarnodeData *ref = (*iter).dataptr;
     (*iter).dataptr = newpool + (ref - poolstart);
@@ -120,7 +123,7 @@ void PcodeCacher::clear(void)
 void PcodeCacher::resolveRelatives(void)
 
 {
-  list<RelativeRecord>::const_iterator iter;
+  vector<RelativeRecord>::const_iterator iter;
   for(iter=label_refs.begin();iter!=label_refs.end();++iter) {
     VarnodeData *ptr = (*iter).dataptr;
     uint4 id = ptr->offset;
@@ -133,16 +136,14 @@ void PcodeCacher::resolveRelatives(void)
   }
 }
 
-/// Each p-code operation is presented to the emitter via its dump() method.
+/// All the p-code operations are presented to the emitter in one call to its dumpOps() method,
+/// along with the pool their Varnodes were allocated from.
 /// \param addr is the Address associated with the p-code operation
 /// \param emt is the emitter
 void PcodeCacher::emit(const Address &addr,PcodeEmit *emt) const
 
 {
-  vector<PcodeData>::const_iterator iter;
-
-  for(iter=issued.begin();iter!=issued.end();++iter)
-    emt->dump(addr,(*iter).opc,(*iter).outvar,(*iter).invar,(*iter).isize);
+  emt->dumpOps(addr,issued.data(),issued.size(),poolstart,curpool - poolstart);
 }
 
 /// \brief Generate a concrete VarnodeData object from the given template (VarnodeTpl)
@@ -503,6 +504,25 @@ ParserContext *DisassemblyCache::getParserContext(const Address &addr)
   return res;
 }
 
+/// Every ParserContext read its 16 byte window starting at its address, the ones whose
+/// window overlaps the range are set back to \e uninitialized so they parse again.
+/// \param addr is the first byte that changed
+/// \param size is the number of bytes that changed
+void DisassemblyCache::invalidate(const Address &addr,uintb size)
+
+{
+  uintb first = addr.getOffset();
+  uintb last = first + size;	// One past the end
+  for(int4 i=0;i<minimumreuse;++i) {
+    ParserContext *pos = list[i];
+    const Address &start(pos->getAddr());
+    if (start.getSpace() != addr.getSpace())
+      continue;
+    if (start.getOffset() < last && first < start.getOffset() + 16)
+      pos->setParserState(ParserContext::uninitialized);
+  }
+}
+
 /// \param ld is the LoadImage to draw program bytes from
 /// \param c_db is the context database
 Sleigh::Sleigh(LoadImage *ld,ContextDatabase *c_db)
@@ -513,6 +533,9 @@ Sleigh::Sleigh(LoadImage *ld,ContextDatabase *c_db)
   context_db = c_db;
   cache = new ContextCache(c_db);
   discache = (DisassemblyCache *)0;
+  arena = (LiftArena *)0;
+  stats = (LiftStats *)0;
+  profile = (DecodeProfile *)0;
 }
 
 void Sleigh::clearForDelete(void)
@@ -541,6 +564,7 @@ void Sleigh::reset(LoadImage *ld,ContextDatabase *c_db)
   loader = ld;
   context_db = c_db;
   cache = new ContextCache(c_db);
+  cache->setStats(stats);
   discache = (DisassemblyCache *)0;
 }
 
@@ -557,13 +581,92 @@ void Sleigh::initialize(DocumentStorage &store)
   }
   else
     reregisterContext();
-  uint4 parser_cachesize = 2;
-  uint4 parser_windowsize = 32;
+  buildDisassemblyCache(0,0);
+}
+
+/// The symbol table, decision trees and address spaces of an already initialized
+/// engine are shared rather than decoded again, only the caches are private to \b this.
+/// The shared engine must outlive \b this.  Any number of engines may share the same base,
+/// and each may be used from its own thread, as decoding never modifies the shared data.
+/// \param base is the initialized engine whose specification is shared
+void Sleigh::initializeShared(const SleighBase &base)
+
+{
+  if (!isInitialized())
+    shareSpec(base);
+  else
+    reregisterContext();
+  buildDisassemblyCache(0,0);
+}
+
+/// The loaded specification sets a minimum for both sizes (instructions with delay slots
+/// need several parse trees live at once), anything smaller is raised to that minimum.
+/// The current cache is only replaced once the new one is built.
+/// \param cachesize is the number of distinct ParserContext objects in the cache
+/// \param windowsize is the size of the ParserContext hash-table, must be a power of 2
+void Sleigh::buildDisassemblyCache(int4 cachesize,int4 windowsize)
+
+{
+  int4 min_cachesize = 2;
+  int4 min_windowsize = 32;
   if ((maxdelayslotbytes > 1)||(unique_allocatemask != 0)) {
-    parser_cachesize = 8;
-    parser_windowsize = 256;
+    min_cachesize = 8;
+    min_windowsize = 256;
   }
-  discache = new DisassemblyCache(this,cache,getConstantSpace(),parser_cachesize,parser_windowsize);
+  if (cachesize < min_cachesize)
+    cachesize = min_cachesize;
+  if (windowsize < min_windowsize)
+    windowsize = min_windowsize;
+  DisassemblyCache *built = new DisassemblyCache(this,cache,getConstantSpace(),cachesize,windowsize);
+  if (discache != (DisassemblyCache *)0)
+    delete discache;
+  discache = built;
+}
+
+/// Bigger caches keep more recently parsed instructions around, which helps when the same
+/// addresses are decoded repeatedly. Passing 0 for either size keeps the default for the
+/// loaded specification.  Throws a LowlevelError if \e windowsize is not a power of 2, in
+/// which case the current cache is kept.
+/// \param cachesize is the number of distinct ParserContext objects in the cache
+/// \param windowsize is the size of the ParserContext hash-table
+void Sleigh::setDisassemblyCacheSize(int4 cachesize,int4 windowsize)
+
+{
+  buildDisassemblyCache(cachesize,windowsize);
+}
+
+/// The LoadImage must already return the new bytes, instructions overlapping them are
+/// parsed again the next time they are asked for.  Context already committed by them stays.
+/// \param addr is the first byte that changed
+/// \param size is the number of bytes that changed
+void Sleigh::invalidateBytes(const Address &addr,uintb size)
+
+{
+  if (discache != (DisassemblyCache *)0)
+    discache->invalidate(addr,size);
+}
+
+/// The ContextDatabase must already hold the new values.  The context blob cached by the
+/// ContextCache is dropped, and instructions parsed out of the range are parsed again.
+/// \param addr is the first address whose context changed
+/// \param size is the number of addresses whose context changed
+void Sleigh::invalidateContext(const Address &addr,uintb size)
+
+{
+  cache->invalidate();
+  if (discache != (DisassemblyCache *)0)
+    discache->invalidate(addr,size);
+}
+
+/// Every call to loadFill(), printAssembly() and oneInstruction() is counted and timed in \e s,
+/// as are the hits and misses of the parser and context caches. Does nothing unless built
+/// with LIBSLA_STATS.
+/// \param s is where to count, or null to stop counting
+void Sleigh::setStats(LiftStats *s)
+
+{
+  stats = s;
+  cache->setStats(s);
 }
 
 /// \brief Obtain a parse tree for the instruction at the given address
@@ -580,6 +683,10 @@ ParserContext *Sleigh::obtainContext(const Address &addr,int4 state) const
 {
   ParserContext *pos = discache->getParserContext(addr);
   int4 curstate = pos->getParserState();
+  if (curstate == ParserContext::uninitialized)
+    LIFT_STATS_ADD(stats,parser_cache_misses,1);
+  else
+    LIFT_STATS_ADD(stats,parser_cache_hits,1);
   if (curstate >= state)
     return pos;
   if (curstate == ParserContext::uninitialized) {
@@ -597,7 +704,65 @@ ParserContext *Sleigh::obtainContext(const Address &addr,int4 state) const
 void Sleigh::resolve(ParserContext &pos) const
 
 {
-  loader->loadFill(pos.getBuffer(),16,pos.getAddr());
+  resolveConstructors(pos,true);
+}
+
+/// Same as TripleSymbol::tryResolve(), the resolves of subtables are counted and timed into
+/// the DecodeProfile if one is set. Does nothing more unless built with LIBSLA_STATS.
+/// \param sym is the symbol defining the operand being resolved
+/// \param walker is the state of the parse, positioned at the operand
+/// \param ct is set to the matching Constructor, or null for a symbol without one
+/// \return \b false if nothing matches
+inline bool Sleigh::tryResolveSymbol(TripleSymbol *sym,ParserWalker &walker,Constructor *&ct) const
+
+{
+#ifdef LIBSLA_STATS
+  if (profile != (DecodeProfile *)0 && sym->getType() == SleighSymbol::subtable_symbol) {
+    SubtableSymbol *table = (SubtableSymbol *)sym;
+    int4 depth,candidates;
+    table->measureResolve(walker,depth,candidates);
+    uint8 start = lift_stats_cycles();
+    bool res = table->tryResolve(walker,ct);
+    profile->countResolve(table,res ? ct : (Constructor *)0,depth,candidates,lift_stats_cycles() - start);
+    return res;
+  }
+#endif
+  return sym->tryResolve(walker,ct);
+}
+
+/// Same as Constructor::applyContext(), timed into the DecodeProfile if one is set and the
+/// Constructor changes any context. Does nothing more unless built with LIBSLA_STATS.
+/// \param ct is the Constructor just matched
+/// \param walker is the state of the parse
+inline void Sleigh::applyConstructorContext(Constructor *ct,ParserWalkerChange &walker) const
+
+{
+#ifdef LIBSLA_STATS
+  if (profile != (DecodeProfile *)0 && ct->numContextChanges() > 0) {
+    uint8 start = lift_stats_cycles();
+    ct->applyContext(walker);
+    profile->countContext(ct,ct->numContextChanges(),lift_stats_cycles() - start);
+    return;
+  }
+#endif
+  ct->applyContext(walker);
+}
+
+/// \brief Resolve the constructors of an instruction, reporting bad data either way
+///
+/// Bytes that match no constructor, or an operand missing from a value/name/varnode table,
+/// throw BadDataError if \e report is \b true. Otherwise nothing is thrown for them and
+/// \b false is returned, leaving the parse tree unusable.
+/// \param pos is the parse object that will hold the resulting tree
+/// \param report is \b true to throw a BadDataError describing any failure
+/// \return \b true if the whole tree was resolved
+bool Sleigh::resolveConstructors(ParserContext &pos,bool report) const
+
+{
+  {
+    LIFT_STATS_TIME(stats,load_fill);
+    loader->loadFill(pos.getBuffer(),16,pos.getAddr());
+  }
   ParserWalkerChange walker(&pos);
   pos.deallocateState(walker);	// Clear the previous resolve and initialize the walker
   Constructor *ct,*subct;
@@ -608,9 +773,13 @@ void Sleigh::resolve(ParserContext &pos) const
   walker.setOffset(0);		// Initial offset
   pos.clearCommits();		// Clear any old context commits
   pos.loadContext();		// Get context for current address
-  ct = root->resolve(walker);	// Base constructor
+  if (!tryResolveSymbol(root,walker,ct)) {	// Base constructor
+    if (report)
+      root->resolve(walker);	// Throws the error describing the failure
+    return false;
+  }
   walker.setConstructor(ct);
-  ct->applyContext(walker);
+  applyConstructorContext(ct,walker);
   while(walker.isState()) {
     ct = walker.getConstructor();
     oper = walker.getOperand();
@@ -618,14 +787,27 @@ void Sleigh::resolve(ParserContext &pos) const
     while(oper < numoper) {
       OperandSymbol *sym = ct->getOperand(oper);
       off = walker.getOffset(sym->getOffsetBase()) + sym->getRelativeOffset();
+      if (!pos.canAllocateOperand(oper)) { // Out of ConstructStates, grow the pool and start over
+	pos.growState(oper);
+	return resolveConstructors(pos,report);
+      }
+      if (walker.getDepth() >= ParserWalker::max_depth) {
+	if (report)
+	  throw BadDataError("Instruction operands nest too deeply");
+	return false;
+      }
       pos.allocateOperand(oper,walker); // Descend into new operand and reserve space
       walker.setOffset(off);
       TripleSymbol *tsym = sym->getDefiningSymbol();
       if (tsym != (TripleSymbol *)0) {
-	subct = tsym->resolve(walker);
+	if (!tryResolveSymbol(tsym,walker,subct)) {
+	  if (report)
+	    tsym->resolve(walker);	// Throws the error describing the failure
+	  return false;
+	}
 	if (subct != (Constructor *)0) {
 	  walker.setConstructor(subct);
-	  subct->applyContext(walker);
+	  applyConstructorContext(subct,walker);
 	  break;
 	}
       }
@@ -644,6 +826,7 @@ void Sleigh::resolve(ParserContext &pos) const
   }
   pos.setNaddr(pos.getAddr()+pos.getLength());	// Update Naddr to pointer after instruction
   pos.setParserState(ParserContext::disassembly);
+  return true;
 }
 
 /// Resolve handle templates for the given parse tree, assuming Constructors
@@ -707,21 +890,285 @@ int4 Sleigh::instructionLength(const Address &baseaddr) const
   return pos->getLength();
 }
 
+/// The parse tree is resolved without throwing on bad data and kept in the disassembly cache
+/// on success, so printing or translating the instruction right after doesn't parse it again.
+int4 Sleigh::tryInstructionLength(const Address &baseaddr) const
+
+{
+  ParserContext *pos = discache->getParserContext(baseaddr);
+  if (pos->getParserState() != ParserContext::uninitialized) {
+    LIFT_STATS_ADD(stats,parser_cache_hits,1);
+    return pos->getLength();
+  }
+  LIFT_STATS_ADD(stats,parser_cache_misses,1);
+  if (!resolveConstructors(*pos,false))
+    return 0;
+  return pos->getLength();
+}
+
+/// Walks the templates exactly like PcodeBuilder::build would, descending into every
+/// subtable that is built, but only looks at the opcodes. A BRANCH or CBRANCH to a
+/// label inside the instruction doesn't leave it and isn't counted as a branch.
+/// \param walker is positioned on the constructor owning \e construct
+/// \param construct is the template to scan (null if the constructor is unimplemented)
+/// \param flow accumulates the flow_flags
+void Sleigh::gatherFlow(ParserWalker &walker,ConstructTpl *construct,uint4 &flow)
+
+{
+  if (construct == (ConstructTpl *)0) {
+    flow |= flow_unimplemented;
+    return;
+  }
+
+  const vector<OpTpl *> &ops(construct->getOpvec());
+  vector<OpTpl *>::const_iterator iter;
+  for(iter=ops.begin();iter!=ops.end();++iter) {
+    OpTpl *op = *iter;
+    switch(op->getOpcode()) {
+    case BUILD:
+      {
+	int4 index = op->getIn(0)->getOffset().getReal();
+	SubtableSymbol *sym = (SubtableSymbol *)walker.getConstructor()->getOperand(index)->getDefiningSymbol();
+	if ((sym==(SubtableSymbol *)0)||(sym->getType() != SleighSymbol::subtable_symbol)) break;
+	walker.pushOperand(index);
+	gatherFlow(walker,walker.getConstructor()->getTempl(),flow);
+	walker.popOperand();
+      }
+      break;
+    case CPUI_CBRANCH:
+      flow |= flow_conditional;
+      if (!op->getIn(0)->isRelative())
+	flow |= flow_branch;
+      break;
+    case CPUI_BRANCH:
+      if (!op->getIn(0)->isRelative())
+	flow |= flow_branch;
+      break;
+    case CPUI_BRANCHIND:
+      flow |= flow_branchind;
+      break;
+    case CPUI_CALL:
+      flow |= flow_call;
+      break;
+    case CPUI_CALLIND:
+      flow |= flow_callind;
+      break;
+    case CPUI_RETURN:
+      flow |= flow_return;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+/// Only the constructors are resolved, their templates are scanned for flow without
+/// building any p-code, varnodes or assembly. Context changes are committed just like
+/// oneInstruction() does, and the length + flow include any delay slot so it steps
+/// through code the same way.  Only instructions with commits get their handles resolved,
+/// which the addresses the commits paint at are read from.
+/// \param baseaddr is the Address of the instruction
+/// \param flow is set to the flow_flags of the instruction
+/// \return the number of bytes in the instruction, or 0 if it doesn't decode
+int4 Sleigh::tryInstructionFlow(const Address &baseaddr,uint4 &flow) const
+
+{
+  flow = 0;
+  if (alignment != 1 && (baseaddr.getOffset() % alignment)!=0)
+    return 0;
+  int4 length = tryInstructionLength(baseaddr);
+  if (length == 0)
+    return 0;
+
+  ParserContext *pos = discache->getParserContext(baseaddr);
+  if (pos->hasCommits()) {
+    pos = obtainContext(baseaddr,ParserContext::pcode);
+    pos->applyCommits();
+  }
+  ParserWalker walker(pos);
+  walker.baseState();
+  gatherFlow(walker,walker.getConstructor()->getTempl(),flow);
+
+  if (pos->getDelaySlot()>0) {
+    int4 bytecount = 0;
+    do {
+      int4 len = tryInstructionLength(baseaddr + length);
+      if (len == 0)
+	return 0;
+      ParserContext *delaypos = discache->getParserContext(baseaddr + length);
+      if (delaypos->getDelaySlot()>0)
+	return 0;		// Nested delay slots don't translate either
+      if (delaypos->hasCommits()) {
+	delaypos = obtainContext(baseaddr + length,ParserContext::pcode);
+	delaypos->applyCommits();
+      }
+      ParserWalker delaywalker(delaypos);
+      delaywalker.baseState();
+      gatherFlow(delaywalker,delaywalker.getConstructor()->getTempl(),flow);
+      length += len;
+      bytecount += len;
+    } while(bytecount < pos->getDelaySlot());
+  }
+  return length;
+}
+
+/// Walks the templates like gatherFlow(), looking for a CROSSBUILD, which parses and
+/// builds an instruction at some other address.
+/// \param walker is positioned on the constructor owning \e construct
+/// \param construct is the template to scan (null if the constructor is unimplemented)
+/// \return \b true if \e construct or anything it builds has a CROSSBUILD
+bool Sleigh::buildsAcross(ParserWalker &walker,ConstructTpl *construct)
+
+{
+  if (construct == (ConstructTpl *)0)
+    return false;
+
+  const vector<OpTpl *> &ops(construct->getOpvec());
+  vector<OpTpl *>::const_iterator iter;
+  for(iter=ops.begin();iter!=ops.end();++iter) {
+    OpTpl *op = *iter;
+    if (op->getOpcode() == CROSSBUILD)
+      return true;
+    if (op->getOpcode() != BUILD)
+      continue;
+    int4 index = op->getIn(0)->getOffset().getReal();
+    SubtableSymbol *sym = (SubtableSymbol *)walker.getConstructor()->getOperand(index)->getDefiningSymbol();
+    if ((sym==(SubtableSymbol *)0)||(sym->getType() != SleighSymbol::subtable_symbol)) continue;
+    walker.pushOperand(index);
+    bool across = buildsAcross(walker,walker.getConstructor()->getTempl());
+    walker.popOperand();
+    if (across)
+      return true;
+  }
+  return false;
+}
+
+/// The instruction is parsed (without throwing on bad data) and \e key is set to every
+/// input of the parse: the instruction bytes followed by the context words at the address.
+/// Any two addresses with the same key parse into the same constructors, so they only differ
+/// wherever the address itself flows into the instruction.  Instructions with a delay slot
+/// also depend on the instructions after them and are reported as 0.
+/// \param baseaddr is the Address of the instruction
+/// \param key is set to the bytes + context of the instruction
+/// \return the number of bytes in the instruction, or 0 if it doesn't decode by itself
+int4 Sleigh::tryInstructionEncoding(const Address &baseaddr,string &key) const
+
+{
+  key.clear();
+  int4 length = tryInstructionLength(baseaddr);
+  if (length == 0 || length > 16)
+    return 0;
+  ParserContext *pos = discache->getParserContext(baseaddr);
+  if (pos->getDelaySlot() > 0)
+    return 0;
+
+  uintm words[16];
+  int4 size = context_db->getContextSize();
+  if (size > 16)
+    return 0;
+  cache->getContext(baseaddr,words);
+  key.append((const char *)pos->getBuffer(),length);
+  key.append((const char *)words,size * sizeof(uintm));
+  return length;
+}
+
+/// Context changes (\e globalset) are normally committed by oneInstruction(), this commits
+/// them for an instruction whose p-code is taken from elsewhere.
+/// \param baseaddr is the Address of the instruction
+void Sleigh::commitInstructionContext(const Address &baseaddr) const
+
+{
+  ParserContext *pos = obtainContext(baseaddr,ParserContext::disassembly);
+  if (!pos->hasCommits())
+    return;
+  pos = obtainContext(baseaddr,ParserContext::pcode);
+  pos->applyCommits();
+}
+
+/// The constructors parsed at \e baseaddr are kept, only the handles are resolved again with
+/// \e asaddr as \e inst_start, so the output is what the same bytes and context would decode
+/// to at \e asaddr.  Nothing is committed to the context.  While relocated the parse tree is
+/// marked uninitialized, so anything using \e inst_next2 throws instead of parsing the bytes
+/// after \e asaddr, as do instructions with a delay slot or a \e crossbuild.
+/// \param emit receives the p-code (or is null)
+/// \param asmemit receives the assembly (or is null)
+/// \param baseaddr is the Address the instruction was parsed at
+/// \param asaddr is the Address to pretend it is at
+/// \return the number of bytes in the instruction
+int4 Sleigh::translateRelocated(PcodeEmit *emit,AssemblyEmit *asmemit,const Address &baseaddr,const Address &asaddr) const
+
+{
+  ParserContext *pos = obtainContext(baseaddr,ParserContext::disassembly);
+  int4 length = pos->getLength();
+  if (pos->getDelaySlot() > 0)
+    throw UnimplError("Cannot relocate an instruction with a delay slot",length);
+  ParserWalker walker(pos);
+  walker.baseState();
+  if (buildsAcross(walker,walker.getConstructor()->getTempl()))
+    throw UnimplError("Cannot relocate an instruction that builds another",length);
+
+  pos->setAddr(asaddr);
+  pos->setNaddr(asaddr + length);
+  pos->setParserState(ParserContext::uninitialized);
+  try {
+    resolveHandles(*pos);
+    pos->setParserState(ParserContext::uninitialized);
+    walker.baseState();
+    if (asmemit != (AssemblyEmit *)0) {
+      Constructor *ct = walker.getConstructor();
+      ostringstream mons;
+      ct->printMnemonic(mons,walker);
+      ostringstream body;
+      ct->printBody(body,walker);
+      asmemit->dump(asaddr,mons.str(),body.str());
+    }
+    if (emit != (PcodeEmit *)0) {
+      pcode_cache.clear();
+      SleighBuilder builder(&walker,discache,&pcode_cache,getConstantSpace(),getUniqueSpace(),unique_allocatemask);
+      builder.build(walker.getConstructor()->getTempl(),-1);
+      pcode_cache.resolveRelatives();
+      pcode_cache.emit(asaddr,emit);
+    }
+  } catch(...) {
+    pos->setAddr(baseaddr);
+    pos->setNaddr(baseaddr + length);
+    pos->setParserState(ParserContext::disassembly);
+    throw;
+  }
+  // The handles are resolved for asaddr, the next use at baseaddr resolves them again
+  pos->setAddr(baseaddr);
+  pos->setNaddr(baseaddr + length);
+  pos->setParserState(ParserContext::disassembly);
+  return length;
+}
+
 int4 Sleigh::printAssembly(AssemblyEmit &emit,const Address &baseaddr) const
 
 {
   int4 sz;
 
+  LIFT_STATS_TIME(stats,print_assembly);
   ParserContext *pos = obtainContext(baseaddr,ParserContext::disassembly);
   ParserWalker walker(pos);
   walker.baseState();
 
   Constructor *ct = walker.getConstructor();
-  ostringstream mons;
-  ct->printMnemonic(mons,walker);
-  ostringstream body;
-  ct->printBody(body,walker);
-  emit.dump(baseaddr,mons.str(),body.str());
+  if (arena != (LiftArena *)0) {
+    ArenaStreamBuf monsbuf(*arena,32);
+    ArenaStreamBuf bodybuf(*arena,128);
+    ostream mons(&monsbuf);
+    ostream body(&bodybuf);
+    ct->printMnemonic(mons,walker);
+    ct->printBody(body,walker);
+    emit.dumpText(baseaddr,monsbuf.data(),monsbuf.size(),bodybuf.data(),bodybuf.size());
+  }
+  else {
+    ostringstream mons;
+    ct->printMnemonic(mons,walker);
+    ostringstream body;
+    ct->printBody(body,walker);
+    emit.dump(baseaddr,mons.str(),body.str());
+  }
   sz = pos->getLength();
   return sz;
 }
@@ -730,6 +1177,7 @@ int4 Sleigh::oneInstruction(PcodeEmit &emit,const Address &baseaddr) const
 
 {
   int4 fallOffset;
+  LIFT_STATS_TIME(stats,one_instruction);
   if (alignment != 1) {
     if ((baseaddr.getOffset() % alignment)!=0) {
       ostringstream s;
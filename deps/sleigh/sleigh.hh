@@ -21,6 +21,10 @@
 
 #include "sleighbase.hh"
 
+class LiftArena;
+struct LiftStats;
+struct DecodeProfile;
+
 namespace ghidra {
 
 class LoadImage;
@@ -38,16 +42,6 @@ struct RelativeRecord {
   uintb calling_index;		///< Index of instruction containing relative offset
 };
 
-/// \brief Data for building one p-code instruction
-///
-/// Raw data used by the emitter to produce a single PcodeOp
-struct PcodeData {
-  OpCode opc;			///< The op code
-  VarnodeData *outvar;	     	///< Output Varnode data (or null)
-  VarnodeData *invar;		///< Array of input Varnode data
-  int4 isize;			///< Number of input Varnodes
-};
-
 /// \brief Class for caching a chunk of p-code, prior to emitting
 ///
 /// The engine accumulates PcodeData and VarnodeData objects for
@@ -60,7 +54,7 @@ class PcodeCacher {
   VarnodeData *curpool;			///< First unused VarnodeData
   VarnodeData *endpool;			///< End of the pool of VarnodeData objects
   vector<PcodeData> issued;		///< P-code ops issued for the current instruction
-  list<RelativeRecord> label_refs;	///< References to labels
+  vector<RelativeRecord> label_refs;	///< References to labels
   vector<uintb> labels;			///< Locations of labels
   VarnodeData *expandPool(uint4 size);	///< Expand the memory pool
 public:
@@ -119,6 +113,7 @@ public:
   DisassemblyCache(Translate *trans,ContextCache *ccache,AddrSpace *cspace,int4 cachesize,int4 windowsize);	///< Constructor
   ~DisassemblyCache(void) { free(); }	///< Destructor
   ParserContext *getParserContext(const Address &addr);		///< Get the parser for a particular Address
+  void invalidate(const Address &addr,uintb size);	///< Forget the parse of every instruction reading bytes in a range
 };
 
 /// \brief Build p-code from a pre-parsed instruction
@@ -160,12 +155,33 @@ public:
 /// P-code is produced via the oneInstruction() method, provided with a PcodeEmit
 /// object and an Address.
 class Sleigh : public SleighBase {
+public:
+  /// \brief Control flow of an instruction, as gathered by tryInstructionFlow()
+  enum flow_flags {
+    flow_branch = 1,			///< Branches (maybe conditionally) out of the instruction
+    flow_conditional = 2,		///< Has a conditional branch, so it may fall through past its flow
+    flow_branchind = 4,			///< Branches indirectly
+    flow_call = 8,			///< Calls a fixed address
+    flow_callind = 16,			///< Calls indirectly
+    flow_return = 32,			///< Returns
+    flow_unimplemented = 64		///< Some constructor it builds has no p-code
+  };
+private:
   LoadImage *loader;			///< The mapped bytes in the program
   ContextDatabase *context_db;		///< Database of context values steering disassembly
   ContextCache *cache;			///< Cache of recently used context values
   mutable DisassemblyCache *discache;	///< Cache of recently parsed instructions
   mutable PcodeCacher pcode_cache;	///< Cache of p-code data just prior to emitting
+  LiftArena *arena;			///< Scratch memory for disassembly text (or null)
+  LiftStats *stats;			///< Where the hot path is counted and timed (or null)
+  DecodeProfile *profile;		///< Where constructor resolution is profiled (or null)
   void clearForDelete(void);		///< Delete the context and disassembly caches
+  void buildDisassemblyCache(int4 cachesize,int4 windowsize);	///< Size and allocate the disassembly cache for the loaded specification
+  bool resolveConstructors(ParserContext &pos,bool report) const;	///< Generate a parse tree, optionally throwing on bad data
+  bool tryResolveSymbol(TripleSymbol *sym,ParserWalker &walker,Constructor *&ct) const;	///< Resolve an operand, profiled if requested
+  void applyConstructorContext(Constructor *ct,ParserWalkerChange &walker) const;	///< Apply context changes, profiled if requested
+  static void gatherFlow(ParserWalker &walker,ConstructTpl *construct,uint4 &flow);	///< Accumulate the flow of a template + what it builds
+  static bool buildsAcross(ParserWalker &walker,ConstructTpl *construct);	///< Does a template + what it builds crossbuild another instruction
 protected:
   ParserContext *obtainContext(const Address &addr,int4 state) const;
   void resolve(ParserContext &pos) const;	///< Generate a parse tree suitable for disassembly
@@ -175,10 +191,23 @@ public:
   virtual ~Sleigh(void);				///< Destructor
   void reset(LoadImage *ld,ContextDatabase *c_db);	///< Reset the engine for a new program
   virtual void initialize(DocumentStorage &store);
+  void initializeShared(const SleighBase &base);	///< Initialize by sharing the specification of another engine
+  void setDisassemblyCacheSize(int4 cachesize,int4 windowsize);	///< Resize the cache of recently parsed instructions
+  void invalidateBytes(const Address &addr,uintb size);	///< Forget what was parsed out of bytes that changed
+  void invalidateContext(const Address &addr,uintb size);	///< Forget what was parsed with context that changed
+  void setArena(LiftArena *a) { arena = a; }	///< Build disassembly text in \e a, which the caller resets
+  void setStats(LiftStats *s);			///< Count and time the hot path in \e s
+  void setProfile(DecodeProfile *p) { profile = p; }	///< Profile constructor resolution in \e p
   virtual void registerContext(const string &name,int4 sbit,int4 ebit);
   virtual void setContextDefault(const string &nm,uintm val);
   virtual void allowContextSet(bool val) const;
   virtual int4 instructionLength(const Address &baseaddr) const;
+  virtual int4 tryInstructionLength(const Address &baseaddr) const;
+  int4 tryInstructionFlow(const Address &baseaddr,uint4 &flow) const;	///< Length and flow_flags of an instruction, without p-code
+  int4 tryInstructionEncoding(const Address &baseaddr,string &key) const;	///< Length of an instruction + the bytes and context it decodes from
+  void commitInstructionContext(const Address &baseaddr) const;	///< Apply the context changes of an instruction without translating it
+  int4 translateRelocated(PcodeEmit *emit,AssemblyEmit *asmemit,const Address &baseaddr,const Address &asaddr) const;	///< Emit an instruction as if it started at another address
+  uint4 getUniqueAllocateMask(void) const { return unique_allocatemask; }	///< Address bits mixed into the offsets of temporaries
   virtual int4 oneInstruction(PcodeEmit &emit,const Address &baseaddr) const;
   virtual int4 printAssembly(AssemblyEmit &emit,const Address &baseaddr) const;
 };
@@ -35,8 +35,9 @@ int4 SourceFileIndexer::getIndex(string filename){
 	return fileToIndex[filename];
 }
 
-string SourceFileIndexer::getFilename(int4 index){
-	return indexToFile[index];
+string SourceFileIndexer::getFilename(int4 index) const {
+	map<int4, string>::const_iterator iter = indexToFile.find(index);
+	return (iter != indexToFile.end()) ? (*iter).second : string();
 }
 
 void SourceFileIndexer::restoreXml(const Element *el){
@@ -64,6 +65,7 @@ void SourceFileIndexer::saveXml(ostream& s) const {
 SleighBase::SleighBase(void)
 
 {
+  owner = (const SleighBase *)0;
   root = (SubtableSymbol *)0;
   maxdelayslotbytes = 0;
   unique_allocatemask = 0;
@@ -111,7 +113,7 @@ void SleighBase::buildXrefs(vector<string> &errorPairs)
 void SleighBase::reregisterContext(void)
 
 {
-  SymbolScope *glb = symtab.getGlobalScope();
+  const SymbolScope *glb = getSymbolTable().getGlobalScope();
   SymbolTree::const_iterator iter;
   SleighSymbol *sym;
   for(iter=glb->begin();iter!=glb->end();++iter) {
@@ -281,4 +283,29 @@ void SleighBase::restoreXml(const Element *el)
     throw SleighError("Duplicate register pairs");
 }
 
+/// Instead of reading a \<sleigh> tag, point \b this at the symbol table and decision
+/// trees of a SleighBase that has already been initialized. Only the address spaces are
+/// copied (by reference count), so \e base must outlive \b this and must not be modified.
+/// Context variables are registered with \b this object's context database as usual.
+/// \param base is the initialized SleighBase to share the specification of
+void SleighBase::shareSpec(const SleighBase &base)
+
+{
+  if (!base.isInitialized())
+    throw LowlevelError("Cannot share an uninitialized specification");
+  owner = (base.owner != (const SleighBase *)0) ? base.owner : &base;
+  setBigEndian(base.isBigEndian());
+  setUniqueBase(base.getUniqueBase());
+  alignment = base.getAlignment();
+  floatformats = base.floatformats;
+  maxdelayslotbytes = base.maxdelayslotbytes;
+  unique_allocatemask = base.unique_allocatemask;
+  numSections = base.numSections;
+  copySpaces(&base);
+  userop = base.userop;
+  varnode_xref = base.varnode_xref;
+  root = base.root;
+  reregisterContext();
+}
+
 } // End namespace ghidra
@@ -40,7 +40,7 @@ public:
   ///Returns the index of the file.  If the file is not in the index it is added.
   int4 index(const string filename);
   int4 getIndex(const string);	///< get the index of a file.  Error if the file is not in the index.
-  string getFilename(int4);	///< get the filename corresponding to an index
+  string getFilename(int4) const;	///< get the filename corresponding to an index
   void restoreXml(const Element *el);	///< read a stored index mapping from an XML file
   void saveXml(ostream&) const;		///< save the index mapping to an XML file
 
@@ -60,6 +60,8 @@ class SleighBase : public Translate {
   static const int4 SLA_FORMAT_VERSION;	///< Current version of the .sla file read/written by SleighBash
   vector<string> userop;		///< Names of user-define p-code ops for \b this Translate object
   map<VarnodeData,string> varnode_xref;	///< A map from Varnodes in the \e register space to register names
+  const SleighBase *owner;		///< SleighBase whose symbol table \b this borrows, or null if it owns \b symtab
+  const SymbolTable &getSymbolTable(void) const { return (owner != (const SleighBase *)0) ? owner->symtab : symtab; }	///< Get the symbol table in use
 protected:
   SubtableSymbol *root;		///< The root SLEIGH decoding symbol
   SymbolTable symtab;		///< The SLEIGH symbol table
@@ -70,6 +72,7 @@ protected:
   void buildXrefs(vector<string> &errorPairs);	///< Build register map. Collect user-ops and context-fields.
   void reregisterContext(void);	///< Reregister context fields for a new executable
   void restoreXml(const Element *el);	///< Read a SLEIGH specification from XML
+  void shareSpec(const SleighBase &base);	///< Borrow the specification already read in by another SleighBase
 public:
   static const uint4 MAX_UNIQUE_SIZE;    ///< Maximum size of a varnode in the unique space (should match value in SleighBase.java)
   SleighBase(void);		///< Construct an uninitialized translator
@@ -80,9 +83,11 @@ public:
   virtual void getAllRegisters(map<VarnodeData,string> &reglist) const;
   virtual void getUserOpNames(vector<string> &res) const;
 
-  SleighSymbol *findSymbol(const string &nm) const { return symtab.findSymbol(nm); }	///< Find a specific SLEIGH symbol by name in the current scope
-  SleighSymbol *findSymbol(uintm id) const { return symtab.findSymbol(id); }	///< Find a specific SLEIGH symbol by id
-  SleighSymbol *findGlobalSymbol(const string &nm) const { return symtab.findGlobalSymbol(nm); }	///< Find a specific global SLEIGH symbol by name
+  SleighSymbol *findSymbol(const string &nm) const { return getSymbolTable().findSymbol(nm); }	///< Find a specific SLEIGH symbol by name in the current scope
+  SleighSymbol *findSymbol(uintm id) const { return getSymbolTable().findSymbol(id); }	///< Find a specific SLEIGH symbol by id
+  SleighSymbol *findGlobalSymbol(const string &nm) const { return getSymbolTable().findGlobalSymbol(nm); }	///< Find a specific global SLEIGH symbol by name
+  int4 numSymbols(void) const { return getSymbolTable().getNumSymbols(); }	///< Number of SLEIGH symbols, the ids passed to findSymbol
+  string getSourceFile(int4 index) const { return ((owner != (const SleighBase *)0) ? owner->indexer : indexer).getFilename(index); }	///< Source file of the constructors with the given index
   void saveXml(ostream &s) const;	///< Write out the SLEIGH specification as an XML \<sleigh> tag.
 };
 
@@ -22,6 +22,7 @@ namespace ghidra {
 
 // A mask/value pair viewed as two bitstreams
 class PatternBlock {
+  friend class DecisionTable;
   int4 offset;			// Offset to non-zero byte of mask
   int4 nonzerosize;		// Last byte(+1) containing nonzero mask
   vector<uintm> maskvec;	// Mask
@@ -69,6 +70,7 @@ public:
 };
 
 class DisjointPattern : public Pattern { // A pattern with no ORs in it
+  friend class DecisionTable;
   virtual PatternBlock *getBlock(bool context) const=0;
 public:
   virtual int4 numDisjoint(void) const { return 0; }
@@ -16,6 +16,12 @@
 #include "slghsymbol.hh"
 #include "sleighbase.hh"
 #include <cmath>
+#include <cstring>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 namespace ghidra {
 
@@ -552,17 +558,27 @@ void ValueMapSymbol::checkTableFill(void)
 Constructor *ValueMapSymbol::resolve(ParserWalker &walker)
 
 {
+  Constructor *ct;
+  if (!tryResolve(walker,ct)) {
+    ostringstream s;
+    s << walker.getAddr().getShortcut();
+    walker.getAddr().printRaw(s);
+    s << ": No corresponding entry in valuetable";
+    throw BadDataError(s.str());
+  }
+  return ct;
+}
+
+bool ValueMapSymbol::tryResolve(ParserWalker &walker,Constructor *&ct)
+
+{
+  ct = (Constructor *)0;
   if (!tableisfilled) {
     intb ind = patval->getValue(walker);
-    if ((ind >= valuetable.size())||(ind<0)||(valuetable[ind] == 0xBADBEEF)) {
-      ostringstream s;
-      s << walker.getAddr().getShortcut();
-      walker.getAddr().printRaw(s);
-      s << ": No corresponding entry in valuetable";
-      throw BadDataError(s.str());
-    }
+    if ((ind >= valuetable.size())||(ind<0)||(valuetable[ind] == 0xBADBEEF))
+      return false;
   }
-  return (Constructor *)0;
+  return true;
 }
 
 void ValueMapSymbol::getFixedHandle(FixedHandle &hand,ParserWalker &walker) const
@@ -645,17 +661,27 @@ void NameSymbol::checkTableFill(void)
 Constructor *NameSymbol::resolve(ParserWalker &walker)
 
 {
+  Constructor *ct;
+  if (!tryResolve(walker,ct)) {
+    ostringstream s;
+    s << walker.getAddr().getShortcut();
+    walker.getAddr().printRaw(s);
+    s << ": No corresponding entry in nametable";
+    throw BadDataError(s.str());
+  }
+  return ct;
+}
+
+bool NameSymbol::tryResolve(ParserWalker &walker,Constructor *&ct)
+
+{
+  ct = (Constructor *)0;
   if (!tableisfilled) {
     intb ind = patval->getValue(walker);
-    if ((ind >= nametable.size())||(ind<0)||((nametable[ind].size()==1)&&(nametable[ind][0]=='\t'))) {
-      ostringstream s;
-      s << walker.getAddr().getShortcut();
-      walker.getAddr().printRaw(s);
-      s << ": No corresponding entry in nametable";
-      throw BadDataError(s.str());
-    }
+    if ((ind >= nametable.size())||(ind<0)||((nametable[ind].size()==1)&&(nametable[ind][0]=='\t')))
+      return false;
   }
-  return (Constructor *)0;
+  return true;
 }
 
 void NameSymbol::print(ostream &s,ParserWalker &walker) const
@@ -864,17 +890,27 @@ void VarnodeListSymbol::checkTableFill(void)
 Constructor *VarnodeListSymbol::resolve(ParserWalker &walker)
 
 {
+  Constructor *ct;
+  if (!tryResolve(walker,ct)) {
+    ostringstream s;
+    s << walker.getAddr().getShortcut();
+    walker.getAddr().printRaw(s);
+    s << ": No corresponding entry in varnode list";
+    throw BadDataError(s.str());
+  }
+  return ct;
+}
+
+bool VarnodeListSymbol::tryResolve(ParserWalker &walker,Constructor *&ct)
+
+{
+  ct = (Constructor *)0;
   if (!tableisfilled) {
     intb ind = patval->getValue(walker);
-    if ((ind<0)||(ind>=varnode_table.size())||(varnode_table[ind]==(VarnodeSymbol *)0)) {
-      ostringstream s;
-      s << walker.getAddr().getShortcut();
-      walker.getAddr().printRaw(s);
-      s << ": No corresponding entry in varnode list";
-      throw BadDataError(s.str());
-    }
+    if ((ind<0)||(ind>=varnode_table.size())||(varnode_table[ind]==(VarnodeSymbol *)0))
+      return false;
   }
-  return (Constructor *)0;
+  return true;
 }
 
 void VarnodeListSymbol::getFixedHandle(FixedHandle &hand,ParserWalker &walker) const
@@ -2020,6 +2056,7 @@ void SubtableSymbol::restoreXml(const Element *el,SleighBase *trans)
     else if ((*iter)->getName() == "decision") {
       decisiontree = new DecisionNode();
       decisiontree->restoreXml(*iter,(DecisionNode *)0,this);
+      decisiontable.build(decisiontree);
     }
     ++iter;
   }
@@ -2043,6 +2080,7 @@ void SubtableSymbol::buildDecisionTree(DecisionProperties &props)
 	decisiontree->addConstructorPair(pat->getDisjoint(j),construct[i]);
   }
   decisiontree->split(props);	// Create the decision strategy
+  decisiontable.build(decisiontree);
 }
 
 TokenPattern *SubtableSymbol::buildPattern(ostream &s)
@@ -2420,6 +2458,27 @@ Constructor *DecisionNode::resolve(ParserWalker &walker) const
   return children[val]->resolve(walker);
 }
 
+/// Walks down the same branches as resolve() without testing the patterns of the leaf.
+/// \param walker is the state of the parse
+/// \param depth is set to the number of branching nodes passed through
+/// \param candidates is set to the number of patterns of the leaf reached
+void DecisionNode::measure(ParserWalker &walker,int4 &depth,int4 &candidates) const
+
+{
+  const DecisionNode *node = this;
+  depth = 0;
+  while(node->bitsize != 0) {
+    uintm val;
+    if (node->contextdecision)
+      val = walker.getContextBits(node->startbit,node->bitsize);
+    else
+      val = walker.getInstructionBits(node->startbit,node->bitsize);
+    node = node->children[val];
+    depth += 1;
+  }
+  candidates = node->list.size();
+}
+
 void DecisionNode::saveXml(ostream &s) const
 
 {
@@ -2489,6 +2548,501 @@ void DecisionNode::restoreXml(const Element *el,DecisionNode *par,SubtableSymbol
   }
 }
 
+/// The children of a branching node are given consecutive slots of \b children before any of
+/// them is flattened, so the slot for field value \e v is always \b first + \e v.
+/// \param node is the node to flatten
+/// \return the index of the node in \b nodes
+uint4 DecisionTable::addNode(const DecisionNode *node)
+
+{
+  uint4 index = nodes.size();
+  nodes.emplace_back();
+  nodes[index].startbit = node->startbit;
+  nodes[index].bitsize = node->bitsize;
+  nodes[index].context = node->contextdecision;
+  nodes[index].count = 0;
+  nodes[index].window = -1;
+  nodes[index].reach = 0;
+  if (node->bitsize == 0) {
+    nodes[index].first = entries.size();
+    nodes[index].count = node->list.size();
+    for(int4 i=0;i<node->list.size();++i) {
+      const DisjointPattern *pat = node->list[i].first;
+      Entry entry;
+      entry.ct = node->list[i].second;
+      entry.never = false;
+      addBlock(pat->getBlock(false),entry.instroff,entry.instrword,entry.instrcount,entry.never);
+      addBlock(pat->getBlock(true),entry.contoff,entry.contword,entry.contcount,entry.never);
+      entries.push_back(entry);
+    }
+    addWindow(nodes[index]);
+    return index;
+  }
+  uint4 first = children.size();
+  nodes[index].first = first;
+  children.resize(first + node->children.size());
+  for(int4 i=0;i<node->children.size();++i) {
+    uint4 child = addNode(node->children[i]);
+    children[first + i] = child;
+  }
+  return index;
+}
+
+/// A missing block (an InstructionPattern has no context block and vice versa) and a block that
+/// is always true add no words.
+/// \param block is the block to copy, may be null
+/// \param off will hold the byte offset of the block
+/// \param word will hold the index of its first mask/value pair
+/// \param count will hold the number of mask/value pairs
+/// \param never is set to \b true if the block can never match
+void DecisionTable::addBlock(const PatternBlock *block,int4 &off,uint4 &word,uint4 &count,bool &never)
+
+{
+  off = 0;
+  word = words.size() / 2;
+  count = 0;
+  if (block == (const PatternBlock *)0) return;
+  if (block->nonzerosize < 0) {
+    never = true;
+    return;
+  }
+  if (block->nonzerosize == 0) return;
+  off = block->offset;
+  count = block->maskvec.size();
+  for(int4 i=0;i<block->maskvec.size();++i) {
+    words.push_back(block->maskvec[i]);
+    words.push_back(block->valvec[i]);
+  }
+}
+
+/// The window starts at the first instruction byte any candidate of the leaf tests and must
+/// cover every byte with a nonzero mask, and the start of every word (as reading a word past the
+/// end of the instruction stream throws). A leaf that needs more than DECISION_WINDOW_SIZE bytes
+/// is left without a window and always resolved one pattern at a time.
+/// \param leaf is the leaf, whose entries were just added
+void DecisionTable::addWindow(Node &leaf)
+
+{
+  rowmask.resize(entries.size()*DECISION_WINDOW_SIZE,0);
+  rowvalue.resize(entries.size()*DECISION_WINDOW_SIZE,0);
+  int4 start = -1;
+  int4 end = 0;
+  for(uint4 i=0;i<leaf.count;++i) {
+    const Entry &entry(entries[leaf.first + i]);
+    if (entry.instrcount == 0) continue;
+    if (start < 0 || entry.instroff < start)
+      start = entry.instroff;
+    int4 laststart = entry.instroff + (entry.instrcount-1)*sizeof(uintm);
+    if (laststart + 1 > end)
+      end = laststart + 1;
+    for(uint4 j=0;j<entry.instrcount;++j) {
+      uintm mask = words[2*(entry.instrword + j)];
+      for(int4 k=0;k<sizeof(uintm);++k) {
+	if (((mask >> 8*(sizeof(uintm)-1-k)) & 0xff) == 0) continue;
+	int4 off = entry.instroff + j*sizeof(uintm) + k;
+	if (off + 1 > end)
+	  end = off + 1;
+      }
+    }
+  }
+  if (start < 0)
+    start = end = 0;		// No instruction words at all, every row matches
+  if (end - start > DECISION_WINDOW_SIZE) return;
+  for(uint4 i=0;i<leaf.count;++i) {
+    const Entry &entry(entries[leaf.first + i]);
+    uint1 *mask = rowmask.data() + (leaf.first + i)*DECISION_WINDOW_SIZE;
+    uint1 *value = rowvalue.data() + (leaf.first + i)*DECISION_WINDOW_SIZE;
+    for(uint4 j=0;j<entry.instrcount;++j) {
+      uintm maskword = words[2*(entry.instrword + j)];
+      uintm valword = words[2*(entry.instrword + j) + 1];
+      for(int4 k=0;k<sizeof(uintm);++k) {
+	int4 shift = 8*(sizeof(uintm)-1-k);
+	if (((maskword >> shift) & 0xff) == 0) continue;
+	int4 pos = entry.instroff + j*sizeof(uintm) + k - start;
+	mask[pos] = (maskword >> shift) & 0xff;
+	value[pos] = (valword >> shift) & 0xff;
+      }
+    }
+  }
+  leaf.window = start;
+  leaf.reach = end - start;
+}
+
+/// \brief Find the first row, from \e i on, whose masked window bytes equal its value bytes
+///
+/// \param window is the DECISION_WINDOW_SIZE bytes of instruction stream
+/// \param mask is the mask bytes of every row
+/// \param value is the value bytes of every row
+/// \param i is the first row to test
+/// \param count is the number of rows
+/// \return the index of the matching row, or \e count if none match
+static uint4 firstWindowMatch(const uint1 *window,const uint1 *mask,const uint1 *value,uint4 i,uint4 count)
+
+{
+#if defined(__AVX2__)
+  __m256i window2 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)window));
+  for(;i+1<count;i+=2) {	// Two rows at a time
+    __m256i m = _mm256_loadu_si256((const __m256i *)(mask + i*DECISION_WINDOW_SIZE));
+    __m256i v = _mm256_loadu_si256((const __m256i *)(value + i*DECISION_WINDOW_SIZE));
+    uint4 equal = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(window2,m),v));
+    if ((equal & 0xffff) == 0xffff) return i;
+    if ((equal >> 16) == 0xffff) return i+1;
+  }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+  __m128i window1 = _mm_loadu_si128((const __m128i *)window);
+  for(;i<count;++i) {
+    __m128i m = _mm_loadu_si128((const __m128i *)(mask + i*DECISION_WINDOW_SIZE));
+    __m128i v = _mm_loadu_si128((const __m128i *)(value + i*DECISION_WINDOW_SIZE));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(window1,m),v)) == 0xffff) return i;
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  uint8x16_t window1 = vld1q_u8(window);
+  for(;i<count;++i) {
+    uint8x16_t m = vld1q_u8(mask + i*DECISION_WINDOW_SIZE);
+    uint8x16_t v = vld1q_u8(value + i*DECISION_WINDOW_SIZE);
+    if (vminvq_u8(vceqq_u8(vandq_u8(window1,m),v)) == 0xff) return i;
+  }
+#else
+  uint8 w0,w1;
+  memcpy(&w0,window,sizeof(w0));
+  memcpy(&w1,window + sizeof(w0),sizeof(w1));
+  for(;i<count;++i) {
+    uint8 m0,m1,v0,v1;
+    memcpy(&m0,mask + i*DECISION_WINDOW_SIZE,sizeof(m0));
+    memcpy(&m1,mask + i*DECISION_WINDOW_SIZE + sizeof(m0),sizeof(m1));
+    memcpy(&v0,value + i*DECISION_WINDOW_SIZE,sizeof(v0));
+    memcpy(&v1,value + i*DECISION_WINDOW_SIZE + sizeof(v0),sizeof(v1));
+    if ((w0 & m0) == v0 && (w1 & m1) == v1) return i;
+  }
+#endif
+  return count;
+}
+
+/// The instruction bytes of the window are copied out once, and the candidates are tested
+/// against them in order. Only the candidates whose instruction bytes match go on to have their
+/// context words tested.
+/// \param leaf is the leaf, which must have a window that fits in the instruction stream
+/// \param walker is the state of the parse
+/// \return the matching Constructor, or null if no candidate matches
+Constructor *DecisionTable::resolveWindow(const Node &leaf,ParserWalker &walker) const
+
+{
+  uint1 window[DECISION_WINDOW_SIZE];
+  memset(window,0,sizeof(window));
+  memcpy(window,walker.getInstructionBuffer() + walker.getOffset(-1) + leaf.window,leaf.reach);
+  const uint1 *mask = rowmask.data() + leaf.first*DECISION_WINDOW_SIZE;
+  const uint1 *value = rowvalue.data() + leaf.first*DECISION_WINDOW_SIZE;
+  uint4 i = firstWindowMatch(window,mask,value,0,leaf.count);
+  while(i < leaf.count) {
+    const Entry &entry(entries[leaf.first + i]);
+    if (!entry.never && isContextMatch(entry,walker))
+      return entry.ct;
+    i = firstWindowMatch(window,mask,value,i+1,leaf.count);
+  }
+  return (Constructor *)0;
+}
+
+/// The instruction words are tested before the context words, matching CombinePattern::isMatch().
+/// \param entry is the candidate pattern
+/// \param walker is the state of the parse
+/// \return \b true if the pattern matches
+bool DecisionTable::isMatch(const Entry &entry,ParserWalker &walker) const
+
+{
+  if (entry.never) return false;
+  const uintm *word = words.data() + 2*entry.instrword;
+  int4 off = entry.instroff;
+  for(uint4 i=0;i<entry.instrcount;++i) {
+    uintm data = walker.getInstructionBytes(off,sizeof(uintm));
+    if ((word[0] & data) != word[1]) return false;
+    off += sizeof(uintm);
+    word += 2;
+  }
+  return isContextMatch(entry,walker);
+}
+
+/// \param entry is the candidate pattern
+/// \param walker is the state of the parse
+/// \return \b true if the context words of the pattern match
+bool DecisionTable::isContextMatch(const Entry &entry,ParserWalker &walker) const
+
+{
+  const uintm *word = words.data() + 2*entry.contword;
+  int4 off = entry.contoff;
+  for(uint4 i=0;i<entry.contcount;++i) {
+    uintm data = walker.getContextBytes(off,sizeof(uintm));
+    if ((word[0] & data) != word[1]) return false;
+    off += sizeof(uintm);
+    word += 2;
+  }
+  return true;
+}
+
+/// \param root is the root of the tree to flatten, it is only read while flattening
+void DecisionTable::build(const DecisionNode *root)
+
+{
+  nodes.clear();
+  children.clear();
+  entries.clear();
+  words.clear();
+  rowmask.clear();
+  rowvalue.clear();
+  addNode(root);
+}
+
+/// \param walker is the state of the parse, positioned at the operand being resolved
+/// \return the matching Constructor
+Constructor *DecisionTable::resolve(ParserWalker &walker) const
+
+{
+  Constructor *ct = tryResolve(walker);
+  if (ct != (Constructor *)0)
+    return ct;
+  ostringstream s;
+  s << walker.getAddr().getShortcut();
+  walker.getAddr().printRaw(s);
+  s << ": Unable to resolve constructor";
+  throw BadDataError(s.str());
+}
+
+/// Same as resolve() except that bytes matching no pattern are not an error, so scanning data
+/// does not pay for an exception at every address.
+/// \param walker is the state of the parse, positioned at the operand being resolved
+/// \return the matching Constructor, or null if no pattern of the leaf matches
+Constructor *DecisionTable::tryResolve(ParserWalker &walker) const
+
+{
+  const Node *node = &nodes[0];
+  while(node->bitsize != 0) {
+    uintm val;
+    if (node->context)
+      val = walker.getContextBits(node->startbit,node->bitsize);
+    else
+      val = walker.getInstructionBits(node->startbit,node->bitsize);
+    node = &nodes[children[node->first + val]];
+  }
+  // The window must fit in the 16 bytes ParserContext buffers
+  if (node->window >= 0 && walker.getOffset(-1) + node->window + node->reach <= 16) {
+    Constructor *ct = resolveWindow(*node,walker);
+    if (ct != (Constructor *)0)
+      return ct;
+  }
+  else {
+    const Entry *entry = entries.data() + node->first;
+    for(uint4 i=0;i<node->count;++i,++entry)
+      if (isMatch(*entry,walker))
+	return entry->ct;
+  }
+  return (Constructor *)0;
+}
+
+/// Walks down the same nodes as tryResolve() without testing the candidates of the leaf.
+/// \param walker is the state of the parse, positioned at the operand being resolved
+/// \param depth is set to the number of branching nodes passed through
+/// \param candidates is set to the number of candidate patterns of the leaf reached
+void DecisionTable::measure(ParserWalker &walker,int4 &depth,int4 &candidates) const
+
+{
+  const Node *node = &nodes[0];
+  depth = 0;
+  while(node->bitsize != 0) {
+    uintm val;
+    if (node->context)
+      val = walker.getContextBits(node->startbit,node->bitsize);
+    else
+      val = walker.getInstructionBits(node->startbit,node->bitsize);
+    node = &nodes[children[node->first + val]];
+    depth += 1;
+  }
+  candidates = node->count;
+}
+
+/// \brief Mix one value into a 64-bit FNV-1a hash, a byte at a time
+///
+/// \param hash is the hash so far
+/// \param val is the value to mix in
+/// \return the new hash
+static uint8 mixFingerprint(uint8 hash,uint8 val)
+
+{
+  for(int4 i=0;i<8;++i) {
+    hash ^= (val >> (8*i)) & 0xff;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/// Two tables with the same fingerprint resolve every instruction and context to the same
+/// Constructor ids, so code written by writeDecoder() for one resolves the other.
+/// \param hash is the hash to mix into
+/// \return the new hash
+uint8 DecisionTable::fingerprint(uint8 hash) const
+
+{
+  hash = mixFingerprint(hash,nodes.size());
+  for(int4 i=0;i<nodes.size();++i) {
+    const Node &node(nodes[i]);
+    hash = mixFingerprint(hash,node.startbit);
+    hash = mixFingerprint(hash,node.bitsize);
+    hash = mixFingerprint(hash,node.context ? 1 : 0);
+    hash = mixFingerprint(hash,node.first);
+    hash = mixFingerprint(hash,node.count);
+  }
+  hash = mixFingerprint(hash,children.size());
+  for(int4 i=0;i<children.size();++i)
+    hash = mixFingerprint(hash,children[i]);
+  hash = mixFingerprint(hash,entries.size());
+  for(int4 i=0;i<entries.size();++i) {
+    const Entry &entry(entries[i]);
+    hash = mixFingerprint(hash,entry.ct->getId());
+    hash = mixFingerprint(hash,entry.never ? 1 : 0);
+    hash = mixFingerprint(hash,entry.instroff);
+    hash = mixFingerprint(hash,entry.contoff);
+    hash = mixFingerprint(hash,entry.instrword);
+    hash = mixFingerprint(hash,entry.instrcount);
+    hash = mixFingerprint(hash,entry.contword);
+    hash = mixFingerprint(hash,entry.contcount);
+  }
+  hash = mixFingerprint(hash,words.size());
+  for(int4 i=0;i<words.size();++i)
+    hash = mixFingerprint(hash,words[i]);
+  return hash;
+}
+
+/// \brief Indent every line of generated code further
+///
+/// \param code is the code to indent
+/// \param extra is the number of spaces to add at the start of each line
+/// \return the indented code
+static string indentCode(const string &code,int4 extra)
+
+{
+  string pad(extra,' ');
+  string res;
+  res.reserve(code.size() + code.size()/16*extra);
+  string::size_type pos = 0;
+  while(pos < code.size()) {
+    string::size_type eol = code.find('\n',pos);
+    if (eol == string::npos) eol = code.size() - 1;
+    res += pad;
+    res.append(code,pos,eol + 1 - pos);
+    pos = eol + 1;
+  }
+  return res;
+}
+
+/// Children that resolve exactly the same way (typically leaves with the same candidates)
+/// share one label, and the biggest group of them becomes the \b default of the switch. The
+/// code of a child that grows past DECISION_HELPER_SIZE is split off into a helper function
+/// (one per distinct body), as compilers take superlinear time over huge functions.
+/// \param index is the node to write
+/// \param helpers collects the functions split off
+/// \return the code resolving from the node down, indented as a function body
+string DecisionTable::writeNode(uint4 index,DecoderHelpers &helpers) const
+
+{
+  const Node &node(nodes[index]);
+  ostringstream s;
+  if (node.bitsize == 0) {
+    writeLeaf(s,node);
+    return s.str();
+  }
+  vector<string> bodies;
+  vector<vector<uint4> > values;
+  map<string,int4> groupof;
+  uint4 numchildren = ((uint4)1) << node.bitsize;
+  for(uint4 val=0;val<numchildren;++val) {
+    string body = writeNode(children[node.first + val],helpers);
+    if (body.size() > DECISION_HELPER_SIZE) {
+      map<string,string>::iterator iter = helpers.byBody.find(body);
+      if (iter == helpers.byBody.end()) {
+	ostringstream name;
+	name << helpers.name << '_' << dec << helpers.byBody.size();
+	iter = helpers.byBody.insert(pair<string,string>(body,name.str())).first;
+	helpers.code << "__attribute__((noinline)) static int4 " << name.str() << "(const AotStream &in)\n\n{\n";
+	helpers.code << body << "}\n\n";
+      }
+      body = "  return " + (*iter).second + "(in);\n";
+    }
+    map<string,int4>::iterator iter = groupof.find(body);
+    if (iter == groupof.end()) {
+      iter = groupof.insert(pair<string,int4>(body,bodies.size())).first;
+      bodies.push_back(body);
+      values.emplace_back();
+    }
+    values[(*iter).second].push_back(val);
+  }
+  int4 biggest = 0;
+  for(int4 i=1;i<values.size();++i)
+    if (values[i].size() > values[biggest].size())
+      biggest = i;
+
+  s << "  switch(" << (node.context ? "in.contextBits(" : "in.bits(") << dec << node.startbit << ',' << node.bitsize << ")) {\n";
+  for(int4 i=0;i<bodies.size();++i) {
+    if (i == biggest) continue;
+    for(int4 j=0;j<values[i].size();++j)
+      s << "  case 0x" << hex << values[i][j] << ":\n";
+    s << indentCode(bodies[i],2);
+  }
+  s << "  default:\n" << indentCode(bodies[biggest],2);
+  s << "  }\n";
+  return s.str();
+}
+
+/// The candidates are tested in order exactly as isMatch() does, reading each instruction and
+/// context word only when the words before it matched (as a read past the instruction stream
+/// throws). A candidate without words ends the leaf.
+/// \param s is the stream to write to, indented as a function body
+/// \param leaf is the leaf to write
+void DecisionTable::writeLeaf(ostream &s,const Node &leaf) const
+
+{
+  for(uint4 i=0;i<leaf.count;++i) {
+    const Entry &entry(entries[leaf.first + i]);
+    if (entry.never) continue;
+    ostringstream test;
+    for(uint4 j=0;j<entry.instrcount;++j) {
+      const uintm *word = words.data() + 2*(entry.instrword + j);
+      if (!test.str().empty())
+	test << " && ";
+      test << "(in.bytes(" << dec << entry.instroff + j*sizeof(uintm) << ") & 0x" << hex << word[0] << ") == 0x" << word[1];
+    }
+    for(uint4 j=0;j<entry.contcount;++j) {
+      const uintm *word = words.data() + 2*(entry.contword + j);
+      if (!test.str().empty())
+	test << " && ";
+      test << "(in.contextBytes(" << dec << entry.contoff + j*sizeof(uintm) << ") & 0x" << hex << word[0] << ") == 0x" << word[1];
+    }
+    if (test.str().empty()) {
+      s << "  return " << dec << entry.ct->getId() << ";\n";
+      return;
+    }
+    s << "  if (" << test.str() << ")\n";
+    s << "    return " << dec << entry.ct->getId() << ";\n";
+  }
+  s << "  return -1;\n";
+}
+
+/// The function is \b static, takes the ParserWalker and returns the Constructor id, see
+/// CompiledDecoder. Helper functions named after it are written first. It reads the instruction
+/// stream and context through an AotStream, so the includer must have declared that
+/// (aot_decoder.hh does).
+/// \param s is the stream to write to
+/// \param name is the name of the function to write
+void DecisionTable::writeDecoder(ostream &s,const string &name) const
+
+{
+  DecoderHelpers helpers;
+  helpers.name = name;
+  string body = writeNode(0,helpers);
+  s << helpers.code.str();
+  s << "static int4 " << name << "(ParserWalker &walker)\n\n{\n";
+  s << "  AotStream in(walker);\n";
+  s << body << "}\n";
+}
+
 static void calc_maskword(int4 sbit,int4 ebit,int4 &num,int4 &shift,uintm &mask)
 
 {
@@ -81,6 +81,7 @@ public:
   ~SymbolTable(void);
   SymbolScope *getCurrentScope(void) { return curscope; }
   SymbolScope *getGlobalScope(void) { return table[0]; }
+  const SymbolScope *getGlobalScope(void) const { return table[0]; }
 
   void setCurrentScope(SymbolScope *scope) { curscope = scope; }
   void addScope(void);		// Add new scope off of current scope, make it current
@@ -91,6 +92,7 @@ public:
   SleighSymbol *findSymbol(const string &nm,int4 skip) const { return findSymbolInternal(skipScope(skip),nm); }
   SleighSymbol *findGlobalSymbol(const string &nm) const { return findSymbolInternal(table[0],nm); }
   SleighSymbol *findSymbol(uintm id) const { return symbollist[id]; }
+  int4 getNumSymbols(void) const { return symbollist.size(); }
   void replaceSymbol(SleighSymbol *a,SleighSymbol *b);
   void saveXml(ostream &s) const;
   void restoreXml(const Element *el,SleighBase *trans);
@@ -150,6 +152,8 @@ public:
   TripleSymbol(void) {}
   TripleSymbol(const string &nm) : SleighSymbol(nm) {}
   virtual Constructor *resolve(ParserWalker &walker) { return (Constructor *)0; }
+  /// \brief Resolve like resolve(), but return \b false instead of throwing if the bytes don't decode
+  virtual bool tryResolve(ParserWalker &walker,Constructor *&ct) { ct = resolve(walker); return true; }
   virtual PatternExpression *getPatternExpression(void) const=0;
   virtual void getFixedHandle(FixedHandle &hand,ParserWalker &walker) const=0;
   virtual int4 getSize(void) const { return 0; }	// Size out of context
@@ -221,6 +225,7 @@ public:
   ValueMapSymbol(void) {}	// For use with restoreXml
   ValueMapSymbol(const string &nm,PatternValue *pv,const vector<intb> &vt) : ValueSymbol(nm,pv) { valuetable=vt; checkTableFill(); }
   virtual Constructor *resolve(ParserWalker &walker);
+  virtual bool tryResolve(ParserWalker &walker,Constructor *&ct);
   virtual void getFixedHandle(FixedHandle &hand,ParserWalker &walker) const;
   virtual void print(ostream &s,ParserWalker &walker) const;
   virtual symbol_type getType(void) const { return valuemap_symbol; }
@@ -237,6 +242,7 @@ public:
   NameSymbol(void) {}		// For use with restoreXml
   NameSymbol(const string &nm,PatternValue *pv,const vector<string> &nt) : ValueSymbol(nm,pv) { nametable=nt; checkTableFill(); }
   virtual Constructor *resolve(ParserWalker &walker);
+  virtual bool tryResolve(ParserWalker &walker,Constructor *&ct);
   virtual void print(ostream &s,ParserWalker &walker) const;
   virtual symbol_type getType(void) const { return name_symbol; }
   virtual void saveXml(ostream &s) const;
@@ -303,10 +309,12 @@ public:
   VarnodeListSymbol(void) {}	// For use with restoreXml
   VarnodeListSymbol(const string &nm,PatternValue *pv,const vector<SleighSymbol *> &vt);
   virtual Constructor *resolve(ParserWalker &walker);
+  virtual bool tryResolve(ParserWalker &walker,Constructor *&ct);
   virtual void getFixedHandle(FixedHandle &hand,ParserWalker &walker) const;
   virtual int4 getSize(void) const;
   virtual void print(ostream &s,ParserWalker &walker) const;
   virtual symbol_type getType(void) const { return varnodelist_symbol; }
+  const vector<VarnodeSymbol *> &getVarnodeTable(void) const { return varnode_table; }	///< Registers attached to each value, null for unused values
   virtual void saveXml(ostream &s) const;
   virtual void saveXmlHeader(ostream &s) const;
   virtual void restoreXml(const Element *el,SleighBase *trans);
@@ -512,7 +520,7 @@ public:
   void setLineno(int4 ln) { lineno = ln; }
   int4 getLineno(void) const { return lineno; }
   void setSrcIndex(int4 index) {src_index = index;}
-  int4 getSrcIndex(void) {return src_index;}
+  int4 getSrcIndex(void) const {return src_index;}
   void addContext(const vector<ContextChange *> &vec) { context = vec; }
   void addOperand(OperandSymbol *sym);
   void addInvisibleOperand(OperandSymbol *sym);
@@ -532,6 +540,7 @@ public:
   void printMnemonic(ostream &s,ParserWalker &walker) const;
   void printBody(ostream &s,ParserWalker &walker) const;
   void removeTrailingSpace(void);
+  int4 numContextChanges(void) const { return context.size(); }
   void applyContext(ParserWalkerChange &walker) const {
     vector<ContextChange *>::const_iterator iter;
     for(iter=context.begin();iter!=context.end();++iter)
@@ -557,6 +566,7 @@ public:
 };
 
 class DecisionNode {
+  friend class DecisionTable;
   vector<pair<DisjointPattern *,Constructor *> > list;
   vector<DecisionNode *> children;
   int4 num;			// Total number of patterns we distinguish
@@ -573,6 +583,7 @@ public:
   DecisionNode(DecisionNode *p);
   ~DecisionNode(void);
   Constructor *resolve(ParserWalker &walker) const;
+  void measure(ParserWalker &walker,int4 &depth,int4 &candidates) const;
   void addConstructorPair(const DisjointPattern *pat,Constructor *ct);
   void split(DecisionProperties &props);
   void orderPatterns(DecisionProperties &props);
@@ -580,13 +591,90 @@ public:
   void restoreXml(const Element *el,DecisionNode *par,SubtableSymbol *sub);
 };
 
+/// Bytes of instruction stream the candidates of a decision leaf are tested against at once
+#define DECISION_WINDOW_SIZE 16
+
+/// Bytes of code past which DecisionTable::writeDecoder() splits a subtree off into a function
+#define DECISION_HELPER_SIZE 4096
+
+/// \brief A decision tree compiled to C++ ahead of time, see aot_decoder.hh
+///
+/// Given the state of the parse positioned at the operand being resolved, returns the id of the
+/// Constructor that the tree resolves, or -1 if no pattern matches.
+typedef int4 (*CompiledDecoder)(ParserWalker &walker);
+
+/// \brief A DecisionNode tree flattened into arrays for resolving constructors
+///
+/// Every node of the tree becomes an entry of one array, its children a run of indices into the
+/// same array keyed by the value of the node's bit field, and the patterns of its leaves a run of
+/// contiguous mask/value words. Resolving walks the arrays in a loop instead of recursing through
+/// the tree and testing each candidate pattern through its virtual isMatch().  It resolves exactly
+/// the Constructor that DecisionNode::resolve() would, including the errors it throws.
+///
+/// The instruction patterns of a leaf are also laid out as rows of DECISION_WINDOW_SIZE mask
+/// and value bytes over one window of the instruction stream, so every candidate of the leaf is
+/// tested at once with vector compares (AVX2, SSE2 or NEON, whichever the build targets).
+class DecisionTable {
+  /// \brief A node of the tree
+  struct Node {
+    int4 startbit;		///< Starting bit of the field to branch on
+    int4 bitsize;		///< Number of bits in the field, 0 for a leaf
+    bool context;		///< \b true if the field is in the context rather than the instruction
+    uint4 first;		///< First child index, or first Entry (and window row) for a leaf
+    uint4 count;		///< Number of Entry records of a leaf
+    int4 window;		///< Start of the window of a leaf relative to the operand, -1 if it has none
+    int4 reach;			///< Bytes of the operand the window patterns read, past \b window
+  };
+  /// \brief One candidate pattern of a leaf
+  struct Entry {
+    Constructor *ct;		///< The Constructor the pattern selects
+    bool never;			///< \b true if the pattern can never match
+    int4 instroff;		///< Byte offset of the instruction words
+    int4 contoff;		///< Byte offset of the context words
+    uint4 instrword;		///< Index of the first instruction mask/value pair in \b words
+    uint4 instrcount;		///< Number of instruction mask/value pairs
+    uint4 contword;		///< Index of the first context mask/value pair in \b words
+    uint4 contcount;		///< Number of context mask/value pairs
+  };
+  vector<Node> nodes;		///< Every node, the root first
+  vector<uint4> children;	///< Child node indices of every branching node
+  vector<Entry> entries;	///< Candidate patterns of every leaf, in the order they are tried
+  vector<uintm> words;		///< Interleaved mask/value words of every pattern
+  vector<uint1> rowmask;	///< Window mask bytes of every Entry, DECISION_WINDOW_SIZE each
+  vector<uint1> rowvalue;	///< Window value bytes of every Entry, DECISION_WINDOW_SIZE each
+  uint4 addNode(const DecisionNode *node);	///< Flatten a node and everything below it
+  void addBlock(const PatternBlock *block,int4 &off,uint4 &word,uint4 &count,bool &never);
+  void addWindow(Node &leaf);	///< Lay out the window rows of a leaf
+  bool isMatch(const Entry &entry,ParserWalker &walker) const;	///< Test one candidate pattern
+  bool isContextMatch(const Entry &entry,ParserWalker &walker) const;	///< Test the context words of a pattern
+  Constructor *resolveWindow(const Node &leaf,ParserWalker &walker) const;	///< Test every candidate of a leaf at once
+  /// \brief Functions split off of the decoder being written by writeDecoder()
+  struct DecoderHelpers {
+    string name;		///< Name of the decoder, the helpers are numbered after it
+    ostringstream code;		///< Every helper written so far
+    map<string,string> byBody;	///< Name of the helper of each distinct body
+  };
+  string writeNode(uint4 index,DecoderHelpers &helpers) const;	///< Write the code resolving from one node down
+  void writeLeaf(ostream &s,const Node &leaf) const;	///< Write the tests of the candidates of a leaf
+public:
+  void build(const DecisionNode *root);	///< Flatten the given tree, replacing any previous one
+  bool empty(void) const { return nodes.empty(); }	///< Return \b true if no tree was flattened
+  Constructor *resolve(ParserWalker &walker) const;	///< Resolve the Constructor for the current instruction
+  Constructor *tryResolve(ParserWalker &walker) const;	///< Resolve the Constructor, or return null if none matches
+  void measure(ParserWalker &walker,int4 &depth,int4 &candidates) const;	///< How deep a resolve goes and how many candidates it tests
+  uint8 fingerprint(uint8 hash) const;	///< Mix everything a resolve depends on into the given hash
+  void writeDecoder(ostream &s,const string &name) const;	///< Write the tree out as a CompiledDecoder function
+};
+
 class SubtableSymbol : public TripleSymbol {
   TokenPattern *pattern;
   bool beingbuilt,errors;
   vector<Constructor *> construct; // All the Constructors in this table
   DecisionNode *decisiontree;
+  DecisionTable decisiontable;	// decisiontree flattened
+  CompiledDecoder compiled;	// decisiontree compiled ahead of time (or null)
 public:
-  SubtableSymbol(void) { pattern = (TokenPattern *)0; decisiontree = (DecisionNode *)0; } // For use with restoreXml
+  SubtableSymbol(void) { pattern = (TokenPattern *)0; decisiontree = (DecisionNode *)0; compiled = (CompiledDecoder)0; } // For use with restoreXml
   SubtableSymbol(const string &nm);
   virtual ~SubtableSymbol(void);
   bool isBeingBuilt(void) const { return beingbuilt; }
@@ -597,7 +685,27 @@ public:
   TokenPattern *getPattern(void) const { return pattern; }
   int4 getNumConstructors(void) const { return construct.size(); }
   Constructor *getConstructor(uintm id) const { return construct[id]; }
-  virtual Constructor *resolve(ParserWalker &walker) { return decisiontree->resolve(walker); }
+  const DecisionTable &getDecisionTable(void) const { return decisiontable; }
+  void setCompiled(CompiledDecoder fn) { compiled = fn; }	///< Resolve through \e fn instead of the tree, null to stop
+  CompiledDecoder getCompiled(void) const { return compiled; }
+  virtual Constructor *resolve(ParserWalker &walker) {
+    if (compiled != (CompiledDecoder)0) {
+      int4 id = compiled(walker);
+      if (id >= 0) return construct[id];
+    }				// The table throws the error describing the failure
+    return decisiontable.empty() ? decisiontree->resolve(walker) : decisiontable.resolve(walker); }
+  virtual bool tryResolve(ParserWalker &walker,Constructor *&ct) {
+    if (compiled != (CompiledDecoder)0) {
+      int4 id = compiled(walker);
+      ct = (id < 0) ? (Constructor *)0 : construct[id];
+      return (ct != (Constructor *)0);
+    }
+    if (decisiontable.empty()) { ct = decisiontree->resolve(walker); return true; }
+    ct = decisiontable.tryResolve(walker);
+    return (ct != (Constructor *)0); }
+  void measureResolve(ParserWalker &walker,int4 &depth,int4 &candidates) const {
+    if (decisiontable.empty()) decisiontree->measure(walker,depth,candidates);
+    else decisiontable.measure(walker,depth,candidates); }
   virtual PatternExpression *getPatternExpression(void) const { throw SleighError("Cannot use subtable in expression"); }
   virtual void getFixedHandle(FixedHandle &hand,ParserWalker &walker) const {
     throw SleighError("Cannot use subtable in expression"); }
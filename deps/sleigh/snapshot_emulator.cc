@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "error.hh"
+#include "snapshot_emulator.hh"
+#include "translate.hh"
+
+/// Word size of every memory bank, the widest value p-code reads in one go
+#define SNAPSHOT_WORD_SIZE 8
+
+/// Page size of the banks over the loaded image, most writes are to a stack
+/// so this is one native page
+#define SNAPSHOT_IMAGE_PAGE_SIZE 4096
+
+/// Page size of every other bank, small so that a run writing a handful of
+/// bytes of some other space only copies a handful of bytes
+#define SNAPSHOT_STATE_PAGE_SIZE 256
+
+/// Largest register or `unique` space kept flat, every snapshot copies the
+/// whole register bank
+#define SNAPSHOT_MAX_FLAT_SIZE (1 << 20)
+
+/// Largest chunk handed to a `MemoryState` at once, it takes an `int4` size
+#define SNAPSHOT_MAX_CHUNK (1 << 30)
+
+/** \brief true for the spaces that hold machine state (so not constants) */
+static bool is_state_space(const ghidra::AddrSpace *space)
+{
+  return space != nullptr && (space->getType() == ghidra::IPTR_PROCESSOR ||
+                              space->getType() == ghidra::IPTR_INTERNAL);
+}
+
+SnapshotEmulator::SnapshotEmulator(ghidra::Translate *t,
+                                   ghidra::LoadImage *loader)
+    : trans(t), state(t), emulate(make_banks(loader), &state, &breaks)
+{
+  emulate.setImage(loader);
+}
+
+ghidra::Translate *SnapshotEmulator::make_banks(ghidra::LoadImage *loader)
+{
+  images.resize(trans->numSpaces());
+  flats.resize(trans->numSpaces());
+  spills.resize(trans->numSpaces());
+  for (int32_t i = 0; i < trans->numSpaces(); i++)
+  {
+    ghidra::AddrSpace *space = trans->getSpace(i);
+    if (space == nullptr)
+    {
+      continue;
+    }
+
+    if (space == trans->getDefaultCodeSpace() ||
+        space == trans->getDefaultDataSpace())
+    {
+      images[i].reset(new ghidra::MemoryImage(space, SNAPSHOT_WORD_SIZE,
+                                              SNAPSHOT_IMAGE_PAGE_SIZE, loader));
+    }
+    else if (space == trans->getUniqueSpace() ||
+             space->getName() == "register")
+    {
+      uint64_t extent = ghidra::MemoryFlatBank::getExtent(trans, space);
+      if (extent > 0 && extent <= SNAPSHOT_MAX_FLAT_SIZE)
+      {
+        spills[i].reset(new ghidra::MemoryPageTable(
+            space, SNAPSHOT_WORD_SIZE, SNAPSHOT_STATE_PAGE_SIZE, nullptr));
+        flats[i].reset(new ghidra::MemoryFlatBank(space, SNAPSHOT_WORD_SIZE,
+                                                 SNAPSHOT_STATE_PAGE_SIZE,
+                                                 extent, spills[i].get()));
+        state.setMemoryBank(flats[i].get());
+        if (space != trans->getUniqueSpace())
+        {
+          register_bank = flats[i].get();
+        }
+      }
+    }
+  }
+
+  push_layer();
+  return trans;
+}
+
+void SnapshotEmulator::push_layer(void)
+{
+  std::vector<std::unique_ptr<ghidra::MemoryPageTable>> layer(trans->numSpaces());
+  for (int32_t i = 0; i < trans->numSpaces(); i++)
+  {
+    ghidra::AddrSpace *space = trans->getSpace(i);
+    if (!is_state_space(space) || flats[i] != nullptr)
+    {
+      continue;
+    }
+
+    ghidra::MemoryBank *under =
+        layers.empty() ? images[i].get() : layers.back()[i].get();
+    int32_t page_size = images[i] != nullptr ? SNAPSHOT_IMAGE_PAGE_SIZE
+                                             : SNAPSHOT_STATE_PAGE_SIZE;
+    layer[i].reset(new ghidra::MemoryPageTable(space, SNAPSHOT_WORD_SIZE,
+                                               page_size, under));
+    state.setMemoryBank(layer[i].get());
+  }
+
+  layers.push_back(std::move(layer));
+}
+
+const ghidra::VarnodeData &
+SnapshotEmulator::scalar_register(const std::string &name) const
+{
+  const ghidra::VarnodeData &vn = trans->getRegister(name);
+  if (vn.size == 0 || vn.size > sizeof(uint64_t))
+  {
+    throw ghidra::LowlevelError("Register " + name + " is wider than 8 bytes");
+  }
+
+  return vn;
+}
+
+void SnapshotEmulator::set_register(const std::string &name, uint64_t value)
+{
+  const ghidra::VarnodeData &vn = scalar_register(name);
+  state.setValue(vn.space, vn.offset, vn.size, value);
+}
+
+uint64_t SnapshotEmulator::get_register(const std::string &name) const
+{
+  const ghidra::VarnodeData &vn = scalar_register(name);
+  return state.getValue(vn.space, vn.offset, vn.size);
+}
+
+void SnapshotEmulator::write_memory(uint64_t address, const uint8_t *data,
+                                    uint64_t size)
+{
+  ghidra::AddrSpace *space = trans->getDefaultDataSpace();
+  if (space == trans->getDefaultCodeSpace())
+  {
+    emulate.dropCode(address, size);
+  }
+  while (size > 0)
+  {
+    int32_t chunk = std::min<uint64_t>(size, SNAPSHOT_MAX_CHUNK);
+    state.setChunk(data, space, address, chunk);
+    address += chunk;
+    data += chunk;
+    size -= chunk;
+  }
+}
+
+void SnapshotEmulator::read_memory(uint64_t address, uint8_t *out,
+                                   uint64_t size) const
+{
+  ghidra::AddrSpace *space = trans->getDefaultDataSpace();
+  while (size > 0)
+  {
+    int32_t chunk = std::min<uint64_t>(size, SNAPSHOT_MAX_CHUNK);
+    state.getChunk(out, space, address, chunk);
+    address += chunk;
+    out += chunk;
+    size -= chunk;
+  }
+}
+
+void SnapshotEmulator::snapshot(void)
+{
+  registers.emplace_back();
+  if (register_bank != nullptr)
+  {
+    registers.back().assign(register_bank->getData(),
+                            register_bank->getData() + register_bank->getSize());
+  }
+  push_layer();
+}
+
+void SnapshotEmulator::restore(void)
+{
+  // the top layer is emptied in place, its tables are reused by the next run
+  for (std::unique_ptr<ghidra::MemoryPageTable> &bank : layers.back())
+  {
+    if (bank != nullptr)
+    {
+      bank->clear();
+    }
+  }
+  if (register_bank == nullptr)
+  {
+    return;
+  }
+  if (registers.empty())
+  {
+    register_bank->clear();
+  }
+  else
+  {
+    std::copy(registers.back().begin(), registers.back().end(),
+              register_bank->getData());
+  }
+}
+
+void SnapshotEmulator::clear(void)
+{
+  layers.clear();
+  push_layer();
+  registers.clear();
+  if (register_bank != nullptr)
+  {
+    register_bank->clear();
+  }
+}
+
+void SnapshotEmulator::flush_code(void)
+{
+  emulate.clearCache();
+  // top down, every layer borrows pages from the one under it
+  for (size_t depth = layers.size(); depth > 0; depth--)
+  {
+    for (std::unique_ptr<ghidra::MemoryPageTable> &bank : layers[depth - 1])
+    {
+      if (bank != nullptr)
+      {
+        bank->flushUnwritten();
+      }
+    }
+  }
+}
+
+void SnapshotEmulator::run(uint64_t address, uint64_t max_insns,
+                           EmulateResult *out)
+{
+  out->stop = StopInsnLimit;
+  out->insn_count = 0;
+  out->address = address;
+  out->target = 0;
+
+  emulate.setHalt(false);
+
+  try
+  {
+    emulate.setExecuteAddress(
+        ghidra::Address(trans->getDefaultCodeSpace(), address));
+
+    while (out->insn_count < max_insns)
+    {
+      out->address = emulate.getExecuteAddress().getOffset();
+      out->insn_count++;
+      emulate.executeInstruction();
+
+      if (emulate.getHalt())
+      {
+        out->stop = StopUserOp;
+        return;
+      }
+      if (emulate.getFlow() == INTERP_FLOW_INDIRECT)
+      {
+        // also covers `RETURN`, the destination is left undecoded since it
+        // is usually whatever the gadget loaded
+        out->stop = StopBranch;
+        out->target = emulate.getExecuteAddress().getOffset();
+        return;
+      }
+    }
+
+    out->address = emulate.getExecuteAddress().getOffset();
+  }
+  catch (ghidra::BadDataError &err)
+  {
+    // thrown while decoding the instruction, so it didn't start
+    out->stop = StopBadInsn;
+    out->insn_count--;
+  }
+  catch (ghidra::UnimplError &err)
+  {
+    out->stop = StopBadInsn;
+    out->insn_count--;
+  }
+  catch (ghidra::LowlevelError &err)
+  {
+    out->stop = StopFault;
+  }
+}
@@ -0,0 +1,142 @@
+/// \file snapshot_emulator.hh
+/// \brief P-Code emulator over copy-on-write snapshots of its machine state
+///
+/// Validating gadget candidates means running thousands of short sequences
+/// from the same register + memory state. `SnapshotEmulator` keeps every
+/// address space as a stack of `MemoryPageTable` layers, with the loaded
+/// image at the bottom of the default code + data spaces. A snapshot freezes
+/// the top layer and pushes an empty one over it, and restoring drops the
+/// pages written since, so a run only ever copies the pages it writes to.
+/// Pages that are only read are borrowed from the layer (or image) under
+/// them, so however deep the stack, reading one is a single lookup.
+///
+/// The register + `unique` spaces are small and dense, so they are
+/// `MemoryFlatBank`s instead of layers. Every snapshot saves a copy of the
+/// register bank, and `unique` is only scratch within an instruction so it
+/// is never saved at all. Instructions are run by a `PcodeInterpreter`,
+/// which reads + writes the register bank in place.
+///
+/// Instructions are decoded through the `Translate` the emulator was built
+/// on, so it must be used from the same thread and not outlive it.
+#ifndef __SNAPSHOT_EMULATOR_HH__
+#define __SNAPSHOT_EMULATOR_HH__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "emulate.hh"
+#include "loadimage.hh"
+#include "memstate.hh"
+#include "pcode_interp.hh"
+
+/// Why `SnapshotEmulator::run` stopped
+enum EmulateStop
+{
+  StopBranch = 0, // an indirect branch, call or return, the end of a gadget
+  StopInsnLimit,  // ran the maximum number of instructions
+  StopBadInsn,    // the next instruction doesn't decode or has no p-code
+  StopUserOp,     // reached a `CALLOTHER`, which has no semantics to run
+  StopFault,      // an op the emulator can't execute, see `run`
+};
+
+/// Outcome of a single `SnapshotEmulator::run`
+struct EmulateResult
+{
+  uint32_t stop;        // `EmulateStop`
+  uint64_t insn_count;  // instructions started, the one stopped at included
+                        // unless it didn't decode
+  uint64_t address;     // instruction the run stopped at
+  uint64_t target;      // destination of the branch for `StopBranch`, else 0
+};
+
+/**
+ * \brief emulates from a layered machine state that can be snapshotted and
+ * restored in time proportional to the pages written since, see the file
+ * docs. Reads of anything never written (or loaded) are 0.
+ */
+class SnapshotEmulator
+{
+  /** \brief halts on every user op, which has no semantics to run */
+  class GadgetBreaks : public ghidra::BreakTable
+  {
+    ghidra::Emulate *emulate = nullptr;
+
+  public:
+    virtual void setEmulate(ghidra::Emulate *emu) { emulate = emu; }
+    virtual bool doPcodeOpBreak(ghidra::PcodeOpRaw *curop)
+    {
+      emulate->setHalt(true);
+      return true;
+    }
+    virtual bool doAddressBreak(const ghidra::Address &addr) { return false; }
+  };
+
+  ghidra::Translate *trans;
+  ghidra::MemoryState state;
+  // indexed by space, the loaded image under the default code + data spaces
+  std::vector<std::unique_ptr<ghidra::MemoryBank>> images;
+  // `[depth][space]`, only the last layer is ever written to
+  std::vector<std::vector<std::unique_ptr<ghidra::MemoryPageTable>>> layers;
+  // indexed by space, the spaces kept flat instead of layered and where
+  // their accesses past the flat bytes spill to
+  std::vector<std::unique_ptr<ghidra::MemoryFlatBank>> flats;
+  std::vector<std::unique_ptr<ghidra::MemoryBank>> spills;
+  ghidra::MemoryFlatBank *register_bank = nullptr;
+  // register bank of every layer but the last, `[depth]`
+  std::vector<std::vector<uint8_t>> registers;
+  GadgetBreaks breaks;
+  PcodeInterpreter emulate;
+
+  /**
+   * \brief maps the image, flat + first layer banks into `state`, returns
+   * `trans`. Runs while `emulate` is made, which needs the register bank.
+   */
+  ghidra::Translate *make_banks(ghidra::LoadImage *loader);
+
+  /** \brief overlays a fresh layer on the current top and maps it into `state` */
+  void push_layer(void);
+
+  /** \brief the varnode of the register `name`, throws if it isn't 1 - 8 bytes */
+  const ghidra::VarnodeData &scalar_register(const std::string &name) const;
+
+public:
+  SnapshotEmulator(ghidra::Translate *t, ghidra::LoadImage *loader);
+
+  void set_register(const std::string &name, uint64_t value);
+  uint64_t get_register(const std::string &name) const;
+
+  /** \brief writes/reads `size` bytes at `address` of the default data space */
+  void write_memory(uint64_t address, const uint8_t *data, uint64_t size);
+  void read_memory(uint64_t address, uint8_t *out, uint64_t size) const;
+
+  /** \brief freezes the current state, `restore` comes back to it */
+  void snapshot(void);
+
+  /**
+   * \brief drops everything written since the last `snapshot`, or since
+   * the emulator was made if there is none
+   */
+  void restore(void);
+
+  /** \brief drops every snapshot and everything ever written */
+  void clear(void);
+
+  /**
+   * \brief drops every translated instruction and every image page read,
+   * for when the image or context changes
+   */
+  void flush_code(void);
+
+  /**
+   * \brief runs from `address` until an indirect branch, call or return
+   * (which isn't followed), or `max_insns` instructions were started.
+   * Direct branches and calls are followed. Never throws, an undecodable
+   * instruction, user op, op SLEIGH can't emulate or instruction that loops
+   * for too long stops the run instead.
+   */
+  void run(uint64_t address, uint64_t max_insns, EmulateResult *out);
+};
+
+#endif
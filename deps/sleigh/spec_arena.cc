@@ -0,0 +1,109 @@
+#include <map>
+#include <mutex>
+#include <new>
+
+#include "semantics.hh"
+#include "spec_arena.hh"
+
+static thread_local SpecArena *current_arena = nullptr;
+
+// every chunk of every arena, start -> end, so a template can tell whether
+// it came out of one when it's deleted
+static std::mutex chunk_lock;
+static std::map<uintptr_t, uintptr_t> chunk_ranges;
+
+static bool in_any_chunk(const void *ptr)
+{
+  std::lock_guard<std::mutex> guard(chunk_lock);
+  std::map<uintptr_t, uintptr_t>::const_iterator iter =
+      chunk_ranges.upper_bound((uintptr_t)ptr);
+  if (iter == chunk_ranges.begin())
+  {
+    return false;
+  }
+  --iter;
+  return (uintptr_t)ptr < iter->second;
+}
+
+SpecArena::~SpecArena(void)
+{
+  std::lock_guard<std::mutex> guard(chunk_lock);
+  for (uint8_t *chunk : chunks)
+  {
+    chunk_ranges.erase((uintptr_t)chunk);
+    delete[] chunk;
+  }
+}
+
+void *SpecArena::allocate_chunk(size_t size)
+{
+  size_t chunk_size = total != 0 ? total : SPEC_ARENA_CHUNK_SIZE;
+  while (chunk_size < size)
+  {
+    chunk_size *= 2;
+  }
+
+  uint8_t *chunk = new uint8_t[chunk_size];
+  {
+    std::lock_guard<std::mutex> guard(chunk_lock);
+    chunk_ranges[(uintptr_t)chunk] = (uintptr_t)(chunk + chunk_size);
+  }
+  chunks.push_back(chunk);
+  total += chunk_size;
+  cur = chunk;
+  end = chunk + chunk_size;
+  return allocate(size);
+}
+
+ghidra::VarnodeTpl *SpecArena::intern(const ghidra::VarnodeTpl &vn)
+{
+  varnode_requests++;
+  uint64_t hash = vn.hash();
+  auto range = varnodes.equal_range(hash);
+  for (auto iter = range.first; iter != range.second; ++iter)
+  {
+    if (iter->second->isIdentical(vn))
+    {
+      return iter->second;
+    }
+  }
+
+  ghidra::VarnodeTpl *out = ::new (allocate(sizeof(ghidra::VarnodeTpl)))
+      ghidra::VarnodeTpl(vn);
+  varnodes.emplace(hash, out);
+  varnode_count++;
+  return out;
+}
+
+void SpecArena::finish(void)
+{
+  std::unordered_multimap<uint64_t, ghidra::VarnodeTpl *>().swap(varnodes);
+}
+
+SpecArena *SpecArena::current(void) { return current_arena; }
+
+void *SpecArena::allocate_template(size_t size)
+{
+  if (current_arena != nullptr)
+  {
+    return current_arena->allocate(size);
+  }
+  return ::operator new(size);
+}
+
+void SpecArena::free_template(void *ptr)
+{
+  // interned templates are shared, so this can see one more than once
+  if (ptr == nullptr || in_any_chunk(ptr))
+  {
+    return;
+  }
+  ::operator delete(ptr);
+}
+
+SpecArenaScope::SpecArenaScope(SpecArena &arena) : previous(current_arena)
+{
+  current_arena = &arena;
+}
+
+SpecArenaScope::~SpecArenaScope(void) { current_arena = previous; }
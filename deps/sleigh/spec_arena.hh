@@ -0,0 +1,118 @@
+/// \file spec_arena.hh
+/// \brief Packed storage for the p-code templates of a decoded spec
+///
+/// Most of a decoded spec is p-code templates: every `Constructor` has a
+/// `ConstructTpl` holding its `OpTpl`s, which hold a `VarnodeTpl` for their
+/// output and each input, and every one of them is its own heap allocation
+/// (x86-64 decodes ~52k `VarnodeTpl`s, over a third of its heap). While a
+/// `SpecArenaScope` is live on a thread, the templates are bump allocated
+/// out of a `SpecArena` instead, packed next to each other in a few large
+/// chunks, and identical `VarnodeTpl`s are interned into a single one.
+///
+/// Deleting a template out of an arena does nothing, its memory goes away
+/// with the arena, so the arena has to outlive the `Sleigh` decoded into it.
+/// Templates created while no scope is live (the p-code compiler, payload
+/// injection) still come from the heap.
+#ifndef __SPEC_ARENA_HH__
+#define __SPEC_ARENA_HH__
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace ghidra
+{
+class VarnodeTpl;
+}
+
+/// Bytes of the first chunk of a `SpecArena`, later ones double it
+#define SPEC_ARENA_CHUNK_SIZE 0x10000
+
+/**
+ * \brief chunked bump allocator the templates of one spec live in, only
+ * safe to allocate out of on one thread at a time
+ */
+class SpecArena
+{
+  std::vector<uint8_t *> chunks;
+  uint8_t *cur = nullptr; // next free byte of the last chunk
+  uint8_t *end = nullptr; // end of the last chunk
+  size_t total = 0;       // bytes of every chunk together
+  size_t used = 0;        // bytes handed out
+
+  // every `VarnodeTpl` interned so far by `VarnodeTpl::hash`, dropped by
+  // `finish` once the spec is decoded
+  std::unordered_multimap<uint64_t, ghidra::VarnodeTpl *> varnodes;
+  uint64_t varnode_requests = 0;
+  uint64_t varnode_count = 0;
+
+  void *allocate_chunk(size_t size);
+
+public:
+  SpecArena(void) {}
+  ~SpecArena(void);
+
+  /** \brief `size` bytes aligned to 8, which is all any template needs */
+  void *allocate(size_t size)
+  {
+    size = (size + 7) & ~(size_t)7;
+    if ((size_t)(end - cur) < size)
+    {
+      return allocate_chunk(size);
+    }
+    void *out = cur;
+    cur += size;
+    used += size;
+    return out;
+  }
+
+  /**
+   * \brief the template in this arena identical to `vn`, copying `vn` in
+   * if there isn't one yet
+   */
+  ghidra::VarnodeTpl *intern(const ghidra::VarnodeTpl &vn);
+
+  /** \brief frees the intern table, call once the spec is decoded */
+  void finish(void);
+
+  /** \brief bytes of templates allocated, and bytes held in chunks */
+  size_t bytes_used(void) const { return used; }
+  size_t capacity(void) const { return total; }
+
+  /** \brief `VarnodeTpl`s decoded, and how many distinct ones are kept */
+  uint64_t varnodes_requested(void) const { return varnode_requests; }
+  uint64_t varnodes_kept(void) const { return varnode_count; }
+
+  /** \brief the arena of the scope live on this thread, or null */
+  static SpecArena *current(void);
+
+  /** \brief `operator new` of the templates */
+  static void *allocate_template(size_t size);
+
+  /** \brief `operator delete` of the templates */
+  static void free_template(void *ptr);
+
+private:
+  SpecArena(const SpecArena &);
+  SpecArena &operator=(const SpecArena &);
+};
+
+/**
+ * \brief makes `arena` the one templates are allocated out of on this
+ * thread until the scope ends
+ */
+class SpecArenaScope
+{
+  SpecArena *previous;
+
+public:
+  explicit SpecArenaScope(SpecArena &arena);
+  ~SpecArenaScope(void);
+
+private:
+  SpecArenaScope(const SpecArenaScope &);
+  SpecArenaScope &operator=(const SpecArenaScope &);
+};
+
+#endif
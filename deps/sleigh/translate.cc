@@ -935,6 +935,16 @@ void Translate::setDefaultFloatFormats(void)
   }
 }
 
+int4 Translate::tryInstructionLength(const Address &baseaddr) const
+
+{
+  try {
+    return instructionLength(baseaddr);
+  } catch(BadDataError &err) {
+    return 0;
+  }
+}
+
 /// The pcode model for floating point encoding assumes that a
 /// consistent encoding is used for all values of a given size.
 /// This routine fetches the FloatFormat object given the size,
@@ -87,6 +87,16 @@ public:
   uint4 getSize(void) const { return size; }			///< Size (of pointers) for new truncated space
 };
 
+/// \brief Data for building one p-code instruction
+///
+/// Raw data used by the emitter to produce a single PcodeOp
+struct PcodeData {
+  OpCode opc;			///< The op code
+  VarnodeData *outvar;	     	///< Output Varnode data (or null)
+  VarnodeData *invar;		///< Array of input Varnode data
+  int4 isize;			///< Number of input Varnodes
+};
+
 /// \brief Abstract class for emitting pcode to an application
 ///
 /// Translation engines pass back the generated pcode for an
@@ -109,6 +119,21 @@ public:
   /// \param isize is the number of input varnodes
   virtual void dump(const Address &addr,OpCode opc,VarnodeData *outvar,VarnodeData *vars,int4 isize)=0;
 
+  /// \brief Emit all the pcode of a machine instruction at once
+  ///
+  /// Called instead of dump() by a Sleigh, with the ops and the VarnodeData pool they were
+  /// built in as they are. Every \e outvar and \e invar points into the pool, which is only
+  /// valid during the call. The default calls dump() for each op, emitters that copy every
+  /// op anyway can override this to skip a virtual call per op.
+  /// \param addr is the Address of the machine instruction
+  /// \param ops is the array of \e count pcode instructions, in order
+  /// \param count is the number of pcode instructions
+  /// \param pool is the start of the VarnodeData the ops reference
+  /// \param poolsize is the number of VarnodeData in the pool
+  virtual void dumpOps(const Address &addr,const PcodeData *ops,int4 count,const VarnodeData *pool,int4 poolsize) {
+    for(int4 i=0;i<count;++i)
+      dump(addr,ops[i].opc,ops[i].outvar,ops[i].invar,ops[i].isize); }
+
   /// Emit pcode directly from an \<op> element
   void decodeOp(const Address &addr,Decoder &decoder);
 };
@@ -131,6 +156,17 @@ public:
   /// \param mnem is the decoded instruction mnemonic
   /// \param body is the decode body (or operands) of the instruction
   virtual void dump(const Address &addr,const string &mnem,const string &body)=0;
+
+  /// \brief Emit disassembly that hasn't been copied into strings
+  ///
+  /// Called instead of dump() by a Sleigh with a LiftArena, the text is only valid during
+  /// the call. The default copies it into strings and calls dump(), emitters that copy the
+  /// text anyway can override this to skip those copies.
+  /// \param addr is the Address of the machine instruction
+  /// \param mnem is the decoded instruction mnemonic, \e mnemlen bytes
+  /// \param body is the decode body of the instruction, \e bodylen bytes
+  virtual void dumpText(const Address &addr,const char *mnem,int4 mnemlen,const char *body,int4 bodylen) {
+    dump(addr,string(mnem,mnemlen),string(body,bodylen)); }
 };
 
 /// \brief Abstract class for converting native constants to addresses
@@ -408,6 +444,17 @@ public:
   /// \return the number of bytes in the instruction
   virtual int4 instructionLength(const Address &baseaddr) const=0;
 
+  /// \brief Get the length of a machine instruction, or 0 if it doesn't decode
+  ///
+  /// Like instructionLength(), except that bytes which are not a valid instruction are
+  /// reported by returning 0 instead of throwing BadDataError. Scanning regions that are
+  /// mostly data can check each address with this before translating it, which costs about
+  /// as much as a failed table lookup when the engine implements it without exceptions.
+  /// The default implementation just catches the exception.
+  /// \param baseaddr is the Address of the instruction
+  /// \return the number of bytes in the instruction, or 0
+  virtual int4 tryInstructionLength(const Address &baseaddr) const;
+
   /// \brief Transform a single machine instruction into pcode
   ///
   /// This is the main interface to the pcode translation engine.
@@ -168,6 +168,7 @@ public:
   Element(Element *par) { parent = par; }	///< Constructor given a parent Element
   ~Element(void);				///< Destructor
   void setName(const string &nm) { name = nm; }	///< Set the local name of the element
+  void setName(const char *nm,int4 len) { name.assign(nm,len); }	///< Set the local name of the element from a character array
 
   /// \brief Append new character content to \b this element
   ///
@@ -190,6 +191,15 @@ public:
   void addAttribute(const string &nm,const string &vl) {
     attr.push_back(nm); value.push_back(vl); }
 
+  /// \brief Add a new name/value attribute pair to \b this element from character arrays
+  ///
+  /// \param nm is the name of the attribute, \e nmlen characters
+  /// \param nmlen is the number of characters in the name
+  /// \param vl is the value of the attribute, \e vllen characters
+  /// \param vllen is the number of characters in the value
+  void addAttribute(const char *nm,int4 nmlen,const char *vl,int4 vllen) {
+    attr.emplace_back(nm,nmlen); value.emplace_back(vl,vllen); }
+
   Element *getParent(void) const { return parent; }		///< Get the parent Element
   const string &getName(void) const { return name; }		///< Get the local name of \b this element
   const List &getChildren(void) const { return children; }	///< Get the list of child elements
@@ -0,0 +1,422 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "error.hh"
+#include "mapped_file.hh"
+#include "xml_scan.hh"
+
+static bool is_space(char c)
+{
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static bool is_name_end(char c)
+{
+  return is_space(c) || c == '=' || c == '>' || c == '/' || c == '<';
+}
+
+static bool all_space(const char *data, size_t size)
+{
+  for (size_t i = 0; i < size; i++)
+  {
+    if (!is_space(data[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void XmlScanner::fail(const char *what) const
+{
+  throw ghidra::DecoderError(std::string("XML error at byte ") +
+                             std::to_string(offset()) + ": " + what);
+}
+
+void XmlScanner::skip_space(void)
+{
+  while (cursor < end && is_space(*cursor))
+  {
+    cursor++;
+  }
+}
+
+bool XmlScanner::starts_with(const char *prefix) const
+{
+  size_t len = strlen(prefix);
+  return (size_t)(end - cursor) >= len && memcmp(cursor, prefix, len) == 0;
+}
+
+/** \brief moves past the next `terminator`, failing if there is none */
+void XmlScanner::skip_past(const char *terminator)
+{
+  size_t len = strlen(terminator);
+  while (cursor < end)
+  {
+    const char *found =
+        (const char *)memchr(cursor, terminator[0], end - cursor);
+    if (found == nullptr || (size_t)(end - found) < len)
+    {
+      break;
+    }
+    cursor = found + 1;
+    if (memcmp(found, terminator, len) == 0)
+    {
+      cursor = found + len;
+      return;
+    }
+  }
+  cursor = end;
+  fail("unterminated markup");
+}
+
+XmlView XmlScanner::scan_name(void)
+{
+  XmlView out;
+  out.data = cursor;
+  while (cursor < end && !is_name_end(*cursor) && *cursor != '&')
+  {
+    cursor++;
+  }
+  out.size = cursor - out.data;
+  if (out.size == 0)
+  {
+    fail("expected a name");
+  }
+  return out;
+}
+
+XmlScanner::Token XmlScanner::scan_attribute(void)
+{
+  name = scan_name();
+  skip_space();
+  if (cursor == end || *cursor != '=')
+  {
+    fail("expected `=` after an attribute name");
+  }
+  cursor++;
+  skip_space();
+  if (cursor == end || (*cursor != '"' && *cursor != '\''))
+  {
+    fail("expected a quoted attribute value");
+  }
+
+  char quote = *cursor++;
+  const char *close = (const char *)memchr(cursor, quote, end - cursor);
+  if (close == nullptr)
+  {
+    fail("unterminated attribute value");
+  }
+  value.data = cursor;
+  value.size = close - cursor;
+  if (memchr(value.data, '<', value.size) != nullptr)
+  {
+    fail("`<` in an attribute value");
+  }
+  escaped = memchr(value.data, '&', value.size) != nullptr;
+  cursor = close + 1;
+  return ATTRIBUTE;
+}
+
+XmlScanner::Token XmlScanner::next(void)
+{
+  if (in_tag)
+  {
+    const char *before = cursor;
+    skip_space();
+    if (cursor == end)
+    {
+      fail("unterminated start tag");
+    }
+    if (*cursor == '>')
+    {
+      cursor++;
+      in_tag = false;
+      return START_TAG_END;
+    }
+    if (*cursor == '/')
+    {
+      if (cursor + 1 == end || cursor[1] != '>')
+      {
+        fail("expected `/>`");
+      }
+      cursor += 2;
+      in_tag = false;
+      return EMPTY_ELEMENT_END;
+    }
+    if (cursor == before)
+    {
+      fail("expected white space before an attribute");
+    }
+    return scan_attribute();
+  }
+
+  for (;;)
+  {
+    if (cursor == end)
+    {
+      return END_OF_DOCUMENT;
+    }
+
+    if (*cursor != '<')
+    {
+      const char *open = (const char *)memchr(cursor, '<', end - cursor);
+      value.data = cursor;
+      value.size = (open == nullptr ? end : open) - cursor;
+      escaped = memchr(value.data, '&', value.size) != nullptr;
+      cdata = false;
+      cursor += value.size;
+      return TEXT;
+    }
+
+    if (starts_with("<!--"))
+    {
+      cursor += 4;
+      skip_past("-->");
+      continue;
+    }
+    if (starts_with("<![CDATA["))
+    {
+      cursor += 9;
+      value.data = cursor;
+      skip_past("]]>");
+      value.size = cursor - 3 - value.data;
+      escaped = false;
+      cdata = true;
+      return TEXT;
+    }
+    if (starts_with("<?"))
+    {
+      // the XML declaration, its version + encoding are unused
+      cursor += 2;
+      skip_past("?>");
+      continue;
+    }
+    if (starts_with("<!"))
+    {
+      fail("DTD's not supported");
+    }
+
+    cursor++;
+    if (cursor < end && *cursor == '/')
+    {
+      cursor++;
+      name = scan_name();
+      skip_space();
+      if (cursor == end || *cursor != '>')
+      {
+        fail("expected `>` closing an end tag");
+      }
+      cursor++;
+      return ELEMENT_END;
+    }
+
+    name = scan_name();
+    in_tag = true;
+    return ELEMENT_START;
+  }
+}
+
+void xml_scan_unescape(const XmlView &raw, std::string &out)
+{
+  const char *cursor = raw.data;
+  const char *end = raw.data + raw.size;
+  while (cursor < end)
+  {
+    const char *amp = (const char *)memchr(cursor, '&', end - cursor);
+    if (amp == nullptr)
+    {
+      out.append(cursor, end - cursor);
+      return;
+    }
+    out.append(cursor, amp - cursor);
+
+    const char *semi = (const char *)memchr(amp, ';', end - amp);
+    if (semi == nullptr)
+    {
+      throw ghidra::DecoderError("Unterminated XML reference");
+    }
+    std::string ref(amp + 1, semi - amp - 1);
+    if (ref == "lt")
+      out += '<';
+    else if (ref == "gt")
+      out += '>';
+    else if (ref == "amp")
+      out += '&';
+    else if (ref == "quot")
+      out += '"';
+    else if (ref == "apos")
+      out += '\'';
+    else if (ref.size() > 1 && ref[0] == '#')
+    {
+      bool hex = ref[1] == 'x';
+      char *digits_end = nullptr;
+      unsigned long code =
+          strtoul(ref.c_str() + (hex ? 2 : 1), &digits_end, hex ? 16 : 10);
+      if (*digits_end != '\0')
+      {
+        throw ghidra::DecoderError("Bad XML character reference: &" + ref +
+                                   ";");
+      }
+      // the bison parser keeps the low byte of the character as well
+      out += (char)code;
+    }
+    else
+    {
+      throw ghidra::DecoderError("Unknown XML entity: &" + ref + ";");
+    }
+    cursor = semi + 1;
+  }
+}
+
+/**
+ * \brief adds the text of one `TEXT` token to `el` the way the bison
+ * parser does: each run between references is dropped if it is only white
+ * space, each reference adds its character
+ */
+static void add_text(ghidra::Element *el, const XmlScanner &scan,
+                     std::string &scratch)
+{
+  const XmlView &text = scan.value;
+  if (!scan.escaped)
+  {
+    if (!all_space(text.data, text.size))
+    {
+      el->addContent(text.data, 0, text.size);
+    }
+    return;
+  }
+
+  const char *cursor = text.data;
+  const char *end = text.data + text.size;
+  while (cursor < end)
+  {
+    const char *amp = (const char *)memchr(cursor, '&', end - cursor);
+    const char *run_end = amp == nullptr ? end : amp;
+    if (!all_space(cursor, run_end - cursor))
+    {
+      el->addContent(cursor, 0, run_end - cursor);
+    }
+    if (amp == nullptr)
+    {
+      break;
+    }
+
+    const char *semi = (const char *)memchr(amp, ';', end - amp);
+    if (semi == nullptr)
+    {
+      throw ghidra::DecoderError("Unterminated XML reference");
+    }
+    XmlView ref;
+    ref.data = amp;
+    ref.size = semi + 1 - amp;
+    scratch.clear();
+    xml_scan_unescape(ref, scratch);
+    el->addContent(scratch.data(), 0, scratch.size());
+    cursor = semi + 1;
+  }
+}
+
+ghidra::Document *xml_scan_document(const char *data, size_t size)
+{
+  std::unique_ptr<ghidra::Document> doc(new ghidra::Document);
+  XmlScanner scan(data, size);
+  ghidra::Element *cur = doc.get();
+  int32_t depth = 0;
+  std::string scratch;
+
+  for (;;)
+  {
+    XmlScanner::Token token = scan.next();
+    switch (token)
+    {
+    case XmlScanner::ELEMENT_START:
+    {
+      if (cur == doc.get() && !doc->getChildren().empty())
+      {
+        throw ghidra::DecoderError("XML document has more than one root");
+      }
+      if (++depth > XML_SCAN_MAX_DEPTH)
+      {
+        throw ghidra::DecoderError("XML document nested too deeply");
+      }
+      // the parent owns the child right away, so nothing leaks on a throw
+      ghidra::Element *el = new ghidra::Element(cur);
+      cur->addChild(el);
+      el->setName(scan.name.data, scan.name.size);
+      cur = el;
+      break;
+    }
+    case XmlScanner::ATTRIBUTE:
+      if (scan.escaped)
+      {
+        scratch.clear();
+        xml_scan_unescape(scan.value, scratch);
+        cur->addAttribute(scan.name.data, scan.name.size, scratch.data(),
+                          scratch.size());
+      }
+      else
+      {
+        cur->addAttribute(scan.name.data, scan.name.size, scan.value.data,
+                          scan.value.size);
+      }
+      break;
+    case XmlScanner::START_TAG_END:
+      break;
+    case XmlScanner::EMPTY_ELEMENT_END:
+    case XmlScanner::ELEMENT_END:
+      if (cur == doc.get() ||
+          (token == XmlScanner::ELEMENT_END && !scan.name.equals(cur->getName())))
+      {
+        throw ghidra::DecoderError("Mismatched XML end tag at byte " +
+                                   std::to_string(scan.offset()));
+      }
+      depth--;
+      cur = cur->getParent();
+      break;
+    case XmlScanner::TEXT:
+      if (cur == doc.get())
+      {
+        if (scan.cdata || !all_space(scan.value.data, scan.value.size))
+        {
+          throw ghidra::DecoderError("Text outside of the XML root element");
+        }
+        break;
+      }
+      add_text(cur, scan, scratch);
+      break;
+    case XmlScanner::END_OF_DOCUMENT:
+      if (cur != doc.get())
+      {
+        throw ghidra::DecoderError("Unterminated XML element: " +
+                                   cur->getName());
+      }
+      if (doc->getChildren().empty())
+      {
+        throw ghidra::DecoderError("Empty XML document");
+      }
+      return doc.release();
+    }
+  }
+}
+
+ghidra::Document *xml_scan_file(const char *path)
+{
+  std::unique_ptr<MappedFile> file;
+  try
+  {
+    file.reset(new MappedFile(path));
+  }
+  catch (ghidra::LowlevelError &err)
+  {
+    throw ghidra::DecoderError("Unable to open xml document " +
+                               std::string(path));
+  }
+
+  // the whole file is read exactly once front to back
+  file->advise_sequential();
+  return xml_scan_document((const char *)file->data, file->size);
+}
@@ -0,0 +1,113 @@
+/// \file xml_scan.hh
+/// \brief In-situ scanning of XML documents straight out of a file mapping
+///
+/// The bison parser in `xml.y` reads its input a character at a time out of
+/// an `istream`, allocates a `std::string` for every token, every attribute
+/// name and value, and then copies each of those into the DOM. It also keeps
+/// its state in globals, so only one document can be parsed at a time.
+///
+/// `XmlScanner` walks a buffer (usually a `MappedFile` of the document)
+/// with `memchr` and hands out every name, attribute value and run of text
+/// as a view into that buffer. Only values holding a character or entity
+/// reference need to be expanded, and building the DOM copies every string
+/// exactly once. It accepts the same documents the bison parser does
+/// (elements, attributes, text, references, CDATA, comments and the XML
+/// declaration) and builds the same DOM, including dropping text that is
+/// only whitespace.
+#ifndef __XML_SCAN_HH__
+#define __XML_SCAN_HH__
+
+#include <cstddef>
+#include <string>
+
+#include "xml.hh"
+
+/// Deepest element nesting accepted while building a DOM, real specs stay
+/// well under a dozen levels
+#define XML_SCAN_MAX_DEPTH 256
+
+/** \brief a string in the scanned buffer, only valid while the buffer is */
+struct XmlView
+{
+  const char *data = nullptr;
+  size_t size = 0;
+
+  bool equals(const std::string &str) const
+  {
+    return str.size() == size && str.compare(0, size, data, size) == 0;
+  }
+};
+
+/**
+ * \brief pulls the tokens of an XML document out of `[data, data + size)`
+ * one at a time, throwing `ghidra::DecoderError` at the first byte that
+ * isn't well formed
+ */
+class XmlScanner
+{
+public:
+  enum Token
+  {
+    ELEMENT_START,     // `<name`, the name is in `name`
+    ATTRIBUTE,         // `name="value"` of the last element started
+    START_TAG_END,     // `>` closing the tag of the last element started
+    EMPTY_ELEMENT_END, // `/>`, the last element started has no content
+    ELEMENT_END,       // `</name>`
+    TEXT,              // character data or a CDATA section, in `value`
+    END_OF_DOCUMENT
+  };
+
+  XmlView name;
+  XmlView value;
+  // `value` holds references that `xml_scan_unescape` has to expand, never
+  // set for CDATA
+  bool escaped = false;
+  // `value` of a `TEXT` token is the content of a CDATA section
+  bool cdata = false;
+
+  XmlScanner(const char *data, size_t size)
+      : start(data), cursor(data), end(data + size)
+  {
+  }
+
+  Token next(void);
+
+  /** \brief offset of the next byte to be scanned, for error messages */
+  size_t offset(void) const { return cursor - start; }
+
+private:
+  const char *start;
+  const char *cursor;
+  const char *end;
+  // inside of a start tag, between its name and `>` or `/>`
+  bool in_tag = false;
+
+  [[noreturn]] void fail(const char *what) const;
+  void skip_space(void);
+  void skip_past(const char *terminator);
+  bool starts_with(const char *prefix) const;
+  XmlView scan_name(void);
+  Token scan_attribute(void);
+};
+
+/**
+ * \brief appends `raw` to `out` with every character and entity reference
+ * expanded, throws `ghidra::DecoderError` on an unknown reference
+ */
+void xml_scan_unescape(const XmlView &raw, std::string &out);
+
+/**
+ * \brief builds the DOM of the XML document in `[data, data + size)`, the
+ * caller owns the returned document. Throws `ghidra::DecoderError` if it
+ * isn't well formed.
+ */
+ghidra::Document *xml_scan_document(const char *data, size_t size);
+
+/**
+ * \brief maps the XML document at `path` and builds its DOM, same as
+ * `xml_scan_document`. Unlike `DocumentStorage::openDocument` any number
+ * of documents can be scanned at once.
+ */
+ghidra::Document *xml_scan_file(const char *path);
+
+#endif
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include <zstd.h>
+
+#include "error.hh"
+#include "zstd_image.hh"
+
+/// Magic of the skippable frame holding a seek table, and of its footer
+#define SEEK_TABLE_FRAME_MAGIC 0x184D2A5E
+#define SEEK_TABLE_FOOTER_MAGIC 0x8F92EAB1
+#define SEEK_TABLE_FOOTER_SIZE 9
+
+#define SKIPPABLE_MAGIC_MASK 0xFFFFFFF0
+#define SKIPPABLE_MAGIC 0x184D2A50
+
+static std::atomic<uint64_t> next_image_id(1);
+
+struct DCtxDeleter
+{
+  void operator()(ZSTD_DCtx *ctx) const { ZSTD_freeDCtx(ctx); }
+};
+
+// decompression contexts are big, every thread keeps one around
+static thread_local std::unique_ptr<ZSTD_DCtx, DCtxDeleter> thread_dctx;
+
+// the chunk this thread read last, SLEIGH reads a few bytes at a time so
+// most reads land in the same frame as the one before and skip the lock
+static thread_local struct
+{
+  uint64_t image = 0;
+  size_t frame = 0;
+  std::shared_ptr<const std::vector<uint8_t>> data;
+} last_chunk;
+
+static uint32_t read_le32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static ghidra::LowlevelError zstd_error(const std::string &what)
+{
+  return ghidra::LowlevelError("Bad zstd image: " + what);
+}
+
+ZstdImage::ZstdImage(const char *path, size_t cache_chunks)
+    : file(path), id(next_image_id++), capacity(std::max<size_t>(cache_chunks, 1)),
+      hits(0), misses(0)
+{
+  if (!detect(file.data, file.size))
+  {
+    throw zstd_error(std::string(path) + " doesn't start with a zstd frame");
+  }
+  if (!read_seek_table())
+  {
+    scan_frames();
+  }
+}
+
+void ZstdImage::add_frame(uint64_t compressed_offset, uint64_t compressed_size,
+                          uint64_t decompressed_size)
+{
+  if (decompressed_size > ZSTD_IMAGE_MAX_FRAME)
+  {
+    throw zstd_error("frame at " + std::to_string(compressed_offset) +
+                     " decompresses to more than " +
+                     std::to_string(ZSTD_IMAGE_MAX_FRAME) +
+                     " bytes, recompress it into smaller frames");
+  }
+  if (decompressed_size == 0)
+  {
+    return;
+  }
+
+  Frame frame;
+  frame.compressed_offset = compressed_offset;
+  frame.decompressed_offset = total;
+  frame.compressed_size = (uint32_t)compressed_size;
+  frame.decompressed_size = (uint32_t)decompressed_size;
+  frames.push_back(frame);
+  total += decompressed_size;
+}
+
+/**
+ * \brief indexes the frames from the seek table at the end of the file,
+ * false if there is none
+ */
+bool ZstdImage::read_seek_table(void)
+{
+  if (file.size < SEEK_TABLE_FOOTER_SIZE + 8)
+  {
+    return false;
+  }
+  const uint8_t *footer = file.data + file.size - SEEK_TABLE_FOOTER_SIZE;
+  if (read_le32(footer + 5) != SEEK_TABLE_FOOTER_MAGIC)
+  {
+    return false;
+  }
+
+  uint64_t count = read_le32(footer);
+  uint64_t entry_size = (footer[4] & 0x80) != 0 ? 12 : 8;
+  uint64_t table_size = count * entry_size + SEEK_TABLE_FOOTER_SIZE;
+  if (table_size + 8 > file.size)
+  {
+    throw zstd_error("seek table is larger than the file");
+  }
+  const uint8_t *table = file.data + file.size - table_size;
+  if (read_le32(table - 8) != SEEK_TABLE_FRAME_MAGIC ||
+      read_le32(table - 4) != table_size)
+  {
+    throw zstd_error("seek table isn't in a skippable frame");
+  }
+
+  uint64_t compressed_end = file.size - table_size - 8;
+  uint64_t offset = 0;
+  for (uint64_t i = 0; i < count; i++)
+  {
+    const uint8_t *entry = table + i * entry_size;
+    uint64_t compressed_size = read_le32(entry);
+    uint64_t decompressed_size = read_le32(entry + 4);
+    if (compressed_size > compressed_end - offset)
+    {
+      throw zstd_error("seek table runs past the frames");
+    }
+    add_frame(offset, compressed_size, decompressed_size);
+    offset += compressed_size;
+  }
+  return true;
+}
+
+/** \brief indexes the frames by walking their headers */
+void ZstdImage::scan_frames(void)
+{
+  uint64_t offset = 0;
+  while (offset < file.size)
+  {
+    const uint8_t *frame = file.data + offset;
+    size_t left = file.size - offset;
+    size_t compressed_size = ZSTD_findFrameCompressedSize(frame, left);
+    if (ZSTD_isError(compressed_size))
+    {
+      throw zstd_error("frame at " + std::to_string(offset) + ": " +
+                       ZSTD_getErrorName(compressed_size));
+    }
+
+    if (left < 4 || (read_le32(frame) & SKIPPABLE_MAGIC_MASK) != SKIPPABLE_MAGIC)
+    {
+      unsigned long long decompressed_size =
+          ZSTD_getFrameContentSize(frame, left);
+      if (decompressed_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+          decompressed_size == ZSTD_CONTENTSIZE_ERROR)
+      {
+        throw zstd_error("frame at " + std::to_string(offset) +
+                         " doesn't record its decompressed size");
+      }
+      add_frame(offset, compressed_size, decompressed_size);
+    }
+    offset += compressed_size;
+  }
+}
+
+size_t ZstdImage::frame_at(uint64_t offset) const
+{
+  size_t low = 0;
+  size_t high = frames.size();
+  while (high - low > 1)
+  {
+    size_t mid = low + (high - low) / 2;
+    if (frames[mid].decompressed_offset <= offset)
+    {
+      low = mid;
+    }
+    else
+    {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+ZstdImage::Chunk ZstdImage::decompress(size_t index) const
+{
+  if (thread_dctx == nullptr)
+  {
+    thread_dctx.reset(ZSTD_createDCtx());
+    if (thread_dctx == nullptr)
+    {
+      throw ghidra::LowlevelError("Unable to create a zstd context");
+    }
+  }
+
+  const Frame &frame = frames[index];
+  std::shared_ptr<std::vector<uint8_t>> out(
+      new std::vector<uint8_t>(frame.decompressed_size));
+  size_t written = ZSTD_decompressDCtx(
+      thread_dctx.get(), out->data(), out->size(),
+      file.data + frame.compressed_offset, frame.compressed_size);
+  if (ZSTD_isError(written) || written != frame.decompressed_size)
+  {
+    throw zstd_error("frame at " + std::to_string(frame.compressed_offset) +
+                     " doesn't decompress");
+  }
+  return out;
+}
+
+/** \brief the decompressed bytes of frame `index`, out of the cache if it
+ * is there
+ */
+ZstdImage::Chunk ZstdImage::chunk(size_t index)
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = cached.find(index);
+    if (found != cached.end())
+    {
+      hits++;
+      lru.splice(lru.begin(), lru, found->second);
+      return found->second->second;
+    }
+  }
+
+  // decompressed without the lock, two threads missing on the same frame
+  // at once just both decompress it
+  misses++;
+  Chunk data = decompress(index);
+
+  std::lock_guard<std::mutex> guard(lock);
+  if (cached.find(index) == cached.end())
+  {
+    lru.emplace_front(index, data);
+    cached[index] = lru.begin();
+    if (lru.size() > capacity)
+    {
+      cached.erase(lru.back().first);
+      lru.pop_back();
+    }
+  }
+  return data;
+}
+
+void ZstdImage::read(uint64_t offset, uint8_t *out, uint64_t count)
+{
+  while (count > 0)
+  {
+    size_t index = frame_at(offset);
+    if (last_chunk.image != id || last_chunk.frame != index ||
+        last_chunk.data == nullptr)
+    {
+      last_chunk.data = chunk(index);
+      last_chunk.image = id;
+      last_chunk.frame = index;
+    }
+
+    const Frame &frame = frames[index];
+    uint64_t start = offset - frame.decompressed_offset;
+    uint64_t piece = std::min<uint64_t>(count, frame.decompressed_size - start);
+    memcpy(out, last_chunk.data->data() + start, piece);
+    out += piece;
+    offset += piece;
+    count -= piece;
+  }
+}
+
+bool ZstdImage::detect(const uint8_t *data, size_t size)
+{
+  return size >= 4 && read_le32(data) == ZSTD_MAGICNUMBER;
+}
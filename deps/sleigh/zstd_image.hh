@@ -0,0 +1,113 @@
+/// \file zstd_image.hh
+/// \brief Images read lazily out of a zstd file of independent frames
+///
+/// A firmware image stored as zstd doesn't have to be decompressed to disk
+/// before it can be lifted, as long as it was compressed into independent
+/// frames (the zstd seekable format, `pzstd`, or simply concatenating the
+/// compressed pieces of the image). A `ZstdImage` maps the compressed file,
+/// indexes where every frame starts in both the compressed and decompressed
+/// bytes, and `read` only decompresses the frames a read touches. The last
+/// `ZSTD_IMAGE_CACHE_CHUNKS` frames decompressed are kept around, so memory
+/// stays bounded whatever the size of the image.
+///
+/// The index comes from the seek table of the seekable format if the file
+/// ends with one, otherwise from walking the frame headers, which then all
+/// have to record their decompressed size (`zstd` always writes it).
+#ifndef __ZSTD_IMAGE_HH__
+#define __ZSTD_IMAGE_HH__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.hh"
+
+/// Decompressed frames kept by every `ZstdImage`
+#define ZSTD_IMAGE_CACHE_CHUNKS 32
+
+/// Largest decompressed frame accepted, so a single frame can't undo the
+/// bound on memory
+#define ZSTD_IMAGE_MAX_FRAME (16 << 20)
+
+/**
+ * \brief the decompressed bytes of a zstd file, read a frame at a time.
+ * Safe to read from any number of threads at once.
+ */
+class ZstdImage
+{
+  struct Frame
+  {
+    uint64_t compressed_offset;
+    uint64_t decompressed_offset;
+    uint32_t compressed_size;
+    uint32_t decompressed_size;
+  };
+
+  typedef std::shared_ptr<const std::vector<uint8_t>> Chunk;
+
+  MappedFile file;
+  // ordered by both offsets
+  std::vector<Frame> frames;
+  uint64_t total = 0;
+  // told apart from every other image by the per-thread last chunk, which
+  // could otherwise be fooled by an image allocated where a freed one was
+  uint64_t id;
+
+  std::mutex lock;
+  // most recently used first
+  std::list<std::pair<size_t, Chunk>> lru;
+  std::unordered_map<size_t, std::list<std::pair<size_t, Chunk>>::iterator>
+      cached;
+  size_t capacity;
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> misses;
+
+  bool read_seek_table(void);
+  void scan_frames(void);
+  void add_frame(uint64_t compressed_offset, uint64_t compressed_size,
+                 uint64_t decompressed_size);
+  size_t frame_at(uint64_t offset) const;
+  Chunk decompress(size_t frame) const;
+  Chunk chunk(size_t frame);
+
+public:
+  /**
+   * \brief maps and indexes the zstd file at `path`, throws
+   * `ghidra::LowlevelError` if it can't be mapped or isn't made of frames
+   * this can read independently
+   */
+  explicit ZstdImage(const char *path,
+                     size_t cache_chunks = ZSTD_IMAGE_CACHE_CHUNKS);
+
+  /** \brief decompressed size of the whole image */
+  uint64_t size(void) const { return total; }
+
+  /**
+   * \brief copies `count` decompressed bytes at `offset` into `out`, which
+   * must be in the image. Throws `ghidra::LowlevelError` on a corrupt frame.
+   */
+  void read(uint64_t offset, uint8_t *out, uint64_t count);
+
+  /** \brief the compressed file, as mapped */
+  const uint8_t *compressed_data(void) const { return file.data; }
+  uint64_t compressed_size(void) const { return file.size; }
+
+  /** \brief frames found in / decompressed into the cache so far */
+  uint64_t cache_hits(void) const { return hits; }
+  uint64_t cache_misses(void) const { return misses; }
+
+  /** \brief true if `data` starts with a zstd frame */
+  static bool detect(const uint8_t *data, size_t size);
+
+private:
+  ZstdImage(const ZstdImage &);
+  ZstdImage &operator=(const ZstdImage &);
+};
+
+#endif
@@ -3,27 +3,72 @@
 //@category Iteration
 //@author lockbox
 
+import java.io.BufferedOutputStream;
 import java.io.File;
-import java.io.FileWriter;
+import java.io.FileOutputStream;
 import java.io.IOException;
+import java.io.OutputStream;
+import java.math.BigInteger;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.nio.charset.StandardCharsets;
-
-import com.google.gson.*;
-import com.google.gson.stream.JsonWriter;
+import java.util.ArrayList;
+import java.util.List;
 
 import ghidra.app.script.GhidraScript;
 import ghidra.util.exception.CancelledException;
+import ghidra.program.model.address.AddressRange;
+import ghidra.program.model.address.AddressRangeIterator;
+import ghidra.program.model.address.AddressSpace;
+import ghidra.program.model.lang.Register;
 import ghidra.program.model.listing.Function;
 import ghidra.program.model.listing.FunctionIterator;
 import ghidra.program.model.listing.Listing;
+import ghidra.program.model.listing.ProgramContext;
 import ghidra.program.model.mem.Memory;
 import ghidra.program.model.mem.MemoryAccessException;
+import ghidra.program.model.mem.MemoryBlock;
 
+// Writes the binary dump described in `src/shard/ghidra_dump.zig`: a header,
+// a table of the initialized memory blocks, a table of the functions, a table
+// of the context variable ranges (eg. `TMode` over Thumb code), their names
+// and then the bytes of every block, each starting on its own page so the
+// dump can be mapped and handed to SLEIGH as is.
 public class IterateAndDumpFunctionsList extends GhidraScript {
 
-	public static final String NAME = "name";
-	public static final String BASE_ADDRESS = "base_address";
-	public static final String DATA = "data";
+	// must match `src/shard/ghidra_dump.zig`
+	private static final byte[] DUMP_MAGIC = { 'S', 'F', 'D', 'U', 'M', 'P', 0, 1 };
+	private static final int DUMP_BYTE_ORDER = 0x01020304;
+	private static final long DUMP_PAGE_SIZE = 0x1000;
+	private static final int HEADER_SIZE = 40;
+	private static final int REGION_SIZE = 40;
+	private static final int FUNCTION_SIZE = 24;
+	private static final int CONTEXT_SIZE = 32;
+
+	private static final int PERM_READ = 1 << 0;
+	private static final int PERM_WRITE = 1 << 1;
+	private static final int PERM_EXECUTE = 1 << 2;
+
+	private static class DumpRegion {
+		byte[] name;
+		long baseAddress;
+		int permissions;
+		byte[] data;
+		long dataOffset;
+	}
+
+	private static class DumpFunction {
+		byte[] name;
+		long entry;
+		long size;
+	}
+
+	private static class DumpContext {
+		byte[] name;
+		long start;
+		long end;
+		int value;
+	}
 
 	@Override
 	public void run() throws Exception {
@@ -36,59 +81,176 @@ public class IterateAndDumpFunctionsList extends GhidraScript {
 
 	}
 
-	// copied from https://stackoverflow.com/questions/9655181/how-to-convert-a-byte-array-to-a-hex-string-in-java
-	private static final byte[] HEX_ARRAY = "0123456789ABCDEF".getBytes(StandardCharsets.US_ASCII);
-	public static String bytesToHex(byte[] bytes) {
-	    byte[] hexChars = new byte[bytes.length * 2];
-	    for (int j = 0; j < bytes.length; j++) {
-	        int v = bytes[j] & 0xFF;
-	        hexChars[j * 2] = HEX_ARRAY[v >>> 4];
-	        hexChars[j * 2 + 1] = HEX_ARRAY[v & 0x0F];
-	    }
-	    return new String(hexChars, StandardCharsets.UTF_8);
+	private static long alignForward(long value) {
+		return (value + DUMP_PAGE_SIZE - 1) & ~(DUMP_PAGE_SIZE - 1);
 	}
-	// end copy
 
-	private void dumpFunctions(File out) {
-		Gson gson = new GsonBuilder().setPrettyPrinting().create();
+	private List<DumpRegion> collectRegions(Memory memory) throws MemoryAccessException {
+		List<DumpRegion> regions = new ArrayList<>();
+		for (MemoryBlock block : memory.getBlocks()) {
+			if (!block.isInitialized() || !block.isLoaded()) {
+				continue;
+			}
+			if (block.getSize() > Integer.MAX_VALUE) {
+				println("!!! Warning: skipping memory block " + block.getName() + ", it is over 2GB");
+				continue;
+			}
 
-		try {
-			// initialize the writer
-			JsonWriter jsonWriter = new JsonWriter(new FileWriter(out));
-			jsonWriter.beginArray();
-
-			Listing listing = currentProgram.getListing();
-			FunctionIterator iter = listing.getFunctions(true);
-			while (iter.hasNext() && !monitor.isCancelled()) {
-				Function f = iter.next();
-
-				// build the properties for each object we're going to write
-				// for the emitted functions
-				String name = f.getName();
-				long entry = f.getEntryPoint().getUnsignedOffset();
-				// +1 because the "max unsigned offset" is the address of the last byte
-				long max_address = f.getBody().getMaxAddress().getUnsignedOffset() + 1;
-				long size = max_address - f.getBody().getMinAddress().getUnsignedOffset();
-				Memory memory = currentProgram.getMemory();
-				byte[] function_bytes = new byte[(int) size];
-
-				// get the actual function bytes
-				int count = memory.getBytes(f.getEntryPoint(), function_bytes);
-				if (count != size) {
-					println("!!! Warning: only read " + count + " bytes from memory instead of the requested" + size);
+			DumpRegion region = new DumpRegion();
+			region.name = block.getName().getBytes(StandardCharsets.UTF_8);
+			region.baseAddress = block.getStart().getUnsignedOffset();
+			region.permissions = (block.isRead() ? PERM_READ : 0) | (block.isWrite() ? PERM_WRITE : 0)
+					| (block.isExecute() ? PERM_EXECUTE : 0);
+			region.data = new byte[(int) block.getSize()];
+			int count = block.getBytes(block.getStart(), region.data);
+			if (count != region.data.length) {
+				println("!!! Warning: only read " + count + " bytes of memory block " + block.getName());
+			}
+			regions.add(region);
+		}
+		return regions;
+	}
+
+	private List<DumpFunction> collectFunctions() {
+		List<DumpFunction> functions = new ArrayList<>();
+		Listing listing = currentProgram.getListing();
+		FunctionIterator iter = listing.getFunctions(true);
+		while (iter.hasNext() && !monitor.isCancelled()) {
+			Function f = iter.next();
+
+			DumpFunction function = new DumpFunction();
+			function.name = f.getName().getBytes(StandardCharsets.UTF_8);
+			function.entry = f.getEntryPoint().getUnsignedOffset();
+			// +1 because the "max unsigned offset" is the address of the last byte
+			long max_address = f.getBody().getMaxAddress().getUnsignedOffset() + 1;
+			function.size = max_address - f.getBody().getMinAddress().getUnsignedOffset();
+			functions.add(function);
+		}
+		return functions;
+	}
+
+	// every range of the code space a field of the context register was set
+	// over, SLEIGH picks the mode of mixed mode code out of them
+	private List<DumpContext> collectContexts() {
+		List<DumpContext> contexts = new ArrayList<>();
+		ProgramContext programContext = currentProgram.getProgramContext();
+		AddressSpace codeSpace = currentProgram.getAddressFactory().getDefaultAddressSpace();
+		for (Register register : programContext.getContextRegisters()) {
+			if (register.isBaseRegister()) {
+				continue;
+			}
+			AddressRangeIterator ranges = programContext.getRegisterValueAddressRanges(register);
+			while (ranges.hasNext() && !monitor.isCancelled()) {
+				AddressRange range = ranges.next();
+				if (!range.getAddressSpace().equals(codeSpace)) {
+					continue;
+				}
+				BigInteger value = programContext.getValue(register, range.getMinAddress(), false);
+				if (value == null) {
+					continue;
 				}
 
-				JsonObject json = new JsonObject();
-				json.addProperty(NAME, name);
-				json.addProperty(BASE_ADDRESS, entry);
-				json.addProperty(DATA, bytesToHex(function_bytes));
+				DumpContext context = new DumpContext();
+				context.name = register.getName().getBytes(StandardCharsets.UTF_8);
+				context.start = range.getMinAddress().getUnsignedOffset();
+				context.end = range.getMaxAddress().getUnsignedOffset() + 1;
+				context.value = value.intValue();
+				contexts.add(context);
+			}
+		}
+		return contexts;
+	}
 
-				gson.toJson(json, jsonWriter);
+	private void dumpFunctions(File out) {
+		try {
+			List<DumpRegion> regions = collectRegions(currentProgram.getMemory());
+			List<DumpFunction> functions = collectFunctions();
+			List<DumpContext> contexts = collectContexts();
+
+			// lay everything out before writing anything
+			long stringsOffset = HEADER_SIZE + (long) regions.size() * REGION_SIZE
+					+ (long) functions.size() * FUNCTION_SIZE + (long) contexts.size() * CONTEXT_SIZE;
+			long stringsSize = 0;
+			for (DumpRegion region : regions) {
+				stringsSize += region.name.length;
+			}
+			for (DumpFunction function : functions) {
+				stringsSize += function.name.length;
+			}
+			for (DumpContext context : contexts) {
+				stringsSize += context.name.length;
 			}
+			long dataOffset = alignForward(stringsOffset + stringsSize);
+			for (DumpRegion region : regions) {
+				region.dataOffset = dataOffset;
+				dataOffset = alignForward(dataOffset + region.data.length);
+			}
+
+			try (OutputStream stream = new BufferedOutputStream(new FileOutputStream(out))) {
+				ByteBuffer header = ByteBuffer.allocate(HEADER_SIZE).order(ByteOrder.LITTLE_ENDIAN);
+				header.put(DUMP_MAGIC);
+				header.putInt(DUMP_BYTE_ORDER);
+				header.putInt(regions.size());
+				header.putInt(functions.size());
+				header.putInt(contexts.size());
+				header.putLong(stringsOffset);
+				header.putLong(stringsSize);
+				stream.write(header.array());
 
-			jsonWriter.endArray();
-			jsonWriter.close();
+				int nameOffset = 0;
+				for (DumpRegion region : regions) {
+					ByteBuffer entry = ByteBuffer.allocate(REGION_SIZE).order(ByteOrder.LITTLE_ENDIAN);
+					entry.putLong(region.baseAddress);
+					entry.putLong(region.data.length);
+					entry.putLong(region.dataOffset);
+					entry.putInt(nameOffset);
+					entry.putInt(region.name.length);
+					entry.putInt(region.permissions);
+					entry.putInt(0);
+					stream.write(entry.array());
+					nameOffset += region.name.length;
+				}
+				for (DumpFunction function : functions) {
+					ByteBuffer entry = ByteBuffer.allocate(FUNCTION_SIZE).order(ByteOrder.LITTLE_ENDIAN);
+					entry.putLong(function.entry);
+					entry.putLong(function.size);
+					entry.putInt(nameOffset);
+					entry.putInt(function.name.length);
+					stream.write(entry.array());
+					nameOffset += function.name.length;
+				}
+				for (DumpContext context : contexts) {
+					ByteBuffer entry = ByteBuffer.allocate(CONTEXT_SIZE).order(ByteOrder.LITTLE_ENDIAN);
+					entry.putLong(context.start);
+					entry.putLong(context.end);
+					entry.putInt(context.value);
+					entry.putInt(nameOffset);
+					entry.putInt(context.name.length);
+					entry.putInt(0);
+					stream.write(entry.array());
+					nameOffset += context.name.length;
+				}
+
+				for (DumpRegion region : regions) {
+					stream.write(region.name);
+				}
+				for (DumpFunction function : functions) {
+					stream.write(function.name);
+				}
+				for (DumpContext context : contexts) {
+					stream.write(context.name);
+				}
+
+				long written = stringsOffset + stringsSize;
+				for (DumpRegion region : regions) {
+					stream.write(new byte[(int) (region.dataOffset - written)]);
+					stream.write(region.data);
+					written = region.dataOffset + region.data.length;
+				}
+			}
 
+			println("Dumped " + regions.size() + " memory blocks, " + functions.size() + " functions and "
+					+ contexts.size() + " context ranges");
 		} catch (IOException e) {
 			println("!!! failed to write to file provided: " + out);
 		} catch (MemoryAccessException e) {
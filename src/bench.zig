@@ -0,0 +1,422 @@
+//! # `bench`
+//!
+//! Lift throughput of every spec in `specfiles/` over the executable
+//! segment of each sample input, printed to stdout as one JSON document so
+//! runs can be diffed for regressions. Progress goes to stderr.
+//!
+//! ```sh
+//! zig build bench -Doptimize=ReleaseFast > bench.json
+//! zig build bench -- --bytes 0x100000 x86-64 riscv
+//! zig build bench -- --input zig-out/bin/struct.foo x86-64.sla
+//! ```
+//!
+//! Every positional argument filters the specs down to those whose file name
+//! contains it. `--bytes` caps how much of each segment is lifted and
+//! `--input` replaces the sample inputs (repeat it for more than one).
+//!
+//! For each spec this records how long `add_specfile` and `begin` take, then
+//! lifts each input twice with `lift_range` and the decode cache + intern
+//! table off (so the second pass decodes everything again): the
+//! first pass is reported as `first_lift_ns`, the second is the steady state
+//! the per second + per instruction numbers come from. Allocations are
+//! counted by the `operator new` of libsla, which this binary is built with.
+//! Every input is lifted with every spec, so most pairs measure how fast a
+//! spec gets through bytes that aren't its own.
+//!
+//! When `FLOAT_SPEC` is picked, `floats` times its emulator running a loop
+//! of float arithmetic twice: once converting the binary32 + binary64
+//! formats by reinterpreting host floats and once field by field (see
+//! `SleighSpec.set_host_floats()`). The two runs must end with the same
+//! registers.
+const std = @import("std");
+
+const sleigh = @import("sleigh.zig");
+
+const logger = std.log.scoped(.bench);
+
+/// Where the specs are read from, relative to the working directory
+const SPECFILES_PATH = "specfiles";
+
+/// Sample inputs lifted by every spec unless `--input` is given
+const DEFAULT_INPUTS = [_][]const u8{
+    "input-files/hello-world-static-riscv64le",
+    "input-files/leon3-sparc32-rtems/core-cpu1.exe",
+};
+
+/// Default cap on the bytes lifted from each input
+const DEFAULT_MAX_BYTES: u64 = 0x40000;
+
+/// Spec the float benchmark emulates `FLOAT_LOOP` with
+const FLOAT_SPEC = "riscv.lp64d.sla";
+
+/// Where `FLOAT_LOOP` is loaded
+const FLOAT_ADDRESS: u64 = 0x1000;
+
+/// RV64 loop of binary64 + binary32 arithmetic, conversions between them
+/// and a compare, jumping back to its start forever:
+/// `fadd.d fmul.d fdiv.d fsqrt.d fcvt.s.d fadd.s fmul.s fcvt.d.s flt.d j`
+const FLOAT_LOOP = [_]u8{
+    0x53, 0x75, 0xb5, 0x02, 0x53, 0x76, 0xb5, 0x12,
+    0xd3, 0x76, 0xa6, 0x1a, 0x53, 0xf7, 0x06, 0x5a,
+    0xd3, 0x77, 0x17, 0x40, 0x53, 0xf8, 0xf7, 0x00,
+    0xd3, 0x78, 0xf8, 0x10, 0x53, 0x80, 0x08, 0x42,
+    0xd3, 0x12, 0xa0, 0xa2, 0x6f, 0xf0, 0xdf, 0xfd,
+};
+
+/// Registers the float loop reads, with their starting values
+const FLOAT_INPUTS = [_]struct { name: [:0]const u8, value: f64 }{
+    .{ .name = "fa0", .value = 1.0 },
+    .{ .name = "fa1", .value = 1.0000001 },
+};
+
+/// Registers compared between the two float runs
+const FLOAT_OUTPUTS = [_][:0]const u8{ "fa0", "fa4", "fa7", "ft0", "t0" };
+
+/// Instructions emulated by each float run
+const FLOAT_INSNS: u64 = 2_000_000;
+
+/// The first executable segment of an input, truncated to the byte cap
+const Input = struct {
+    path: []const u8,
+    address: u64,
+    bytes: u64,
+    data: []const u8,
+};
+
+/// One input lifted with one spec
+const LiftResult = struct {
+    input: []const u8,
+    insns: u64 = 0,
+    ops: u64 = 0,
+    first_lift_ns: u64 = 0,
+    lift_ns: u64 = 0,
+    insns_per_sec: f64 = 0,
+    ops_per_sec: f64 = 0,
+    allocs_per_insn: ?f64 = null,
+    alloc_bytes_per_insn: ?f64 = null,
+    @"error": ?[]const u8 = null,
+};
+
+/// Everything measured for one spec
+const SpecResult = struct {
+    spec: []const u8,
+    load_ns: u64 = 0,
+    begin_ns: u64 = 0,
+    @"error": ?[]const u8 = null,
+    lifts: []const LiftResult = &.{},
+};
+
+/// One run of the float loop
+const FloatRun = struct {
+    insns: u64 = 0,
+    emulate_ns: u64 = 0,
+    insns_per_sec: f64 = 0,
+};
+
+/// The float loop with host conversions vs the generic ones
+const FloatResult = struct {
+    spec: []const u8 = FLOAT_SPEC,
+    host: FloatRun = .{},
+    generic: FloatRun = .{},
+    /// generic time over host time
+    speedup: f64 = 0,
+    @"error": ?[]const u8 = null,
+};
+
+/// Where an input was lifted from, without its bytes
+const InputSummary = struct {
+    path: []const u8,
+    address: u64,
+    bytes: u64,
+};
+
+const Report = struct {
+    max_bytes: u64,
+    inputs: []const InputSummary,
+    specs: []const SpecResult,
+    floats: ?FloatResult,
+};
+
+/// Reads the first executable `PT_LOAD` segment of the ELF at `path`, at
+/// most `max_bytes` of it
+fn load_input(allocator: std.mem.Allocator, path: []const u8, max_bytes: u64) !Input {
+    const file = try std.fs.cwd().openFile(path, .{});
+    defer file.close();
+
+    const header = try std.elf.Header.read(file);
+    var it = header.program_header_iterator(file);
+    while (try it.next()) |phdr| {
+        if (phdr.p_type != std.elf.PT_LOAD or (phdr.p_flags & std.elf.PF_X) == 0) {
+            continue;
+        }
+
+        const size = @min(phdr.p_filesz, max_bytes);
+        const data = try allocator.alloc(u8, size);
+        if (try file.preadAll(data, phdr.p_offset) != size) {
+            return error.EndOfStream;
+        }
+
+        return Input{ .path = path, .address = phdr.p_vaddr, .bytes = size, .data = data };
+    }
+
+    return error.NoExecutableSegment;
+}
+
+/// Whether the spec file `name` is picked by `filters`
+fn matches(name: []const u8, filters: []const []const u8) bool {
+    if (filters.len == 0) {
+        return true;
+    }
+
+    for (filters) |filter| {
+        if (std.mem.indexOf(u8, name, filter) != null) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Every `.sla` in `SPECFILES_PATH` whose name contains one of `filters`
+/// (or all of them with no filters), sorted by name
+fn find_specs(allocator: std.mem.Allocator, filters: []const []const u8) ![]const []const u8 {
+    var specs = std.ArrayList([]const u8).init(allocator);
+
+    var dir = try std.fs.cwd().openDir(SPECFILES_PATH, .{ .iterate = true });
+    defer dir.close();
+
+    var it = dir.iterate();
+    while (try it.next()) |entry| {
+        if (entry.kind != .file or !std.mem.endsWith(u8, entry.name, ".sla")) {
+            continue;
+        }
+
+        if (matches(entry.name, filters)) {
+            try specs.append(try allocator.dupe(u8, entry.name));
+        }
+    }
+
+    const names = try specs.toOwnedSlice();
+    std.mem.sort([]const u8, names, {}, struct {
+        fn lessThan(_: void, lhs: []const u8, rhs: []const u8) bool {
+            return std.mem.lessThan(u8, lhs, rhs);
+        }
+    }.lessThan);
+    return names;
+}
+
+/// `count` per second over `ns` nanoseconds
+fn per_second(count: u64, ns: u64) f64 {
+    if (ns == 0) {
+        return 0;
+    }
+    return @as(f64, @floatFromInt(count)) * std.time.ns_per_s / @as(f64, @floatFromInt(ns));
+}
+
+/// `total` per instruction, `null` if nothing was lifted
+fn per_insn(total: u64, insns: u64) ?f64 {
+    if (insns == 0) {
+        return null;
+    }
+    return @as(f64, @floatFromInt(total)) / @as(f64, @floatFromInt(insns));
+}
+
+/// Lifts `input` with the already started `state`, see the file docs
+fn bench_lift(state: *sleigh.SleighState, input: *const Input) LiftResult {
+    var result = LiftResult{ .input = input.path };
+    const end = input.address + input.bytes;
+
+    var timer = std.time.Timer.start() catch unreachable;
+    var first = sleigh.LiftedRange{};
+    state.lift_range(input.address, end, &first) catch |err| {
+        result.@"error" = @errorName(err);
+        return result;
+    };
+    result.first_lift_ns = timer.read();
+    state.release_range(&first);
+
+    const allocs_before = sleigh.AllocationStats.read();
+    timer.reset();
+    var range = sleigh.LiftedRange{};
+    state.lift_range(input.address, end, &range) catch |err| {
+        result.@"error" = @errorName(err);
+        return result;
+    };
+    result.lift_ns = timer.read();
+    const allocs_after = sleigh.AllocationStats.read();
+
+    result.insns = range.insn_count;
+    // not `range.op_count`, repeated encodings share their rows
+    for (range.insns()) |insn| {
+        result.ops += insn.op_count;
+    }
+    state.release_range(&range);
+
+    result.insns_per_sec = per_second(result.insns, result.lift_ns);
+    result.ops_per_sec = per_second(result.ops, result.lift_ns);
+    if (allocs_before != null and allocs_after != null) {
+        result.allocs_per_insn = per_insn(allocs_after.?.count - allocs_before.?.count, result.insns);
+        result.alloc_bytes_per_insn = per_insn(allocs_after.?.bytes - allocs_before.?.bytes, result.insns);
+    }
+
+    return result;
+}
+
+fn bench_spec(allocator: std.mem.Allocator, name: []const u8, inputs: []const Input) !SpecResult {
+    var result = SpecResult{ .spec = name };
+    const path = try std.fmt.allocPrintZ(allocator, "{s}/{s}", .{ SPECFILES_PATH, name });
+
+    var timer = try std.time.Timer.start();
+    var state = sleigh.SleighState.init();
+    defer state.deinit();
+
+    state.add_specfile(path) catch |err| {
+        result.@"error" = @errorName(err);
+        return result;
+    };
+    result.load_ns = timer.lap();
+
+    state.begin();
+    result.begin_ns = timer.lap();
+
+    state.set_decode_cache(0);
+    state.set_insn_intern(0);
+    for (inputs) |*input| {
+        try state.load_data(input.address, input.data);
+    }
+
+    const lifts = try allocator.alloc(LiftResult, inputs.len);
+    for (inputs, lifts) |*input, *lift| {
+        lift.* = bench_lift(&state, input);
+    }
+    result.lifts = lifts;
+
+    return result;
+}
+
+/// Emulates `FLOAT_INSNS` of the float loop with a fresh load of
+/// `FLOAT_SPEC`, host conversions on or off, the final registers go to
+/// `outputs`
+fn bench_float_run(host_floats: bool, outputs: *[FLOAT_OUTPUTS.len]u64) !FloatRun {
+    sleigh.SleighSpec.set_host_floats(host_floats);
+    // formats of specs loaded later should be the default again
+    defer sleigh.SleighSpec.set_host_floats(true);
+
+    var state = sleigh.SleighState.init();
+    defer state.deinit();
+    try state.add_specfile(SPECFILES_PATH ++ "/" ++ FLOAT_SPEC);
+    state.begin();
+    try state.load_data(FLOAT_ADDRESS, &FLOAT_LOOP);
+
+    // once around the loop first, so the timed run doesn't translate it
+    _ = try state.emulate_run(FLOAT_ADDRESS, FLOAT_LOOP.len / 4);
+    for (FLOAT_INPUTS) |input| {
+        try state.emulate_set_register(input.name, @bitCast(input.value));
+    }
+
+    var timer = try std.time.Timer.start();
+    const result = try state.emulate_run(FLOAT_ADDRESS, FLOAT_INSNS);
+    const ns = timer.read();
+    if (result.stop != .InsnLimit) {
+        return error.FloatLoopStopped;
+    }
+
+    for (FLOAT_OUTPUTS, outputs) |name, *output| {
+        output.* = try state.emulate_get_register(name);
+    }
+    return FloatRun{
+        .insns = result.insn_count,
+        .emulate_ns = ns,
+        .insns_per_sec = per_second(result.insn_count, ns),
+    };
+}
+
+/// See the file docs
+fn bench_floats() FloatResult {
+    var result = FloatResult{};
+    var host_outputs: [FLOAT_OUTPUTS.len]u64 = undefined;
+    var generic_outputs: [FLOAT_OUTPUTS.len]u64 = undefined;
+
+    result.host = bench_float_run(true, &host_outputs) catch |err| {
+        result.@"error" = @errorName(err);
+        return result;
+    };
+    result.generic = bench_float_run(false, &generic_outputs) catch |err| {
+        result.@"error" = @errorName(err);
+        return result;
+    };
+
+    if (!std.mem.eql(u64, &host_outputs, &generic_outputs)) {
+        result.@"error" = "FloatResultsDiffer";
+    }
+    if (result.host.emulate_ns != 0) {
+        result.speedup = @as(f64, @floatFromInt(result.generic.emulate_ns)) / @as(f64, @floatFromInt(result.host.emulate_ns));
+    }
+    return result;
+}
+
+pub fn main() !void {
+    var arena = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    var max_bytes = DEFAULT_MAX_BYTES;
+    var input_paths = std.ArrayList([]const u8).init(allocator);
+    var filters = std.ArrayList([]const u8).init(allocator);
+
+    const args = try std.process.argsAlloc(allocator);
+    var idx: usize = 1;
+    while (idx < args.len) : (idx += 1) {
+        const arg = args[idx];
+        if (std.mem.eql(u8, arg, "--bytes") or std.mem.eql(u8, arg, "--input")) {
+            idx += 1;
+            if (idx == args.len) {
+                logger.err("`{s}` needs a value", .{arg});
+                return error.InvalidArguments;
+            }
+
+            if (std.mem.eql(u8, arg, "--bytes")) {
+                max_bytes = try std.fmt.parseInt(u64, args[idx], 0);
+            } else {
+                try input_paths.append(args[idx]);
+            }
+        } else {
+            try filters.append(arg);
+        }
+    }
+
+    if (input_paths.items.len == 0) {
+        try input_paths.appendSlice(&DEFAULT_INPUTS);
+    }
+
+    const inputs = try allocator.alloc(Input, input_paths.items.len);
+    for (input_paths.items, inputs) |path, *input| {
+        input.* = load_input(allocator, path, max_bytes) catch |err| {
+            logger.err("Failed to load `{s}`: {}", .{ path, err });
+            return err;
+        };
+    }
+
+    const specs = try find_specs(allocator, filters.items);
+    const results = try allocator.alloc(SpecResult, specs.len);
+    for (specs, results) |name, *result| {
+        logger.info("Benchmarking `{s}`", .{name});
+        result.* = try bench_spec(allocator, name, inputs);
+    }
+
+    var floats: ?FloatResult = null;
+    if (matches(FLOAT_SPEC, filters.items)) {
+        logger.info("Benchmarking float ops of `{s}`", .{FLOAT_SPEC});
+        floats = bench_floats();
+    }
+
+    const summaries = try allocator.alloc(InputSummary, inputs.len);
+    for (inputs, summaries) |input, *summary| {
+        summary.* = .{ .path = input.path, .address = input.address, .bytes = input.bytes };
+    }
+
+    const report = Report{ .max_bytes = max_bytes, .inputs = summaries, .specs = results, .floats = floats };
+    var buffered = std.io.bufferedWriter(std.io.getStdOut().writer());
+    try std.json.stringify(report, .{ .whitespace = .indent_2 }, buffered.writer());
+    try buffered.writer().writeByte('\n');
+    try buffered.flush();
+}
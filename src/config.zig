@@ -20,6 +20,15 @@ pub const StructFooInputMode = enum {
     dump,
 };
 
+/// A context variable set to `value` over `[start, end)` of the target
+/// only, eg. `TMode` over the Thumb functions of an ARM image
+pub const StructFooContextRegion = struct {
+    variable: []const u8,
+    start: u64,
+    end: u64,
+    value: u64,
+};
+
 /// Loads configuration from command line flags and
 /// configuration `json` files to expedite things.
 ///
@@ -38,6 +47,33 @@ pub const StructFooConfig = struct {
     alignment: usize = 2,
     /// Default base address
     base_address: u64 = 0,
+    /// Context variables set over address ranges, on top of the pspec's
+    context_regions: []StructFooContextRegion = &.{},
+    /// Number of threads used for lifting
+    threads: usize = 1,
+    /// Pin the lifting threads to NUMA nodes, their memory placed on them
+    numa: bool = false,
+    /// Back the lift arenas + the image with 2MB huge pages
+    huge_pages: bool = false,
+    /// Directory of the on-disk lift cache, empty to always lift
+    cache_dir: []u8 = &.{},
+    /// Cache the lifts by content defined chunks, so other images holding
+    /// the same code hit them too
+    content_chunks: bool = false,
+    /// Directory of the persistent gadget index, empty to not index
+    index_dir: []u8 = &.{},
+    /// Search for gadgets while lifting instead of after
+    stream: bool = false,
+    /// Decode only the windows before gadget ending instructions
+    anchored: bool = false,
+    /// Decode at every aligned offset, not just after the last instruction
+    all_offsets: bool = false,
+    /// Only decode the code reachable from the entry point + dumped functions
+    reachable: bool = false,
+    /// Lift p-code only, disassembling just the gadgets that are found
+    pcode_only: bool = false,
+    /// Fold the `unique` temporaries out of the lifted p-code
+    simplify: bool = false,
     /// Enable debug mode
     debug: bool = false,
     /// Action to perform
@@ -96,6 +132,78 @@ pub const StructFooConfig = struct {
         self.alignment = value;
     }
 
+    /// Set whether gadgets are searched for while lifting
+    pub fn set_stream(self: *Self, value: bool) void {
+        self.stream = value;
+    }
+
+    /// Set whether gadgets are searched for backwards from their anchors
+    pub fn set_anchored(self: *Self, value: bool) void {
+        self.anchored = value;
+    }
+
+    /// Set whether every aligned offset is decoded
+    pub fn set_all_offsets(self: *Self, value: bool) void {
+        self.all_offsets = value;
+    }
+
+    /// Set whether only the reachable code is decoded
+    pub fn set_reachable(self: *Self, value: bool) void {
+        self.reachable = value;
+    }
+
+    /// Set whether the lift skips the assembly text
+    pub fn set_pcode_only(self: *Self, value: bool) void {
+        self.pcode_only = value;
+    }
+
+    /// Set whether the lifted p-code gets simplified
+    pub fn set_simplify(self: *Self, value: bool) void {
+        self.simplify = value;
+    }
+
+    /// Set the number of lifting threads
+    pub fn set_threads(self: *Self, value: u64) void {
+        self.threads = value;
+    }
+
+    /// Set whether the lifting threads are placed on NUMA nodes
+    pub fn set_numa(self: *Self, value: bool) void {
+        self.numa = value;
+    }
+
+    /// Set whether the lift is backed by huge pages
+    pub fn set_huge_pages(self: *Self, value: bool) void {
+        self.huge_pages = value;
+    }
+
+    /// Set the directory of the on-disk lift cache
+    pub fn set_cache_dir(self: *Self, path: []const u8, allocator: Allocator) !void {
+        self.cache_dir = try allocator.alloc(u8, path.len);
+        @memcpy(self.cache_dir, path);
+    }
+
+    /// Set whether the lift cache is keyed by content defined chunks
+    pub fn set_content_chunks(self: *Self, value: bool) void {
+        self.content_chunks = value;
+    }
+
+    /// Set the directory of the persistent gadget index
+    pub fn set_index_dir(self: *Self, path: []const u8, allocator: Allocator) !void {
+        self.index_dir = try allocator.alloc(u8, path.len);
+        @memcpy(self.index_dir, path);
+    }
+
+    /// Set the context variables set over address ranges, the names are
+    /// copied null terminated for SLEIGH
+    pub fn set_context_regions(self: *Self, context_regions: []const StructFooContextRegion, allocator: Allocator) !void {
+        self.context_regions = try allocator.alloc(StructFooContextRegion, context_regions.len);
+        for (context_regions, self.context_regions) |region, *out| {
+            out.* = region;
+            out.variable = try allocator.dupeZ(u8, region.variable);
+        }
+    }
+
     /// Set the base address
     pub fn set_base_address(self: *Self, value: u64) void {
         self.base_address = value;
@@ -156,15 +264,37 @@ pub const StructFooConfig = struct {
         const file_contents = try std.fs.cwd().readFileAlloc(allocator, path, 16 * 1024);
         defer allocator.free(file_contents);
 
+        try self.load_json_slice(file_contents, allocator);
+    }
+
+    /// Same as `StructFooConfig.load_json()` with the json already in memory,
+    /// also takes the `root_dir` if there is one
+    pub fn load_json_slice(self: *Self, file_contents: []const u8, allocator: std.mem.Allocator) !void {
         var json_config = try json.parseFromSlice(Self, allocator, file_contents, .{});
         defer json_config.deinit();
         const parsed_config = json_config.value;
 
         self.set_alignment(parsed_config.alignment);
         self.set_base_address(parsed_config.base_address);
+        try self.set_context_regions(parsed_config.context_regions, allocator);
+        self.set_threads(parsed_config.threads);
+        self.set_numa(parsed_config.numa);
+        self.set_huge_pages(parsed_config.huge_pages);
+        self.set_stream(parsed_config.stream);
+        self.set_pcode_only(parsed_config.pcode_only);
+        self.set_simplify(parsed_config.simplify);
+        self.set_anchored(parsed_config.anchored);
+        self.set_all_offsets(parsed_config.all_offsets);
+        self.set_reachable(parsed_config.reachable);
+        try self.set_cache_dir(parsed_config.cache_dir, allocator);
+        self.set_content_chunks(parsed_config.content_chunks);
+        try self.set_index_dir(parsed_config.index_dir, allocator);
         try self.set_pspec(parsed_config.pspec, allocator);
         try self.set_sla(parsed_config.sla, allocator);
         try self.set_input_path(parsed_config.input_path, allocator);
         self.input_mode = parsed_config.input_mode;
+        if (parsed_config.root_dir.len > 0) {
+            try self.set_root_dir(parsed_config.root_dir, allocator);
+        }
     }
 };
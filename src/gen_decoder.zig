@@ -0,0 +1,32 @@
+//! # `gen-decoder`
+//!
+//! Writes the C++ source of a decoder for a `.sla`, its decision trees
+//! compiled into nested `switch`es (see `deps/sleigh/aot_decoder.hh`).
+//! `zig build` runs it over the `-Daot` specs and compiles what it writes
+//! into the binaries, nothing else needs to call it.
+//!
+//! ```sh
+//! gen-decoder specfiles/riscv.lp64d.sla riscv.lp64d.cc riscv.lp64d
+//! ```
+const std = @import("std");
+
+const sleigh = @import("sleigh.zig");
+
+const logger = std.log.scoped(.gen_decoder);
+
+pub fn main() !void {
+    var arena = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    if (args.len != 4) {
+        logger.err("usage: {s} <in.sla> <out.cc> <name>", .{args[0]});
+        return error.InvalidArguments;
+    }
+
+    sleigh.SleighSpec.gen_decoder(args[1], args[2], args[3]) catch |err| {
+        logger.err("Failed to generate the decoder of `{s}`: {}", .{ args[1], err });
+        return err;
+    };
+}
@@ -44,16 +44,51 @@ pub const NeedleGadget = struct {
     size: u64,
     /// Human readable representation of gadget
     text: []const u8,
+    /// Every register one of the instructions writes, ORed together from
+    /// their `effects` as the gadget grows. Empty for gadgets read back out
+    /// of an index or a daemon
+    writes: sleigh.EffectSet.Words = sleigh.EffectSet.empty,
+    /// How far the whole gadget moves the stack pointer, or
+    /// `sleigh.InsnEffects.SP_UNKNOWN`
+    sp_delta: i64 = sleigh.InsnEffects.SP_UNKNOWN,
 
     const Self = @This();
 
+    /// A gadget of just `insn`
+    pub fn from_insn(insn: *const ShardInsn, text: []const u8) Self {
+        return NeedleGadget{ .address = insn.base_address, .size = insn.size, .text = text, .writes = insn.effects.writes, .sp_delta = insn.effects.sp_delta };
+    }
+
+    /// Adds the register writes + stack pointer delta of `parent` to the
+    /// ones of `self`, which runs right before it
+    fn join(self: *Self, parent: *const Self) void {
+        sleigh.EffectSet.merge(&self.writes, parent.writes);
+        const unknown = sleigh.InsnEffects.SP_UNKNOWN;
+        if (self.sp_delta == unknown or parent.sp_delta == unknown) {
+            self.sp_delta = unknown;
+        } else {
+            self.sp_delta +%= parent.sp_delta;
+        }
+    }
+
     /// Given a previous gadget, combine the metadata of the provided instruciton
     /// to create....bigger gadget
     pub fn from_parent_gadget(insn: *const ShardInsn, parent: *const Self, allocator: std.mem.Allocator) !Self {
         const out_text = try std.fmt.allocPrint(allocator, "{s}; {s}", .{ insn.text, parent.text });
         const out_size = insn.size + parent.size;
         const out_address = insn.base_address;
-        return NeedleGadget{ .address = out_address, .size = out_size, .text = out_text };
+        var out = NeedleGadget{ .address = out_address, .size = out_size, .text = out_text, .writes = insn.effects.writes, .sp_delta = insn.effects.sp_delta };
+        out.join(parent);
+        return out;
+    }
+
+    /// Same as `from_parent_gadget()` for an instruction that was already
+    /// turned into a gadget of its own
+    pub fn from_parent(gadget: *const Self, parent: *const Self, allocator: std.mem.Allocator) !Self {
+        const out_text = try std.fmt.allocPrint(allocator, "{s}; {s}", .{ gadget.text, parent.text });
+        var out = NeedleGadget{ .address = gadget.address, .size = gadget.size + parent.size, .text = out_text, .writes = gadget.writes, .sp_delta = gadget.sp_delta };
+        out.join(parent);
+        return out;
     }
 };
 
@@ -72,7 +107,7 @@ pub fn find_gadgets(insns: std.ArrayList(ShardInsn), allocator: std.mem.Allocato
         // check semantic flags for easy root nodes:
         // - ret
         if (insn.summary.ret) {
-            try gadgets.append(NeedleGadget{ .address = insn.base_address, .size = insn.size, .text = try std.fmt.allocPrint(allocator, "{s}", .{insn.text}) });
+            try gadgets.append(NeedleGadget.from_insn(&insn, try std.fmt.allocPrint(allocator, "{s}", .{insn.text})));
             try root_gadget_indicies.append(idx);
         }
     }
@@ -116,6 +151,10 @@ pub fn find_gadgets(insns: std.ArrayList(ShardInsn), allocator: std.mem.Allocato
             // index of insns to check for presence of gadget or not
             const check_idx = curr_index - 1;
             const insn = insns.items[check_idx];
+            // a gap in the lift (the end of a block or region) ends the gadget
+            if (insn.base_address + insn.size != insns.items[curr_index].base_address) {
+                break;
+            }
             if (is_gadget(insn)) {
                 // add the size of this gadget to the size of the parent gadget
                 // add the text of this gadget to the text of the parent gadget
@@ -144,6 +183,193 @@ pub fn find_gadgets(insns: std.ArrayList(ShardInsn), allocator: std.mem.Allocato
     return gadgets;
 }
 
+/// Finds the same gadgets as `find_gadgets()`, in the same order, out of the
+/// batches handed over by `ShardRuntime.perform_lift_streaming()`.
+///
+/// Working backwards from a root only ever walks over gadget instructions,
+/// so the only instructions kept around are the run of them since the last
+/// one that isn't (copied, batches don't outlive `consume()`).
+pub const GadgetStream = struct {
+    allocator: std.mem.Allocator,
+    roots: std.ArrayList(NeedleGadget),
+    /// gadgets grown out of `roots`, in the order `find_gadgets()` adds them
+    extended: std.ArrayList(NeedleGadget),
+    /// every gadget instruction since the last non gadget one, oldest first
+    window: std.ArrayList(NeedleGadget),
+    window_arena: std.heap.ArenaAllocator,
+
+    const Self = @This();
+
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return Self{
+            .allocator = allocator,
+            .roots = std.ArrayList(NeedleGadget).init(allocator),
+            .extended = std.ArrayList(NeedleGadget).init(allocator),
+            .window = std.ArrayList(NeedleGadget).init(allocator),
+            .window_arena = std.heap.ArenaAllocator.init(allocator),
+        };
+    }
+
+    pub fn consume(self: *Self, insns: []const ShardInsn) !void {
+        for (insns) |*insn| {
+            // same as a non gadget instruction, nothing grows across a gap
+            if (self.window.items.len > 0) {
+                const last = &self.window.items[self.window.items.len - 1];
+                if (last.address + last.size != insn.base_address) {
+                    self.window.clearRetainingCapacity();
+                    _ = self.window_arena.reset(.retain_capacity);
+                }
+            }
+            if (insn.summary.ret) {
+                try self.add_root(insn);
+            }
+
+            if (is_gadget(insn.*)) {
+                const text = try self.window_arena.allocator().dupe(u8, insn.text);
+                try self.window.append(NeedleGadget.from_insn(insn, text));
+            } else {
+                self.window.clearRetainingCapacity();
+                _ = self.window_arena.reset(.retain_capacity);
+            }
+        }
+    }
+
+    /// Adds `insn` as a root gadget followed by every gadget grown out of it
+    fn add_root(self: *Self, insn: *const ShardInsn) !void {
+        var parent = NeedleGadget.from_insn(insn, try std.fmt.allocPrint(self.allocator, "{s}", .{insn.text}));
+        try self.roots.append(parent);
+
+        var idx = self.window.items.len;
+        while (idx > 0) {
+            idx -= 1;
+            const gadget = try NeedleGadget.from_parent(&self.window.items[idx], &parent, self.allocator);
+            self.extended.append(gadget) catch |err| {
+                logger.err("Failed to add gadget due to error: `{}`", .{err});
+                break;
+            };
+            parent = gadget;
+        }
+    }
+
+    /// Every gadget found, roots first like `find_gadgets()`
+    pub fn finish(self: *Self) !std.ArrayList(NeedleGadget) {
+        try self.roots.appendSlice(self.extended.items);
+        self.extended.deinit();
+        self.window.deinit();
+        self.window_arena.deinit();
+        return self.roots;
+    }
+};
+
+/// How far before an anchor `find_gadgets_anchored()` looks for gadget starts
+pub const ANCHOR_WINDOW_BYTES: u64 = 32;
+
+/// Finds gadgets without translating the whole image: a length + flow only
+/// sweep (`ShardRuntime.find_anchors()`) picks out every return, indirect
+/// branch or indirect call, and only the `ANCHOR_WINDOW_BYTES` before each
+/// of them are decoded.
+///
+/// Unlike `find_gadgets()` every `alignment` offset in the window is tried as
+/// a start, so gadgets hiding inside of other instructions turn up too. The
+/// window is walked backwards from the anchor so every start reuses the
+/// gadget already found where its first instruction ends, and instructions
+/// are decoded once no matter how many windows overlap them.
+pub fn find_gadgets_anchored(shard_rt: *shard.ShardRuntime, alignment: u64, allocator: std.mem.Allocator) !std.ArrayList(NeedleGadget) {
+    const anchors = try shard_rt.find_anchors();
+    defer anchors.deinit();
+
+    var roots = std.ArrayList(NeedleGadget).init(allocator);
+    var extended = std.ArrayList(NeedleGadget).init(allocator);
+    defer extended.deinit();
+
+    // every instruction decoded so far, `null` where nothing decodes
+    var decoded = std.AutoHashMap(u64, ?ShardInsn).init(allocator);
+    defer decoded.deinit();
+    // start address -> gadget running from there to the current anchor
+    var reaching = std.AutoHashMap(u64, NeedleGadget).init(allocator);
+    defer reaching.deinit();
+
+    const step = @max(alignment, 1);
+    for (anchors.items) |anchor| {
+        const root_insn = (try shard_rt.lift_at(anchor, allocator)) orelse continue;
+        const root = NeedleGadget.from_insn(&root_insn, try std.fmt.allocPrint(allocator, "{s}", .{root_insn.text}));
+        try roots.append(root);
+
+        reaching.clearRetainingCapacity();
+        try reaching.put(anchor, root);
+
+        var start = anchor;
+        while (start >= step and anchor - (start - step) <= ANCHOR_WINDOW_BYTES) {
+            start -= step;
+
+            const entry = try decoded.getOrPut(start);
+            if (!entry.found_existing) {
+                entry.value_ptr.* = shard_rt.lift_at(start, allocator) catch null;
+            }
+            const insn = entry.value_ptr.* orelse continue;
+            if (!is_gadget(insn)) {
+                continue;
+            }
+
+            const parent = reaching.get(start + insn.size) orelse continue;
+            const gadget = try NeedleGadget.from_parent_gadget(&insn, &parent, allocator);
+            try extended.append(gadget);
+            try reaching.put(start, gadget);
+        }
+    }
+
+    try roots.appendSlice(extended.items);
+    return roots;
+}
+
+/// Finds gadgets in a lift of every aligned offset
+/// (`ShardRuntime.set_all_offsets()`), which holds the instructions hiding
+/// inside of other ones next to the ones `find_gadgets()` sees.
+///
+/// `insns` overlap, so instead of walking back over the previous
+/// instruction every start is only joined onto the gadget starting where it
+/// ends. Walking the lift backwards means that gadget is already known, and
+/// each suffix is built once however many starts run into it. Gadgets are
+/// at most `ANCHOR_WINDOW_BYTES` long, like `find_gadgets_anchored()`.
+pub fn find_gadgets_all_offsets(insns: std.ArrayList(ShardInsn), allocator: std.mem.Allocator) !std.ArrayList(NeedleGadget) {
+    var roots = std.ArrayList(NeedleGadget).init(allocator);
+    var extended = std.ArrayList(NeedleGadget).init(allocator);
+    defer extended.deinit();
+
+    // start address -> gadget running from there to its root
+    var reaching = std.AutoHashMap(u64, NeedleGadget).init(allocator);
+    defer reaching.deinit();
+
+    var idx = insns.items.len;
+    while (idx > 0) {
+        idx -= 1;
+        const insn = &insns.items[idx];
+        if (insn.summary.ret) {
+            const root = NeedleGadget.from_insn(insn, try std.fmt.allocPrint(allocator, "{s}", .{insn.text}));
+            try roots.append(root);
+            try reaching.put(insn.base_address, root);
+            continue;
+        }
+        if (!is_gadget(insn.*)) {
+            continue;
+        }
+
+        const parent = reaching.get(insn.base_address + insn.size) orelse continue;
+        if (parent.size + insn.size > ANCHOR_WINDOW_BYTES) {
+            continue;
+        }
+        const gadget = try NeedleGadget.from_parent_gadget(insn, &parent, allocator);
+        try extended.append(gadget);
+        try reaching.put(insn.base_address, gadget);
+    }
+
+    // found back to front, handed out in address order
+    std.mem.reverse(NeedleGadget, roots.items);
+    std.mem.reverse(NeedleGadget, extended.items);
+    try roots.appendSlice(extended.items);
+    return roots;
+}
+
 /// Determines if the current instruction is useful as a gadget, pretty old but it checks out
 pub fn is_gadget(insn: ShardInsn) bool {
     if (insn.summary.modify_sp) {
@@ -168,6 +394,243 @@ pub fn dump_gadgets(gadgets: std.ArrayList(NeedleGadget)) void {
     }
 }
 
+/// Keeps the first of every group of `gadgets` that do the same thing to the
+/// registers, memory and control flow (see `shard.egraph`), in the order
+/// they were found
+fn dedup_gadgets(shard_rt: *shard.ShardRuntime, gadgets: std.ArrayList(NeedleGadget), allocator: std.mem.Allocator) !std.ArrayList(NeedleGadget) {
+    var semantics = shard.GadgetSemantics.init(allocator);
+    defer semantics.deinit();
+
+    for (gadgets.items) |gadget| {
+        var lifted = sleigh.LiftedRange{};
+        shard_rt.lift_gadget(gadget.address, gadget.size, &lifted) catch |err| {
+            logger.warn("Failed to lift gadget @ 0x{x}: {}", .{ gadget.address, err });
+            _ = try semantics.add_opaque();
+            continue;
+        };
+        defer shard_rt.sleigh_handle.release_range(&lifted);
+        _ = try semantics.add(&lifted, &shard_rt.spaces);
+    }
+
+    const report = try semantics.saturate(.{});
+    logger.debug("Saturated {} e-nodes in {} iterations ({s}): {} matches, {} unions", .{ semantics.graph.node_count(), report.iterations, @tagName(report.stop), report.matches, report.unions });
+
+    const representatives = try semantics.representatives(allocator);
+    var unique = std.ArrayList(NeedleGadget).init(allocator);
+    for (gadgets.items, representatives, 0..) |gadget, representative, idx| {
+        if (representative == idx) {
+            try unique.append(gadget);
+        }
+    }
+    logger.info("{} of {} gadgets do something no gadget before them does", .{ unique.items.len, gadgets.items.len });
+    return unique;
+}
+
+/// Dumps every gadget of the index at `index_dir` matching the query `text`
+fn query_index(index_dir: []const u8, text: []const u8, allocator: std.mem.Allocator) !void {
+    const query = shard.gadget_index.GadgetQuery.parse(text, allocator) catch |err| {
+        logger.err("Invalid gadget query `{s}`: {}", .{ text, err });
+        return err;
+    };
+
+    var index = try shard.gadget_index.GadgetIndex.open(index_dir, allocator);
+    defer index.close();
+
+    const hits = try index.query(&query, allocator);
+    var gadgets = try std.ArrayList(NeedleGadget).initCapacity(allocator, hits.items.len);
+    for (hits.items) |hit| {
+        gadgets.appendAssumeCapacity(NeedleGadget{ .address = hit.record.address, .size = hit.record.size, .text = hit.text });
+    }
+    dump_gadgets(gadgets);
+}
+
+/// Dumps the shortest chain of gadgets in the index at `index_dir` reaching
+/// the goal `text`, searched with `thread_count` threads
+fn chain_index(index_dir: []const u8, text: []const u8, thread_count: usize, allocator: std.mem.Allocator) !void {
+    const goal = shard.chain_search.ChainGoal.parse(text, allocator) catch |err| {
+        logger.err("Invalid chain goal `{s}`: {}", .{ text, err });
+        return err;
+    };
+
+    var index = try shard.gadget_index.GadgetIndex.open(index_dir, allocator);
+    defer index.close();
+
+    const chain = try shard.chain_search.find_chain(&index, &goal, thread_count, allocator) orelse {
+        logger.info("No chain of at most {} gadgets sets `{s}`", .{ goal.max_length, text });
+        return;
+    };
+    logger.info("Chain of {} gadgets eating 0x{x} stack bytes", .{ chain.gadgets.len, chain.stack_bytes });
+    for (chain.gadgets, chain.frame_offsets) |hit, offset| {
+        logger.info("  sp+0x{x}: 0x{x}", .{ offset, hit.record.address });
+    }
+
+    var gadgets = try std.ArrayList(NeedleGadget).initCapacity(allocator, chain.gadgets.len);
+    for (chain.gadgets) |hit| {
+        gadgets.appendAssumeCapacity(NeedleGadget{ .address = hit.record.address, .size = hit.record.size, .text = hit.text });
+    }
+    dump_gadgets(gadgets);
+}
+
+/// Finds the gadgets of the target loaded into `shard_rt` the way `c` says,
+/// for both a normal run and a job of `--serve`
+fn search_gadgets(shard_rt: *shard.ShardRuntime, c: *const StructFooConfig, dedup: bool, allocator: std.mem.Allocator) !std.ArrayList(NeedleGadget) {
+    // get list of gadget insns, or search them as they are lifted
+    var gadgets: std.ArrayList(NeedleGadget) = undefined;
+    if (c.anchored) {
+        gadgets = try find_gadgets_anchored(shard_rt, c.alignment, allocator);
+    } else if (c.all_offsets) {
+        // every chain needs the whole lift, there is nothing to stream
+        shard_rt.set_all_offsets(true);
+        defer shard_rt.set_all_offsets(false);
+        const haystack = try shard_rt.perform_lift_parallel(c.threads);
+        gadgets = try find_gadgets_all_offsets(haystack, allocator);
+    } else if (c.reachable) {
+        // the blocks are scattered over the image, nothing to stream either
+        const seeds = try shard_rt.cfg_seeds();
+        defer shard_rt.allocator.free(seeds);
+        var graph = try shard_rt.recover_cfg(seeds, c.threads);
+        defer graph.deinit();
+        logger.info("Recovered {} blocks, {} instructions", .{ graph.blocks.len, graph.insn_count() });
+        const haystack = try shard_rt.perform_lift_blocks(&graph, c.threads);
+        gadgets = try find_gadgets(haystack, allocator);
+    } else if (c.stream) {
+        var stream = GadgetStream.init(allocator);
+        try shard_rt.perform_lift_streaming(c.threads, &stream);
+        gadgets = try stream.finish();
+    } else {
+        const haystack = try shard_rt.perform_lift_parallel(c.threads);
+        gadgets = try find_gadgets(haystack, allocator);
+    }
+    if (c.pcode_only) {
+        for (gadgets.items) |*gadget| {
+            gadget.text = try shard_rt.disasm_range(gadget.address, gadget.size, allocator);
+        }
+    }
+    if (c.index_dir.len > 0) {
+        var index = try shard.gadget_index.GadgetIndex.open(c.index_dir, allocator);
+        defer index.close();
+        if (!try index.add(shard_rt, gadgets.items)) {
+            logger.info("Target is already in the gadget index", .{});
+        }
+    }
+    if (dedup) {
+        gadgets = try dedup_gadgets(shard_rt, gadgets, allocator);
+    }
+    return gadgets;
+}
+
+/// Gadget jobs of `--serve`, searched the same way as a normal run
+const DaemonJobs = struct {
+    pub fn gadgets(_: DaemonJobs, shard_rt: *shard.ShardRuntime, c: *const StructFooConfig, flags: shard.lift_daemon.JobFlags, allocator: std.mem.Allocator) ![]const shard.lift_daemon.Gadget {
+        const found = try search_gadgets(shard_rt, c, flags.dedup, allocator);
+        const out = try allocator.alloc(shard.lift_daemon.Gadget, found.items.len);
+        for (found.items, out) |gadget, *row| {
+            row.* = .{ .address = gadget.address, .size = gadget.size, .text = gadget.text };
+        }
+        return out;
+    }
+};
+
+/// Keeps every spec + image a job needs loaded, and answers jobs on the
+/// Unix socket at `socket_path` until one asks it to shut down
+fn serve_daemon(socket_path: []const u8) !void {
+    // not the arena of `main`, every target + job gives its memory back
+    var daemon = shard.LiftDaemon.init(std.heap.page_allocator, shard.lift_daemon.DEFAULT_SHM_DIR);
+    defer daemon.deinit();
+
+    var server = try shard.LiftDaemon.listen(socket_path);
+    defer server.deinit();
+    defer std.fs.cwd().deleteFile(socket_path) catch {};
+
+    logger.info("Serving jobs on `{s}`", .{socket_path});
+    try daemon.serve(&server, DaemonJobs{});
+}
+
+/// Finds the gadgets of the target of `c` with the daemon on the Unix
+/// socket at `socket_path` instead of loading it here
+fn run_on_daemon(socket_path: []const u8, c: *StructFooConfig, dedup: bool, allocator: std.mem.Allocator) !void {
+    // the daemon doesn't share our working directory
+    try c.set_root_dir(try std.fs.cwd().realpathAlloc(allocator, c.root_dir), allocator);
+    try c.set_input_path(try std.fs.cwd().realpathAlloc(allocator, c.input_path), allocator);
+    if (c.cache_dir.len > 0) {
+        try std.fs.cwd().makePath(c.cache_dir);
+        try c.set_cache_dir(try std.fs.cwd().realpathAlloc(allocator, c.cache_dir), allocator);
+    }
+    if (c.index_dir.len > 0) {
+        try std.fs.cwd().makePath(c.index_dir);
+        try c.set_index_dir(try std.fs.cwd().realpathAlloc(allocator, c.index_dir), allocator);
+    }
+
+    var client = shard.DaemonClient.connect(socket_path) catch |err| {
+        logger.err("No daemon on `{s}`: {}", .{ socket_path, err });
+        return err;
+    };
+    defer client.close();
+
+    var reply = try client.gadgets(c, .{ .dedup = dedup }, allocator);
+    defer reply.release();
+
+    var gadgets = try std.ArrayList(NeedleGadget).initCapacity(allocator, reply.rows.len);
+    for (reply.rows) |*row| {
+        gadgets.appendAssumeCapacity(NeedleGadget{ .address = row.address, .size = row.size, .text = reply.text_of(row) });
+    }
+    dump_gadgets(gadgets);
+}
+
+/// `part` as a percentage of `total`
+fn percent(part: u64, total: u64) f64 {
+    if (total == 0) {
+        return 0;
+    }
+    return @as(f64, @floatFromInt(part)) * 100 / @as(f64, @floatFromInt(total));
+}
+
+/// `total` per `count`, 0 if there were none
+fn per_call(total: u64, count: u64) u64 {
+    if (count == 0) {
+        return 0;
+    }
+    return total / count;
+}
+
+/// Dumps where the lift spent its time to console
+pub fn dump_profile(profile: *const shard.LiftProfile) void {
+    const stats = &profile.sleigh;
+    logger.info("Lift profile:", .{});
+    logger.info("  {} insns from {} chunks in {} ms", .{ profile.insns, profile.chunks, profile.wall_ns / std.time.ns_per_ms });
+    logger.info("  lift_range: {} ms, ShardInsn.from_lifted_range: {} ms (summed over threads)", .{ profile.lift_ns / std.time.ns_per_ms, profile.xlate_ns / std.time.ns_per_ms });
+    for (profile.nodes, 0..) |node, idx| {
+        if (node.chunks > 0) {
+            logger.info("  node {}: {} chunks, {} KiB at {} MiB/s per thread", .{ idx, node.chunks, node.bytes / 1024, node.bytes_per_sec() / (1024 * 1024) });
+        }
+    }
+    const spec = &profile.spec;
+    logger.info("  spec: {} symbols, {} constructors, {} op templates, {} of {} varnode templates kept, {} KiB of templates, shared by {}", .{ spec.symbol_count, spec.constructor_count, spec.op_template_count, spec.varnode_template_count, spec.varnode_template_refs, spec.template_bytes / 1024, spec.references });
+
+    if (stats.enabled == 0) {
+        logger.info("  build with `-Dstats` for the SLEIGH counters", .{});
+        return;
+    }
+
+    logger.info("| {s: <16} | {s: >10} | {s: >14} | {s: >12}", .{ "Phase", "Calls", "Cycles", "Cycles/call" });
+    logger.info("|{0s:-^18}|{0s:-^12}|{0s:-^16}|{0s:-^13}", .{"-"});
+    const phases = [_]struct { []const u8, u64, u64 }{
+        .{ "loadFill", stats.load_fill_calls, stats.load_fill_cycles },
+        .{ "printAssembly", stats.print_assembly_calls, stats.print_assembly_cycles },
+        .{ "oneInstruction", stats.one_instruction_calls, stats.one_instruction_cycles },
+    };
+    for (phases) |phase| {
+        logger.info("| {s: <16} | {: >10} | {: >14} | {: >12}", .{ phase[0], phase[1], phase[2], per_call(phase[2], phase[1]) });
+    }
+
+    logger.info("  decode errors: {}", .{stats.decode_errors});
+    logger.info("  parser cache: {} hits, {} misses ({d:.1}% hit)", .{ stats.parser_cache_hits, stats.parser_cache_misses, percent(stats.parser_cache_hits, stats.parser_cache_hits + stats.parser_cache_misses) });
+    logger.info("  context cache: {} hits, {} misses ({d:.1}% hit)", .{ stats.context_cache_hits, stats.context_cache_misses, percent(stats.context_cache_hits, stats.context_cache_hits + stats.context_cache_misses) });
+    logger.info("  decode cache: {} hits, {} misses", .{ stats.decode_cache_hits, stats.decode_cache_misses });
+    logger.info("  intern table: {} hits, {} misses ({d:.1}% hit)", .{ stats.intern_hits, stats.intern_misses, percent(stats.intern_hits, stats.intern_hits + stats.intern_misses) });
+    logger.info("  allocations: {} ({} bytes)", .{ stats.allocation_count, stats.allocation_bytes });
+}
+
 pub fn main() !void {
     const params = comptime clap.parseParamsComptime(
         \\-h, --help               Display this help and exit.
@@ -178,7 +641,25 @@ pub fn main() !void {
         \\--sla <str>              Name of sla spec.
         \\--pspec <str>            Name of pspec.
         \\--alignment <u64>        Target alignment in bytes.
+        \\--threads <u64>          Number of lifting threads.
+        \\--numa                   Pin the lifting threads to NUMA nodes, each with its memory on its node.
+        \\--huge-pages             Back the lift arenas + the image with 2MB huge pages.
+        \\--cache-dir <str>        Directory to cache lifted instructions in.
+        \\--content-chunks         Cache by content, so other builds of the image reuse the lifts.
         \\--root-dir <str>         Path to prefix containing `specfiles`, `configs` and `input-files` directories.
+        \\--profile                Print where the lift spent its time.
+        \\--stream                 Find gadgets while lifting, memory stays bounded.
+        \\--pcode-only             Only disassemble the gadgets that are found.
+        \\--simplify               Fold the temporaries out of the lifted p-code.
+        \\--anchored               Only decode the bytes before returns + indirect branches.
+        \\--all-offsets            Decode at every offset the spec aligns instructions to.
+        \\--reachable              Only decode the code reachable from the entry point + functions.
+        \\--index <str>            Directory of the persistent gadget index to add the gadgets to.
+        \\--query <str>            Answer a query (eg. `pops:a0,end:ret`) from the gadget index.
+        \\--chain <str>            Find the shortest chain of indexed gadgets setting these registers (eg. `a0,a1`).
+        \\--dedup                  Only print the first of the gadgets that do the same thing.
+        \\--serve <str>            Serve lift + gadget jobs on the Unix socket at this path.
+        \\--connect <str>          Send the run to the daemon on the Unix socket at this path.
         \\<str>                    Path to input file.
     );
 
@@ -237,6 +718,54 @@ pub fn main() !void {
         c.set_alignment(alignment);
     }
 
+    if (res.args.threads) |threads| {
+        c.set_threads(threads);
+    }
+
+    if (res.args.numa > 0) {
+        c.set_numa(true);
+    }
+
+    if (res.args.@"huge-pages" > 0) {
+        c.set_huge_pages(true);
+    }
+
+    if (res.args.stream > 0) {
+        c.set_stream(true);
+    }
+
+    if (res.args.anchored > 0) {
+        c.set_anchored(true);
+    }
+
+    if (res.args.@"all-offsets" > 0) {
+        c.set_all_offsets(true);
+    }
+
+    if (res.args.reachable > 0) {
+        c.set_reachable(true);
+    }
+
+    if (res.args.@"pcode-only" > 0) {
+        c.set_pcode_only(true);
+    }
+
+    if (res.args.simplify > 0) {
+        c.set_simplify(true);
+    }
+
+    if (res.args.@"cache-dir") |cache_dir| {
+        try c.set_cache_dir(cache_dir, allocator);
+    }
+
+    if (res.args.@"content-chunks" > 0) {
+        c.set_content_chunks(true);
+    }
+
+    if (res.args.index) |index_dir| {
+        try c.set_index_dir(index_dir, allocator);
+    }
+
     if (res.args.@"root-dir") |root| {
         try c.set_root_dir(root, allocator);
     } else {
@@ -248,12 +777,37 @@ pub fn main() !void {
         try c.set_input_path(res.positionals[0], allocator);
     }
 
+    if (res.args.serve) |socket_path| {
+        return serve_daemon(socket_path);
+    }
+
+    // queries are answered from the index alone, nothing is lifted
+    if (res.args.query) |text| {
+        if (c.index_dir.len == 0) {
+            logger.err("`--query` needs a gadget index (`--index`)", .{});
+            std.process.exit(1);
+        }
+        return query_index(c.index_dir, text, allocator);
+    }
+    if (res.args.chain) |text| {
+        if (c.index_dir.len == 0) {
+            logger.err("`--chain` needs a gadget index (`--index`)", .{});
+            std.process.exit(1);
+        }
+        return chain_index(c.index_dir, text, c.threads, allocator);
+    }
+
     if (!c.ready()) {
         logger.err("Missing configuration parameters! (need mode, sla, pspec, input path)", .{});
         return clap.help(std.io.getStdErr().writer(), clap.Help, &params, .{});
     }
 
+    if (res.args.connect) |socket_path| {
+        return run_on_daemon(socket_path, &c, res.args.dedup > 0, allocator);
+    }
+
     var loader = shard.ShardLoader.init(allocator);
+    defer loader.deinit();
 
     const target = try loader.loadFileFromConfig(&c);
 
@@ -261,9 +815,25 @@ pub fn main() !void {
     defer shard_rt.deinit();
 
     try shard_rt.load_target(target);
+    shard_rt.set_pcode_only(c.pcode_only);
+    shard_rt.set_simplify(c.simplify);
+    shard_rt.set_content_chunks(c.content_chunks);
+    shard_rt.set_numa(c.numa);
+    shard_rt.set_huge_pages(c.huge_pages);
+    if (res.args.profile > 0) {
+        // only there with `-Dstats`
+        shard_rt.set_decode_profile(true) catch {};
+    }
+    if (c.cache_dir.len > 0) {
+        try shard_rt.use_lift_cache(c.cache_dir);
+    }
 
-    // get list of gadget insns
-    const haystack = try shard_rt.perform_lift();
-    const gadgets = try find_gadgets(haystack, allocator);
+    const gadgets = try search_gadgets(&shard_rt, &c, res.args.dedup > 0, allocator);
+    if (res.args.profile > 0) {
+        dump_profile(&shard_rt.profile);
+        if (shard_rt.decode_profile_report()) |report| {
+            logger.info("{s}", .{report});
+        }
+    }
     dump_gadgets(gadgets);
 }
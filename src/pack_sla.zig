@@ -0,0 +1,31 @@
+//! # `pack-sla`
+//!
+//! Converts `.sla` specs into packed specs that `SleighSpec.load()` and
+//! `SleighState.add_specfile()` mmap instead of parsing the XML.
+//!
+//! ```sh
+//! pack-sla specfiles/x86-64.sla specfiles/x86-64.psla
+//! ```
+const std = @import("std");
+
+const sleigh = @import("sleigh.zig");
+
+const logger = std.log.scoped(.pack_sla);
+
+pub fn main() !void {
+    var arena = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    const args = try std.process.argsAlloc(allocator);
+    if (args.len != 3) {
+        logger.err("usage: {s} <in.sla> <out.psla>", .{args[0]});
+        return error.InvalidArguments;
+    }
+
+    sleigh.SleighSpec.pack(args[1], args[2]) catch |err| {
+        logger.err("Failed to pack `{s}`: {}", .{ args[1], err });
+        return err;
+    };
+    logger.info("Packed `{s}` into `{s}`", .{ args[1], args[2] });
+}
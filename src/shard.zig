@@ -5,12 +5,23 @@ const json = std.json;
 const sleigh = @import("sleigh.zig");
 pub const SleighState = sleigh.SleighState;
 pub const SleighError = sleigh.SleighError;
+pub const Numa = sleigh.Numa;
 pub const opcodes = @import("shard/opcodes.zig");
 pub const loader = @import("shard/loader.zig");
 pub const memory = @import("shard/memory.zig");
 pub const registers = @import("shard/registers.zig");
 pub const var_references = @import("shard/var_references.zig");
 pub const targets = @import("shard/targets.zig");
+pub const lift_cache = @import("shard/lift_cache.zig");
+pub const lift_ring = @import("shard/lift_ring.zig");
+pub const steal_deque = @import("shard/steal_deque.zig");
+pub const content_chunks = @import("shard/content_chunks.zig");
+pub const cfg = @import("shard/cfg.zig");
+pub const gadget_index = @import("shard/gadget_index.zig");
+pub const chain_search = @import("shard/chain_search.zig");
+pub const egraph = @import("shard/egraph.zig");
+pub const lift_daemon = @import("shard/lift_daemon.zig");
+pub const ghidra_dump = @import("shard/ghidra_dump.zig");
 
 pub const ShardLoader = loader.ShardLoader;
 pub const ShardInputTarget = targets.ShardInputTarget;
@@ -19,6 +30,15 @@ pub const ShardMemoryRegion = memory.ShardMemoryRegion;
 pub const VarReference = var_references.VarReference;
 pub const RegisterMap = registers.RegisterMap;
 pub const RegisterImpl = registers.RegisterImpl;
+pub const LiftCache = lift_cache.LiftCache;
+pub const LiftRing = lift_ring.LiftRing;
+pub const StealDeque = steal_deque.StealDeque;
+pub const ContentChunker = content_chunks.ContentChunker;
+pub const ControlFlowGraph = cfg.ControlFlowGraph;
+pub const GadgetIndex = gadget_index.GadgetIndex;
+pub const GadgetSemantics = egraph.GadgetSemantics;
+pub const LiftDaemon = lift_daemon.LiftDaemon;
+pub const DaemonClient = lift_daemon.DaemonClient;
 
 pub const LOG_SCOPE = .shard_rt;
 
@@ -31,6 +51,307 @@ pub const ShardError = error{
     NoTarget,
     NoInputMode,
     TargetPresent,
+    NoLiftThreads,
+};
+
+/// How many chunks each lifting thread gets on average, more chunks balance
+/// better at the cost of more boundaries to resynchronize
+const CHUNKS_PER_THREAD = 8;
+
+/// Smallest piece of a memory region handed to a lifting thread
+const MIN_CHUNK_SIZE = 64 * 1024;
+
+/// Piece of a memory region handed to a lifting thread by a streaming lift,
+/// fixed so memory doesn't grow with the image
+const STREAM_CHUNK_SIZE = 256 * 1024;
+
+/// Lifted chunks each streaming thread can get ahead of the consumer
+const STREAM_CHUNKS_PER_THREAD = 2;
+
+/// Instructions `ShardRuntime.find_anchors()` decodes per `flow_range()`
+const ANCHOR_FLOW_BATCH = 4096;
+
+/// NUMA nodes `LiftProfile` reports on, any past it count as the last one
+pub const PROFILE_NODES = 8;
+
+/// Contiguous piece of a memory region lifted as one unit of work
+const LiftChunk = struct {
+    start: u64,
+    end: u64,
+    /// first chunk of its memory region, nothing before it to line up with
+    region_start: bool,
+    /// content hash keying the chunk in the lift cache instead of its
+    /// addresses, see `ShardRuntime.set_content_chunks()`
+    content: ?u64 = null,
+    /// the basic blocks of `ShardRuntime.perform_lift_blocks()` are too
+    /// small to be worth a cache file each
+    cacheable: bool = true,
+    /// filled in once lifted
+    insns: []ShardInsn = &.{},
+    /// first address not lifted, can be past `end` if the last
+    /// instruction crossed it
+    end_address: u64 = 0,
+    err: ?anyerror = null,
+    /// time spent in `SleighState.lift_range()` (or the lift cache) and in
+    /// `ShardInsn.from_lifted_range()`
+    lift_ns: u64 = 0,
+    xlate_ns: u64 = 0,
+    /// NUMA node of the thread that lifted it, see `sleigh.Numa`
+    node: u32 = 0,
+    /// owns `insns` for a streaming lift, freed once consumed
+    arena: ?std.heap.ArenaAllocator = null,
+
+    fn deinit(self: *LiftChunk) void {
+        if (self.arena) |*arena| {
+            arena.deinit();
+        }
+        self.* = undefined;
+    }
+};
+
+/// Where the last `ShardRuntime.perform_lift()` spent its time, summed over
+/// every lifting thread
+pub const LiftProfile = struct {
+    /// counters of every SLEIGH handle, see `sleigh.LiftStats`
+    sleigh: sleigh.LiftStats = .{},
+    /// the spec every handle shares, see `sleigh.SpecMemoryUsage`
+    spec: sleigh.SpecMemoryUsage = .{},
+    chunks: u64 = 0,
+    insns: u64 = 0,
+    /// wall clock of the whole lift, merging included
+    wall_ns: u64 = 0,
+    lift_ns: u64 = 0,
+    xlate_ns: u64 = 0,
+    /// the chunks lifted on each NUMA node, only `nodes[0]` without
+    /// more than one
+    nodes: [PROFILE_NODES]NodeProfile = [_]NodeProfile{.{}} ** PROFILE_NODES,
+
+    /// What the threads of one NUMA node lifted
+    pub const NodeProfile = struct {
+        chunks: u64 = 0,
+        /// of the chunks, lifted or not
+        bytes: u64 = 0,
+        /// lifting + translating them, summed over the threads
+        busy_ns: u64 = 0,
+
+        /// Bytes lifted per second of thread time on the node
+        pub fn bytes_per_sec(self: *const NodeProfile) u64 {
+            if (self.busy_ns == 0) {
+                return 0;
+            }
+            return @intCast(@as(u128, self.bytes) * std.time.ns_per_s / self.busy_ns);
+        }
+    };
+
+    fn add_chunk(self: *LiftProfile, chunk: *const LiftChunk) void {
+        self.chunks += 1;
+        self.lift_ns += chunk.lift_ns;
+        self.xlate_ns += chunk.xlate_ns;
+
+        const node = &self.nodes[@min(chunk.node, PROFILE_NODES - 1)];
+        node.chunks += 1;
+        node.bytes += chunk.end - chunk.start;
+        node.busy_ns += chunk.lift_ns + chunk.xlate_ns;
+    }
+};
+
+/// Where the lifting threads of a parallel lift run + what their arenas
+/// come from, see `ShardRuntime.set_numa()` and
+/// `ShardRuntime.set_huge_pages()`
+const WorkerPlacement = struct {
+    /// NUMA nodes to spread the threads over, 1 to leave them be
+    nodes: u32 = 1,
+    /// node of the calling thread, the first worker
+    home: u32 = 0,
+    huge_pages: bool = false,
+
+    fn init(numa: bool, huge_pages: bool) WorkerPlacement {
+        const nodes = if (numa) Numa.node_count() else 1;
+        return .{ .nodes = nodes, .home = if (nodes > 1) Numa.current_node() else 0, .huge_pages = huge_pages };
+    }
+
+    /// Round robin from the node of the calling thread
+    fn node_of(self: WorkerPlacement, worker: usize) u32 {
+        return @intCast((@as(usize, self.home) + worker) % self.nodes);
+    }
+
+    /// Forks `parent` for `worker` with what it allocates eagerly placed on
+    /// its node, the rest it touches first from there once bound
+    fn fork(self: WorkerPlacement, parent: *SleighState, worker: usize) !SleighState {
+        if (self.nodes < 2) {
+            return parent.fork();
+        }
+        Numa.prefer_node(self.node_of(worker));
+        defer Numa.prefer_node(null);
+        return parent.fork();
+    }
+
+    /// Pins the calling thread to the node of `worker`, called first thing
+    /// by every thread the lift spawned
+    fn bind(self: WorkerPlacement, worker: usize) void {
+        if (self.nodes < 2) {
+            return;
+        }
+        if (!Numa.bind_thread(self.node_of(worker))) {
+            logger.debug("Failed to pin lift thread {} to node {}", .{ worker, self.node_of(worker) });
+        }
+    }
+
+    /// Backs the arenas of the lifting threads
+    fn page_allocator(self: WorkerPlacement) std.mem.Allocator {
+        return if (self.huge_pages) sleigh.huge_page_allocator else std.heap.page_allocator;
+    }
+};
+
+/// Chunks of a parallel lift as tasks on the work stealing deques of the
+/// lifting threads. A plain lift starts out with a task per function
+/// (memory region), for targets whose functions range from a few huge ones
+/// to thousands of tiny leaves.
+///
+/// Each thread starts on its largest tasks and steals the smallest of the
+/// others once it runs out. Any task over `split_size` is halved at an
+/// aligned address before it is lifted, the second half is left on the
+/// deque of the thread for whoever gets to it first. That half only keeps
+/// its instructions from where the last one of the first half ended (see
+/// `ShardRuntime.sync_chunk()`), so the splits end up on decoded
+/// instruction boundaries. A task is split the same way whichever thread
+/// takes it, the chunks (and their lift cache keys) are the same every run.
+/// Content defined chunks are never split, their bytes key the lift cache.
+const LiftQueue = struct {
+    /// room for every task the lift can ever make, splits go at the end
+    tasks: []LiftChunk,
+    task_count: std.atomic.Value(u32),
+    /// tasks made but not lifted yet, the lift is done once there are none
+    pending: std.atomic.Value(u32),
+    /// one per lifting thread, the calling thread has the first
+    deques: []StealDeque,
+    split_size: u64,
+    alignment: u64,
+    allocator: std.mem.Allocator,
+
+    fn init(chunks: []const LiftChunk, split_size: u64, alignment: u64, thread_count: usize, allocator: std.mem.Allocator) !LiftQueue {
+        // a split never leaves less than a quarter of `split_size` behind
+        var capacity: u64 = 0;
+        for (chunks) |chunk| {
+            capacity += 1 + (chunk.end - chunk.start) / @max(split_size / 4, 1);
+        }
+
+        const tasks = try allocator.alloc(LiftChunk, @intCast(capacity));
+        errdefer allocator.free(tasks);
+        @memcpy(tasks[0..chunks.len], chunks);
+
+        // every deque can hold every task, pushing never fails
+        const deques = try allocator.alloc(StealDeque, @max(thread_count, 1));
+        errdefer allocator.free(deques);
+        var created: usize = 0;
+        errdefer for (deques[0..created]) |*deque| {
+            deque.deinit(allocator);
+        };
+        while (created < deques.len) : (created += 1) {
+            deques[created] = try StealDeque.init(allocator, tasks.len);
+        }
+
+        // dealt out smallest first, so the largest end up at the bottoms
+        // the owners pop from and the smallest at the tops thieves take
+        const order = try allocator.alloc(u32, chunks.len);
+        defer allocator.free(order);
+        for (order, 0..) |*index, idx| {
+            index.* = @intCast(idx);
+        }
+        std.mem.sort(u32, order, tasks, task_smaller);
+        for (order, 0..) |index, rank| {
+            deques[(order.len - 1 - rank) % deques.len].push(index) catch unreachable;
+        }
+
+        return LiftQueue{
+            .tasks = tasks,
+            .task_count = std.atomic.Value(u32).init(@intCast(chunks.len)),
+            .pending = std.atomic.Value(u32).init(@intCast(chunks.len)),
+            .deques = deques,
+            .split_size = split_size,
+            .alignment = @max(alignment, 1),
+            .allocator = allocator,
+        };
+    }
+
+    fn deinit(self: *LiftQueue) void {
+        for (self.deques) |*deque| {
+            deque.deinit(self.allocator);
+        }
+        self.allocator.free(self.deques);
+        self.allocator.free(self.tasks);
+        self.* = undefined;
+    }
+
+    fn task_smaller(tasks: []LiftChunk, lhs: u32, rhs: u32) bool {
+        return tasks[lhs].end - tasks[lhs].start < tasks[rhs].end - tasks[rhs].start;
+    }
+
+    fn start_less_than(_: void, lhs: LiftChunk, rhs: LiftChunk) bool {
+        return lhs.start < rhs.start or (lhs.start == rhs.start and lhs.end < rhs.end);
+    }
+
+    /// Next task of the thread with the `worker`th deque, `null` once
+    /// every task is lifted
+    fn take(self: *LiftQueue, worker: usize) ?*LiftChunk {
+        while (true) {
+            const index = self.deques[worker].pop() orelse self.steal(worker) orelse {
+                // whatever is left is being lifted, but could still be split
+                if (self.pending.load(.acquire) == 0) {
+                    return null;
+                }
+                std.Thread.yield() catch {};
+                continue;
+            };
+
+            const chunk = &self.tasks[index];
+            self.split(worker, chunk);
+            return chunk;
+        }
+    }
+
+    fn steal(self: *LiftQueue, worker: usize) ?u32 {
+        for (1..self.deques.len) |offset| {
+            if (self.deques[(worker + offset) % self.deques.len].steal()) |index| {
+                return index;
+            }
+        }
+        return null;
+    }
+
+    /// Halves `chunk` until it is no larger than `split_size`, the second
+    /// halves go onto the deque of `worker`
+    fn split(self: *LiftQueue, worker: usize, chunk: *LiftChunk) void {
+        if (chunk.content != null) {
+            return;
+        }
+        while (chunk.end - chunk.start > self.split_size) {
+            const middle = std.mem.alignForward(u64, chunk.start + (chunk.end - chunk.start) / 2, self.alignment);
+            if (middle >= chunk.end) {
+                return;
+            }
+
+            const index = self.task_count.fetchAdd(1, .monotonic);
+            std.debug.assert(index < self.tasks.len);
+            self.tasks[index] = LiftChunk{ .start = middle, .end = chunk.end, .region_start = false };
+            // counted before anyone can take it, so the lift is never done
+            // early
+            _ = self.pending.fetchAdd(1, .monotonic);
+            self.deques[worker].push(index) catch unreachable;
+            chunk.end = middle;
+        }
+    }
+
+    fn done(self: *LiftQueue) void {
+        _ = self.pending.fetchSub(1, .release);
+    }
+
+    /// Every task in address order, once every thread stopped
+    fn lifted(self: *LiftQueue) []const LiftChunk {
+        const tasks = self.tasks[0..self.task_count.load(.monotonic)];
+        std.mem.sort(LiftChunk, tasks, {}, start_less_than);
+        return tasks;
+    }
 };
 
 /// Runtime that lifts and processes program instructions
@@ -47,12 +368,53 @@ pub const ShardRuntime = struct {
     /// backing register array
     register_map: RegisterMap,
 
+    /// space index -> `VarnodeSpace` for the loaded spec
+    spaces: sleigh.SpaceTable = .{},
+
+    /// registers treated as the stack pointer by the instruction summaries
+    stack_pointer: StackPointerSet = .{},
+
+    /// arenas owning the instructions lifted by worker threads
+    lift_arenas: std.ArrayList(std.heap.ArenaAllocator),
+
+    /// on-disk cache of lifted chunks, see `ShardRuntime.use_lift_cache()`
+    lift_cache: ?LiftCache = null,
+
+    /// filled in by every `perform_lift()`
+    profile: LiftProfile = .{},
+
+    /// lifts leave `ShardInsn.text` empty, see `ShardRuntime.set_pcode_only()`
+    pcode_only: bool = false,
+
+    /// lifts decode at every aligned offset, see `ShardRuntime.set_all_offsets()`
+    all_offsets: bool = false,
+
+    /// lifts come out with simplified p-code, see `ShardRuntime.set_simplify()`
+    simplify: bool = false,
+
+    /// regions are chunked by content, see `ShardRuntime.set_content_chunks()`
+    content_chunks: bool = false,
+
+    /// decoded spec `load_target()` uses instead of reading the `.sla` of
+    /// the target, see `ShardRuntime.use_spec()`
+    spec: ?sleigh.SleighSpec = null,
+
+    /// lifting threads are placed on NUMA nodes, see `ShardRuntime.set_numa()`
+    numa: bool = false,
+
+    /// lifts are backed by huge pages, see `ShardRuntime.set_huge_pages()`
+    huge_pages: bool = false,
+
+    /// what `ShardRuntime.place_image()` already did to the regions
+    image_interleaved: bool = false,
+    image_advised: bool = false,
+
     const Self = @This();
 
     pub fn init(allocator: std.mem.Allocator) Self {
         const sleigh_rt = SleighState.init();
 
-        return Self{ .sleigh_handle = sleigh_rt, .allocator = allocator, .register_map = RegisterMap.new(allocator) catch @panic("OOM") };
+        return Self{ .sleigh_handle = sleigh_rt, .allocator = allocator, .register_map = RegisterMap.new(allocator) catch @panic("OOM"), .lift_arenas = std.ArrayList(std.heap.ArenaAllocator).init(allocator) };
     }
 
     /// Sets up the initial state to be able to lift the target from SLEIGH
@@ -78,13 +440,47 @@ pub const ShardRuntime = struct {
 
         try self.load_target_to_sleigh();
         try self.load_registers();
+        try self.load_spaces();
+        self.stack_pointer = try StackPointerSet.init(&self.spaces, &self.register_map, try self.sleigh_handle.get_registers(), self.allocator);
+    }
+
+    /// Loads `target` with an already decoded `spec` instead of decoding its
+    /// `.sla` again, must be called before `ShardRuntime.load_target()`.
+    /// Only the handle is kept, `spec` must outlive the runtime.
+    pub fn use_spec(self: *Self, spec: sleigh.SleighSpec) void {
+        self.spec = spec;
+    }
+
+    /// Same as `ShardRuntime.load_target()`, except SLEIGH is a fork of
+    /// `parent`, which already has the spec, context and regions of
+    /// `target` loaded (eg. the `sleigh_handle` of a runtime that loaded
+    /// `target`). Nothing is decoded or loaded again, and the runtime can
+    /// be thrown away without touching `parent`.
+    pub fn load_forked(self: *Self, parent: *SleighState, target: ShardInputTarget) !void {
+        if (self.target) |_| {
+            logger.err("Already have target!", .{});
+            return ShardError.TargetPresent;
+        }
+
+        const forked = try parent.fork();
+        self.sleigh_handle.deinit();
+        self.sleigh_handle = forked;
+        self.target = target;
+
+        try self.load_registers();
+        try self.load_spaces();
+        self.stack_pointer = try StackPointerSet.init(&self.spaces, &self.register_map, try self.sleigh_handle.get_registers(), self.allocator);
     }
 
     // TODO: clean this error handling up a bit
     fn load_target_to_sleigh(self: *Self) !void {
         if (self.target) |target| {
             // load sla contents
-            try self.sleigh_handle.add_specfile(target.getSlaPath());
+            if (self.spec) |spec| {
+                self.sleigh_handle.use_spec(&spec);
+            } else {
+                try self.sleigh_handle.add_specfile(target.getSlaPath());
+            }
             self.begin();
 
             // load pspec context
@@ -92,13 +488,23 @@ pub const ShardRuntime = struct {
                 try self.sleigh_handle.context_var_set_default(pair.variable, @truncate(pair.value));
             }
 
+            // then the ranges that decode in another mode, forks keep them
+            for (target.getContextRegions()) |context_region| {
+                try self.sleigh_handle.context_var_set_region(
+                    context_region.variable,
+                    context_region.start +% target.baseAddress(),
+                    context_region.end +% target.baseAddress(),
+                    @truncate(context_region.value),
+                );
+            }
+
             // load regions
             if (target.getRebasedMemoryRegions(self.allocator)) |regions| {
                 defer self.allocator.free(regions);
                 for (regions) |region| {
                     //logger.debug("Loading region{{name: {s}, base_address: 0x{x}, len: {}}}", .{ region.name, region.base_address, region.data.len });
                     self.load_region_to_sleigh(region) catch |err| {
-                        logger.err("Failed to load Region{{base: 0x{x}, size: 0x{x}}} into SLEIGH: err: {}", .{ region.base_address, region.data.len, err });
+                        logger.err("Failed to load Region{{base: 0x{x}, size: 0x{x}}} into SLEIGH: err: {}", .{ region.base_address, region.len(), err });
                     };
                 }
             } else |_| {
@@ -112,6 +518,12 @@ pub const ShardRuntime = struct {
     /// Internal method used to pass an individual memory region to
     /// SLEIGH.
     fn load_region_to_sleigh(self: *Self, region: ShardMemoryRegion) !void {
+        if (region.compressed) |*image| {
+            return self.sleigh_handle.load_zstd_data(region.base_address, image);
+        }
+        if (region.flags != 0) {
+            return self.sleigh_handle.load_section(region.base_address, region.data, region.flags);
+        }
         try self.sleigh_handle.load_data(region.base_address, region.data);
     }
 
@@ -127,61 +539,820 @@ pub const ShardRuntime = struct {
             try self.register_map.addRegister(RegisterImpl.from_sleigh(&reg));
             //logger.debug("Register: `{s}`, offset: {}, size: {}, space: `{s}`", .{ reg.name, reg.varnode.offset, reg.varnode.size, reg.varnode.space });
         }
+
+        // the ids SLEIGH resolves lifted varnodes to index into this same order
+        try self.register_map.useIndex(sleigh_registers);
+    }
+
+    /// Builds the space lookup table used to translate lifted varnodes
+    pub fn load_spaces(self: *Self) !void {
+        const sleigh_spaces = try self.sleigh_handle.get_spaces();
+        self.spaces = try sleigh.SpaceTable.init(sleigh_spaces, self.allocator);
+    }
+
+    /// Keeps the lifts of the loaded target in the cache directory at `path`,
+    /// any chunk lifted before with the same spec, context + image is mapped
+    /// back in instead of being lifted again
+    pub fn use_lift_cache(self: *Self, path: []const u8) !void {
+        const target = self.target orelse {
+            logger.err("No target, nothing to cache", .{});
+            return ShardError.NoTarget;
+        };
+
+        if (self.lift_cache) |*cache| {
+            cache.close();
+            self.lift_cache = null;
+        }
+        self.lift_cache = try LiftCache.open(path, &target, self.allocator);
+    }
+
+    /// Lifts p-code only when `enable`d: every `ShardInsn` comes out without
+    /// its text, which skips the disassembler for the whole input. Get the
+    /// text of whatever is kept from `ShardRuntime.disasm_range()`.
+    ///
+    /// Text-less lifts are never written to the lift cache, so it keeps
+    /// serving full lifts.
+    pub fn set_pcode_only(self: *Self, enable: bool) void {
+        self.sleigh_handle.set_pcode_only(enable);
+        self.pcode_only = enable;
+    }
+
+    /// Lifts an instruction at every offset that is a multiple of the
+    /// alignment of the spec when `enable`d, instead of only after the end
+    /// of the last one. The lifted instructions overlap and are in address
+    /// order, an offset that doesn't decode has none.
+    ///
+    /// These lifts never go through the lift cache, its chunks only hold
+    /// the instructions of a normal lift.
+    pub fn set_all_offsets(self: *Self, enable: bool) void {
+        self.sleigh_handle.set_all_offsets(enable);
+        self.all_offsets = enable;
+    }
+
+    /// Simplifies the p-code of every lifted instruction when `enable`d, see
+    /// `SleighState.set_simplify_pcode()`. The instructions do the same with
+    /// fewer ops and temporaries.
+    ///
+    /// The lift cache holds the p-code as SLEIGH emits it, so these lifts
+    /// neither read from it nor write to it.
+    pub fn set_simplify(self: *Self, enable: bool) void {
+        self.sleigh_handle.set_simplify_pcode(enable);
+        self.simplify = enable;
+    }
+
+    /// Profiles where SLEIGH decodes spend their cycles when `enable`d, per
+    /// subtable and constructor of the spec, see
+    /// `SleighState.set_decode_profile()`. The lifting threads are merged in
+    /// after every lift, read it with `ShardRuntime.decode_profile_report()`.
+    pub fn set_decode_profile(self: *Self, enable: bool) SleighError!void {
+        try self.sleigh_handle.set_decode_profile(enable);
+    }
+
+    /// What the decode profile counted over every lift so far, `null` when
+    /// not profiling
+    pub fn decode_profile_report(self: *Self) ?[]const u8 {
+        return self.sleigh_handle.decode_profile_report();
+    }
+
+    /// Splits the regions into content defined chunks when `enable`d (see
+    /// `content_chunks.zig`), which the lift cache keys by their bytes
+    /// instead of by the whole image. A chunk lifted out of any other image
+    /// is moved to where it is in this one with
+    /// `SleighState.relocate_range()` instead of being lifted again, so a
+    /// new build of an image only lifts the chunks that changed.
+    ///
+    /// Compressed regions are still chunked by address.
+    pub fn set_content_chunks(self: *Self, enable: bool) void {
+        self.content_chunks = enable;
+    }
+
+    /// Spreads the lifting threads of parallel + streaming lifts round robin
+    /// over the NUMA nodes when `enable`d, starting from the node of the
+    /// calling thread (see `sleigh.Numa`). Every spawned thread is pinned to
+    /// its node and its handle is forked with its memory there, so the
+    /// caches it hits + the arena it lifts into are local to it. The regions
+    /// of the target every thread reads are interleaved over the nodes.
+    ///
+    /// Nothing changes on a machine with a single node.
+    pub fn set_numa(self: *Self, enable: bool) void {
+        self.numa = enable;
+    }
+
+    /// Backs the arenas of the lifting threads with 2MB huge pages when
+    /// `enable`d (see `sleigh.huge_page_allocator`), and asks for the
+    /// regions of the target to be backed by them. Big lifts then take far
+    /// fewer TLB misses, at the cost of arenas rounding up to 2MB.
+    pub fn set_huge_pages(self: *Self, enable: bool) void {
+        self.huge_pages = enable;
+    }
+
+    /// Interleaves and/or advises huge pages for the uncompressed regions
+    /// of the target, once each per runtime
+    fn place_image(self: *Self, target: *const ShardInputTarget) void {
+        const interleave = self.numa and !self.image_interleaved and Numa.node_count() > 1;
+        const advise = self.huge_pages and !self.image_advised;
+        if (!interleave and !advise) {
+            return;
+        }
+
+        for (target.getRawMemoryRegions()) |region| {
+            if (region.compressed != null) {
+                continue;
+            }
+            if (interleave) {
+                Numa.interleave(region.data);
+            }
+            if (advise) {
+                Numa.advise_huge_pages(region.data);
+            }
+        }
+        self.image_interleaved = self.image_interleaved or interleave;
+        self.image_advised = self.image_advised or advise;
+    }
+
+    /// Renders the instructions in `[address, address + size)` as
+    /// `insn; insn; ...`, the same text the lift would have given them
+    pub fn disasm_range(self: *Self, address: u64, size: u64, allocator: std.mem.Allocator) ![]const u8 {
+        var text = std.ArrayList(u8).init(allocator);
+        errdefer text.deinit();
+
+        var cursor = address;
+        while (cursor < address + size) {
+            const insn = try self.sleigh_handle.disasm(cursor);
+            if (cursor != address) {
+                try text.appendSlice("; ");
+            }
+            try text.writer().print("{s} {s}", .{ insn.insn[0..insn.insn_len], insn.body[0..insn.body_len] });
+            cursor += @max(insn.size, 1);
+        }
+
+        return text.toOwnedSlice();
+    }
+
+    /// Lifts the gadget of `size` bytes at `address` into `out` the way it
+    /// executes, one instruction after the end of the last, even while the
+    /// other lifts `set_all_offsets()`
+    pub fn lift_gadget(self: *Self, address: u64, size: u64, out: *sleigh.LiftedRange) !void {
+        if (self.all_offsets) {
+            self.sleigh_handle.set_all_offsets(false);
+        }
+        defer if (self.all_offsets) {
+            self.sleigh_handle.set_all_offsets(true);
+        };
+        try self.sleigh_handle.lift_range(address, address + size, out);
     }
 
     /// Performs initial translation of the entire input space
+    ///
+    /// Each memory region is lifted with a single `SleighState.lift_range()`
+    /// call, the lifted arena is only kept around long enough to be
+    /// translated into `ShardInsn`'s.
     pub fn perform_lift(self: *Self) !std.ArrayList(ShardInsn) {
-        var target = self.target orelse {
+        const target = self.target orelse {
             logger.err("No target, cannot lift anything", .{});
             return ShardError.NoTarget;
         };
-        var address = target.baseAddress();
-        const max_address = target.maxAddress();
-        logger.debug("Base address: 0x{x}", .{address});
+        logger.debug("Base address: 0x{x}", .{target.baseAddress()});
 
-        var insn_list = std.ArrayList(ShardInsn).init(self.allocator);
+        var timer = try std.time.Timer.start();
+        self.sleigh_handle.reset_stats();
+        const chunks = try self.build_chunks(&target, std.math.maxInt(u64));
+        defer self.allocator.free(chunks);
 
-        while (address < max_address) {
-            //logger.debug("[perform lift] looper with address: 0x{x}", .{address});
-
-            // check if next address is valid
-            const inner_address = target.nextAddress(address);
-            //logger.debug("Inner addr: `0x{?x}`", .{inner_address});
-            if (inner_address) |insn_addr| {
-                // next address is a valid one, update the top level address
-                address = insn_addr;
-
-                // now attempt to parse the insn at the address
-                if (try self.sleigh_handle.lift_insn(insn_addr)) |insn| {
-                    //logger.debug("[INSN] {s}", .{try insn.to_asm(self.allocator)});
-
-                    // lift insn semantic summary
-                    const shard_insn = ShardInsn.from_sleigh(insn, &self.register_map, self.allocator) catch {
-                        logger.warn("Failed to xlate insn: {s}", .{try insn.to_asm(self.allocator)});
-                        address += insn.size;
-                        continue;
-                    };
-                    try insn_list.append(shard_insn);
-                    address += insn.size;
-                } else {
-                    // failed to parse, continue on
-                    logger.err("Failed to parse insn @ `0x{x}`", .{address});
-                    address += 2; // TODO: target alignment
+        for (chunks) |*chunk| {
+            try self.lift_chunk(&self.sleigh_handle, self.allocator, chunk);
+        }
+
+        const insns = try self.merge_chunks(chunks);
+        var profile = LiftProfile{ .insns = insns.items.len, .wall_ns = timer.read() };
+        for (chunks) |*chunk| {
+            profile.add_chunk(chunk);
+        }
+        self.record_profile(profile, &.{});
+        return insns;
+    }
+
+    /// Same as `ShardRuntime.perform_lift()` except the regions are split up
+    /// across `thread_count` threads, each with their own forked SLEIGH handle.
+    /// The results are identical to the single threaded lift.
+    pub fn perform_lift_parallel(self: *Self, thread_count: usize) !std.ArrayList(ShardInsn) {
+        if (thread_count <= 1) {
+            return self.perform_lift();
+        }
+
+        const target = self.target orelse {
+            logger.err("No target, cannot lift anything", .{});
+            return ShardError.NoTarget;
+        };
+
+        var timer = try std.time.Timer.start();
+        self.sleigh_handle.reset_stats();
+        var total_size: u64 = 0;
+        for (target.getRawMemoryRegions()) |region| {
+            total_size += region.len();
+        }
+        const chunk_size = std.mem.alignForward(u64, @max(total_size / (thread_count * CHUNKS_PER_THREAD), MIN_CHUNK_SIZE), 4096);
+
+        // a chunk per region (or the content defined ones), split up as
+        // they are lifted, see `LiftQueue`
+        const chunks = try self.build_chunks(&target, std.math.maxInt(u64));
+        defer self.allocator.free(chunks);
+        var queue = try LiftQueue.init(chunks, chunk_size, try self.sleigh_handle.alignment(), thread_count, self.allocator);
+        defer queue.deinit();
+        self.place_image(&target);
+        return self.lift_chunks_parallel(&queue, thread_count, &timer);
+    }
+
+    /// Decodes the basic blocks reachable from `seeds` (see `cfg.zig`)
+    /// with `thread_count` threads, each with their own forked SLEIGH
+    /// handle. `ShardRuntime.cfg_seeds()` has the usual seeds.
+    pub fn recover_cfg(self: *Self, seeds: []const u64, thread_count: usize) !ControlFlowGraph {
+        const target = self.target orelse {
+            logger.err("No target, cannot recover anything", .{});
+            return ShardError.NoTarget;
+        };
+
+        const handles = try self.allocator.alloc(SleighState, @max(thread_count, 1) - 1);
+        defer self.allocator.free(handles);
+        var forked: usize = 0;
+        defer for (handles[0..forked]) |*handle| {
+            handle.deinit();
+        };
+        while (forked < handles.len) : (forked += 1) {
+            handles[forked] = try self.sleigh_handle.fork();
+        }
+
+        const rebased = try target.getRebasedMemoryRegions(self.allocator);
+        defer self.allocator.free(rebased);
+        return ControlFlowGraph.recover(&self.sleigh_handle, handles, rebased, seeds, self.allocator);
+    }
+
+    /// Where `ShardRuntime.recover_cfg()` usually starts: the base address
+    /// of the target and the start of every region (every function of a
+    /// Ghidra dump is a region of its own). Caller owns the slice.
+    pub fn cfg_seeds(self: *Self) ![]u64 {
+        const target = self.target orelse {
+            logger.err("No target, no seeds", .{});
+            return ShardError.NoTarget;
+        };
+
+        const rebased = try target.getRebasedMemoryRegions(self.allocator);
+        defer self.allocator.free(rebased);
+        const seeds = try self.allocator.alloc(u64, rebased.len + 1);
+        seeds[0] = target.baseAddress();
+        for (rebased, seeds[1..]) |region, *seed| {
+            seed.* = region.base_address;
+        }
+        return seeds;
+    }
+
+    /// Same as `ShardRuntime.perform_lift_parallel()`, except only the
+    /// blocks of `graph` are lifted: the instructions come out block after
+    /// block in address order, and nothing outside of a block (padding,
+    /// literal pools) is decoded.
+    pub fn perform_lift_blocks(self: *Self, graph: *const ControlFlowGraph, thread_count: usize) !std.ArrayList(ShardInsn) {
+        var timer = try std.time.Timer.start();
+        self.sleigh_handle.reset_stats();
+        const chunks = try self.allocator.alloc(LiftChunk, graph.blocks.len);
+        defer self.allocator.free(chunks);
+        for (graph.blocks, chunks) |block, *chunk| {
+            chunk.* = LiftChunk{ .start = block.start, .end = block.end, .region_start = true, .cacheable = false };
+        }
+        var queue = try LiftQueue.init(chunks, std.math.maxInt(u64), 1, thread_count, self.allocator);
+        defer queue.deinit();
+        return self.lift_chunks_parallel(&queue, thread_count, &timer);
+    }
+
+    /// Lifts the chunks of `queue` across `thread_count` threads and merges
+    /// them, see `ShardRuntime.perform_lift_parallel()`
+    fn lift_chunks_parallel(self: *Self, queue: *LiftQueue, thread_count: usize, timer: *std.time.Timer) !std.ArrayList(ShardInsn) {
+
+        // the calling thread does its share of the work with the main handle,
+        // every other thread gets a forked handle + its own arena
+        const worker_count = @max(thread_count, 1) - 1;
+        const handles = try self.allocator.alloc(SleighState, worker_count);
+        defer self.allocator.free(handles);
+        const arenas = try self.allocator.alloc(std.heap.ArenaAllocator, worker_count);
+        defer self.allocator.free(arenas);
+        const threads = try self.allocator.alloc(std.Thread, worker_count);
+        defer self.allocator.free(threads);
+        try self.lift_arenas.ensureUnusedCapacity(worker_count);
+        const placement = WorkerPlacement.init(self.numa, self.huge_pages);
+
+        var forked: usize = 0;
+        defer for (handles[0..forked]) |*handle| {
+            handle.deinit();
+        };
+        while (forked < worker_count) : (forked += 1) {
+            handles[forked] = try placement.fork(&self.sleigh_handle, forked + 1);
+        }
+
+        var spawned: usize = 0;
+        while (spawned < worker_count) : (spawned += 1) {
+            arenas[spawned] = std.heap.ArenaAllocator.init(placement.page_allocator());
+            threads[spawned] = std.Thread.spawn(.{}, placed_lift_worker, .{ self, placement, &handles[spawned], arenas[spawned].allocator(), queue, spawned + 1 }) catch |err| {
+                logger.warn("Failed to spawn lift thread: {}", .{err});
+                arenas[spawned].deinit();
+                break;
+            };
+        }
+
+        lift_worker(self, &self.sleigh_handle, self.allocator, queue, 0);
+
+        for (threads[0..spawned], arenas[0..spawned]) |thread, arena| {
+            thread.join();
+            self.lift_arenas.appendAssumeCapacity(arena);
+        }
+
+        const chunks = queue.lifted();
+        const insns = try self.merge_chunks(chunks);
+        var profile = LiftProfile{ .insns = insns.items.len, .wall_ns = timer.read() };
+        for (chunks) |*chunk| {
+            profile.add_chunk(chunk);
+        }
+        self.record_profile(profile, handles[0..forked]);
+        return insns;
+    }
+
+    /// Same lift as `ShardRuntime.perform_lift()`, except the instructions
+    /// are never all kept around: `consumer.consume(insns)` is called with
+    /// consecutive batches of them in address order, each only valid for
+    /// the duration of the call, while `thread_count` forked handles keep
+    /// lifting the chunks after it. The threads can only get a few chunks
+    /// ahead of `consumer` (see `LiftRing`), so memory stays the same
+    /// however large the image is. Any error of `consumer` stops the lift.
+    pub fn perform_lift_streaming(self: *Self, thread_count: usize, consumer: anytype) !void {
+        const target = self.target orelse {
+            logger.err("No target, cannot lift anything", .{});
+            return ShardError.NoTarget;
+        };
+
+        var timer = try std.time.Timer.start();
+        self.sleigh_handle.reset_stats();
+        const chunks = try self.build_chunks(&target, STREAM_CHUNK_SIZE);
+        defer self.allocator.free(chunks);
+        self.place_image(&target);
+        const placement = WorkerPlacement.init(self.numa, self.huge_pages);
+
+        // the calling thread consumes (and relifts with the main handle),
+        // every lifting thread gets a forked handle
+        const worker_count = @max(thread_count, 1);
+        var ring = try LiftRing(LiftChunk).init(self.allocator, @intCast(worker_count * STREAM_CHUNKS_PER_THREAD), @intCast(chunks.len));
+        defer ring.deinit(self.allocator);
+        const handles = try self.allocator.alloc(SleighState, worker_count);
+        defer self.allocator.free(handles);
+        const threads = try self.allocator.alloc(std.Thread, worker_count);
+        defer self.allocator.free(threads);
+
+        var forked: usize = 0;
+        defer for (handles[0..forked]) |*handle| {
+            handle.deinit();
+        };
+        while (forked < worker_count) : (forked += 1) {
+            handles[forked] = try placement.fork(&self.sleigh_handle, forked + 1);
+        }
+
+        var spawned: usize = 0;
+        defer {
+            ring.close();
+            for (threads[0..spawned]) |thread| {
+                thread.join();
+            }
+            while (ring.drain()) |chunk| {
+                var left = chunk;
+                left.deinit();
+            }
+        }
+        while (spawned < worker_count) : (spawned += 1) {
+            threads[spawned] = std.Thread.spawn(.{}, stream_worker, .{ self, placement, &handles[spawned], chunks, &ring, spawned + 1 }) catch |err| {
+                logger.warn("Failed to spawn lift thread: {}", .{err});
+                break;
+            };
+        }
+        if (spawned == 0) {
+            return ShardError.NoLiftThreads;
+        }
+
+        var profile = LiftProfile{};
+        var cursor: u64 = 0;
+        while (ring.take()) |taken| {
+            var chunk = taken;
+            defer chunk.deinit();
+            profile.add_chunk(&chunk);
+            if (chunk.err) |err| {
+                return err;
+            }
+
+            var resync_arena = std.heap.ArenaAllocator.init(std.heap.page_allocator);
+            defer resync_arena.deinit();
+            const insns = try self.sync_chunk(&chunk, &cursor, resync_arena.allocator());
+            profile.insns += insns.len;
+            try consumer.consume(insns);
+        }
+
+        profile.wall_ns = timer.read();
+        self.record_profile(profile, handles[0..forked]);
+    }
+
+    /// Cheap first pass of an anchored gadget scan: decodes only the length
+    /// + flow of every instruction (`SleighState.flow_range()`, no p-code)
+    /// and returns the address of every one that returns, branches
+    /// indirectly or calls indirectly. Use `ShardRuntime.lift_at()` to decode
+    /// the windows before them.
+    pub fn find_anchors(self: *Self) !std.ArrayList(u64) {
+        const target = self.target orelse {
+            logger.err("No target, cannot lift anything", .{});
+            return ShardError.NoTarget;
+        };
+
+        var timer = try std.time.Timer.start();
+        self.sleigh_handle.reset_stats();
+
+        const chunks = try self.build_chunks(&target, STREAM_CHUNK_SIZE);
+        defer self.allocator.free(chunks);
+        const buffer = try self.allocator.alloc(sleigh.InsnFlow, ANCHOR_FLOW_BATCH);
+        defer self.allocator.free(buffer);
+
+        var anchors = std.ArrayList(u64).init(self.allocator);
+        errdefer anchors.deinit();
+
+        var profile = LiftProfile{};
+        var cursor: u64 = 0;
+        for (chunks) |chunk| {
+            // carry on from wherever the last chunk stopped, a region start
+            // is the only place the sweep can't be in sync already
+            if (chunk.region_start or cursor < chunk.start) {
+                cursor = chunk.start;
+            }
+
+            while (cursor < chunk.end) {
+                const flows = try self.sleigh_handle.flow_range(cursor, chunk.end, buffer);
+                for (flows.insns) |flow| {
+                    if (flow.has(sleigh.InsnFlow.RETURN | sleigh.InsnFlow.BRANCH_INDIRECT | sleigh.InsnFlow.CALL_INDIRECT)) {
+                        try anchors.append(flow.address);
+                    }
                 }
+
+                profile.insns += flows.insns.len;
+                cursor = @max(flows.end_address, cursor + 1);
+            }
+            profile.chunks += 1;
+        }
+
+        profile.wall_ns = timer.read();
+        profile.lift_ns = profile.wall_ns;
+        self.record_profile(profile, &.{});
+        return anchors;
+    }
+
+    /// Lifts the single instruction at `address`, `null` if nothing decodes
+    /// there. The text is only filled in without `ShardRuntime.set_pcode_only()`.
+    pub fn lift_at(self: *Self, address: u64, allocator: std.mem.Allocator) !?ShardInsn {
+        var lifted = sleigh.LiftedRange{};
+        try self.sleigh_handle.lift_range(address, address + 1, &lifted);
+        defer self.sleigh_handle.release_range(&lifted);
+
+        if (lifted.insn_count == 0 or lifted.insns()[0].address != address) {
+            return null;
+        }
+        return try ShardInsn.from_lifted_range(&lifted, &lifted.insns()[0], &self.spaces, &self.register_map, &self.stack_pointer, allocator);
+    }
+
+    /// Adds the counters of the main handle + `forks` to `profile` and keeps
+    /// it as `ShardRuntime.profile`
+    fn record_profile(self: *Self, profile: LiftProfile, forks: []const SleighState) void {
+        self.profile = profile;
+        self.profile.sleigh = self.sleigh_handle.get_stats();
+        self.profile.spec = self.sleigh_handle.spec_memory_usage() catch .{};
+        for (forks) |*handle| {
+            self.profile.sleigh.add(handle.get_stats());
+            // only fails when not profiling
+            self.sleigh_handle.merge_decode_profile(handle) catch {};
+        }
+    }
+
+    /// Hash of the context regions of `target` painted over `[start, end)`,
+    /// or null if one of them starts or ends inside of it
+    fn painted_context(target: *const ShardInputTarget, start: u64, end: u64) ?u64 {
+        var hasher = std.hash.Wyhash.init(0);
+        for (target.getContextRegions()) |context_region| {
+            const region_start = context_region.start +% target.baseAddress();
+            const region_end = context_region.end +% target.baseAddress();
+            if ((region_start > start and region_start < end) or (region_end > start and region_end < end)) {
+                return null;
+            }
+            if (region_start <= start and start < region_end) {
+                hasher.update(context_region.variable);
+                hasher.update(std.mem.asBytes(&context_region.value));
+            }
+        }
+        return hasher.final();
+    }
+
+    /// Splits the memory regions of `target` into address ordered chunks of
+    /// at most `max_chunk_size` bytes (or content defined ones, see
+    /// `ShardRuntime.set_content_chunks()`), caller owns the returned slice
+    fn build_chunks(self: *Self, target: *const ShardInputTarget, max_chunk_size: u64) ![]LiftChunk {
+        const rebased = try target.getRebasedMemoryRegions(self.allocator);
+        defer self.allocator.free(rebased);
+        const regions = try self.allocator.dupe(ShardMemoryRegion, rebased);
+        defer self.allocator.free(regions);
+        std.mem.sort(ShardMemoryRegion, regions, {}, ShardMemoryRegion.baseAddressLessThan);
+
+        var chunks = std.ArrayList(LiftChunk).init(self.allocator);
+        errdefer chunks.deinit();
+        var cuts = std.ArrayList(content_chunks.ContentChunk).init(self.allocator);
+        defer cuts.deinit();
+        const chunker = ContentChunker{ .alignment = if (self.content_chunks) try self.sleigh_handle.alignment() else 1 };
+
+        for (regions) |region| {
+            if (self.content_chunks and region.compressed == null) {
+                cuts.clearRetainingCapacity();
+                try chunker.split(region.base_address, region.data, &cuts);
+                for (cuts.items) |cut| {
+                    // the same bytes only lift the same in the same context
+                    const content = if (painted_context(target, cut.start, cut.end)) |painted| std.hash.Wyhash.hash(painted, std.mem.asBytes(&cut.content)) else null;
+                    try chunks.append(LiftChunk{ .start = cut.start, .end = cut.end, .region_start = cut.start == region.base_address, .content = content });
+                }
+                continue;
+            }
+
+            const region_end = region.base_address + region.len();
+            var start = region.base_address;
+            while (start < region_end) {
+                const end = start + @min(max_chunk_size, region_end - start);
+                try chunks.append(LiftChunk{ .start = start, .end = end, .region_start = start == region.base_address });
+                start = end;
+            }
+        }
+
+        return chunks.toOwnedSlice();
+    }
+
+    /// Pulls chunks off of `queue` until it is empty, each thread must pass
+    /// in its own `handle`, an `allocator` nobody else is using and its
+    /// `worker` index (the calling thread is 0).
+    fn lift_worker(self: *const Self, handle: *SleighState, allocator: std.mem.Allocator, queue: *LiftQueue, worker: usize) void {
+        while (queue.take(worker)) |chunk| {
+            self.lift_chunk(handle, allocator, chunk) catch |err| {
+                chunk.err = err;
+            };
+            queue.done();
+        }
+    }
+
+    /// `ShardRuntime.lift_worker()` of a spawned thread, pinned to its node
+    /// first
+    fn placed_lift_worker(self: *const Self, placement: WorkerPlacement, handle: *SleighState, allocator: std.mem.Allocator, queue: *LiftQueue, worker: usize) void {
+        placement.bind(worker);
+        self.lift_worker(handle, allocator, queue, worker);
+    }
+
+    /// Lifts the chunks `ring` hands out into arenas of their own, see
+    /// `ShardRuntime.perform_lift_streaming()`
+    fn stream_worker(self: *const Self, placement: WorkerPlacement, handle: *SleighState, chunks: []const LiftChunk, ring: *LiftRing(LiftChunk), worker: usize) void {
+        placement.bind(worker);
+        while (ring.claim()) |index| {
+            var chunk = chunks[index];
+            chunk.arena = std.heap.ArenaAllocator.init(placement.page_allocator());
+            self.lift_chunk(handle, chunk.arena.?.allocator(), &chunk) catch |err| {
+                chunk.err = err;
+            };
+            ring.put(index, chunk);
+        }
+    }
+
+    /// Lifts `chunk` with `handle` and translates it into `ShardInsn`'s
+    /// allocated from `allocator`
+    fn lift_chunk(self: *const Self, handle: *SleighState, allocator: std.mem.Allocator, chunk: *LiftChunk) !void {
+        var timer = try std.time.Timer.start();
+        var cached: ?lift_cache.LiftCacheEntry = null;
+        if (self.lift_cache) |*cache| {
+            if (chunk.cacheable and !self.all_offsets and !self.simplify) {
+                cached = if (chunk.content) |content| cache.load_content(content, chunk.end - chunk.start) else cache.load(chunk.start, chunk.end);
+            }
+        }
+
+        var lifted = sleigh.LiftedRange{};
+        if (cached) |entry| {
+            if (entry.start == chunk.start) {
+                lifted = entry.range;
             } else {
-                // no more insn addresses, exit
-                break;
+                // the same bytes lifted out of another image, moved to here
+                var moved = entry;
+                cached = null;
+                defer moved.release();
+                try handle.relocate_range(&moved.range, moved.start, chunk.start, &lifted);
+            }
+        } else {
+            try handle.lift_range(chunk.start, chunk.end, &lifted);
+            if (self.lift_cache != null and chunk.cacheable and !self.pcode_only and !self.all_offsets and !self.simplify) {
+                const cache = &self.lift_cache.?;
+                const stored = if (chunk.content) |content| cache.store_content(content, chunk.start, chunk.end, &lifted) else cache.store(chunk.start, chunk.end, &lifted);
+                stored catch |err| {
+                    logger.warn("Failed to cache lift @ 0x{x}: {}", .{ chunk.start, err });
+                };
+            }
+        }
+        defer if (cached) |*entry| {
+            entry.release();
+        } else {
+            handle.release_range(&lifted);
+        };
+        chunk.lift_ns = timer.lap();
+
+        var insns = try std.ArrayList(ShardInsn).initCapacity(allocator, lifted.insn_count);
+        for (lifted.insns()) |*insn| {
+            // lift insn semantic summary
+            const shard_insn = ShardInsn.from_lifted_range(&lifted, insn, &self.spaces, &self.register_map, &self.stack_pointer, allocator) catch {
+                logger.warn("Failed to xlate insn: {s}", .{try lifted.to_asm(insn, allocator)});
+                continue;
+            };
+            insns.appendAssumeCapacity(shard_insn);
+        }
+
+        chunk.insns = try insns.toOwnedSlice();
+        chunk.end_address = lifted.end_address;
+        chunk.xlate_ns = timer.read();
+        chunk.node = Numa.current_node();
+    }
+
+    /// Concatenates lifted chunks in address order.
+    ///
+    /// Any chunk that doesn't start at a region boundary was decoded from an
+    /// arbitrary aligned address, so its instructions are only kept from the
+    /// point where they line up with the end of the previous chunk. If they
+    /// never do, the rest of the chunk is lifted again from where the
+    /// previous chunk stopped.
+    fn merge_chunks(self: *Self, chunks: []const LiftChunk) !std.ArrayList(ShardInsn) {
+        var insn_list = std.ArrayList(ShardInsn).init(self.allocator);
+        errdefer insn_list.deinit();
+
+        var cursor: u64 = 0;
+        for (chunks) |*chunk| {
+            if (chunk.err) |err| {
+                return err;
             }
+
+            try insn_list.appendSlice(try self.sync_chunk(chunk, &cursor, self.allocator));
         }
 
         return insn_list;
     }
 
+    /// Lines `chunk` up with the end of the previous chunk at `cursor` (see
+    /// `ShardRuntime.merge_chunks()`), returns its instructions from there
+    /// on and moves `cursor` past them. A chunk that stays out of sync is
+    /// lifted again with the main handle into `allocator`.
+    fn sync_chunk(self: *Self, chunk: *const LiftChunk, cursor: *u64, allocator: std.mem.Allocator) ![]const ShardInsn {
+        if (chunk.region_start) {
+            cursor.* = chunk.start;
+        }
+
+        // the last instruction of the previous chunk covered all of this one
+        if (cursor.* >= chunk.end) {
+            return &.{};
+        }
+
+        var idx: usize = 0;
+        while (idx < chunk.insns.len and chunk.insns[idx].base_address < cursor.*) {
+            idx += 1;
+        }
+
+        const in_sync = cursor.* == chunk.start or (idx < chunk.insns.len and chunk.insns[idx].base_address == cursor.*);
+        if (in_sync) {
+            cursor.* = chunk.end_address;
+            return chunk.insns[idx..];
+        }
+
+        logger.debug("Chunk @ 0x{x} out of sync with 0x{x}, relifting", .{ chunk.start, cursor.* });
+        var resync = LiftChunk{ .start = cursor.*, .end = chunk.end, .region_start = true };
+        try self.lift_chunk(&self.sleigh_handle, allocator, &resync);
+        cursor.* = resync.end_address;
+        return resync.insns;
+    }
+
     pub fn deinit(self: *Self) void {
         self.sleigh_handle.deinit();
         self.register_map.deinit();
+        self.spaces.deinit();
+        self.stack_pointer.deinit();
+        if (self.lift_cache) |*cache| {
+            cache.close();
+        }
+        for (self.lift_arenas.items) |*arena| {
+            arena.deinit();
+        }
+        self.lift_arenas.deinit();
+        self.* = undefined;
+    }
+};
+
+/// Stack pointer registers of a spec as register space offsets, lets the
+/// range summaries test op outputs for stack pointer writes without turning
+/// every output into a register first.
+///
+/// The same registers as `sleigh.EffectSet` slots let a summary test the
+/// `writes` of the instruction instead of any output at all. That is only
+/// `exact` if every one of them has a slot of its own, and every slot is
+/// held by a register that is named like a stack pointer itself (not eg. a
+/// status register with a stack pointer bank inside of it).
+pub const StackPointerSet = struct {
+    /// index of the register space
+    space: u32 = NO_SPACE,
+    /// `[start, end)` offsets of every register named like a stack pointer,
+    /// same naming rule as `ShardOperation.modifies_sp()`
+    spans: []const Span = &.{},
+    /// effect slots of the registers in `spans`
+    mask: sleigh.EffectSet.Words = sleigh.EffectSet.empty,
+    /// a write of `mask` is exactly a write overlapping `spans`
+    exact: bool = false,
+    allocator: ?std.mem.Allocator = null,
+
+    const NO_SPACE = std.math.maxInt(u32);
+
+    pub const Span = struct {
+        start: u64,
+        end: u64,
+    };
+
+    const Self = @This();
+
+    /// `list` is the SLEIGH list `register_map` was loaded from
+    pub fn init(spaces: *const sleigh.SpaceTable, register_map: *const RegisterMap, list: *const sleigh.RegisterList, allocator: std.mem.Allocator) !Self {
+        var spans = std.ArrayList(Span).init(allocator);
+        errdefer spans.deinit();
+
+        for (register_map.items()) |reg| {
+            if (is_stack_pointer(&reg)) {
+                try spans.append(Span{ .start = reg.offset_key, .end = reg.offset_key + reg.size });
+            }
+        }
+
+        // registers come widest first, so the first one with a slot holds it
+        var mask = sleigh.EffectSet.empty;
+        var exact = list.slot_table().len == register_map.items().len;
+        var held = sleigh.EffectSet.empty;
+        var held_by_sp = sleigh.EffectSet.empty;
+        if (exact) {
+            const slots = list.slot_table();
+            const regs = register_map.items();
+            for (list.space_start..list.space_start + list.space_count) |id| {
+                const slot = slots[id];
+                const named = is_stack_pointer(&regs[id]);
+                if (!sleigh.EffectSet.has(held, slot)) {
+                    sleigh.EffectSet.set(&held, slot);
+                    if (named) {
+                        sleigh.EffectSet.set(&held_by_sp, slot);
+                    }
+                }
+                if (named) {
+                    sleigh.EffectSet.set(&mask, slot);
+                }
+            }
+
+            for (mask, held_by_sp) |word, named| {
+                exact = exact and word & ~named == 0;
+            }
+            exact = exact and !sleigh.EffectSet.has(mask, sleigh.EffectSet.OTHER);
+        }
+
+        var space: u32 = NO_SPACE;
+        for (spaces.kinds, 0..) |kind, idx| {
+            const known = kind orelse continue;
+            if (known == .REGISTER) {
+                space = @intCast(idx);
+                break;
+            }
+        }
+
+        return Self{ .space = space, .spans = try spans.toOwnedSlice(), .mask = mask, .exact = exact, .allocator = allocator };
+    }
+
+    fn is_stack_pointer(reg: *const RegisterImpl) bool {
+        return std.mem.containsAtLeast(u8, &reg.name, 1, "sp");
+    }
+
+    pub fn deinit(self: *Self) void {
+        if (self.allocator) |allocator| {
+            allocator.free(self.spans);
+        }
         self.* = undefined;
     }
+
+    /// Does a write of `size` bytes at `offset` of `space` touch a stack pointer
+    pub fn overlaps(self: *const Self, space: u32, offset: u64, size: u32) bool {
+        if (space != self.space) {
+            return false;
+        }
+
+        for (self.spans) |span| {
+            if (offset < span.end and span.start < offset + size) {
+                return true;
+            }
+        }
+        return false;
+    }
 };
 
 /// Summarization of an affiliated sequence of `ShardOperation`'s.
@@ -263,6 +1434,59 @@ pub const SemanticSummary = struct {
         }
         return out;
     }
+
+    /// Same as `SemanticSummary.summarize()` except it scans the op columns
+    /// of `insn` inside of `range` directly, without translating anything.
+    ///
+    /// `modify_sp` is set by any output overlapping `stack_pointer`, which
+    /// also catches partial writes of the stack pointer.
+    pub fn summarize_range(range: *const sleigh.LiftedRange, insn: *const sleigh.RangeInsnDesc, stack_pointer: *const StackPointerSet) Self {
+        var out = Self.empty();
+
+        for (range.opcodes(insn)) |opcode| {
+            switch (opcodes.ShardOps.from_sleigh(opcode)) {
+                .unimplemented => out.unimpl = true,
+                .ret => out.ret = true,
+                .branch, .branch_conditional, .branch_indirect => out.jump = true,
+                .call, .call_indirect => out.call = true,
+                else => {},
+            }
+        }
+
+        const vns = range.varnodes();
+        const offsets = vns.items(.offset);
+        const sizes = vns.items(.size);
+        const spaces = vns.items(.space);
+        for (range.ops().items(.output)[insn.op_start..][0..insn.op_count]) |vn| {
+            if (vn != sleigh.RangePcodeOp.NO_OUTPUT and stack_pointer.overlaps(spaces[vn], offsets[vn], sizes[vn])) {
+                out.modify_sp = true;
+                break;
+            }
+        }
+
+        return out;
+    }
+
+    /// Same as `SemanticSummary.summarize_range()` except it is read off of
+    /// the `effects` SLEIGH summed up `insn` with. The op columns are only
+    /// scanned when `stack_pointer` can't tell a stack pointer write from
+    /// the `writes` bitset alone.
+    pub fn from_effects(range: *const sleigh.LiftedRange, insn: *const sleigh.RangeInsnDesc, effects: *const sleigh.InsnEffects, stack_pointer: *const StackPointerSet) Self {
+        const Effects = sleigh.InsnEffects;
+
+        var out = Self.empty();
+        out.unimpl = effects.has(Effects.CALLOTHER | Effects.COMPUTE);
+        out.ret = effects.has(Effects.RETURN);
+        out.jump = effects.has(Effects.BRANCH);
+        out.call = effects.has(Effects.CALL);
+
+        if (stack_pointer.exact) {
+            out.modify_sp = sleigh.EffectSet.intersects(effects.writes, stack_pointer.mask);
+        } else if (sleigh.EffectSet.intersects(effects.writes, stack_pointer.mask) or sleigh.EffectSet.has(effects.writes, sleigh.EffectSet.OTHER)) {
+            out.modify_sp = summarize_range(range, insn, stack_pointer).modify_sp;
+        }
+        return out;
+    }
 };
 
 /// A container that wraps underlying `ShardOperation`'s and holds
@@ -271,6 +1495,9 @@ pub const SemanticSummary = struct {
 /// TODO: rename to `ShardBlock` or something
 pub const ShardInsn = struct {
     summary: SemanticSummary,
+    /// what the instruction reads + writes, `none` unless it was lifted out
+    /// of a `LiftedRange`
+    effects: sleigh.InsnEffects = sleigh.InsnEffects.none,
     size: u64,
     base_address: u64,
     operations: []ShardOperation,
@@ -296,6 +1523,21 @@ pub const ShardInsn = struct {
         //}
         return Self{ .summary = summary, .size = size, .base_address = base_address, .operations = operations, .text = text };
     }
+
+    /// Same as `ShardInsn.from_sleigh()` except for an instruction inside
+    /// of a `LiftedRange`, summarized straight from the range columns
+    pub fn from_lifted_range(range: *const sleigh.LiftedRange, insn: *const sleigh.RangeInsnDesc, spaces: *const sleigh.SpaceTable, register_map: *const RegisterMap, stack_pointer: *const StackPointerSet, allocator: std.mem.Allocator) !Self {
+        const text = try range.to_asm(insn, allocator);
+
+        const operations = try allocator.alloc(ShardOperation, insn.op_count);
+        for (operations, insn.op_start..) |*operation, op_idx| {
+            operation.* = try ShardOperation.from_range_op(range, op_idx, spaces, register_map, allocator);
+        }
+
+        const effects = range.effects_of(insn);
+        const summary = SemanticSummary.from_effects(range, insn, effects, stack_pointer);
+        return Self{ .summary = summary, .effects = effects.*, .size = insn.size, .base_address = insn.address, .operations = operations, .text = text };
+    }
 };
 
 /// Applies the callback `func` to each instruction in the `[]ShardMemoryRegion`'s owned by `target`
@@ -318,6 +1560,455 @@ pub fn ShardTargetInsnIterator(comptime T: type, target: ShardInputTarget, func:
     _ = max_address;
 }
 
+// modules nothing here calls into still get their tests run
+test {
+    _ = egraph;
+    _ = chain_search;
+    _ = @import("union_find.zig");
+}
+
+test "parallel lift matches serial lift" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    // enough `andeq r0, r0, r0` to be split into a few chunks
+    const data = try allocator.alloc(u8, 4 * MIN_CHUNK_SIZE);
+    @memset(data, 0);
+    var regions = [_]ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "zeros"), .base_address = 0, .data = data }};
+
+    var target = ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var shard_rt = ShardRuntime.init(allocator);
+    defer shard_rt.deinit();
+    try shard_rt.load_target(target);
+
+    const serial = try shard_rt.perform_lift();
+    const parallel = try shard_rt.perform_lift_parallel(4);
+
+    try std.testing.expectEqual(serial.items.len, parallel.items.len);
+    for (serial.items, parallel.items) |a, b| {
+        try std.testing.expectEqual(a.base_address, b.base_address);
+        try std.testing.expectEqual(a.size, b.size);
+    }
+}
+
+test "skewed functions lift like the serial lift" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    // one function to split a few times over + a lot of tiny leaves
+    var regions: [41]ShardMemoryRegion = undefined;
+    for (&regions, 0..) |*region, idx| {
+        const data = try allocator.alloc(u8, if (idx == 0) 6 * MIN_CHUNK_SIZE + 0x44 else 0x40);
+        @memset(data, 0);
+        const base = if (idx == 0) 0 else 8 * MIN_CHUNK_SIZE + @as(u64, idx) * 0x1000;
+        region.* = .{ .name = try allocator.dupe(u8, "function"), .base_address = base, .data = data };
+    }
+
+    var target = ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var shard_rt = ShardRuntime.init(allocator);
+    defer shard_rt.deinit();
+    try shard_rt.load_target(target);
+
+    const serial = try shard_rt.perform_lift();
+    const parallel = try shard_rt.perform_lift_parallel(4);
+
+    // the big function was lifted in pieces, and nothing twice
+    try std.testing.expect(shard_rt.profile.chunks > regions.len);
+    try std.testing.expectEqual(serial.items.len, parallel.items.len);
+    for (serial.items, parallel.items) |a, b| {
+        try std.testing.expectEqual(a.base_address, b.base_address);
+        try std.testing.expectEqual(a.size, b.size);
+    }
+}
+
+/// Collects what `ShardRuntime.perform_lift_streaming()` hands over
+const TestStreamConsumer = struct {
+    insns: std.ArrayList(ShardInsn),
+    batches: usize = 0,
+
+    pub fn consume(self: *TestStreamConsumer, insns: []const ShardInsn) !void {
+        // only the addresses + sizes are compared, nothing the batch owns
+        self.batches += 1;
+        try self.insns.appendSlice(insns);
+    }
+};
+
+test "streaming lift matches serial lift" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    // enough `andeq r0, r0, r0` for more chunks than the ring holds
+    const data = try allocator.alloc(u8, 10 * STREAM_CHUNK_SIZE + 0x123);
+    @memset(data, 0);
+    var regions = [_]ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "zeros"), .base_address = 0, .data = data }};
+
+    var target = ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var shard_rt = ShardRuntime.init(allocator);
+    defer shard_rt.deinit();
+    try shard_rt.load_target(target);
+
+    const serial = try shard_rt.perform_lift();
+    var consumer = TestStreamConsumer{ .insns = std.ArrayList(ShardInsn).init(allocator) };
+    try shard_rt.perform_lift_streaming(2, &consumer);
+
+    try std.testing.expectEqual(@as(usize, 11), consumer.batches);
+    try std.testing.expectEqual(serial.items.len, consumer.insns.items.len);
+    for (serial.items, consumer.insns.items) |a, b| {
+        try std.testing.expectEqual(a.base_address, b.base_address);
+        try std.testing.expectEqual(a.size, b.size);
+    }
+}
+
+test "numa placed + huge page lifts match serial lift" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    const data = try allocator.alloc(u8, 6 * STREAM_CHUNK_SIZE + 0x44);
+    @memset(data, 0);
+    var regions = [_]ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "zeros"), .base_address = 0, .data = data }};
+
+    var target = ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var shard_rt = ShardRuntime.init(allocator);
+    defer shard_rt.deinit();
+    try shard_rt.load_target(target);
+
+    const serial = try shard_rt.perform_lift();
+    shard_rt.set_numa(true);
+    shard_rt.set_huge_pages(true);
+    const parallel = try shard_rt.perform_lift_parallel(4);
+    const parallel_profile = shard_rt.profile;
+    var consumer = TestStreamConsumer{ .insns = std.ArrayList(ShardInsn).init(allocator) };
+    try shard_rt.perform_lift_streaming(2, &consumer);
+
+    for ([_][]const ShardInsn{ parallel.items, consumer.insns.items }) |placed| {
+        try std.testing.expectEqual(serial.items.len, placed.len);
+        for (serial.items, placed) |a, b| {
+            try std.testing.expectEqual(a.base_address, b.base_address);
+            try std.testing.expectEqual(a.size, b.size);
+        }
+    }
+
+    // every chunk (split or not) counts towards the node it was lifted on
+    for ([_]LiftProfile{ parallel_profile, shard_rt.profile }) |profile| {
+        var chunks: u64 = 0;
+        var bytes: u64 = 0;
+        for (profile.nodes) |node| {
+            chunks += node.chunks;
+            bytes += node.bytes;
+        }
+        try std.testing.expectEqual(profile.chunks, chunks);
+        try std.testing.expectEqual(@as(u64, data.len), bytes);
+    }
+}
+
+test "all offsets lift overlaps across chunks" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    // `andeq r0, r0, r0` decodes at every half word too
+    const data = try allocator.alloc(u8, 4 * MIN_CHUNK_SIZE);
+    @memset(data, 0);
+    var regions = [_]ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "zeros"), .base_address = 0, .data = data }};
+
+    var target = ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var shard_rt = ShardRuntime.init(allocator);
+    defer shard_rt.deinit();
+    try shard_rt.load_target(target);
+
+    const aligned = try shard_rt.perform_lift();
+    shard_rt.set_all_offsets(true);
+    const serial = try shard_rt.perform_lift();
+    const parallel = try shard_rt.perform_lift_parallel(4);
+
+    const step = try shard_rt.sleigh_handle.alignment();
+    try std.testing.expect(step < 4);
+    try std.testing.expect(serial.items.len > aligned.items.len);
+    try std.testing.expectEqual(serial.items.len, parallel.items.len);
+    for (serial.items, parallel.items, 0..) |a, b, idx| {
+        try std.testing.expectEqual(@as(u64, idx) * step, a.base_address);
+        try std.testing.expectEqual(a.base_address, b.base_address);
+        try std.testing.expectEqual(a.size, b.size);
+    }
+}
+
+test "gadgets of an all offsets lift are lifted on their own" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    // `mov r0, #0; bx lr` twice, with something decoding at every half word
+    const data = try allocator.dupe(u8, &.{ 0x00, 0x00, 0xa0, 0xe3, 0x1e, 0xff, 0x2f, 0xe1, 0x00, 0x00, 0xa0, 0xe3, 0x1e, 0xff, 0x2f, 0xe1 });
+    var regions = [_]ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "code"), .base_address = 0, .data = data }};
+
+    var target = ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var shard_rt = ShardRuntime.init(allocator);
+    defer shard_rt.deinit();
+    try shard_rt.load_target(target);
+
+    shard_rt.set_all_offsets(true);
+    const lifted = try shard_rt.perform_lift_parallel(2);
+    try std.testing.expect(lifted.items.len > 4);
+
+    var semantics = egraph.GadgetSemantics.init(allocator);
+    defer semantics.deinit();
+    for ([_]u64{ 0x0, 0x8 }) |address| {
+        var range = sleigh.LiftedRange{};
+        try shard_rt.lift_gadget(address, 8, &range);
+        defer shard_rt.sleigh_handle.release_range(&range);
+        try std.testing.expectEqual(@as(u64, 2), range.insn_count);
+        _ = try semantics.add(&range, &shard_rt.spaces);
+    }
+    _ = try semantics.saturate(.{});
+    try std.testing.expect(semantics.same(0, 1));
+
+    // and the lifts after it still decode every offset
+    var all = sleigh.LiftedRange{};
+    try shard_rt.sleigh_handle.lift_range(0x0, 0x8, &all);
+    defer shard_rt.sleigh_handle.release_range(&all);
+    try std.testing.expect(all.insn_count > 2);
+}
+
+test "range summaries match the operation summaries" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    // `push {lr}; bx lr; b .; andeq r0, r0, r0`
+    const data = try allocator.dupe(u8, &.{ 0x04, 0xe0, 0x2d, 0xe5, 0x1e, 0xff, 0x2f, 0xe1, 0xfe, 0xff, 0xff, 0xea, 0, 0, 0, 0 });
+    var regions = [_]ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "code"), .base_address = 0, .data = data }};
+
+    var target = ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var shard_rt = ShardRuntime.init(allocator);
+    defer shard_rt.deinit();
+    try shard_rt.load_target(target);
+
+    const insns = try shard_rt.perform_lift();
+    try std.testing.expectEqual(@as(usize, 4), insns.items.len);
+    for (insns.items) |insn| {
+        const expected = SemanticSummary.summarize(insn.operations);
+        try std.testing.expectEqual(expected.ret, insn.summary.ret);
+        try std.testing.expectEqual(expected.jump, insn.summary.jump);
+        try std.testing.expectEqual(expected.call, insn.summary.call);
+        try std.testing.expectEqual(expected.unimpl, insn.summary.unimpl);
+        try std.testing.expectEqual(expected.modify_sp, insn.summary.modify_sp);
+    }
+    try std.testing.expect(insns.items[0].summary.modify_sp);
+    try std.testing.expect(!insns.items[3].summary.modify_sp);
+
+    // `push {lr}` moves the stack pointer by a constant, `bx lr` doesn't
+    try std.testing.expectEqual(@as(i64, -4), insns.items[0].effects.sp_delta);
+    try std.testing.expect(insns.items[0].effects.has(sleigh.InsnEffects.STORE));
+    try std.testing.expectEqual(@as(i64, 0), insns.items[1].effects.sp_delta);
+    try std.testing.expect(insns.items[1].effects.has(sleigh.InsnEffects.BRANCH));
+}
+
+test "anchors are the indirect flow of the serial lift" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    // `push {lr}; bx lr; b .; blx r3; andeq r0, r0, r0`
+    const data = try allocator.dupe(u8, &.{ 0x04, 0xe0, 0x2d, 0xe5, 0x1e, 0xff, 0x2f, 0xe1, 0xfe, 0xff, 0xff, 0xea, 0x33, 0xff, 0x2f, 0xe1, 0, 0, 0, 0 });
+    var regions = [_]ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "code"), .base_address = 0, .data = data }};
+
+    var target = ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var shard_rt = ShardRuntime.init(allocator);
+    defer shard_rt.deinit();
+    try shard_rt.load_target(target);
+
+    const anchors = try shard_rt.find_anchors();
+    defer anchors.deinit();
+    try std.testing.expectEqualSlices(u64, &.{ 0x4, 0xc }, anchors.items);
+
+    // the single instruction lifts agree with the sweep
+    const insns = try shard_rt.perform_lift();
+    for (insns.items) |insn| {
+        const single = (try shard_rt.lift_at(insn.base_address, allocator)).?;
+        try std.testing.expectEqual(insn.size, single.size);
+        try std.testing.expectEqual(insn.summary, single.summary);
+        try std.testing.expectEqualStrings(insn.text, single.text);
+    }
+}
+
+test "cached lift matches the fresh lift" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const cache_path = try std.fmt.allocPrint(allocator, "zig-cache/tmp/{s}/lifts", .{tmp.sub_path});
+
+    // `push {lr}; ldr r0, [r1]; bx lr`
+    const data = try allocator.dupe(u8, &.{ 0x04, 0xe0, 0x2d, 0xe5, 0x00, 0x00, 0x91, 0xe5, 0x1e, 0xff, 0x2f, 0xe1 });
+    var regions = [_]ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "code"), .base_address = 0, .data = data }};
+    var target = ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var lifts: [2]std.ArrayList(ShardInsn) = undefined;
+    for (&lifts) |*lift| {
+        var shard_rt = ShardRuntime.init(allocator);
+        defer shard_rt.deinit();
+        try shard_rt.load_target(target);
+        try shard_rt.use_lift_cache(cache_path);
+        lift.* = try shard_rt.perform_lift();
+    }
+
+    // the first lift wrote the whole region out, the second read it back
+    var cache = try LiftCache.open(cache_path, &target, allocator);
+    defer cache.close();
+    var entry = cache.load(0, data.len) orelse return error.TestUnexpectedResult;
+    entry.release();
+
+    try std.testing.expectEqual(lifts[0].items.len, lifts[1].items.len);
+    for (lifts[0].items, lifts[1].items) |a, b| {
+        try std.testing.expectEqual(a.base_address, b.base_address);
+        try std.testing.expectEqual(a.operations.len, b.operations.len);
+        try std.testing.expectEqualStrings(a.text, b.text);
+        try std.testing.expectEqual(a.summary, b.summary);
+    }
+}
+
+test "content chunks reuse the lifts of another image" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const cache_path = try std.fmt.allocPrint(allocator, "zig-cache/tmp/{s}/lifts", .{tmp.sub_path});
+
+    // `bl` + `mov` soup, long enough for a few chunks
+    const data = try allocator.alloc(u8, 96 * 1024);
+    for (std.mem.bytesAsSlice(u32, data), 0..) |*word, idx| {
+        const bits: u32 = @truncate(std.hash.Wyhash.hash(0, std.mem.asBytes(&idx)));
+        word.* = if (bits & 1 == 0) 0xeb000000 | (bits >> 8) else 0xe3a00000 | (bits & 0xf000) | (bits >> 20);
+    }
+
+    // the build that was lifted first + the same code somewhere else
+    var lifts: [3]std.ArrayList(ShardInsn) = undefined;
+    for (&lifts, [_]u64{ 0x10000, 0x80000, 0x80000 }, [_]bool{ true, true, false }) |*lift, base, cached| {
+        var regions = [_]ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "code"), .base_address = base, .data = data }};
+        var target = ShardInputTarget.from_regions(&regions);
+        target.setSlaPath("./specfiles/ARM8_le.sla");
+
+        var shard_rt = ShardRuntime.init(allocator);
+        defer shard_rt.deinit();
+        try shard_rt.load_target(target);
+        shard_rt.set_content_chunks(true);
+        if (cached) {
+            try shard_rt.use_lift_cache(cache_path);
+        }
+        lift.* = try shard_rt.perform_lift();
+    }
+
+    // relocated out of the cache or lifted from scratch, it's the same
+    try std.testing.expectEqual(lifts[2].items.len, lifts[1].items.len);
+    for (lifts[2].items, lifts[1].items) |a, b| {
+        try std.testing.expectEqual(a.base_address, b.base_address);
+        try std.testing.expectEqual(a.operations.len, b.operations.len);
+        try std.testing.expectEqualStrings(a.text, b.text);
+        try std.testing.expectEqual(a.summary, b.summary);
+    }
+}
+
+test "content chunks only reuse the lifts of the same context" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const cache_path = try std.fmt.allocPrint(allocator, "zig-cache/tmp/{s}/lifts", .{tmp.sub_path});
+
+    const data = try allocator.alloc(u8, 96 * 1024);
+    for (std.mem.bytesAsSlice(u32, data), 0..) |*word, idx| {
+        const bits: u32 = @truncate(std.hash.Wyhash.hash(0, std.mem.asBytes(&idx)));
+        word.* = if (bits & 1 == 0) 0xeb000000 | (bits >> 8) else 0xe3a00000 | (bits & 0xf000) | (bits >> 20);
+    }
+
+    // the same bytes twice, the second copy in Thumb
+    var lifts: [2]std.ArrayList(ShardInsn) = undefined;
+    for (&lifts, [_]bool{ false, true }) |*lift, cached| {
+        var regions = [_]ShardMemoryRegion{
+            .{ .name = try allocator.dupe(u8, "arm"), .base_address = 0x0, .data = data },
+            .{ .name = try allocator.dupe(u8, "thumb"), .base_address = 0x80000, .data = data },
+        };
+        var context_regions = [_]targets.SleighContextRegion{.{ .variable = "TMode", .start = 0x80000, .end = 0x80000 + data.len, .value = 1 }};
+        var target = ShardInputTarget.from_regions(&regions);
+        target.setSlaPath("./specfiles/ARM8_le.sla");
+        target.setContextRegions(&context_regions);
+
+        var shard_rt = ShardRuntime.init(allocator);
+        defer shard_rt.deinit();
+        try shard_rt.load_target(target);
+        shard_rt.set_content_chunks(true);
+        if (cached) {
+            try shard_rt.use_lift_cache(cache_path);
+        }
+        lift.* = try shard_rt.perform_lift();
+    }
+
+    try std.testing.expectEqual(lifts[0].items.len, lifts[1].items.len);
+    for (lifts[0].items, lifts[1].items) |a, b| {
+        try std.testing.expectEqual(a.base_address, b.base_address);
+        try std.testing.expectEqualStrings(a.text, b.text);
+    }
+}
+
+test "block lift only holds the reachable instructions" {
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    // `push {lr}; bl 0x10; pop {pc}`, a literal, `mov r0, #1; bx lr`
+    const data = try allocator.dupe(u8, &.{
+        0x04, 0xe0, 0x2d, 0xe5, 0x01, 0x00, 0x00, 0xeb,
+        0x04, 0xf0, 0x9d, 0xe4, 0xef, 0xbe, 0xad, 0xde,
+        0x01, 0x00, 0xa0, 0xe3, 0x1e, 0xff, 0x2f, 0xe1,
+    });
+    var regions = [_]ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "code"), .base_address = 0, .data = data }};
+    var target = ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var shard_rt = ShardRuntime.init(allocator);
+    defer shard_rt.deinit();
+    try shard_rt.load_target(target);
+
+    const seeds = try shard_rt.cfg_seeds();
+    var graph = try shard_rt.recover_cfg(seeds, 2);
+    defer graph.deinit();
+    const insns = try shard_rt.perform_lift_blocks(&graph, 2);
+
+    var addresses: [5]u64 = undefined;
+    try std.testing.expectEqual(@as(usize, 5), insns.items.len);
+    for (insns.items, &addresses) |insn, *address| {
+        address.* = insn.base_address;
+    }
+    try std.testing.expectEqualSlices(u64, &.{ 0x0, 0x4, 0x8, 0x10, 0x14 }, &addresses);
+}
+
 test "Full package test" {
     std.testing.refAllDeclsRecursive(@This());
 }
@@ -0,0 +1,395 @@
+//! Control flow graph recovery by recursive descent.
+//!
+//! Instead of sweeping every byte of an image, only the code reachable from
+//! a set of seeds (the entry point, the functions of a Ghidra dump) is
+//! decoded: every basic block hands back the constant targets of the
+//! branches + calls in its p-code (`SleighState.block_flow()`), and those
+//! are decoded next. Padding and literal pools nothing branches to are never
+//! decoded at all.
+//!
+//! The worklist is shared by every thread, each decoding blocks with its own
+//! forked handle. A block that a branch lands in the middle of is split so
+//! every block starts at a leader, and the blocks + edges end up in two
+//! flat arrays sorted by address.
+const std = @import("std");
+const testing = std.testing;
+const sleigh = @import("../sleigh.zig");
+const memory = @import("memory.zig");
+
+const SleighState = sleigh.SleighState;
+const BlockEdge = sleigh.BlockEdge;
+const BlockFlow = sleigh.BlockFlow;
+const ShardMemoryRegion = memory.ShardMemoryRegion;
+
+const logger = std.log.scoped(.shard_cfg);
+
+/// Edges of a block each `SleighState.block_flow()` call has room for, a
+/// jump table in the p-code of one instruction is the only way past it
+const BLOCK_EDGES = 16;
+
+/// Basic block of a `ControlFlowGraph`
+pub const CfgBlock = struct {
+    start: u64,
+    /// first address past its last instruction
+    end: u64,
+    insn_count: u32,
+    /// its edges are `ControlFlowGraph.edges[edge_start..][0..edge_count]`
+    edge_start: u32,
+    edge_count: u32,
+    /// `sleigh.InsnFlow` flags of how its last instruction leaves it, 0 if
+    /// it only runs into the next block
+    flow: u32,
+};
+
+/// Edge from a `CfgBlock` to `target`
+pub const CfgEdge = struct {
+    target: u64,
+    kind: sleigh.BlockEdgeKind,
+    /// index of the block starting at `target`, or `NO_BLOCK` if the
+    /// target is outside of every region
+    block: u32,
+
+    pub const NO_BLOCK = std.math.maxInt(u32);
+};
+
+/// Blocks found by the threads, in whatever order they were decoded
+const Worklist = struct {
+    lock: std.Thread.Mutex = .{},
+    ready: std.Thread.Condition = .{},
+    /// sorted by base address
+    regions: []const ShardMemoryRegion,
+    pending: std.ArrayList(u64),
+    /// every address ever pushed onto `pending`
+    seen: std.AutoHashMap(u64, void),
+    blocks: std.ArrayList(BlockFlow),
+    edges: std.ArrayList(BlockEdge),
+    /// threads decoding a block they took
+    busy: usize = 0,
+    err: ?anyerror = null,
+
+    const Self = @This();
+
+    /// End of the region holding `address`, `null` if none does
+    fn region_end(self: *const Self, address: u64) ?u64 {
+        for (self.regions) |region| {
+            if (address >= region.base_address and address - region.base_address < region.len()) {
+                return region.base_address + region.len();
+            }
+        }
+        return null;
+    }
+
+    /// Queues `address` unless it was already or is outside of every
+    /// region, the lock must be held
+    fn push(self: *Self, address: u64) !void {
+        if (self.region_end(address) == null) {
+            return;
+        }
+        const slot = try self.seen.getOrPut(address);
+        if (slot.found_existing) {
+            return;
+        }
+        try self.pending.append(address);
+        self.ready.signal();
+    }
+
+    /// Next block to decode, `null` once every thread is out of work
+    fn take(self: *Self) ?u64 {
+        self.lock.lock();
+        defer self.lock.unlock();
+
+        while (self.pending.items.len == 0) {
+            if (self.busy == 0 or self.err != null) {
+                self.ready.broadcast();
+                return null;
+            }
+            self.ready.wait(&self.lock);
+        }
+        if (self.err != null) {
+            return null;
+        }
+
+        self.busy += 1;
+        return self.pending.pop();
+    }
+
+    /// Keeps the decoded `block` + `edges` and queues their targets
+    fn finish(self: *Self, block: BlockFlow, edges: []const BlockEdge) void {
+        self.lock.lock();
+        defer self.lock.unlock();
+
+        self.busy -= 1;
+        self.keep(block, edges) catch |err| {
+            self.err = err;
+        };
+        if (self.busy == 0 and self.pending.items.len == 0) {
+            self.ready.broadcast();
+        }
+    }
+
+    fn keep(self: *Self, block: BlockFlow, edges: []const BlockEdge) !void {
+        var kept = block;
+        kept.edge_count = edges.len;
+        try self.blocks.append(kept);
+        try self.edges.appendSlice(edges);
+        for (edges) |edge| {
+            try self.push(edge.target);
+        }
+    }
+
+    /// Stops every thread with `err`
+    fn fail(self: *Self, err: anyerror) void {
+        self.lock.lock();
+        defer self.lock.unlock();
+
+        self.busy -= 1;
+        self.err = err;
+        self.ready.broadcast();
+    }
+};
+
+/// Decodes blocks off of `work` with `handle` until it runs out
+fn recover_worker(work: *Worklist, handle: *SleighState) void {
+    var edges: [BLOCK_EDGES]BlockEdge = undefined;
+    while (work.take()) |address| {
+        // only pushed if some region holds it
+        const end = work.region_end(address).?;
+        const block = handle.block_flow(address, end, &edges) catch |err| {
+            work.fail(err);
+            return;
+        };
+        if (block.edge_count > edges.len) {
+            logger.warn("Block @ 0x{x} has {} edges, only following {}", .{ address, block.edge_count, edges.len });
+        }
+        work.finish(block, edges[0..@min(block.edge_count, edges.len)]);
+    }
+}
+
+/// Basic blocks + edges of the code reachable from a set of seeds
+pub const ControlFlowGraph = struct {
+    /// sorted by `start`, no two start at the same address
+    blocks: []CfgBlock,
+    edges: []CfgEdge,
+    allocator: std.mem.Allocator,
+
+    const Self = @This();
+
+    /// Decodes every block reachable from `seeds` inside of `regions`, the
+    /// calling thread works with `handle` and every one of `forks` gets a
+    /// thread of its own. The handles must all have `regions` loaded.
+    pub fn recover(handle: *SleighState, forks: []SleighState, regions: []const ShardMemoryRegion, seeds: []const u64, allocator: std.mem.Allocator) !Self {
+        const sorted = try allocator.dupe(ShardMemoryRegion, regions);
+        defer allocator.free(sorted);
+        std.mem.sort(ShardMemoryRegion, sorted, {}, ShardMemoryRegion.baseAddressLessThan);
+
+        var work = Worklist{
+            .regions = sorted,
+            .pending = std.ArrayList(u64).init(allocator),
+            .seen = std.AutoHashMap(u64, void).init(allocator),
+            .blocks = std.ArrayList(BlockFlow).init(allocator),
+            .edges = std.ArrayList(BlockEdge).init(allocator),
+        };
+        defer {
+            work.pending.deinit();
+            work.seen.deinit();
+            work.blocks.deinit();
+            work.edges.deinit();
+        }
+        for (seeds) |seed| {
+            try work.push(seed);
+        }
+
+        const threads = try allocator.alloc(std.Thread, forks.len);
+        defer allocator.free(threads);
+        var spawned: usize = 0;
+        while (spawned < threads.len) : (spawned += 1) {
+            threads[spawned] = std.Thread.spawn(.{}, recover_worker, .{ &work, &forks[spawned] }) catch |err| {
+                logger.warn("Failed to spawn cfg thread: {}", .{err});
+                break;
+            };
+        }
+        recover_worker(&work, handle);
+        for (threads[0..spawned]) |thread| {
+            thread.join();
+        }
+        if (work.err) |err| {
+            return err;
+        }
+
+        return build(work.blocks.items, work.edges.items, allocator);
+    }
+
+    /// Splits the decoded `found` blocks at every block starting inside of
+    /// them and lays them out sorted by address
+    fn build(found: []BlockFlow, found_edges: []const BlockEdge, allocator: std.mem.Allocator) !Self {
+        // every decoded block has its edges right after the ones before it
+        const edge_starts = try allocator.alloc(u64, found.len);
+        defer allocator.free(edge_starts);
+        var edge_start: u64 = 0;
+        for (found, edge_starts) |block, *start| {
+            start.* = edge_start;
+            edge_start += block.edge_count;
+        }
+
+        // a block a branch lands in is decoded again from there, ending at
+        // the same address. So the blocks sharing an end are the suffixes
+        // of the longest one, each is cut off at the next
+        const order = try allocator.alloc(u32, found.len);
+        defer allocator.free(order);
+        for (order, 0..) |*idx, i| {
+            idx.* = @intCast(i);
+        }
+        std.mem.sort(u32, order, found, end_then_start);
+
+        var blocks = try std.ArrayList(CfgBlock).initCapacity(allocator, found.len);
+        errdefer blocks.deinit();
+        var edges = std.ArrayList(CfgEdge).init(allocator);
+        errdefer edges.deinit();
+        for (order, 0..) |idx, pos| {
+            const block = found[idx];
+            const next: ?BlockFlow = if (pos + 1 < order.len and found[order[pos + 1]].end == block.end) found[order[pos + 1]] else null;
+
+            // (unless they didn't line up, eg. x86 decoding inside of an
+            // instruction, then they just overlap)
+            if (next != null and next.?.insn_count < block.insn_count) {
+                try edges.append(CfgEdge{ .target = next.?.start, .kind = .fallthrough, .block = CfgEdge.NO_BLOCK });
+                blocks.appendAssumeCapacity(CfgBlock{
+                    .start = block.start,
+                    .end = next.?.start,
+                    .insn_count = @intCast(block.insn_count - next.?.insn_count),
+                    .edge_start = @intCast(edges.items.len - 1),
+                    .edge_count = 1,
+                    .flow = 0,
+                });
+                continue;
+            }
+
+            const start = edges.items.len;
+            for (found_edges[edge_starts[idx]..][0..block.edge_count]) |edge| {
+                try edges.append(CfgEdge{ .target = edge.target, .kind = edge.kind, .block = CfgEdge.NO_BLOCK });
+            }
+            blocks.appendAssumeCapacity(CfgBlock{
+                .start = block.start,
+                .end = block.end,
+                .insn_count = @intCast(block.insn_count),
+                .edge_start = @intCast(start),
+                .edge_count = @intCast(block.edge_count),
+                .flow = @intCast(block.flow),
+            });
+        }
+
+        // blocks in address order, their edges kept where they are
+        std.mem.sort(CfgBlock, blocks.items, {}, start_less_than);
+        var out = Self{ .blocks = try blocks.toOwnedSlice(), .edges = &.{}, .allocator = allocator };
+        errdefer allocator.free(out.blocks);
+        out.edges = try edges.toOwnedSlice();
+        for (out.edges) |*edge| {
+            edge.block = out.index_of(edge.target) orelse CfgEdge.NO_BLOCK;
+        }
+        return out;
+    }
+
+    fn end_then_start(found: []BlockFlow, a: u32, b: u32) bool {
+        if (found[a].end != found[b].end) {
+            return found[a].end < found[b].end;
+        }
+        return found[a].start < found[b].start;
+    }
+
+    fn start_less_than(_: void, a: CfgBlock, b: CfgBlock) bool {
+        return a.start < b.start;
+    }
+
+    pub fn deinit(self: *Self) void {
+        self.allocator.free(self.blocks);
+        self.allocator.free(self.edges);
+        self.* = undefined;
+    }
+
+    /// Index into `blocks` of the block starting at `address`
+    pub fn index_of(self: *const Self, address: u64) ?u32 {
+        var lo: usize = 0;
+        var hi = self.blocks.len;
+        while (lo < hi) {
+            const mid = lo + (hi - lo) / 2;
+            if (self.blocks[mid].start < address) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < self.blocks.len and self.blocks[lo].start == address) {
+            return @intCast(lo);
+        }
+        return null;
+    }
+
+    /// Every edge leaving `block`, which must be one of `blocks`
+    pub fn successors(self: *const Self, block: *const CfgBlock) []const CfgEdge {
+        return self.edges[block.edge_start..][0..block.edge_count];
+    }
+
+    /// Instructions in every block added up
+    pub fn insn_count(self: *const Self) u64 {
+        var count: u64 = 0;
+        for (self.blocks) |block| {
+            count += block.insn_count;
+        }
+        return count;
+    }
+};
+
+test "recover the blocks reachable from a seed" {
+    // 0x00: `push {lr}; bl 0x14`
+    // 0x08: `cmp r0, #0; beq 0x1c`
+    // 0x10: `pop {pc}`
+    // 0x14: `mov r0, #1; bx lr`
+    // 0x1c: `b 0xc`, into the middle of the block at 0x8
+    // 0x20: a literal nothing branches to
+    const data = [_]u8{
+        0x04, 0xe0, 0x2d, 0xe5, 0x02, 0x00, 0x00, 0xeb,
+        0x00, 0x00, 0x50, 0xe3, 0x02, 0x00, 0x00, 0x0a,
+        0x04, 0xf0, 0x9d, 0xe4, 0x01, 0x00, 0xa0, 0xe3,
+        0x1e, 0xff, 0x2f, 0xe1, 0xfa, 0xff, 0xff, 0xea,
+        0xef, 0xbe, 0xad, 0xde,
+    };
+    var name = [_]u8{ 'c', 'o', 'd', 'e' };
+    var bytes = data;
+    const regions = [_]ShardMemoryRegion{.{ .name = &name, .base_address = 0, .data = &bytes }};
+
+    var handle = SleighState.init();
+    defer handle.deinit();
+    try handle.add_specfile("./specfiles/ARM8_le.sla");
+    handle.begin();
+    try handle.load_data(0x0, &bytes);
+    var forks = [_]SleighState{try handle.fork()};
+    defer forks[0].deinit();
+
+    var graph = try ControlFlowGraph.recover(&handle, &forks, &regions, &.{0x0}, testing.allocator);
+    defer graph.deinit();
+
+    var starts: [6]u64 = undefined;
+    try testing.expectEqual(@as(usize, 6), graph.blocks.len);
+    for (graph.blocks, &starts) |block, *start| {
+        start.* = block.start;
+    }
+    try testing.expectEqualSlices(u64, &.{ 0x0, 0x8, 0xc, 0x10, 0x14, 0x1c }, &starts);
+    try testing.expectEqual(@as(u64, 8), graph.insn_count());
+
+    // the `cmp` was cut off of the `beq` the `b` lands on
+    const cmp = &graph.blocks[1];
+    try testing.expectEqual(@as(u64, 0xc), cmp.end);
+    try testing.expectEqual(@as(usize, 1), graph.successors(cmp).len);
+    try testing.expectEqual(@as(u32, 2), graph.successors(cmp)[0].block);
+
+    const beq = &graph.blocks[2];
+    try testing.expect(beq.flow & sleigh.InsnFlow.CONDITIONAL != 0);
+    for (graph.successors(beq)) |edge| {
+        try testing.expect(edge.block != CfgEdge.NO_BLOCK);
+    }
+
+    const call = graph.successors(&graph.blocks[0]);
+    try testing.expectEqual(sleigh.BlockEdgeKind.call, call[0].kind);
+    try testing.expectEqual(@as(?u32, 4), graph.index_of(call[0].target));
+    try testing.expectEqual(@as(?u32, null), graph.index_of(0x20));
+}
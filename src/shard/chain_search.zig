@@ -0,0 +1,668 @@
+//! Searches a gadget index for chains: gadgets that, returned into one after
+//! the other, leave every wanted register holding a value popped off of the
+//! stack (eg. `a0,a1` before returning into a call).
+//!
+//! Only what a gadget does to the wanted registers matters to the search:
+//! which of them it pops, which it writes without popping (clobbers) and
+//! how much stack it eats. Gadgets that pop + clobber the same registers and
+//! leave the stack equally aligned are interchangeable apart from that cost,
+//! so only the cheapest one of each is kept. However many gadgets the index
+//! holds, that leaves no more than a few hundred for a handful of registers,
+//! and that pass over every gadget is split across worker threads.
+//!
+//! The search runs over abstract states: the mask of wanted registers set so
+//! far and how far the stack eaten so far is off of the alignment the goal
+//! asks for. It goes one chain length at a time, every state reached with
+//! `n` gadgets is expanded by worker threads into the states first reached
+//! with `n + 1`, keeping the cheapest way to each. A transposition table of
+//! the states reached already expands each one at most once, so a search
+//! visits no more than `2^registers * alignment` states, and finds the
+//! shortest chain, then the one eating the least stack.
+//!
+//! Gadgets go into a chain if they end in a return and move the stack
+//! pointer up by a constant (which also covers the return address).
+//! Ordering matters: a gadget clobbering a register set earlier undoes it,
+//! so such gadgets run first. The chain comes with where the stack of each
+//! gadget starts in the payload, but which of those slots each popped value
+//! goes in isn't in the index, filling them in is left to the caller.
+const std = @import("std");
+const testing = std.testing;
+const gadget_index = @import("gadget_index.zig");
+
+const GadgetHit = gadget_index.GadgetHit;
+const GadgetRecord = gadget_index.GadgetRecord;
+const SegmentView = gadget_index.SegmentView;
+
+const logger = std.log.scoped(.shard_chain_search);
+
+/// Most registers a chain can set, they are tracked as bits of a `u64`
+pub const MAX_REGISTERS = 64;
+
+/// Gadget ids each pruning worker takes at a time
+const PRUNE_BATCH = 4096;
+
+/// States each search worker expands at a time
+const SEARCH_BATCH = 64;
+
+/// What a chain has to do
+pub const ChainGoal = struct {
+    /// registers left holding a value off of the stack
+    registers: []const []const u8 = &.{},
+    /// longest chain looked for, in gadgets
+    max_length: u32 = 8,
+    /// only gadgets that don't write memory
+    no_stores: bool = false,
+    /// the chain eats a multiple of this many stack bytes, so the stack
+    /// pointer ends as aligned as it started (eg. 16 before calling on
+    /// x86-64)
+    stack_align: u32 = 1,
+
+    /// Parses comma separated terms: a register name, `len:<max gadgets>`,
+    /// `align:<stack bytes>` or `nostore`. For example `a0,a1,len:4`.
+    pub fn parse(text: []const u8, allocator: std.mem.Allocator) !ChainGoal {
+        var registers = std.ArrayList([]const u8).init(allocator);
+        errdefer registers.deinit();
+
+        var goal = ChainGoal{};
+        var terms = std.mem.tokenizeScalar(u8, text, ',');
+        while (terms.next()) |term| {
+            if (std.mem.eql(u8, term, "nostore")) {
+                goal.no_stores = true;
+            } else if (std.mem.startsWith(u8, term, "len:")) {
+                goal.max_length = try std.fmt.parseInt(u32, term["len:".len..], 0);
+            } else if (std.mem.startsWith(u8, term, "align:")) {
+                goal.stack_align = try std.fmt.parseInt(u32, term["align:".len..], 0);
+                if (goal.stack_align == 0) {
+                    return error.InvalidGoal;
+                }
+            } else if (std.mem.indexOfScalar(u8, term, ':') == null) {
+                try registers.append(term);
+            } else {
+                return error.InvalidGoal;
+            }
+        }
+
+        if (registers.items.len == 0 or registers.items.len > MAX_REGISTERS) {
+            return error.InvalidGoal;
+        }
+        goal.registers = try registers.toOwnedSlice();
+        return goal;
+    }
+};
+
+/// A chain found by `find_chain()`, the gadgets in the order they run
+pub const Chain = struct {
+    gadgets: []GadgetHit,
+    /// where the stack each gadget eats starts, in bytes past the stack
+    /// pointer the first one runs with
+    frame_offsets: []u64,
+    /// stack every gadget eats added up
+    stack_bytes: u64,
+    /// which image the gadgets are in
+    image_hash: u64,
+
+    fn better(self: *const Chain, other: *const Chain) bool {
+        if (self.gadgets.len != other.gadgets.len) {
+            return self.gadgets.len < other.gadgets.len;
+        }
+        return self.stack_bytes < other.stack_bytes;
+    }
+};
+
+/// A gadget as the search sees it, the masks are bits of the goal registers
+pub const Candidate = struct {
+    id: u32,
+    sets: u64,
+    clobbers: u64,
+    stack_bytes: u64,
+    size: u64,
+
+    fn cheaper(self: Candidate, other: Candidate) bool {
+        if (self.stack_bytes != other.stack_bytes) {
+            return self.stack_bytes < other.stack_bytes;
+        }
+        if (self.size != other.size) {
+            return self.size < other.size;
+        }
+        return self.id < other.id;
+    }
+};
+
+/// What a gadget does to the goal registers and the stack alignment, all
+/// that tells candidates apart
+const Effect = struct {
+    sets: u64,
+    clobbers: u64,
+    misalignment: u64,
+};
+
+const Cheapest = std.AutoArrayHashMap(Effect, Candidate);
+
+/// A gadget's masks of the goal registers, indexed by gadget id
+const Projection = struct {
+    records: []const GadgetRecord,
+    pops: []const u64,
+    writes: []const u64,
+    no_stores: bool,
+    stack_align: u32,
+
+    /// The gadget `id` as a candidate, `null` if it can't be chained or
+    /// sets none of the registers
+    fn candidate(self: *const Projection, id: u32) ?Candidate {
+        const record = &self.records[id];
+        if (self.pops[id] == 0 or record.terminator != .ret) {
+            return null;
+        }
+        if (record.sp_delta == GadgetRecord.SP_UNKNOWN or record.sp_delta <= 0) {
+            return null;
+        }
+        if (self.no_stores and record.stores != 0) {
+            return null;
+        }
+        return Candidate{ .id = id, .sets = self.pops[id], .clobbers = self.writes[id] & ~self.pops[id], .stack_bytes = @intCast(record.sp_delta), .size = record.size };
+    }
+};
+
+/// Hands out batches of indices to the pruning + search workers
+const WorkQueue = struct {
+    next: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    total: u32,
+    batch: u32,
+    lock: std.Thread.Mutex = .{},
+    /// first error of any worker, the results are incomplete once set
+    err: ?anyerror = null,
+
+    fn pop(self: *WorkQueue) ?[2]u32 {
+        const start = self.next.fetchAdd(self.batch, .monotonic);
+        if (start >= self.total) {
+            return null;
+        }
+        return .{ start, @min(start + self.batch, self.total) };
+    }
+
+    /// Keeps `err` if it is the first, and hands out no more batches
+    fn fail(self: *WorkQueue, err: anyerror) void {
+        self.lock.lock();
+        defer self.lock.unlock();
+
+        if (self.err == null) {
+            self.err = err;
+        }
+        self.next.store(self.total, .monotonic);
+    }
+};
+
+/// Keeps the cheapest candidate of every `Effect` out of the batches of
+/// `queue` in `out`
+fn prune_worker(projection: *const Projection, queue: *WorkQueue, out: *Cheapest) void {
+    prune_batches(projection, queue, out) catch |err| {
+        queue.fail(err);
+    };
+}
+
+fn prune_batches(projection: *const Projection, queue: *WorkQueue, out: *Cheapest) !void {
+    while (queue.pop()) |batch| {
+        for (batch[0]..batch[1]) |id| {
+            const found = projection.candidate(@intCast(id)) orelse continue;
+            try keep_cheapest(out, found, projection.stack_align);
+        }
+    }
+}
+
+fn keep_cheapest(cheapest: *Cheapest, found: Candidate, stack_align: u32) !void {
+    const entry = try cheapest.getOrPut(Effect{ .sets = found.sets, .clobbers = found.clobbers, .misalignment = found.stack_bytes % stack_align });
+    if (!entry.found_existing or found.cheaper(entry.value_ptr.*)) {
+        entry.value_ptr.* = found;
+    }
+}
+
+/// The cheapest gadget of `view` for every way of setting + clobbering the
+/// `goal` registers and misaligning the stack, in no particular order. The gadgets are split between
+/// `thread_count` threads.
+pub fn prune(view: SegmentView, goal: *const ChainGoal, thread_count: usize, allocator: std.mem.Allocator) ![]Candidate {
+    const records = view.records();
+    const pops = try allocator.alloc(u64, records.len);
+    defer allocator.free(pops);
+    const writes = try allocator.alloc(u64, records.len);
+    defer allocator.free(writes);
+    @memset(pops, 0);
+    @memset(writes, 0);
+
+    // only the lists of the goal registers are ever walked
+    for (goal.registers, 0..) |reg, bit| {
+        const mask = @as(u64, 1) << @intCast(bit);
+        for (view.popping(reg)) |id| {
+            pops[id] |= mask;
+        }
+        for (view.writing(reg)) |id| {
+            writes[id] |= mask;
+        }
+    }
+
+    const projection = Projection{ .records = records, .pops = pops, .writes = writes, .no_stores = goal.no_stores, .stack_align = goal.stack_align };
+    var queue = WorkQueue{ .total = @intCast(records.len), .batch = PRUNE_BATCH };
+
+    // the calling thread prunes into `merged`, every other thread into a
+    // map of its own that is folded into it afterwards
+    var merged = Cheapest.init(allocator);
+    defer merged.deinit();
+    const worker_count = if (records.len > PRUNE_BATCH) @min(thread_count, records.len / PRUNE_BATCH) -| 1 else 0;
+    const maps = try allocator.alloc(Cheapest, worker_count);
+    defer allocator.free(maps);
+    const threads = try allocator.alloc(std.Thread, worker_count);
+    defer allocator.free(threads);
+
+    var spawned: usize = 0;
+    defer {
+        for (maps[0..spawned]) |*map| {
+            map.deinit();
+        }
+    }
+    while (spawned < worker_count) : (spawned += 1) {
+        maps[spawned] = Cheapest.init(std.heap.page_allocator);
+        threads[spawned] = std.Thread.spawn(.{}, prune_worker, .{ &projection, &queue, &maps[spawned] }) catch |err| {
+            logger.warn("Failed to spawn chain pruning thread: {}", .{err});
+            maps[spawned].deinit();
+            break;
+        };
+    }
+
+    prune_worker(&projection, &queue, &merged);
+    for (threads[0..spawned]) |thread| {
+        thread.join();
+    }
+    if (queue.err) |err| {
+        return err;
+    }
+    for (maps[0..spawned]) |*map| {
+        for (map.values()) |found| {
+            try keep_cheapest(&merged, found, goal.stack_align);
+        }
+    }
+
+    return allocator.dupe(Candidate, merged.values());
+}
+
+/// Where a chain stands: the goal registers it has set and how many bytes
+/// the stack it ate is past a multiple of `ChainGoal.stack_align`
+const State = struct {
+    registers: u64,
+    misalignment: u32,
+
+    fn before(_: void, lhs: State, rhs: State) bool {
+        if (lhs.registers != rhs.registers) {
+            return lhs.registers < rhs.registers;
+        }
+        return lhs.misalignment < rhs.misalignment;
+    }
+};
+
+/// A state reached by the search, `parent` + `candidate` lead back to the
+/// start
+const Node = struct {
+    state: State,
+    stack_bytes: u64,
+    candidate: u32,
+    parent: u32,
+
+    const NONE = std.math.maxInt(u32);
+
+    /// Reaches the state more cheaply than `other`, ties go to the first
+    /// one found so every thread count finds the same chain
+    fn cheaper(self: Node, other: Node) bool {
+        if (self.stack_bytes != other.stack_bytes) {
+            return self.stack_bytes < other.stack_bytes;
+        }
+        if (self.parent != other.parent) {
+            return self.parent < other.parent;
+        }
+        return self.candidate < other.candidate;
+    }
+
+    fn before(_: void, lhs: Node, rhs: Node) bool {
+        return State.before({}, lhs.state, rhs.state);
+    }
+};
+
+/// The cheapest way to every state reached by a layer
+const Reached = std.AutoArrayHashMap(State, Node);
+
+/// Every state first reached by a chain of the same length, `nodes[first..]`
+const Layer = struct {
+    candidates: []const Candidate,
+    nodes: []const Node,
+    first: u32,
+    /// states reached by shorter chains, which the layer never reaches again
+    seen: *const std.AutoHashMap(State, void),
+    wanted: u64,
+    widest: u32,
+    stack_align: u32,
+    /// gadgets that may still be added after the next one
+    remaining: u32,
+};
+
+/// Expands the states of `layer` handed out by `queue` into `out`
+fn expand_worker(layer: *const Layer, queue: *WorkQueue, out: *Reached) void {
+    expand_batches(layer, queue, out) catch |err| {
+        queue.fail(err);
+    };
+}
+
+fn expand_batches(layer: *const Layer, queue: *WorkQueue, out: *Reached) !void {
+    while (queue.pop()) |batch| {
+        for (batch[0]..batch[1]) |offset| {
+            const parent: u32 = @intCast(layer.first + offset);
+            const node = &layer.nodes[parent];
+            for (layer.candidates, 0..) |found, candidate_idx| {
+                // a gadget setting nothing new only helps by realigning
+                if (found.sets & layer.wanted & ~node.state.registers == 0 and found.stack_bytes % layer.stack_align == 0) {
+                    continue;
+                }
+
+                const state = State{
+                    .registers = (node.state.registers & ~found.clobbers) | found.sets,
+                    .misalignment = @intCast((node.state.misalignment + found.stack_bytes) % layer.stack_align),
+                };
+                if (layer.seen.contains(state) or needed(state, layer.wanted, layer.widest) > layer.remaining) {
+                    continue;
+                }
+                try keep_closer(out, Node{ .state = state, .stack_bytes = node.stack_bytes + found.stack_bytes, .candidate = @intCast(candidate_idx), .parent = parent });
+            }
+        }
+    }
+}
+
+fn keep_closer(reached: *Reached, node: Node) !void {
+    const entry = try reached.getOrPut(node.state);
+    if (!entry.found_existing or node.cheaper(entry.value_ptr.*)) {
+        entry.value_ptr.* = node;
+    }
+}
+
+/// Every state one gadget away from `layer` into `out`, the cheapest way to
+/// each. The states are split between `thread_count` threads.
+fn expand_layer(layer: *const Layer, thread_count: usize, out: *Reached, allocator: std.mem.Allocator) !void {
+    const states = layer.nodes.len - layer.first;
+    var queue = WorkQueue{ .total = @intCast(states), .batch = SEARCH_BATCH };
+
+    // the calling thread expands into `out`, every other thread into a map
+    // of its own that is folded into it afterwards
+    const worker_count = if (states > SEARCH_BATCH) @min(thread_count, states / SEARCH_BATCH) -| 1 else 0;
+    const maps = try allocator.alloc(Reached, worker_count);
+    defer allocator.free(maps);
+    const threads = try allocator.alloc(std.Thread, worker_count);
+    defer allocator.free(threads);
+
+    var spawned: usize = 0;
+    defer {
+        for (maps[0..spawned]) |*map| {
+            map.deinit();
+        }
+    }
+    while (spawned < worker_count) : (spawned += 1) {
+        maps[spawned] = Reached.init(std.heap.page_allocator);
+        threads[spawned] = std.Thread.spawn(.{}, expand_worker, .{ layer, &queue, &maps[spawned] }) catch |err| {
+            logger.warn("Failed to spawn chain search thread: {}", .{err});
+            maps[spawned].deinit();
+            break;
+        };
+    }
+
+    expand_worker(layer, &queue, out);
+    for (threads[0..spawned]) |thread| {
+        thread.join();
+    }
+    if (queue.err) |err| {
+        return err;
+    }
+    for (maps[0..spawned]) |*map| {
+        for (map.values()) |node| {
+            try keep_closer(out, node);
+        }
+    }
+}
+
+/// The shortest (then smallest) ordering of `candidates` that sets every
+/// bit of `wanted` and eats a multiple of `stack_align` stack bytes, as
+/// indices into `candidates`. `null` if none is at most `max_length` long.
+/// Each length is searched by `thread_count` threads.
+pub fn search(candidates: []const Candidate, wanted: u64, max_length: u32, stack_align: u32, thread_count: usize, allocator: std.mem.Allocator) !?[]u32 {
+    // no gadget sets more registers than the widest, which bounds how many
+    // are still needed from below
+    var widest: u32 = 1;
+    for (candidates) |found| {
+        widest = @max(widest, @popCount(found.sets & wanted));
+    }
+
+    var nodes = std.ArrayList(Node).init(allocator);
+    defer nodes.deinit();
+    // transposition table, the states a shorter chain reached
+    var seen = std.AutoHashMap(State, void).init(allocator);
+    defer seen.deinit();
+    var reached = Reached.init(allocator);
+    defer reached.deinit();
+
+    try nodes.append(Node{ .state = .{ .registers = 0, .misalignment = 0 }, .stack_bytes = 0, .candidate = Node.NONE, .parent = Node.NONE });
+    try seen.put(nodes.items[0].state, {});
+
+    var first: u32 = 0;
+    var length: u32 = 0;
+    while (length < max_length and first < nodes.items.len) : (length += 1) {
+        const layer = Layer{ .candidates = candidates, .nodes = nodes.items, .first = first, .seen = &seen, .wanted = wanted, .widest = widest, .stack_align = stack_align, .remaining = max_length - length - 1 };
+        reached.clearRetainingCapacity();
+        try expand_layer(&layer, thread_count, &reached, allocator);
+
+        // in a fixed order, so the parents of the next layer are too
+        first = @intCast(nodes.items.len);
+        try nodes.appendSlice(reached.values());
+        std.mem.sort(Node, nodes.items[first..], {}, Node.before);
+
+        var done: ?u32 = null;
+        for (nodes.items[first..], first..) |node, idx| {
+            try seen.put(node.state, {});
+            if (node.state.registers & wanted != wanted or node.state.misalignment != 0) {
+                continue;
+            }
+            if (done == null or node.stack_bytes < nodes.items[done.?].stack_bytes) {
+                done = @as(u32, @intCast(idx));
+            }
+        }
+        if (done) |idx| {
+            return try unwind(nodes.items, idx, allocator);
+        }
+    }
+    return null;
+}
+
+/// Fewest gadgets that could still set what `state` is missing of `wanted`
+/// and realign the stack
+fn needed(state: State, wanted: u64, widest: u32) u32 {
+    const missing: u32 = @popCount(wanted & ~state.registers);
+    const setting = (missing + widest - 1) / widest;
+    return if (setting == 0 and state.misalignment != 0) 1 else setting;
+}
+
+/// The candidates leading to `nodes[idx]`, first one first
+fn unwind(nodes: []const Node, idx: u32, allocator: std.mem.Allocator) ![]u32 {
+    var path = std.ArrayList(u32).init(allocator);
+    errdefer path.deinit();
+
+    var cursor = idx;
+    while (nodes[cursor].parent != Node.NONE) : (cursor = nodes[cursor].parent) {
+        try path.append(nodes[cursor].candidate);
+    }
+    std.mem.reverse(u32, path.items);
+    return path.toOwnedSlice();
+}
+
+/// The best chain reaching `goal` in any one image of `index`, `thread_count`
+/// threads prune the gadgets of each and search for its chain. Caller owns
+/// the chain.
+pub fn find_chain(index: *const gadget_index.GadgetIndex, goal: *const ChainGoal, thread_count: usize, allocator: std.mem.Allocator) !?Chain {
+    if (goal.registers.len == 0 or goal.registers.len > MAX_REGISTERS or goal.stack_align == 0) {
+        return error.InvalidGoal;
+    }
+    const wanted = if (goal.registers.len == MAX_REGISTERS) ~@as(u64, 0) else (@as(u64, 1) << @intCast(goal.registers.len)) - 1;
+
+    const views = try index.views(allocator);
+    defer allocator.free(views);
+
+    var found: ?Chain = null;
+    errdefer {
+        if (found) |chain| {
+            allocator.free(chain.gadgets);
+            allocator.free(chain.frame_offsets);
+        }
+    }
+    for (views) |view| {
+        const candidates = try prune(view, goal, thread_count, allocator);
+        defer allocator.free(candidates);
+        logger.debug("{} candidate gadgets in image {x:0>16}", .{ candidates.len, view.image_hash() });
+
+        // a chain in an earlier image is only beaten by one no longer
+        const max_length = if (found) |chain| @min(goal.max_length, @as(u32, @intCast(chain.gadgets.len))) else goal.max_length;
+        const path = try search(candidates, wanted, max_length, goal.stack_align, thread_count, allocator) orelse continue;
+        defer allocator.free(path);
+
+        const gadgets = try allocator.alloc(GadgetHit, path.len);
+        errdefer allocator.free(gadgets);
+        var chain = Chain{ .gadgets = gadgets, .frame_offsets = try allocator.alloc(u64, path.len), .stack_bytes = 0, .image_hash = view.image_hash() };
+        for (path, chain.gadgets, chain.frame_offsets) |candidate_idx, *hit, *offset| {
+            hit.* = view.hit(candidates[candidate_idx].id);
+            offset.* = chain.stack_bytes;
+            chain.stack_bytes += candidates[candidate_idx].stack_bytes;
+        }
+
+        if (found == null or chain.better(&found.?)) {
+            if (found) |old| {
+                allocator.free(old.gadgets);
+                allocator.free(old.frame_offsets);
+            }
+            found = chain;
+        } else {
+            allocator.free(chain.gadgets);
+            allocator.free(chain.frame_offsets);
+        }
+    }
+    return found;
+}
+
+test "goals parse registers and limits" {
+    var arena = std.heap.ArenaAllocator.init(testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    const goal = try ChainGoal.parse("a0,a1,len:3,nostore,align:16", allocator);
+    try testing.expectEqual(@as(usize, 2), goal.registers.len);
+    try testing.expectEqualStrings("a1", goal.registers[1]);
+    try testing.expectEqual(@as(u32, 3), goal.max_length);
+    try testing.expectEqual(@as(u32, 16), goal.stack_align);
+    try testing.expect(goal.no_stores);
+
+    try testing.expectError(error.InvalidGoal, ChainGoal.parse("len:3", allocator));
+    try testing.expectError(error.InvalidGoal, ChainGoal.parse("a0,bogus:1", allocator));
+    try testing.expectError(error.InvalidGoal, ChainGoal.parse("a0,align:0", allocator));
+}
+
+test "search orders clobbering gadgets first" {
+    // bit 0 + bit 1 wanted, the only gadget setting bit 1 clobbers bit 0
+    const candidates = [_]Candidate{
+        .{ .id = 0, .sets = 0b01, .clobbers = 0, .stack_bytes = 8, .size = 4 },
+        .{ .id = 1, .sets = 0b10, .clobbers = 0b01, .stack_bytes = 8, .size = 8 },
+        .{ .id = 2, .sets = 0b11, .clobbers = 0, .stack_bytes = 64, .size = 4 },
+    };
+
+    const path = (try search(candidates[0..2], 0b11, 8, 1, 1, testing.allocator)).?;
+    defer testing.allocator.free(path);
+    try testing.expectEqualSlices(u32, &.{ 1, 0 }, path);
+
+    // one gadget beats two, however much stack it eats
+    const single = (try search(&candidates, 0b11, 8, 1, 1, testing.allocator)).?;
+    defer testing.allocator.free(single);
+    try testing.expectEqualSlices(u32, &.{2}, single);
+
+    try testing.expect(try search(candidates[0..2], 0b11, 1, 1, 1, testing.allocator) == null);
+    try testing.expect(try search(candidates[0..1], 0b11, 8, 1, 1, testing.allocator) == null);
+
+    // 16 bytes short of 32 after the two, so two more realign the stack
+    const aligned = (try search(candidates[0..2], 0b11, 8, 32, 1, testing.allocator)).?;
+    defer testing.allocator.free(aligned);
+    try testing.expectEqual(@as(usize, 4), aligned.len);
+    try testing.expect(try search(candidates[0..2], 0b11, 3, 32, 1, testing.allocator) == null);
+}
+
+test "search finds the same chain with any number of threads" {
+    // a register each, eating a different amount of stack, and every other
+    // one clobbering its neighbour: up to 1820 states per length
+    var candidates: [24]Candidate = undefined;
+    for (&candidates, 0..) |*found, idx| {
+        const bit: u6 = @intCast(idx % 12);
+        found.* = .{ .id = @intCast(idx), .sets = @as(u64, 1) << bit, .clobbers = if (idx % 2 == 1) @as(u64, 1) << ((bit + 1) % 12) else 0, .stack_bytes = 8 * (1 + idx % 5), .size = 4 };
+    }
+
+    const alone = (try search(&candidates, 0xfff, 12, 16, 1, testing.allocator)).?;
+    defer testing.allocator.free(alone);
+    try testing.expectEqual(@as(usize, 12), alone.len);
+
+    const shared = (try search(&candidates, 0xfff, 12, 16, 8, testing.allocator)).?;
+    defer testing.allocator.free(shared);
+    try testing.expectEqualSlices(u32, alone, shared);
+}
+
+test "chains are found in the gadget index" {
+    const shard = @import("../shard.zig");
+
+    var arena = std.heap.ArenaAllocator.init(testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const index_path = try std.fmt.allocPrint(allocator, "zig-cache/tmp/{s}/gadgets", .{tmp.sub_path});
+
+    // `pop {r0, pc}; mov r0, #0; pop {r3, pc}; pop {r0, r1, r2, pc}`
+    const data = try allocator.dupe(u8, &.{ 0x01, 0x80, 0xbd, 0xe8, 0x00, 0x00, 0xa0, 0xe3, 0x08, 0x80, 0xbd, 0xe8, 0x07, 0x80, 0xbd, 0xe8 });
+    var regions = [_]shard.ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "code"), .base_address = 0, .data = data }};
+    var target = shard.ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var shard_rt = shard.ShardRuntime.init(allocator);
+    defer shard_rt.deinit();
+    try shard_rt.load_target(target);
+
+    const Span = struct { address: u64, size: u64, text: []const u8 };
+    const gadgets = [_]Span{
+        .{ .address = 0x0, .size = 4, .text = "ldmia sp!,{r0,pc}" },
+        .{ .address = 0x4, .size = 8, .text = "mov r0,#0x0; ldmia sp!,{r3,pc}" },
+        .{ .address = 0xc, .size = 4, .text = "ldmia sp!,{r0,r1,r2,pc}" },
+    };
+
+    var index = try gadget_index.GadgetIndex.open(index_path, allocator);
+    defer index.close();
+    try testing.expect(try index.add(&shard_rt, &gadgets));
+
+    // `r3` can only be set by clobbering `r0`, so that gadget runs first
+    for ([_]usize{ 1, 4 }) |threads| {
+        const chain = (try find_chain(&index, &try ChainGoal.parse("r0,r3", allocator), threads, allocator)).?;
+        try testing.expectEqual(@as(usize, 2), chain.gadgets.len);
+        try testing.expectEqual(@as(u64, 0x4), chain.gadgets[0].record.address);
+        try testing.expectEqual(@as(u64, 0x0), chain.gadgets[1].record.address);
+        try testing.expectEqual(@as(u64, 16), chain.stack_bytes);
+        try testing.expectEqualSlices(u64, &.{ 0, 8 }, chain.frame_offsets);
+    }
+
+    const single = (try find_chain(&index, &try ChainGoal.parse("r0,r1", allocator), 1, allocator)).?;
+    try testing.expectEqual(@as(usize, 1), single.gadgets.len);
+    try testing.expectEqual(@as(u64, 0xc), single.gadgets[0].record.address);
+
+    // 16 bytes each, so twice keeps the stack 32 byte aligned
+    const aligned = (try find_chain(&index, &try ChainGoal.parse("r0,r1,align:32", allocator), 1, allocator)).?;
+    try testing.expectEqual(@as(usize, 2), aligned.gadgets.len);
+    try testing.expectEqual(@as(u64, 0xc), aligned.gadgets[0].record.address);
+    try testing.expectEqual(@as(u64, 0xc), aligned.gadgets[1].record.address);
+    try testing.expectEqualSlices(u64, &.{ 0, 16 }, aligned.frame_offsets);
+    try testing.expectEqual(@as(u64, 32), aligned.stack_bytes);
+
+    try testing.expect(try find_chain(&index, &try ChainGoal.parse("r0,r3,len:1", allocator), 1, allocator) == null);
+    try testing.expect(try find_chain(&index, &try ChainGoal.parse("r5", allocator), 1, allocator) == null);
+}
@@ -0,0 +1,172 @@
+//! Content defined chunking of memory regions, for lifting many builds of
+//! the same image.
+//!
+//! A Gear rolling hash runs over the bytes of a region and a chunk is cut
+//! wherever the hash has its low bits clear, so the cut points follow the
+//! bytes instead of the addresses: code that moved between two builds is
+//! cut into the same chunks in both, and only the chunks around an edit
+//! change. Every chunk gets a hash of its bytes (plus the few after it the
+//! last instruction can read) that keys its lift in the lift cache, see
+//! `LiftCache.load_content()`.
+//!
+//! Cuts are rounded up to addresses aligned to the spec alignment, so a
+//! chunk found at another address is always moved by a multiple of it.
+const std = @import("std");
+const testing = std.testing;
+
+const Wyhash = std.hash.Wyhash;
+
+/// Bytes past the end of a chunk that its content hash covers, the longest
+/// instruction of any spec fits
+pub const CONTENT_TAIL = 32;
+
+/// Chunk sizes of `ContentChunker.split()`, `avg_size` must be a power of
+/// two
+pub const ChunkSizes = struct {
+    min_size: u64 = 8 * 1024,
+    avg_size: u64 = 32 * 1024,
+    max_size: u64 = 128 * 1024,
+};
+
+/// Piece of a region cut by `ContentChunker.split()`
+pub const ContentChunk = struct {
+    start: u64,
+    end: u64,
+    /// hash of the chunk + `CONTENT_TAIL` bytes, `null` for the last chunk
+    /// of a region, whose instructions can run off the end of it
+    content: ?u64,
+};
+
+/// Random 64-bit value for every byte, the same in every build
+const GEAR = blk: {
+    @setEvalBranchQuota(8192);
+    var table: [256]u64 = undefined;
+    var state: u64 = 0x5348_4152_4443_4443;
+    for (&table) |*entry| {
+        entry.* = splitmix(&state);
+    }
+    break :blk table;
+};
+
+fn splitmix(state: *u64) u64 {
+    state.* +%= 0x9e3779b97f4a7c15;
+    var z = state.*;
+    z = (z ^ (z >> 30)) *% 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) *% 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+pub const ContentChunker = struct {
+    sizes: ChunkSizes = .{},
+    /// alignment of the spec, see `SleighState.alignment()`
+    alignment: u64 = 1,
+
+    const Self = @This();
+
+    /// Cuts the `data` of the region at `base_address` into chunks, appended
+    /// to `out` in address order
+    pub fn split(self: *const Self, base_address: u64, data: []const u8, out: *std.ArrayList(ContentChunk)) !void {
+        const mask = self.sizes.avg_size - 1;
+        var start: usize = 0;
+        while (start < data.len) {
+            const end = start + self.cut(base_address + start, data[start..], mask);
+            try out.append(ContentChunk{
+                .start = base_address + start,
+                .end = base_address + end,
+                .content = if (end + CONTENT_TAIL <= data.len) Wyhash.hash(0, data[start .. end + CONTENT_TAIL]) else null,
+            });
+            start = end;
+        }
+    }
+
+    /// Length of the chunk at the start of `data`, which is at `address`
+    fn cut(self: *const Self, address: u64, data: []const u8, mask: u64) usize {
+        if (data.len <= self.sizes.min_size) {
+            return data.len;
+        }
+
+        const limit = @min(data.len, self.sizes.max_size);
+        var hash: u64 = 0;
+        // the bytes before `min_size` still roll into the hash, so the cut
+        // depends on the last 64 bytes wherever the chunk started
+        var idx: usize = self.sizes.min_size - @min(self.sizes.min_size, 64);
+        while (idx < limit) : (idx += 1) {
+            hash = (hash << 1) +% GEAR[data[idx]];
+            const len = idx + 1;
+            if (len >= self.sizes.min_size and hash & mask == 0) {
+                // rounded up to the next aligned address, so the cut still
+                // only depends on the bytes
+                const aligned = std.mem.alignForward(u64, address + len, self.alignment) - address;
+                return @intCast(@min(aligned, limit));
+            }
+        }
+        return limit;
+    }
+};
+
+fn test_bytes(seed: u64, len: usize, allocator: std.mem.Allocator) ![]u8 {
+    const data = try allocator.alloc(u8, len);
+    var state = seed;
+    for (data) |*byte| {
+        byte.* = @truncate(splitmix(&state));
+    }
+    return data;
+}
+
+test "chunks cover the region at aligned cuts" {
+    const data = try test_bytes(1, 1024 * 1024, testing.allocator);
+    defer testing.allocator.free(data);
+
+    var chunks = std.ArrayList(ContentChunk).init(testing.allocator);
+    defer chunks.deinit();
+    const chunker = ContentChunker{ .alignment = 4 };
+    try chunker.split(0x10000, data, &chunks);
+
+    try testing.expect(chunks.items.len > 1);
+    var cursor: u64 = 0x10000;
+    for (chunks.items, 0..) |chunk, idx| {
+        try testing.expectEqual(cursor, chunk.start);
+        try testing.expect(chunk.end - chunk.start <= chunker.sizes.max_size);
+        if (idx + 1 < chunks.items.len) {
+            try testing.expect(chunk.end - chunk.start >= chunker.sizes.min_size);
+            try testing.expectEqual(@as(u64, 0), chunk.end % 4);
+        }
+        cursor = chunk.end;
+    }
+    try testing.expectEqual(@as(u64, 0x10000 + data.len), cursor);
+    try testing.expect(chunks.items[chunks.items.len - 1].content == null);
+}
+
+test "moved bytes cut into the same chunks" {
+    const data = try test_bytes(2, 512 * 1024, testing.allocator);
+    defer testing.allocator.free(data);
+
+    // the same bytes behind a 0x1234 byte insertion, loaded somewhere else
+    const moved = try testing.allocator.alloc(u8, data.len + 0x1234);
+    defer testing.allocator.free(moved);
+    @memset(moved[0..0x1234], 0xcc);
+    @memcpy(moved[0x1234..], data);
+
+    const chunker = ContentChunker{ .alignment = 4 };
+    var a = std.ArrayList(ContentChunk).init(testing.allocator);
+    defer a.deinit();
+    try chunker.split(0x400000, data, &a);
+    var b = std.ArrayList(ContentChunk).init(testing.allocator);
+    defer b.deinit();
+    try chunker.split(0x800000, moved, &b);
+
+    var shared: usize = 0;
+    for (a.items) |chunk| {
+        const content = chunk.content orelse continue;
+        for (b.items) |other| {
+            if (other.content == content) {
+                try testing.expectEqual(chunk.end - chunk.start, other.end - other.start);
+                shared += 1;
+                break;
+            }
+        }
+    }
+    // only the few chunks it takes to line up again after the insertion +
+    // the unhashed last one differ
+    try testing.expect(shared + 4 >= a.items.len);
+}
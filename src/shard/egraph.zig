@@ -0,0 +1,1252 @@
+//! E-graph of what gadgets do, to tell the gadgets apart that only differ in
+//! how they get there.
+//!
+//! The p-code of a gadget is executed symbolically into terms: whatever is
+//! written to a `unique` temporary is read back as the term itself, so no
+//! temporary is left once the gadget is done, and the registers written,
+//! the memory and the branch target on exit make up the root term of the
+//! gadget. Every gadget goes into the same `EGraph`, where equal terms are
+//! hash-consed into one e-class (a dense id of a `DenseUnionFind`), and the
+//! graph is then saturated with `GADGET_RULES`. Two gadgets do the same
+//! thing once their roots are in the same e-class.
+//!
+//! Rewrites are matched like egglog does it, relationally and in batches.
+//! Every op is a table of e-nodes and the left side of a rule is a join
+//! over these tables: the root of the pattern is a scan of its table, every
+//! child a lookup by e-class in an index sorted by (op, e-class), so no rule
+//! ever walks the nodes of a class one by one. All rules are matched against
+//! the same snapshot of the graph, then every match is applied, and the
+//! congruence closure is restored once per iteration by re-canonicalizing
+//! the tables (the deferred rebuilding of egg). Constants are an e-class
+//! analysis, a node is folded as soon as all of its children are constant.
+//!
+//! The rewrites are sound, not complete. Whatever isn't modelled (a
+//! conditional branch, a user op without an output, a read of a register
+//! that was only partly written) makes the gadget opaque, which is equal to
+//! no other gadget.
+const std = @import("std");
+const testing = std.testing;
+const sleigh = @import("../sleigh.zig");
+const shard = @import("../shard.zig");
+const union_find = @import("../union_find.zig");
+
+const OpCode = sleigh.OpCode;
+const Terminator = shard.gadget_index.Terminator;
+
+const logger = std.log.scoped(.shard_egraph);
+
+/// An e-class
+pub const Id = u32;
+
+/// Unused child of a `Node`
+pub const NONE: Id = std.math.maxInt(Id);
+
+/// Most children of a node, p-code with more inputs makes the gadget opaque
+pub const MAX_ARGS = 3;
+
+/// Children a pattern can bind to variables
+pub const MAX_VARS = 4;
+
+/// Nodes in the left side of a rule
+pub const MAX_ATOMS = 4;
+
+/// What an e-node computes, the p-code opcodes keep their number
+pub const Op = enum(u16) {
+    /// `payload` is the value
+    constant = 0x100,
+    /// the register at offset `payload` on entry
+    input,
+    /// memory on entry
+    memory,
+    /// equal to nothing but itself, `payload` tells them apart
+    opaque_value,
+    /// `bind(value, rest)`: the register at offset `payload` holds `value`
+    /// on exit, as do the ones bound by `rest`
+    bind,
+    /// `exit(memory, target)`: memory on exit and where the gadget goes,
+    /// `payload` is its `Terminator`
+    exit,
+    _,
+
+    pub fn of(code: OpCode) Op {
+        return @enumFromInt(@as(u16, @intCast(@intFromEnum(code))));
+    }
+
+    /// The p-code opcode of the op, `null` for the others
+    pub fn opcode(self: Op) ?OpCode {
+        return std.meta.intToEnum(OpCode, @intFromEnum(self)) catch null;
+    }
+};
+
+const ADD = Op.of(.CPUI_INT_ADD);
+const SUB = Op.of(.CPUI_INT_SUB);
+const MULT = Op.of(.CPUI_INT_MULT);
+const AND = Op.of(.CPUI_INT_AND);
+const OR = Op.of(.CPUI_INT_OR);
+const XOR = Op.of(.CPUI_INT_XOR);
+const LEFT = Op.of(.CPUI_INT_LEFT);
+const RIGHT = Op.of(.CPUI_INT_RIGHT);
+const SRIGHT = Op.of(.CPUI_INT_SRIGHT);
+const EQUAL = Op.of(.CPUI_INT_EQUAL);
+const NOTEQUAL = Op.of(.CPUI_INT_NOTEQUAL);
+const LESS = Op.of(.CPUI_INT_LESS);
+const LESSEQUAL = Op.of(.CPUI_INT_LESSEQUAL);
+const SLESS = Op.of(.CPUI_INT_SLESS);
+const SLESSEQUAL = Op.of(.CPUI_INT_SLESSEQUAL);
+const NEGATE = Op.of(.CPUI_INT_NEGATE);
+const TWOCOMP = Op.of(.CPUI_INT_2COMP);
+const BOOL_NEGATE = Op.of(.CPUI_BOOL_NEGATE);
+const ZEXT = Op.of(.CPUI_INT_ZEXT);
+const SEXT = Op.of(.CPUI_INT_SEXT);
+const SUBPIECE = Op.of(.CPUI_SUBPIECE);
+const LOAD = Op.of(.CPUI_LOAD);
+const STORE = Op.of(.CPUI_STORE);
+
+/// An e-node, one row of the table of its op
+pub const Node = struct {
+    op: Op,
+    /// bytes of the value, 0 for memory + `exit`
+    size: u32,
+    /// constant, register offset or space, see `Op`
+    payload: u64 = 0,
+    /// e-classes of the children, `NONE` past the last one
+    args: [MAX_ARGS]Id = .{ NONE, NONE, NONE },
+
+    pub fn arity(self: *const Node) usize {
+        for (self.args, 0..) |arg, idx| {
+            if (arg == NONE) {
+                return idx;
+            }
+        }
+        return MAX_ARGS;
+    }
+};
+
+/// Every row of every op table sorted by (op, e-class), so both the rows of
+/// an op and the rows of an op in one e-class are a binary search away
+pub const Index = struct {
+    entries: []Entry,
+
+    pub const Entry = struct {
+        key: u64,
+        row: u32,
+
+        fn lessThan(_: void, lhs: Entry, rhs: Entry) bool {
+            return lhs.key < rhs.key;
+        }
+    };
+
+    fn key(op: Op, class: Id) u64 {
+        return (@as(u64, @intFromEnum(op)) << 32) | class;
+    }
+
+    /// Indexes the rows of `graph`, which must be rebuilt
+    pub fn build(graph: *const EGraph, allocator: std.mem.Allocator) !Index {
+        const entries = try allocator.alloc(Entry, graph.nodes.items.len);
+        for (graph.nodes.items, graph.node_classes.items, entries, 0..) |node, class, *entry, row| {
+            entry.* = .{ .key = key(node.op, class), .row = @intCast(row) };
+        }
+        std.mem.sort(Entry, entries, {}, Entry.lessThan);
+        return Index{ .entries = entries };
+    }
+
+    pub fn deinit(self: *Index, allocator: std.mem.Allocator) void {
+        allocator.free(self.entries);
+        self.* = undefined;
+    }
+
+    fn lower_bound(self: *const Index, wanted: u64) usize {
+        var lo: usize = 0;
+        var hi = self.entries.len;
+        while (lo < hi) {
+            const mid = lo + (hi - lo) / 2;
+            if (self.entries[mid].key < wanted) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    /// Every row of the table of `op`
+    pub fn rows_of(self: *const Index, op: Op) []const Entry {
+        const start = key(op, 0);
+        return self.entries[self.lower_bound(start)..self.lower_bound(start + (1 << 32))];
+    }
+
+    /// The rows of the table of `op` in the e-class `class`
+    pub fn rows_in(self: *const Index, op: Op, class: Id) []const Entry {
+        const start = key(op, class);
+        return self.entries[self.lower_bound(start)..self.lower_bound(start + 1)];
+    }
+};
+
+/// Left side of a `Rule`
+pub const Pattern = union(enum) {
+    /// any e-class, bound to the variable. A variable used twice only
+    /// matches the same e-class twice.
+    variable: u8,
+    /// an e-class with a known constant, bound to the variable
+    constant: u8,
+    node: PatternNode,
+};
+
+pub const PatternNode = struct {
+    op: Op,
+    args: []const Pattern = &.{},
+};
+
+/// One match of the left side of a rule
+pub const Match = struct {
+    /// e-class of the root of the pattern
+    root: Id = NONE,
+    /// what every variable is bound to
+    vars: [MAX_VARS]Id = .{NONE} ** MAX_VARS,
+    /// row of every node of the pattern, in pre-order
+    rows: [MAX_ATOMS]u32 = undefined,
+};
+
+/// What building the right side of a rule can fail with
+pub const ApplyError = std.mem.Allocator.Error;
+
+/// A rewrite: whatever `apply` builds out of a match of `pattern` is merged
+/// into the e-class of the match
+pub const Rule = struct {
+    name: []const u8,
+    pattern: Pattern,
+    /// the right side, `null` if the match doesn't apply after all
+    apply: *const fn (graph: *EGraph, index: *const Index, match: *const Match) ApplyError!?Id,
+};
+
+/// When `EGraph.saturate()` gives up
+pub const Limits = struct {
+    iterations: u32 = 16,
+    nodes: usize = 1 << 24,
+};
+
+pub const Saturation = struct {
+    iterations: u32 = 0,
+    matches: u64 = 0,
+    unions: u64 = 0,
+    stop: Stop = .saturated,
+
+    pub const Stop = enum {
+        /// no rule adds anything anymore
+        saturated,
+        iteration_limit,
+        node_limit,
+    };
+};
+
+/// A pattern flattened into the nodes it joins, `atoms[0]` is the root
+const Query = struct {
+    atoms: [MAX_ATOMS]Atom = undefined,
+    len: u8 = 0,
+
+    const NO_VAR = std.math.maxInt(u8);
+
+    const Atom = struct {
+        op: Op,
+        /// atom this is a child of, unused for the root
+        parent: u8,
+        /// child of the parent this is
+        slot: u8,
+        arity: u8,
+        /// variable of every child, `NO_VAR` for a nested atom
+        vars: [MAX_ARGS]u8 = .{NO_VAR} ** MAX_ARGS,
+        /// children that must have a known constant
+        constant: [MAX_ARGS]bool = .{false} ** MAX_ARGS,
+    };
+
+    fn compile(lhs: Pattern) Query {
+        var query = Query{};
+        query.push(lhs.node, 0, 0);
+        return query;
+    }
+
+    fn push(self: *Query, node: PatternNode, parent: u8, slot: u8) void {
+        const at = self.len;
+        self.len += 1;
+        self.atoms[at] = .{ .op = node.op, .parent = parent, .slot = slot, .arity = @intCast(node.args.len) };
+        for (node.args, 0..) |arg, idx| {
+            switch (arg) {
+                .variable => |id| self.atoms[at].vars[idx] = id,
+                .constant => |id| {
+                    self.atoms[at].vars[idx] = id;
+                    self.atoms[at].constant[idx] = true;
+                },
+                .node => |child| self.push(child, at, @intCast(idx)),
+            }
+        }
+    }
+};
+
+pub const EGraph = struct {
+    allocator: std.mem.Allocator,
+    sets: union_find.DenseUnionFind,
+    /// rows of every op table, canonical after `rebuild()`
+    nodes: std.ArrayListUnmanaged(Node) = .{},
+    /// e-class of every row of `nodes`
+    node_classes: std.ArrayListUnmanaged(Id) = .{},
+    /// the hash-cons, canonical node -> its e-class
+    memo: std.AutoHashMapUnmanaged(Node, Id) = .{},
+    /// known constant by e-class, up to date for the roots
+    constants: std.ArrayListUnmanaged(?u64) = .{},
+    /// bytes of the value by e-class
+    sizes: std.ArrayListUnmanaged(u32) = .{},
+    /// whether e-classes were merged since the last `rebuild()`
+    dirty: bool = false,
+    opaque_count: u64 = 0,
+
+    const Self = @This();
+
+    /// A match waiting to be applied
+    const Pending = struct {
+        rule: u16,
+        match: Match,
+    };
+
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return Self{ .allocator = allocator, .sets = union_find.DenseUnionFind.init(allocator) };
+    }
+
+    pub fn deinit(self: *Self) void {
+        self.sets.deinit();
+        self.nodes.deinit(self.allocator);
+        self.node_classes.deinit(self.allocator);
+        self.memo.deinit(self.allocator);
+        self.constants.deinit(self.allocator);
+        self.sizes.deinit(self.allocator);
+        self.* = undefined;
+    }
+
+    pub fn find(self: *Self, id: Id) Id {
+        return self.sets.find(id);
+    }
+
+    pub fn constant_of(self: *Self, id: Id) ?u64 {
+        return self.constants.items[self.find(id)];
+    }
+
+    pub fn size_of(self: *Self, id: Id) u32 {
+        return self.sizes.items[self.find(id)];
+    }
+
+    pub fn class_count(self: *const Self) usize {
+        return self.sets.size();
+    }
+
+    pub fn node_count(self: *const Self) usize {
+        return self.nodes.items.len;
+    }
+
+    /// E-class of `node`, added unless an equal node is already in the
+    /// graph. Nodes of constants only are folded into the constant.
+    pub fn add(self: *Self, node: Node) std.mem.Allocator.Error!Id {
+        var canonical = node;
+        for (&canonical.args) |*arg| {
+            if (arg.* != NONE) {
+                arg.* = self.find(arg.*);
+            }
+        }
+        if (self.memo.get(canonical)) |id| {
+            return self.find(id);
+        }
+        if (self.fold(canonical)) |value| {
+            return self.constant(value, canonical.size);
+        }
+
+        try self.nodes.ensureUnusedCapacity(self.allocator, 1);
+        try self.node_classes.ensureUnusedCapacity(self.allocator, 1);
+        try self.constants.ensureUnusedCapacity(self.allocator, 1);
+        try self.sizes.ensureUnusedCapacity(self.allocator, 1);
+        try self.memo.ensureUnusedCapacity(self.allocator, 1);
+
+        const id = try self.sets.makeSet();
+        self.nodes.appendAssumeCapacity(canonical);
+        self.node_classes.appendAssumeCapacity(id);
+        self.constants.appendAssumeCapacity(if (canonical.op == .constant) canonical.payload else null);
+        self.sizes.appendAssumeCapacity(canonical.size);
+        self.memo.putAssumeCapacity(canonical, id);
+        return id;
+    }
+
+    /// E-class of the constant `value` of `size` bytes
+    pub fn constant(self: *Self, value: u64, size: u32) std.mem.Allocator.Error!Id {
+        return self.add(.{ .op = .constant, .size = size, .payload = mask(value, size) });
+    }
+
+    /// A new e-class equal to no other
+    pub fn fresh_opaque(self: *Self, size: u32) std.mem.Allocator.Error!Id {
+        self.opaque_count += 1;
+        return self.add(.{ .op = .opaque_value, .size = size, .payload = self.opaque_count });
+    }
+
+    /// Merges the e-classes of `a` and `b`, `false` if they already were
+    /// the same. The tables are only canonical again after `rebuild()`.
+    pub fn merge(self: *Self, a: Id, b: Id) bool {
+        const root_a = self.find(a);
+        const root_b = self.find(b);
+        const root = self.sets.unionSets(root_a, root_b) orelse return false;
+        const other = if (root == root_a) root_b else root_a;
+        if (self.constants.items[root] == null) {
+            self.constants.items[root] = self.constants.items[other];
+        }
+        self.dirty = true;
+        return true;
+    }
+
+    /// Restores the congruence closure after merges: every row is
+    /// canonicalized, rows that became equal merge their e-classes and only
+    /// one of them is kept. Repeats until nothing merges anymore.
+    pub fn rebuild(self: *Self) !void {
+        while (self.dirty) {
+            self.dirty = false;
+            self.memo.clearRetainingCapacity();
+            try self.memo.ensureTotalCapacity(self.allocator, @intCast(self.nodes.items.len));
+
+            var kept: usize = 0;
+            for (0..self.nodes.items.len) |row| {
+                var node = self.nodes.items[row];
+                for (&node.args) |*arg| {
+                    if (arg.* != NONE) {
+                        arg.* = self.find(arg.*);
+                    }
+                }
+                const class = self.find(self.node_classes.items[row]);
+
+                const entry = self.memo.getOrPutAssumeCapacity(node);
+                if (entry.found_existing) {
+                    _ = self.merge(entry.value_ptr.*, class);
+                    continue;
+                }
+                entry.value_ptr.* = class;
+                self.nodes.items[kept] = node;
+                self.node_classes.items[kept] = class;
+                kept += 1;
+            }
+            self.nodes.shrinkRetainingCapacity(kept);
+            self.node_classes.shrinkRetainingCapacity(kept);
+        }
+    }
+
+    /// Applies `rules` until they add nothing or a limit is reached, one
+    /// batch of matches + one `rebuild()` per iteration
+    pub fn saturate(self: *Self, rules: []const Rule, limits: Limits) !Saturation {
+        var report = Saturation{};
+
+        const queries = try self.allocator.alloc(Query, rules.len);
+        defer self.allocator.free(queries);
+        for (rules, queries) |rule, *query| {
+            query.* = Query.compile(rule.pattern);
+        }
+
+        var matches = std.ArrayListUnmanaged(Pending){};
+        defer matches.deinit(self.allocator);
+
+        try self.rebuild();
+        while (true) {
+            if (report.iterations == limits.iterations) {
+                report.stop = .iteration_limit;
+                break;
+            }
+            if (self.nodes.items.len >= limits.nodes) {
+                report.stop = .node_limit;
+                break;
+            }
+            report.iterations += 1;
+
+            var index = try Index.build(self, self.allocator);
+            defer index.deinit(self.allocator);
+
+            // match everything against the same snapshot before changing it
+            matches.clearRetainingCapacity();
+            for (queries, 0..) |*query, rule| {
+                var match = Match{};
+                try self.search(query, &index, 0, &match, @intCast(rule), &matches);
+            }
+            report.matches += matches.items.len;
+
+            var unions = try self.fold_constants();
+            for (matches.items) |*pending| {
+                const id = try rules[pending.rule].apply(self, &index, &pending.match) orelse continue;
+                if (self.merge(pending.match.root, id)) {
+                    unions += 1;
+                }
+            }
+            try self.rebuild();
+
+            report.unions += unions;
+            if (unions == 0) {
+                report.stop = .saturated;
+                break;
+            }
+        }
+        return report;
+    }
+
+    /// Joins the atoms of `query` from `depth` on, appending every match
+    fn search(self: *Self, query: *const Query, index: *const Index, depth: u8, match: *Match, rule: u16, out: *std.ArrayListUnmanaged(Pending)) std.mem.Allocator.Error!void {
+        if (depth == query.len) {
+            try out.append(self.allocator, .{ .rule = rule, .match = match.* });
+            return;
+        }
+
+        const atom = &query.atoms[depth];
+        const candidates = if (depth == 0) index.rows_of(atom.op) else blk: {
+            const parent = self.nodes.items[match.rows[atom.parent]];
+            break :blk index.rows_in(atom.op, parent.args[atom.slot]);
+        };
+
+        const bound = match.vars;
+        for (candidates) |entry| {
+            const node = self.nodes.items[entry.row];
+            if (node.arity() != atom.arity) {
+                continue;
+            }
+
+            match.vars = bound;
+            if (!self.bind(atom, &node, &match.vars)) {
+                continue;
+            }
+            match.rows[depth] = entry.row;
+            if (depth == 0) {
+                match.root = self.node_classes.items[entry.row];
+            }
+            try self.search(query, index, depth + 1, match, rule, out);
+        }
+        match.vars = bound;
+    }
+
+    /// Binds the variables of `atom` to the children of `node`, `false` if
+    /// they contradict what is bound already
+    fn bind(self: *const Self, atom: *const Query.Atom, node: *const Node, vars: *[MAX_VARS]Id) bool {
+        for (0..atom.arity) |idx| {
+            const id = atom.vars[idx];
+            if (id == Query.NO_VAR) {
+                continue;
+            }
+
+            const class = node.args[idx];
+            if (atom.constant[idx] and self.constants.items[class] == null) {
+                return false;
+            }
+            if (vars[id] == NONE) {
+                vars[id] = class;
+            } else if (vars[id] != class) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Merges every row whose children turned constant with its value
+    fn fold_constants(self: *Self) !u64 {
+        var unions: u64 = 0;
+        const rows = self.nodes.items.len;
+        for (0..rows) |row| {
+            const node = self.nodes.items[row];
+            const class = self.node_classes.items[row];
+            if (self.constant_of(class) != null) {
+                continue;
+            }
+
+            const value = self.fold(node) orelse continue;
+            if (self.merge(class, try self.constant(value, node.size))) {
+                unions += 1;
+            }
+        }
+        return unions;
+    }
+
+    /// `node` evaluated, if it is p-code of constants only
+    fn fold(self: *Self, node: Node) ?u64 {
+        const opcode = node.op.opcode() orelse return null;
+        const count = node.arity();
+        if (count == 0) {
+            return null;
+        }
+
+        var values: [MAX_ARGS]u64 = undefined;
+        var widths: [MAX_ARGS]u32 = undefined;
+        for (0..count) |idx| {
+            values[idx] = self.constant_of(node.args[idx]) orelse return null;
+            widths[idx] = self.size_of(node.args[idx]);
+        }
+        return evaluate(opcode, node.size, values[0..count], widths[0..count]);
+    }
+};
+
+/// `opcode` of the constants `values` (each `widths` bytes), `null` for what
+/// isn't folded
+fn evaluate(opcode: OpCode, size: u32, values: []const u64, widths: []const u32) ?u64 {
+    const a = values[0];
+    const b = if (values.len > 1) values[1] else 0;
+    const b_width = if (widths.len > 1) widths[1] else 0;
+    const result: u64 = switch (opcode) {
+        .CPUI_COPY, .CPUI_INT_ZEXT => a,
+        .CPUI_INT_SEXT => @bitCast(signed(a, widths[0])),
+        .CPUI_INT_ADD => a +% b,
+        .CPUI_INT_SUB => a -% b,
+        .CPUI_INT_MULT => a *% b,
+        .CPUI_INT_AND, .CPUI_BOOL_AND => a & b,
+        .CPUI_INT_OR, .CPUI_BOOL_OR => a | b,
+        .CPUI_INT_XOR, .CPUI_BOOL_XOR => a ^ b,
+        .CPUI_INT_NEGATE => ~a,
+        .CPUI_INT_2COMP => 0 -% a,
+        .CPUI_BOOL_NEGATE => a ^ 1,
+        .CPUI_INT_LEFT => if (b >= 64) 0 else a << @intCast(b),
+        .CPUI_INT_RIGHT => if (b >= 64) 0 else a >> @intCast(b),
+        .CPUI_INT_SRIGHT => @bitCast(signed(a, widths[0]) >> @intCast(@min(b, 63))),
+        .CPUI_INT_EQUAL => flag(a == b),
+        .CPUI_INT_NOTEQUAL => flag(a != b),
+        .CPUI_INT_LESS => flag(a < b),
+        .CPUI_INT_LESSEQUAL => flag(a <= b),
+        .CPUI_INT_SLESS => flag(signed(a, widths[0]) < signed(b, b_width)),
+        .CPUI_INT_SLESSEQUAL => flag(signed(a, widths[0]) <= signed(b, b_width)),
+        .CPUI_INT_CARRY => flag(mask(a +% b, widths[0]) < a),
+        .CPUI_SUBPIECE => if (b >= 8) 0 else a >> @intCast(b * 8),
+        .CPUI_PIECE => if (b_width >= 8) b else (a << @intCast(b_width * 8)) | b,
+        .CPUI_POPCOUNT => @popCount(a),
+        else => return null,
+    };
+    return mask(result, size);
+}
+
+fn flag(value: bool) u64 {
+    return @intFromBool(value);
+}
+
+/// The low `size` bytes of `value`
+fn mask(value: u64, size: u32) u64 {
+    if (size == 0 or size >= 8) {
+        return value;
+    }
+    return value & ((@as(u64, 1) << @intCast(size * 8)) - 1);
+}
+
+/// `value` of `size` bytes as a signed number
+fn signed(value: u64, size: u32) i64 {
+    if (size == 0 or size >= 8) {
+        return @bitCast(value);
+    }
+    const shift: u6 = @intCast(64 - size * 8);
+    return @as(i64, @bitCast(value << shift)) >> shift;
+}
+
+fn var_pattern(id: u8) Pattern {
+    return .{ .variable = id };
+}
+
+fn const_pattern(id: u8) Pattern {
+    return .{ .constant = id };
+}
+
+fn op_pattern(op: Op, args: []const Pattern) Pattern {
+    return .{ .node = .{ .op = op, .args = args } };
+}
+
+/// The root node of `match`
+fn root_node(graph: *const EGraph, match: *const Match) Node {
+    return graph.nodes.items[match.rows[0]];
+}
+
+/// `op(c, x)` into `op(x, c)`, so constants of commutative ops are always
+/// the second child
+fn constant_second(graph: *EGraph, _: *const Index, match: *const Match) ApplyError!?Id {
+    if (graph.constant_of(match.vars[1]) != null) {
+        return null;
+    }
+    const node = root_node(graph, match);
+    return try graph.add(.{ .op = node.op, .size = node.size, .args = .{ match.vars[1], match.vars[0], NONE } });
+}
+
+/// `x - c` into `x + -c`
+fn sub_constant(graph: *EGraph, _: *const Index, match: *const Match) ApplyError!?Id {
+    const node = root_node(graph, match);
+    const negated = try graph.constant(0 -% graph.constant_of(match.vars[1]).?, graph.size_of(match.vars[1]));
+    return try graph.add(.{ .op = ADD, .size = node.size, .args = .{ match.vars[0], negated, NONE } });
+}
+
+/// `(x + c1) + c2` into `x + (c1 + c2)`, what turns chains of stack pointer
+/// adjustments into a single one
+fn add_add(graph: *EGraph, _: *const Index, match: *const Match) ApplyError!?Id {
+    const node = root_node(graph, match);
+    const sum = try graph.constant(graph.constant_of(match.vars[1]).? +% graph.constant_of(match.vars[2]).?, node.size);
+    return try graph.add(.{ .op = ADD, .size = node.size, .args = .{ match.vars[0], sum, NONE } });
+}
+
+/// `x op c` into `x` for the neutral constant of `op`
+fn identity(graph: *EGraph, _: *const Index, match: *const Match) ApplyError!?Id {
+    const node = root_node(graph, match);
+    const value = graph.constant_of(match.vars[1]).?;
+    const unit: u64 = if (node.op == MULT) 1 else if (node.op == AND) mask(std.math.maxInt(u64), node.size) else 0;
+    if (value != unit or graph.size_of(match.vars[0]) != node.size) {
+        return null;
+    }
+    return match.vars[0];
+}
+
+/// `x & 0`, `x * 0` and `x | ~0` into the constant
+fn absorb(graph: *EGraph, _: *const Index, match: *const Match) ApplyError!?Id {
+    const node = root_node(graph, match);
+    const value = graph.constant_of(match.vars[1]).?;
+    const sink: u64 = if (node.op == OR) mask(std.math.maxInt(u64), node.size) else 0;
+    if (value != sink) {
+        return null;
+    }
+    return try graph.constant(sink, node.size);
+}
+
+/// `x op x` into `0`
+fn zero(graph: *EGraph, _: *const Index, match: *const Match) ApplyError!?Id {
+    return try graph.constant(0, root_node(graph, match).size);
+}
+
+/// `x op x` into `1`
+fn one(graph: *EGraph, _: *const Index, match: *const Match) ApplyError!?Id {
+    return try graph.constant(1, root_node(graph, match).size);
+}
+
+/// `x op x` or `op(op(x))` into `x`
+fn first(_: *EGraph, _: *const Index, match: *const Match) ApplyError!?Id {
+    return match.vars[0];
+}
+
+/// The low bytes of an extension (or of anything) of their own size into
+/// what was extended
+fn truncate(graph: *EGraph, _: *const Index, match: *const Match) ApplyError!?Id {
+    const node = root_node(graph, match);
+    if (graph.constant_of(match.vars[1]).? != 0 or graph.size_of(match.vars[0]) != node.size) {
+        return null;
+    }
+    return match.vars[0];
+}
+
+/// A load of what was just stored at the same address into the value
+fn load_after_store(graph: *EGraph, _: *const Index, match: *const Match) ApplyError!?Id {
+    const load = root_node(graph, match);
+    const store = graph.nodes.items[match.rows[1]];
+    if (load.payload != store.payload or graph.size_of(match.vars[2]) != load.size) {
+        return null;
+    }
+    return match.vars[2];
+}
+
+/// An address as a base e-class plus a constant, the base is `NONE` for
+/// constant addresses
+const Pointer = struct {
+    base: Id,
+    offset: u64,
+
+    fn of(graph: *EGraph, index: *const Index, class: Id) Pointer {
+        if (graph.constant_of(class)) |value| {
+            return .{ .base = NONE, .offset = value };
+        }
+        for (index.rows_in(ADD, class)) |entry| {
+            const node = graph.nodes.items[entry.row];
+            if (graph.constant_of(node.args[1])) |value| {
+                return .{ .base = graph.find(node.args[0]), .offset = value };
+            }
+        }
+        return .{ .base = graph.find(class), .offset = 0 };
+    }
+};
+
+/// A load from bytes the store before it doesn't touch into a load from
+/// the memory before that store, for addresses off of the same base
+fn load_past_store(graph: *EGraph, index: *const Index, match: *const Match) ApplyError!?Id {
+    const load = root_node(graph, match);
+    const store = graph.nodes.items[match.rows[1]];
+    const width = graph.size_of(match.vars[1]);
+    if (load.payload != store.payload or graph.size_of(match.vars[3]) != width) {
+        return null;
+    }
+
+    const stored = Pointer.of(graph, index, match.vars[1]);
+    const loaded = Pointer.of(graph, index, match.vars[3]);
+    if (stored.base != loaded.base) {
+        return null;
+    }
+    // the byte ranges wrap around the address space
+    if (mask(loaded.offset -% stored.offset, width) < graph.size_of(match.vars[2]) or mask(stored.offset -% loaded.offset, width) < load.size) {
+        return null;
+    }
+    return try graph.add(.{ .op = LOAD, .size = load.size, .payload = load.payload, .args = .{ match.vars[0], match.vars[3], NONE } });
+}
+
+/// Storing what was loaded from the same address into the memory as it was
+fn store_of_load(graph: *EGraph, _: *const Index, match: *const Match) ApplyError!?Id {
+    const store = root_node(graph, match);
+    const load = graph.nodes.items[match.rows[1]];
+    if (load.payload != store.payload) {
+        return null;
+    }
+    return match.vars[0];
+}
+
+/// A register left holding what it held on entry isn't written at all
+fn unchanged_register(graph: *EGraph, _: *const Index, match: *const Match) ApplyError!?Id {
+    const binding = root_node(graph, match);
+    const input = graph.nodes.items[match.rows[1]];
+    if (binding.payload != input.payload or binding.size != input.size) {
+        return null;
+    }
+    return match.vars[0];
+}
+
+fn commuted(comptime op: Op) Rule {
+    return .{ .name = "constant-second", .pattern = op_pattern(op, &.{ const_pattern(0), var_pattern(1) }), .apply = &constant_second };
+}
+
+fn neutral(comptime op: Op) Rule {
+    return .{ .name = "identity", .pattern = op_pattern(op, &.{ var_pattern(0), const_pattern(1) }), .apply = &identity };
+}
+
+fn absorbing(comptime op: Op) Rule {
+    return .{ .name = "absorb", .pattern = op_pattern(op, &.{ var_pattern(0), const_pattern(1) }), .apply = &absorb };
+}
+
+fn self_op(comptime op: Op, comptime apply: anytype) Rule {
+    return .{ .name = "self", .pattern = op_pattern(op, &.{ var_pattern(0), var_pattern(0) }), .apply = apply };
+}
+
+fn involution(comptime op: Op) Rule {
+    return .{ .name = "involution", .pattern = op_pattern(op, &.{op_pattern(op, &.{var_pattern(0)})}), .apply = &first };
+}
+
+/// The rewrites gadgets are saturated with, see the functions they apply
+pub const GADGET_RULES = [_]Rule{
+    commuted(ADD),
+    commuted(MULT),
+    commuted(AND),
+    commuted(OR),
+    commuted(XOR),
+    commuted(EQUAL),
+    commuted(NOTEQUAL),
+    .{ .name = "sub-constant", .pattern = op_pattern(SUB, &.{ var_pattern(0), const_pattern(1) }), .apply = &sub_constant },
+    .{ .name = "add-add", .pattern = op_pattern(ADD, &.{ op_pattern(ADD, &.{ var_pattern(0), const_pattern(1) }), const_pattern(2) }), .apply = &add_add },
+    neutral(ADD),
+    neutral(MULT),
+    neutral(AND),
+    neutral(OR),
+    neutral(XOR),
+    neutral(LEFT),
+    neutral(RIGHT),
+    neutral(SRIGHT),
+    absorbing(AND),
+    absorbing(MULT),
+    absorbing(OR),
+    self_op(SUB, &zero),
+    self_op(XOR, &zero),
+    self_op(NOTEQUAL, &zero),
+    self_op(LESS, &zero),
+    self_op(SLESS, &zero),
+    self_op(EQUAL, &one),
+    self_op(LESSEQUAL, &one),
+    self_op(SLESSEQUAL, &one),
+    self_op(AND, &first),
+    self_op(OR, &first),
+    involution(NEGATE),
+    involution(TWOCOMP),
+    involution(BOOL_NEGATE),
+    .{ .name = "truncate-zext", .pattern = op_pattern(SUBPIECE, &.{ op_pattern(ZEXT, &.{var_pattern(0)}), const_pattern(1) }), .apply = &truncate },
+    .{ .name = "truncate-sext", .pattern = op_pattern(SUBPIECE, &.{ op_pattern(SEXT, &.{var_pattern(0)}), const_pattern(1) }), .apply = &truncate },
+    .{ .name = "truncate-full", .pattern = op_pattern(SUBPIECE, &.{ var_pattern(0), const_pattern(1) }), .apply = &truncate },
+    .{ .name = "load-after-store", .pattern = op_pattern(LOAD, &.{ op_pattern(STORE, &.{ var_pattern(0), var_pattern(1), var_pattern(2) }), var_pattern(1) }), .apply = &load_after_store },
+    .{ .name = "load-past-store", .pattern = op_pattern(LOAD, &.{ op_pattern(STORE, &.{ var_pattern(0), var_pattern(1), var_pattern(2) }), var_pattern(3) }), .apply = &load_past_store },
+    .{ .name = "store-of-load", .pattern = op_pattern(STORE, &.{ var_pattern(0), var_pattern(1), op_pattern(LOAD, &.{ var_pattern(0), var_pattern(1) }) }), .apply = &store_of_load },
+    .{ .name = "unchanged-register", .pattern = op_pattern(.bind, &.{ op_pattern(.input, &.{}), var_pattern(0) }), .apply = &unchanged_register },
+};
+
+/// A varnode, values are tracked per exact location
+const Location = struct {
+    space: u32,
+    offset: u64,
+    size: u32,
+
+    fn of(vn: sleigh.CompactVarnodeDesc) Location {
+        return Location{ .space = vn.space, .offset = vn.offset, .size = vn.size };
+    }
+
+    fn overlaps(self: Location, other: Location) bool {
+        return self.space == other.space and self.offset < other.offset + other.size and other.offset < self.offset + self.size;
+    }
+
+    fn contains(self: Location, other: Location) bool {
+        return self.space == other.space and self.offset <= other.offset and other.offset + other.size <= self.offset + self.size;
+    }
+
+    fn lessThan(_: void, lhs: Location, rhs: Location) bool {
+        if (lhs.offset != rhs.offset) {
+            return lhs.offset < rhs.offset;
+        }
+        return lhs.size < rhs.size;
+    }
+};
+
+/// How a gadget hands control back, and to where
+const Exit = struct {
+    terminator: Terminator,
+    target: Id,
+};
+
+/// Executes the p-code of one gadget into terms of the graph
+const Executor = struct {
+    graph: *EGraph,
+    range: *const sleigh.LiftedRange,
+    spaces: *const sleigh.SpaceTable,
+    /// term held by every register + `unique` written so far
+    values: std.AutoArrayHashMap(Location, Id),
+    /// memory after the stores so far
+    memory: Id,
+    /// set once the gadget does something that isn't modelled
+    opaque_gadget: bool = false,
+
+    /// The root term of the gadget
+    fn run(self: *Executor) !Id {
+        var exit: ?Exit = null;
+        outer: for (self.range.insns()) |*insn| {
+            for (insn.op_start..insn.op_start + insn.op_count) |op_idx| {
+                exit = try self.step(self.range.op(op_idx));
+                if (exit != null or self.opaque_gadget) {
+                    break :outer;
+                }
+            }
+        }
+        if (self.opaque_gadget) {
+            return self.graph.fresh_opaque(0);
+        }
+        return self.root(exit orelse .{ .terminator = .none, .target = NONE });
+    }
+
+    /// Binds every register written, in offset order, on top of the exit
+    fn root(self: *Executor, exit: Exit) !Id {
+        var registers = std.ArrayList(Location).init(self.graph.allocator);
+        defer registers.deinit();
+        for (self.values.keys()) |location| {
+            if (kind_of(self.spaces, location.space) == .REGISTER) {
+                try registers.append(location);
+            }
+        }
+        std.mem.sort(Location, registers.items, {}, Location.lessThan);
+
+        var rest = try self.graph.add(.{ .op = .exit, .size = 0, .payload = @intFromEnum(exit.terminator), .args = .{ self.memory, exit.target, NONE } });
+        var idx = registers.items.len;
+        while (idx > 0) {
+            idx -= 1;
+            const location = registers.items[idx];
+            rest = try self.graph.add(.{ .op = .bind, .size = location.size, .payload = location.offset, .args = .{ self.values.get(location).?, rest, NONE } });
+        }
+        return rest;
+    }
+
+    fn step(self: *Executor, pcode: sleigh.RangePcodeOp) !?Exit {
+        const first_input: u64 = pcode.input_start;
+        switch (pcode.opcode) {
+            .CPUI_COPY => {
+                const out = self.range.output(pcode) orelse return null;
+                try self.write(out, try self.read(first_input));
+            },
+            .CPUI_LOAD => {
+                const out = self.range.output(pcode) orelse return null;
+                const space = self.range.varnode(first_input).offset;
+                const address = try self.read(first_input + 1);
+                try self.write(out, try self.graph.add(.{ .op = LOAD, .size = out.size, .payload = space, .args = .{ self.memory, address, NONE } }));
+            },
+            .CPUI_STORE => {
+                const space = self.range.varnode(first_input).offset;
+                const address = try self.read(first_input + 1);
+                const value = try self.read(first_input + 2);
+                self.memory = try self.graph.add(.{ .op = STORE, .size = 0, .payload = space, .args = .{ self.memory, address, value } });
+            },
+            .CPUI_BRANCH, .CPUI_CALL => {
+                const vn = self.range.varnode(first_input);
+                // a branch within the p-code of one instruction
+                if (kind_of(self.spaces, vn.space) == .CONST) {
+                    self.opaque_gadget = true;
+                    return null;
+                }
+                return Exit{ .terminator = Terminator.from_opcode(pcode.opcode).?, .target = try self.graph.constant(vn.offset, vn.size) };
+            },
+            .CPUI_BRANCHIND, .CPUI_CALLIND, .CPUI_RETURN => {
+                return Exit{ .terminator = Terminator.from_opcode(pcode.opcode).?, .target = try self.read(first_input) };
+            },
+            .CPUI_CBRANCH => self.opaque_gadget = true,
+            else => {
+                // a user op without an output is only there for its side effects
+                const out = self.range.output(pcode) orelse {
+                    self.opaque_gadget = true;
+                    return null;
+                };
+                if (pcode.input_len == 0 or pcode.input_len > MAX_ARGS) {
+                    self.opaque_gadget = true;
+                    return null;
+                }
+
+                var node = Node{ .op = Op.of(pcode.opcode), .size = out.size };
+                for (0..pcode.input_len) |idx| {
+                    node.args[idx] = try self.read(first_input + idx);
+                }
+                try self.write(out, try self.graph.add(node));
+            },
+        }
+        return null;
+    }
+
+    fn read(self: *Executor, index: u64) !Id {
+        const vn = self.range.varnode(index);
+        const location = Location.of(vn);
+        const kind = kind_of(self.spaces, vn.space) orelse return self.unknown(vn.size);
+        switch (kind) {
+            .CONST => return self.graph.constant(vn.offset, vn.size),
+            .REGISTER, .UNIQUE => {
+                if (self.values.get(location)) |id| {
+                    return id;
+                }
+                if (kind == .UNIQUE or self.overlaps_written(location)) {
+                    return self.unknown(vn.size);
+                }
+                return self.graph.add(.{ .op = .input, .size = vn.size, .payload = vn.offset });
+            },
+            .RAM, .DATA, .CODE, .STACK => {
+                const address = try self.graph.constant(vn.offset, 8);
+                return self.graph.add(.{ .op = LOAD, .size = vn.size, .payload = vn.space, .args = .{ self.memory, address, NONE } });
+            },
+            else => return self.unknown(vn.size),
+        }
+    }
+
+    fn write(self: *Executor, vn: sleigh.CompactVarnodeDesc, value: Id) !void {
+        const location = Location.of(vn);
+        switch (kind_of(self.spaces, vn.space) orelse .JOIN) {
+            .REGISTER, .UNIQUE => {
+                // whatever this covers is gone, a location it only covers
+                // in part couldn't be read back
+                var idx = self.values.count();
+                while (idx > 0) {
+                    idx -= 1;
+                    const other = self.values.keys()[idx];
+                    if (std.meta.eql(other, location) or !other.overlaps(location)) {
+                        continue;
+                    }
+                    if (!location.contains(other)) {
+                        self.opaque_gadget = true;
+                        return;
+                    }
+                    self.values.swapRemoveAt(idx);
+                }
+                try self.values.put(location, value);
+            },
+            .RAM, .DATA, .CODE, .STACK => {
+                const address = try self.graph.constant(vn.offset, 8);
+                self.memory = try self.graph.add(.{ .op = STORE, .size = 0, .payload = vn.space, .args = .{ self.memory, address, value } });
+            },
+            else => self.opaque_gadget = true,
+        }
+    }
+
+    fn overlaps_written(self: *const Executor, location: Location) bool {
+        for (self.values.keys()) |other| {
+            if (other.overlaps(location)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    fn unknown(self: *Executor, size: u32) !Id {
+        self.opaque_gadget = true;
+        return self.graph.fresh_opaque(size);
+    }
+};
+
+fn kind_of(spaces: *const sleigh.SpaceTable, space: u32) ?sleigh.VarnodeSpace {
+    if (space >= spaces.kinds.len) {
+        return null;
+    }
+    return spaces.kinds[space];
+}
+
+/// Gadgets of one target in one e-graph, deduplicated by what they do
+pub const GadgetSemantics = struct {
+    graph: EGraph,
+    /// root e-class of every gadget, by the number `add()` gave it
+    roots: std.ArrayListUnmanaged(Id) = .{},
+
+    const Self = @This();
+
+    pub fn init(allocator: std.mem.Allocator) Self {
+        return Self{ .graph = EGraph.init(allocator) };
+    }
+
+    pub fn deinit(self: *Self) void {
+        self.roots.deinit(self.graph.allocator);
+        self.graph.deinit();
+        self.* = undefined;
+    }
+
+    /// Adds the gadget lifted into `range`, returns its number
+    pub fn add(self: *Self, range: *const sleigh.LiftedRange, spaces: *const sleigh.SpaceTable) !usize {
+        var executor = Executor{
+            .graph = &self.graph,
+            .range = range,
+            .spaces = spaces,
+            .values = std.AutoArrayHashMap(Location, Id).init(self.graph.allocator),
+            .memory = try self.graph.add(.{ .op = .memory, .size = 0 }),
+        };
+        defer executor.values.deinit();
+
+        const root = try executor.run();
+        try self.roots.append(self.graph.allocator, root);
+        return self.roots.items.len - 1;
+    }
+
+    /// Adds a gadget equal to no other (like one that failed to lift),
+    /// returns its number
+    pub fn add_opaque(self: *Self) !usize {
+        try self.roots.append(self.graph.allocator, try self.graph.fresh_opaque(0));
+        return self.roots.items.len - 1;
+    }
+
+    pub fn saturate(self: *Self, limits: Limits) !Saturation {
+        return self.graph.saturate(&GADGET_RULES, limits);
+    }
+
+    /// Whether the gadgets `a` and `b` were shown to do the same thing
+    pub fn same(self: *Self, a: usize, b: usize) bool {
+        return self.graph.find(self.roots.items[a]) == self.graph.find(self.roots.items[b]);
+    }
+
+    /// The number of the first gadget doing the same thing, for every
+    /// gadget. Caller owned.
+    pub fn representatives(self: *Self, allocator: std.mem.Allocator) ![]u32 {
+        var first_of = std.AutoHashMap(Id, u32).init(allocator);
+        defer first_of.deinit();
+
+        const out = try allocator.alloc(u32, self.roots.items.len);
+        errdefer allocator.free(out);
+        for (self.roots.items, out, 0..) |root, *representative, idx| {
+            const entry = try first_of.getOrPut(self.graph.find(root));
+            if (!entry.found_existing) {
+                entry.value_ptr.* = @intCast(idx);
+            }
+            representative.* = entry.value_ptr.*;
+        }
+        return out;
+    }
+};
+
+test "stack pointer adjustments are normalized" {
+    var graph = EGraph.init(testing.allocator);
+    defer graph.deinit();
+
+    const sp = try graph.add(.{ .op = .input, .size = 4, .payload = 0x54 });
+    // (sp + 8) + 8, sp - 0xfffffff0 and (16 + sp)
+    const twice = try graph.add(.{ .op = ADD, .size = 4, .args = .{ try graph.add(.{ .op = ADD, .size = 4, .args = .{ sp, try graph.constant(8, 4), NONE } }), try graph.constant(8, 4), NONE } });
+    const sub = try graph.add(.{ .op = SUB, .size = 4, .args = .{ sp, try graph.constant(0xfffffff0, 4), NONE } });
+    const flipped = try graph.add(.{ .op = ADD, .size = 4, .args = .{ try graph.constant(16, 4), sp, NONE } });
+    // sp + 4 + (-4)
+    const back = try graph.add(.{ .op = ADD, .size = 4, .args = .{ try graph.add(.{ .op = ADD, .size = 4, .args = .{ sp, try graph.constant(4, 4), NONE } }), try graph.constant(0xfffffffc, 4), NONE } });
+
+    const report = try graph.saturate(&GADGET_RULES, .{});
+    try testing.expectEqual(Saturation.Stop.saturated, report.stop);
+    try testing.expectEqual(graph.find(twice), graph.find(sub));
+    try testing.expectEqual(graph.find(twice), graph.find(flipped));
+    try testing.expectEqual(graph.find(sp), graph.find(back));
+}
+
+test "constants fold and congruent nodes merge" {
+    var graph = EGraph.init(testing.allocator);
+    defer graph.deinit();
+
+    // folded as they are added
+    const sum = try graph.add(.{ .op = ADD, .size = 1, .args = .{ try graph.constant(0xff, 1), try graph.constant(2, 1), NONE } });
+    try testing.expectEqual(@as(?u64, 1), graph.constant_of(sum));
+
+    const a = try graph.add(.{ .op = .input, .size = 4, .payload = 0 });
+    const b = try graph.add(.{ .op = .input, .size = 4, .payload = 4 });
+    const neg_a = try graph.add(.{ .op = NEGATE, .size = 4, .args = .{ a, NONE, NONE } });
+    const neg_b = try graph.add(.{ .op = NEGATE, .size = 4, .args = .{ b, NONE, NONE } });
+    try testing.expect(graph.find(neg_a) != graph.find(neg_b));
+
+    // merging the children merges the parents once rebuilt
+    try testing.expect(graph.merge(a, b));
+    try graph.rebuild();
+    try testing.expectEqual(graph.find(neg_a), graph.find(neg_b));
+
+    // and once a child turns constant the parent does too
+    try testing.expect(graph.merge(a, try graph.constant(0, 4)));
+    _ = try graph.saturate(&GADGET_RULES, .{});
+    try testing.expectEqual(@as(?u64, 0xffffffff), graph.constant_of(neg_a));
+}
+
+test "loads see through stores" {
+    var graph = EGraph.init(testing.allocator);
+    defer graph.deinit();
+
+    const memory = try graph.add(.{ .op = .memory, .size = 0 });
+    const sp = try graph.add(.{ .op = .input, .size = 8, .payload = 0x20 });
+    const value = try graph.add(.{ .op = .input, .size = 8, .payload = 0 });
+    const slot = try graph.add(.{ .op = ADD, .size = 8, .args = .{ sp, try graph.constant(8, 8), NONE } });
+    const stored = try graph.add(.{ .op = STORE, .size = 0, .payload = 1, .args = .{ memory, slot, value } });
+
+    const same_slot = try graph.add(.{ .op = LOAD, .size = 8, .payload = 1, .args = .{ stored, slot, NONE } });
+    const below = try graph.add(.{ .op = LOAD, .size = 8, .payload = 1, .args = .{ stored, sp, NONE } });
+    const overlapping = try graph.add(.{ .op = LOAD, .size = 8, .payload = 1, .args = .{ stored, try graph.add(.{ .op = ADD, .size = 8, .args = .{ sp, try graph.constant(4, 8), NONE } }), NONE } });
+    const untouched = try graph.add(.{ .op = LOAD, .size = 8, .payload = 1, .args = .{ memory, sp, NONE } });
+    // storing back what was loaded changes nothing
+    const restored = try graph.add(.{ .op = STORE, .size = 0, .payload = 1, .args = .{ memory, sp, untouched } });
+
+    _ = try graph.saturate(&GADGET_RULES, .{});
+    try testing.expectEqual(graph.find(value), graph.find(same_slot));
+    try testing.expectEqual(graph.find(untouched), graph.find(below));
+    try testing.expect(graph.find(untouched) != graph.find(overlapping));
+    try testing.expectEqual(graph.find(memory), graph.find(restored));
+}
+
+const TestGadget = struct {
+    address: u64,
+    size: u64,
+};
+
+test "gadgets are deduplicated by what they do" {
+    var arena = std.heap.ArenaAllocator.init(testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    // `str r0, [sp, #-4]!; ldr r0, [sp], #4; bx lr; str r0, [sp, #-4]; bx lr`
+    const data = try allocator.dupe(u8, &.{ 0x04, 0x00, 0x2d, 0xe5, 0x04, 0x00, 0x9d, 0xe4, 0x1e, 0xff, 0x2f, 0xe1, 0x04, 0x00, 0x0d, 0xe5, 0x1e, 0xff, 0x2f, 0xe1 });
+    var regions = [_]shard.ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "code"), .base_address = 0, .data = data }};
+    var target = shard.ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var shard_rt = shard.ShardRuntime.init(allocator);
+    defer shard_rt.deinit();
+    try shard_rt.load_target(target);
+
+    const gadgets = [_]TestGadget{
+        // push + pop of r0 leaves r0 + sp as they were, only the store stays
+        .{ .address = 0x0, .size = 12 },
+        .{ .address = 0xc, .size = 8 },
+        .{ .address = 0x8, .size = 4 },
+        // pops r0
+        .{ .address = 0x4, .size = 8 },
+        .{ .address = 0x10, .size = 4 },
+    };
+
+    var semantics = GadgetSemantics.init(allocator);
+    defer semantics.deinit();
+    for (gadgets) |gadget| {
+        var lifted = sleigh.LiftedRange{};
+        try shard_rt.sleigh_handle.lift_range(gadget.address, gadget.address + gadget.size, &lifted);
+        defer shard_rt.sleigh_handle.release_range(&lifted);
+        _ = try semantics.add(&lifted, &shard_rt.spaces);
+    }
+
+    const report = try semantics.saturate(.{});
+    try testing.expectEqual(Saturation.Stop.saturated, report.stop);
+    const representatives = try semantics.representatives(allocator);
+    try testing.expectEqualSlices(u32, &.{ 0, 0, 2, 3, 2 }, representatives);
+}
@@ -0,0 +1,1046 @@
+//! Persistent index of found gadgets, looked up by what they do instead of
+//! lifting + walking the image again.
+//!
+//! An index is a directory of segments, one per spec + context + image
+//! (the `TargetKey` of the lift cache). A segment holds every gadget found
+//! in its image and is never changed once written, so indexing another
+//! binary or spec only adds a segment next to the others. Each one has:
+//!
+//! - a `GadgetRecord` per gadget, sorted by end address
+//! - the sorted names of every register its gadgets write
+//! - an ascending list of gadget ids per register written, per register
+//!   popped off of the stack and per terminator kind. Queries intersect
+//!   these inverted lists, no gadget is looked at unless it matches them.
+//! - the text of every gadget
+//!
+//! Like lift cache entries, segments are written to a temporary file and
+//! renamed into place, then mapped back in as they are. Every table is
+//! sorted, so lookups are binary searches over the mapping.
+const std = @import("std");
+const testing = std.testing;
+const sleigh = @import("../sleigh.zig");
+const shard = @import("../shard.zig");
+const lift_cache = @import("lift_cache.zig");
+
+const ShardRuntime = shard.ShardRuntime;
+const TargetKey = lift_cache.TargetKey;
+
+const logger = std.log.scoped(.shard_gadget_index);
+
+/// First bytes of every segment, the last byte is the format version
+const SEGMENT_MAGIC = "SFGIDX\x00\x01".*;
+
+/// Written as a native `u32` to reject segments from a host with the other
+/// byte order
+const SEGMENT_BYTE_ORDER: u32 = 0x01020304;
+
+/// File extension of a segment inside of the index directory
+const SEGMENT_EXTENSION = ".gadgets";
+
+/// How a gadget hands control back
+pub const Terminator = enum(u8) {
+    none = 0,
+    ret = 1,
+    branch_indirect = 2,
+    call_indirect = 3,
+    branch = 4,
+    call = 5,
+
+    pub fn from_opcode(opcode: sleigh.OpCode) ?Terminator {
+        return switch (opcode) {
+            .CPUI_RETURN => .ret,
+            .CPUI_BRANCHIND => .branch_indirect,
+            .CPUI_CALLIND => .call_indirect,
+            .CPUI_BRANCH => .branch,
+            .CPUI_CALL => .call,
+            else => null,
+        };
+    }
+};
+
+/// One gadget as stored in a segment
+pub const GadgetRecord = extern struct {
+    address: u64,
+    size: u64,
+    /// net change of the stack pointer, `SP_UNKNOWN` if it isn't a constant
+    sp_delta: i64,
+    /// into the text of the segment
+    text_offset: u64,
+    text_len: u32,
+    loads: u16,
+    stores: u16,
+    terminator: Terminator,
+    _pad: [7]u8 = .{0} ** 7,
+
+    pub const SP_UNKNOWN: i64 = std.math.minInt(i64);
+
+    /// First byte past the gadget, what records are sorted by
+    pub fn end(self: *const GadgetRecord) u64 {
+        return self.address + self.size;
+    }
+};
+
+/// Start of every segment, the tables follow in the order of the counts
+const SegmentHeader = extern struct {
+    magic: [8]u8 = SEGMENT_MAGIC,
+    byte_order: u32 = SEGMENT_BYTE_ORDER,
+    _pad: u32 = 0,
+    spec_hash: u64,
+    context_hash: u64,
+    image_hash: u64,
+    gadget_count: u64,
+    name_count: u64,
+    posting_count: u64,
+    id_count: u64,
+    names_size: u64,
+    text_size: u64,
+};
+
+/// A register name inside of the names blob
+const NameRecord = extern struct {
+    offset: u32,
+    len: u32,
+};
+
+const PostingKind = enum(u32) {
+    /// `key` is the id of a register written
+    writes = 0,
+    /// `key` is the id of a register left holding a value off of the stack
+    pops = 1,
+    /// `key` is a `Terminator`
+    terminator = 2,
+};
+
+/// An inverted list, `len` gadget ids from `start` of the id table
+const Posting = extern struct {
+    kind: PostingKind,
+    key: u32,
+    start: u32,
+    len: u32,
+
+    fn lessThan(_: void, lhs: Posting, rhs: Posting) bool {
+        return order(lhs.kind, lhs.key, rhs) == .lt;
+    }
+
+    fn order(kind: PostingKind, key: u32, posting: Posting) std.math.Order {
+        const lhs = (@as(u64, @intFromEnum(kind)) << 32) | key;
+        const rhs = (@as(u64, @intFromEnum(posting.kind)) << 32) | posting.key;
+        return std.math.order(lhs, rhs);
+    }
+};
+
+/// What a gadget does, gathered from its p-code by following the stack
+/// pointer and everything loaded relative to it through copies, extensions
+/// and constant adds + subtracts. The names borrow from the register map of
+/// the runtime the gadget was lifted with.
+pub const GadgetEffects = struct {
+    /// every register written
+    writes: std.ArrayList([]const u8),
+    /// registers left holding a value loaded off of the stack
+    pops: std.ArrayList([]const u8),
+    sp_delta: ?i64 = 0,
+    loads: u16 = 0,
+    stores: u16 = 0,
+    terminator: Terminator = .none,
+
+    const Self = @This();
+
+    /// A varnode, values are tracked per exact location
+    const Location = struct {
+        space: u32,
+        offset: u64,
+        size: u32,
+
+        fn of(vn: sleigh.CompactVarnodeDesc) Location {
+            return Location{ .space = vn.space, .offset = vn.offset, .size = vn.size };
+        }
+
+        fn overlaps(self: Location, other: Location) bool {
+            return self.space == other.space and self.offset < other.offset + other.size and other.offset < self.offset + self.size;
+        }
+    };
+
+    const Value = union(enum) {
+        unknown,
+        constant: u64,
+        /// the stack pointer on entry plus this many bytes
+        stack: i64,
+        /// something loaded relative to the stack pointer
+        stack_load,
+    };
+
+    /// Values of every location written so far
+    const Tracker = struct {
+        range: *const sleigh.LiftedRange,
+        spaces: *const sleigh.SpaceTable,
+        values: std.AutoHashMap(Location, Value),
+        sp: ?Location,
+
+        fn input(self: *const Tracker, index: u64) Value {
+            const vn = self.range.varnode(index);
+            const location = Location.of(vn);
+            if (self.values.get(location)) |value| {
+                return value;
+            }
+            if (self.sp) |sp| {
+                if (std.meta.eql(location, sp)) {
+                    return .{ .stack = 0 };
+                }
+            }
+            if (kind_of(self.spaces, vn.space) == .CONST) {
+                return .{ .constant = vn.offset };
+            }
+            return .unknown;
+        }
+    };
+
+    pub fn analyze(range: *const sleigh.LiftedRange, shard_rt: *const ShardRuntime, allocator: std.mem.Allocator) !Self {
+        var self = Self{ .writes = std.ArrayList([]const u8).init(allocator), .pops = std.ArrayList([]const u8).init(allocator) };
+        errdefer self.deinit();
+
+        var tracker = Tracker{
+            .range = range,
+            .spaces = &shard_rt.spaces,
+            .values = std.AutoHashMap(Location, Value).init(allocator),
+            .sp = stack_location(&shard_rt.register_map, shard_rt.stack_pointer.space),
+        };
+        defer tracker.values.deinit();
+        var written = std.AutoArrayHashMap(Location, []const u8).init(allocator);
+        defer written.deinit();
+
+        var sp_clobbered = false;
+        for (range.insns()) |*insn| {
+            for (insn.op_start..insn.op_start + insn.op_count) |op_idx| {
+                const pcode = range.op(op_idx);
+                if (Terminator.from_opcode(pcode.opcode)) |terminator| {
+                    self.terminator = terminator;
+                }
+
+                const value = self.evaluate(&tracker, pcode);
+                const out = range.output(pcode) orelse continue;
+                const location = Location.of(out);
+                try tracker.values.put(location, value);
+
+                if (kind_of(&shard_rt.spaces, out.space) != .REGISTER) {
+                    continue;
+                }
+                if (shard_rt.register_map.lookup(out.offset, out.size)) |reg| {
+                    try written.put(location, std.mem.sliceTo(&reg.name, 0));
+                }
+                if (tracker.sp) |sp| {
+                    if (!std.meta.eql(location, sp) and location.overlaps(sp)) {
+                        sp_clobbered = true;
+                    }
+                }
+            }
+        }
+
+        if (tracker.sp == null or sp_clobbered) {
+            self.sp_delta = null;
+        } else if (tracker.values.get(tracker.sp.?)) |value| {
+            self.sp_delta = switch (value) {
+                .stack => |delta| delta,
+                else => null,
+            };
+        }
+
+        var it = written.iterator();
+        while (it.next()) |entry| {
+            try self.writes.append(entry.value_ptr.*);
+            const value = tracker.values.get(entry.key_ptr.*) orelse continue;
+            if (value == .stack_load) {
+                try self.pops.append(entry.value_ptr.*);
+            }
+        }
+
+        return self;
+    }
+
+    pub fn deinit(self: *Self) void {
+        self.writes.deinit();
+        self.pops.deinit();
+        self.* = undefined;
+    }
+
+    fn evaluate(self: *Self, tracker: *const Tracker, pcode: sleigh.RangePcodeOp) Value {
+        const first: u64 = pcode.input_start;
+        switch (pcode.opcode) {
+            .CPUI_COPY, .CPUI_INT_ZEXT, .CPUI_INT_SEXT, .CPUI_SUBPIECE => {
+                const value = tracker.input(first);
+                // only the full width copy keeps a stack address intact
+                if (pcode.opcode != .CPUI_COPY and value == .stack) {
+                    return .unknown;
+                }
+                return value;
+            },
+            .CPUI_INT_ADD, .CPUI_INT_SUB => {
+                if (pcode.input_len != 2) {
+                    return .unknown;
+                }
+                const lhs = tracker.input(first);
+                const rhs = tracker.input(first + 1);
+                const negate = pcode.opcode == .CPUI_INT_SUB;
+                if (lhs == .stack and rhs == .constant) {
+                    const delta = signed(rhs.constant, tracker.range.varnode(first + 1).size);
+                    return .{ .stack = if (negate) lhs.stack -% delta else lhs.stack +% delta };
+                }
+                if (!negate and lhs == .constant and rhs == .stack) {
+                    return .{ .stack = rhs.stack +% signed(lhs.constant, tracker.range.varnode(first).size) };
+                }
+                if (lhs == .constant and rhs == .constant) {
+                    return .{ .constant = if (negate) lhs.constant -% rhs.constant else lhs.constant +% rhs.constant };
+                }
+                return .unknown;
+            },
+            .CPUI_LOAD => {
+                self.loads +|= 1;
+                if (pcode.input_len == 2 and tracker.input(first + 1) == .stack) {
+                    return .stack_load;
+                }
+                return .unknown;
+            },
+            .CPUI_STORE => {
+                self.stores +|= 1;
+                return .unknown;
+            },
+            else => return .unknown,
+        }
+    }
+
+    /// The stack pointer deltas are tracked for: the widest register named
+    /// `sp` or `<x>sp` (`rsp` over `esp` over `sp`), other registers with
+    /// `sp` in their name like `spsr` are left alone
+    fn stack_location(register_map: *const shard.RegisterMap, space: u32) ?Location {
+        var widest: ?Location = null;
+        for (register_map.items()) |reg| {
+            const name = std.mem.sliceTo(&reg.name, 0);
+            if (!std.mem.endsWith(u8, name, "sp") or name.len > 3) {
+                continue;
+            }
+            if (widest == null or reg.size > widest.?.size) {
+                widest = Location{ .space = space, .offset = reg.offset_key, .size = @intCast(reg.size) };
+            }
+        }
+        return widest;
+    }
+
+    fn kind_of(spaces: *const sleigh.SpaceTable, space: u32) ?sleigh.VarnodeSpace {
+        if (space >= spaces.kinds.len) {
+            return null;
+        }
+        return spaces.kinds[space];
+    }
+
+    /// `value` of `size` bytes as a signed number
+    fn signed(value: u64, size: u32) i64 {
+        if (size == 0 or size >= 8) {
+            return @bitCast(value);
+        }
+        const shift: u6 = @intCast(64 - size * 8);
+        return @as(i64, @bitCast(value << shift)) >> shift;
+    }
+};
+
+/// What to look for, every field that is set must match
+pub const GadgetQuery = struct {
+    /// registers the gadget writes
+    writes: []const []const u8 = &.{},
+    /// registers the gadget loads off of the stack
+    pops: []const []const u8 = &.{},
+    terminator: ?Terminator = null,
+    sp_delta: ?i64 = null,
+    max_size: ?u64 = null,
+    /// only gadgets that don't write memory
+    no_stores: bool = false,
+
+    /// Parses comma separated terms: `writes:<reg>`, `pops:<reg>`,
+    /// `end:<terminator>`, `sp:<delta>`, `size:<max bytes>` and `nostore`.
+    /// For example `pops:a0,end:ret`.
+    pub fn parse(text: []const u8, allocator: std.mem.Allocator) !GadgetQuery {
+        var writes = std.ArrayList([]const u8).init(allocator);
+        errdefer writes.deinit();
+        var pops = std.ArrayList([]const u8).init(allocator);
+        errdefer pops.deinit();
+
+        var query = GadgetQuery{};
+        var terms = std.mem.tokenizeScalar(u8, text, ',');
+        while (terms.next()) |term| {
+            if (std.mem.eql(u8, term, "nostore")) {
+                query.no_stores = true;
+                continue;
+            }
+
+            const split = std.mem.indexOfScalar(u8, term, ':') orelse return error.InvalidQuery;
+            const name = term[0..split];
+            const value = term[split + 1 ..];
+            if (std.mem.eql(u8, name, "writes")) {
+                try writes.append(value);
+            } else if (std.mem.eql(u8, name, "pops")) {
+                try pops.append(value);
+            } else if (std.mem.eql(u8, name, "end")) {
+                query.terminator = std.meta.stringToEnum(Terminator, value) orelse return error.InvalidQuery;
+            } else if (std.mem.eql(u8, name, "sp")) {
+                query.sp_delta = try std.fmt.parseInt(i64, value, 0);
+            } else if (std.mem.eql(u8, name, "size")) {
+                query.max_size = try std.fmt.parseInt(u64, value, 0);
+            } else {
+                return error.InvalidQuery;
+            }
+        }
+
+        query.writes = try writes.toOwnedSlice();
+        query.pops = try pops.toOwnedSlice();
+        return query;
+    }
+
+    /// Whatever isn't answered by the inverted lists
+    fn matches(self: *const GadgetQuery, record: *const GadgetRecord) bool {
+        if (self.sp_delta) |delta| {
+            if (record.sp_delta != delta) {
+                return false;
+            }
+        }
+        if (self.max_size) |size| {
+            if (record.size > size) {
+                return false;
+            }
+        }
+        return !self.no_stores or record.stores == 0;
+    }
+};
+
+/// A gadget found in the index, `text` borrows from the index until it is
+/// closed
+pub const GadgetHit = struct {
+    record: GadgetRecord,
+    text: []const u8,
+    /// which image the gadget is in
+    image_hash: u64,
+};
+
+/// The gadgets of one image in an index as the inverted lists they are
+/// stored as, for searches that combine more of them than a `GadgetQuery`
+/// does (see `shard.chain_search`). Borrows from the index until it is
+/// closed or added to.
+pub const SegmentView = struct {
+    segment: *const Segment,
+
+    /// Every gadget of the image, ids index into this
+    pub fn records(self: SegmentView) []const GadgetRecord {
+        return self.segment.records;
+    }
+
+    pub fn image_hash(self: SegmentView) u64 {
+        return self.segment.header.image_hash;
+    }
+
+    /// Ascending ids of the gadgets writing `reg`
+    pub fn writing(self: SegmentView, reg: []const u8) []const u32 {
+        const id = self.segment.name_id(reg) orelse return &.{};
+        return self.segment.list(.writes, id);
+    }
+
+    /// Ascending ids of the gadgets loading `reg` off of the stack
+    pub fn popping(self: SegmentView, reg: []const u8) []const u32 {
+        const id = self.segment.name_id(reg) orelse return &.{};
+        return self.segment.list(.pops, id);
+    }
+
+    pub fn hit(self: SegmentView, id: u32) GadgetHit {
+        return self.segment.hit(&self.segment.records[id]);
+    }
+};
+
+/// A mapped segment, see the module docs
+const Segment = struct {
+    mapping: sleigh.MappedRegion,
+    header: SegmentHeader,
+    records: []const GadgetRecord,
+    names: []const NameRecord,
+    postings: []const Posting,
+    ids: []const u32,
+    names_blob: []const u8,
+    text: []const u8,
+
+    fn open(path: [:0]const u8) !Segment {
+        var mapping = try sleigh.MappedRegion.map(path, 0, 0);
+        errdefer mapping.unmap();
+
+        const bytes = mapping.slice();
+        if (bytes.len < @sizeOf(SegmentHeader)) {
+            return error.InvalidSegment;
+        }
+        const header = std.mem.bytesToValue(SegmentHeader, bytes[0..@sizeOf(SegmentHeader)]);
+        if (!std.mem.eql(u8, &header.magic, &SEGMENT_MAGIC) or header.byte_order != SEGMENT_BYTE_ORDER) {
+            return error.InvalidSegment;
+        }
+
+        var cursor: usize = @sizeOf(SegmentHeader);
+        var segment = Segment{
+            .mapping = mapping,
+            .header = header,
+            .records = try table(GadgetRecord, bytes, &cursor, header.gadget_count),
+            .names = try table(NameRecord, bytes, &cursor, header.name_count),
+            .postings = try table(Posting, bytes, &cursor, header.posting_count),
+            .ids = try table(u32, bytes, &cursor, header.id_count),
+            .names_blob = undefined,
+            .text = undefined,
+        };
+        segment.names_blob = try table(u8, bytes, &cursor, header.names_size);
+        segment.text = try table(u8, bytes, &cursor, header.text_size);
+
+        for (segment.names) |name| {
+            if (@as(u64, name.offset) + name.len > segment.names_blob.len) {
+                return error.InvalidSegment;
+            }
+        }
+        for (segment.postings) |posting| {
+            if (@as(u64, posting.start) + posting.len > segment.ids.len) {
+                return error.InvalidSegment;
+            }
+        }
+        for (segment.ids) |id| {
+            if (id >= segment.records.len) {
+                return error.InvalidSegment;
+            }
+        }
+        for (segment.records) |record| {
+            const text_end = std.math.add(u64, record.text_offset, record.text_len) catch return error.InvalidSegment;
+            if (text_end > segment.text.len) {
+                return error.InvalidSegment;
+            }
+        }
+
+        return segment;
+    }
+
+    fn close(self: *Segment) void {
+        self.mapping.unmap();
+        self.* = undefined;
+    }
+
+    /// The next `count` `T`'s at `cursor.*`, tables are padded to 8 bytes
+    fn table(comptime T: type, bytes: []const u8, cursor: *usize, count: u64) ![]const T {
+        const size = std.math.mul(u64, @sizeOf(T), count) catch return error.InvalidSegment;
+        if (size > bytes.len - cursor.*) {
+            return error.InvalidSegment;
+        }
+        const padded = std.mem.alignForward(u64, size, 8);
+        if (padded > bytes.len - cursor.*) {
+            return error.InvalidSegment;
+        }
+
+        const slice: []const T = @alignCast(std.mem.bytesAsSlice(T, bytes[cursor.*..][0..@intCast(size)]));
+        cursor.* += @intCast(padded);
+        return slice;
+    }
+
+    fn key(self: *const Segment) TargetKey {
+        return TargetKey{ .spec_hash = self.header.spec_hash, .context_hash = self.header.context_hash, .image_hash = self.header.image_hash };
+    }
+
+    fn name(self: *const Segment, id: usize) []const u8 {
+        const record = self.names[id];
+        return self.names_blob[record.offset..][0..record.len];
+    }
+
+    fn name_id(self: *const Segment, wanted: []const u8) ?u32 {
+        var lo: usize = 0;
+        var hi: usize = self.names.len;
+        while (lo < hi) {
+            const mid = lo + (hi - lo) / 2;
+            switch (std.mem.order(u8, self.name(mid), wanted)) {
+                .eq => return @intCast(mid),
+                .lt => lo = mid + 1,
+                .gt => hi = mid,
+            }
+        }
+        return null;
+    }
+
+    /// Ascending gadget ids of the list `kind`/`posting_key`, empty if none
+    fn list(self: *const Segment, kind: PostingKind, posting_key: u32) []const u32 {
+        var lo: usize = 0;
+        var hi: usize = self.postings.len;
+        while (lo < hi) {
+            const mid = lo + (hi - lo) / 2;
+            switch (Posting.order(kind, posting_key, self.postings[mid])) {
+                .eq => {
+                    const posting = self.postings[mid];
+                    return self.ids[posting.start..][0..posting.len];
+                },
+                .lt => hi = mid,
+                .gt => lo = mid + 1,
+            }
+        }
+        return &.{};
+    }
+
+    fn hit(self: *const Segment, record: *const GadgetRecord) GadgetHit {
+        return GadgetHit{ .record = record.*, .text = self.text[record.text_offset..][0..record.text_len], .image_hash = self.header.image_hash };
+    }
+
+    /// Every gadget ending right before `end_address`
+    fn ending_at(self: *const Segment, end_address: u64, out: *std.ArrayList(GadgetHit)) !void {
+        var lo: usize = 0;
+        var hi: usize = self.records.len;
+        while (lo < hi) {
+            const mid = lo + (hi - lo) / 2;
+            if (self.records[mid].end() < end_address) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        while (lo < self.records.len and self.records[lo].end() == end_address) : (lo += 1) {
+            try out.append(self.hit(&self.records[lo]));
+        }
+    }
+
+    fn query(self: *const Segment, wanted: *const GadgetQuery, allocator: std.mem.Allocator, out: *std.ArrayList(GadgetHit)) !void {
+        var lists = std.ArrayList([]const u32).init(allocator);
+        defer lists.deinit();
+
+        for (wanted.writes) |reg| {
+            const id = self.name_id(reg) orelse return;
+            try lists.append(self.list(.writes, id));
+        }
+        for (wanted.pops) |reg| {
+            const id = self.name_id(reg) orelse return;
+            try lists.append(self.list(.pops, id));
+        }
+        if (wanted.terminator) |terminator| {
+            try lists.append(self.list(.terminator, @intFromEnum(terminator)));
+        }
+
+        if (lists.items.len == 0) {
+            for (self.records) |*record| {
+                if (wanted.matches(record)) {
+                    try out.append(self.hit(record));
+                }
+            }
+            return;
+        }
+
+        // walk the shortest list, binary searching the others
+        std.mem.sort([]const u32, lists.items, {}, struct {
+            fn lessThan(_: void, lhs: []const u32, rhs: []const u32) bool {
+                return lhs.len < rhs.len;
+            }
+        }.lessThan);
+        candidates: for (lists.items[0]) |id| {
+            for (lists.items[1..]) |other| {
+                if (std.sort.binarySearch(u32, id, other, {}, orderId) == null) {
+                    continue :candidates;
+                }
+            }
+            const record = &self.records[id];
+            if (wanted.matches(record)) {
+                try out.append(self.hit(record));
+            }
+        }
+    }
+
+    fn orderId(_: void, lhs: u32, rhs: u32) std.math.Order {
+        return std.math.order(lhs, rhs);
+    }
+};
+
+/// A gadget + its effects, waiting to be written into a segment
+const PendingGadget = struct {
+    address: u64,
+    size: u64,
+    text: []const u8,
+    effects: GadgetEffects,
+
+    fn lessThan(_: void, lhs: PendingGadget, rhs: PendingGadget) bool {
+        const lhs_end = lhs.address + lhs.size;
+        const rhs_end = rhs.address + rhs.size;
+        if (lhs_end != rhs_end) {
+            return lhs_end < rhs_end;
+        }
+        return lhs.address < rhs.address;
+    }
+};
+
+/// The index directory, see the module docs
+pub const GadgetIndex = struct {
+    dir: std.fs.Dir,
+    /// path of `dir`, segments are mapped by path
+    path: []const u8,
+    segments: std.ArrayList(Segment),
+    allocator: std.mem.Allocator,
+
+    const Self = @This();
+
+    /// Opens (creating if needed) the index directory at `path` and maps
+    /// every segment in it
+    pub fn open(path: []const u8, allocator: std.mem.Allocator) !Self {
+        try std.fs.cwd().makePath(path);
+        var dir = try std.fs.cwd().openDir(path, .{ .iterate = true });
+        errdefer dir.close();
+
+        var self = Self{ .dir = dir, .path = try allocator.dupe(u8, path), .segments = std.ArrayList(Segment).init(allocator), .allocator = allocator };
+        errdefer {
+            allocator.free(self.path);
+            self.segments.deinit();
+        }
+
+        var it = dir.iterate();
+        while (try it.next()) |entry| {
+            if (entry.kind != .file or !std.mem.endsWith(u8, entry.name, SEGMENT_EXTENSION)) {
+                continue;
+            }
+            self.map_segment(entry.name) catch |err| {
+                logger.warn("Ignoring gadget index segment `{s}`: {}", .{ entry.name, err });
+            };
+        }
+
+        return self;
+    }
+
+    pub fn close(self: *Self) void {
+        for (self.segments.items) |*segment| {
+            segment.close();
+        }
+        self.segments.deinit();
+        self.dir.close();
+        self.allocator.free(self.path);
+        self.* = undefined;
+    }
+
+    /// Whether the gadgets of the target behind `key` are in the index
+    pub fn contains(self: *const Self, key: TargetKey) bool {
+        for (self.segments.items) |*segment| {
+            if (std.meta.eql(segment.key(), key)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Adds `gadgets` (anything with an `address`, `size` and `text`) found
+    /// in the target loaded into `shard_rt` as a new segment. Each gadget is
+    /// lifted once more to gather its `GadgetEffects`. Returns `false`
+    /// without doing anything if the target is already indexed.
+    pub fn add(self: *Self, shard_rt: *ShardRuntime, gadgets: anytype) !bool {
+        const target = shard_rt.target orelse return shard.ShardError.NoTarget;
+        const key = try TargetKey.of(&target, self.allocator);
+        if (self.contains(key)) {
+            return false;
+        }
+
+        var arena = std.heap.ArenaAllocator.init(self.allocator);
+        defer arena.deinit();
+        const allocator = arena.allocator();
+
+        var pending = try std.ArrayList(PendingGadget).initCapacity(allocator, gadgets.len);
+        for (gadgets) |gadget| {
+            var lifted = sleigh.LiftedRange{};
+            shard_rt.lift_gadget(gadget.address, gadget.size, &lifted) catch |err| {
+                logger.warn("Failed to lift gadget @ 0x{x}: {}", .{ gadget.address, err });
+                continue;
+            };
+            defer shard_rt.sleigh_handle.release_range(&lifted);
+
+            const effects = try GadgetEffects.analyze(&lifted, shard_rt, allocator);
+            pending.appendAssumeCapacity(PendingGadget{ .address = gadget.address, .size = gadget.size, .text = gadget.text, .effects = effects });
+        }
+        std.mem.sort(PendingGadget, pending.items, {}, PendingGadget.lessThan);
+
+        var name_buf: [64]u8 = undefined;
+        const name = try std.fmt.bufPrint(&name_buf, "{x:0>16}" ++ SEGMENT_EXTENSION, .{key.hash()});
+        try self.write_segment(name, key, pending.items, allocator);
+        try self.map_segment(name);
+        return true;
+    }
+
+    /// Every indexed gadget matching `wanted`, in segment + end address order
+    pub fn query(self: *const Self, wanted: *const GadgetQuery, allocator: std.mem.Allocator) !std.ArrayList(GadgetHit) {
+        var hits = std.ArrayList(GadgetHit).init(allocator);
+        errdefer hits.deinit();
+
+        for (self.segments.items) |*segment| {
+            try segment.query(wanted, allocator, &hits);
+        }
+        return hits;
+    }
+
+    /// Every image in the index, see `SegmentView`
+    pub fn views(self: *const Self, allocator: std.mem.Allocator) ![]SegmentView {
+        const out = try allocator.alloc(SegmentView, self.segments.items.len);
+        for (self.segments.items, out) |*segment, *view| {
+            view.* = SegmentView{ .segment = segment };
+        }
+        return out;
+    }
+
+    /// Every indexed gadget whose last byte is right before `end_address`
+    pub fn ending_at(self: *const Self, end_address: u64, allocator: std.mem.Allocator) !std.ArrayList(GadgetHit) {
+        var hits = std.ArrayList(GadgetHit).init(allocator);
+        errdefer hits.deinit();
+
+        for (self.segments.items) |*segment| {
+            try segment.ending_at(end_address, &hits);
+        }
+        return hits;
+    }
+
+    fn map_segment(self: *Self, name: []const u8) !void {
+        var path_buf: [std.fs.MAX_PATH_BYTES]u8 = undefined;
+        const path = try std.fmt.bufPrintZ(&path_buf, "{s}/{s}", .{ self.path, name });
+
+        var segment = try Segment.open(path);
+        errdefer segment.close();
+        try self.segments.append(segment);
+    }
+
+    /// Writes `gadgets` (sorted by end address) out as the segment `name`
+    fn write_segment(self: *Self, name: []const u8, key: TargetKey, gadgets: []const PendingGadget, allocator: std.mem.Allocator) !void {
+        // sorted register names, ids are indices into them
+        var name_set = std.StringArrayHashMap(void).init(allocator);
+        for (gadgets) |*gadget| {
+            for (gadget.effects.writes.items) |reg| {
+                try name_set.put(reg, {});
+            }
+            for (gadget.effects.pops.items) |reg| {
+                try name_set.put(reg, {});
+            }
+        }
+        const names = try allocator.dupe([]const u8, name_set.keys());
+        std.mem.sort([]const u8, names, {}, struct {
+            fn lessThan(_: void, lhs: []const u8, rhs: []const u8) bool {
+                return std.mem.lessThan(u8, lhs, rhs);
+            }
+        }.lessThan);
+        var name_ids = std.StringHashMap(u32).init(allocator);
+        for (names, 0..) |reg, id| {
+            try name_ids.put(reg, @intCast(id));
+        }
+
+        // the inverted lists, ids come out ascending as gadgets are visited
+        // in order
+        var lists = std.AutoArrayHashMap(Posting, std.ArrayList(u32)).init(allocator);
+        for (gadgets, 0..) |*gadget, idx| {
+            const id: u32 = @intCast(idx);
+            for (gadget.effects.writes.items) |reg| {
+                try add_id(&lists, .writes, name_ids.get(reg).?, id, allocator);
+            }
+            for (gadget.effects.pops.items) |reg| {
+                try add_id(&lists, .pops, name_ids.get(reg).?, id, allocator);
+            }
+            try add_id(&lists, .terminator, @intFromEnum(gadget.effects.terminator), id, allocator);
+        }
+        const postings = try allocator.dupe(Posting, lists.keys());
+        std.mem.sort(Posting, postings, {}, Posting.lessThan);
+
+        var ids = std.ArrayList(u32).init(allocator);
+        for (postings) |*posting| {
+            const list = lists.get(posting.*).?;
+            posting.start = @intCast(ids.items.len);
+            posting.len = @intCast(list.items.len);
+            try ids.appendSlice(list.items);
+        }
+
+        const name_records = try allocator.alloc(NameRecord, names.len);
+        var names_blob = std.ArrayList(u8).init(allocator);
+        for (names, name_records) |reg, *record| {
+            record.* = NameRecord{ .offset = @intCast(names_blob.items.len), .len = @intCast(reg.len) };
+            try names_blob.appendSlice(reg);
+        }
+
+        const records = try allocator.alloc(GadgetRecord, gadgets.len);
+        var text = std.ArrayList(u8).init(allocator);
+        for (gadgets, records) |*gadget, *record| {
+            const effects = &gadget.effects;
+            record.* = GadgetRecord{
+                .address = gadget.address,
+                .size = gadget.size,
+                .sp_delta = effects.sp_delta orelse GadgetRecord.SP_UNKNOWN,
+                .text_offset = text.items.len,
+                .text_len = @intCast(gadget.text.len),
+                .loads = effects.loads,
+                .stores = effects.stores,
+                .terminator = effects.terminator,
+            };
+            try text.appendSlice(gadget.text);
+        }
+
+        const header = SegmentHeader{
+            .spec_hash = key.spec_hash,
+            .context_hash = key.context_hash,
+            .image_hash = key.image_hash,
+            .gadget_count = records.len,
+            .name_count = name_records.len,
+            .posting_count = postings.len,
+            .id_count = ids.items.len,
+            .names_size = names_blob.items.len,
+            .text_size = text.items.len,
+        };
+
+        var tmp_buf: [96]u8 = undefined;
+        const tmp_name = try std.fmt.bufPrint(&tmp_buf, "{s}.{x:0>16}.tmp", .{ name, std.crypto.random.int(u64) });
+        {
+            const file = try self.dir.createFile(tmp_name, .{});
+            defer file.close();
+            errdefer self.dir.deleteFile(tmp_name) catch {};
+
+            var buffered = std.io.bufferedWriter(file.writer());
+            const writer = buffered.writer();
+            try writer.writeAll(std.mem.asBytes(&header));
+            try write_table(writer, std.mem.sliceAsBytes(records));
+            try write_table(writer, std.mem.sliceAsBytes(name_records));
+            try write_table(writer, std.mem.sliceAsBytes(postings));
+            try write_table(writer, std.mem.sliceAsBytes(ids.items));
+            try write_table(writer, names_blob.items);
+            try write_table(writer, text.items);
+            try buffered.flush();
+        }
+
+        self.dir.rename(tmp_name, name) catch |err| {
+            self.dir.deleteFile(tmp_name) catch {};
+            return err;
+        };
+    }
+
+    fn add_id(lists: *std.AutoArrayHashMap(Posting, std.ArrayList(u32)), kind: PostingKind, posting_key: u32, id: u32, allocator: std.mem.Allocator) !void {
+        const entry = try lists.getOrPut(Posting{ .kind = kind, .key = posting_key, .start = 0, .len = 0 });
+        if (!entry.found_existing) {
+            entry.value_ptr.* = std.ArrayList(u32).init(allocator);
+        }
+        const list = entry.value_ptr;
+        if (list.items.len == 0 or list.items[list.items.len - 1] != id) {
+            try list.append(id);
+        }
+    }
+
+    /// Writes `bytes` padded to 8 bytes, the alignment every table keeps
+    fn write_table(writer: anytype, bytes: []const u8) !void {
+        try writer.writeAll(bytes);
+        const padding = std.mem.alignForward(usize, bytes.len, 8) - bytes.len;
+        try writer.writeByteNTimes(0, padding);
+    }
+};
+
+/// Gadget spans as `GadgetIndex.add()` takes them
+const TestGadget = struct {
+    address: u64,
+    size: u64,
+    text: []const u8,
+};
+
+test "gadgets are found by their effects" {
+    var arena = std.heap.ArenaAllocator.init(testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const index_path = try std.fmt.allocPrint(allocator, "zig-cache/tmp/{s}/gadgets", .{tmp.sub_path});
+
+    // `pop {r0, pc}; add sp, sp, #4; bx lr; str r0, [sp]`
+    const data = try allocator.dupe(u8, &.{ 0x01, 0x80, 0xbd, 0xe8, 0x04, 0xd0, 0x8d, 0xe2, 0x1e, 0xff, 0x2f, 0xe1, 0x00, 0x00, 0x8d, 0xe5 });
+    var regions = [_]shard.ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "code"), .base_address = 0, .data = data }};
+    var target = shard.ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var shard_rt = ShardRuntime.init(allocator);
+    defer shard_rt.deinit();
+    try shard_rt.load_target(target);
+
+    const gadgets = [_]TestGadget{
+        .{ .address = 0x0, .size = 4, .text = "ldmia sp!,{r0,pc}" },
+        .{ .address = 0x4, .size = 8, .text = "add sp,sp,#0x4; bx lr" },
+        .{ .address = 0x8, .size = 4, .text = "bx lr" },
+        .{ .address = 0xc, .size = 4, .text = "str r0,[sp,#0x0]" },
+    };
+
+    {
+        var index = try GadgetIndex.open(index_path, allocator);
+        defer index.close();
+        try testing.expect(try index.add(&shard_rt, &gadgets));
+        // indexing the same image again is a no-op
+        try testing.expect(!try index.add(&shard_rt, &gadgets));
+    }
+
+    // everything is answered from the segment on disk
+    var index = try GadgetIndex.open(index_path, allocator);
+    defer index.close();
+    try testing.expectEqual(@as(usize, 1), index.segments.items.len);
+
+    const popped = try index.query(&try GadgetQuery.parse("pops:r0,end:ret", allocator), allocator);
+    try testing.expectEqual(@as(usize, 1), popped.items.len);
+    try testing.expectEqual(@as(u64, 0x0), popped.items[0].record.address);
+    try testing.expectEqual(@as(i64, 8), popped.items[0].record.sp_delta);
+    try testing.expectEqualStrings("ldmia sp!,{r0,pc}", popped.items[0].text);
+
+    const lifted = try index.query(&try GadgetQuery.parse("sp:4", allocator), allocator);
+    try testing.expectEqual(@as(usize, 1), lifted.items.len);
+    try testing.expectEqual(@as(u64, 0x4), lifted.items[0].record.address);
+
+    const returns = try index.query(&try GadgetQuery.parse("end:ret,nostore", allocator), allocator);
+    try testing.expectEqual(@as(usize, 3), returns.items.len);
+
+    const stores = try index.query(&try GadgetQuery.parse("end:none", allocator), allocator);
+    try testing.expectEqual(@as(usize, 1), stores.items.len);
+    try testing.expectEqual(@as(u16, 1), stores.items[0].record.stores);
+
+    const ending = try index.ending_at(0xc, allocator);
+    try testing.expectEqual(@as(usize, 2), ending.items.len);
+    try testing.expect(ending.items[0].record.address < ending.items[1].record.address);
+
+    const missing = try index.query(&try GadgetQuery.parse("pops:r7", allocator), allocator);
+    try testing.expectEqual(@as(usize, 0), missing.items.len);
+    try testing.expectError(error.InvalidQuery, GadgetQuery.parse("bogus", allocator));
+}
+
+test "another image adds a segment" {
+    var arena = std.heap.ArenaAllocator.init(testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const index_path = try std.fmt.allocPrint(allocator, "zig-cache/tmp/{s}/gadgets", .{tmp.sub_path});
+
+    var index = try GadgetIndex.open(index_path, allocator);
+    defer index.close();
+
+    // `bx lr` at two different addresses
+    for ([_]u64{ 0x0, 0x1000 }) |base| {
+        const data = try allocator.dupe(u8, &.{ 0x1e, 0xff, 0x2f, 0xe1 });
+        var regions = [_]shard.ShardMemoryRegion{.{ .name = try allocator.dupe(u8, "code"), .base_address = base, .data = data }};
+        var target = shard.ShardInputTarget.from_regions(&regions);
+        target.setSlaPath("./specfiles/ARM8_le.sla");
+
+        var shard_rt = ShardRuntime.init(allocator);
+        defer shard_rt.deinit();
+        try shard_rt.load_target(target);
+
+        const gadgets = [_]TestGadget{.{ .address = base, .size = 4, .text = "bx lr" }};
+        try testing.expect(try index.add(&shard_rt, &gadgets));
+    }
+
+    try testing.expectEqual(@as(usize, 2), index.segments.items.len);
+    const returns = try index.query(&.{ .terminator = .ret }, allocator);
+    try testing.expectEqual(@as(usize, 2), returns.items.len);
+    try testing.expect(returns.items[0].image_hash != returns.items[1].image_hash);
+}
+
+test "corrupt segments fail to open" {
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    // a record whose text would end past the end of the address space
+    const header = SegmentHeader{ .spec_hash = 0, .context_hash = 0, .image_hash = 0, .gadget_count = 1, .name_count = 0, .posting_count = 0, .id_count = 0, .names_size = 0, .text_size = 0 };
+    const record = GadgetRecord{ .address = 0, .size = 4, .sp_delta = 0, .text_offset = std.math.maxInt(u64), .text_len = 1, .loads = 0, .stores = 0, .terminator = .ret };
+    const file = try tmp.dir.createFile("segment", .{});
+    try file.writeAll(std.mem.asBytes(&header));
+    try file.writeAll(std.mem.asBytes(&record));
+    file.close();
+
+    var path_buf: [std.fs.MAX_PATH_BYTES]u8 = undefined;
+    const path = try std.fmt.bufPrintZ(&path_buf, "zig-cache/tmp/{s}/segment", .{tmp.sub_path});
+    try testing.expectError(error.InvalidSegment, Segment.open(path));
+}
@@ -0,0 +1,317 @@
+//! Binary dump of a program written by `ghidra_scripts/IterateAndDumpFunctionsList.java`.
+//!
+//! Replaces the JSON dumps that held every byte as two hex characters: the
+//! bytes of every memory block are stored as is, each starting on its own
+//! page, so a mapping of the dump can be handed to SLEIGH without parsing
+//! or copying anything. Everything is little endian:
+//!
+//! - `DumpHeader`
+//! - `DumpRegion[region_count]`, one per initialized memory block
+//! - `DumpFunction[function_count]`
+//! - `DumpContext[context_count]`
+//! - the names of the regions, functions + context variables,
+//!   `strings_size` bytes at `strings_offset`, not null terminated
+//! - the bytes of every region at its `data_offset`, a multiple of
+//!   `DUMP_PAGE_SIZE`
+const std = @import("std");
+const testing = std.testing;
+
+/// First bytes of every dump, the last byte is the format version
+pub const DUMP_MAGIC = "SFDUMP\x00\x01".*;
+
+/// Written as a little endian `u32`, a big endian host reads it the other
+/// way around and rejects the dump
+const DUMP_BYTE_ORDER: u32 = 0x01020304;
+
+/// Alignment of every region's bytes in the file
+pub const DUMP_PAGE_SIZE = 0x1000;
+
+pub const DUMP_PERM_READ: u32 = 1 << 0;
+pub const DUMP_PERM_WRITE: u32 = 1 << 1;
+pub const DUMP_PERM_EXECUTE: u32 = 1 << 2;
+
+pub const DumpError = error{
+    NotADump,
+    WrongByteOrder,
+    Truncated,
+};
+
+pub const DumpHeader = extern struct {
+    magic: [8]u8 = DUMP_MAGIC,
+    byte_order: u32 = DUMP_BYTE_ORDER,
+    region_count: u32,
+    function_count: u32,
+    /// dumps written before there were contexts have a 0 here
+    context_count: u32 = 0,
+    strings_offset: u64,
+    strings_size: u64,
+};
+
+/// A memory block of the program
+pub const DumpRegion = extern struct {
+    base_address: u64,
+    size: u64,
+    /// file offset of the `size` bytes of the block
+    data_offset: u64,
+    /// into the string table
+    name_offset: u32,
+    name_len: u32,
+    /// `DUMP_PERM_*` mask
+    permissions: u32,
+    _pad: u32 = 0,
+};
+
+/// A function Ghidra found, its `size` bytes start at `entry`
+pub const DumpFunction = extern struct {
+    entry: u64,
+    size: u64,
+    name_offset: u32,
+    name_len: u32,
+};
+
+/// A context variable Ghidra has set to `value` over `[start, end)`, eg.
+/// `TMode` over the Thumb functions of an ARM program
+pub const DumpContext = extern struct {
+    start: u64,
+    end: u64,
+    value: u32,
+    name_offset: u32,
+    name_len: u32,
+    _pad: u32 = 0,
+};
+
+fn in_bounds(offset: u64, size: u64, len: u64) bool {
+    return offset <= len and size <= len - offset;
+}
+
+/// A dump validated by `parse()`, every slice borrows the dump's bytes
+pub const GhidraDump = struct {
+    bytes: []u8,
+    regions: []align(1) const DumpRegion,
+    functions: []align(1) const DumpFunction,
+    contexts: []align(1) const DumpContext,
+    strings: []const u8,
+
+    const Self = @This();
+
+    /// Checks that every table, name and region of the dump in `bytes` is
+    /// in bounds
+    pub fn parse(bytes: []u8) DumpError!Self {
+        if (bytes.len < @sizeOf(DumpHeader) or !std.mem.eql(u8, bytes[0..DUMP_MAGIC.len], &DUMP_MAGIC)) {
+            return DumpError.NotADump;
+        }
+        const header = std.mem.bytesToValue(DumpHeader, bytes[0..@sizeOf(DumpHeader)]);
+        if (header.byte_order != DUMP_BYTE_ORDER) {
+            return DumpError.WrongByteOrder;
+        }
+
+        const regions_offset: u64 = @sizeOf(DumpHeader);
+        const regions_size = @as(u64, header.region_count) * @sizeOf(DumpRegion);
+        const functions_offset = regions_offset + regions_size;
+        const functions_size = @as(u64, header.function_count) * @sizeOf(DumpFunction);
+        const contexts_offset = functions_offset + functions_size;
+        const contexts_size = @as(u64, header.context_count) * @sizeOf(DumpContext);
+        if (!in_bounds(contexts_offset, contexts_size, bytes.len) or
+            !in_bounds(header.strings_offset, header.strings_size, bytes.len))
+        {
+            return DumpError.Truncated;
+        }
+
+        const out = Self{
+            .bytes = bytes,
+            .regions = std.mem.bytesAsSlice(DumpRegion, bytes[regions_offset..][0..regions_size]),
+            .functions = std.mem.bytesAsSlice(DumpFunction, bytes[functions_offset..][0..functions_size]),
+            .contexts = std.mem.bytesAsSlice(DumpContext, bytes[contexts_offset..][0..contexts_size]),
+            .strings = bytes[header.strings_offset..][0..header.strings_size],
+        };
+
+        for (out.regions) |region| {
+            if (!in_bounds(region.data_offset, region.size, bytes.len) or
+                !in_bounds(region.name_offset, region.name_len, out.strings.len))
+            {
+                return DumpError.Truncated;
+            }
+        }
+        for (out.functions) |function| {
+            if (!in_bounds(function.name_offset, function.name_len, out.strings.len)) {
+                return DumpError.Truncated;
+            }
+        }
+        for (out.contexts) |context| {
+            if (!in_bounds(context.name_offset, context.name_len, out.strings.len)) {
+                return DumpError.Truncated;
+            }
+        }
+        return out;
+    }
+
+    pub fn region_name(self: *const Self, region: DumpRegion) []const u8 {
+        return self.strings[region.name_offset..][0..region.name_len];
+    }
+
+    pub fn function_name(self: *const Self, function: DumpFunction) []const u8 {
+        return self.strings[function.name_offset..][0..function.name_len];
+    }
+
+    pub fn context_name(self: *const Self, context: DumpContext) []const u8 {
+        return self.strings[context.name_offset..][0..context.name_len];
+    }
+
+    /// The bytes of `region` inside of the dump
+    pub fn region_data(self: *const Self, region: DumpRegion) []u8 {
+        return self.bytes[region.data_offset..][0..region.size];
+    }
+
+    /// The bytes of `function` inside of the region holding it, `null` if
+    /// no region holds all of them
+    pub fn function_data(self: *const Self, function: DumpFunction) ?[]u8 {
+        for (self.regions) |region| {
+            if (function.entry >= region.base_address and
+                in_bounds(function.entry - region.base_address, function.size, region.size))
+            {
+                return self.region_data(region)[function.entry - region.base_address ..][0..function.size];
+            }
+        }
+        return null;
+    }
+};
+
+/// What `write()` puts into a dump for one region
+pub const RegionSource = struct {
+    name: []const u8,
+    base_address: u64,
+    permissions: u32,
+    data: []const u8,
+};
+
+/// What `write()` puts into a dump for one function
+pub const FunctionSource = struct {
+    name: []const u8,
+    entry: u64,
+    size: u64,
+};
+
+/// What `write()` puts into a dump for one context variable range
+pub const ContextSource = struct {
+    name: []const u8,
+    start: u64,
+    end: u64,
+    value: u32,
+};
+
+/// Writes a dump of `regions`, `functions` + `contexts` laid out the same as
+/// the Ghidra script does
+pub fn write(writer: anytype, regions: []const RegionSource, functions: []const FunctionSource, contexts: []const ContextSource) !void {
+    var strings_size: u64 = 0;
+    for (regions) |region| {
+        strings_size += region.name.len;
+    }
+    for (functions) |function| {
+        strings_size += function.name.len;
+    }
+    for (contexts) |context| {
+        strings_size += context.name.len;
+    }
+
+    const strings_offset = @sizeOf(DumpHeader) + regions.len * @sizeOf(DumpRegion) + functions.len * @sizeOf(DumpFunction) + contexts.len * @sizeOf(DumpContext);
+    const header = DumpHeader{
+        .region_count = @intCast(regions.len),
+        .function_count = @intCast(functions.len),
+        .context_count = @intCast(contexts.len),
+        .strings_offset = strings_offset,
+        .strings_size = strings_size,
+    };
+    try writer.writeStruct(header);
+
+    var name_offset: u32 = 0;
+    var data_offset = std.mem.alignForward(u64, strings_offset + strings_size, DUMP_PAGE_SIZE);
+    for (regions) |region| {
+        try writer.writeStruct(DumpRegion{
+            .base_address = region.base_address,
+            .size = region.data.len,
+            .data_offset = data_offset,
+            .name_offset = name_offset,
+            .name_len = @intCast(region.name.len),
+            .permissions = region.permissions,
+        });
+        name_offset += @intCast(region.name.len);
+        data_offset = std.mem.alignForward(u64, data_offset + region.data.len, DUMP_PAGE_SIZE);
+    }
+    for (functions) |function| {
+        try writer.writeStruct(DumpFunction{
+            .entry = function.entry,
+            .size = function.size,
+            .name_offset = name_offset,
+            .name_len = @intCast(function.name.len),
+        });
+        name_offset += @intCast(function.name.len);
+    }
+    for (contexts) |context| {
+        try writer.writeStruct(DumpContext{
+            .start = context.start,
+            .end = context.end,
+            .value = context.value,
+            .name_offset = name_offset,
+            .name_len = @intCast(context.name.len),
+        });
+        name_offset += @intCast(context.name.len);
+    }
+
+    for (regions) |region| {
+        try writer.writeAll(region.name);
+    }
+    for (functions) |function| {
+        try writer.writeAll(function.name);
+    }
+    for (contexts) |context| {
+        try writer.writeAll(context.name);
+    }
+
+    var written = strings_offset + strings_size;
+    for (regions) |region| {
+        const start = std.mem.alignForward(u64, written, DUMP_PAGE_SIZE);
+        try writer.writeByteNTimes(0, start - written);
+        try writer.writeAll(region.data);
+        written = start + region.data.len;
+    }
+}
+
+test "dump round trips through write + parse" {
+    const text = [_]u8{ 0x13, 0x00, 0x00, 0x00, 0x67, 0x80, 0x00, 0x00 };
+    const rodata = [_]u8{ 'h', 'i', 0 };
+    const regions = [_]RegionSource{
+        .{ .name = ".text", .base_address = 0x10000, .permissions = DUMP_PERM_READ | DUMP_PERM_EXECUTE, .data = &text },
+        .{ .name = ".rodata", .base_address = 0x20000, .permissions = DUMP_PERM_READ, .data = &rodata },
+    };
+    const functions = [_]FunctionSource{
+        .{ .name = "main", .entry = 0x10004, .size = 4 },
+        .{ .name = "outside", .entry = 0x30000, .size = 4 },
+    };
+    const contexts = [_]ContextSource{
+        .{ .name = "TMode", .start = 0x10004, .end = 0x10008, .value = 1 },
+    };
+
+    var out = std.ArrayList(u8).init(testing.allocator);
+    defer out.deinit();
+    try write(out.writer(), &regions, &functions, &contexts);
+
+    const dump = try GhidraDump.parse(out.items);
+    try testing.expectEqual(@as(usize, 2), dump.regions.len);
+    try testing.expectEqualStrings(".rodata", dump.region_name(dump.regions[1]));
+    try testing.expectEqual(@as(u64, 0), dump.regions[0].data_offset % DUMP_PAGE_SIZE);
+    try testing.expectEqual(@as(u64, 0), dump.regions[1].data_offset % DUMP_PAGE_SIZE);
+    try testing.expectEqualSlices(u8, &rodata, dump.region_data(dump.regions[1]));
+    try testing.expectEqual(DUMP_PERM_READ | DUMP_PERM_EXECUTE, dump.regions[0].permissions);
+
+    try testing.expectEqualStrings("main", dump.function_name(dump.functions[0]));
+    try testing.expectEqualSlices(u8, text[4..], dump.function_data(dump.functions[0]).?);
+    try testing.expect(dump.function_data(dump.functions[1]) == null);
+
+    try testing.expectEqual(@as(usize, 1), dump.contexts.len);
+    try testing.expectEqualStrings("TMode", dump.context_name(dump.contexts[0]));
+    try testing.expectEqual(@as(u64, 0x10008), dump.contexts[0].end);
+
+    // cutting off any region's bytes is caught
+    try testing.expectError(DumpError.Truncated, GhidraDump.parse(out.items[0 .. out.items.len - 1]));
+    try testing.expectError(DumpError.NotADump, GhidraDump.parse(out.items[1..]));
+}
@@ -0,0 +1,376 @@
+//! Content addressed on-disk cache of lifted address ranges.
+//!
+//! Every entry is the arena of a `sleigh.LiftedRange` written out verbatim
+//! behind a small header, keyed by a hash of the `.sla` file, the context
+//! pairs applied to SLEIGH and the bytes + addresses of every region of the
+//! target. Since the arena references everything by index, a hit is a
+//! single mmap of the entry and SLEIGH is never involved.
+//!
+//! Lifts of content defined chunks (see `content_chunks.zig`) are keyed by
+//! the hash of their bytes instead of the whole target, so another image
+//! holding the same chunk at another address hits them as well and only has
+//! to relocate the range (`SleighState.relocate_range()`).
+//!
+//! Entries are written to a temporary file and renamed into place, so
+//! concurrent lifts (or processes) sharing a directory never see a partial
+//! entry. Nothing is ever evicted, delete the directory to clear it.
+const std = @import("std");
+const testing = std.testing;
+const sleigh = @import("../sleigh.zig");
+const targets = @import("targets.zig");
+const memory = @import("memory.zig");
+
+const ShardInputTarget = targets.ShardInputTarget;
+const ShardMemoryRegion = memory.ShardMemoryRegion;
+const Wyhash = std.hash.Wyhash;
+
+const logger = std.log.scoped(.shard_lift_cache);
+
+/// First bytes of every entry, the last byte is the format version and
+/// must be bumped whenever the `LiftedRange` arena layout changes
+const ENTRY_MAGIC = "SFLIFT\x00\x04".*;
+
+/// Written as a native `u32` to reject entries from a host with the other
+/// byte order
+const ENTRY_BYTE_ORDER: u32 = 0x01020304;
+
+/// Start of every entry, the arena of `range` follows directly after it.
+/// Holds the whole key so a hash collision of the file name is a miss.
+const EntryHeader = extern struct {
+    magic: [8]u8 = ENTRY_MAGIC,
+    byte_order: u32 = ENTRY_BYTE_ORDER,
+    _pad: u32 = 0,
+    spec_hash: u64,
+    context_hash: u64,
+    /// the content hash of a chunk entry
+    image_hash: u64,
+    start: u64,
+    end: u64,
+    /// `arena` is always written as `null`
+    range: sleigh.LiftedRange,
+};
+
+/// A cache hit, `range` borrows the mapped entry until `release()`
+pub const LiftCacheEntry = struct {
+    range: sleigh.LiftedRange,
+    /// address `range` was lifted at, only differs from the one asked for
+    /// on a `LiftCache.load_content()` hit
+    start: u64,
+    mapping: sleigh.MappedRegion,
+
+    pub fn release(self: *LiftCacheEntry) void {
+        self.mapping.unmap();
+        self.* = undefined;
+    }
+};
+
+/// Everything a lift of a target depends on besides the address range: the
+/// `.sla` file, the context pairs + regions applied to SLEIGH and the bytes +
+/// addresses of every region
+pub const TargetKey = struct {
+    spec_hash: u64,
+    context_hash: u64,
+    image_hash: u64,
+
+    pub fn of(target: *const ShardInputTarget, allocator: std.mem.Allocator) !TargetKey {
+        const rebased = try target.getRebasedMemoryRegions(allocator);
+        defer allocator.free(rebased);
+
+        return TargetKey{
+            .spec_hash = try hash_file(target.getSlaPath()),
+            .context_hash = hash_context(target.getContextPairs(), target.getContextRegions()),
+            .image_hash = hash_regions(rebased),
+        };
+    }
+
+    /// All three hashes folded into one
+    pub fn hash(self: TargetKey) u64 {
+        var hasher = Wyhash.init(0);
+        hasher.update(std.mem.asBytes(&[_]u64{ self.spec_hash, self.context_hash, self.image_hash }));
+        return hasher.final();
+    }
+
+    fn hash_file(path: []const u8) !u64 {
+        var file = try std.fs.cwd().openFile(path, .{});
+        defer file.close();
+
+        var hasher = Wyhash.init(0);
+        var buf: [64 * 1024]u8 = undefined;
+        while (true) {
+            const len = try file.read(&buf);
+            if (len == 0) {
+                break;
+            }
+            hasher.update(buf[0..len]);
+        }
+        return hasher.final();
+    }
+
+    fn hash_context(pairs: []const targets.SleighContextPair, context_regions: []const targets.SleighContextRegion) u64 {
+        var hasher = Wyhash.init(0);
+        for (pairs) |pair| {
+            hasher.update(std.mem.asBytes(&pair.variable.len));
+            hasher.update(pair.variable);
+            hasher.update(std.mem.asBytes(&pair.value));
+        }
+        // targets without any hash the same as before there were regions
+        for (context_regions) |context_region| {
+            hasher.update(std.mem.asBytes(&context_region.variable.len));
+            hasher.update(context_region.variable);
+            hasher.update(std.mem.asBytes(&[_]u64{ context_region.start, context_region.end, context_region.value }));
+        }
+        return hasher.final();
+    }
+
+    fn hash_regions(regions: []const ShardMemoryRegion) u64 {
+        var hasher = Wyhash.init(0);
+        for (regions) |region| {
+            hasher.update(std.mem.asBytes(&region.base_address));
+            const len = region.len();
+            hasher.update(std.mem.asBytes(&len));
+            // the compressed bytes stand in for the decompressed ones, so
+            // hashing doesn't decompress the whole image
+            if (region.compressed) |*image| {
+                hasher.update(image.compressed());
+            } else {
+                hasher.update(region.data);
+            }
+        }
+        return hasher.final();
+    }
+};
+
+/// Cache of the lifts of a single target, see the module docs
+pub const LiftCache = struct {
+    dir: std.fs.Dir,
+    /// path of `dir`, entries are mapped by path
+    path: []const u8,
+    spec_hash: u64,
+    context_hash: u64,
+    image_hash: u64,
+    allocator: std.mem.Allocator,
+
+    const Self = @This();
+
+    /// Opens (creating if needed) the cache directory at `path` for lifts
+    /// of `target`
+    pub fn open(path: []const u8, target: *const ShardInputTarget, allocator: std.mem.Allocator) !Self {
+        try std.fs.cwd().makePath(path);
+        var dir = try std.fs.cwd().openDir(path, .{});
+        errdefer dir.close();
+
+        const owned_path = try allocator.dupe(u8, path);
+        errdefer allocator.free(owned_path);
+
+        const target_key = try TargetKey.of(target, allocator);
+        return Self{
+            .dir = dir,
+            .path = owned_path,
+            .spec_hash = target_key.spec_hash,
+            .context_hash = target_key.context_hash,
+            .image_hash = target_key.image_hash,
+            .allocator = allocator,
+        };
+    }
+
+    pub fn close(self: *Self) void {
+        self.dir.close();
+        self.allocator.free(self.path);
+        self.* = undefined;
+    }
+
+    /// Looks up the lift of `[start, end)`, `null` on a miss
+    pub fn load(self: *const Self, start: u64, end: u64) ?LiftCacheEntry {
+        return self.load_entry(self.key(start, end), self.image_hash, start, end - start);
+    }
+
+    /// Looks up the lift of `len` bytes hashing to `content_hash` out of any
+    /// image, wherever it was lifted at. `null` on a miss
+    pub fn load_content(self: *const Self, content_hash: u64, len: u64) ?LiftCacheEntry {
+        return self.load_entry(self.content_key(content_hash, len), content_hash, null, len);
+    }
+
+    /// Writes the lift of `[start, end)` into the cache
+    pub fn store(self: *const Self, start: u64, end: u64, range: *const sleigh.LiftedRange) !void {
+        try self.store_entry(self.key(start, end), self.image_hash, start, end, range);
+    }
+
+    /// Writes the lift of `[start, end)`, whose bytes hash to
+    /// `content_hash`, into the cache for `load_content()`
+    pub fn store_content(self: *const Self, content_hash: u64, start: u64, end: u64, range: *const sleigh.LiftedRange) !void {
+        try self.store_entry(self.content_key(content_hash, end - start), content_hash, start, end, range);
+    }
+
+    /// Maps the entry named `entry_key`, a `start` of `null` takes an entry
+    /// lifted at any address
+    fn load_entry(self: *const Self, entry_key: u64, image_hash: u64, start: ?u64, len: u64) ?LiftCacheEntry {
+        var path_buf: [std.fs.MAX_PATH_BYTES]u8 = undefined;
+        const path = std.fmt.bufPrintZ(&path_buf, "{s}/{x:0>16}.lift", .{ self.path, entry_key }) catch return null;
+
+        var mapping = sleigh.MappedRegion.map(path, 0, 0) catch return null;
+
+        const bytes = mapping.slice();
+        if (bytes.len < @sizeOf(EntryHeader)) {
+            mapping.unmap();
+            return null;
+        }
+
+        const header = std.mem.bytesToValue(EntryHeader, bytes[0..@sizeOf(EntryHeader)]);
+        const arena = bytes[@sizeOf(EntryHeader)..];
+        if (!std.mem.eql(u8, &header.magic, &ENTRY_MAGIC) or
+            header.byte_order != ENTRY_BYTE_ORDER or
+            header.spec_hash != self.spec_hash or
+            header.context_hash != self.context_hash or
+            header.image_hash != image_hash or
+            (start != null and header.start != start.?) or
+            header.end -% header.start != len or
+            header.range.arena_size != arena.len)
+        {
+            logger.warn("Ignoring stale lift cache entry `{s}`", .{path});
+            mapping.unmap();
+            return null;
+        }
+
+        // the mapping is page aligned and the header is a multiple of 8, so
+        // the arena keeps the alignment of the tables inside of it
+        var range = header.range;
+        range.arena = arena.ptr;
+        return LiftCacheEntry{ .range = range, .start = header.start, .mapping = mapping };
+    }
+
+    fn store_entry(self: *const Self, entry_key: u64, image_hash: u64, start: u64, end: u64, range: *const sleigh.LiftedRange) !void {
+        var name_buf: [64]u8 = undefined;
+        const name = try std.fmt.bufPrint(&name_buf, "{x:0>16}.lift", .{entry_key});
+        var tmp_buf: [64]u8 = undefined;
+        const tmp_name = try std.fmt.bufPrint(&tmp_buf, "{s}.{x:0>16}.tmp", .{ name, std.crypto.random.int(u64) });
+
+        var header = EntryHeader{
+            .spec_hash = self.spec_hash,
+            .context_hash = self.context_hash,
+            .image_hash = image_hash,
+            .start = start,
+            .end = end,
+            .range = range.*,
+        };
+        header.range.arena = null;
+
+        {
+            var file = try self.dir.createFile(tmp_name, .{});
+            defer file.close();
+            errdefer self.dir.deleteFile(tmp_name) catch {};
+
+            try file.writeAll(std.mem.asBytes(&header));
+            if (range.arena) |arena| {
+                try file.writeAll(arena[0..range.arena_size]);
+            }
+        }
+
+        self.dir.rename(tmp_name, name) catch |err| {
+            self.dir.deleteFile(tmp_name) catch {};
+            return err;
+        };
+    }
+
+    /// File name hash of the entry for `[start, end)`
+    fn key(self: *const Self, start: u64, end: u64) u64 {
+        var hasher = Wyhash.init(0);
+        hasher.update(std.mem.asBytes(&[_]u64{ self.spec_hash, self.context_hash, self.image_hash, start, end }));
+        return hasher.final();
+    }
+
+    /// File name hash of the entry for `len` bytes hashing to `content_hash`,
+    /// salted so it can't name a `key()` entry
+    fn content_key(self: *const Self, content_hash: u64, len: u64) u64 {
+        var hasher = Wyhash.init(1);
+        hasher.update(std.mem.asBytes(&[_]u64{ self.spec_hash, self.context_hash, content_hash, len }));
+        return hasher.final();
+    }
+};
+
+test "store and load a lifted range" {
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const cache_path = try std.fmt.allocPrint(testing.allocator, "zig-cache/tmp/{s}/lifts", .{tmp.sub_path});
+    defer testing.allocator.free(cache_path);
+
+    // `push {lr}; ldr r0, [r1]`
+    var data = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x00, 0x00, 0x91, 0xe5 };
+    var name = [_]u8{ 'c', 'o', 'd', 'e' };
+    const regions = [_]ShardMemoryRegion{.{ .name = &name, .base_address = 0, .data = &data }};
+    var target = ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var sleigh_rt = sleigh.SleighState.init();
+    defer sleigh_rt.deinit();
+    try sleigh_rt.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh_rt.begin();
+    try sleigh_rt.load_data(0x0, &data);
+
+    var lifted = sleigh.LiftedRange{};
+    try sleigh_rt.lift_range(0x0, data.len, &lifted);
+    defer sleigh_rt.release_range(&lifted);
+
+    var cache = try LiftCache.open(cache_path, &target, testing.allocator);
+    defer cache.close();
+
+    try testing.expect(cache.load(0x0, data.len) == null);
+    try cache.store(0x0, data.len, &lifted);
+
+    var entry = cache.load(0x0, data.len) orelse return error.TestUnexpectedResult;
+    defer entry.release();
+    try testing.expectEqual(lifted.insn_count, entry.range.insn_count);
+    try testing.expectEqual(lifted.end_address, entry.range.end_address);
+    try testing.expectEqualSlices(u8, lifted.arena.?[0..lifted.arena_size], entry.range.arena.?[0..entry.range.arena_size]);
+
+    // any other range or image is a miss
+    try testing.expect(cache.load(0x0, 4) == null);
+    data[0] = 0;
+    var other = try LiftCache.open(cache_path, &target, testing.allocator);
+    defer other.close();
+    try testing.expect(other.load(0x0, data.len) == null);
+}
+
+test "chunks hit by content at any address" {
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const cache_path = try std.fmt.allocPrint(testing.allocator, "zig-cache/tmp/{s}/lifts", .{tmp.sub_path});
+    defer testing.allocator.free(cache_path);
+
+    // `push {lr}; ldr r0, [r1]`
+    var data = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x00, 0x00, 0x91, 0xe5 };
+    var name = [_]u8{ 'c', 'o', 'd', 'e' };
+    const regions = [_]ShardMemoryRegion{.{ .name = &name, .base_address = 0x1000, .data = &data }};
+    var target = ShardInputTarget.from_regions(&regions);
+    target.setSlaPath("./specfiles/ARM8_le.sla");
+
+    var sleigh_rt = sleigh.SleighState.init();
+    defer sleigh_rt.deinit();
+    try sleigh_rt.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh_rt.begin();
+    try sleigh_rt.load_data(0x1000, &data);
+
+    var lifted = sleigh.LiftedRange{};
+    try sleigh_rt.lift_range(0x1000, 0x1000 + data.len, &lifted);
+    defer sleigh_rt.release_range(&lifted);
+
+    var cache = try LiftCache.open(cache_path, &target, testing.allocator);
+    defer cache.close();
+
+    const content_hash = Wyhash.hash(0, &data);
+    try testing.expect(cache.load_content(content_hash, data.len) == null);
+    try cache.store_content(content_hash, 0x1000, 0x1000 + data.len, &lifted);
+
+    // another image holding the same bytes somewhere else
+    data[0] = 0;
+    var other = try LiftCache.open(cache_path, &target, testing.allocator);
+    defer other.close();
+
+    var entry = other.load_content(content_hash, data.len) orelse return error.TestUnexpectedResult;
+    defer entry.release();
+    try testing.expectEqual(@as(u64, 0x1000), entry.start);
+    try testing.expectEqual(lifted.insn_count, entry.range.insn_count);
+
+    // neither an address keyed lookup nor another length hit it
+    try testing.expect(other.load(0x1000, 0x1000 + data.len) == null);
+    try testing.expect(other.load_content(content_hash, 4) == null);
+}
@@ -0,0 +1,676 @@
+//! # `lift_daemon`
+//!
+//! Keeps decoded specs and loaded images resident between runs of
+//! `struct.foo`. A short run against a spec + image spends most of its time
+//! decoding the `.sla` and loading the image, which is the same work on
+//! every run.
+//!
+//! `LiftDaemon.serve()` answers jobs from `DaemonClient`s on a Unix socket:
+//! lift a range of a target, or find the gadgets of a target. Each job
+//! describes its target with a `StructFooConfig`. A target seen before is
+//! still loaded, so only the first job against it decodes anything. Every
+//! job lifts with its own fork of the resident SLEIGH (see
+//! `ShardRuntime.load_forked()`), so nothing a job allocates outlives it.
+//!
+//! Results don't go over the socket. The daemon writes each one into a
+//! file in `shm_dir` (`/dev/shm`, so memory backed), and the client maps
+//! and unlinks it. Lifts keep the layout of the `LiftedRange` arena, so the
+//! client reads the ops + varnodes straight out of the mapping, the same
+//! way entries of the lift cache are read.
+//!
+//! Jobs are served one at a time, in the order they arrive.
+const std = @import("std");
+const testing = std.testing;
+
+const shard = @import("../shard.zig");
+const sleigh = @import("../sleigh.zig");
+const config = @import("../config.zig");
+const loader = @import("loader.zig");
+const targets = @import("targets.zig");
+
+const ShardRuntime = shard.ShardRuntime;
+const ShardLoader = loader.ShardLoader;
+const ShardInputTarget = targets.ShardInputTarget;
+const StructFooConfig = config.StructFooConfig;
+
+const logger = std.log.scoped(.shard_lift_daemon);
+
+/// First bytes of every job, the last byte is the protocol version
+const JOB_MAGIC = "SFJOB\x00\x00\x02".*;
+
+/// First bytes of every reply
+const REPLY_MAGIC = "SFREPLY\x01".*;
+
+/// Directory the results are written into unless told otherwise
+pub const DEFAULT_SHM_DIR = "/dev/shm";
+
+/// Targets kept loaded at once, the least recently used one is dropped
+/// to make room for another
+pub const DEFAULT_MAX_TARGETS = 8;
+
+/// Largest config a job can carry
+const MAX_CONFIG_SIZE = 64 * 1024;
+
+pub const DaemonError = error{
+    BadJob,
+    JobFailed,
+    BadReply,
+};
+
+pub const JobKind = enum(u32) {
+    /// lift `[start, end)` of the target
+    lift = 0,
+    /// find the gadgets of the target
+    gadgets = 1,
+    /// stop serving once replied to
+    shutdown = 2,
+    _,
+};
+
+pub const JobFlags = packed struct(u32) {
+    /// only keep the first of the gadgets that do the same thing
+    dedup: bool = false,
+    _reserved: u31 = 0,
+};
+
+/// Start of every job, the json `StructFooConfig` of the target follows
+const JobHeader = extern struct {
+    magic: [8]u8 = JOB_MAGIC,
+    kind: JobKind,
+    flags: JobFlags = .{},
+    /// `[start, end)` of a `lift` job
+    start: u64 = 0,
+    end: u64 = 0,
+    config_size: u64 = 0,
+};
+
+pub const ReplyStatus = enum(u32) {
+    ok = 0,
+    bad_job = 1,
+    failed = 2,
+    _,
+};
+
+/// Start of every reply, the path of the result file follows
+const ReplyHeader = extern struct {
+    magic: [8]u8 = REPLY_MAGIC,
+    status: ReplyStatus = .ok,
+    path_size: u32 = 0,
+};
+
+/// Start of the result of a `lift` job, the arena of `range` follows
+/// directly after it. `range.arena` is always written as `null`
+const LiftHeader = extern struct {
+    range: sleigh.LiftedRange,
+};
+
+/// Start of the result of a `gadgets` job, followed by `count` rows and
+/// then `text_size` bytes of text
+const GadgetHeader = extern struct {
+    count: u64,
+    text_size: u64,
+};
+
+/// One gadget of a `gadgets` result, the text is at `text_offset` of the
+/// text that follows the rows
+pub const GadgetRow = extern struct {
+    address: u64,
+    size: u64,
+    text_offset: u64,
+    text_size: u64,
+};
+
+/// A gadget found by the `handler` of `LiftDaemon.serve()`
+pub const Gadget = struct {
+    address: u64,
+    size: u64,
+    text: []const u8,
+};
+
+/// A target loaded by an earlier job
+const Resident = struct {
+    /// what the target was loaded from, see `LiftDaemon.target_key()`
+    key: []const u8,
+    arena: std.heap.ArenaAllocator,
+    loader: ShardLoader,
+    target: ShardInputTarget,
+    /// the parent every job against this target forks from
+    runtime: ShardRuntime,
+    /// the input when it was loaded, a changed input is loaded again
+    input_mtime: i128,
+    input_size: u64,
+    /// the job that last used it
+    last_used: u64,
+
+    fn deinit(self: *Resident) void {
+        self.runtime.deinit();
+        self.loader.deinit();
+        self.arena.deinit();
+        self.* = undefined;
+    }
+};
+
+/// The server side, see the module docs
+pub const LiftDaemon = struct {
+    allocator: std.mem.Allocator,
+    /// where result files are written
+    shm_dir: []const u8,
+    max_targets: usize = DEFAULT_MAX_TARGETS,
+    /// every spec decoded so far, by `.sla` path
+    specs: std.StringHashMap(sleigh.SleighSpec),
+    residents: std.ArrayList(*Resident),
+    /// counts every job served, names the result files
+    jobs: u64 = 0,
+    /// set apart the result files of daemons sharing `shm_dir`
+    tag: u64,
+
+    const Self = @This();
+
+    pub fn init(allocator: std.mem.Allocator, shm_dir: []const u8) Self {
+        return Self{
+            .allocator = allocator,
+            .shm_dir = shm_dir,
+            .specs = std.StringHashMap(sleigh.SleighSpec).init(allocator),
+            .residents = std.ArrayList(*Resident).init(allocator),
+            .tag = std.crypto.random.int(u64),
+        };
+    }
+
+    pub fn deinit(self: *Self) void {
+        for (self.residents.items) |resident| {
+            resident.deinit();
+            self.allocator.destroy(resident);
+        }
+        self.residents.deinit();
+
+        var it = self.specs.iterator();
+        while (it.next()) |entry| {
+            entry.value_ptr.deinit();
+            self.allocator.free(entry.key_ptr.*);
+        }
+        self.specs.deinit();
+        self.* = undefined;
+    }
+
+    /// Listens on the Unix socket at `socket_path`, replacing whatever file
+    /// is there. Hand the server to `LiftDaemon.serve()`
+    pub fn listen(socket_path: []const u8) !std.net.Server {
+        std.fs.cwd().deleteFile(socket_path) catch {};
+        const address = try std.net.Address.initUnix(socket_path);
+        return address.listen(.{});
+    }
+
+    /// Serves jobs on `server` until a `shutdown` job. The gadgets of a
+    /// `gadgets` job come from `handler.gadgets(shard_rt, cfg, flags,
+    /// allocator)`, which returns a `[]const Gadget` allocated from (or
+    /// borrowing from) `allocator` and `shard_rt`
+    pub fn serve(self: *Self, server: *std.net.Server, handler: anytype) !void {
+        while (true) {
+            const connection = try server.accept();
+            defer connection.stream.close();
+
+            const keep_serving = self.serve_connection(connection.stream, handler) catch |err| {
+                logger.warn("Dropped a client: {}", .{err});
+                continue;
+            };
+            if (!keep_serving) {
+                return;
+            }
+        }
+    }
+
+    /// Answers the jobs of one client until it hangs up, `false` once it
+    /// asked for a shutdown
+    fn serve_connection(self: *Self, stream: std.net.Stream, handler: anytype) !bool {
+        while (true) {
+            var job: JobHeader = undefined;
+            stream.reader().readNoEof(std.mem.asBytes(&job)) catch |err| switch (err) {
+                error.EndOfStream => return true,
+                else => return err,
+            };
+
+            if (!std.mem.eql(u8, &job.magic, &JOB_MAGIC) or job.config_size > MAX_CONFIG_SIZE) {
+                try send_reply(stream, .bad_job, "");
+                return true;
+            }
+            if (job.kind == .shutdown) {
+                try send_reply(stream, .ok, "");
+                return false;
+            }
+
+            var arena = std.heap.ArenaAllocator.init(self.allocator);
+            defer arena.deinit();
+            const allocator = arena.allocator();
+
+            const config_text = try allocator.alloc(u8, job.config_size);
+            try stream.reader().readNoEof(config_text);
+
+            self.jobs += 1;
+            var timer = try std.time.Timer.start();
+            const path = self.run_job(&job, config_text, handler, allocator) catch |err| {
+                logger.warn("Job {} ({}) failed: {}", .{ self.jobs, job.kind, err });
+                try send_reply(stream, .failed, "");
+                continue;
+            };
+            logger.debug("Job {} ({}) took {} us", .{ self.jobs, job.kind, timer.read() / std.time.ns_per_us });
+
+            send_reply(stream, .ok, path) catch |err| {
+                std.fs.cwd().deleteFile(path) catch {};
+                return err;
+            };
+        }
+    }
+
+    fn send_reply(stream: std.net.Stream, status: ReplyStatus, path: []const u8) !void {
+        const reply = ReplyHeader{ .status = status, .path_size = @intCast(path.len) };
+        try stream.writeAll(std.mem.asBytes(&reply));
+        try stream.writeAll(path);
+    }
+
+    /// Runs `job` against a fork of its resident target, returns the path
+    /// of the result file
+    fn run_job(self: *Self, job: *const JobHeader, config_text: []const u8, handler: anytype, allocator: std.mem.Allocator) ![]const u8 {
+        var cfg = StructFooConfig.new();
+        try cfg.load_json_slice(config_text, allocator);
+        if (!cfg.ready()) {
+            return DaemonError.BadJob;
+        }
+
+        const resident = try self.resident_for(&cfg, allocator);
+
+        var shard_rt = ShardRuntime.init(allocator);
+        defer shard_rt.deinit();
+        try shard_rt.load_forked(&resident.runtime.sleigh_handle, resident.target);
+        shard_rt.set_pcode_only(cfg.pcode_only);
+        shard_rt.set_simplify(cfg.simplify);
+        shard_rt.set_content_chunks(cfg.content_chunks);
+        shard_rt.set_numa(cfg.numa);
+        shard_rt.set_huge_pages(cfg.huge_pages);
+        if (cfg.cache_dir.len > 0) {
+            try shard_rt.use_lift_cache(cfg.cache_dir);
+        }
+
+        switch (job.kind) {
+            .lift => return self.write_lift(&shard_rt, job.start, job.end, allocator),
+            .gadgets => {
+                const gadgets: []const Gadget = try handler.gadgets(&shard_rt, &cfg, job.flags, allocator);
+                return self.write_gadgets(gadgets, allocator);
+            },
+            else => return DaemonError.BadJob,
+        }
+    }
+
+    fn write_lift(self: *Self, shard_rt: *ShardRuntime, start: u64, end: u64, allocator: std.mem.Allocator) ![]const u8 {
+        var lifted = sleigh.LiftedRange{};
+        try shard_rt.sleigh_handle.lift_range(start, end, &lifted);
+        defer shard_rt.sleigh_handle.release_range(&lifted);
+
+        var header = LiftHeader{ .range = lifted };
+        header.range.arena = null;
+        const arena: []const u8 = if (lifted.arena) |bytes| bytes[0..lifted.arena_size] else &.{};
+
+        return self.write_result(&.{ std.mem.asBytes(&header), arena }, allocator);
+    }
+
+    fn write_gadgets(self: *Self, gadgets: []const Gadget, allocator: std.mem.Allocator) ![]const u8 {
+        const rows = try allocator.alloc(GadgetRow, gadgets.len);
+        var text_size: u64 = 0;
+        for (gadgets, rows) |gadget, *row| {
+            row.* = GadgetRow{ .address = gadget.address, .size = gadget.size, .text_offset = text_size, .text_size = gadget.text.len };
+            text_size += gadget.text.len;
+        }
+
+        const header = GadgetHeader{ .count = gadgets.len, .text_size = text_size };
+        const parts = try allocator.alloc([]const u8, gadgets.len + 2);
+        parts[0] = std.mem.asBytes(&header);
+        parts[1] = std.mem.sliceAsBytes(rows);
+        for (gadgets, parts[2..]) |gadget, *part| {
+            part.* = gadget.text;
+        }
+
+        return self.write_result(parts, allocator);
+    }
+
+    /// Writes `parts` one after the other into a new result file
+    fn write_result(self: *Self, parts: []const []const u8, allocator: std.mem.Allocator) ![]const u8 {
+        const path = try std.fmt.allocPrint(allocator, "{s}/struct-foo-{x:0>16}-{}.result", .{ self.shm_dir, self.tag, self.jobs });
+
+        var file = try std.fs.cwd().createFile(path, .{ .exclusive = true, .mode = 0o600 });
+        defer file.close();
+        errdefer std.fs.cwd().deleteFile(path) catch {};
+
+        var buffered = std.io.bufferedWriter(file.writer());
+        for (parts) |part| {
+            try buffered.writer().writeAll(part);
+        }
+        try buffered.flush();
+
+        return path;
+    }
+
+    /// Everything in `cfg` that decides what gets loaded
+    fn target_key(cfg: *const StructFooConfig, allocator: std.mem.Allocator) ![]const u8 {
+        var key = std.ArrayList(u8).init(allocator);
+        errdefer key.deinit();
+        try key.writer().print("{s}\x00{s}\x00{s}\x00{s}\x00{s}\x00{x}", .{ cfg.root_dir, cfg.sla, cfg.pspec, cfg.input_path, @tagName(cfg.input_mode), cfg.base_address });
+        for (cfg.context_regions) |region| {
+            try key.writer().print("\x00{s}={x}@{x}-{x}", .{ region.variable, region.value, region.start, region.end });
+        }
+        return key.toOwnedSlice();
+    }
+
+    /// The resident target of `cfg`, loading it if it isn't loaded yet or
+    /// its input changed since
+    fn resident_for(self: *Self, cfg: *const StructFooConfig, allocator: std.mem.Allocator) !*Resident {
+        const key = try target_key(cfg, allocator);
+        const stat = try std.fs.cwd().statFile(cfg.input_path);
+
+        for (self.residents.items, 0..) |resident, idx| {
+            if (!std.mem.eql(u8, resident.key, key)) {
+                continue;
+            }
+
+            if (resident.input_mtime == stat.mtime and resident.input_size == stat.size) {
+                resident.last_used = self.jobs;
+                return resident;
+            }
+
+            logger.info("`{s}` changed, loading it again", .{cfg.input_path});
+            self.drop_resident(idx);
+            break;
+        }
+
+        if (self.residents.items.len >= self.max_targets) {
+            var oldest: usize = 0;
+            for (self.residents.items, 0..) |resident, idx| {
+                if (resident.last_used < self.residents.items[oldest].last_used) {
+                    oldest = idx;
+                }
+            }
+            self.drop_resident(oldest);
+        }
+
+        const resident = try self.allocator.create(Resident);
+        errdefer self.allocator.destroy(resident);
+        try self.load_resident(resident, cfg, key);
+        errdefer resident.deinit();
+        resident.input_mtime = stat.mtime;
+        resident.input_size = stat.size;
+        resident.last_used = self.jobs;
+
+        try self.residents.append(resident);
+        return resident;
+    }
+
+    fn load_resident(self: *Self, resident: *Resident, cfg: *const StructFooConfig, key: []const u8) !void {
+        resident.arena = std.heap.ArenaAllocator.init(self.allocator);
+        errdefer resident.arena.deinit();
+        const allocator = resident.arena.allocator();
+
+        resident.key = try allocator.dupe(u8, key);
+        resident.loader = ShardLoader.init(allocator);
+        errdefer resident.loader.deinit();
+        resident.target = try resident.loader.loadFileFromConfig(cfg);
+
+        const spec = try self.spec_for(resident.target.getSlaPath());
+        resident.runtime = ShardRuntime.init(allocator);
+        errdefer resident.runtime.deinit();
+        resident.runtime.use_spec(spec);
+        try resident.runtime.load_target(resident.target);
+        logger.info("Loaded `{s}` with `{s}`", .{ cfg.input_path, resident.target.getSlaPath() });
+    }
+
+    fn drop_resident(self: *Self, idx: usize) void {
+        const resident = self.residents.orderedRemove(idx);
+        resident.deinit();
+        self.allocator.destroy(resident);
+    }
+
+    /// The decoded spec at `path`, decoded on first use
+    fn spec_for(self: *Self, path: []const u8) !sleigh.SleighSpec {
+        if (self.specs.get(path)) |spec| {
+            return spec;
+        }
+
+        const owned_path = try self.allocator.dupeZ(u8, path);
+        errdefer self.allocator.free(owned_path);
+        var spec = try sleigh.SleighSpec.load(owned_path);
+        errdefer spec.deinit();
+
+        try self.specs.put(owned_path, spec);
+        return spec;
+    }
+};
+
+/// Result of a `lift` job, `range` borrows the mapping until `release()`
+pub const LiftReply = struct {
+    range: sleigh.LiftedRange,
+    mapping: sleigh.MappedRegion,
+
+    pub fn release(self: *LiftReply) void {
+        self.mapping.unmap();
+        self.* = undefined;
+    }
+};
+
+/// Result of a `gadgets` job, borrows the mapping until `release()`
+pub const GadgetReply = struct {
+    rows: []const GadgetRow,
+    text: []const u8,
+    mapping: sleigh.MappedRegion,
+
+    pub fn text_of(self: *const GadgetReply, row: *const GadgetRow) []const u8 {
+        return self.text[row.text_offset..][0..row.text_size];
+    }
+
+    pub fn release(self: *GadgetReply) void {
+        self.mapping.unmap();
+        self.* = undefined;
+    }
+};
+
+/// The client side, see the module docs. Any number of jobs can be sent
+/// over one connection
+pub const DaemonClient = struct {
+    stream: std.net.Stream,
+
+    const Self = @This();
+
+    pub fn connect(socket_path: []const u8) !Self {
+        return Self{ .stream = try std.net.connectUnixSocket(socket_path) };
+    }
+
+    pub fn close(self: *Self) void {
+        self.stream.close();
+        self.* = undefined;
+    }
+
+    /// Lifts `[start, end)` of the target of `cfg`. Like
+    /// `SleighState.lift_range()` the lift can stop early, continue from
+    /// `range.end_address`
+    pub fn lift(self: *Self, cfg: *const StructFooConfig, start: u64, end: u64, allocator: std.mem.Allocator) !LiftReply {
+        var mapping = try self.submit(.{ .kind = .lift, .start = start, .end = end }, cfg, allocator);
+        errdefer mapping.unmap();
+
+        const bytes = mapping.slice();
+        if (bytes.len < @sizeOf(LiftHeader)) {
+            return DaemonError.BadReply;
+        }
+        const header = std.mem.bytesToValue(LiftHeader, bytes[0..@sizeOf(LiftHeader)]);
+        const arena = bytes[@sizeOf(LiftHeader)..];
+        if (header.range.arena_size != arena.len) {
+            return DaemonError.BadReply;
+        }
+
+        // the mapping is page aligned and the header is a multiple of 8, so
+        // the arena keeps the alignment of the tables inside of it
+        var range = header.range;
+        range.arena = arena.ptr;
+        return LiftReply{ .range = range, .mapping = mapping };
+    }
+
+    /// Finds the gadgets of the target of `cfg`
+    pub fn gadgets(self: *Self, cfg: *const StructFooConfig, flags: JobFlags, allocator: std.mem.Allocator) !GadgetReply {
+        var mapping = try self.submit(.{ .kind = .gadgets, .flags = flags }, cfg, allocator);
+        errdefer mapping.unmap();
+
+        const bytes = mapping.slice();
+        if (bytes.len < @sizeOf(GadgetHeader)) {
+            return DaemonError.BadReply;
+        }
+        const header = std.mem.bytesToValue(GadgetHeader, bytes[0..@sizeOf(GadgetHeader)]);
+        const rows_size = header.count * @sizeOf(GadgetRow);
+        if (bytes.len != @sizeOf(GadgetHeader) + rows_size + header.text_size) {
+            return DaemonError.BadReply;
+        }
+
+        const rows_bytes = bytes[@sizeOf(GadgetHeader)..][0..rows_size];
+        const rows: []const GadgetRow = @alignCast(std.mem.bytesAsSlice(GadgetRow, rows_bytes));
+        const text = bytes[@sizeOf(GadgetHeader) + rows_size ..];
+        for (rows) |row| {
+            if (row.text_offset + row.text_size > text.len) {
+                return DaemonError.BadReply;
+            }
+        }
+
+        return GadgetReply{ .rows = rows, .text = text, .mapping = mapping };
+    }
+
+    /// Stops the daemon once it replied
+    pub fn shutdown(self: *Self) !void {
+        const job = JobHeader{ .kind = .shutdown };
+        try self.stream.writeAll(std.mem.asBytes(&job));
+
+        var path_buf: [std.fs.MAX_PATH_BYTES]u8 = undefined;
+        _ = try self.read_reply(&path_buf);
+    }
+
+    /// Sends `job` for the target of `cfg` and maps its result
+    fn submit(self: *Self, job: JobHeader, cfg: *const StructFooConfig, allocator: std.mem.Allocator) !sleigh.MappedRegion {
+        const config_text = try std.json.stringifyAlloc(allocator, cfg.*, .{});
+        defer allocator.free(config_text);
+
+        var header = job;
+        header.config_size = config_text.len;
+        try self.stream.writeAll(std.mem.asBytes(&header));
+        try self.stream.writeAll(config_text);
+
+        var path_buf: [std.fs.MAX_PATH_BYTES]u8 = undefined;
+        const path = try self.read_reply(&path_buf);
+
+        // the mapping outlives the file, nothing else is going to open it
+        const mapping = try sleigh.MappedRegion.map(path, 0, 0);
+        std.fs.cwd().deleteFile(path) catch {};
+        return mapping;
+    }
+
+    /// Reads a reply into `path_buf`, any result path it carries is returned
+    fn read_reply(self: *Self, path_buf: []u8) ![:0]const u8 {
+        var reply: ReplyHeader = undefined;
+        try self.stream.reader().readNoEof(std.mem.asBytes(&reply));
+        if (!std.mem.eql(u8, &reply.magic, &REPLY_MAGIC) or reply.path_size >= path_buf.len) {
+            return DaemonError.BadReply;
+        }
+
+        try self.stream.reader().readNoEof(path_buf[0..reply.path_size]);
+        path_buf[reply.path_size] = 0;
+        switch (reply.status) {
+            .ok => return path_buf[0..reply.path_size :0],
+            .bad_job => return DaemonError.BadJob,
+            else => return DaemonError.JobFailed,
+        }
+    }
+};
+
+/// Every instruction of the target is a gadget
+const TestJobs = struct {
+    pub fn gadgets(_: TestJobs, shard_rt: *ShardRuntime, _: *const StructFooConfig, _: JobFlags, allocator: std.mem.Allocator) ![]const Gadget {
+        const insns = try shard_rt.perform_lift();
+        const out = try allocator.alloc(Gadget, insns.items.len);
+        for (insns.items, out) |insn, *gadget| {
+            gadget.* = Gadget{ .address = insn.base_address, .size = insn.size, .text = insn.text };
+        }
+        return out;
+    }
+};
+
+fn test_serve(daemon: *LiftDaemon, server: *std.net.Server) void {
+    daemon.serve(server, TestJobs{}) catch |err| {
+        std.debug.panic("daemon failed: {}", .{err});
+    };
+}
+
+test "daemon serves lifts + gadgets of a resident target" {
+    var arena = std.heap.ArenaAllocator.init(testing.allocator);
+    defer arena.deinit();
+    const allocator = arena.allocator();
+
+    var tmp = testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+    const dir = try std.fmt.allocPrint(allocator, "zig-cache/tmp/{s}", .{tmp.sub_path});
+
+    // `push {lr}; ldr r0, [r1]; bx lr`
+    const code = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x00, 0x00, 0x91, 0xe5, 0x1e, 0xff, 0x2f, 0xe1 };
+    try tmp.dir.writeFile("code.bin", &code);
+
+    var cfg = StructFooConfig.new();
+    try cfg.set_root_dir(".", allocator);
+    try cfg.set_sla("ARM8_le.sla", allocator);
+    try cfg.set_pspec("ARMt.pspec", allocator);
+    try cfg.set_input_path(try std.fmt.allocPrint(allocator, "{s}/code.bin", .{dir}), allocator);
+    cfg.set_input_mode("raw");
+
+    var daemon = LiftDaemon.init(allocator, dir);
+    defer daemon.deinit();
+    var server = try LiftDaemon.listen(try std.fmt.allocPrint(allocator, "{s}/daemon.sock", .{dir}));
+    defer server.deinit();
+    const thread = try std.Thread.spawn(.{}, test_serve, .{ &daemon, &server });
+
+    var client = try DaemonClient.connect(try std.fmt.allocPrint(allocator, "{s}/daemon.sock", .{dir}));
+    defer client.close();
+
+    // the same lift as a local `SleighState`
+    var local = sleigh.SleighState.init();
+    defer local.deinit();
+    try local.add_specfile("./specfiles/ARM8_le.sla");
+    local.begin();
+    try local.load_data(0x0, &code);
+    var expected = sleigh.LiftedRange{};
+    try local.lift_range(0x0, code.len, &expected);
+    defer local.release_range(&expected);
+
+    var lifted = try client.lift(&cfg, 0x0, code.len, allocator);
+    defer lifted.release();
+    try testing.expectEqual(expected.insn_count, lifted.range.insn_count);
+    try testing.expectEqual(expected.varnode_count, lifted.range.varnode_count);
+    for (expected.insns(), lifted.range.insns()) |*a, *b| {
+        try testing.expectEqualStrings(try expected.to_asm(a, allocator), try lifted.range.to_asm(b, allocator));
+    }
+
+    // both go to the target the lift loaded
+    for (0..2) |_| {
+        var reply = try client.gadgets(&cfg, .{}, allocator);
+        defer reply.release();
+        try testing.expectEqual(@as(usize, 3), reply.rows.len);
+        for (reply.rows, expected.insns()) |*row, *insn| {
+            try testing.expectEqual(insn.address, row.address);
+            try testing.expectEqualStrings(try expected.to_asm(insn, allocator), reply.text_of(row));
+        }
+    }
+
+    // a target that can't be loaded fails the job, not the daemon
+    var missing = cfg;
+    try missing.set_input_path("does-not-exist.bin", allocator);
+    try testing.expectError(DaemonError.JobFailed, client.gadgets(&missing, .{}, allocator));
+
+    try client.shutdown();
+    thread.join();
+    try testing.expectEqual(@as(usize, 1), daemon.residents.items.len);
+    try testing.expectEqual(@as(usize, 1), daemon.specs.count());
+
+    // the client unlinked every result
+    var it = tmp.dir.iterate();
+    while (try it.next()) |entry| {
+        try testing.expect(!std.mem.endsWith(u8, entry.name, ".result"));
+    }
+}
@@ -0,0 +1,165 @@
+//! Bounded ring carrying lifted chunks from the lifting threads to the
+//! single consumer of a streaming lift.
+//!
+//! Item `n` always goes into slot `n % capacity`, and a producer can only
+//! claim item `n` once the consumer has taken every item before
+//! `n - capacity + 1`. So no more than `capacity` items are ever lifted but
+//! not yet consumed (the back-pressure that keeps memory bounded), any
+//! number of producers fill their own slots without a lock, and the
+//! consumer gets the items in order no matter which thread finished first.
+//! Everything waits on futexes, nothing spins.
+const std = @import("std");
+const testing = std.testing;
+
+const Futex = std.Thread.Futex;
+
+pub fn LiftRing(comptime T: type) type {
+    return struct {
+        slots: []Slot,
+        /// items that will go through the ring
+        total: u32,
+        /// next item index a producer claims
+        next: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+        /// items the consumer has taken, or `total` once closed
+        consumed: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+        closed: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+
+        const Slot = struct {
+            item: T = undefined,
+            /// 1 while `item` holds an item the consumer hasn't taken
+            ready: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+        };
+
+        const Self = @This();
+
+        pub fn init(allocator: std.mem.Allocator, capacity: u32, total: u32) !Self {
+            const slots = try allocator.alloc(Slot, @max(capacity, 1));
+            for (slots) |*slot| {
+                slot.* = .{};
+            }
+            return Self{ .slots = slots, .total = total };
+        }
+
+        pub fn deinit(self: *Self, allocator: std.mem.Allocator) void {
+            allocator.free(self.slots);
+            self.* = undefined;
+        }
+
+        /// Producer side: claims the index of the next item to produce,
+        /// waiting while the ring is full. `null` once every item is
+        /// claimed or the ring is closed.
+        pub fn claim(self: *Self) ?u32 {
+            if (self.closed.load(.acquire)) {
+                return null;
+            }
+
+            const index = self.next.fetchAdd(1, .monotonic);
+            if (index >= self.total) {
+                return null;
+            }
+
+            while (true) {
+                const consumed = self.consumed.load(.acquire);
+                if (self.closed.load(.acquire)) {
+                    return null;
+                }
+                if (index < consumed + self.slots.len) {
+                    return index;
+                }
+                Futex.wait(&self.consumed, consumed);
+            }
+        }
+
+        /// Producer side: hands over the item claimed as `index`
+        pub fn put(self: *Self, index: u32, item: T) void {
+            const slot = &self.slots[index % self.slots.len];
+            slot.item = item;
+            slot.ready.store(1, .release);
+            Futex.wake(&slot.ready, 1);
+        }
+
+        /// Consumer side: waits for the next item in order, `null` once
+        /// every item was taken
+        pub fn take(self: *Self) ?T {
+            const index = self.consumed.load(.monotonic);
+            if (index >= self.total) {
+                return null;
+            }
+
+            const slot = &self.slots[index % self.slots.len];
+            while (slot.ready.load(.acquire) == 0) {
+                Futex.wait(&slot.ready, 0);
+            }
+            const item = slot.item;
+            slot.ready.store(0, .monotonic);
+
+            self.consumed.store(index + 1, .release);
+            Futex.wake(&self.consumed, std.math.maxInt(u32));
+            return item;
+        }
+
+        /// Consumer side: stops handing out items, for when the consumer
+        /// gives up early. Producers waiting on a full ring return `null`
+        /// from `claim()`, anything already claimed is still `put()`.
+        pub fn close(self: *Self) void {
+            self.closed.store(true, .release);
+            self.consumed.store(self.total, .release);
+            Futex.wake(&self.consumed, std.math.maxInt(u32));
+        }
+
+        /// Once every producer stopped, the next item put but never taken
+        pub fn drain(self: *Self) ?T {
+            for (self.slots) |*slot| {
+                if (slot.ready.load(.acquire) != 0) {
+                    slot.ready.store(0, .monotonic);
+                    return slot.item;
+                }
+            }
+            return null;
+        }
+    };
+}
+
+fn produce(ring: *LiftRing(u64)) void {
+    while (ring.claim()) |index| {
+        ring.put(index, @as(u64, index) * 3);
+    }
+}
+
+test "items come out in order with many producers" {
+    var ring = try LiftRing(u64).init(testing.allocator, 4, 1000);
+    defer ring.deinit(testing.allocator);
+
+    var threads: [3]std.Thread = undefined;
+    for (&threads) |*thread| {
+        thread.* = try std.Thread.spawn(.{}, produce, .{&ring});
+    }
+
+    var expected: u64 = 0;
+    while (ring.take()) |item| {
+        try testing.expectEqual(expected * 3, item);
+        expected += 1;
+    }
+    for (threads) |thread| {
+        thread.join();
+    }
+    try testing.expectEqual(@as(u64, 1000), expected);
+}
+
+test "closing releases waiting producers" {
+    var ring = try LiftRing(u64).init(testing.allocator, 2, 1000);
+    defer ring.deinit(testing.allocator);
+
+    var thread = try std.Thread.spawn(.{}, produce, .{&ring});
+    try testing.expectEqual(@as(?u64, 0), ring.take());
+    ring.close();
+    thread.join();
+
+    // whatever was put after the last take is left for `drain()`
+    var left: usize = 0;
+    while (ring.drain()) |_| {
+        left += 1;
+    }
+    try testing.expect(left <= 2);
+    try testing.expectEqual(@as(?u64, null), ring.take());
+}
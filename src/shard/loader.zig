@@ -6,14 +6,18 @@ const json = std.json;
 
 const targets = @import("targets.zig");
 const memory = @import("memory.zig");
+const ghidra_dump = @import("ghidra_dump.zig");
 const xml = @import("../xml.zig");
 const config = @import("../config.zig");
 const shard = @import("../shard.zig");
+const sleigh = @import("../sleigh.zig");
 const XmlParser = xml.parse;
 
 const ShardError = shard.ShardError;
 const StructFooConfig = config.StructFooConfig;
+const MappedRegion = sleigh.MappedRegion;
 const SleighContextPair = targets.SleighContextPair;
+const SleighContextRegion = targets.SleighContextRegion;
 const ShardInputTarget = targets.ShardInputTarget;
 const ShardMemoryRegion = memory.ShardMemoryRegion;
 
@@ -129,6 +133,76 @@ pub fn loadPspecContext(allocator: std.mem.Allocator, path: []const u8) []Sleigh
     return pairs;
 }
 
+/// Parses the `context_set`'s of the `.pspec` that only cover `first` to
+/// `last` (eg. the upper bank of an 8048) into `SleighContextRegion`'s, the
+/// ones without a range are the defaults of `loadPspecContext`.
+///
+/// The returned slice of regions is caller-owned
+pub fn loadPspecContextRegions(allocator: std.mem.Allocator, path: []const u8) []SleighContextRegion {
+    var raw_file = std.fs.openFileAbsolute(path, .{}) catch |err| {
+        logger.err("Failed to open file: `{}`", .{err});
+        return &.{};
+    };
+    defer raw_file.close();
+    const file_contents = raw_file.readToEndAlloc(allocator, 16 * 1024) catch |err| {
+        logger.err("Unable to read from file: `{}`", .{err});
+        return &.{};
+    };
+    defer allocator.free(file_contents);
+
+    var document = XmlParser(allocator, file_contents) catch {
+        logger.err("Failed to parse xml from pspec", .{});
+        return &.{};
+    };
+    defer document.deinit();
+
+    const context_data = document.root.findChildByTag("context_data") orelse return &.{};
+
+    var context_regions = std.ArrayList(SleighContextRegion).init(allocator);
+    var set_it = context_data.findChildrenByTag("context_set");
+    while (set_it.next()) |context_set| {
+        const first = context_set.getAttribute("first") orelse continue;
+        const last = context_set.getAttribute("last") orelse continue;
+        const start = std.fmt.parseInt(u64, first, 0) catch {
+            logger.err("bad `first` address in context set: `{s}`", .{first});
+            continue;
+        };
+        // `last` is the last address the set covers
+        const end = (std.fmt.parseInt(u64, last, 0) catch {
+            logger.err("bad `last` address in context set: `{s}`", .{last});
+            continue;
+        }) +| 1;
+
+        var it = context_set.findChildrenByTag("set");
+        while (it.next()) |ctx_set| {
+            const var_name = ctx_set.getAttribute("name") orelse {
+                logger.err("Context tuple did not contain `name` attr", .{});
+                continue;
+            };
+            const var_value = ctx_set.getAttribute("val") orelse {
+                logger.err("Context tuple did not contain `val` attr", .{});
+                continue;
+            };
+            const value = std.fmt.parseInt(u64, var_value, 10) catch blk: {
+                logger.err("bad value in context set for `{s}`-- setting to 0", .{var_name});
+                break :blk 0;
+            };
+
+            const variable = allocator.dupeZ(u8, var_name) catch |err| {
+                logger.err("Failed to allocate memory for context `name`: {}", .{err});
+                return context_regions.toOwnedSlice() catch &.{};
+            };
+            context_regions.append(.{ .variable = variable, .start = start, .end = end, .value = value }) catch |err| {
+                logger.err("Failed to allocate memory required for regions: {}", .{err});
+                allocator.free(variable);
+                return context_regions.toOwnedSlice() catch &.{};
+            };
+        }
+    }
+
+    return context_regions.toOwnedSlice() catch &.{};
+}
+
 /// Performs the loading of input files from disk and deserializing or
 /// parsing them into a `ShardInputTarget` that can be consumed by the
 /// remainder of the `SHARD` runtime. The dependencies for this to do
@@ -141,11 +215,42 @@ pub fn loadPspecContext(allocator: std.mem.Allocator, path: []const u8) []Sleigh
 /// - alignment
 pub const ShardLoader = struct {
     allocator: std.mem.Allocator,
+    /// files mapped for raw regions, the regions alias them until `deinit`
+    mappings: std.ArrayList(MappedRegion),
+    /// zstd images of compressed raw regions, closed at `deinit`
+    images: std.ArrayList(sleigh.ZstdImage),
+    /// object files the code section regions alias, until `deinit`
+    objects: std.ArrayList(sleigh.ObjectImage),
+    /// context variables the last loaded dump sets over ranges of it
+    dump_context_regions: std.ArrayList(SleighContextRegion),
 
     const Self = @This();
 
     pub fn init(allocator: std.mem.Allocator) Self {
-        return Self{ .allocator = allocator };
+        return Self{
+            .allocator = allocator,
+            .mappings = std.ArrayList(MappedRegion).init(allocator),
+            .images = std.ArrayList(sleigh.ZstdImage).init(allocator),
+            .objects = std.ArrayList(sleigh.ObjectImage).init(allocator),
+            .dump_context_regions = std.ArrayList(SleighContextRegion).init(allocator),
+        };
+    }
+
+    /// Unmaps every input file, the loaded targets can't be used afterwards
+    pub fn deinit(self: *Self) void {
+        for (self.mappings.items) |*mapping| {
+            mapping.unmap();
+        }
+        self.mappings.deinit();
+        for (self.images.items) |*image| {
+            image.close();
+        }
+        self.images.deinit();
+        for (self.objects.items) |*object| {
+            object.close();
+        }
+        self.objects.deinit();
+        self.dump_context_regions.deinit();
     }
 
     /// Given a `StructFooConfig`, take the necesary input arguments
@@ -170,6 +275,26 @@ pub const ShardLoader = struct {
         defer self.allocator.free(pspec_path);
         const pairs = loadPspecContext(self.allocator, pspec_path);
 
+        // get the ranged context, the pspec's first so the dump + config
+        // can paint over it
+        const pspec_regions = loadPspecContextRegions(self.allocator, pspec_path);
+        defer self.allocator.free(pspec_regions);
+        var context_regions = try std.ArrayList(SleighContextRegion).initCapacity(
+            self.allocator,
+            pspec_regions.len + self.dump_context_regions.items.len + cfg.context_regions.len,
+        );
+        context_regions.appendSliceAssumeCapacity(pspec_regions);
+        context_regions.appendSliceAssumeCapacity(self.dump_context_regions.items);
+        self.dump_context_regions.clearRetainingCapacity();
+        for (cfg.context_regions) |region| {
+            context_regions.appendAssumeCapacity(.{
+                .variable = region.variable,
+                .start = region.start,
+                .end = region.end,
+                .value = region.value,
+            });
+        }
+
         // construct target
         var target = ShardInputTarget.from_regions(regions);
 
@@ -178,6 +303,7 @@ pub const ShardLoader = struct {
 
         // add context pairs to target
         target.setContextPairs(pairs);
+        target.setContextRegions(try context_regions.toOwnedSlice());
 
         // add sla to target
         const sla_path = try cfg.getSlaPath(self.allocator);
@@ -187,33 +313,201 @@ pub const ShardLoader = struct {
         return target;
     }
 
-    /// For now this just treats `path` as a raw binary file, the plan
-    /// is for this method to handle the detectino of known object file formats
-    /// and load into the proper regions if applicable, else fallback to a single
-    /// flat binary blob region. REturned regions are caller-owned.
+    /// Loads the code sections of an object file BFD recognizes (ELF, COFF,
+    /// PE, ...) at their VMAs, and falls back to the whole file as a single
+    /// flat binary blob region at 0 for anything else. Returned regions are
+    /// caller-owned.
+    ///
+    /// The file is mapped rather than read, so the region data references the
+    /// page cache directly and lives until `ShardLoader.deinit()`.
+    ///
+    /// A zstd compressed file is loaded as its decompressed bytes, which
+    /// SLEIGH only decompresses a frame at a time as it reads them.
     pub fn rawToRegions(self: *Self, path: []const u8) ![]ShardMemoryRegion {
-        const file_contents = try std.fs.cwd().readFileAlloc(self.allocator, path, 50 * 1024 * 1024);
-        defer self.allocator.free(file_contents);
+        if (try self.objectToRegions(path)) |regions| {
+            return regions;
+        }
+        return self.flatToRegions(path);
+    }
+
+    /// A region for every code section of the object file at `path`, `null`
+    /// if it isn't an object file or has none
+    fn objectToRegions(self: *Self, path: []const u8) !?[]ShardMemoryRegion {
+        const path_z = try self.allocator.dupeZ(u8, path);
+        defer self.allocator.free(path_z);
+
+        try self.objects.ensureUnusedCapacity(1);
+        var image = sleigh.ObjectImage.open(path_z) catch return null;
+        errdefer image.close();
+
+        var memory_regions = std.ArrayList(ShardMemoryRegion).init(self.allocator);
+        errdefer {
+            for (memory_regions.items) |region| {
+                self.allocator.free(region.name);
+            }
+            memory_regions.deinit();
+        }
+
+        for (image.slice()) |*section| {
+            if (section.flags & sleigh.SectionFlags.CODE == 0) {
+                continue;
+            }
+            const data = section.slice() orelse continue;
+            try memory_regions.append(.{
+                .name = try self.allocator.dupe(u8, section.get_name()),
+                .base_address = section.address,
+                .data = data,
+                .flags = section.flags,
+            });
+        }
+
+        if (memory_regions.items.len == 0) {
+            logger.warn("`{s}` has no code sections, loading all of it", .{path});
+            memory_regions.deinit();
+            image.close();
+            return null;
+        }
+        logger.debug("Found {} code sections in `{s}`", .{ memory_regions.items.len, path });
+
+        self.objects.appendAssumeCapacity(image);
+        return try memory_regions.toOwnedSlice();
+    }
+
+    /// The whole file at `path` as one region at 0
+    fn flatToRegions(self: *Self, path: []const u8) ![]ShardMemoryRegion {
+        const path_z = try self.allocator.dupeZ(u8, path);
+        defer self.allocator.free(path_z);
+
+        try self.mappings.ensureUnusedCapacity(1);
+        try self.images.ensureUnusedCapacity(1);
+        var mapping = try MappedRegion.map(path_z, 0, 0);
+        errdefer mapping.unmap();
+        const file_contents = mapping.slice();
 
         const name = try self.allocator.alloc(u8, path.len);
+        errdefer self.allocator.free(name);
         @memcpy(name, path);
 
         var region = try self.allocator.alloc(ShardMemoryRegion, 1);
+        errdefer self.allocator.free(region);
         region[0].base_address = 0;
         region[0].name = name;
+        if (sleigh.ZstdImage.detect(file_contents)) {
+            const image = sleigh.ZstdImage.open(path_z) catch |err| {
+                logger.err("`{s}` isn't made of zstd frames that record their size, recompress it with `zstd` from a file rather than a pipe", .{path});
+                return err;
+            };
+            mapping.unmap();
+            region[0].data = &.{};
+            region[0].compressed = image;
+            region[0].flags = 0;
+            self.images.appendAssumeCapacity(image);
+            logger.debug("Loading `{s}` as a zstd image of 0x{x} bytes", .{ path, image.size });
+            return region;
+        }
+
         region[0].data = file_contents;
+        region[0].compressed = null;
+        region[0].flags = 0;
+        self.mappings.appendAssumeCapacity(mapping);
         return region;
     }
 
-    /// This method should only be used with json dumps that were created with
-    /// the packaged scripts, and will convert the serialized "regions" into
-    /// `ShardMemoryRegion`. Returned regions are caller-owned.
+    /// This method should only be used with dumps that were created with the
+    /// packaged scripts, and will convert the dumped functions into
+    /// `ShardMemoryRegion`. Takes both the binary dumps the script writes
+    /// (see `ghidra_dump.zig`) and the hex-in-json dumps it used to.
+    /// Returned regions are caller-owned.
     pub fn ghidraDumpToRegions(self: *Self, path: []const u8) ![]ShardMemoryRegion {
-        const file_contents = try std.fs.cwd().readFileAlloc(self.allocator, path, 50 * 1024 * 1024);
-        defer self.allocator.free(file_contents);
+        const path_z = try self.allocator.dupeZ(u8, path);
+        defer self.allocator.free(path_z);
+
+        try self.mappings.ensureUnusedCapacity(1);
+        var mapping = try MappedRegion.map(path_z, 0, 0);
+        var keep_mapping = false;
+        defer if (!keep_mapping) mapping.unmap();
+
+        if (ghidra_dump.GhidraDump.parse(mapping.slice())) |dump| {
+            const regions = try self.binaryDumpToRegions(&dump);
+            keep_mapping = true;
+            self.mappings.appendAssumeCapacity(mapping);
+            return regions;
+        } else |err| switch (err) {
+            error.NotADump => {},
+            else => return err,
+        }
+        return self.jsonDumpToRegions(mapping.slice());
+    }
+
+    /// Every function of `dump` as a region aliasing the mapped dump, or
+    /// every executable region if it has no functions
+    fn binaryDumpToRegions(self: *Self, dump: *const ghidra_dump.GhidraDump) ![]ShardMemoryRegion {
+        var memory_regions = std.ArrayList(ShardMemoryRegion).init(self.allocator);
+        errdefer {
+            for (memory_regions.items) |region| {
+                self.allocator.free(region.name);
+            }
+            memory_regions.deinit();
+        }
+
+        if (dump.functions.len > 0) {
+            for (dump.functions) |function| {
+                const data = dump.function_data(function) orelse {
+                    logger.warn("Function `{s}` is outside of every dumped region, skipping it", .{dump.function_name(function)});
+                    continue;
+                };
+                try memory_regions.append(.{
+                    .name = try self.allocator.dupe(u8, dump.function_name(function)),
+                    .base_address = function.entry,
+                    .data = data,
+                });
+            }
+        } else {
+            for (dump.regions) |region| {
+                if (region.permissions & ghidra_dump.DUMP_PERM_EXECUTE == 0) {
+                    continue;
+                }
+                try memory_regions.append(.{
+                    .name = try self.allocator.dupe(u8, dump.region_name(region)),
+                    .base_address = region.base_address,
+                    .data = dump.region_data(region),
+                });
+            }
+        }
+        logger.debug("Found {} memory regions", .{memory_regions.items.len});
+
+        try self.dump_context_regions.ensureUnusedCapacity(dump.contexts.len);
+        for (dump.contexts) |context| {
+            if (context.end <= context.start) {
+                logger.warn("Context `{s}` covers no bytes, skipping it", .{dump.context_name(context)});
+                continue;
+            }
+            const variable = try self.allocator.dupeZ(u8, dump.context_name(context));
+            self.dump_context_regions.appendAssumeCapacity(.{
+                .variable = variable,
+                .start = context.start,
+                .end = context.end,
+                .value = context.value,
+            });
+        }
+        logger.debug("Found {} context ranges", .{self.dump_context_regions.items.len});
+
+        return memory_regions.toOwnedSlice();
+    }
+
+    /// A `ShardMemoryRegion` as the json dumps have it, `data` hex encoded
+    const JsonDumpRegion = struct {
+        name: []u8,
+        base_address: u64,
+        data: []u8,
+    };
+
+    /// Converts the hex encoded functions of a json dump into regions
+    /// holding their bytes
+    fn jsonDumpToRegions(self: *Self, file_contents: []const u8) ![]ShardMemoryRegion {
 
         // reads the file into the json schema for an array of `ShardMemoryRegion`'s'
-        var input_regions = try json.parseFromSlice([]ShardMemoryRegion, self.allocator, file_contents, .{});
+        var input_regions = try json.parseFromSlice([]JsonDumpRegion, self.allocator, file_contents, .{});
         defer input_regions.deinit();
         logger.debug("Found {} memory regions", .{input_regions.value.len});
 
@@ -238,6 +532,8 @@ pub const ShardLoader = struct {
                 data[i] = try std.fmt.parseInt(u8, str_byte, 16);
             }
             out.data = data;
+            out.compressed = null;
+            out.flags = 0;
         }
 
         return memory_regions;
@@ -1,5 +1,6 @@
 const std = @import("std");
 const testing = std.testing;
+const sleigh = @import("../sleigh.zig");
 
 /// Represents a region of memory, does not own it's own memory
 /// and should be created with an `ArenaAllocator`
@@ -12,22 +13,39 @@ pub const ShardMemoryRegion = struct {
     /// used essentially as an offset from the `ShardInputTarget.base_address`
     base_address: u64,
 
-    /// The backing slice of data for the entire `ShardMemoryRegion`
+    /// The backing slice of data for the entire `ShardMemoryRegion`, empty
+    /// when the region is `compressed`
     data: []u8,
 
+    /// The zstd image holding the bytes of the region instead of `data`,
+    /// they are only decompressed as SLEIGH reads them
+    compressed: ?sleigh.ZstdImage = null,
+
+    /// `sleigh.SectionFlags` of the object file section the region is, 0
+    /// for anything else
+    flags: u32 = 0,
+
     const Self = @This();
 
+    /// Size of the region in bytes, decompressed
+    pub fn len(self: *const Self) u64 {
+        if (self.compressed) |image| {
+            return image.size;
+        }
+        return self.data.len;
+    }
+
     /// Is the requested address inside the memory region.
     ///
     /// NOTE: this does not take into consideration any `size` constraints of a request,
     /// for that -- see `ShardMemoryRegion::containsRange()`
     pub fn contains(self: *const Self, address: u64) bool {
-        if (self.data.len == 0) {
+        if (self.len() == 0) {
             return false;
         }
 
         // address must be in the range [base_address, base_address + size)
-        if (address >= self.base_address and address <= self.base_address + self.data.len - 1) {
+        if (address >= self.base_address and address <= self.base_address + self.len() - 1) {
             return true;
         }
 
@@ -40,25 +58,30 @@ pub const ShardMemoryRegion = struct {
     /// Applies failure cases, and fallthrough is `true`
     /// 1. if `address` < `self.base_address` => `false`
     /// *at this point, `address` >= `self.base_address`*
-    /// 2. if `address` + `size` > `self.base_address` + `self.data.len` => false
+    /// 2. if `address` + `size` > `self.base_address` + `self.len()` => false
     pub fn containsRange(self: *const Self, address: u64, size: u64) bool {
         if (address < self.base_address) {
             return false;
         }
 
-        if (self.data.len == 0) {
+        if (self.len() == 0) {
             return false;
         }
 
         // address + size must be below the upper bound of the region,
         // we can skip the -1 check here by just checking if the provided upper
         // bound is greater than this regions' upper bound
-        if (address + size > self.base_address + self.data.len) {
+        if (address + size > self.base_address + self.len()) {
             return false;
         }
 
         return true;
     }
+
+    /// Orders regions by `base_address`, for use with `std.mem.sort`
+    pub fn baseAddressLessThan(_: void, lhs: Self, rhs: Self) bool {
+        return lhs.base_address < rhs.base_address;
+    }
 };
 
 test "contains" {
@@ -184,6 +184,29 @@ pub const ShardOperation = union(ShardOps) {
         // no output
         return Self.new(inputs, null, shard_op, allocator);
     }
+
+    /// Creates a caller owned `ShardOperation` from a P-Code operation inside
+    /// of a `LiftedRange`
+    pub fn from_range_op(range: *const sleigh.LiftedRange, op_index: u64, spaces: *const sleigh.SpaceTable, register_map: *const RegisterMap, allocator: std.mem.Allocator) !Self {
+        const in_op = range.op(op_index);
+        const inputs = try allocator.alloc(VarReference, in_op.input_len);
+        errdefer allocator.free(inputs);
+
+        const shard_op = ShardOps.from_sleigh(in_op.opcode);
+
+        for (inputs, in_op.input_start..) |*input, vn_idx| {
+            const vn = range.varnode(vn_idx);
+            input.* = try VarReference.from_compact_varnode(&vn, spaces, register_map);
+        }
+
+        if (range.output(in_op)) |out_vn| {
+            const out = try VarReference.from_compact_varnode(&out_vn, spaces, register_map);
+
+            return Self.new(inputs, out, shard_op, allocator);
+        }
+
+        return Self.new(inputs, null, shard_op, allocator);
+    }
 };
 
 pub const ShardAstNode = struct {};
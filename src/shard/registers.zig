@@ -36,10 +36,46 @@ pub const RegisterImpl = struct {
     }
 };
 
+/// Sizes a register can be split by when a varnode is only part of it
+const SIZE_MODIFIERS = [_]usize{ 2, 4, 8 };
+
+/// Copy of the lookup SLEIGH builds for the register space (see
+/// `sleigh.RegisterList`), indices are into the `RegisterMap`
+const DenseIndex = struct {
+    /// index of the register at `offsets[0]`
+    start: usize,
+    /// ascending offsets of the register space registers
+    offsets: []u64,
+    direct_base: u64,
+    /// index of the first register at `direct_base + idx`, empty if the
+    /// register space is too sparse
+    direct: []u32,
+
+    /// Index of the first (and largest) register at `offset`
+    fn first_at(self: *const DenseIndex, offset: u64) ?usize {
+        if (self.direct.len > 0) {
+            if (offset < self.direct_base or offset - self.direct_base >= self.direct.len) {
+                return null;
+            }
+
+            const id = self.direct[offset - self.direct_base];
+            return if (id == sleigh.CompactVarnodeDesc.NO_REGISTER) null else id;
+        }
+
+        const idx = std.sort.lowerBound(u64, offset, self.offsets, {}, std.sort.asc(u64));
+        if (idx == self.offsets.len or self.offsets[idx] != offset) {
+            return null;
+        }
+        return self.start + idx;
+    }
+};
+
 /// Container of `RegisterImpl`'s, thin layet over the backing container
 /// to logically segment the implementation
 pub const RegisterMap = struct {
     registers: std.ArrayList(RegisterImpl),
+    /// set by `useIndex`, otherwise every lookup is a scan
+    dense: ?DenseIndex = null,
 
     const Self = @This();
 
@@ -64,11 +100,47 @@ pub const RegisterMap = struct {
     }
 
     pub fn deinit(self: *Self) void {
+        self.dropIndex();
         self.registers.deinit();
         self.* = undefined;
     }
 
+    /// Looks registers up through the table SLEIGH built for `list`, which
+    /// must be the list the registers were added from (in the same order)
+    pub fn useIndex(self: *Self, list: *const sleigh.RegisterList) !void {
+        const allocator = self.registers.allocator;
+        const offsets = try allocator.dupe(u64, list.space_offsets());
+        errdefer allocator.free(offsets);
+        const direct = try allocator.dupe(u32, list.direct_table());
+
+        self.dropIndex();
+        self.dense = DenseIndex{ .start = list.space_start, .offsets = offsets, .direct_base = list.direct_base, .direct = direct };
+    }
+
+    fn dropIndex(self: *Self) void {
+        if (self.dense) |dense| {
+            self.registers.allocator.free(dense.offsets);
+            self.registers.allocator.free(dense.direct);
+            self.dense = null;
+        }
+    }
+
+    /// The register with index `id`, eg. the `register_id` of a lifted
+    /// varnode
+    pub fn get(self: *const Self, id: usize) ?*const RegisterImpl {
+        if (id >= self.registers.items.len) {
+            return null;
+        }
+        return &self.registers.items[id];
+    }
+
     pub fn lookup(self: *const Self, offset: usize, size: usize) ?*const RegisterImpl {
+        if (self.dense) |*dense| {
+            if (self.lookupDense(dense, offset, size)) |reg| {
+                return reg;
+            }
+        }
+
         for (self.items(), 0..) |reg, idx| {
             if (reg.offset_key == offset and reg.size == size) {
                 return &self.registers.items[idx];
@@ -81,8 +153,7 @@ pub const RegisterMap = struct {
         // ghidra has some *very* poor decisions for architectures like riscv
         // to not have sub registers like (ax into eax into rax),
         // in this case they have `a4` and don't differentiate into smaller variations
-        const modifiers = [_]usize{ 2, 4, 8 };
-        for (modifiers) |modifier| {
+        for (SIZE_MODIFIERS) |modifier| {
             for (self.items(), 0..) |reg, idx| {
                 if (reg.offset_key == offset and (size == reg.size / modifier)) {
                     return &self.registers.items[idx];
@@ -92,6 +163,29 @@ pub const RegisterMap = struct {
         return null;
     }
 
+    /// Same matching as `lookup`, over only the registers at `offset`.
+    /// Those are contiguous and the largest comes first
+    fn lookupDense(self: *const Self, dense: *const DenseIndex, offset: usize, size: usize) ?*const RegisterImpl {
+        const first = dense.first_at(offset) orelse return null;
+        const end = @min(dense.start + dense.offsets.len, self.items().len);
+
+        var last = first;
+        while (last < end and self.items()[last].offset_key == offset) : (last += 1) {
+            if (self.items()[last].size == size) {
+                return &self.registers.items[last];
+            }
+        }
+
+        for (SIZE_MODIFIERS) |modifier| {
+            for (self.items()[first..last], first..) |reg, idx| {
+                if (size == reg.size / modifier) {
+                    return &self.registers.items[idx];
+                }
+            }
+        }
+        return null;
+    }
+
     pub fn print_all(self: *const Self) void {
         for (self.items()) |reg| {
             logger.debug("Register{{name: {s}, offset: {}, size: {}}}", .{ reg.name, reg.offset_key, reg.size });
@@ -200,3 +294,43 @@ test "register map lookup" {
     try testing.expect(null == reg_map.lookup(100, 4));
     try testing.expect(null == reg_map.lookup(2, 4));
 }
+
+test "register map dense lookup" {
+    var reg_map = try RegisterMap.newWithCapacity(testing.allocator, 8);
+    defer reg_map.deinit();
+
+    // ordered like SLEIGH hands them out: offset, then size descending
+    const names = [_]*const [16]u8{ "rax_____________", "eax_____________", "ax______________", "al______________", "ah______________", "a4______________" };
+    const keys = [_][2]usize{ .{ 0, 8 }, .{ 0, 4 }, .{ 0, 2 }, .{ 0, 1 }, .{ 1, 1 }, .{ 0x40, 8 } };
+    for (names, keys) |name, key| {
+        try reg_map.addRegister(RegisterImpl{ .name = name.*, .offset_key = key[0], .size = key[1], .size_key = key[1], .value = &[_]u8{} });
+    }
+
+    const none = sleigh.CompactVarnodeDesc.NO_REGISTER;
+    var offsets = [_]u64{ 0, 0, 0, 0, 1, 0x40 };
+    var direct = [_]u32{none} ** 0x41;
+    direct[0] = 0;
+    direct[1] = 4;
+    direct[0x40] = 5;
+
+    var descs: [1]sleigh.RegisterDesc = undefined;
+    const sparse = sleigh.RegisterList{ .register_count = 0, .registers = &descs, .space_start = 0, .space_count = offsets.len, .offsets = &offsets, .direct_base = 0, .direct_count = 0, .direct = null };
+    const dense = sleigh.RegisterList{ .register_count = 0, .registers = &descs, .space_start = 0, .space_count = offsets.len, .offsets = &offsets, .direct_base = 0, .direct_count = direct.len, .direct = &direct };
+
+    // the binary searched + the directly indexed tables give the same
+    // registers as the scan
+    for ([_]*const sleigh.RegisterList{ &sparse, &dense }) |list| {
+        try reg_map.useIndex(list);
+
+        try testing.expectEqualStrings("eax_____________", &reg_map.lookup(0, 4).?.name);
+        try testing.expectEqualStrings("al______________", &reg_map.lookup(0, 1).?.name);
+        try testing.expectEqualStrings("ah______________", &reg_map.lookup(1, 1).?.name);
+        try testing.expectEqualStrings("a4______________", &reg_map.lookup(0x40, 4).?.name);
+        try testing.expectEqualStrings("a4______________", &reg_map.lookup(0x40, 1).?.name);
+        try testing.expect(null == reg_map.lookup(2, 1));
+        try testing.expect(null == reg_map.lookup(0x1000, 8));
+    }
+
+    try testing.expectEqualStrings("ah______________", &reg_map.get(4).?.name);
+    try testing.expect(null == reg_map.get(6));
+}
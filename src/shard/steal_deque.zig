@@ -0,0 +1,162 @@
+//! Chase-Lev work stealing deque of task indices, one per lifting thread.
+//!
+//! The thread owning a deque pushes + pops at its bottom without ever
+//! taking a lock, every other thread steals from its top when it runs out
+//! of work of its own. The owner works through its newest tasks first
+//! while thieves take the oldest ones, so the two only race for the last
+//! task. Capacity is fixed, a lift knows up front how many tasks it can
+//! ever make.
+const std = @import("std");
+const testing = std.testing;
+
+pub const StealDeque = struct {
+    slots: []std.atomic.Value(u32),
+    /// next slot a thief steals from
+    top: std.atomic.Value(i64) = std.atomic.Value(i64).init(0),
+    /// next slot the owner pushes to
+    bottom: std.atomic.Value(i64) = std.atomic.Value(i64).init(0),
+
+    const Self = @This();
+
+    /// `capacity` is rounded up to a power of two
+    pub fn init(allocator: std.mem.Allocator, capacity: usize) !Self {
+        const slots = try allocator.alloc(std.atomic.Value(u32), std.math.ceilPowerOfTwoAssert(usize, @max(capacity, 1)));
+        for (slots) |*slot| {
+            slot.* = std.atomic.Value(u32).init(0);
+        }
+        return Self{ .slots = slots };
+    }
+
+    pub fn deinit(self: *Self, allocator: std.mem.Allocator) void {
+        allocator.free(self.slots);
+        self.* = undefined;
+    }
+
+    fn at(self: *Self, index: i64) *std.atomic.Value(u32) {
+        return &self.slots[@as(usize, @intCast(index)) & (self.slots.len - 1)];
+    }
+
+    /// Owner side: adds `task` to the bottom, `error.DequeFull` if every
+    /// slot already holds one
+    pub fn push(self: *Self, task: u32) !void {
+        const b = self.bottom.load(.monotonic);
+        const t = self.top.load(.acquire);
+        if (b - t >= @as(i64, @intCast(self.slots.len))) {
+            return error.DequeFull;
+        }
+        self.at(b).store(task, .monotonic);
+        self.bottom.store(b + 1, .release);
+    }
+
+    /// Owner side: takes the newest task, `null` if thieves got them all
+    pub fn pop(self: *Self) ?u32 {
+        const b = self.bottom.load(.monotonic) - 1;
+        // both sequentially consistent, so a thief either sees the lowered
+        // bottom or the owner sees the thief's top
+        self.bottom.store(b, .seq_cst);
+        const t = self.top.load(.seq_cst);
+        if (t > b) {
+            self.bottom.store(b + 1, .monotonic);
+            return null;
+        }
+
+        const task = self.at(b).load(.monotonic);
+        if (t == b) {
+            // the last task, whoever moves top first gets it
+            const won = self.top.cmpxchgStrong(t, t + 1, .seq_cst, .monotonic) == null;
+            self.bottom.store(b + 1, .monotonic);
+            return if (won) task else null;
+        }
+        return task;
+    }
+
+    /// Thief side: takes the oldest task, `null` if there is none or
+    /// another thread took it first
+    pub fn steal(self: *Self) ?u32 {
+        const t = self.top.load(.seq_cst);
+        const b = self.bottom.load(.seq_cst);
+        if (t >= b) {
+            return null;
+        }
+
+        const task = self.at(t).load(.monotonic);
+        if (self.top.cmpxchgStrong(t, t + 1, .seq_cst, .monotonic) != null) {
+            return null;
+        }
+        return task;
+    }
+};
+
+test "owner pops newest first, thieves take the oldest" {
+    var deque = try StealDeque.init(testing.allocator, 3);
+    defer deque.deinit(testing.allocator);
+
+    try deque.push(1);
+    try deque.push(2);
+    try deque.push(3);
+    try deque.push(4);
+    try testing.expectError(error.DequeFull, deque.push(5));
+
+    try testing.expectEqual(@as(?u32, 4), deque.pop());
+    try testing.expectEqual(@as(?u32, 1), deque.steal());
+    try testing.expectEqual(@as(?u32, 3), deque.pop());
+    try testing.expectEqual(@as(?u32, 2), deque.steal());
+    try testing.expectEqual(@as(?u32, null), deque.pop());
+    try testing.expectEqual(@as(?u32, null), deque.steal());
+}
+
+fn steal_all(deque: *StealDeque, taken: []std.atomic.Value(u32)) void {
+    var misses: usize = 0;
+    while (misses < 1000) {
+        const task = deque.steal() orelse {
+            misses += 1;
+            std.Thread.yield() catch {};
+            continue;
+        };
+        _ = taken[task].fetchAdd(1, .monotonic);
+        misses = 0;
+    }
+}
+
+test "every task is taken exactly once" {
+    const task_count = 20000;
+    var deque = try StealDeque.init(testing.allocator, 64);
+    defer deque.deinit(testing.allocator);
+    const taken = try testing.allocator.alloc(std.atomic.Value(u32), task_count);
+    defer testing.allocator.free(taken);
+    for (taken) |*count| {
+        count.* = std.atomic.Value(u32).init(0);
+    }
+
+    var threads: [3]std.Thread = undefined;
+    for (&threads) |*thread| {
+        thread.* = try std.Thread.spawn(.{}, steal_all, .{ &deque, taken });
+    }
+
+    // the owner pops some back in between, racing the thieves for them
+    var next: u32 = 0;
+    while (next < task_count) {
+        deque.push(next) catch {
+            if (deque.pop()) |task| {
+                _ = taken[task].fetchAdd(1, .monotonic);
+            }
+            continue;
+        };
+        next += 1;
+        if (next % 3 == 0) {
+            if (deque.pop()) |task| {
+                _ = taken[task].fetchAdd(1, .monotonic);
+            }
+        }
+    }
+    while (deque.pop()) |task| {
+        _ = taken[task].fetchAdd(1, .monotonic);
+    }
+    for (threads) |thread| {
+        thread.join();
+    }
+
+    for (taken) |*count| {
+        try testing.expectEqual(@as(u32, 1), count.load(.monotonic));
+    }
+}
@@ -10,6 +10,17 @@ pub const SleighContextPair = struct {
     value: u64,
 };
 
+/// A SLEIGH context variable set to `value` over `[start, end)` only, on
+/// top of its default (eg. `TMode` over the Thumb code of an ARM image).
+/// Addresses are relative to the base address of the target like the
+/// regions are.
+pub const SleighContextRegion = struct {
+    variable: []const u8,
+    start: u64,
+    end: u64,
+    value: u64,
+};
+
 /// A container for inputs that SHARD can process.
 ///
 /// Generally an entire program, a dump of a program, or a sequence of
@@ -40,6 +51,7 @@ pub const ShardInputTarget = struct {
     size: u64,
     regions: []const ShardMemoryRegion,
     context_pairs: []SleighContextPair = &.{},
+    context_regions: []SleighContextRegion = &.{},
     sla_path: []const u8 = &.{},
 
     const Self = @This();
@@ -67,6 +79,17 @@ pub const ShardInputTarget = struct {
         return self.context_pairs;
     }
 
+    /// Takes ownership of slice of context regions
+    pub fn setContextRegions(self: *ShardInputTarget, context_regions: []SleighContextRegion) void {
+        self.context_regions = context_regions;
+    }
+
+    /// Getter for the slice of `SleighContextRegion` that are applied over
+    /// the context pairs
+    pub fn getContextRegions(self: *const Self) []SleighContextRegion {
+        return self.context_regions;
+    }
+
     /// Returns the total size of all contained `ShardMemoryRegion`'s'
     pub fn size(self: *const Self) u64 {
         return self.size;
@@ -102,7 +125,7 @@ pub const ShardInputTarget = struct {
             // update maximum
             if (region.base_address > max_base_address) {
                 max_base_address = region.base_address;
-                max_base_address_size = region.data.len;
+                max_base_address_size = region.len();
             }
 
             // update minimum
@@ -153,6 +176,8 @@ pub const ShardInputTarget = struct {
         for (self.regions, 0..) |region, idx| {
             out[idx].base_address = region.base_address + self.base_address;
             out[idx].data = region.data;
+            out[idx].compressed = region.compressed;
+            out[idx].flags = region.flags;
             out[idx].name = region.name;
         }
 
@@ -54,22 +54,41 @@ pub const VarReference = union(enum) {
         // get the enum of valid address spaces
         const var_space = try vn.space_enum();
 
+        return Self.from_space(var_space, vn.offset, vn.size, register_map);
+    }
+
+    /// Same as `VarReference.from_varnode()` except the space is resolved
+    /// through `spaces` instead of comparing the space name
+    pub fn from_compact_varnode(vn: *const sleigh.CompactVarnodeDesc, spaces: *const sleigh.SpaceTable, register_map: *const RegisterMap) !Self {
+        const var_space = try spaces.space_enum(vn);
+
+        // resolved by SLEIGH while lifting, so no lookup is needed
+        if (var_space == .REGISTER and vn.register_id != sleigh.CompactVarnodeDesc.NO_REGISTER) {
+            if (register_map.get(vn.register_id)) |reg| {
+                return VarReference{ .register = reg };
+            }
+        }
+
+        return Self.from_space(var_space, vn.offset, vn.size, register_map);
+    }
+
+    fn from_space(var_space: sleigh.VarnodeSpace, offset: u64, size: u64, register_map: *const RegisterMap) !Self {
         // switch on the address space type
         switch (var_space) {
             .CODE, .DATA, .STACK, .RAM => {
-                return VarReference{ .memory = MemoryReference{ .address = vn.offset, .size = vn.size } };
+                return VarReference{ .memory = MemoryReference{ .address = offset, .size = size } };
             },
             .CONST => {
-                return VarReference{ .constant = ConstReference{ .value = vn.offset, .size = vn.size } };
+                return VarReference{ .constant = ConstReference{ .value = offset, .size = size } };
             },
             .REGISTER => {
-                return VarReference{ .register = register_map.lookup(vn.offset, vn.size) orelse {
-                    std.log.err("[REGISTER IMPL] failed to find offset: `{}`, size: `{}`", .{ vn.offset, vn.size });
+                return VarReference{ .register = register_map.lookup(offset, size) orelse {
+                    std.log.err("[REGISTER IMPL] failed to find offset: `{}`, size: `{}`", .{ offset, size });
                     return ShardError.InvalidRegisterLookup;
                 } };
             },
             .UNIQUE => {
-                return VarReference{ .unique = UniqueReference{ .inner_addr = vn.offset, .size = vn.size } };
+                return VarReference{ .unique = UniqueReference{ .inner_addr = offset, .size = size } };
             },
             else => {
                 logger.warn("Got unsupported VarReference Space: {}", .{var_space});
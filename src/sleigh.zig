@@ -42,9 +42,176 @@
 //!                        uint64_t size,
 //!                        uint8_t *data);
 //! void arbitrary_manager_specfile(ArbitraryManager *mgr, char path[]);
+//! ArbitrarySpec *arbitrary_spec_load(char path[]);
+//! void arbitrary_spec_free(ArbitrarySpec *spec);
+//! void arbitrary_manager_use_spec(ArbitraryManager *mgr, ArbitrarySpec *spec);
+//! LibSlaError arbitrary_spec_pack(char in_path[], char out_path[]);
+//! LibSlaError arbitrary_spec_gen_decoder(char in_path[], char out_path[],
+//!                        char name[]);
+//! void arbitrary_set_aot_decoders(bool enable);
+//! void arbitrary_set_host_floats(bool enable);
+//! const char *arbitrary_manager_aot_decoder(ArbitraryManager *mgr);
+//! LibSlaError arbitrary_file_map(char path[], uint64_t offset, uint64_t size,
+//!                        MappedRegion *out);
+//! void arbitrary_file_unmap(MappedRegion *region);
+//! uint32_t arbitrary_numa_node_count(void);
+//! uint32_t arbitrary_numa_current_node(void);
+//! bool arbitrary_numa_bind_thread(uint32_t node);
+//! void arbitrary_numa_prefer_node(int32_t node);
+//! void arbitrary_numa_interleave(const uint8_t *data, uint64_t size);
+//! void arbitrary_advise_huge_pages(const uint8_t *data, uint64_t size);
+//! uint8_t *arbitrary_huge_page_alloc(uint64_t size);
+//! void arbitrary_huge_page_free(uint8_t *data, uint64_t size);
+//! LibSlaError arbitrary_bfd_open(char path[], ObjectImage *out);
+//! void arbitrary_bfd_close(ObjectImage *image);
+//! void arbitrary_manager_load_section(ArbitraryManager *mgr,
+//!                        uint64_t address,
+//!                        uint64_t size,
+//!                        uint8_t *data,
+//!                        uint32_t flags);
+//! LibSlaError arbitrary_zstd_open(char path[], ZstdHandle **out,
+//!                        uint64_t *size);
+//! LibSlaError arbitrary_manager_patch(ArbitraryManager *mgr,
+//!                        uint64_t address,
+//!                        const uint8_t *bytes,
+//!                        uint64_t size);
+//! const uint8_t *arbitrary_zstd_compressed(ZstdHandle *image, uint64_t *size);
+//! void arbitrary_zstd_cache_stats(ZstdHandle *image, uint64_t *hits,
+//!                        uint64_t *misses);
+//! void arbitrary_zstd_close(ZstdHandle *image);
+//! void arbitrary_manager_load_zstd_region(ArbitraryManager *mgr,
+//!                        uint64_t address,
+//!                        ZstdHandle *image);
+//! LibSlaError arbitrary_allocation_stats(uint64_t *count, uint64_t *bytes);
+//! LibSlaError arbitrary_manager_get_stats(ArbitraryManager *mgr, LiftStats *out);
+//! void arbitrary_manager_reset_stats(ArbitraryManager *mgr);
+//! LibSlaError arbitrary_manager_set_decode_profile(ArbitraryManager *mgr,
+//!                        bool enable);
+//! LibSlaError arbitrary_manager_merge_decode_profile(ArbitraryManager *mgr,
+//!                        ArbitraryManager *other);
+//! LibSlaError arbitrary_manager_decode_profile_report(ArbitraryManager *mgr,
+//!                        const char **out);
+//! LibSlaError arbitrary_manager_context_var_set_region(ArbitraryManager *mgr,
+//!                        char key[],
+//!                        uint64_t start,
+//!                        uint64_t end,
+//!                        uint32_t value);
 //! InsnPcode * arbitrary_manager_next_insn(ArbitraryManager *mgr);
+//! LibSlaError arbitrary_manager_lift_insn(ArbitraryManager *mgr,
+//!                        uint64_t address,
+//!                        InsnDesc **out);
+//! LibSlaError arbitrary_manager_lift_range(ArbitraryManager *mgr,
+//!                        uint64_t start,
+//!                        uint64_t end,
+//!                        LiftedRange *out);
+//! LibSlaError arbitrary_manager_relocate_range(ArbitraryManager *mgr,
+//!                        const LiftedRange *in,
+//!                        uint64_t from,
+//!                        uint64_t to,
+//!                        LiftedRange *out);
+//! void arbitrary_manager_release(LiftedRange *out);
+//! void arbitrary_manager_set_decode_cache(ArbitraryManager *mgr, uint64_t capacity);
+//! void arbitrary_manager_set_pcode_only(ArbitraryManager *mgr, bool enable);
+//! void arbitrary_manager_set_simplify_pcode(ArbitraryManager *mgr, bool enable);
+//! void arbitrary_manager_set_all_offsets(ArbitraryManager *mgr, bool enable);
+//! uint64_t arbitrary_manager_get_alignment(ArbitraryManager *mgr);
+//! LibSlaError arbitrary_manager_spec_memory_usage(ArbitraryManager *mgr,
+//!                        SpecMemoryUsage *out);
+//! void arbitrary_manager_set_insn_intern(ArbitraryManager *mgr, uint64_t capacity);
+//! LibSlaError arbitrary_manager_disasm(ArbitraryManager *mgr, uint64_t address,
+//!                        DisasmText *out);
+//! LibSlaError arbitrary_manager_insn_flow(ArbitraryManager *mgr, uint64_t address,
+//!                        InsnFlow *out);
+//! LibSlaError arbitrary_manager_flow_range(ArbitraryManager *mgr, uint64_t start,
+//!                        uint64_t end, InsnFlow *out, uint64_t capacity,
+//!                        uint64_t *count, uint64_t *end_address);
+//! LibSlaError arbitrary_manager_block_flow(ArbitraryManager *mgr,
+//!                        uint64_t address, uint64_t end, BlockEdge *edges,
+//!                        uint64_t capacity, BlockFlow *out);
+//! LibSlaError arbitrary_manager_set_parser_cache(ArbitraryManager *mgr,
+//!                        uint32_t cache_size,
+//!                        uint32_t window_size);
+//! LibSlaError arbitrary_manager_emulate_set_register(ArbitraryManager *mgr,
+//!                        char name[], uint64_t value);
+//! LibSlaError arbitrary_manager_emulate_get_register(ArbitraryManager *mgr,
+//!                        char name[], uint64_t *out);
+//! LibSlaError arbitrary_manager_emulate_write(ArbitraryManager *mgr,
+//!                        uint64_t address, uint64_t size, uint8_t *data);
+//! LibSlaError arbitrary_manager_emulate_read(ArbitraryManager *mgr,
+//!                        uint64_t address, uint64_t size, uint8_t *out);
+//! LibSlaError arbitrary_manager_emulate_snapshot(ArbitraryManager *mgr);
+//! LibSlaError arbitrary_manager_emulate_restore(ArbitraryManager *mgr);
+//! LibSlaError arbitrary_manager_emulate_clear(ArbitraryManager *mgr);
+//! LibSlaError arbitrary_manager_emulate_run(ArbitraryManager *mgr,
+//!                        uint64_t address,
+//!                        uint64_t max_insns,
+//!                        EmulateResult *out);
+//! LibSlaError arbitrary_manager_emulate_lanes(ArbitraryManager *mgr,
+//!                        uint32_t count);
+//! LibSlaError arbitrary_manager_lane_set_register(ArbitraryManager *mgr,
+//!                        uint32_t lane, char name[], uint64_t value);
+//! LibSlaError arbitrary_manager_lane_get_register(ArbitraryManager *mgr,
+//!                        uint32_t lane, char name[], uint64_t *out);
+//! LibSlaError arbitrary_manager_lane_write(ArbitraryManager *mgr,
+//!                        uint32_t lane, uint64_t address, uint64_t size,
+//!                        uint8_t *data);
+//! LibSlaError arbitrary_manager_lane_read(ArbitraryManager *mgr,
+//!                        uint32_t lane, uint64_t address, uint64_t size,
+//!                        uint8_t *out);
+//! LibSlaError arbitrary_manager_lanes_clear(ArbitraryManager *mgr);
+//! LibSlaError arbitrary_manager_lanes_run(ArbitraryManager *mgr,
+//!                        uint64_t address,
+//!                        uint64_t max_insns,
+//!                        EmulateResult *out);
 //! ```
 //!
+//! Prefer `arbitrary_manager_lift_range` for anything bigger than a handful
+//! of instructions, it writes the instructions, ops, varnodes + text into one
+//! arena that references everything by index and is freed in a single call.
+//! The ops + varnodes are laid out as one array per member (see `LiftedRange`).
+//! Anything that lifts the same addresses over and over should turn on the
+//! decode cache with `arbitrary_manager_set_decode_cache`, repeated lifts of
+//! a cached address skip SLEIGH entirely. Every manager also interns the
+//! instruction encodings (bytes + context) it decodes, so a prologue or
+//! return repeated all over an image is decoded once and relocated to each
+//! address it is at (`arbitrary_manager_set_insn_intern`). Scans that only need the text of a
+//! few instructions can `arbitrary_manager_set_pcode_only` to skip the
+//! disassembler, and `arbitrary_manager_disasm` the ones they keep. Passes
+//! that only need instruction boundaries and control flow decode with
+//! `arbitrary_manager_flow_range`, which builds no p-code at all. Passes
+//! that follow the control flow instead of sweeping decode a basic block at
+//! a time with `arbitrary_manager_block_flow`, which hands back the constant
+//! branch + call targets of its p-code. Scans for
+//! instructions hiding inside of other ones turn on
+//! `arbitrary_manager_set_all_offsets`, and every offset that is a multiple
+//! of `arbitrary_manager_get_alignment` gets an instruction of its own.
+//! Consumers that walk the p-code op by op can
+//! `arbitrary_manager_set_simplify_pcode` to get it with the `unique`
+//! temporaries SLEIGH shuffles values through folded away. Consumers that
+//! only ask which registers an instruction touches, whether it touches
+//! memory and how far it moves the stack pointer read the `effects` of the
+//! range instead, summed up while it was lifted. Bytes that were already
+//! lifted at another address (the same code in another build of an image)
+//! don't have to be decoded again, `arbitrary_manager_relocate_range` moves
+//! the range only fixing up the varnodes that hold an address.
+//!
+//! Mixed mode images (ARM + Thumb, MIPS + MIPS16) set the context variable
+//! picking the mode over the ranges that use it with
+//! `arbitrary_manager_context_var_set_region`, on top of the default, and
+//! every range then lifts in its own mode in one pass.
+//!
+//! The `arbitrary_manager_emulate_*` calls run the p-code of the loaded
+//! regions from a register + memory state, stopping at the first indirect
+//! branch, call or return. Set up the shared state once, snapshot it, then
+//! run + read + restore each candidate: restoring only throws away the pages
+//! the run wrote on top of the snapshot.
+//!
+//! To try one gadget against many states, set up that many lanes with
+//! `arbitrary_manager_emulate_lanes` and fill in each one with the
+//! `arbitrary_manager_lane_*` calls. A single `arbitrary_manager_lanes_run`
+//! then runs all of them in lockstep: every instruction is decoded once, and
+//! every op is evaluated for all the lanes with one batch `OpBehavior` call.
+//!
 //! # Limitations
 //!
 //! - This entire `arbitrary_manager` API needs to be reworked where the bindings
@@ -52,8 +219,16 @@
 //! - Alternatively it could also get reworked into something where the returns
 //! stay as-is and if `null` is returned there is an API call to get the last error.
 //!     - "but wah this isn't going to be nice for concurrent access" - inner brain.
-//!         - my guy this is SLEIGH, concurrency isn't a part of the game, we got
-//!           processes for that.
+//!         - a single manager is still single threaded, for concurrency
+//!           `arbitrary_manager_fork` hands out managers with their own `Sleigh`
+//!           + context that share the loaded bytes and parsed spec, one per thread.
+//!
+//! Decoding a `.sla` is by far the most expensive part of starting up a manager,
+//! `arbitrary_spec_load` decodes it once into a reference counted spec that
+//! every manager attached through `arbitrary_manager_use_spec` (or forked from
+//! one) shares instead of decoding it again. Both it and `arbitrary_manager_specfile`
+//! also take packed specs from `arbitrary_spec_pack` (`zig build pack-sla`), which
+//! are mmapped and skip the XML parser altogether.
 //!
 const std = @import("std");
 const testing = std.testing;
@@ -64,6 +239,8 @@ pub const LOG_SCOPE = .sleigh;
 const logger = std.log.scoped(LOG_SCOPE);
 
 const SleighManager = opaque {};
+const SleighSpecHandle = opaque {};
+const ZstdHandle = opaque {};
 
 /// Automatically generated from source
 ///
@@ -255,6 +432,34 @@ pub const VarnodeSpace = enum {
     const JOIN_CONST = "join";
     const IOP_CONST = "iop";
     const FSPEC_CONST = "fspec";
+
+    /// Translates the name of a SLEIGH space into a Zig enum, `null` if the
+    /// space is not one of the defaults
+    pub fn from_name(name: []const u8) ?VarnodeSpace {
+        if (mem.startsWith(u8, name, REGISTER_CONST)) {
+            return VarnodeSpace.REGISTER;
+        } else if (mem.startsWith(u8, name, CONST_CONST)) {
+            return VarnodeSpace.CONST;
+        } else if (mem.startsWith(u8, name, UNIQUE_CONST)) {
+            return VarnodeSpace.UNIQUE;
+        } else if (mem.startsWith(u8, name, STACK_CONST)) {
+            return VarnodeSpace.STACK;
+        } else if (mem.startsWith(u8, name, RAM_CONST)) {
+            return VarnodeSpace.RAM;
+        } else if (mem.startsWith(u8, name, DATA_CONST)) {
+            return VarnodeSpace.DATA;
+        } else if (mem.startsWith(u8, name, CODE_CONST)) {
+            return VarnodeSpace.CODE;
+        } else if (mem.startsWith(u8, name, JOIN_CONST)) {
+            return VarnodeSpace.JOIN;
+        } else if (mem.startsWith(u8, name, IOP_CONST)) {
+            return VarnodeSpace.IOP;
+        } else if (mem.startsWith(u8, name, FSPEC_CONST)) {
+            return VarnodeSpace.FSPEC;
+        }
+
+        return null;
+    }
 };
 
 /// Zig representation of C-style Varnode in SLEIGH.
@@ -272,30 +477,10 @@ pub const VarnodeDesc = extern struct {
     ///
     /// Once it is an enum its a lot easier to work with.
     pub fn space_enum(self: *const VarnodeDesc) SleighError!VarnodeSpace {
-        if (mem.startsWith(u8, &self.space, VarnodeSpace.REGISTER_CONST)) {
-            return VarnodeSpace.REGISTER;
-        } else if (mem.startsWith(u8, &self.space, VarnodeSpace.CONST_CONST)) {
-            return VarnodeSpace.CONST;
-        } else if (mem.startsWith(u8, &self.space, VarnodeSpace.UNIQUE_CONST)) {
-            return VarnodeSpace.UNIQUE;
-        } else if (mem.startsWith(u8, &self.space, VarnodeSpace.STACK_CONST)) {
-            return VarnodeSpace.STACK;
-        } else if (mem.startsWith(u8, &self.space, VarnodeSpace.RAM_CONST)) {
-            return VarnodeSpace.RAM;
-        } else if (mem.startsWith(u8, &self.space, VarnodeSpace.DATA_CONST)) {
-            return VarnodeSpace.DATA;
-        } else if (mem.startsWith(u8, &self.space, VarnodeSpace.CODE_CONST)) {
-            return VarnodeSpace.CODE;
-        } else if (mem.startsWith(u8, &self.space, VarnodeSpace.JOIN_CONST)) {
-            return VarnodeSpace.JOIN;
-        } else if (mem.startsWith(u8, &self.space, VarnodeSpace.IOP_CONST)) {
-            return VarnodeSpace.IOP;
-        } else if (mem.startsWith(u8, &self.space, VarnodeSpace.FSPEC_CONST)) {
-            return VarnodeSpace.FSPEC;
-        } else {
+        return VarnodeSpace.from_name(&self.space) orelse {
             logger.warn("Unhandled varspace: {s}", .{self.space});
             return SleighError.BadVarSpace;
-        }
+        };
     }
 
     /// Creates a new `VarnodeDesc` from the necessary components
@@ -330,6 +515,103 @@ test "varnode to enum conversion" {
     }
 }
 
+/// Varnode of a `LiftedRange`, one row of its varnode columns.
+///
+/// Instead of the 16 byte space name `space` holds the index of the space,
+/// which gets mapped back to a `VarnodeSpace` with a `SpaceTable`.
+/// `register_id` is the index into `SleighState.get_registers()` of the
+/// register the varnode names, resolved by SLEIGH while lifting.
+pub const CompactVarnodeDesc = struct {
+    offset: u64,
+    size: u32,
+    space: u32,
+    register_id: u32 = NO_REGISTER,
+
+    /// `register_id` of a varnode that doesn't name a register
+    pub const NO_REGISTER: u32 = std.math.maxInt(u32);
+};
+
+/// Why `SleighState.emulate_run()` stopped
+pub const EmulateStop = enum(u32) {
+    /// an indirect branch, call or return, the end of a gadget
+    Branch = 0,
+    /// ran the maximum number of instructions
+    InsnLimit = 1,
+    /// the next instruction doesn't decode or has no p-code
+    BadInsn = 2,
+    /// reached a `CALLOTHER`, which has no semantics to run
+    UserOp = 3,
+    /// an op SLEIGH can't emulate, or an instruction that never finished
+    Fault = 4,
+};
+
+/// Outcome of a single `SleighState.emulate_run()`
+pub const EmulateResult = extern struct {
+    stop: EmulateStop = .InsnLimit,
+    /// instructions started, the one stopped at included unless it didn't decode
+    insn_count: u64 = 0,
+    /// instruction the run stopped at
+    address: u64 = 0,
+    /// destination of the branch for `EmulateStop.Branch`, else 0
+    target: u64 = 0,
+};
+
+/// Name and index of a single SLEIGH address space
+pub const SpaceDesc = extern struct {
+    name: [16]u8,
+    index: u64,
+};
+
+/// C-Style list of every address space, owned by the SLEIGH manager.
+pub const SpaceList = extern struct {
+    space_count: u64,
+    spaces: [*]SpaceDesc,
+
+    pub fn slice(self: *const SpaceList) []const SpaceDesc {
+        return self.spaces[0..self.space_count];
+    }
+};
+
+/// Lookup table of space index into `VarnodeSpace`, built once per spec so
+/// resolving the space of a `CompactVarnodeDesc` is an array index instead
+/// of a string compare.
+pub const SpaceTable = struct {
+    /// `null` for unused indices and non-default spaces
+    kinds: []?VarnodeSpace = &.{},
+    allocator: ?std.mem.Allocator = null,
+
+    const Self = @This();
+
+    pub fn init(list: *const SpaceList, allocator: std.mem.Allocator) !Self {
+        const kinds = try allocator.alloc(?VarnodeSpace, list.space_count);
+        @memset(kinds, null);
+        for (list.slice()) |space| {
+            kinds[space.index] = VarnodeSpace.from_name(&space.name);
+        }
+
+        return Self{ .kinds = kinds, .allocator = allocator };
+    }
+
+    pub fn deinit(self: *Self) void {
+        if (self.allocator) |allocator| {
+            allocator.free(self.kinds);
+        }
+        self.* = undefined;
+    }
+
+    /// Translates the space of `vn` into a Zig enum
+    pub fn space_enum(self: *const Self, vn: *const CompactVarnodeDesc) SleighError!VarnodeSpace {
+        if (vn.space >= self.kinds.len) {
+            return SleighError.BadVarSpace;
+        }
+
+        return self.kinds[vn.space] orelse {
+            logger.warn("Unhandled varspace index: {}", .{vn.space});
+            return SleighError.BadVarSpace;
+        };
+    }
+};
+
 /// Minimal wrapper around C-style struct that represents a P-Code operation.
 ///
 /// This struct retains the list of inputs, the optitonal output, and the
@@ -378,6 +660,323 @@ pub const InsnDesc = extern struct {
     }
 };
 
+/// Assembly of one instruction from `SleighState.disasm()`, borrowed from the
+/// state until its next `disasm()`
+pub const DisasmText = extern struct {
+    size: u64 = 0,
+    insn: [*]const u8 = undefined,
+    insn_len: u64 = 0,
+    body: [*]const u8 = undefined,
+    body_len: u64 = 0,
+
+    /// Copies out `mnemonic body`, the same text `InsnDesc.to_asm()` gives
+    pub fn to_asm(self: *const DisasmText, allocator: std.mem.Allocator) ![]const u8 {
+        return std.fmt.allocPrint(allocator, "{s} {s}", .{ self.insn[0..self.insn_len], self.body[0..self.body_len] });
+    }
+};
+
+/// Length + control flow of one instruction from `SleighState.insn_flow()`,
+/// gathered from the SLEIGH templates without building any p-code
+pub const InsnFlow = extern struct {
+    address: u64 = 0,
+    size: u64 = 0,
+    /// mask of the flags below
+    flow: u64 = 0,
+
+    /// branches (maybe conditionally) out of the instruction
+    pub const BRANCH: u64 = 1;
+    /// has a conditional branch, so it may fall through past its flow
+    pub const CONDITIONAL: u64 = 2;
+    pub const BRANCH_INDIRECT: u64 = 4;
+    pub const CALL: u64 = 8;
+    pub const CALL_INDIRECT: u64 = 16;
+    pub const RETURN: u64 = 32;
+    /// some constructor has no p-code, a lift would fail
+    pub const UNIMPLEMENTED: u64 = 64;
+
+    pub fn has(self: InsnFlow, flags: u64) bool {
+        return (self.flow & flags) != 0;
+    }
+};
+
+/// What `SleighState.flow_range()` decoded
+pub const FlowRange = struct {
+    insns: []InsnFlow,
+    /// first address that wasn't decoded, where to pick back up
+    end_address: u64,
+};
+
+/// How control leaves a basic block along a `BlockEdge`
+pub const BlockEdgeKind = enum(u32) {
+    /// into the instruction right after the block
+    fallthrough = 0,
+    /// a `BRANCH` / `CBRANCH` to a constant address
+    branch = 1,
+    /// a `CALL` of a constant address
+    call = 2,
+    _,
+};
+
+/// Edge out of a basic block from `SleighState.block_flow()`
+pub const BlockEdge = extern struct {
+    target: u64 = 0,
+    kind: BlockEdgeKind = .fallthrough,
+    _pad: u32 = 0,
+};
+
+/// Basic block from `SleighState.block_flow()`, `flow` holds the
+/// `InsnFlow` flags of how its last instruction leaves it, or
+/// `InsnFlow.UNIMPLEMENTED` when the bytes after it don't decode
+pub const BlockFlow = extern struct {
+    start: u64 = 0,
+    /// first address past its last instruction
+    end: u64 = 0,
+    insn_count: u64 = 0,
+    flow: u64 = 0,
+    /// can be more than fit into the edges passed in
+    edge_count: u64 = 0,
+
+    pub fn has(self: BlockFlow, flags: u64) bool {
+        return (self.flow & flags) != 0;
+    }
+};
+
+/// Instruction record inside of a `LiftedRange`, all members index into the
+/// other tables of the owning range instead of pointing at them.
+pub const RangeInsnDesc = extern struct {
+    address: u64,
+    size: u64,
+    op_start: u64,
+    op_count: u64,
+    insn_offset: u64,
+    insn_len: u64,
+    body_offset: u64,
+    body_len: u64,
+};
+
+/// Bitset over the effect slots of a spec (`RegisterList.slot_table()`),
+/// every register that isn't inside of a larger one has a slot of its own
+/// unless the spec has more than `SLOTS` of them, the leftovers
+/// share `EffectSet.OTHER`.
+pub const EffectSet = struct {
+    pub const SLOTS = 256;
+    pub const WORDS = SLOTS / 64;
+    pub const OTHER: u16 = SLOTS - 1;
+
+    pub const Words = [WORDS]u64;
+
+    pub const empty: Words = .{0} ** WORDS;
+
+    pub fn has(words: Words, slot: u16) bool {
+        return (words[slot / 64] >> @intCast(slot % 64)) & 1 != 0;
+    }
+
+    pub fn set(words: *Words, slot: u16) void {
+        words[slot / 64] |= @as(u64, 1) << @intCast(slot % 64);
+    }
+
+    pub fn merge(words: *Words, other: Words) void {
+        for (words, other) |*word, bits| {
+            word.* |= bits;
+        }
+    }
+
+    pub fn intersects(lhs: Words, rhs: Words) bool {
+        for (lhs, rhs) |a, b| {
+            if (a & b != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/// What one instruction of a `LiftedRange` reads, writes and how it ends,
+/// summed up by SLEIGH as the instruction is lifted so a filter doesn't
+/// have to walk its ops.
+pub const InsnEffects = extern struct {
+    /// registers read before the instruction writes them
+    reads: EffectSet.Words,
+    writes: EffectSet.Words,
+    /// how far the stack pointer (`RegisterList.stack_pointer`) moves, or
+    /// `SP_UNKNOWN` if that isn't a constant
+    sp_delta: i64,
+    /// mask of the flags below
+    flags: u32,
+    /// `OpCode` of the last branch, call or return, 0 if there is none
+    terminator: u32,
+
+    pub const SP_UNKNOWN: i64 = std.math.minInt(i64);
+
+    /// Effects of an instruction nothing was summed up for
+    pub const none = InsnEffects{ .reads = EffectSet.empty, .writes = EffectSet.empty, .sp_delta = SP_UNKNOWN, .flags = 0, .terminator = 0 };
+
+    pub const LOAD: u32 = 1;
+    pub const STORE: u32 = 2;
+    /// `BRANCH`, `CBRANCH` or `BRANCHIND`
+    pub const BRANCH: u32 = 4;
+    /// `CALL` or `CALLIND`
+    pub const CALL: u32 = 8;
+    pub const RETURN: u32 = 16;
+    pub const CALLOTHER: u32 = 32;
+    /// any op besides `COPY`, `LOAD`, `STORE` and the ones above
+    pub const COMPUTE: u32 = 64;
+    /// writes (part of) the stack pointer
+    pub const WRITE_SP: u32 = 128;
+
+    pub fn has(self: *const InsnEffects, flags: u32) bool {
+        return (self.flags & flags) != 0;
+    }
+};
+
+/// P-Code operation of a `LiftedRange`, one row of its op columns
+pub const RangePcodeOp = struct {
+    opcode: OpCode,
+    /// index of the output varnode, or `NO_OUTPUT`
+    output: u32,
+    /// index of the first input varnode
+    input_start: u32,
+    input_len: u32,
+
+    /// Value of `output` when the operation has no output varnode
+    pub const NO_OUTPUT = std.math.maxInt(u32);
+};
+
+/// Columns of every P-Code operation in a `LiftedRange`
+pub const RangeOps = std.MultiArrayList(RangePcodeOp).Slice;
+
+/// Columns of every varnode in a `LiftedRange`
+pub const RangeVarnodes = std.MultiArrayList(CompactVarnodeDesc).Slice;
+
+/// Caller-owned arena of every instruction lifted out of an address range.
+///
+/// Everything lives in the single `arena` allocation, the `*_offset` members
+/// are byte offsets to each table. Must be released with
+/// `SleighState.release_range()`.
+///
+/// The ops + varnodes are stored one column per member, and are handed out
+/// as `std.MultiArrayList` slices so a scan over a single member (eg. the
+/// opcodes of an instruction) is a loop over one packed array.
+///
+/// Repeats of an interned encoding share the op + varnode rows (and the
+/// text) of the first one in the range, so `op_count` can be less than the
+/// `op_count`s of the instructions added up.
+///
+/// `effects()` is parallel to `insns()`, see `InsnEffects`.
+///
+/// `insn_relocs_offset` + `vn_relocs_offset` say how every instruction and
+/// varnode moves with its bytes, only `SleighState.relocate_range()` reads
+/// them.
+pub const LiftedRange = extern struct {
+    arena: ?[*]u8 = null,
+    arena_size: u64 = 0,
+    end_address: u64 = 0,
+    insn_count: u64 = 0,
+    insns_offset: u64 = 0,
+    op_count: u64 = 0,
+    op_opcodes_offset: u64 = 0,
+    op_outputs_offset: u64 = 0,
+    op_input_starts_offset: u64 = 0,
+    op_input_lens_offset: u64 = 0,
+    varnode_count: u64 = 0,
+    vn_offsets_offset: u64 = 0,
+    vn_sizes_offset: u64 = 0,
+    vn_spaces_offset: u64 = 0,
+    vn_registers_offset: u64 = 0,
+    text_size: u64 = 0,
+    text_offset: u64 = 0,
+    effects_offset: u64 = 0,
+    insn_relocs_offset: u64 = 0,
+    vn_relocs_offset: u64 = 0,
+
+    const Self = @This();
+
+    /// Reinterpret `count` elements at byte `offset` of the arena as `T`
+    fn table(self: *const Self, comptime T: type, offset: u64, count: u64) []const T {
+        const arena = self.arena orelse return &.{};
+        if (count == 0) {
+            return &.{};
+        }
+
+        const ptr: [*]const T = @ptrCast(@alignCast(arena + offset));
+        return ptr[0..count];
+    }
+
+    /// Builds a `std.MultiArrayList` slice over columns of the arena, the
+    /// `offsets` are in field order of `T`. The slice borrows the arena, so
+    /// it must not be `deinit`'d or outlive the range.
+    fn columns(self: *const Self, comptime T: type, offsets: [std.meta.fields(T).len]u64, count: u64) std.MultiArrayList(T).Slice {
+        const arena = self.arena orelse return .{ .ptrs = undefined, .len = 0, .capacity = 0 };
+
+        var out = std.MultiArrayList(T).Slice{ .ptrs = undefined, .len = count, .capacity = count };
+        for (offsets, 0..) |offset, idx| {
+            out.ptrs[idx] = arena + offset;
+        }
+        return out;
+    }
+
+    /// Get the slice of all the lifted instructions, in address order
+    pub fn insns(self: *const Self) []const RangeInsnDesc {
+        return self.table(RangeInsnDesc, self.insns_offset, self.insn_count);
+    }
+
+    /// Get the effects of every lifted instruction, `effects()[i]` is the one
+    /// of `insns()[i]`
+    pub fn effects(self: *const Self) []const InsnEffects {
+        return self.table(InsnEffects, self.effects_offset, self.insn_count);
+    }
+
+    /// Get the effects of `insn`, which must be one of `insns()`
+    pub fn effects_of(self: *const Self, insn: *const RangeInsnDesc) *const InsnEffects {
+        const idx = (@intFromPtr(insn) - @intFromPtr(self.insns().ptr)) / @sizeOf(RangeInsnDesc);
+        return &self.effects()[idx];
+    }
+
+    /// Get the columns of every P-Code operation in the range, the ops of an
+    /// instruction are `[insn.op_start, insn.op_start + insn.op_count)`
+    pub fn ops(self: *const Self) RangeOps {
+        return self.columns(RangePcodeOp, .{ self.op_opcodes_offset, self.op_outputs_offset, self.op_input_starts_offset, self.op_input_lens_offset }, self.op_count);
+    }
+
+    /// Get the columns of every varnode in the range
+    pub fn varnodes(self: *const Self) RangeVarnodes {
+        return self.columns(CompactVarnodeDesc, .{ self.vn_offsets_offset, self.vn_sizes_offset, self.vn_spaces_offset, self.vn_registers_offset }, self.varnode_count);
+    }
+
+    /// Get the opcodes of the P-Code operations that make up `insn`
+    pub fn opcodes(self: *const Self, insn: *const RangeInsnDesc) []const OpCode {
+        return self.ops().items(.opcode)[insn.op_start..][0..insn.op_count];
+    }
+
+    /// Get the P-Code operation at `index`
+    pub fn op(self: *const Self, index: u64) RangePcodeOp {
+        return self.ops().get(index);
+    }
+
+    /// Get the varnode at `index`
+    pub fn varnode(self: *const Self, index: u64) CompactVarnodeDesc {
+        return self.varnodes().get(index);
+    }
+
+    /// Get the output varnode of `pcode` if it has one
+    pub fn output(self: *const Self, pcode: RangePcodeOp) ?CompactVarnodeDesc {
+        if (pcode.output == RangePcodeOp.NO_OUTPUT) {
+            return null;
+        }
+
+        return self.varnode(pcode.output);
+    }
+
+    /// Return the ascii text for the assembly instruction, caller owned
+    pub fn to_asm(self: *const Self, insn: *const RangeInsnDesc, allocator: std.mem.Allocator) ![]const u8 {
+        const text = self.table(u8, self.text_offset, self.text_size);
+        const mnemonic = text[insn.insn_offset..][0..insn.insn_len];
+        const body = text[insn.body_offset..][0..insn.body_len];
+
+        return std.fmt.allocPrint(allocator, "{s} {s}", .{ mnemonic, body });
+    }
+};
+
 /// Container for Registers.
 ///
 /// Made up of name and backing Varnode. Used as a search key for mapping
@@ -387,16 +986,49 @@ pub const RegisterDesc = extern struct {
     varnode: VarnodeDesc,
 };
 
-/// C-Style list of registers.
+/// C-Style list of registers, owned by the spec.
 ///
-/// Made up of a count and the array of registers.
+/// Made up of a count and the array of registers, ordered by space, offset
+/// and then size descending, along with the lookup SLEIGH resolves the
+/// `register_id` of lifted varnodes with: the ascending offsets of the
+/// registers in the register space, and a table of the first register at
+/// every offset when the register space is small enough. `slots` are the
+/// `EffectSet` slots of the registers, `stack_pointer` the id of the one
+/// `InsnEffects.sp_delta` tracks.
 pub const RegisterList = extern struct {
     register_count: u64,
     registers: [*]RegisterDesc,
+    space_start: u64,
+    space_count: u64,
+    offsets: ?[*]const u64,
+    direct_base: u64,
+    direct_count: u64,
+    direct: ?[*]const u32,
+    slots: ?[*]const u16,
+    stack_pointer: u64,
 
     pub fn slice(self: *const RegisterList) []const RegisterDesc {
         return self.registers[0..self.register_count];
     }
+
+    /// Offsets of the registers `[space_start, space_start + space_count)`
+    pub fn space_offsets(self: *const RegisterList) []const u64 {
+        const offsets = self.offsets orelse return &.{};
+        return offsets[0..self.space_count];
+    }
+
+    /// Id of the first register at `direct_base + idx`, or `NO_REGISTER`.
+    /// Empty if the register space is too sparse to index directly
+    pub fn direct_table(self: *const RegisterList) []const u32 {
+        const direct = self.direct orelse return &.{};
+        return direct[0..self.direct_count];
+    }
+
+    /// `EffectSet` slot of every register, empty if the spec has none
+    pub fn slot_table(self: *const RegisterList) []const u16 {
+        const slots = self.slots orelse return &.{};
+        return slots[0..self.register_count];
+    }
 };
 
 /// List of all user defined operations (`CALLOTHER`).
@@ -426,16 +1058,82 @@ pub const UserOpList = extern struct {
 };
 
 extern fn arbitrary_manager_new() callconv(.C) *SleighManager;
+extern fn arbitrary_manager_fork(parent: *SleighManager) callconv(.C) ?*SleighManager;
 extern fn arbitrary_manager_free(mgr: *SleighManager) callconv(.C) void;
 extern fn arbitrary_manager_load_region(mgr: *SleighManager, address: u64, size: u64, data: [*]const u8) callconv(.C) void;
 /// `path` MUST be a null terminated string
 extern fn arbitrary_manager_specfile(mgr: *SleighManager, path: [*]const u8) callconv(.C) LibSlaError;
+extern fn arbitrary_spec_load(path: [*]const u8) callconv(.C) ?*SleighSpecHandle;
+extern fn arbitrary_spec_free(spec: *SleighSpecHandle) callconv(.C) void;
+extern fn arbitrary_file_map(path: [*]const u8, offset: u64, size: u64, out: *MappedRegion) callconv(.C) LibSlaError;
+extern fn arbitrary_file_unmap(region: *MappedRegion) callconv(.C) void;
+extern fn arbitrary_numa_node_count() callconv(.C) u32;
+extern fn arbitrary_numa_current_node() callconv(.C) u32;
+extern fn arbitrary_numa_bind_thread(node: u32) callconv(.C) bool;
+extern fn arbitrary_numa_prefer_node(node: i32) callconv(.C) void;
+extern fn arbitrary_numa_interleave(data: [*]const u8, size: u64) callconv(.C) void;
+extern fn arbitrary_advise_huge_pages(data: [*]const u8, size: u64) callconv(.C) void;
+extern fn arbitrary_huge_page_alloc(size: u64) callconv(.C) ?[*]u8;
+extern fn arbitrary_huge_page_free(data: [*]u8, size: u64) callconv(.C) void;
+extern fn arbitrary_bfd_open(path: [*]const u8, out: *ObjectImage) callconv(.C) LibSlaError;
+extern fn arbitrary_bfd_close(image: *ObjectImage) callconv(.C) void;
+extern fn arbitrary_manager_load_section(mgr: *SleighManager, address: u64, size: u64, data: [*]const u8, flags: u32) callconv(.C) void;
+extern fn arbitrary_zstd_open(path: [*]const u8, out: *?*ZstdHandle, size: *u64) callconv(.C) LibSlaError;
+extern fn arbitrary_zstd_compressed(image: *ZstdHandle, size: *u64) callconv(.C) [*]const u8;
+extern fn arbitrary_zstd_cache_stats(image: *ZstdHandle, hits: *u64, misses: *u64) callconv(.C) void;
+extern fn arbitrary_zstd_close(image: *ZstdHandle) callconv(.C) void;
+extern fn arbitrary_manager_load_zstd_region(mgr: *SleighManager, address: u64, image: *ZstdHandle) callconv(.C) void;
+extern fn arbitrary_manager_relocate_range(mgr: *SleighManager, in: *const LiftedRange, from: u64, to: u64, out: *LiftedRange) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_patch(mgr: *SleighManager, address: u64, bytes: [*]const u8, size: u64) callconv(.C) LibSlaError;
+extern fn arbitrary_allocation_stats(count: *u64, bytes: *u64) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_get_stats(mgr: *SleighManager, out: *LiftStats) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_reset_stats(mgr: *SleighManager) callconv(.C) void;
+extern fn arbitrary_manager_set_decode_profile(mgr: *SleighManager, enable: bool) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_merge_decode_profile(mgr: *SleighManager, other: *SleighManager) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_decode_profile_report(mgr: *SleighManager, out: *?[*:0]const u8) callconv(.C) LibSlaError;
+extern fn arbitrary_spec_pack(in_path: [*]const u8, out_path: [*]const u8) callconv(.C) LibSlaError;
+extern fn arbitrary_spec_gen_decoder(in_path: [*]const u8, out_path: [*]const u8, name: [*]const u8) callconv(.C) LibSlaError;
+extern fn arbitrary_set_aot_decoders(enable: bool) callconv(.C) void;
+extern fn arbitrary_set_host_floats(enable: bool) callconv(.C) void;
+extern fn arbitrary_manager_aot_decoder(mgr: *SleighManager) callconv(.C) ?[*:0]const u8;
+extern fn arbitrary_manager_use_spec(mgr: *SleighManager, spec: *SleighSpecHandle) callconv(.C) void;
 extern fn arbitrary_manager_begin(mgr: *SleighManager) callconv(.C) void;
 extern fn arbitrary_manager_next_insn(mgr: *SleighManager) callconv(.C) *InsnDesc;
-extern fn arbitrary_manager_lift_insn(mgr: *SleighManager, address: u64) callconv(.C) ?*InsnDesc;
+extern fn arbitrary_manager_lift_insn(mgr: *SleighManager, address: u64, out: *?*InsnDesc) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_lift_range(mgr: *SleighManager, start: u64, end: u64, out: *LiftedRange) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_release(out: *LiftedRange) callconv(.C) void;
+extern fn arbitrary_manager_set_decode_cache(mgr: *SleighManager, capacity: u64) callconv(.C) void;
+extern fn arbitrary_manager_set_pcode_only(mgr: *SleighManager, enable: bool) callconv(.C) void;
+extern fn arbitrary_manager_set_simplify_pcode(mgr: *SleighManager, enable: bool) callconv(.C) void;
+extern fn arbitrary_manager_set_all_offsets(mgr: *SleighManager, enable: bool) callconv(.C) void;
+extern fn arbitrary_manager_get_alignment(mgr: *SleighManager) callconv(.C) u64;
+extern fn arbitrary_manager_spec_memory_usage(mgr: *SleighManager, out: *SpecMemoryUsage) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_set_insn_intern(mgr: *SleighManager, capacity: u64) callconv(.C) void;
+extern fn arbitrary_manager_disasm(mgr: *SleighManager, address: u64, out: *DisasmText) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_insn_flow(mgr: *SleighManager, address: u64, out: *InsnFlow) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_block_flow(mgr: *SleighManager, address: u64, end: u64, edges: [*]BlockEdge, capacity: u64, out: *BlockFlow) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_flow_range(mgr: *SleighManager, start: u64, end: u64, out: [*]InsnFlow, capacity: u64, count: *u64, end_address: *u64) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_set_parser_cache(mgr: *SleighManager, cache_size: u32, window_size: u32) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_emulate_set_register(mgr: *SleighManager, name: [*:0]const u8, value: u64) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_emulate_get_register(mgr: *SleighManager, name: [*:0]const u8, out: *u64) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_emulate_write(mgr: *SleighManager, address: u64, size: u64, data: [*]const u8) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_emulate_read(mgr: *SleighManager, address: u64, size: u64, out: [*]u8) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_emulate_snapshot(mgr: *SleighManager) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_emulate_restore(mgr: *SleighManager) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_emulate_clear(mgr: *SleighManager) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_emulate_run(mgr: *SleighManager, address: u64, max_insns: u64, out: *EmulateResult) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_emulate_lanes(mgr: *SleighManager, count: u32) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_lane_set_register(mgr: *SleighManager, lane: u32, name: [*:0]const u8, value: u64) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_lane_get_register(mgr: *SleighManager, lane: u32, name: [*:0]const u8, out: *u64) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_lane_write(mgr: *SleighManager, lane: u32, address: u64, size: u64, data: [*]const u8) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_lane_read(mgr: *SleighManager, lane: u32, address: u64, size: u64, out: [*]u8) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_lanes_clear(mgr: *SleighManager) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_lanes_run(mgr: *SleighManager, address: u64, max_insns: u64, out: [*]EmulateResult) callconv(.C) LibSlaError;
 extern fn arbitrary_manager_context_var_set_default(mgr: *SleighManager, context_key: [*]const u8, value: u32) callconv(.C) LibSlaError;
+extern fn arbitrary_manager_context_var_set_region(mgr: *SleighManager, context_key: [*]const u8, start: u64, end: u64, value: u32) callconv(.C) LibSlaError;
 extern fn arbitrary_manager_get_all_registers(mgr: *SleighManager) callconv(.C) *RegisterList;
 extern fn arbitrary_manager_get_user_ops(mgr: *SleighManager) callconv(.C) *UserOpList;
+extern fn arbitrary_manager_get_spaces(mgr: *SleighManager) callconv(.C) *SpaceList;
 
 /// Zig error type for errors encountered in SLEIGH
 pub const SleighError = error{
@@ -507,111 +1205,1011 @@ test "libsla error to SleighError" {
     }
 }
 
-/// Wrapper over the SLEIGH engine. In general this is the lowest level wrapper
-/// in `Zig` over an added C ffi layer.
-pub const SleighState = struct {
-    mgr: *SleighManager,
-    began: bool = false,
+/// Copy-on-write mapping of part of a file, the bytes come straight out of
+/// the page cache so a mapped image can be loaded into SLEIGH without ever
+/// being read into (or copied on) the heap
+pub const MappedRegion = extern struct {
+    data: ?[*]u8 = null,
+    size: u64 = 0,
+    file: ?*anyopaque = null,
 
     const Self = @This();
 
-    /// Constructor
-    pub fn init() Self {
-        logger.debug("Initializing SLEIGH", .{});
-        const inner_manager = arbitrary_manager_new();
+    /// Maps `size` bytes at `offset` of the file at `path`, a `size` of 0
+    /// maps up to the end of the file
+    pub fn map(path: []const u8, offset: u64, size: u64) SleighError!Self {
+        var out = Self{};
+        var result = arbitrary_file_map(path.ptr, offset, size, &out);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
 
-        return Self{ .mgr = inner_manager };
+        return out;
     }
 
-    /// Destroys the inner SLEIGH handle
-    ///
-    /// TODO: add a reset method
-    pub fn deinit(self: *SleighState) void {
-        arbitrary_manager_free(self.mgr);
-        logger.debug("De-init SLEIGH", .{});
-        self.mgr = undefined;
-        self.* = undefined;
+    /// The mapped bytes, writes stay private to this process
+    pub fn slice(self: *const Self) []u8 {
+        const data = self.data orelse return &.{};
+        return data[0..self.size];
     }
 
-    /// Initialize the inner `SLEIGH` instance with the specific architecture flavor
-    /// we want to decode and lift from
-    pub fn add_specfile(self: *SleighState, path: []const u8) SleighError!void {
-        logger.debug("Adding specfile `{s}`", .{path});
+    /// Unmaps the file, the bytes can't still be loaded in any `SleighState`
+    pub fn unmap(self: *Self) void {
+        arbitrary_file_unmap(self);
+    }
+};
 
-        var result = arbitrary_manager_specfile(self.mgr, path.ptr);
-        if (result.isError()) {
-            return result.asSleighError();
-        }
+/// Where threads run + where their memory is placed on a machine with more
+/// than one NUMA node, see `deps/sleigh/numa_placement.hh`. Nodes are
+/// numbered `0..node_count()`. Everything is best effort, with one node only
+/// `node_count` + `current_node` mean anything.
+pub const Numa = struct {
+    /// Nodes with CPUs, at least 1
+    pub fn node_count() u32 {
+        return arbitrary_numa_node_count();
     }
 
-    /// Puts array of `u8` into SLEIGH memory
-    pub fn load_data(self: *SleighState, address: u64, data: []const u8) SleighError!void {
-        if (!self.began) {
-            return SleighError.CallBeginFirst;
-        }
+    /// Node of the CPU the calling thread runs on right now
+    pub fn current_node() u32 {
+        return arbitrary_numa_current_node();
+    }
 
-        //logger.debug("Adding data{{size: 0x{x:0>8}, address: 0x{x:0>8}}}", .{ data.len, address });
-        arbitrary_manager_load_region(self.mgr, address, data.len, data.ptr);
+    /// Runs the calling thread only on the CPUs of `node` from now on, false
+    /// if it couldn't be pinned
+    pub fn bind_thread(node: u32) bool {
+        return arbitrary_numa_bind_thread(node);
     }
 
-    /// Actually start the SLEIGH instance
-    ///
-    /// This must be called AFTER loading the sla file but BEFORE loading the
-    /// proper context  variables (.pspec) and binary data or lifting insns
-    pub fn begin(self: *SleighState) void {
-        arbitrary_manager_begin(self.mgr);
-        self.began = true;
+    /// Puts the pages the calling thread touches first on `node` from now
+    /// on, `null` goes back to its own node
+    pub fn prefer_node(node: ?u32) void {
+        arbitrary_numa_prefer_node(if (node) |n| @intCast(n) else -1);
     }
 
-    /// Set a `SLEIGH` instance global default context variable
-    ///
-    /// These are different for each architecture and sub-family
-    /// TODO: make a getter for all the context variables
-    pub fn context_var_set_default(self: *SleighState, key: []const u8, value: u32) SleighError!void {
-        //logger.debug("Setting context var `{s}` default to `{}`", .{ key, value });
-        if (!self.began) {
-            return SleighError.CallBeginFirst;
-        }
+    /// Spreads the whole pages of `data` evenly over every node, for buffers
+    /// every thread reads
+    pub fn interleave(data: []const u8) void {
+        arbitrary_numa_interleave(data.ptr, data.len);
+    }
 
-        var result = arbitrary_manager_context_var_set_default(self.mgr, key.ptr, value);
-        if (result.isError()) {
-            return result.asSleighError();
-        }
+    /// Asks for the huge page aligned part of `data` to be backed by
+    /// transparent huge pages
+    pub fn advise_huge_pages(data: []const u8) void {
+        arbitrary_advise_huge_pages(data.ptr, data.len);
     }
+};
 
-    /// *WARNING*: Deprecated, use `SleighState::lift_insn()` instead
-    pub fn next_insn(self: *SleighState) SleighError!*InsnDesc {
-        if (!self.began) {
-            return SleighError.CallBeginFirst;
-        }
+/// Size of a transparent huge page on x86-64 + 4K page AArch64
+pub const HUGE_PAGE_SIZE: usize = 2 * 1024 * 1024;
 
-        return arbitrary_manager_next_insn(self.mgr);
+/// Backs every allocation of at least `HUGE_PAGE_SIZE` with its own huge page
+/// aligned mapping, advised for transparent huge pages, so big arenas take a
+/// TLB entry per 2MB rather than per 4K. Smaller ones come from
+/// `std.heap.page_allocator`.
+pub const huge_page_allocator = std.mem.Allocator{
+    .ptr = undefined,
+    .vtable = &HugePageAllocator.vtable,
+};
+
+const HugePageAllocator = struct {
+    const vtable = std.mem.Allocator.VTable{
+        .alloc = alloc,
+        .resize = resize,
+        .free = free,
+    };
+
+    fn round(len: usize) usize {
+        return mem.alignForward(usize, len, HUGE_PAGE_SIZE);
     }
 
-    /// Lift instruction at `address` into an `InsnDesc` to be processed
-    ///
-    /// TODO: handle the `SleighError.UnableToLift` case
-    pub fn lift_insn(self: *SleighState, address: u64) SleighError!?*InsnDesc {
-        //logger.debug("Getting insn @ 0x{x}", .{address});
-        if (!self.began) {
-            return SleighError.CallBeginFirst;
+    fn alloc(_: *anyopaque, len: usize, ptr_align: u8, ret_addr: usize) ?[*]u8 {
+        if (len < HUGE_PAGE_SIZE) {
+            return std.heap.page_allocator.rawAlloc(len, ptr_align, ret_addr);
         }
-
-        return arbitrary_manager_lift_insn(self.mgr, address);
+        if (ptr_align > @ctz(HUGE_PAGE_SIZE)) {
+            return null;
+        }
+        return arbitrary_huge_page_alloc(len);
     }
 
-    /// Get the entire list of registers for the current architecture
-    pub fn get_registers(self: *SleighState) SleighError!*RegisterList {
-        //logger.debug("Getting register list", .{});
-        if (!self.began) {
-            return SleighError.CallBeginFirst;
+    fn resize(_: *anyopaque, buf: []u8, buf_align: u8, new_len: usize, ret_addr: usize) bool {
+        if (buf.len < HUGE_PAGE_SIZE) {
+            // growing past it would have to move to a huge mapping
+            return new_len < HUGE_PAGE_SIZE and
+                std.heap.page_allocator.rawResize(buf, buf_align, new_len, ret_addr);
         }
+        // in place only while it still needs the same huge pages
+        return new_len >= HUGE_PAGE_SIZE and round(new_len) == round(buf.len);
+    }
 
-        return arbitrary_manager_get_all_registers(self.mgr);
+    fn free(_: *anyopaque, buf: []u8, buf_align: u8, ret_addr: usize) void {
+        if (buf.len < HUGE_PAGE_SIZE) {
+            std.heap.page_allocator.rawFree(buf, buf_align, ret_addr);
+        } else {
+            arbitrary_huge_page_free(buf.ptr, buf.len);
+        }
     }
+};
 
-    /// Get entire list of user-defined operations aka `CALLOTHER` ops
-    ///
+/// `ghidra::LoadImageSection` flags of a section
+pub const SectionFlags = struct {
+    pub const UNALLOC: u32 = 1;
+    pub const NOLOAD: u32 = 2;
+    pub const CODE: u32 = 4;
+    pub const DATA: u32 = 8;
+    pub const READONLY: u32 = 16;
+};
+
+/// An allocated section of an `ObjectImage`
+pub const ObjectSection = extern struct {
+    name: [*:0]const u8,
+    address: u64,
+    size: u64,
+    /// `SectionFlags` mask
+    flags: u32,
+    /// into the mapped file, `null` for sections without bytes in the file
+    data: ?[*]u8,
+
+    const Self = @This();
+
+    pub fn get_name(self: *const Self) []const u8 {
+        return std.mem.span(self.name);
+    }
+
+    /// The bytes of the section, `null` if it has none in the file
+    pub fn slice(self: *const Self) ?[]u8 {
+        const data = self.data orelse return null;
+        return data[0..self.size];
+    }
+};
+
+/// An object file (ELF, COFF, ...) read through BFD, the bytes of its
+/// sections are mapped straight out of the file
+pub const ObjectImage = extern struct {
+    section_count: u64 = 0,
+    sections: ?[*]ObjectSection = null,
+    entry: u64 = 0,
+    arch: ?[*:0]const u8 = null,
+    image: ?*anyopaque = null,
+
+    const Self = @This();
+
+    /// Maps the object file at `path`, fails if BFD doesn't recognize it
+    pub fn open(path: []const u8) SleighError!Self {
+        var out = Self{};
+        var result = arbitrary_bfd_open(path.ptr, &out);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+
+        return out;
+    }
+
+    /// Every allocated section, in the order of the section table
+    pub fn slice(self: *const Self) []const ObjectSection {
+        const sections = self.sections orelse return &.{};
+        return sections[0..self.section_count];
+    }
+
+    /// Unmaps the file, none of its sections can still be loaded in any
+    /// `SleighState`
+    pub fn close(self: *Self) void {
+        arbitrary_bfd_close(self);
+    }
+};
+
+/// A zstd file of independent frames (see `deps/sleigh/zstd_image.hh`),
+/// loading it into a `SleighState` only decompresses the frames SLEIGH
+/// reads, a couple dozen at a time, instead of the whole image
+pub const ZstdImage = struct {
+    handle: *ZstdHandle,
+    /// decompressed size of the image
+    size: u64,
+
+    const Self = @This();
+
+    /// First bytes of every zstd frame
+    pub const MAGIC = [_]u8{ 0x28, 0xb5, 0x2f, 0xfd };
+
+    /// Maps + indexes the zstd file at `path`, fails if any of its frames
+    /// doesn't record its decompressed size
+    pub fn open(path: []const u8) SleighError!Self {
+        var handle: ?*ZstdHandle = null;
+        var size: u64 = 0;
+        var result = arbitrary_zstd_open(path.ptr, &handle, &size);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+
+        return Self{ .handle = handle.?, .size = size };
+    }
+
+    /// true if `data` starts with a zstd frame
+    pub fn detect(data: []const u8) bool {
+        return data.len >= MAGIC.len and std.mem.eql(u8, data[0..MAGIC.len], &MAGIC);
+    }
+
+    /// The compressed file, as mapped
+    pub fn compressed(self: *const Self) []const u8 {
+        var size: u64 = 0;
+        const data = arbitrary_zstd_compressed(self.handle, &size);
+        return data[0..size];
+    }
+
+    /// Reads that found their frame already decompressed, and that had to
+    /// decompress it
+    pub fn cache_stats(self: *const Self) struct { hits: u64, misses: u64 } {
+        var hits: u64 = 0;
+        var misses: u64 = 0;
+        arbitrary_zstd_cache_stats(self.handle, &hits, &misses);
+        return .{ .hits = hits, .misses = misses };
+    }
+
+    /// Drops this reference to the image, `SleighState`s it was loaded
+    /// into keep their own
+    pub fn close(self: *Self) void {
+        arbitrary_zstd_close(self.handle);
+    }
+};
+
+/// Heap allocations libsla has made since it was loaded
+pub const AllocationStats = struct {
+    count: u64 = 0,
+    bytes: u64 = 0,
+
+    /// The allocations so far, `null` unless libsla was built with
+    /// `-DLIBSLA_COUNT_ALLOCATIONS` (only `zig build bench` is)
+    pub fn read() ?AllocationStats {
+        var out = AllocationStats{};
+        var result = arbitrary_allocation_stats(&out.count, &out.bytes);
+        if (result.isError()) {
+            return null;
+        }
+
+        return out;
+    }
+};
+
+/// Hot path counters + cycle timers of one `SleighState`, see
+/// `deps/sleigh/lift_stats.hh`. Everything but `allocation_*` stays 0 unless
+/// libsla was built with `-DLIBSLA_STATS` (`zig build -Dstats`), which
+/// `enabled` tells. `print_assembly` + `one_instruction` include the
+/// `load_fill`s they trigger.
+pub const LiftStats = extern struct {
+    enabled: u64 = 0,
+    load_fill_calls: u64 = 0,
+    load_fill_cycles: u64 = 0,
+    print_assembly_calls: u64 = 0,
+    print_assembly_cycles: u64 = 0,
+    one_instruction_calls: u64 = 0,
+    one_instruction_cycles: u64 = 0,
+    /// `BadDataError`s + `UnimplError`s thrown while decoding
+    decode_errors: u64 = 0,
+    parser_cache_hits: u64 = 0,
+    parser_cache_misses: u64 = 0,
+    context_cache_hits: u64 = 0,
+    context_cache_misses: u64 = 0,
+    decode_cache_hits: u64 = 0,
+    decode_cache_misses: u64 = 0,
+    /// encodings found in / decoded into the intern table
+    intern_hits: u64 = 0,
+    intern_misses: u64 = 0,
+    /// process wide, only with `-DLIBSLA_COUNT_ALLOCATIONS`
+    allocation_count: u64 = 0,
+    allocation_bytes: u64 = 0,
+
+    /// Adds every counter of `other` into `self`, for totals across forks.
+    /// The allocations are process wide already so the larger one is kept.
+    pub fn add(self: *LiftStats, other: LiftStats) void {
+        inline for (std.meta.fields(LiftStats)) |field| {
+            if (comptime (mem.eql(u8, field.name, "enabled") or mem.startsWith(u8, field.name, "allocation_"))) {
+                @field(self, field.name) = @max(@field(self, field.name), @field(other, field.name));
+            } else {
+                @field(self, field.name) += @field(other, field.name);
+            }
+        }
+    }
+};
+
+/// What the decoded spec of a `SleighState` holds, see
+/// `SleighState.spec_memory_usage()`. Forks and every state attached to the
+/// same `SleighSpec` share one copy of it, `references` counts them.
+pub const SpecMemoryUsage = extern struct {
+    symbol_count: u64 = 0,
+    constructor_count: u64 = 0,
+    op_template_count: u64 = 0,
+    /// outputs + inputs of every op template
+    varnode_template_refs: u64 = 0,
+    /// distinct varnode templates kept for them, identical ones are interned
+    varnode_template_count: u64 = 0,
+    /// characters of every symbol name
+    name_bytes: u64 = 0,
+    /// bytes of p-code templates, and the bytes of the arena they live in
+    template_bytes: u64 = 0,
+    template_capacity: u64 = 0,
+    references: u64 = 0,
+};
+
+/// A decoded `.sla` spec that any number of `SleighState`'s can share through
+/// `SleighState.use_spec()`, each `SleighState` keeps the spec alive for as
+/// long as it needs it so this can be `deinit`'ed right after attaching.
+pub const SleighSpec = struct {
+    handle: *SleighSpecHandle,
+
+    const Self = @This();
+
+    /// Converts the `.sla` at `in_path` into a packed spec at `out_path`,
+    /// which loads a good deal faster than the XML it came from
+    pub fn pack(in_path: []const u8, out_path: []const u8) SleighError!void {
+        logger.debug("Packing spec `{s}` into `{s}`", .{ in_path, out_path });
+
+        var result = arbitrary_spec_pack(in_path.ptr, out_path.ptr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Writes C++ source of a decoder for the spec at `in_path` to
+    /// `out_path`, every decision tree of it compiled to `switch`es. A
+    /// binary the source is compiled into resolves that spec through it,
+    /// see `zig build -Daot`.
+    pub fn gen_decoder(in_path: []const u8, out_path: []const u8, name: []const u8) SleighError!void {
+        logger.debug("Generating the decoder of `{s}` into `{s}`", .{ in_path, out_path });
+
+        const result = arbitrary_spec_gen_decoder(in_path.ptr, out_path.ptr, name.ptr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Whether specs loaded from now on resolve through the decoders
+    /// compiled in ahead of time (the default), or their decision tables
+    pub fn set_aot_decoders(enable: bool) void {
+        arbitrary_set_aot_decoders(enable);
+    }
+
+    /// Whether specs loaded from now on evaluate float ops of binary32 +
+    /// binary64 formats by reinterpreting the bits as host floats (the
+    /// default), or through the generic field by field conversions. The
+    /// results are the same either way, up to the sign of NaNs the ops
+    /// produce.
+    pub fn set_host_floats(enable: bool) void {
+        arbitrary_set_host_floats(enable);
+    }
+
+    /// Reads and decodes the spec at `path`, either a `.sla` or a
+    /// packed spec from `SleighSpec.pack()`
+    pub fn load(path: []const u8) SleighError!Self {
+        logger.debug("Loading spec `{s}`", .{path});
+
+        const handle = arbitrary_spec_load(path.ptr) orelse return SleighError.InvalidSlaspec;
+        return Self{ .handle = handle };
+    }
+
+    /// Drops this reference to the spec
+    pub fn deinit(self: *Self) void {
+        arbitrary_spec_free(self.handle);
+        self.* = undefined;
+    }
+};
+
+/// Wrapper over the SLEIGH engine. In general this is the lowest level wrapper
+/// in `Zig` over an added C ffi layer.
+pub const SleighState = struct {
+    mgr: *SleighManager,
+    began: bool = false,
+    // set by `emulate_lanes`, lanes aren't shared with forks
+    lane_count: u32 = 0,
+
+    const Self = @This();
+
+    /// Constructor
+    pub fn init() Self {
+        logger.debug("Initializing SLEIGH", .{});
+        const inner_manager = arbitrary_manager_new();
+
+        return Self{ .mgr = inner_manager };
+    }
+
+    /// Creates a new handle that shares the loaded data, spec and context
+    /// defaults of `self`, but can lift on a different thread than `self`.
+    ///
+    /// Don't load any more data into either handle after forking.
+    pub fn fork(self: *SleighState) SleighError!Self {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        const inner_manager = arbitrary_manager_fork(self.mgr) orelse return SleighError.Fail;
+        return Self{ .mgr = inner_manager, .began = true };
+    }
+
+    /// Destroys the inner SLEIGH handle
+    ///
+    /// TODO: add a reset method
+    pub fn deinit(self: *SleighState) void {
+        arbitrary_manager_free(self.mgr);
+        logger.debug("De-init SLEIGH", .{});
+        self.mgr = undefined;
+        self.* = undefined;
+    }
+
+    /// Initialize the inner `SLEIGH` instance with the specific architecture flavor
+    /// we want to decode and lift from
+    pub fn add_specfile(self: *SleighState, path: []const u8) SleighError!void {
+        logger.debug("Adding specfile `{s}`", .{path});
+
+        var result = arbitrary_manager_specfile(self.mgr, path.ptr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Lift with the already decoded `spec` instead of calling
+    /// `SleighState.add_specfile()`, must be called before `SleighState.begin()`
+    pub fn use_spec(self: *SleighState, spec: *const SleighSpec) void {
+        arbitrary_manager_use_spec(self.mgr, spec.handle);
+    }
+
+    /// Puts array of `u8` into SLEIGH memory
+    pub fn load_data(self: *SleighState, address: u64, data: []const u8) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        //logger.debug("Adding data{{size: 0x{x:0>8}, address: 0x{x:0>8}}}", .{ data.len, address });
+        arbitrary_manager_load_region(self.mgr, address, data.len, data.ptr);
+    }
+
+    /// Same as `load_data()` for a section with `flags` (`SectionFlags`),
+    /// which SLEIGH's section walk + read-only ranges then report
+    pub fn load_section(self: *SleighState, address: u64, data: []const u8, flags: u32) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        arbitrary_manager_load_section(self.mgr, address, data.len, data.ptr, flags);
+    }
+
+    /// Same as `load_data()` with the decompressed bytes of `image`, which
+    /// are only decompressed once they are read
+    pub fn load_zstd_data(self: *SleighState, address: u64, image: *const ZstdImage) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        arbitrary_manager_load_zstd_region(self.mgr, address, image.handle);
+    }
+
+    /// Overwrites the bytes at `address` with a copy of `bytes`. Only the
+    /// cached decodes that read one of them are dropped, so lifting again
+    /// only decodes the patched instructions again.
+    ///
+    /// The bytes are shared with the forks of `self` (and the handle it was
+    /// forked off of), so this is `SleighError.Fail` until every one of
+    /// them is `deinit()`ed. Fork again after patching.
+    pub fn patch(self: *SleighState, address: u64, bytes: []const u8) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_patch(self.mgr, address, bytes.ptr, bytes.len);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Actually start the SLEIGH instance
+    ///
+    /// This must be called AFTER loading the sla file but BEFORE loading the
+    /// proper context  variables (.pspec) and binary data or lifting insns
+    pub fn begin(self: *SleighState) void {
+        arbitrary_manager_begin(self.mgr);
+        self.began = true;
+    }
+
+    /// Set a `SLEIGH` instance global default context variable
+    ///
+    /// These are different for each architecture and sub-family
+    /// TODO: make a getter for all the context variables
+    pub fn context_var_set_default(self: *SleighState, key: []const u8, value: u32) SleighError!void {
+        //logger.debug("Setting context var `{s}` default to `{}`", .{ key, value });
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_context_var_set_default(self.mgr, key.ptr, value);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Set a context variable to `value` over `[start, end)` only, on top of
+    /// its default (eg. `TMode` over the Thumb functions of an ARM image).
+    /// `key` must be null terminated like for
+    /// `SleighState.context_var_set_default()`, forks keep the region.
+    pub fn context_var_set_region(self: *SleighState, key: []const u8, start: u64, end: u64, value: u32) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        const result = arbitrary_manager_context_var_set_region(self.mgr, key.ptr, start, end, value);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// *WARNING*: Deprecated, use `SleighState::lift_insn()` instead
+    pub fn next_insn(self: *SleighState) SleighError!*InsnDesc {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        return arbitrary_manager_next_insn(self.mgr);
+    }
+
+    /// Lift instruction at `address` into an `InsnDesc` to be processed,
+    /// `null` if nothing decodes there and `SleighError.Fail` when out of
+    /// memory
+    ///
+    /// TODO: handle the `SleighError.UnableToLift` case
+    pub fn lift_insn(self: *SleighState, address: u64) SleighError!?*InsnDesc {
+        //logger.debug("Getting insn @ 0x{x}", .{address});
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var out: ?*InsnDesc = null;
+        var result = arbitrary_manager_lift_insn(self.mgr, address, &out);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+
+        return out;
+    }
+
+    /// Keep up to `capacity` decoded instructions around so lifting the same
+    /// address again is a lookup, `0` (the default) disables the cache.
+    /// Loading data or setting a context variable empties it.
+    pub fn set_decode_cache(self: *SleighState, capacity: u64) void {
+        arbitrary_manager_set_decode_cache(self.mgr, capacity);
+    }
+
+    /// Intern up to `capacity` distinct instruction encodings, each is
+    /// decoded once and relocated to every address it repeats at. `0`
+    /// disables it, the default is 65536. Forks keep the capacity.
+    pub fn set_insn_intern(self: *SleighState, capacity: u64) void {
+        arbitrary_manager_set_insn_intern(self.mgr, capacity);
+    }
+
+    /// What this state counted since it was created or last `reset_stats`'ed,
+    /// see `LiftStats`
+    pub fn get_stats(self: *const SleighState) LiftStats {
+        var out = LiftStats{};
+        _ = arbitrary_manager_get_stats(self.mgr, &out);
+        return out;
+    }
+
+    pub fn reset_stats(self: *SleighState) void {
+        arbitrary_manager_reset_stats(self.mgr);
+    }
+
+    /// Profile which subtables + constructors of the spec decoding spends
+    /// its cycles in while `enable`d, enabling drops what was counted so
+    /// far. Forks made while it is on profile too. `SleighError.Fail`
+    /// unless libsla was built with `-Dstats`.
+    pub fn set_decode_profile(self: *SleighState, enable: bool) SleighError!void {
+        const result = arbitrary_manager_set_decode_profile(self.mgr, enable);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Add what the fork `other` profiled to this state's profile
+    pub fn merge_decode_profile(self: *SleighState, other: *const SleighState) SleighError!void {
+        const result = arbitrary_manager_merge_decode_profile(self.mgr, other.mgr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// The decode profile as text tables, `null` when not profiling. Only
+    /// valid until the next call.
+    pub fn decode_profile_report(self: *SleighState) ?[]const u8 {
+        var out: ?[*:0]const u8 = null;
+        if (arbitrary_manager_decode_profile_report(self.mgr, &out).isError()) {
+            return null;
+        }
+        return std.mem.span(out orelse return null);
+    }
+
+    /// Lift p-code only when `enable`d, every instruction `lift_insn()` and
+    /// `lift_range()` return then has empty text. Forks inherit the setting.
+    pub fn set_pcode_only(self: *SleighState, enable: bool) void {
+        arbitrary_manager_set_pcode_only(self.mgr, enable);
+    }
+
+    /// Simplify the p-code of every lifted instruction when `enable`d:
+    /// copies through `unique` temporaries are propagated, integer ops of
+    /// constants folded and dead temporaries dropped. What the instructions
+    /// write to registers + memory stays the same. Forks inherit the setting.
+    pub fn set_simplify_pcode(self: *SleighState, enable: bool) void {
+        arbitrary_manager_set_simplify_pcode(self.mgr, enable);
+    }
+
+    /// `lift_range()` decodes at every `alignment()` offset when `enable`d
+    /// instead of after the end of the last instruction, so overlapping
+    /// instructions all come out, in address order. Forks inherit the
+    /// setting.
+    pub fn set_all_offsets(self: *SleighState, enable: bool) void {
+        arbitrary_manager_set_all_offsets(self.mgr, enable);
+    }
+
+    /// Instruction alignment of the spec in bytes, what `lift_range()`
+    /// steps by past bytes that don't decode
+    pub fn alignment(self: *SleighState) SleighError!u64 {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+        return arbitrary_manager_get_alignment(self.mgr);
+    }
+
+    /// Name of the decoder compiled in ahead of time that resolves the
+    /// spec, `null` if it goes through its decision tables
+    pub fn aot_decoder(self: *const SleighState) ?[]const u8 {
+        const name = arbitrary_manager_aot_decoder(self.mgr) orelse return null;
+        return mem.span(name);
+    }
+
+    /// Counts the symbols, constructors and p-code templates of the spec this
+    /// state lifts with, and the bytes they take
+    pub fn spec_memory_usage(self: *const SleighState) SleighError!SpecMemoryUsage {
+        var out = SpecMemoryUsage{};
+        var result = arbitrary_manager_spec_memory_usage(self.mgr, &out);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+        return out;
+    }
+
+    /// Disassemble the single instruction at `address`, for the text of
+    /// instructions lifted with `set_pcode_only()`
+    pub fn disasm(self: *SleighState, address: u64) SleighError!DisasmText {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var out = DisasmText{};
+        var result = arbitrary_manager_disasm(self.mgr, address, &out);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+
+        return out;
+    }
+
+    /// Decode only the length + flow of the instruction at `address`
+    pub fn insn_flow(self: *SleighState, address: u64) SleighError!InsnFlow {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var out = InsnFlow{};
+        var result = arbitrary_manager_insn_flow(self.mgr, address, &out);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+
+        return out;
+    }
+
+    /// Decode the length + flow of as many instructions in `[start, end)`
+    /// as fit into `out`, stepping through the code exactly like
+    /// `lift_range()` does
+    pub fn flow_range(self: *SleighState, start: u64, end: u64, out: []InsnFlow) SleighError!FlowRange {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var count: u64 = 0;
+        var end_address: u64 = start;
+        var result = arbitrary_manager_flow_range(self.mgr, start, end, out.ptr, out.len, &count, &end_address);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+
+        return FlowRange{ .insns = out[0..count], .end_address = end_address };
+    }
+
+    /// Decode the basic block at `address`: every instruction up to the
+    /// first one whose p-code branches out of it, calls or returns, and
+    /// never past `end` (unmapped bytes decode as zeros, pass the end of the
+    /// region). As many of its edges as fit go into `edges`, check
+    /// `edge_count` against it for the rest.
+    pub fn block_flow(self: *SleighState, address: u64, end: u64, edges: []BlockEdge) SleighError!BlockFlow {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var out = BlockFlow{};
+        var result = arbitrary_manager_block_flow(self.mgr, address, end, edges.ptr, edges.len, &out);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+        return out;
+    }
+
+    /// Size the parse tree cache of SLEIGH, `0` keeps the default of the spec.
+    /// `window_size` must be a power of 2.
+    pub fn set_parser_cache(self: *SleighState, cache_size: u32, window_size: u32) SleighError!void {
+        var result = arbitrary_manager_set_parser_cache(self.mgr, cache_size, window_size);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Lift every instruction in `[start, end)` into `out`, the range must be
+    /// released with `SleighState.release_range()` once you're done with it.
+    pub fn lift_range(self: *SleighState, start: u64, end: u64, out: *LiftedRange) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_lift_range(self.mgr, start, end, out);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Fill in `out` as if it was lifted from the same bytes as `in`, only
+    /// loaded at `to` instead of at `from`. The instructions are copied over
+    /// with their relocated varnodes (branch targets, pc-relative loads)
+    /// moved, only the ones that can't be moved are decoded again, so the
+    /// bytes at `to` must be loaded into `self`. `out` must be released
+    /// with `SleighState.release_range()` like any other range.
+    pub fn relocate_range(self: *SleighState, in: *const LiftedRange, from: u64, to: u64, out: *LiftedRange) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_relocate_range(self.mgr, in, from, to, out);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Free everything owned by a `LiftedRange`
+    pub fn release_range(self: *SleighState, range: *LiftedRange) void {
+        _ = self;
+        arbitrary_manager_release(range);
+    }
+
+    /// Get the entire list of registers for the current architecture, the
+    /// list is owned by SLEIGH
+    pub fn get_registers(self: *SleighState) SleighError!*RegisterList {
+        //logger.debug("Getting register list", .{});
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        return arbitrary_manager_get_all_registers(self.mgr);
+    }
+
+    /// Get the table of every address space, used to resolve the space of a
+    /// `CompactVarnodeDesc`. The list is owned by SLEIGH.
+    pub fn get_spaces(self: *SleighState) SleighError!*SpaceList {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        return arbitrary_manager_get_spaces(self.mgr);
+    }
+
+    /// Set the register `name` of the emulator, the emulator itself is built
+    /// on first use with the loaded data as its memory
+    pub fn emulate_set_register(self: *SleighState, name: [:0]const u8, value: u64) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_emulate_set_register(self.mgr, name.ptr, value);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Read the register `name` of the emulator, registers wider than 8
+    /// bytes aren't supported
+    pub fn emulate_get_register(self: *SleighState, name: [:0]const u8) SleighError!u64 {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var out: u64 = 0;
+        var result = arbitrary_manager_emulate_get_register(self.mgr, name.ptr, &out);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+
+        return out;
+    }
+
+    /// Write `data` at `address` of the emulator's default data space, the
+    /// loaded data itself is never modified
+    pub fn emulate_write(self: *SleighState, address: u64, data: []const u8) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_emulate_write(self.mgr, address, data.len, data.ptr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Read `out.len` bytes at `address` of the emulator's default data space
+    pub fn emulate_read(self: *SleighState, address: u64, out: []u8) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_emulate_read(self.mgr, address, out.len, out.ptr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Freeze the emulator state as the one `SleighState.emulate_restore()`
+    /// goes back to
+    pub fn emulate_snapshot(self: *SleighState) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_emulate_snapshot(self.mgr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Drop every write since the last `SleighState.emulate_snapshot()`
+    pub fn emulate_restore(self: *SleighState) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_emulate_restore(self.mgr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Drop every snapshot and write of the emulator
+    pub fn emulate_clear(self: *SleighState) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_emulate_clear(self.mgr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Emulate from `address` until an indirect branch, call or return, or
+    /// until `max_insns` instructions ran. The final state stays in the
+    /// emulator to be read back.
+    pub fn emulate_run(self: *SleighState, address: u64, max_insns: u64) SleighError!EmulateResult {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var out = EmulateResult{};
+        var result = arbitrary_manager_emulate_run(self.mgr, address, max_insns, &out);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+
+        return out;
+    }
+
+    /// Set up `count` lanes for `SleighState.lanes_run()`, each with its own
+    /// copy of the state a fresh emulator starts from. Drops any lanes set
+    /// up before.
+    pub fn emulate_lanes(self: *SleighState, count: u32) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        self.lane_count = 0;
+        var result = arbitrary_manager_emulate_lanes(self.mgr, count);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+        self.lane_count = count;
+    }
+
+    /// `SleighState.emulate_set_register()` for the lane `lane`
+    pub fn lane_set_register(self: *SleighState, lane: u32, name: [:0]const u8, value: u64) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_lane_set_register(self.mgr, lane, name.ptr, value);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// `SleighState.emulate_get_register()` for the lane `lane`
+    pub fn lane_get_register(self: *SleighState, lane: u32, name: [:0]const u8) SleighError!u64 {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var out: u64 = 0;
+        var result = arbitrary_manager_lane_get_register(self.mgr, lane, name.ptr, &out);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+
+        return out;
+    }
+
+    /// `SleighState.emulate_write()` for the lane `lane`
+    pub fn lane_write(self: *SleighState, lane: u32, address: u64, data: []const u8) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_lane_write(self.mgr, lane, address, data.len, data.ptr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// `SleighState.emulate_read()` for the lane `lane`
+    pub fn lane_read(self: *SleighState, lane: u32, address: u64, out: []u8) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_lane_read(self.mgr, lane, address, out.len, out.ptr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Drop every write to every lane
+    pub fn lanes_clear(self: *SleighState) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+
+        var result = arbitrary_manager_lanes_clear(self.mgr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Run every lane from `address` like `SleighState.emulate_run()`, the
+    /// result of lane `i` goes to `out[i]`. `out` needs an entry per lane.
+    pub fn lanes_run(self: *SleighState, address: u64, max_insns: u64, out: []EmulateResult) SleighError!void {
+        if (!self.began) {
+            return SleighError.CallBeginFirst;
+        }
+        if (out.len < self.lane_count) {
+            return SleighError.Fail;
+        }
+
+        var result = arbitrary_manager_lanes_run(self.mgr, address, max_insns, out.ptr);
+        if (result.isError()) {
+            return result.asSleighError();
+        }
+    }
+
+    /// Get entire list of user-defined operations aka `CALLOTHER` ops
+    ///
     /// This is used to help navigate the architecture specific semantics
     /// of various architectures and one-off instructions.
     pub fn get_user_ops(self: *SleighState) SleighError!*UserOpList {
@@ -620,101 +2218,1176 @@ pub const SleighState = struct {
             return SleighError.CallBeginFirst;
         }
 
-        return arbitrary_manager_get_user_ops(self.mgr);
+        return arbitrary_manager_get_user_ops(self.mgr);
+    }
+};
+
+test "can load sleigh" {
+    const sleigh_mgr = arbitrary_manager_new();
+    defer arbitrary_manager_free(sleigh_mgr);
+}
+
+test "init" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+}
+
+test "load slaspec" {
+    {
+        // success
+        var sleigh = SleighState.init();
+        defer sleigh.deinit();
+        try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    }
+
+    {
+        // make sure we fail correctly
+        var sleigh = SleighState.init();
+        defer sleigh.deinit();
+        try testing.expectError(SleighError.InvalidSlaspec, sleigh.add_specfile("./src/main.zig"));
+    }
+}
+
+test "call begin before certain actions" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+
+    try testing.expectError(SleighError.CallBeginFirst, sleigh.context_var_set_default("TMode", 1));
+    try testing.expectError(SleighError.CallBeginFirst, sleigh.load_data(0x00, &[_]u8{}));
+    try testing.expectError(SleighError.CallBeginFirst, sleigh.next_insn());
+    try testing.expectError(SleighError.CallBeginFirst, sleigh.get_registers());
+    try testing.expectError(SleighError.CallBeginFirst, sleigh.get_user_ops());
+    try testing.expectError(SleighError.CallBeginFirst, sleigh.get_spaces());
+    try testing.expectError(SleighError.CallBeginFirst, sleigh.fork());
+    try testing.expectError(SleighError.CallBeginFirst, sleigh.lift_insn(0x0));
+    var range = LiftedRange{};
+    try testing.expectError(SleighError.CallBeginFirst, sleigh.lift_range(0x0, 0x4, &range));
+    try testing.expectError(SleighError.CallBeginFirst, sleigh.emulate_run(0x0, 1));
+    try testing.expectError(SleighError.CallBeginFirst, sleigh.emulate_lanes(4));
+
+    // add sla + begin
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // call methods in same order as above, tho it doesnt really matter
+    try sleigh.context_var_set_default("TMode", 1);
+    try sleigh.load_data(0x0, &.{ 0, 0, 0, 0 });
+    _ = try sleigh.next_insn();
+    _ = try sleigh.get_registers();
+    _ = try sleigh.get_user_ops();
+    _ = try sleigh.get_spaces();
+    _ = try sleigh.lift_insn(0x0);
+    try sleigh.lift_range(0x0, 0x4, &range);
+    sleigh.release_range(&range);
+}
+
+test "load context variable" {
+    {
+        // success
+        var sleigh = SleighState.init();
+        defer sleigh.deinit();
+        try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+        sleigh.begin();
+        try sleigh.context_var_set_default("TMode", 1);
+    }
+    {
+        // fail
+        var sleigh = SleighState.init();
+        defer sleigh.deinit();
+        try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+        sleigh.begin();
+        try testing.expectError(SleighError.BadContextVariable, sleigh.context_var_set_default("DNE", 1));
+    }
+}
+
+test "context regions lift in their own mode" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // `push {lr}` in ARM, then `nop; bx lr` in Thumb
+    const bytes = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x00, 0xbf, 0x70, 0x47 };
+    try sleigh.load_data(0x0, &bytes);
+    try sleigh.context_var_set_region("TMode", 0x4, 0x8, 1);
+    try testing.expectError(SleighError.BadContextVariable, sleigh.context_var_set_region("DNE", 0x4, 0x8, 1));
+
+    var forked = try sleigh.fork();
+    defer forked.deinit();
+    for ([_]*SleighState{ &sleigh, &forked }) |handle| {
+        var range = LiftedRange{};
+        try handle.lift_range(0x0, bytes.len, &range);
+        defer handle.release_range(&range);
+
+        const insns = range.insns();
+        try testing.expectEqual(@as(usize, 3), insns.len);
+        try testing.expectEqual(@as(u64, 4), insns[0].size);
+        try testing.expectEqual(@as(u64, 2), insns[1].size);
+        try testing.expectEqual(@as(u64, 2), insns[2].size);
+    }
+}
+
+test "context defaults reach past the regions painted before them" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // `push {lr}` in ARM, then `nop; bx lr` in Thumb by default
+    const bytes = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x00, 0xbf, 0x70, 0x47 };
+    try sleigh.load_data(0x0, &bytes);
+    try sleigh.context_var_set_region("TMode", 0x0, 0x4, 0);
+    try sleigh.context_var_set_default("TMode", 1);
+
+    var forked = try sleigh.fork();
+    defer forked.deinit();
+    for ([_]*SleighState{ &sleigh, &forked }) |handle| {
+        var range = LiftedRange{};
+        try handle.lift_range(0x0, bytes.len, &range);
+        defer handle.release_range(&range);
+
+        const insns = range.insns();
+        try testing.expectEqual(@as(usize, 3), insns.len);
+        try testing.expectEqual(@as(u64, 4), insns[0].size);
+        try testing.expectEqual(@as(u64, 2), insns[1].size);
+        try testing.expectEqual(@as(u64, 2), insns[2].size);
+    }
+}
+
+test "load binary data" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // call methods in same order as above, tho it doesnt really matter
+    try sleigh.context_var_set_default("TMode", 1);
+    try sleigh.load_data(0x0, &.{ 0, 0, 0, 0 });
+}
+
+test "lift binary data" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // call methods in same order as above, tho it doesnt really matter
+    try sleigh.context_var_set_default("TMode", 1);
+
+    // this translates to `movs r0, r0; movs r0, r0` in
+    // arm thumb
+    try sleigh.load_data(0x0, &.{ 0, 0, 0, 0 });
+    _ = try sleigh.lift_insn(0x0);
+}
+
+test "lift binary range" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+    try sleigh.context_var_set_default("TMode", 1);
+
+    // `movs r0, r0` x4 in arm thumb
+    try sleigh.load_data(0x0, &.{ 0, 0, 0, 0, 0, 0, 0, 0 });
+
+    var range = LiftedRange{};
+    try sleigh.lift_range(0x0, 0x8, &range);
+    defer sleigh.release_range(&range);
+
+    try testing.expectEqual(@as(u64, 4), range.insn_count);
+    try testing.expectEqual(@as(u64, 0x8), range.end_address);
+    for (range.insns(), 0..) |*insn, idx| {
+        try testing.expectEqual(@as(u64, idx * 2), insn.address);
+        try testing.expectEqual(@as(u64, 2), insn.size);
+        try testing.expect(range.opcodes(insn).len > 0);
+
+        const text = try range.to_asm(insn, testing.allocator);
+        defer testing.allocator.free(text);
+        try testing.expect(text.len > 0);
+    }
+
+    var spaces = try SpaceTable.init(try sleigh.get_spaces(), testing.allocator);
+    defer spaces.deinit();
+
+    // equivalent to lifting each insn one at a time
+    const single = (try sleigh.lift_insn(0x0)).?;
+    const first = &range.insns()[0];
+    try testing.expectEqual(single.op_count, first.op_count);
+    for (single.pcodes(), first.op_start..) |a, op_idx| {
+        const b = range.op(op_idx);
+        try testing.expectEqual(a.opcode, b.opcode);
+        try testing.expectEqual(a.inputs_len, b.input_len);
+        try testing.expectEqual(a.output == null, range.output(b) == null);
+        for (a.inputs(), b.input_start..) |*full, vn_idx| {
+            const compact = range.varnode(vn_idx);
+            try testing.expectEqual(full.offset, compact.offset);
+            try testing.expectEqual(full.size, compact.size);
+            try testing.expectEqual(try full.space_enum(), try spaces.space_enum(&compact));
+        }
+    }
+
+    // the columns line up with the rows
+    const ops = range.ops();
+    try testing.expectEqual(@as(usize, range.op_count), ops.len);
+    try testing.expectEqualSlices(OpCode, ops.items(.opcode)[first.op_start..][0..first.op_count], range.opcodes(first));
+    for (ops.items(.output), ops.items(.input_start), ops.items(.input_len)) |out, input_start, input_len| {
+        try testing.expect(out == RangePcodeOp.NO_OUTPUT or out < range.varnode_count);
+        try testing.expect(input_start + input_len <= range.varnode_count);
     }
-};
+}
 
-test "can load sleigh" {
-    const sleigh_mgr = arbitrary_manager_new();
-    defer arbitrary_manager_free(sleigh_mgr);
+test "p-code only lifts render text on demand" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // `push {lr}; ldr r0, [r1]; bx lr`
+    const data = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x00, 0x00, 0x91, 0xe5, 0x1e, 0xff, 0x2f, 0xe1 };
+    try sleigh.load_data(0x0, &data);
+
+    var full = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &full);
+    defer sleigh.release_range(&full);
+
+    sleigh.set_pcode_only(true);
+    var bare = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &bare);
+    defer sleigh.release_range(&bare);
+
+    try testing.expectEqual(full.insn_count, bare.insn_count);
+    try testing.expectEqualSlices(OpCode, full.ops().items(.opcode), bare.ops().items(.opcode));
+    for (full.insns(), bare.insns()) |*a, *b| {
+        try testing.expectEqual(@as(u64, 0), b.insn_len + b.body_len);
+
+        const text = try full.to_asm(a, testing.allocator);
+        defer testing.allocator.free(text);
+        const dis = try sleigh.disasm(b.address);
+        try testing.expectEqual(b.size, dis.size);
+        const lazy = try dis.to_asm(testing.allocator);
+        defer testing.allocator.free(lazy);
+        try testing.expectEqualStrings(text, lazy);
+    }
+
+    try testing.expectError(SleighError.InsnDecodeError, sleigh.disasm(0x1000));
 }
 
-test "init" {
+test "simplified p-code folds away temporaries" {
     var sleigh = SleighState.init();
     defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/riscv.lp64d.sla");
+    sleigh.begin();
+
+    // `c.addi16sp sp, -0x150; lui a5, 0x75`
+    const data = [_]u8{ 0x4d, 0x71, 0xb7, 0x57, 0x07, 0x00 };
+    try sleigh.load_data(0x0, &data);
+
+    var full = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &full);
+    defer sleigh.release_range(&full);
+
+    sleigh.set_simplify_pcode(true);
+    var simple = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &simple);
+    defer sleigh.release_range(&simple);
+
+    try testing.expectEqual(full.insn_count, simple.insn_count);
+    try testing.expect(simple.op_count < full.op_count);
+    for (full.insns(), simple.insns()) |*a, *b| {
+        try testing.expectEqual(a.size, b.size);
+        try testing.expectEqual(@as(u64, 1), b.op_count);
+    }
+
+    // the shifted immediate is copied into `a5` as a constant
+    const lui = simple.op(simple.insns()[1].op_start);
+    try testing.expectEqual(OpCode.CPUI_COPY, lui.opcode);
+    try testing.expectEqual(@as(u64, 0x75000), simple.varnode(lui.input_start).offset);
 }
 
-test "load slaspec" {
-    {
-        // success
-        var sleigh = SleighState.init();
-        defer sleigh.deinit();
-        try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+test "lifted instructions carry their effects" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/riscv.lp64d.sla");
+    sleigh.begin();
+
+    // `c.addi16sp sp, -0x150; lui a5, 0x75; ret`
+    const data = [_]u8{ 0x4d, 0x71, 0xb7, 0x57, 0x07, 0x00, 0x82, 0x80 };
+    try sleigh.load_data(0x0, &data);
+
+    var range = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &range);
+    defer sleigh.release_range(&range);
+
+    const registers = try sleigh.get_registers();
+    const slots = registers.slot_table();
+    var a5: ?u16 = null;
+    for (registers.slice(), 0..) |*reg, id| {
+        if (std.mem.eql(u8, std.mem.sliceTo(&reg.name, 0), "a5")) {
+            a5 = slots[id];
+        }
     }
+    const sp = slots[registers.stack_pointer];
 
-    {
-        // make sure we fail correctly
-        var sleigh = SleighState.init();
-        defer sleigh.deinit();
-        try testing.expectError(SleighError.InvalidSlaspec, sleigh.add_specfile("./src/main.zig"));
+    const effects = range.effects();
+    try testing.expectEqual(@as(usize, 3), effects.len);
+
+    try testing.expectEqual(@as(i64, -0x150), effects[0].sp_delta);
+    try testing.expect(effects[0].has(InsnEffects.WRITE_SP));
+    try testing.expect(EffectSet.has(effects[0].reads, sp));
+    try testing.expect(EffectSet.has(effects[0].writes, sp));
+
+    try testing.expectEqual(@as(i64, 0), effects[1].sp_delta);
+    try testing.expect(EffectSet.has(effects[1].writes, a5.?));
+    try testing.expect(!EffectSet.has(effects[1].writes, sp));
+    try testing.expect(!effects[1].has(InsnEffects.LOAD | InsnEffects.STORE | InsnEffects.BRANCH));
+
+    try testing.expect(effects[2].has(InsnEffects.RETURN | InsnEffects.BRANCH));
+    try testing.expect(effects[2].terminator != 0);
+}
+
+test "all offsets lift decodes inside of instructions" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/x86-64.sla");
+    sleigh.begin();
+    try sleigh.context_var_set_default("addrsize", 2);
+    try sleigh.context_var_set_default("opsize", 1);
+    try sleigh.context_var_set_default("longMode", 1);
+
+    // `mov eax, 0xc3; ret`, the immediate is a `ret` of its own
+    const data = [_]u8{ 0xb8, 0xc3, 0x00, 0x00, 0x00, 0xc3 };
+    try sleigh.load_data(0x0, &data);
+    try testing.expectEqual(@as(u64, 1), try sleigh.alignment());
+
+    var aligned = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &aligned);
+    defer sleigh.release_range(&aligned);
+    try testing.expectEqual(@as(u64, 2), aligned.insn_count);
+
+    sleigh.set_all_offsets(true);
+    var every = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &every);
+    defer sleigh.release_range(&every);
+    try testing.expectEqual(@as(u64, data.len), every.insn_count);
+    try testing.expectEqual(@as(u64, data.len), every.end_address);
+    for (every.insns(), 0..) |*insn, idx| {
+        try testing.expectEqual(@as(u64, idx), insn.address);
     }
+
+    // the hidden `ret` lifts like the real one
+    const hidden = &every.insns()[1];
+    const real = &every.insns()[5];
+    try testing.expectEqual(real.size, hidden.size);
+    try testing.expectEqualSlices(OpCode, every.opcodes(real), every.opcodes(hidden));
 }
 
-test "call begin before certain actions" {
+test "flow decode steps like the lift" {
     var sleigh = SleighState.init();
     defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
 
-    try testing.expectError(SleighError.CallBeginFirst, sleigh.context_var_set_default("TMode", 1));
-    try testing.expectError(SleighError.CallBeginFirst, sleigh.load_data(0x00, &[_]u8{}));
-    try testing.expectError(SleighError.CallBeginFirst, sleigh.next_insn());
-    try testing.expectError(SleighError.CallBeginFirst, sleigh.get_registers());
-    try testing.expectError(SleighError.CallBeginFirst, sleigh.get_user_ops());
-    try testing.expectError(SleighError.CallBeginFirst, sleigh.lift_insn(0x0));
+    // `push {lr}; bx lr; b .; blx r3; bl 0`
+    const data = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x1e, 0xff, 0x2f, 0xe1, 0xfe, 0xff, 0xff, 0xea, 0x33, 0xff, 0x2f, 0xe1, 0xfa, 0xff, 0xff, 0xeb };
+    try sleigh.load_data(0x0, &data);
+
+    var buffer: [8]InsnFlow = undefined;
+    const flows = try sleigh.flow_range(0x0, data.len, &buffer);
+    try testing.expectEqual(@as(u64, data.len), flows.end_address);
+    try testing.expectEqual(@as(usize, 5), flows.insns.len);
+
+    try testing.expectEqual(@as(u64, 0), flows.insns[0].flow);
+    try testing.expect(flows.insns[1].has(InsnFlow.RETURN));
+    try testing.expect(flows.insns[2].has(InsnFlow.BRANCH));
+    try testing.expect(flows.insns[3].has(InsnFlow.CALL_INDIRECT));
+    try testing.expect(flows.insns[4].has(InsnFlow.CALL));
+
+    var range = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &range);
+    defer sleigh.release_range(&range);
+    for (range.insns(), flows.insns) |*insn, flow| {
+        try testing.expectEqual(insn.address, flow.address);
+        try testing.expectEqual(insn.size, flow.size);
+        try testing.expectEqual(flow, try sleigh.insn_flow(insn.address));
+    }
 
-    // add sla + begin
+    // a full buffer stops early
+    const first = try sleigh.flow_range(0x0, data.len, buffer[0..2]);
+    try testing.expectEqual(@as(u64, 0x8), first.end_address);
+}
+
+test "flow decode paints the context its operands set" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
     try sleigh.add_specfile("./specfiles/ARM8_le.sla");
     sleigh.begin();
 
-    // call methods in same order as above, tho it doesnt really matter
-    try sleigh.context_var_set_default("TMode", 1);
-    try sleigh.load_data(0x0, &.{ 0, 0, 0, 0 });
-    _ = try sleigh.next_insn();
-    _ = try sleigh.get_registers();
-    _ = try sleigh.get_user_ops();
-    _ = try sleigh.lift_insn(0x0);
+    // `blx 0x100` sets TMode at its target, where `bx lr` is Thumb
+    var data = [_]u8{0} ** 0x200;
+    @memcpy(data[0..4], &[_]u8{ 0x3e, 0x00, 0x00, 0xfa });
+    @memcpy(data[0x100..0x102], &[_]u8{ 0x70, 0x47 });
+    try sleigh.load_data(0x0, &data);
+
+    try testing.expectEqual(@as(u64, 4), (try sleigh.disasm(0x100)).size);
+    const flow = try sleigh.insn_flow(0x0);
+    try testing.expect(flow.has(InsnFlow.CALL));
+    try testing.expectEqual(@as(u64, 2), (try sleigh.disasm(0x100)).size);
+    try testing.expectEqual(@as(u64, 4), (try sleigh.disasm(0x0)).size);
 }
 
-test "load context variable" {
-    {
-        // success
-        var sleigh = SleighState.init();
-        defer sleigh.deinit();
-        try sleigh.add_specfile("./specfiles/ARM8_le.sla");
-        sleigh.begin();
-        try sleigh.context_var_set_default("TMode", 1);
+test "basic blocks end at their branches" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // `push {lr}; bl 0x14; ldr r0, [pc, #4]; bx lr; bx lr; bxeq lr`
+    const data = [_]u8{
+        0x04, 0xe0, 0x2d, 0xe5, 0x02, 0x00, 0x00, 0xeb, 0x04, 0x00, 0x9f, 0xe5,
+        0x1e, 0xff, 0x2f, 0xe1, 0x1e, 0xff, 0x2f, 0xe1, 0x1e, 0xff, 0x2f, 0x01,
+    };
+    try sleigh.load_data(0x0, &data);
+
+    // the call comes back, so the block falls through past it
+    var edges: [4]BlockEdge = undefined;
+    const call = try sleigh.block_flow(0x0, data.len, &edges);
+    try testing.expectEqual(@as(u64, 0x8), call.end);
+    try testing.expectEqual(@as(u64, 2), call.insn_count);
+    try testing.expect(call.has(InsnFlow.CALL));
+    try testing.expectEqual(@as(u64, 2), call.edge_count);
+    try testing.expectEqual(BlockEdge{ .target = 0x14, .kind = .call }, edges[0]);
+    try testing.expectEqual(BlockEdge{ .target = 0x8, .kind = .fallthrough }, edges[1]);
+
+    const ret = try sleigh.block_flow(0x8, data.len, &edges);
+    try testing.expectEqual(@as(u64, 0x10), ret.end);
+    try testing.expect(ret.has(InsnFlow.RETURN));
+    try testing.expectEqual(@as(u64, 0), ret.edge_count);
+
+    // a conditional return may not, and nothing decodes past `end`
+    const cond = try sleigh.block_flow(0x14, data.len, &edges);
+    try testing.expectEqual(@as(u64, 1), cond.edge_count);
+    try testing.expectEqual(BlockEdge{ .target = 0x18, .kind = .fallthrough }, edges[0]);
+    const empty = try sleigh.block_flow(0x18, data.len, &edges);
+    try testing.expectEqual(@as(u64, 0), empty.insn_count);
+}
+
+test "decode cache lifts like the decoder" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // `push {lr}; ldr r0, [r1]; bx lr`, the last two twice
+    const data = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x00, 0x00, 0x91, 0xe5, 0x1e, 0xff, 0x2f, 0xe1, 0x00, 0x00, 0x91, 0xe5, 0x1e, 0xff, 0x2f, 0xe1 };
+    try sleigh.load_data(0x0, &data);
+
+    var uncached = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &uncached);
+    defer sleigh.release_range(&uncached);
+
+    try testing.expectError(SleighError.Fail, sleigh.set_parser_cache(16, 100));
+    try sleigh.set_parser_cache(16, 512);
+    sleigh.set_decode_cache(2);
+
+    // the second lift is served out of the cache, and the tiny capacity
+    // evicts along the way. The repeats hit it and still share the rows of
+    // their encoding.
+    for (0..2) |_| {
+        var cached = LiftedRange{};
+        try sleigh.lift_range(0x0, data.len, &cached);
+        defer sleigh.release_range(&cached);
+        try testing.expectEqual(uncached.arena_size, cached.arena_size);
+        try testing.expectEqualSlices(u8, uncached.arena.?[0..uncached.arena_size], cached.arena.?[0..cached.arena_size]);
+        try testing.expectEqual(cached.insns()[1].op_start, cached.insns()[3].op_start);
     }
-    {
-        // fail
+
+    const first = (try sleigh.lift_insn(0x0)).?;
+    const again = (try sleigh.lift_insn(0x0)).?;
+    try testing.expectEqual(first.op_count, again.op_count);
+    try testing.expectEqualSlices(u8, first.insn[0..first.insn_len], again.insn[0..again.insn_len]);
+
+    // new bytes throw away the cached decode
+    try sleigh.load_data(0x100, &.{ 0, 0, 0, 0 });
+    const fresh = (try sleigh.lift_insn(0x0)).?;
+    try testing.expectEqual(first.op_count, fresh.op_count);
+}
+
+test "interned encodings lift like the decoder" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // `bl +0x10; bx lr` twice: the `bl` is relocated, the `bx lr` shared
+    const data = [_]u8{ 0x02, 0x00, 0x00, 0xeb, 0x1e, 0xff, 0x2f, 0xe1 } ** 2;
+    try sleigh.load_data(0x0, &data);
+
+    var interned = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &interned);
+    defer sleigh.release_range(&interned);
+
+    sleigh.set_insn_intern(0);
+    var decoded = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &decoded);
+    defer sleigh.release_range(&decoded);
+
+    try testing.expectEqual(decoded.insn_count, interned.insn_count);
+    try testing.expect(interned.op_count < decoded.op_count);
+    try testing.expectEqual(interned.insns()[1].op_start, interned.insns()[3].op_start);
+
+    for (interned.insns(), decoded.insns()) |*a, *b| {
+        try testing.expectEqual(b.op_count, a.op_count);
+        try testing.expectEqualSlices(OpCode, decoded.opcodes(b), interned.opcodes(a));
+
+        const a_text = try interned.to_asm(a, testing.allocator);
+        defer testing.allocator.free(a_text);
+        const b_text = try decoded.to_asm(b, testing.allocator);
+        defer testing.allocator.free(b_text);
+        try testing.expectEqualStrings(b_text, a_text);
+
+        for (a.op_start..a.op_start + a.op_count, b.op_start..) |a_idx, b_idx| {
+            const a_op = interned.op(a_idx);
+            const b_op = decoded.op(b_idx);
+            try testing.expectEqual(decoded.output(b_op), interned.output(a_op));
+            for (0..a_op.input_len) |input| {
+                try testing.expectEqual(decoded.varnode(b_op.input_start + input), interned.varnode(a_op.input_start + input));
+            }
+        }
+    }
+}
+
+test "emulate a gadget from a snapshot" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // `push {lr}; ldr r0, [r1]; bx lr`
+    const data = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x00, 0x00, 0x91, 0xe5, 0x1e, 0xff, 0x2f, 0xe1 };
+    try sleigh.load_data(0x0, &data);
+
+    try sleigh.emulate_set_register("sp", 0x8000);
+    try sleigh.emulate_set_register("lr", 0x4140);
+    try sleigh.emulate_write(0x2000, &.{ 0x44, 0x33, 0x22, 0x11 });
+    try testing.expectError(SleighError.Fail, sleigh.emulate_set_register("not_a_register", 0));
+    try sleigh.emulate_snapshot();
+
+    for ([_]u64{ 0x2000, 0x2004 }) |pointer| {
+        try sleigh.emulate_set_register("r1", pointer);
+        const result = try sleigh.emulate_run(0x0, 16);
+        try testing.expectEqual(EmulateStop.Branch, result.stop);
+        try testing.expectEqual(@as(u64, 3), result.insn_count);
+        try testing.expectEqual(@as(u64, 0x8), result.address);
+        try testing.expectEqual(@as(u64, 0x4140), result.target);
+
+        const expected: u64 = if (pointer == 0x2000) 0x11223344 else 0;
+        try testing.expectEqual(expected, try sleigh.emulate_get_register("r0"));
+        try testing.expectEqual(@as(u64, 0x7ffc), try sleigh.emulate_get_register("sp"));
+        var pushed: [4]u8 = undefined;
+        try sleigh.emulate_read(0x7ffc, &pushed);
+        try testing.expectEqualSlices(u8, &.{ 0x40, 0x41, 0, 0 }, &pushed);
+
+        // back to the snapshot for the next candidate
+        try sleigh.emulate_restore();
+        try testing.expectEqual(@as(u64, 0), try sleigh.emulate_get_register("r0"));
+        try testing.expectEqual(@as(u64, 0x8000), try sleigh.emulate_get_register("sp"));
+    }
+
+    const limited = try sleigh.emulate_run(0x0, 1);
+    try testing.expectEqual(EmulateStop.InsnLimit, limited.stop);
+    try testing.expectEqual(@as(u64, 0x4), limited.address);
+
+    try sleigh.emulate_clear();
+    try testing.expectEqual(@as(u64, 0), try sleigh.emulate_get_register("sp"));
+}
+
+test "emulate a gadget over many lanes" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // `push {lr}; ldr r0, [r1]; bx lr`
+    const data = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x00, 0x00, 0x91, 0xe5, 0x1e, 0xff, 0x2f, 0xe1 };
+    try sleigh.load_data(0x0, &data);
+
+    var results: [4]EmulateResult = undefined;
+    try testing.expectError(SleighError.Fail, sleigh.lanes_run(0x0, 16, &results));
+    try testing.expectError(SleighError.Fail, sleigh.emulate_lanes(0));
+    try sleigh.emulate_lanes(4);
+    try testing.expectError(SleighError.Fail, sleigh.lane_set_register(4, "sp", 0));
+
+    var lane: u32 = 0;
+    while (lane < 4) : (lane += 1) {
+        try sleigh.lane_set_register(lane, "sp", 0x8000);
+        try sleigh.lane_set_register(lane, "lr", 0x4140 + lane * 4);
+        try sleigh.lane_set_register(lane, "r1", 0x2000 + lane * 4);
+        try sleigh.lane_write(lane, 0x2000 + lane * 4, &.{ 0x44, 0x33, 0x22, @as(u8, @intCast(lane)) });
+    }
+    try sleigh.lanes_run(0x0, 16, &results);
+
+    lane = 0;
+    while (lane < 4) : (lane += 1) {
+        try testing.expectEqual(EmulateStop.Branch, results[lane].stop);
+        try testing.expectEqual(@as(u64, 3), results[lane].insn_count);
+        try testing.expectEqual(@as(u64, 0x8), results[lane].address);
+        try testing.expectEqual(@as(u64, 0x4140 + lane * 4), results[lane].target);
+        try testing.expectEqual(@as(u64, 0x00223344) | (@as(u64, lane) << 24), try sleigh.lane_get_register(lane, "r0"));
+        try testing.expectEqual(@as(u64, 0x7ffc), try sleigh.lane_get_register(lane, "sp"));
+        var pushed: [4]u8 = undefined;
+        try sleigh.lane_read(lane, 0x7ffc, &pushed);
+        try testing.expectEqualSlices(u8, &.{ @as(u8, @intCast(0x40 + lane * 4)), 0x41, 0, 0 }, &pushed);
+    }
+
+    try sleigh.lanes_clear();
+    try testing.expectEqual(@as(u64, 0), try sleigh.lane_get_register(3, "sp"));
+}
+
+test "emulated float ops are the same with host conversions" {
+    // `fadd.d fa0, fa0, fa1; fmul.d fa2, fa0, fa1; fcvt.s.d fa5, fa2`
+    const data = [_]u8{ 0x53, 0x75, 0xb5, 0x02, 0x53, 0x76, 0xb5, 0x12, 0xd3, 0x77, 0x16, 0x40 };
+    defer SleighSpec.set_host_floats(true);
+
+    for ([_]bool{ true, false }) |host_floats| {
+        SleighSpec.set_host_floats(host_floats);
         var sleigh = SleighState.init();
         defer sleigh.deinit();
-        try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+        try sleigh.add_specfile("./specfiles/riscv.lp64d.sla");
         sleigh.begin();
-        try testing.expectError(SleighError.BadContextVariable, sleigh.context_var_set_default("DNE", 1));
+        try sleigh.load_data(0x1000, &data);
+
+        try sleigh.emulate_set_register("fa0", @bitCast(@as(f64, 1.5)));
+        try sleigh.emulate_set_register("fa1", @bitCast(@as(f64, 2.25)));
+        const result = try sleigh.emulate_run(0x1000, 3);
+        try testing.expectEqual(EmulateStop.InsnLimit, result.stop);
+        try testing.expectEqual(@as(u64, @bitCast(@as(f64, 3.75))), try sleigh.emulate_get_register("fa0"));
+        try testing.expectEqual(@as(u64, @bitCast(@as(f64, 8.4375))), try sleigh.emulate_get_register("fa2"));
+        try testing.expectEqual(@as(u64, @as(u32, @bitCast(@as(f32, 8.4375)))), try sleigh.emulate_get_register("fa5"));
     }
 }
 
-test "load binary data" {
+test "patched bytes lift again" {
     var sleigh = SleighState.init();
     defer sleigh.deinit();
     try sleigh.add_specfile("./specfiles/ARM8_le.sla");
     sleigh.begin();
+    try sleigh.set_parser_cache(16, 512);
+    sleigh.set_decode_cache(16);
+
+    // `push {lr}; ldr r0, [r1]; bx lr`
+    const data = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x00, 0x00, 0x91, 0xe5, 0x1e, 0xff, 0x2f, 0xe1 };
+    try sleigh.load_data(0x0, &data);
+
+    var before = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &before);
+    defer sleigh.release_range(&before);
+
+    // the `ldr` becomes a `bx lr`, straight through the cached decodes
+    try sleigh.patch(0x4, &.{ 0x1e, 0xff, 0x2f, 0xe1 });
+    var after = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &after);
+    defer sleigh.release_range(&after);
+    try testing.expectEqual(before.insn_count, after.insn_count);
+
+    var texts: [2][3][]const u8 = undefined;
+    for ([_]*const LiftedRange{ &before, &after }, 0..) |range, lift| {
+        for (range.insns(), 0..) |*insn, idx| {
+            texts[lift][idx] = try range.to_asm(insn, testing.allocator);
+        }
+    }
+    defer for (texts) |lift| {
+        for (lift) |text| {
+            testing.allocator.free(text);
+        }
+    };
 
-    // call methods in same order as above, tho it doesnt really matter
-    try sleigh.context_var_set_default("TMode", 1);
-    try sleigh.load_data(0x0, &.{ 0, 0, 0, 0 });
+    try testing.expectEqualStrings(texts[0][0], texts[1][0]);
+    try testing.expect(!mem.eql(u8, texts[0][1], texts[1][1]));
+    try testing.expectEqualStrings(texts[0][2], texts[1][1]);
+    try testing.expectEqualStrings(texts[0][2], texts[1][2]);
+
+    // the caller's buffer is left alone, the patch is a copy
+    try testing.expectEqual(@as(u8, 0x00), data[4]);
+
+    // the end of the patch has to be an address too
+    try testing.expectError(SleighError.Fail, sleigh.patch(std.math.maxInt(u64) - 3, &.{ 0x00, 0x00, 0x91, 0xe5 }));
+    try testing.expectError(SleighError.Fail, sleigh.patch(std.math.maxInt(u64) - 1, &.{ 0x00, 0x00, 0x91, 0xe5 }));
+
+    // not while a fork is reading the same bytes
+    var forked = try sleigh.fork();
+    try testing.expectError(SleighError.Fail, sleigh.patch(0x4, &.{ 0x00, 0x00, 0x91, 0xe5 }));
+    try testing.expectError(SleighError.Fail, forked.patch(0x4, &.{ 0x00, 0x00, 0x91, 0xe5 }));
+    forked.deinit();
+    try sleigh.patch(0x4, &.{ 0x00, 0x00, 0x91, 0xe5 });
 }
 
-test "lift binary data" {
+test "relocated ranges lift like the moved bytes" {
+    // `push {lr}; bl 0x14; ldr r0, [pc, #4]; bx lr`
+    const data = [_]u8{
+        0x04, 0xe0, 0x2d, 0xe5, 0x02, 0x00, 0x00, 0xeb,
+        0x04, 0x00, 0x9f, 0xe5, 0x1e, 0xff, 0x2f, 0xe1,
+    };
+
+    var first = SleighState.init();
+    defer first.deinit();
+    try first.add_specfile("./specfiles/ARM8_le.sla");
+    first.begin();
+    try first.load_data(0x0, &data);
+
+    var moved = SleighState.init();
+    defer moved.deinit();
+    try moved.add_specfile("./specfiles/ARM8_le.sla");
+    moved.begin();
+    try moved.load_data(0x1000, &data);
+
+    var lifted = LiftedRange{};
+    try first.lift_range(0x0, data.len, &lifted);
+    defer first.release_range(&lifted);
+
+    var relocated = LiftedRange{};
+    try moved.relocate_range(&lifted, 0x0, 0x1000, &relocated);
+    defer moved.release_range(&relocated);
+
+    var fresh = LiftedRange{};
+    try moved.lift_range(0x1000, 0x1000 + data.len, &fresh);
+    defer moved.release_range(&fresh);
+
+    try testing.expectEqual(fresh.insn_count, relocated.insn_count);
+    try testing.expectEqual(fresh.end_address, relocated.end_address);
+    for (fresh.insns(), relocated.insns()) |*want, *got| {
+        try testing.expectEqual(want.address, got.address);
+        try testing.expectEqual(want.op_count, got.op_count);
+
+        const want_asm = try fresh.to_asm(want, testing.allocator);
+        defer testing.allocator.free(want_asm);
+        const got_asm = try relocated.to_asm(got, testing.allocator);
+        defer testing.allocator.free(got_asm);
+        try testing.expectEqualStrings(want_asm, got_asm);
+
+        try testing.expectEqualSlices(OpCode, fresh.opcodes(want), relocated.opcodes(got));
+        for (want.op_start..want.op_start + want.op_count, got.op_start..) |want_idx, got_idx| {
+            const want_op = fresh.op(want_idx);
+            const got_op = relocated.op(got_idx);
+            try testing.expectEqual(fresh.output(want_op), relocated.output(got_op));
+            for (0..want_op.input_len) |input| {
+                try testing.expectEqual(fresh.varnode(want_op.input_start + input), relocated.varnode(got_op.input_start + input));
+            }
+        }
+    }
+}
+
+test "relocated ranges commit the context they set" {
+    // `blx 0x100` sets TMode at its target, where `bx lr` is Thumb
+    var data = [_]u8{0} ** 0x200;
+    @memcpy(data[0..4], &[_]u8{ 0x3e, 0x00, 0x00, 0xfa });
+    @memcpy(data[0x100..0x102], &[_]u8{ 0x70, 0x47 });
+
+    var first = SleighState.init();
+    defer first.deinit();
+    try first.add_specfile("./specfiles/ARM8_le.sla");
+    first.begin();
+    try first.load_data(0x0, &data);
+
+    var moved = SleighState.init();
+    defer moved.deinit();
+    try moved.add_specfile("./specfiles/ARM8_le.sla");
+    moved.begin();
+    try moved.load_data(0x1000, &data);
+
+    var lifted = LiftedRange{};
+    try first.lift_range(0x0, 0x4, &lifted);
+    defer first.release_range(&lifted);
+
+    // the `blx` is moved rather than decoded again, its context still is set
+    var relocated = LiftedRange{};
+    try moved.relocate_range(&lifted, 0x0, 0x1000, &relocated);
+    defer moved.release_range(&relocated);
+    try testing.expectEqual(@as(u64, 1), relocated.insn_count);
+    try testing.expectEqual(@as(u64, 2), (try moved.disasm(0x1100)).size);
+}
+
+test "overlapping and unmapped regions" {
     var sleigh = SleighState.init();
     defer sleigh.deinit();
     try sleigh.add_specfile("./specfiles/ARM8_le.sla");
     sleigh.begin();
 
-    // call methods in same order as above, tho it doesnt really matter
+    // `push {lr}` then a later region overlapping it, the first region keeps
+    // the bytes it already covered
+    try sleigh.load_data(0x0, &.{ 0x04, 0xe0, 0x2d, 0xe5 });
+    try sleigh.load_data(0x0, &.{ 0, 0, 0, 0, 0, 0, 0, 0 });
+
+    // 0x8.. isn't mapped at all and reads as zeros
+    var range = LiftedRange{};
+    try sleigh.lift_range(0x0, 0x10, &range);
+    defer sleigh.release_range(&range);
+    try testing.expectEqual(@as(u64, 4), range.insn_count);
+
+    var texts: [4][]const u8 = undefined;
+    for (range.insns(), 0..) |*insn, idx| {
+        texts[idx] = try range.to_asm(insn, testing.allocator);
+    }
+    defer for (texts) |text| {
+        testing.allocator.free(text);
+    };
+
+    try testing.expect(!mem.eql(u8, texts[0], texts[1]));
+    try testing.expectEqualStrings(texts[1], texts[2]);
+    try testing.expectEqualStrings(texts[1], texts[3]);
+}
+
+test "map part of a file" {
+    var all = try MappedRegion.map("./specfiles/ARM8_le.sla", 0, 0);
+    defer all.unmap();
+
+    // unaligned offsets are fine
+    var part = try MappedRegion.map("./specfiles/ARM8_le.sla", 3, 16);
+    defer part.unmap();
+
+    try testing.expectEqual(@as(u64, 16), part.size);
+    try testing.expectEqualSlices(u8, all.slice()[3..19], part.slice());
+    try testing.expectError(SleighError.Fail, MappedRegion.map("./specfiles/does-not-exist.sla", 0, 0));
+}
+
+test "numa placement + huge page allocations" {
+    const nodes = Numa.node_count();
+    try testing.expect(nodes >= 1);
+    try testing.expect(Numa.current_node() < nodes);
+
+    Numa.prefer_node(0);
+    Numa.prefer_node(null);
+
+    const small = try huge_page_allocator.alloc(u8, 100);
+    defer huge_page_allocator.free(small);
+    @memset(small, 0xab);
+
+    const big = try huge_page_allocator.alloc(u8, 3 * HUGE_PAGE_SIZE + 1);
+    @memset(big, 0xcd);
+    try testing.expect(mem.isAligned(@intFromPtr(big.ptr), HUGE_PAGE_SIZE));
+    Numa.interleave(big);
+    Numa.advise_huge_pages(big);
+    try testing.expect(huge_page_allocator.resize(big, 4 * HUGE_PAGE_SIZE));
+    try testing.expect(!huge_page_allocator.resize(big, 5 * HUGE_PAGE_SIZE));
+    try testing.expectEqual(@as(u8, 0xcd), big[3 * HUGE_PAGE_SIZE]);
+    huge_page_allocator.free(big.ptr[0 .. 4 * HUGE_PAGE_SIZE]);
+
+    var arena = std.heap.ArenaAllocator.init(huge_page_allocator);
+    defer arena.deinit();
+    const words = try arena.allocator().alloc(u64, HUGE_PAGE_SIZE);
+    @memset(words, 7);
+}
+
+test "object file sections" {
+    var image = try ObjectImage.open("./input-files/hello-world-static-riscv64le");
+    defer image.close();
+
+    var text: ?ObjectSection = null;
+    for (image.slice()) |section| {
+        if (mem.eql(u8, section.get_name(), ".text")) {
+            text = section;
+        }
+        // `.bss` has no bytes in the file
+        if (mem.eql(u8, section.get_name(), ".bss")) {
+            try testing.expect(section.slice() == null);
+            try testing.expect(section.flags & SectionFlags.CODE == 0);
+        }
+    }
+    try testing.expect(text != null);
+    try testing.expect(text.?.flags & SectionFlags.CODE != 0);
+    try testing.expect(image.entry >= text.?.address and image.entry < text.?.address + text.?.size);
+
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/riscv.lp64d.sla");
+    sleigh.begin();
+    try sleigh.load_section(text.?.address, text.?.slice().?, text.?.flags);
+
+    // the entry point decodes straight out of the mapped file
+    const insn = (try sleigh.lift_insn(image.entry)).?;
+    try testing.expect(insn.size > 0);
+
+    try testing.expectError(SleighError.Fail, ObjectImage.open("./specfiles/riscv.lp64d.sla"));
+}
+
+test "zstd image lifts like the raw file" {
+    var raw = try MappedRegion.map("./input-files/hello-world-static-riscv64le", 0, 0);
+    defer raw.unmap();
+    // the raw file split into 64KB pieces, each compressed on its own
+    var image = try ZstdImage.open("./input-files/hello-world-static-riscv64le.zst");
+    try testing.expectEqual(raw.size, image.size);
+    try testing.expect(ZstdImage.detect(image.compressed()));
+    try testing.expect(!ZstdImage.detect(raw.slice()));
+
+    var states = [_]SleighState{ SleighState.init(), SleighState.init() };
+    defer for (&states) |*state| state.deinit();
+    for (&states) |*state| {
+        try state.add_specfile("./specfiles/riscv.lp64d.sla");
+        state.begin();
+    }
+    try states[0].load_data(0x10000, raw.slice());
+    try states[1].load_zstd_data(0x10000, &image);
+    // the state keeps its own reference
+    image.close();
+
+    // crosses from the first frame into the second
+    var ranges = [_]LiftedRange{ .{}, .{} };
+    for (&states, &ranges) |*state, *range| {
+        try state.lift_range(0x10000 + 0xf000, 0x10000 + 0x11000, range);
+    }
+    defer for (&states, &ranges) |*state, *range| state.release_range(range);
+
+    try testing.expectEqual(ranges[0].insn_count, ranges[1].insn_count);
+    try testing.expectEqual(ranges[0].op_count, ranges[1].op_count);
+    for (ranges[0].insns(), ranges[1].insns()) |*a, *b| {
+        try testing.expectEqual(a.size, b.size);
+        try testing.expectEqualSlices(OpCode, ranges[0].opcodes(a), ranges[1].opcodes(b));
+    }
+
+    try testing.expectError(SleighError.Fail, ZstdImage.open("./input-files/hello-world-static-riscv64le"));
+}
+
+test "space table" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    const list = try sleigh.get_spaces();
+    var spaces = try SpaceTable.init(list, testing.allocator);
+    defer spaces.deinit();
+
+    try testing.expectEqual(list.space_count, spaces.kinds.len);
+    for (list.slice(), 0..) |space, idx| {
+        try testing.expectEqual(@as(u64, idx), space.index);
+    }
+
+    // out of bounds indices are an error, not a crash
+    const bad = CompactVarnodeDesc{ .offset = 0, .size = 4, .space = 0xffff };
+    try testing.expectError(SleighError.BadVarSpace, spaces.space_enum(&bad));
+}
+
+test "lifted varnodes carry their register" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // `push {lr}; bx lr`
+    const data = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x1e, 0xff, 0x2f, 0xe1 };
+    try sleigh.load_data(0x0, &data);
+
+    var range = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &range);
+    defer sleigh.release_range(&range);
+
+    const registers = try sleigh.get_registers();
+    try testing.expectEqual(registers, try sleigh.get_registers());
+    var spaces = try SpaceTable.init(try sleigh.get_spaces(), testing.allocator);
+    defer spaces.deinit();
+
+    var seen: usize = 0;
+    const varnodes = range.varnodes();
+    for (0..varnodes.len) |idx| {
+        const vn = varnodes.get(idx);
+        if (try spaces.space_enum(&vn) != .REGISTER) {
+            try testing.expectEqual(CompactVarnodeDesc.NO_REGISTER, vn.register_id);
+            continue;
+        }
+
+        // every register these two read or write is a whole register
+        const reg = registers.slice()[vn.register_id];
+        try testing.expectEqual(vn.offset, reg.varnode.offset);
+        try testing.expectEqual(@as(u64, vn.size), reg.varnode.size);
+        seen += 1;
+    }
+    try testing.expect(seen > 0);
+}
+
+test "lift stats stay off without -DLIBSLA_STATS" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    // `push {lr}; bx lr`
+    const data = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x1e, 0xff, 0x2f, 0xe1 };
+    try sleigh.load_data(0x0, &data);
+
+    var range = LiftedRange{};
+    try sleigh.lift_range(0x0, data.len, &range);
+    defer sleigh.release_range(&range);
+
+    // the unit tests build libsla without the counters
+    const stats = sleigh.get_stats();
+    try testing.expectEqual(@as(u64, 0), stats.enabled);
+    try testing.expectEqual(@as(u64, 0), stats.print_assembly_calls);
+    try testing.expectError(SleighError.Fail, sleigh.set_decode_profile(true));
+    try testing.expectEqual(@as(?[]const u8, null), sleigh.decode_profile_report());
+    try sleigh.set_decode_profile(false);
+
+    var total = LiftStats{ .decode_errors = 1, .allocation_count = 5 };
+    total.add(.{ .decode_errors = 2, .allocation_count = 3 });
+    try testing.expectEqual(@as(u64, 3), total.decode_errors);
+    try testing.expectEqual(@as(u64, 5), total.allocation_count);
+}
+
+test "spec memory usage is shared with forks" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
+
+    const usage = try sleigh.spec_memory_usage();
+    try testing.expect(usage.constructor_count > 0);
+    try testing.expect(usage.varnode_template_count > 0);
+    // identical operands share one template
+    try testing.expect(usage.varnode_template_count < usage.varnode_template_refs);
+    try testing.expect(usage.template_bytes > 0);
+    try testing.expect(usage.template_bytes <= usage.template_capacity);
+
+    var forked = try sleigh.fork();
+    defer forked.deinit();
+    const forked_usage = try forked.spec_memory_usage();
+    try testing.expectEqual(usage.template_bytes, forked_usage.template_bytes);
+    try testing.expectEqual(usage.references + 1, forked_usage.references);
+}
+
+test "compiled decoders lift the same as the decision tables" {
+    // `addi a0,a0,1; c.li a0,0; ret; lui a1,0x12345`
+    const data = [_]u8{ 0x13, 0x05, 0x15, 0x00, 0x01, 0x45, 0x67, 0x80, 0x00, 0x00, 0xb7, 0x55, 0x34, 0x12 };
+
+    var compiled = SleighState.init();
+    defer compiled.deinit();
+    try compiled.add_specfile("./specfiles/riscv.lp64d.sla");
+    compiled.begin();
+    if (compiled.aot_decoder() == null) {
+        // built with `-Daot=none`
+        return error.SkipZigTest;
+    }
+    try testing.expectEqualStrings("riscv.lp64d", compiled.aot_decoder().?);
+
+    SleighSpec.set_aot_decoders(false);
+    defer SleighSpec.set_aot_decoders(true);
+    var tables = SleighState.init();
+    defer tables.deinit();
+    try tables.add_specfile("./specfiles/riscv.lp64d.sla");
+    tables.begin();
+    try testing.expectEqual(@as(?[]const u8, null), tables.aot_decoder());
+
+    try compiled.load_data(0x1000, &data);
+    try tables.load_data(0x1000, &data);
+    var compiled_range = LiftedRange{};
+    try compiled.lift_range(0x1000, 0x1000 + data.len, &compiled_range);
+    defer compiled.release_range(&compiled_range);
+    var tables_range = LiftedRange{};
+    try tables.lift_range(0x1000, 0x1000 + data.len, &tables_range);
+    defer tables.release_range(&tables_range);
+
+    try testing.expectEqual(@as(u64, 4), compiled_range.insn_count);
+    try testing.expectEqual(tables_range.insn_count, compiled_range.insn_count);
+    for (compiled_range.insns(), tables_range.insns()) |*compiled_insn, *tables_insn| {
+        try testing.expectEqual(tables_insn.size, compiled_insn.size);
+        try testing.expectEqualSlices(OpCode, tables_range.opcodes(tables_insn), compiled_range.opcodes(compiled_insn));
+    }
+}
+
+test "forked handles lift the same data" {
+    var sleigh = SleighState.init();
+    defer sleigh.deinit();
+    try sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    sleigh.begin();
     try sleigh.context_var_set_default("TMode", 1);
+    try sleigh.load_data(0x0, &.{ 0, 0, 0, 0, 0, 0, 0, 0 });
 
-    // this translates to `movs r0, r0; movs r0, r0` in
-    // arm thumb
-    try sleigh.load_data(0x0, &.{ 0, 0, 0, 0 });
-    _ = try sleigh.lift_insn(0x0);
+    var forked = try sleigh.fork();
+    defer forked.deinit();
+
+    var parent_range = LiftedRange{};
+    try sleigh.lift_range(0x0, 0x8, &parent_range);
+    defer sleigh.release_range(&parent_range);
+
+    // the context default is carried over, so this is still thumb
+    var forked_range = LiftedRange{};
+    try forked.lift_range(0x0, 0x8, &forked_range);
+    defer forked.release_range(&forked_range);
+
+    try testing.expectEqual(parent_range.insn_count, forked_range.insn_count);
+    try testing.expectEqual(parent_range.op_count, forked_range.op_count);
+    try testing.expectEqual(parent_range.end_address, forked_range.end_address);
+}
+
+test "share a decoded spec" {
+    try testing.expectError(SleighError.InvalidSlaspec, SleighSpec.load("./specfiles/does-not-exist.sla"));
+
+    var spec = try SleighSpec.load("./specfiles/ARM8_le.sla");
+
+    var first = SleighState.init();
+    defer first.deinit();
+    first.use_spec(&spec);
+    first.begin();
+
+    var second = SleighState.init();
+    defer second.deinit();
+    second.use_spec(&spec);
+    second.begin();
+
+    // both handles keep the spec alive
+    spec.deinit();
+
+    try first.load_data(0x0, &.{ 0, 0, 0, 0 });
+    try second.load_data(0x0, &.{ 0, 0, 0, 0 });
+
+    var first_range = LiftedRange{};
+    try first.lift_range(0x0, 0x4, &first_range);
+    defer first.release_range(&first_range);
+
+    var second_range = LiftedRange{};
+    try second.lift_range(0x0, 0x4, &second_range);
+    defer second.release_range(&second_range);
+
+    try testing.expectEqual(first_range.insn_count, second_range.insn_count);
+    try testing.expectEqual(first_range.op_count, second_range.op_count);
+}
+
+test "packed spec lifts like the xml spec" {
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+    const packed_path = try std.fmt.allocPrintZ(testing.allocator, "zig-cache/tmp/{s}/ARM8_le.psla", .{tmp.sub_path});
+    defer testing.allocator.free(packed_path);
+
+    try SleighSpec.pack("./specfiles/ARM8_le.sla", packed_path);
+    try testing.expectError(SleighError.Fail, SleighSpec.pack("./specfiles/ARM8_le.sla", "./does/not/exist.psla"));
+    try testing.expectError(SleighError.InvalidSlaspec, SleighSpec.pack("./specfiles/ARMCortex.pspec", packed_path));
+
+    var xml_sleigh = SleighState.init();
+    defer xml_sleigh.deinit();
+    try xml_sleigh.add_specfile("./specfiles/ARM8_le.sla");
+    xml_sleigh.begin();
+
+    var packed_sleigh = SleighState.init();
+    defer packed_sleigh.deinit();
+    try packed_sleigh.add_specfile(packed_path);
+    packed_sleigh.begin();
+
+    const data = [_]u8{ 0x04, 0xe0, 0x2d, 0xe5, 0x00, 0x00, 0x00, 0x00 };
+    try xml_sleigh.load_data(0x0, &data);
+    try packed_sleigh.load_data(0x0, &data);
+
+    var xml_range = LiftedRange{};
+    try xml_sleigh.lift_range(0x0, data.len, &xml_range);
+    defer xml_sleigh.release_range(&xml_range);
+
+    var packed_range = LiftedRange{};
+    try packed_sleigh.lift_range(0x0, data.len, &packed_range);
+    defer packed_sleigh.release_range(&packed_range);
+
+    try testing.expectEqual(xml_range.insn_count, packed_range.insn_count);
+    try testing.expectEqual(xml_range.op_count, packed_range.op_count);
+    for (xml_range.insns(), packed_range.insns()) |*xml_insn, *packed_insn| {
+        const xml_text = try xml_range.to_asm(xml_insn, testing.allocator);
+        defer testing.allocator.free(xml_text);
+        const packed_text = try packed_range.to_asm(packed_insn, testing.allocator);
+        defer testing.allocator.free(packed_text);
+        try testing.expectEqualStrings(xml_text, packed_text);
+    }
 }
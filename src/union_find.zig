@@ -139,7 +139,7 @@ pub fn UnionFindAligned(comptime T: type, comptime alignment: ?u29) type {
 
             // add item to node, make the new node
             // self-referential
-            var node_ptr = &self.nodes[insert_idx];
+            const node_ptr = &self.nodes[insert_idx];
             node_ptr.item = item;
             node_ptr.next = node_ptr;
             return insert_idx;
@@ -160,7 +160,7 @@ pub fn UnionFindAligned(comptime T: type, comptime alignment: ?u29) type {
         /// returns true if success or bool if pointer is not found
         /// in the table
         pub fn unionItems(self: *Self, child: *T, parent: *T) bool {
-            var child_node = self.getNode(child) orelse return false;
+            const child_node = self.getNode(child) orelse return false;
             const parent_node = self.getNode(parent) orelse return false;
 
             child_node.next = parent_node;
@@ -257,6 +257,87 @@ pub fn UnionFindAligned(comptime T: type, comptime alignment: ?u29) type {
     };
 }
 
+/// Union-Find over dense `u32` ids instead of pointers, for when the sets
+/// are only ever named by their index (like the e-classes of an e-graph).
+/// Unions link the smaller set under the bigger one and `find` halves the
+/// path it walks, so millions of ids stay cheap to merge + look up.
+pub const DenseUnionFind = struct {
+    const Self = @This();
+
+    /// parent of every id, roots point at themselves
+    parents: std.ArrayListUnmanaged(u32) = .{},
+
+    /// number of ids under every root, stale for the others
+    sizes: std.ArrayListUnmanaged(u32) = .{},
+
+    allocator: std.mem.Allocator,
+
+    pub fn init(allocator: Allocator) Self {
+        return Self{ .allocator = allocator };
+    }
+
+    pub fn deinit(self: *Self) void {
+        self.parents.deinit(self.allocator);
+        self.sizes.deinit(self.allocator);
+        self.* = undefined;
+    }
+
+    /// Adds a new id in a set of its own
+    pub fn makeSet(self: *Self) Allocator.Error!u32 {
+        const id: u32 = @intCast(self.parents.items.len);
+        try self.parents.append(self.allocator, id);
+        errdefer _ = self.parents.pop();
+        try self.sizes.append(self.allocator, 1);
+        return id;
+    }
+
+    /// Root of the set `id` is in
+    pub fn find(self: *Self, id: u32) u32 {
+        const parents = self.parents.items;
+        var current = id;
+        while (parents[current] != current) {
+            // path halving, point at the grandparent while walking up
+            parents[current] = parents[parents[current]];
+            current = parents[current];
+        }
+        return current;
+    }
+
+    /// Root of the set `id` is in, without shortening any path
+    pub fn findConst(self: *const Self, id: u32) u32 {
+        var current = id;
+        while (self.parents.items[current] != current) {
+            current = self.parents.items[current];
+        }
+        return current;
+    }
+
+    /// Merges the sets of `a` and `b`, returns the root of the merged set
+    /// or `null` if they already were in the same one
+    pub fn unionSets(self: *Self, a: u32, b: u32) ?u32 {
+        var root_a = self.find(a);
+        var root_b = self.find(b);
+        if (root_a == root_b) {
+            return null;
+        }
+
+        if (self.sizes.items[root_a] < self.sizes.items[root_b]) {
+            std.mem.swap(u32, &root_a, &root_b);
+        }
+        self.parents.items[root_b] = root_a;
+        self.sizes.items[root_a] += self.sizes.items[root_b];
+        return root_a;
+    }
+
+    pub fn inSameSet(self: *Self, a: u32, b: u32) bool {
+        return self.find(a) == self.find(b);
+    }
+
+    pub fn size(self: *const Self) usize {
+        return self.parents.items.len;
+    }
+};
+
 pub const UnionFindError = error{
     InvalidIndex,
 };
@@ -592,3 +673,54 @@ test "transitive testing" {
     // test transitive membership of a and b being in the same set
     try testing.expect(test_uf.inSameSet(&.{ a, b }));
 }
+
+test "dense union find make set" {
+    var test_uf = DenseUnionFind.init(testing.allocator);
+    defer test_uf.deinit();
+
+    try testing.expectEqual(@as(u32, 0), try test_uf.makeSet());
+    try testing.expectEqual(@as(u32, 1), try test_uf.makeSet());
+    try testing.expectEqual(@as(usize, 2), test_uf.size());
+
+    // every id starts out as its own root
+    try testing.expectEqual(@as(u32, 0), test_uf.find(0));
+    try testing.expectEqual(@as(u32, 1), test_uf.find(1));
+    try testing.expect(!test_uf.inSameSet(0, 1));
+}
+
+test "dense union find union sets" {
+    var test_uf = DenseUnionFind.init(testing.allocator);
+    defer test_uf.deinit();
+
+    for (0..4) |_| {
+        _ = try test_uf.makeSet();
+    }
+
+    // the bigger set keeps its root
+    try testing.expectEqual(@as(?u32, 0), test_uf.unionSets(0, 1));
+    try testing.expectEqual(@as(?u32, 0), test_uf.unionSets(2, 0));
+    try testing.expectEqual(@as(?u32, null), test_uf.unionSets(1, 2));
+
+    try testing.expect(test_uf.inSameSet(1, 2));
+    try testing.expect(!test_uf.inSameSet(1, 3));
+    try testing.expectEqual(@as(u32, 0), test_uf.findConst(2));
+}
+
+test "dense union find path halving" {
+    var test_uf = DenseUnionFind.init(testing.allocator);
+    defer test_uf.deinit();
+
+    for (0..5) |_| {
+        _ = try test_uf.makeSet();
+    }
+
+    // build the chain 4 -> 3 -> 2 -> 1 -> 0 by hand
+    for (1..5) |idx| {
+        test_uf.parents.items[idx] = @intCast(idx - 1);
+    }
+
+    try testing.expectEqual(@as(u32, 0), test_uf.find(4));
+    // 4 and 2 skipped their parents on the way up
+    try testing.expectEqual(@as(u32, 2), test_uf.parents.items[4]);
+    try testing.expectEqual(@as(u32, 0), test_uf.parents.items[2]);
+}